@@ -9,6 +9,7 @@ BOARD_USES_GENERIC_INVENSENSE := false
 # Bluetooth
 BOARD_HAVE_BLUETOOTH := true
 BOARD_HAVE_BLUETOOTH_BCM := true
+BOARD_BLUEDROID_VENDOR_CONF := $(BOWSER_COMMON_FOLDER)/bluetooth/vnd_bowser.txt
 
 # Camera
 TI_OMAP4_CAMERAHAL_VARIANT := true
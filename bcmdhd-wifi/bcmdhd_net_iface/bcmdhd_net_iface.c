@@ -6,6 +6,7 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -15,6 +16,18 @@
 #include <private/android_filesystem_config.h>
 
 #define INTERFACE_MAX_BUFFER_SIZE 4096
+#define INTERFACE_REPLY_SIZE 256
+
+/* histogram bucket i counts commands faster than 2^i ms */
+#define STATS_CMDS 16
+#define STATS_NAME_LEN 20
+#define STATS_BUCKETS 10
+
+struct net_iface_cmd {
+	const char *cmd;
+	int ret;
+	char *reply;
+};
 
 typedef struct android_wifi_priv_cmd {
 	char *buf;
@@ -24,9 +37,89 @@ typedef struct android_wifi_priv_cmd {
 
 static struct net_if_snd_cmd_state {
 	int sock;
-	char cmd[INTERFACE_MAX_BUFFER_SIZE];
 	char ibuf[INTERFACE_MAX_BUFFER_SIZE];
-} state;
+	char batch[INTERFACE_MAX_BUFFER_SIZE];
+} state = { .sock = -1 };
+
+static struct net_iface_cmd_stats {
+	char name[STATS_NAME_LEN];
+	unsigned int count;
+	unsigned int errors;
+	unsigned long long total_us;
+	unsigned int max_us;
+	unsigned int hist[STATS_BUCKETS];
+} stats[STATS_CMDS];
+
+static long long now_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void stats_add(const char *cmd, unsigned int us, int ret) {
+	size_t len = strcspn(cmd, " ");
+	int i, b;
+
+	if (len >= STATS_NAME_LEN)
+		len = STATS_NAME_LEN - 1;
+	for (i = 0; i < STATS_CMDS; i++) {
+		if (stats[i].name[0] == '\0') {
+			memcpy(stats[i].name, cmd, len);
+			stats[i].name[len] = '\0';
+			break;
+		}
+		if (strncmp(stats[i].name, cmd, len) == 0 && stats[i].name[len] == '\0')
+			break;
+	}
+	if (i == STATS_CMDS)
+		return;
+
+	stats[i].count++;
+	if (ret < 0)
+		stats[i].errors++;
+	stats[i].total_us += us;
+	if (us > stats[i].max_us)
+		stats[i].max_us = us;
+	for (b = 0; b < STATS_BUCKETS - 1 && us >= (1000U << b); b++)
+		;
+	stats[i].hist[b]++;
+}
+
+/*
+ * Writes one line per private command sent so far:
+ *	<cmd> count=<n> errors=<n> avg_us=<us> max_us=<us> hist=<b0>,...,<b9>
+ * Returns the length written; only whole lines are written.
+ */
+int net_iface_get_stats(char *buf, size_t len) {
+	size_t bc = 0;
+	int i, b, n;
+
+	if (!buf || !len)
+		return -EINVAL;
+	buf[0] = '\0';
+	for (i = 0; i < STATS_CMDS && stats[i].name[0]; i++) {
+		char line[256];
+
+		n = snprintf(line, sizeof(line),
+			     "%s count=%u errors=%u avg_us=%u max_us=%u hist=",
+			     stats[i].name, stats[i].count, stats[i].errors,
+			     (unsigned int)(stats[i].total_us / stats[i].count),
+			     stats[i].max_us);
+		for (b = 0; b < STATS_BUCKETS; b++)
+			n += snprintf(&line[n], sizeof(line) - n, "%u%c", stats[i].hist[b],
+				      b == STATS_BUCKETS - 1 ? '\n' : ',');
+		if (bc + n >= len)
+			break;
+		memcpy(&buf[bc], line, n + 1);
+		bc += n;
+	}
+	return bc;
+}
+
+void net_iface_reset_stats(void) {
+	memset(stats, 0, sizeof(stats));
+}
 
 int net_iface_send_command_init(void) {
 	state.sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -37,6 +130,32 @@ int net_iface_send_command_init(void) {
 	}
 }
 
+static int net_iface_ioctl(const char *ifname, char *buf, int len) {
+	struct ifreq ifr;
+	android_wifi_priv_cmd priv_cmd;
+	long long start;
+	char name[STATS_NAME_LEN];
+	int ret;
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, ifname, IFNAMSIZ);
+
+	priv_cmd.buf = buf;
+	priv_cmd.used_len = len;
+	priv_cmd.total_len = len;
+
+	ifr.ifr_data = &priv_cmd;
+
+	/* the reply overwrites the command, keep its name for the stats */
+	strncpy(name, buf, sizeof(name) - 1);
+	name[sizeof(name) - 1] = '\0';
+	start = now_us();
+	ret = ioctl(state.sock, SIOCDEVPRIVATE + 1, &ifr);
+	stats_add(name, (unsigned int)(now_us() - start), ret);
+
+	return ret;
+}
+
 /*
  * Arguments:
  *	  argv[2] - wlan interface
@@ -46,31 +165,20 @@ int net_iface_send_command_init(void) {
 int net_iface_send_command(int argc, char *argv[], char **rbuf) {
 	int ret, i;
 	size_t bc = 0;
-	struct ifreq ifr;
-	android_wifi_priv_cmd priv_cmd;
 
 	if (argc < 3) {
 		return -EINVAL;
 	}
+	/* the driver replies in the same buffer, build the command there */
 	for (i = 3; i < argc; i++) {
-		bc += snprintf(&state.cmd[bc], sizeof(state.cmd) - bc, "%s ", argv[i]);
-		if (bc >= sizeof(state.cmd)) {
+		bc += snprintf(&state.ibuf[bc], sizeof(state.ibuf) - bc, "%s ", argv[i]);
+		if (bc >= sizeof(state.ibuf)) {
 			return -ENOBUFS;
 		}
 	}
-	state.cmd[bc] = '\0';
-
-	memset(&ifr, 0, sizeof(ifr));
-	strncpy(ifr.ifr_name, argv[2], IFNAMSIZ);
-	strncpy(state.ibuf, state.cmd, INTERFACE_MAX_BUFFER_SIZE);
-
-	priv_cmd.buf = state.ibuf;
-	priv_cmd.used_len = INTERFACE_MAX_BUFFER_SIZE;
-	priv_cmd.total_len = INTERFACE_MAX_BUFFER_SIZE;
+	state.ibuf[bc] = '\0';
 
-	ifr.ifr_data = &priv_cmd;
-
-	if ((ret = ioctl(state.sock, SIOCDEVPRIVATE + 1, &ifr)) < 0) {
+	if ((ret = net_iface_ioctl(argv[2], state.ibuf, INTERFACE_MAX_BUFFER_SIZE)) < 0) {
 		return ret;
 	}
 
@@ -81,3 +189,48 @@ int net_iface_send_command(int argc, char *argv[], char **rbuf) {
 
 	return ret;
 }
+
+/*
+ * Sends several private commands, e.g. "COUNTRY US", "SETBAND 0" and
+ * "POWERMODE 1", to one interface. Each command gets its own slice of
+ * the reply buffer, at least INTERFACE_REPLY_SIZE bytes, so every reply
+ * stays valid until the next call. The driver takes one command per
+ * ioctl, so this saves the per command setup and copies, not the ioctls.
+ *
+ * Arguments:
+ *	  ifname - wlan interface
+ *	  cmds   - commands to send; ret and reply are filled in per command
+ *	  count  - number of commands
+ *
+ * Returns the number of commands that succeeded, or a negative error if
+ * none could be sent.
+ */
+int net_iface_send_batch(const char *ifname, struct net_iface_cmd *cmds, int count) {
+	int i, len, ok = 0;
+	size_t off = 0, slice;
+
+	if (!ifname || !cmds || count <= 0) {
+		return -EINVAL;
+	}
+	if (state.sock < 0) {
+		return -ENOTCONN;
+	}
+	for (i = 0; i < count; i++) {
+		cmds[i].reply = NULL;
+		len = strlen(cmds[i].cmd);
+		slice = len + 1 > INTERFACE_REPLY_SIZE ? len + 1 : INTERFACE_REPLY_SIZE;
+		if (off + slice > sizeof(state.batch)) {
+			cmds[i].ret = -ENOBUFS;
+			continue;
+		}
+		memcpy(&state.batch[off], cmds[i].cmd, len + 1);
+		cmds[i].ret = net_iface_ioctl(ifname, &state.batch[off], slice);
+		if (cmds[i].ret >= 0) {
+			cmds[i].reply = &state.batch[off];
+			ok++;
+		}
+		off += slice;
+	}
+
+	return ok ? ok : cmds[0].ret;
+}
@@ -13,6 +13,7 @@
 #include "driver_nl80211.h"
 #include "wpa_supplicant_i.h"
 #include "config.h"
+#include "bss.h"
 #ifdef ANDROID
 #include "android_drv.h"
 #endif
@@ -22,6 +23,18 @@
 
 #define MAX_WPSP2PIE_CMD_SIZE		512
 
+/* streaming profile limits, CTWindow is a 7 bit TU count */
+#define P2P_CTWINDOW_MAX		127
+#define P2P_STREAM_TX_GUARD_MS		4
+#define P2P_NOA_MIN_MS			5
+
+/* a busy driver is retried after 10, 20 and 40 ms */
+#define DRV_CMD_RETRIES			3
+#define DRV_CMD_RETRY_US		10000
+
+/* RSSI and LINKSPEED arrive back to back, answer both from one poll */
+#define SIGNAL_POLL_CACHE_MS		500
+
 typedef struct android_wifi_priv_cmd {
 	char *buf;
 	int used_len;
@@ -31,24 +44,393 @@ typedef struct android_wifi_priv_cmd {
 int send_and_recv_msgs(struct wpa_driver_nl80211_data *drv, struct nl_msg *msg,
 		       int (*valid_handler)(struct nl_msg *, void *),
 		       void *valid_data);
+int wpa_driver_set_p2p_stream_profile(void *priv, int fps,
+				      int max_latency_ms);
 
 static int drv_errors = 0;
 
+/*
+ * Roam offload settings per network. The firmware keeps one set, so the
+ * one of the current network is pushed again whenever a driver command
+ * finds us associated to a different network than last time; the
+ * framework sends several right after each connection.
+ */
+#define ROAM_PROFILE_MAX		8
+
+static struct roam_profile {
+	u8 ssid[MAX_SSID_LEN];
+	size_t ssid_len;
+	struct wpa_roam_params params;
+} roam_profiles[ROAM_PROFILE_MAX];
+static int roam_profile_next;
+
+static struct {
+	int ifindex;
+	u8 bssid[ETH_ALEN];
+} roam_applied;
+
+/* AP IEs last pushed per frame type, to skip pushes that change nothing */
+static char ap_ie_ifname[IFNAMSIZ + 1];
+static struct ap_ie_cache {
+	int valid;
+	size_t len;
+	u8 ie[MAX_WPSP2PIE_CMD_SIZE];
+} ap_ie_cache[3];
+
+static struct signal_poll_cache {
+	int ifindex;
+	u8 bssid[ETH_ALEN];
+	struct os_time stamp;
+	struct wpa_signal_info si;
+} sig_cache;
+
+/*
+ * Per command latency statistics, reported by "STATS" and cleared by
+ * "STATS RESET". Bucket i of the histogram counts calls that took less
+ * than 2^i ms, the last one everything slower.
+ */
+#define DRV_STATS_CMDS			24
+#define DRV_STATS_NAME_LEN		20
+#define DRV_STATS_BUCKETS		10
+
+static struct drv_cmd_stats {
+	char name[DRV_STATS_NAME_LEN];
+	unsigned int count;
+	unsigned int errors;
+	unsigned long long total_us;
+	unsigned int max_us;
+	unsigned int hist[DRV_STATS_BUCKETS];
+} drv_stats[DRV_STATS_CMDS];
+
+static unsigned int drv_stats_hangs;
+static unsigned int drv_stats_retries;
+
+static long long wpa_driver_stats_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* name is the command up to the first blank */
+static void wpa_driver_stats_add(const char *name, long long start, int ret)
+{
+	struct drv_cmd_stats *st = NULL;
+	unsigned int us = (unsigned int)(wpa_driver_stats_now_us() - start);
+	size_t len = strcspn(name, " ");
+	int i, b;
+
+	if (len >= DRV_STATS_NAME_LEN)
+		len = DRV_STATS_NAME_LEN - 1;
+	for (i = 0; i < DRV_STATS_CMDS; i++) {
+		if (drv_stats[i].name[0] == '\0') {
+			/* first use of this command */
+			os_memcpy(drv_stats[i].name, name, len);
+			drv_stats[i].name[len] = '\0';
+			st = &drv_stats[i];
+			break;
+		}
+		if (os_strncmp(drv_stats[i].name, name, len) == 0 &&
+		    drv_stats[i].name[len] == '\0') {
+			st = &drv_stats[i];
+			break;
+		}
+	}
+	if (!st)
+		return;
+
+	st->count++;
+	if (ret < 0)
+		st->errors++;
+	st->total_us += us;
+	if (us > st->max_us)
+		st->max_us = us;
+	for (b = 0; b < DRV_STATS_BUCKETS - 1 && us >= (1000U << b); b++)
+		;
+	st->hist[b]++;
+}
+
+static int wpa_driver_stats_report(char *buf, size_t buf_len)
+{
+	int i, b, len = 0, line = 0, n;
+
+	/* only whole lines go out if buf is too short */
+	for (i = 0; i < DRV_STATS_CMDS && drv_stats[i].name[0]; i++) {
+		struct drv_cmd_stats *st = &drv_stats[i];
+
+		line = len;
+		n = os_snprintf(buf + len, buf_len - len,
+				"%s count=%u errors=%u avg_us=%u max_us=%u hist=",
+				st->name, st->count, st->errors,
+				st->count ? (unsigned int)(st->total_us / st->count) : 0,
+				st->max_us);
+		if (n < 0 || (size_t)n >= buf_len - len)
+			goto truncated;
+		len += n;
+		for (b = 0; b < DRV_STATS_BUCKETS; b++) {
+			n = os_snprintf(buf + len, buf_len - len, "%u%c",
+					st->hist[b],
+					b == DRV_STATS_BUCKETS - 1 ? '\n' : ',');
+			if (n < 0 || (size_t)n >= buf_len - len)
+				goto truncated;
+			len += n;
+		}
+	}
+	n = os_snprintf(buf + len, buf_len - len, "hangs=%u retries=%u\n",
+			drv_stats_hangs, drv_stats_retries);
+	if (n > 0 && (size_t)n < buf_len - len)
+		len += n;
+	return len;
+
+truncated:
+	buf[line] = '\0';
+	return line;
+}
+
+static void wpa_driver_flush_ap_ie_cache(void)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+		ap_ie_cache[i].valid = 0;
+}
+
 static void wpa_driver_send_hang_msg(struct wpa_driver_nl80211_data *drv)
 {
 	drv_errors++;
 	if (drv_errors > DRV_NUMBER_SEQUENTIAL_ERRORS) {
 		drv_errors = 0;
+		/* the reloaded firmware has none of our IEs */
+		wpa_driver_flush_ap_ie_cache();
+		drv_stats_hangs++;
 		wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "HANGED");
 	}
 }
 
+/*
+ * Only failures that point at a dead driver or firmware count towards
+ * the HANGED threshold, since that reloads the whole module. A driver
+ * still busy after the retries or a command it refuses does not.
+ */
+static void wpa_driver_cmd_error(struct wpa_driver_nl80211_data *drv, int err)
+{
+	if (err < 0)
+		err = -err;
+
+	switch (err) {
+	case EBUSY:
+	case EAGAIN:
+	case EINTR:
+	case EINVAL:
+	case EOPNOTSUPP:
+	case EPERM:
+		wpa_printf(MSG_DEBUG, "nl80211: driver command error %d, "
+			   "not counted as hang", err);
+		return;
+	default:
+		wpa_driver_send_hang_msg(drv);
+	}
+}
+
+/* Returns 1 after backing off if a command that failed with err is retried */
+static int wpa_driver_cmd_retry(int err, int attempt)
+{
+	if (err < 0)
+		err = -err;
+	if ((err != EBUSY && err != EAGAIN && err != EINTR) ||
+	    attempt >= DRV_CMD_RETRIES)
+		return 0;
+	os_sleep(0, DRV_CMD_RETRY_US << attempt);
+	drv_stats_retries++;
+	return 1;
+}
+
+/*
+ * Issue a private command, retrying while the driver is busy. The driver
+ * may have written into buf, so the cmd_len bytes of the command are
+ * restored from a saved copy before each retry; longer commands are
+ * tried only once. Returns the ioctl result, with the errno as negative
+ * value on failure.
+ */
+static int wpa_driver_priv_cmd_ioctl(struct i802_bss *bss, char *buf,
+				     int len, int cmd_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	char saved[MAX_WPSP2PIE_CMD_SIZE];
+	struct ifreq ifr;
+	android_wifi_priv_cmd priv_cmd;
+	int ret, attempt = 0, can_retry = cmd_len <= (int)sizeof(saved);
+	char name[DRV_STATS_NAME_LEN];
+	long long start = wpa_driver_stats_now_us();
+
+	if (can_retry)
+		os_memcpy(saved, buf, cmd_len);
+	os_strlcpy(name, buf, sizeof(name));
+
+	for (;;) {
+		memset(&ifr, 0, sizeof(ifr));
+		memset(&priv_cmd, 0, sizeof(priv_cmd));
+		os_strncpy(ifr.ifr_name, bss->ifname, IFNAMSIZ);
+
+		priv_cmd.buf = buf;
+		priv_cmd.used_len = len;
+		priv_cmd.total_len = len;
+		ifr.ifr_data = &priv_cmd;
+
+		ret = ioctl(drv->global->ioctl_sock, SIOCDEVPRIVATE + 1, &ifr);
+		if (ret < 0)
+			ret = -errno;
+		if (ret >= 0 || !can_retry ||
+		    !wpa_driver_cmd_retry(ret, attempt++)) {
+			/* retries and backoff count towards the latency */
+			wpa_driver_stats_add(name, start, ret);
+			return ret;
+		}
+		os_memcpy(buf, saved, cmd_len);
+	}
+}
+
+static struct roam_profile *wpa_driver_find_roam_profile(const u8 *ssid,
+							 size_t ssid_len)
+{
+	int i;
+
+	for (i = 0; i < ROAM_PROFILE_MAX; i++) {
+		if (roam_profiles[i].ssid_len == ssid_len && ssid_len &&
+		    os_memcmp(roam_profiles[i].ssid, ssid, ssid_len) == 0)
+			return &roam_profiles[i];
+	}
+	return NULL;
+}
+
+static int wpa_driver_roam_cmd(struct i802_bss *bss, char *buf, int len)
+{
+	int ret;
+
+	wpa_printf(MSG_DEBUG, "%s: %s", __func__, buf);
+	ret = wpa_driver_priv_cmd_ioctl(bss, buf, len, len);
+	if (ret < 0)
+		wpa_driver_cmd_error(bss->drv, ret);
+	return ret;
+}
+
+/*
+ * Push the roam settings of the current network to the firmware. Without
+ * a channel list of its own the channels its APs were last seen on, from
+ * the BSS table, become the roam scan channel cache.
+ */
+static int wpa_driver_apply_roam_params(struct i802_bss *bss)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	struct wpa_supplicant *wpa_s = drv->ctx;
+	struct roam_profile *prof;
+	struct wpa_roam_params *p;
+	struct wpa_bss *wbss;
+	char buf[MAX_DRV_CMD_SIZE];
+	u8 chans[ROAM_MAX_CHANNELS];
+	int i, j, n, len, ret = 0;
+	u8 chan;
+
+	roam_applied.ifindex = drv->ifindex;
+	os_memcpy(roam_applied.bssid, drv->bssid, ETH_ALEN);
+
+	prof = wpa_driver_find_roam_profile(drv->ssid, drv->ssid_len);
+	if (!prof)
+		return 0;
+	p = &prof->params;
+
+	if (p->trigger) {
+		len = os_snprintf(buf, sizeof(buf), "SETROAMTRIGGER %d", p->trigger);
+		ret |= wpa_driver_roam_cmd(bss, buf, len + 1);
+	}
+	if (p->delta) {
+		len = os_snprintf(buf, sizeof(buf), "SETROAMDELTA %d", p->delta);
+		ret |= wpa_driver_roam_cmd(bss, buf, len + 1);
+	}
+	if (p->scan_period) {
+		len = os_snprintf(buf, sizeof(buf), "SETROAMSCANPERIOD %d",
+				  p->scan_period);
+		ret |= wpa_driver_roam_cmd(bss, buf, len + 1);
+	}
+
+	n = p->num_channels;
+	os_memcpy(chans, p->channels, n);
+	if (n == 0 && wpa_s) {
+		dl_list_for_each(wbss, &wpa_s->bss, struct wpa_bss, list) {
+			if (wbss->ssid_len != drv->ssid_len ||
+			    os_memcmp(wbss->ssid, drv->ssid, drv->ssid_len) != 0)
+				continue;
+			if (wbss->freq == 2484)
+				chan = 14;
+			else if (wbss->freq < 2484)
+				chan = (wbss->freq - 2407) / 5;
+			else
+				chan = (wbss->freq - 5000) / 5;
+			for (j = 0; j < n && chans[j] != chan; j++)
+				;
+			if (j == n && n < ROAM_MAX_CHANNELS)
+				chans[n++] = chan;
+		}
+	}
+	if (n) {
+		len = os_snprintf(buf, sizeof(buf), "SETROAMSCANCHANNELS %d", n);
+		for (i = 0; i < n; i++)
+			len += os_snprintf(buf + len, sizeof(buf) - len, " %d",
+					   chans[i]);
+		ret |= wpa_driver_roam_cmd(bss, buf, len + 1);
+	}
+
+	return ret < 0 ? -1 : 0;
+}
+
+/**
+ * wpa_driver_set_roam_params - Set the firmware roam settings of a network
+ * @priv: Pointer to private driver data (struct i802_bss)
+ * @ssid: Network the settings belong to
+ * @ssid_len: Length of ssid
+ * @params: Roam trigger, delta, scan period and channels
+ * Returns: 0 on success, -1 on failure
+ *
+ * The settings are kept for ROAM_PROFILE_MAX networks and are pushed to
+ * the firmware now if we are associated to that network, otherwise the
+ * next time we are.
+ */
+int wpa_driver_set_roam_params(void *priv, const u8 *ssid, size_t ssid_len,
+			       const struct wpa_roam_params *params)
+{
+	struct i802_bss *bss = priv;
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	struct roam_profile *prof;
+
+	if (ssid_len == 0 || ssid_len > MAX_SSID_LEN ||
+	    params->num_channels < 0 ||
+	    params->num_channels > ROAM_MAX_CHANNELS)
+		return -1;
+
+	prof = wpa_driver_find_roam_profile(ssid, ssid_len);
+	if (!prof) {
+		/* replace the oldest one */
+		prof = &roam_profiles[roam_profile_next];
+		roam_profile_next = (roam_profile_next + 1) % ROAM_PROFILE_MAX;
+		os_memcpy(prof->ssid, ssid, ssid_len);
+		prof->ssid_len = ssid_len;
+	}
+	os_memcpy(&prof->params, params, sizeof(*params));
+
+	if (drv->associated && drv->ssid_len == ssid_len &&
+	    os_memcmp(drv->ssid, ssid, ssid_len) == 0)
+		return wpa_driver_apply_roam_params(bss);
+	return 0;
+}
+
 static int wpa_driver_set_power_save(void *priv, int state)
 {
 	struct i802_bss *bss = priv;
 	struct wpa_driver_nl80211_data *drv = bss->drv;
 	struct nl_msg *msg;
 	int ret = -1;
+	long long start;
 	enum nl80211_ps_state ps_state;
 
 	msg = nlmsg_alloc();
@@ -66,7 +448,9 @@ static int wpa_driver_set_power_save(void *priv, int state)
 	NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, drv->ifindex);
 	NLA_PUT_U32(msg, NL80211_ATTR_PS_STATE, ps_state);
 
+	start = wpa_driver_stats_now_us();
 	ret = send_and_recv_msgs(drv, msg, NULL, NULL);
+	wpa_driver_stats_add("NL80211_SET_POWER_SAVE", start, ret);
 	msg = NULL;
 	if (ret < 0)
 		wpa_printf(MSG_ERROR, "nl80211: Set power mode fail: %d", ret);
@@ -103,6 +487,7 @@ static int wpa_driver_get_power_save(void *priv, int *state)
 	struct wpa_driver_nl80211_data *drv = bss->drv;
 	struct nl_msg *msg;
 	int ret = -1;
+	long long start;
 	enum nl80211_ps_state ps_state;
 
 	msg = nlmsg_alloc();
@@ -114,7 +499,9 @@ static int wpa_driver_get_power_save(void *priv, int *state)
 
 	NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, drv->ifindex);
 
+	start = wpa_driver_stats_now_us();
 	ret = send_and_recv_msgs(drv, msg, get_power_mode_handler, state);
+	wpa_driver_stats_add("NL80211_GET_POWER_SAVE", start, ret);
 	msg = NULL;
 	if (ret < 0)
 		wpa_printf(MSG_ERROR, "nl80211: Get power mode fail: %d", ret);
@@ -123,203 +510,1368 @@ nla_put_failure:
 	return ret;
 }
 
-static int wpa_driver_set_backgroundscan_params(void *priv)
+/* what one NL80211_CMD_GET_STATION tells us about the current AP */
+struct station_stats {
+	struct wpa_signal_info si;
+	u32 rx_bytes;
+	u32 tx_bytes;
+	int have_bytes;
+};
+
+static int get_station_handler(struct nl_msg *msg, void *arg)
 {
-	struct i802_bss *bss = priv;
-	struct wpa_driver_nl80211_data *drv = bss->drv;
-	struct wpa_supplicant *wpa_s;
-	struct ifreq ifr;
-	android_wifi_priv_cmd priv_cmd;
-	int ret = 0, i = 0, bp;
-	char buf[WEXT_PNO_MAX_COMMAND_SIZE];
-	struct wpa_ssid *ssid_conf;
+	struct nlattr *tb[NL80211_ATTR_MAX + 1];
+	struct genlmsghdr *gnlh = nlmsg_data(nlmsg_hdr(msg));
+	struct nlattr *sinfo[NL80211_STA_INFO_MAX + 1];
+	struct nlattr *rinfo[NL80211_RATE_INFO_MAX + 1];
+	static struct nla_policy policy[NL80211_STA_INFO_MAX + 1] = {
+		[NL80211_STA_INFO_SIGNAL] = { .type = NLA_U8 },
+		[NL80211_STA_INFO_RX_BYTES] = { .type = NLA_U32 },
+		[NL80211_STA_INFO_TX_BYTES] = { .type = NLA_U32 },
+	};
+	static struct nla_policy rate_policy[NL80211_RATE_INFO_MAX + 1] = {
+		[NL80211_RATE_INFO_BITRATE] = { .type = NLA_U16 },
+		[NL80211_RATE_INFO_MCS] = { .type = NLA_U8 },
+		[NL80211_RATE_INFO_40_MHZ_WIDTH] = { .type = NLA_FLAG },
+		[NL80211_RATE_INFO_SHORT_GI] = { .type = NLA_FLAG },
+	};
+	struct station_stats *st = arg;
+	struct wpa_signal_info *si = &st->si;
 
-	if (drv == NULL) {
-		wpa_printf(MSG_ERROR, "%s: drv is NULL. Exiting", __func__);
-		return -1;
-	}
-	if (drv->ctx == NULL) {
-		wpa_printf(MSG_ERROR, "%s: drv->ctx is NULL. Exiting", __func__);
-		return -1;
-	}
-	wpa_s = (struct wpa_supplicant *)(drv->ctx);
-	if (wpa_s->conf == NULL) {
-		wpa_printf(MSG_ERROR, "%s: wpa_s->conf is NULL. Exiting", __func__);
-		return -1;
-	}
-	ssid_conf = wpa_s->conf->ssid;
+	nla_parse(tb, NL80211_ATTR_MAX, genlmsg_attrdata(gnlh, 0),
+		  genlmsg_attrlen(gnlh, 0), NULL);
 
-	bp = WEXT_PNOSETUP_HEADER_SIZE;
-	os_memcpy(buf, WEXT_PNOSETUP_HEADER, bp);
-	buf[bp++] = WEXT_PNO_TLV_PREFIX;
-	buf[bp++] = WEXT_PNO_TLV_VERSION;
-	buf[bp++] = WEXT_PNO_TLV_SUBVERSION;
-	buf[bp++] = WEXT_PNO_TLV_RESERVED;
+	if (!tb[NL80211_ATTR_STA_INFO] ||
+	    nla_parse_nested(sinfo, NL80211_STA_INFO_MAX,
+			     tb[NL80211_ATTR_STA_INFO], policy))
+		return NL_SKIP;
 
-	while ((i < WEXT_PNO_AMOUNT) && (ssid_conf != NULL)) {
-		/* Check that there is enough space needed for 1 more SSID, the other sections and null termination */
-		if ((bp + WEXT_PNO_SSID_HEADER_SIZE + MAX_SSID_LEN + WEXT_PNO_NONSSID_SECTIONS_SIZE + 1) >= (int)sizeof(buf))
-			break;
-		if ((!ssid_conf->disabled) && (ssid_conf->ssid_len <= MAX_SSID_LEN)){
-			wpa_printf(MSG_DEBUG, "For PNO Scan: %s", ssid_conf->ssid);
-			buf[bp++] = WEXT_PNO_SSID_SECTION;
-			buf[bp++] = ssid_conf->ssid_len;
-			os_memcpy(&buf[bp], ssid_conf->ssid, ssid_conf->ssid_len);
-			bp += ssid_conf->ssid_len;
-			i++;
-		}
-		ssid_conf = ssid_conf->next;
+	if (sinfo[NL80211_STA_INFO_SIGNAL])
+		si->current_signal =
+			(s8) nla_get_u8(sinfo[NL80211_STA_INFO_SIGNAL]);
+
+	if (sinfo[NL80211_STA_INFO_TX_BITRATE] &&
+	    !nla_parse_nested(rinfo, NL80211_RATE_INFO_MAX,
+			      sinfo[NL80211_STA_INFO_TX_BITRATE],
+			      rate_policy) &&
+	    rinfo[NL80211_RATE_INFO_BITRATE])
+		/* reported in 100 kbps units */
+		si->current_txrate =
+			nla_get_u16(rinfo[NL80211_RATE_INFO_BITRATE]) * 100;
+
+	if (sinfo[NL80211_STA_INFO_RX_BYTES] &&
+	    sinfo[NL80211_STA_INFO_TX_BYTES]) {
+		st->rx_bytes = nla_get_u32(sinfo[NL80211_STA_INFO_RX_BYTES]);
+		st->tx_bytes = nla_get_u32(sinfo[NL80211_STA_INFO_TX_BYTES]);
+		st->have_bytes = 1;
 	}
 
-	buf[bp++] = WEXT_PNO_SCAN_INTERVAL_SECTION;
-	os_snprintf(&buf[bp], WEXT_PNO_SCAN_INTERVAL_LENGTH + 1, "%x", WEXT_PNO_SCAN_INTERVAL);
-	bp += WEXT_PNO_SCAN_INTERVAL_LENGTH;
+	return NL_SKIP;
+}
 
-	buf[bp++] = WEXT_PNO_REPEAT_SECTION;
-	os_snprintf(&buf[bp], WEXT_PNO_REPEAT_LENGTH + 1, "%x", WEXT_PNO_REPEAT);
-	bp += WEXT_PNO_REPEAT_LENGTH;
+static int wpa_driver_get_station(struct wpa_driver_nl80211_data *drv,
+				  struct station_stats *st)
+{
+	struct nl_msg *msg;
+	int ret = -1;
+	long long start;
 
-	buf[bp++] = WEXT_PNO_MAX_REPEAT_SECTION;
-	os_snprintf(&buf[bp], WEXT_PNO_MAX_REPEAT_LENGTH + 1, "%x", WEXT_PNO_MAX_REPEAT);
-	bp += WEXT_PNO_MAX_REPEAT_LENGTH + 1;
+	msg = nlmsg_alloc();
+	if (!msg)
+		return -1;
 
-	memset(&ifr, 0, sizeof(ifr));
-	memset(&priv_cmd, 0, sizeof(priv_cmd));
-	os_strncpy(ifr.ifr_name, bss->ifname, IFNAMSIZ);
+	os_memset(st, 0, sizeof(*st));
+	st->si.current_signal = -9999;
+	st->si.current_noise = WPA_INVALID_NOISE;
+	st->si.frequency = drv->assoc_freq;
 
-	priv_cmd.buf = buf;
-	priv_cmd.used_len = bp;
-	priv_cmd.total_len = bp;
-	ifr.ifr_data = &priv_cmd;
+	genlmsg_put(msg, 0, 0, drv->global->nl80211_id, 0, 0,
+		    NL80211_CMD_GET_STATION, 0);
 
-	ret = ioctl(drv->global->ioctl_sock, SIOCDEVPRIVATE + 1, &ifr);
+	NLA_PUT_U32(msg, NL80211_ATTR_IFINDEX, drv->ifindex);
+	NLA_PUT(msg, NL80211_ATTR_MAC, ETH_ALEN, drv->bssid);
 
-	if (ret < 0) {
-		wpa_printf(MSG_ERROR, "ioctl[SIOCSIWPRIV] (pnosetup): %d", ret);
-		wpa_driver_send_hang_msg(drv);
-	} else {
-		drv_errors = 0;
+	start = wpa_driver_stats_now_us();
+	ret = send_and_recv_msgs(drv, msg, get_station_handler, st);
+	wpa_driver_stats_add("NL80211_GET_STATION", start, ret);
+	msg = NULL;
+	if (ret < 0 || st->si.current_signal == -9999) {
+		wpa_printf(MSG_DEBUG, "nl80211: Get station fail: %d", ret);
+		ret = -1;
 	}
+nla_put_failure:
+	nlmsg_free(msg);
 	return ret;
 }
 
-int wpa_driver_nl80211_driver_cmd(void *priv, char *cmd, char *buf,
-				  size_t buf_len )
+/**
+ * wpa_driver_nl80211_signal_poll - Get RSSI and tx rate of the current AP
+ * @priv: Pointer to private driver data (struct i802_bss)
+ * @si: Filled with the signal information
+ * Returns: 0 on success, -1 on failure
+ *
+ * A single NL80211_CMD_GET_STATION request for the associated BSSID
+ * returns both values, which replaces a RSSI and a LINKSPEED private
+ * command. The answer is reused for SIGNAL_POLL_CACHE_MS. Noise is not
+ * part of the station info and is reported as WPA_INVALID_NOISE.
+ */
+int wpa_driver_nl80211_signal_poll(void *priv, struct wpa_signal_info *si)
 {
 	struct i802_bss *bss = priv;
 	struct wpa_driver_nl80211_data *drv = bss->drv;
-	struct ifreq ifr;
-	android_wifi_priv_cmd priv_cmd;
-	int ret = 0;
-
-	if (os_strcasecmp(cmd, "STOP") == 0) {
-		linux_set_iface_flags(drv->global->ioctl_sock, bss->ifname, 0);
-		wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "STOPPED");
-	} else if (os_strcasecmp(cmd, "START") == 0) {
-		linux_set_iface_flags(drv->global->ioctl_sock, bss->ifname, 1);
-		wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "STARTED");
-	} else if (os_strcasecmp(cmd, "MACADDR") == 0) {
-		u8 macaddr[ETH_ALEN] = {};
-
-		ret = linux_get_ifhwaddr(drv->global->ioctl_sock, bss->ifname, macaddr);
-		if (!ret)
-			ret = os_snprintf(buf, buf_len,
-					  "Macaddr = " MACSTR "\n", MAC2STR(macaddr));
-	} else if (os_strcasecmp(cmd, "RELOAD") == 0) {
-		wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "HANGED");
-	} else if (os_strncasecmp(cmd, "POWERMODE ", 10) == 0) {
-		int state;
+	struct station_stats st;
+	struct os_time now;
 
-		state = atoi(cmd + 10);
-		ret = wpa_driver_set_power_save(priv, state);
-		if (ret < 0)
-			wpa_driver_send_hang_msg(drv);
-		else
-			drv_errors = 0;
-	} else if (os_strncasecmp(cmd, "GETPOWER", 8) == 0) {
-		int state = -1;
-
-		ret = wpa_driver_get_power_save(priv, &state);
-		if (!ret && (state != -1)) {
-			ret = os_snprintf(buf, buf_len, "POWERMODE = %d\n", state);
-			drv_errors = 0;
-		} else {
-			wpa_driver_send_hang_msg(drv);
-		}
-	} else { /* Use private command */
-		if (os_strcasecmp(cmd, "BGSCAN-START") == 0) {
-			ret = wpa_driver_set_backgroundscan_params(priv);
-			if (ret < 0) {
-				return ret;
-			}
-			os_memcpy(buf, "PNOFORCE 1", 11);
-		} else if (os_strcasecmp(cmd, "BGSCAN-STOP") == 0) {
-			os_memcpy(buf, "PNOFORCE 0", 11);
-		} else {
-			os_memcpy(buf, cmd, strlen(cmd) + 1);
-		}
-		memset(&ifr, 0, sizeof(ifr));
-		memset(&priv_cmd, 0, sizeof(priv_cmd));
-		os_strncpy(ifr.ifr_name, bss->ifname, IFNAMSIZ);
+	if (!drv->associated)
+		return -1;
 
-		priv_cmd.buf = buf;
-		priv_cmd.used_len = buf_len;
-		priv_cmd.total_len = buf_len;
-		ifr.ifr_data = &priv_cmd;
+	os_get_time(&now);
+	if (sig_cache.ifindex == drv->ifindex &&
+	    os_memcmp(sig_cache.bssid, drv->bssid, ETH_ALEN) == 0 &&
+	    (now.sec - sig_cache.stamp.sec) * 1000 +
+	    (now.usec - sig_cache.stamp.usec) / 1000 < SIGNAL_POLL_CACHE_MS) {
+		os_memcpy(si, &sig_cache.si, sizeof(*si));
+		return 0;
+	}
 
-		if ((ret = ioctl(drv->global->ioctl_sock, SIOCDEVPRIVATE + 1, &ifr)) < 0) {
-			wpa_printf(MSG_ERROR, "%s: failed to issue private commands\n", __func__);
-			wpa_driver_send_hang_msg(drv);
-		} else {
-			drv_errors = 0;
-			ret = 0;
-			if ((os_strcasecmp(cmd, "LINKSPEED") == 0) ||
-			    (os_strcasecmp(cmd, "RSSI") == 0) ||
-			    (os_strcasecmp(cmd, "GETBAND") == 0) )
-				ret = strlen(buf);
-			else if (os_strcasecmp(cmd, "COUNTRY") == 0)
-				wpa_supplicant_event(drv->ctx,
-					EVENT_CHANNEL_LIST_CHANGED, NULL);
-			wpa_printf(MSG_DEBUG, "%s %s len = %d, %d", __func__, buf, ret, strlen(buf));
-		}
+	if (wpa_driver_get_station(drv, &st) < 0) {
+		sig_cache.ifindex = 0;
+		return -1;
 	}
-	return ret;
+	os_memcpy(si, &st.si, sizeof(*si));
+	sig_cache.ifindex = drv->ifindex;
+	os_memcpy(sig_cache.bssid, drv->bssid, ETH_ALEN);
+	sig_cache.stamp = now;
+	os_memcpy(&sig_cache.si, si, sizeof(*si));
+	return 0;
 }
 
-int wpa_driver_set_p2p_noa(void *priv, u8 count, int start, int duration)
+/*
+ * Dynamic power save ("PSPOLICY AUTO [high_kbps low_kbps]"): the traffic
+ * to and from the AP is sampled every PS_POLICY_INTERVAL seconds. Power
+ * save goes off as soon as a sample reaches high_kbps and comes back
+ * after PS_POLICY_IDLE_SAMPLES samples in a row below low_kbps, so a
+ * stream stays in active mode across short gaps. "POWERMODE 1" pauses
+ * the policy until "POWERMODE 0", "PSPOLICY OFF" or STOP ends it.
+ */
+#define PS_POLICY_INTERVAL		1
+#define PS_POLICY_HIGH_KBPS		500
+#define PS_POLICY_LOW_KBPS		100
+#define PS_POLICY_IDLE_SAMPLES		5
+
+static struct ps_policy {
+	struct nl80211_global *global;
+	int ifindex;		/* 0 while the policy is off */
+	int paused;
+	int high_kbps;
+	int low_kbps;
+	int active;		/* power save is off */
+	int idle;		/* samples in a row below low_kbps */
+	int have_sample;
+	u32 rx_bytes;
+	u32 tx_bytes;
+} ps_policy;
+
+static void wpa_driver_ps_policy_apply(struct wpa_driver_nl80211_data *drv,
+				       int active)
 {
-	char buf[MAX_DRV_CMD_SIZE];
+	if (wpa_driver_set_power_save(&drv->first_bss, active ?
+				      WPA_PS_DISABLED : WPA_PS_ENABLED) < 0)
+		return;
+	wpa_printf(MSG_DEBUG, "nl80211: PS policy -> %s",
+		   active ? "active" : "power save");
+	ps_policy.active = active;
+	ps_policy.idle = 0;
+}
 
-	memset(buf, 0, sizeof(buf));
-	wpa_printf(MSG_DEBUG, "%s: Entry", __func__);
-	snprintf(buf, sizeof(buf), "P2P_SET_NOA %d %d %d", count, start, duration);
-	return wpa_driver_nl80211_driver_cmd(priv, buf, buf, strlen(buf)+1);
+static void wpa_driver_ps_policy_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_driver_nl80211_data *drv;
+	struct station_stats st;
+	unsigned long long kbps;
+
+	if (!ps_policy.ifindex)
+		return;
+
+	/* the interface may be gone, only the global data outlives eloop */
+	dl_list_for_each(drv, &ps_policy.global->interfaces,
+			 struct wpa_driver_nl80211_data, list) {
+		if (drv->ifindex == ps_policy.ifindex)
+			break;
+	}
+	if (&drv->list == &ps_policy.global->interfaces) {
+		ps_policy.ifindex = 0;
+		return;
+	}
+
+	if (!ps_policy.paused && drv->associated &&
+	    wpa_driver_get_station(drv, &st) == 0 && st.have_bytes) {
+		if (ps_policy.have_sample) {
+			/* u32 counters, the differences survive a wrap */
+			kbps = (unsigned long long)
+				((u32)(st.rx_bytes - ps_policy.rx_bytes) +
+				 (u32)(st.tx_bytes - ps_policy.tx_bytes)) *
+				8 / 1000 / PS_POLICY_INTERVAL;
+			if (kbps >= (unsigned long long)ps_policy.high_kbps) {
+				ps_policy.idle = 0;
+				if (!ps_policy.active)
+					wpa_driver_ps_policy_apply(drv, 1);
+			} else if (ps_policy.active &&
+				   kbps < (unsigned long long)ps_policy.low_kbps) {
+				if (++ps_policy.idle >= PS_POLICY_IDLE_SAMPLES)
+					wpa_driver_ps_policy_apply(drv, 0);
+			} else {
+				ps_policy.idle = 0;
+			}
+		}
+		ps_policy.rx_bytes = st.rx_bytes;
+		ps_policy.tx_bytes = st.tx_bytes;
+		ps_policy.have_sample = 1;
+	} else {
+		ps_policy.have_sample = 0;
+	}
+
+	eloop_register_timeout(PS_POLICY_INTERVAL, 0,
+			       wpa_driver_ps_policy_timeout, NULL, NULL);
 }
 
-int wpa_driver_get_p2p_noa(void *priv, u8 *buf, size_t len)
+static int wpa_driver_set_ps_policy(struct wpa_driver_nl80211_data *drv,
+				    const char *arg)
 {
-	/* Return 0 till we handle p2p_presence request completely in the driver */
+	int high = PS_POLICY_HIGH_KBPS, low = PS_POLICY_LOW_KBPS;
+
+	eloop_cancel_timeout(wpa_driver_ps_policy_timeout, NULL, NULL);
+	ps_policy.ifindex = 0;
+
+	if (os_strncasecmp(arg, "OFF", 3) == 0)
+		return 0;
+	if (os_strncasecmp(arg, "AUTO", 4) != 0)
+		return -1;
+	if (sscanf(arg + 4, "%d %d", &high, &low) == 1 || high <= 0 ||
+	    low < 0 || low > high)
+		return -1;
+
+	os_memset(&ps_policy, 0, sizeof(ps_policy));
+	ps_policy.global = drv->global;
+	ps_policy.ifindex = drv->ifindex;
+	ps_policy.high_kbps = high;
+	ps_policy.low_kbps = low;
+	/* start from power save and let the traffic turn it off */
+	wpa_driver_ps_policy_apply(drv, 0);
+	eloop_register_timeout(PS_POLICY_INTERVAL, 0,
+			       wpa_driver_ps_policy_timeout, NULL, NULL);
 	return 0;
 }
 
-int wpa_driver_set_p2p_ps(void *priv, int legacy_ps, int opp_ps, int ctwindow)
+/*
+ * PNO profile: the firmware scans every interval seconds, and after
+ * repeat scans without a match doubles the interval, at most max_repeat
+ * times. Selected at runtime with "PNOPROFILE <name>" or
+ * "PNOPROFILE <interval> <repeat> <max_repeat>".
+ */
+struct pno_profile {
+	const char *name;
+	int interval;
+	int repeat;
+	int max_repeat;
+};
+
+static const struct pno_profile pno_profiles[] = {
+	{ "default", WEXT_PNO_SCAN_INTERVAL, WEXT_PNO_REPEAT,
+	  WEXT_PNO_MAX_REPEAT },
+	{ "fast", 10, 2, 2 },
+	{ "lowpower", 60, 2, 4 },
+	{ NULL, 0, 0, 0 }
+};
+
+static struct pno_profile pno_cur = {
+	"default", WEXT_PNO_SCAN_INTERVAL, WEXT_PNO_REPEAT, WEXT_PNO_MAX_REPEAT
+};
+
+/* networks we were recently connected to go first in the PNO list */
+#define PNO_HISTORY_LEN		8
+
+static struct pno_history {
+	u8 ssid[MAX_SSID_LEN];
+	size_t ssid_len;
+	os_time_t seen;
+} pno_history[PNO_HISTORY_LEN];
+
+/* the last PNOSETUP command, reused while nothing it depends on changed */
+static struct pno_cache {
+	int valid;
+	struct wpa_config *conf;
+	u32 fingerprint;
+	int len;
+	char buf[WEXT_PNO_MAX_COMMAND_SIZE];
+} pno_cache;
+
+static void pno_note_connected(const u8 *ssid, size_t ssid_len)
 {
-	char buf[MAX_DRV_CMD_SIZE];
+	struct os_time now;
+	int i, slot = -1, oldest = 0, newest = 0;
 
-	memset(buf, 0, sizeof(buf));
-	wpa_printf(MSG_DEBUG, "%s: Entry", __func__);
-	snprintf(buf, sizeof(buf), "P2P_SET_PS %d %d %d", legacy_ps, opp_ps, ctwindow);
-	return wpa_driver_nl80211_driver_cmd(priv, buf, buf, strlen(buf) + 1);
+	if (ssid_len == 0 || ssid_len > MAX_SSID_LEN)
+		return;
+
+	for (i = 0; i < PNO_HISTORY_LEN; i++) {
+		if (pno_history[i].ssid_len == ssid_len &&
+		    os_memcmp(pno_history[i].ssid, ssid, ssid_len) == 0)
+			slot = i;
+		if (pno_history[i].seen < pno_history[oldest].seen)
+			oldest = i;
+		if (pno_history[i].seen > pno_history[newest].seen)
+			newest = i;
+	}
+
+	/* only a change of order needs the PNO list to be rebuilt */
+	if (slot < 0 || (slot != newest &&
+			 pno_history[slot].seen != pno_history[newest].seen)) {
+		pno_cache.valid = 0;
+		if (slot < 0)
+			slot = oldest;
+	}
+
+	os_get_time(&now);
+	os_memcpy(pno_history[slot].ssid, ssid, ssid_len);
+	pno_history[slot].ssid_len = ssid_len;
+	pno_history[slot].seen = now.sec;
 }
 
-int wpa_driver_set_ap_wps_p2p_ie(void *priv, const struct wpabuf *beacon,
-				 const struct wpabuf *proberesp,
+/* 0 for the most recently connected network, PNO_HISTORY_LEN if never */
+static int pno_rank(const struct wpa_ssid *ssid)
+{
+	int i, rank = 0;
+	os_time_t seen = 0;
+
+	for (i = 0; i < PNO_HISTORY_LEN; i++) {
+		if (pno_history[i].ssid_len == ssid->ssid_len &&
+		    os_memcmp(pno_history[i].ssid, ssid->ssid,
+			      ssid->ssid_len) == 0) {
+			seen = pno_history[i].seen;
+			break;
+		}
+	}
+	if (!seen)
+		return PNO_HISTORY_LEN;
+	for (i = 0; i < PNO_HISTORY_LEN; i++)
+		if (pno_history[i].ssid_len && pno_history[i].seen > seen)
+			rank++;
+	return rank;
+}
+
+/* orders PNO candidates: recent connections, then priority, then list */
+static int pno_better(const struct wpa_ssid *a, int rank_a,
+		      const struct wpa_ssid *b, int rank_b)
+{
+	if (rank_a != rank_b)
+		return rank_a < rank_b;
+	return a->priority > b->priority;
+}
+
+static u32 pno_fingerprint(struct wpa_ssid *ssid_conf)
+{
+	u32 h = 2166136261u;
+	size_t i;
+
+	for (; ssid_conf; ssid_conf = ssid_conf->next) {
+		h = (h ^ ssid_conf->id) * 16777619u;
+		h = (h ^ ssid_conf->disabled) * 16777619u;
+		h = (h ^ ssid_conf->priority) * 16777619u;
+		h = (h ^ ssid_conf->ssid_len) * 16777619u;
+		for (i = 0; i < ssid_conf->ssid_len; i++)
+			h = (h ^ ssid_conf->ssid[i]) * 16777619u;
+	}
+	return h;
+}
+
+static int wpa_driver_set_pno_profile(const char *arg)
+{
+	int i, interval, repeat, max_repeat;
+
+	for (i = 0; pno_profiles[i].name; i++) {
+		if (os_strcasecmp(arg, pno_profiles[i].name) == 0) {
+			pno_cur = pno_profiles[i];
+			pno_cache.valid = 0;
+			return 0;
+		}
+	}
+
+	if (sscanf(arg, "%d %d %d", &interval, &repeat, &max_repeat) != 3)
+		return -1;
+	/* the TLV has two hex digits for the interval and one for the rest */
+	if (interval < 1 || interval > 0xff || repeat < 0 || repeat > 0xf ||
+	    max_repeat < 0 || max_repeat > 0xf)
+		return -1;
+	pno_cur.name = "custom";
+	pno_cur.interval = interval;
+	pno_cur.repeat = repeat;
+	pno_cur.max_repeat = max_repeat;
+	pno_cache.valid = 0;
+	return 0;
+}
+
+static int wpa_driver_build_pno_cmd(struct wpa_ssid *ssid_conf, char *buf,
+				    size_t buf_len)
+{
+	struct wpa_ssid *best[WEXT_PNO_AMOUNT];
+	int rank[WEXT_PNO_AMOUNT];
+	int i, j, r, n = 0, bp;
+
+	/* keep the WEXT_PNO_AMOUNT best enabled networks in order */
+	for (; ssid_conf; ssid_conf = ssid_conf->next) {
+		if (ssid_conf->disabled || ssid_conf->ssid_len == 0 ||
+		    ssid_conf->ssid_len > MAX_SSID_LEN)
+			continue;
+		r = pno_rank(ssid_conf);
+		for (i = n; i > 0 && pno_better(ssid_conf, r, best[i - 1],
+						rank[i - 1]); i--)
+			;
+		if (i >= WEXT_PNO_AMOUNT)
+			continue;
+		if (n < WEXT_PNO_AMOUNT)
+			n++;
+		for (j = n - 1; j > i; j--) {
+			best[j] = best[j - 1];
+			rank[j] = rank[j - 1];
+		}
+		best[i] = ssid_conf;
+		rank[i] = r;
+	}
+
+	bp = WEXT_PNOSETUP_HEADER_SIZE;
+	os_memcpy(buf, WEXT_PNOSETUP_HEADER, bp);
+	buf[bp++] = WEXT_PNO_TLV_PREFIX;
+	buf[bp++] = WEXT_PNO_TLV_VERSION;
+	buf[bp++] = WEXT_PNO_TLV_SUBVERSION;
+	buf[bp++] = WEXT_PNO_TLV_RESERVED;
+
+	for (i = 0; i < n; i++) {
+		/* Check that there is enough space needed for 1 more SSID, the other sections and null termination */
+		if ((bp + WEXT_PNO_SSID_HEADER_SIZE + MAX_SSID_LEN + WEXT_PNO_NONSSID_SECTIONS_SIZE + 1) >= (int)buf_len)
+			break;
+		wpa_printf(MSG_DEBUG, "For PNO Scan: %s", best[i]->ssid);
+		buf[bp++] = WEXT_PNO_SSID_SECTION;
+		buf[bp++] = best[i]->ssid_len;
+		os_memcpy(&buf[bp], best[i]->ssid, best[i]->ssid_len);
+		bp += best[i]->ssid_len;
+	}
+
+	buf[bp++] = WEXT_PNO_SCAN_INTERVAL_SECTION;
+	os_snprintf(&buf[bp], WEXT_PNO_SCAN_INTERVAL_LENGTH + 1, "%02x", pno_cur.interval);
+	bp += WEXT_PNO_SCAN_INTERVAL_LENGTH;
+
+	buf[bp++] = WEXT_PNO_REPEAT_SECTION;
+	os_snprintf(&buf[bp], WEXT_PNO_REPEAT_LENGTH + 1, "%x", pno_cur.repeat);
+	bp += WEXT_PNO_REPEAT_LENGTH;
+
+	buf[bp++] = WEXT_PNO_MAX_REPEAT_SECTION;
+	os_snprintf(&buf[bp], WEXT_PNO_MAX_REPEAT_LENGTH + 1, "%x", pno_cur.max_repeat);
+	bp += WEXT_PNO_MAX_REPEAT_LENGTH + 1;
+
+	return bp;
+}
+
+static int wpa_driver_set_backgroundscan_params(void *priv)
+{
+	struct i802_bss *bss = priv;
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	struct wpa_supplicant *wpa_s;
+	int ret = 0;
+	char buf[WEXT_PNO_MAX_COMMAND_SIZE];
+	u32 fingerprint;
+
+	if (drv == NULL) {
+		wpa_printf(MSG_ERROR, "%s: drv is NULL. Exiting", __func__);
+		return -1;
+	}
+	if (drv->ctx == NULL) {
+		wpa_printf(MSG_ERROR, "%s: drv->ctx is NULL. Exiting", __func__);
+		return -1;
+	}
+	wpa_s = (struct wpa_supplicant *)(drv->ctx);
+	if (wpa_s->conf == NULL) {
+		wpa_printf(MSG_ERROR, "%s: wpa_s->conf is NULL. Exiting", __func__);
+		return -1;
+	}
+
+	if (wpa_s->current_ssid)
+		pno_note_connected(wpa_s->current_ssid->ssid,
+				   wpa_s->current_ssid->ssid_len);
+
+	/*
+	 * The supplicant has no change counter for its network list, so a
+	 * cheap fingerprint of it decides whether the command is rebuilt.
+	 */
+	fingerprint = pno_fingerprint(wpa_s->conf->ssid);
+	if (!pno_cache.valid || pno_cache.conf != wpa_s->conf ||
+	    pno_cache.fingerprint != fingerprint) {
+		pno_cache.len = wpa_driver_build_pno_cmd(wpa_s->conf->ssid,
+							 pno_cache.buf,
+							 sizeof(pno_cache.buf));
+		pno_cache.conf = wpa_s->conf;
+		pno_cache.fingerprint = fingerprint;
+		pno_cache.valid = 1;
+	}
+
+	/* the driver may write into the buffer, hand it a copy */
+	os_memcpy(buf, pno_cache.buf, pno_cache.len);
+	ret = wpa_driver_priv_cmd_ioctl(bss, buf, pno_cache.len, pno_cache.len);
+
+	if (ret < 0) {
+		wpa_printf(MSG_ERROR, "ioctl[SIOCSIWPRIV] (pnosetup): %d", ret);
+		wpa_driver_cmd_error(drv, ret);
+	} else {
+		drv_errors = 0;
+	}
+	return ret;
+}
+
+/*
+ * bcmdhd packet filters, numbered as RXFILTER-ADD/REMOVE take them. They
+ * are pass filters applied while the host sleeps, so removing one drops
+ * that traffic in the firmware instead of waking the host for it.
+ */
+#define RX_FILTER_BROADCAST		1
+#define RX_FILTER_MULTICAST4		2
+#define RX_FILTER_MULTICAST6		3
+#define RX_FILTER_SCREEN_OFF_DROP	((1 << RX_FILTER_BROADCAST) | \
+					 (1 << RX_FILTER_MULTICAST4) | \
+					 (1 << RX_FILTER_MULTICAST6))
+#define RX_FILTER_STEPS_MAX		8
+
+static struct rx_filter_state {
+	int ifindex;
+	int keep;	/* pass filters added by the framework (multicast lock) */
+	int dropped;	/* pass filters removed for screen off */
+} rx_filter;
+
+/* flags of a driver command table entry */
+#define DRV_CMD_ARGS		0x01	/* name is a prefix, arguments follow */
+#define DRV_CMD_RET_LEN		0x02	/* answers in buf, its length is returned */
+#define DRV_CMD_CHANLIST	0x04	/* changes the allowed channels */
+
+typedef int (*drv_cmd_handler)(struct i802_bss *bss, char *cmd, char *arg,
+			       char *buf, size_t buf_len);
+
+/*
+ * Send cmd as a private command, with the answer in buf. buf may already
+ * hold what is to be sent instead of cmd.
+ */
+static int wpa_driver_private_cmd(struct i802_bss *bss, const char *cmd,
+				  char *buf, size_t buf_len, int flags)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	int ret;
+
+	if (buf != cmd)
+		os_memcpy(buf, cmd, strlen(cmd) + 1);
+	/* binary commands carry their exact length, text ones don't */
+	if ((ret = wpa_driver_priv_cmd_ioctl(bss, buf, buf_len,
+			buf_len <= MAX_WPSP2PIE_CMD_SIZE ?
+			(int)buf_len : (int)strlen(buf) + 1)) < 0) {
+		wpa_printf(MSG_ERROR, "%s: failed to issue private commands (%d)\n", __func__, ret);
+		wpa_driver_cmd_error(drv, ret);
+		return ret;
+	}
+
+	drv_errors = 0;
+	ret = 0;
+	if (flags & DRV_CMD_RET_LEN)
+		ret = strlen(buf);
+	else if (flags & DRV_CMD_CHANLIST)
+		wpa_supplicant_event(drv->ctx, EVENT_CHANNEL_LIST_CHANGED, NULL);
+	wpa_printf(MSG_DEBUG, "%s %s len = %d, %d", __func__, buf, ret, strlen(buf));
+	return ret;
+}
+
+/*
+ * Bluetooth coexistence on the shared antenna, "BTCOEXPROFILE <IDLE|A2DP|
+ * SCO>" from whoever follows the active BT profiles. The profile picks
+ * the BTCOEXMODE and how scans share the air with BT: BTCOEXSCAN-START
+ * has the driver scan BT aware, and shorter channel dwells with longer
+ * stays on the home channel leave BT its slots in between. Only settings
+ * that differ from the last applied ones are sent, in one pass like
+ * SETSUSPENDMODE, so repeating a profile costs nothing. The framework's
+ * own "BTCOEXMODE 1" around DHCP holds until its "BTCOEXMODE 2", which
+ * then gets the mode of the profile.
+ */
+#define BTCOEX_MODE_ENABLED	0	/* BT has priority */
+#define BTCOEX_MODE_DISABLED	1	/* Wi-Fi has priority, DHCP */
+#define BTCOEX_MODE_SENSE	2	/* firmware follows the BT traffic */
+#define BTCOEX_STEPS_MAX	4
+
+static const struct btcoex_profile {
+	const char *name;
+	int mode;
+	int scan;		/* BTCOEXSCAN-START */
+	int channel_ms;		/* SETSCANCHANNELTIME */
+	int home_ms;		/* SETSCANHOMETIME */
+} btcoex_profiles[] = {
+	{ "IDLE",	BTCOEX_MODE_SENSE,	0,	40,	45 },
+	{ "A2DP",	BTCOEX_MODE_SENSE,	1,	30,	90 },
+	{ "SCO",	BTCOEX_MODE_ENABLED,	1,	20,	120 },
+};
+
+/* what the driver was last given, -1 if not known */
+static struct btcoex_state {
+	int ifindex;
+	const struct btcoex_profile *profile;	/* NULL until one is set */
+	int dhcp;
+	int mode;
+	int scan;
+	int channel_ms;
+	int home_ms;
+} btcoex;
+
+static void wpa_driver_btcoex_reset(struct wpa_driver_nl80211_data *drv,
+				    int force)
+{
+	if (!force && btcoex.ifindex == drv->ifindex)
+		return;
+	btcoex.ifindex = drv->ifindex;
+	btcoex.profile = NULL;
+	btcoex.dhcp = 0;
+	btcoex.mode = -1;
+	btcoex.scan = -1;
+	btcoex.channel_ms = -1;
+	btcoex.home_ms = -1;
+}
+
+static int wpa_driver_btcoex_apply(struct i802_bss *bss, char *buf,
+				   size_t buf_len)
+{
+	const struct btcoex_profile *p = btcoex.profile;
+	struct {
+		char cmd[24];
+		int *cache;
+		int val;
+		int optional;	/* not every driver has it, failure is kept */
+	} steps[BTCOEX_STEPS_MAX];
+	int n = 0, i, ret;
+
+	if (!btcoex.dhcp && btcoex.mode != p->mode) {
+		os_snprintf(steps[n].cmd, sizeof(steps[n].cmd),
+			    "BTCOEXMODE %d", p->mode);
+		steps[n].cache = &btcoex.mode;
+		steps[n].val = p->mode;
+		steps[n++].optional = 0;
+	}
+	if (btcoex.scan != p->scan) {
+		os_strlcpy(steps[n].cmd, p->scan ? "BTCOEXSCAN-START" :
+			   "BTCOEXSCAN-STOP", sizeof(steps[n].cmd));
+		steps[n].cache = &btcoex.scan;
+		steps[n].val = p->scan;
+		steps[n++].optional = 0;
+	}
+	if (btcoex.channel_ms != p->channel_ms) {
+		os_snprintf(steps[n].cmd, sizeof(steps[n].cmd),
+			    "SETSCANCHANNELTIME %d", p->channel_ms);
+		steps[n].cache = &btcoex.channel_ms;
+		steps[n].val = p->channel_ms;
+		steps[n++].optional = 1;
+	}
+	if (btcoex.home_ms != p->home_ms) {
+		os_snprintf(steps[n].cmd, sizeof(steps[n].cmd),
+			    "SETSCANHOMETIME %d", p->home_ms);
+		steps[n].cache = &btcoex.home_ms;
+		steps[n].val = p->home_ms;
+		steps[n++].optional = 1;
+	}
+
+	for (i = 0; i < n; i++) {
+		ret = wpa_driver_private_cmd(bss, steps[i].cmd, buf, buf_len,
+					     0);
+		if (ret < 0 && !steps[i].optional) {
+			wpa_printf(MSG_ERROR, "%s: '%s' failed (%d), step %d "
+				   "of %d", __func__, steps[i].cmd, ret, i + 1,
+				   n);
+			return ret;
+		}
+		if (ret < 0)
+			wpa_printf(MSG_DEBUG, "%s: '%s' not supported (%d)",
+				   __func__, steps[i].cmd, ret);
+		*steps[i].cache = steps[i].val;
+	}
+	wpa_printf(MSG_DEBUG, "%s: BT %s, %d commands", __func__, p->name, n);
+	return 0;
+}
+
+static int wpa_driver_cmd_btcoexprofile(struct i802_bss *bss, char *cmd,
+					char *arg, char *buf, size_t buf_len)
+{
+	unsigned int i;
+
+	wpa_driver_btcoex_reset(bss->drv, 0);
+	for (i = 0; i < sizeof(btcoex_profiles) / sizeof(btcoex_profiles[0]);
+	     i++) {
+		if (os_strcasecmp(arg, btcoex_profiles[i].name) == 0)
+			break;
+	}
+	if (i == sizeof(btcoex_profiles) / sizeof(btcoex_profiles[0])) {
+		wpa_printf(MSG_ERROR, "%s: bad BT profile '%s'", __func__,
+			   arg);
+		return -1;
+	}
+	btcoex.profile = &btcoex_profiles[i];
+	return wpa_driver_btcoex_apply(bss, buf, buf_len);
+}
+
+/* the framework's "BTCOEXMODE <n>", kept track of so profiles don't undo it */
+static int wpa_driver_cmd_btcoexmode(struct i802_bss *bss, char *cmd,
+				     char *arg, char *buf, size_t buf_len)
+{
+	int mode = atoi(arg), ret;
+
+	wpa_driver_btcoex_reset(bss->drv, 0);
+	ret = wpa_driver_private_cmd(bss, cmd, buf, buf_len, 0);
+	if (ret < 0)
+		return ret;
+	btcoex.mode = mode;
+	btcoex.dhcp = mode == BTCOEX_MODE_DISABLED;
+	/* end of DHCP, back to what the BT profile wants */
+	if (mode == BTCOEX_MODE_SENSE && btcoex.profile)
+		return wpa_driver_btcoex_apply(bss, buf, buf_len);
+	return ret;
+}
+
+/*
+ * Low latency mode for streaming and VoIP, "LOWLATENCY START [seconds]"
+ * and "LOWLATENCY STOP", counted so that it lasts while anyone holds it.
+ * Power save goes off, with the PS policy paused, and the firmware stops
+ * roaming and its roam scans. PNO is stopped and a BGSCAN-START meanwhile
+ * only takes effect when the mode ends. Every START renews the timeout,
+ * LOW_LATENCY_TIMEOUT by default and none for 0, after which all holds
+ * are dropped in case a client went away without its STOP.
+ */
+#define LOW_LATENCY_TIMEOUT		300
+
+static struct low_latency {
+	struct nl80211_global *global;
+	int ifindex;
+	int holds;		/* 0 while the mode is off */
+	int saved_ps;		/* power save to go back to */
+	int saved_paused;	/* PS policy paused before */
+} low_latency;
+
+static int pno_started;	/* BGSCAN-START without BGSCAN-STOP */
+
+static void wpa_driver_low_latency_timeout(void *eloop_ctx,
+					   void *timeout_ctx);
+
+/* Switches the mode, the steps that fail are logged and skipped */
+static void wpa_driver_low_latency_set(struct i802_bss *bss, int on)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	char buf[32];
+	int paused = ps_policy.ifindex == drv->ifindex;
+
+	if (on) {
+		if (wpa_driver_get_power_save(bss, &low_latency.saved_ps) < 0)
+			low_latency.saved_ps = WPA_PS_ENABLED;
+		if (paused) {
+			low_latency.saved_paused = ps_policy.paused;
+			ps_policy.paused = 1;
+			ps_policy.idle = 0;
+			ps_policy.have_sample = 0;
+		}
+		if (wpa_driver_set_power_save(bss, WPA_PS_DISABLED) == 0 &&
+		    paused)
+			ps_policy.active = 1;
+	} else if (paused && !low_latency.saved_paused) {
+		/* the policy takes over again from active mode */
+		ps_policy.paused = 0;
+	} else {
+		wpa_driver_set_power_save(bss, low_latency.saved_ps);
+	}
+
+	os_strlcpy(buf, on ? "SETROAMMODE 1" : "SETROAMMODE 0", sizeof(buf));
+	if (wpa_driver_private_cmd(bss, buf, buf, sizeof(buf), 0) < 0)
+		wpa_printf(MSG_DEBUG, "%s: roam mode not changed", __func__);
+	if (pno_started) {
+		os_strlcpy(buf, on ? "PNOFORCE 0" : "PNOFORCE 1", sizeof(buf));
+		wpa_driver_private_cmd(bss, buf, buf, sizeof(buf), 0);
+	}
+	wpa_printf(MSG_DEBUG, "%s: low latency %s", __func__,
+		   on ? "on" : "off");
+}
+
+/* drop the mode without telling the driver, which starts over */
+static void wpa_driver_low_latency_reset(void)
+{
+	eloop_cancel_timeout(wpa_driver_low_latency_timeout, NULL, NULL);
+	os_memset(&low_latency, 0, sizeof(low_latency));
+}
+
+static void wpa_driver_low_latency_timeout(void *eloop_ctx, void *timeout_ctx)
+{
+	struct wpa_driver_nl80211_data *drv;
+
+	if (!low_latency.holds)
+		return;
+
+	/* the interface may be gone, only the global data outlives eloop */
+	dl_list_for_each(drv, &low_latency.global->interfaces,
+			 struct wpa_driver_nl80211_data, list) {
+		if (drv->ifindex == low_latency.ifindex)
+			break;
+	}
+	wpa_printf(MSG_INFO, "%s: %d holds timed out", __func__,
+		   low_latency.holds);
+	if (&drv->list != &low_latency.global->interfaces)
+		wpa_driver_low_latency_set(&drv->first_bss, 0);
+	wpa_driver_low_latency_reset();
+}
+
+static int wpa_driver_cmd_lowlatency(struct i802_bss *bss, char *cmd,
+				     char *arg, char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	int timeout = LOW_LATENCY_TIMEOUT;
+
+	if (low_latency.holds && low_latency.ifindex != drv->ifindex)
+		return -1;
+
+	if (os_strncasecmp(arg, "START", 5) == 0) {
+		if (arg[5] && (sscanf(arg + 5, "%d", &timeout) != 1 ||
+			       timeout < 0))
+			return -1;
+		if (!low_latency.holds++) {
+			low_latency.global = drv->global;
+			low_latency.ifindex = drv->ifindex;
+			wpa_driver_low_latency_set(bss, 1);
+		}
+		eloop_cancel_timeout(wpa_driver_low_latency_timeout, NULL,
+				     NULL);
+		if (timeout)
+			eloop_register_timeout(timeout, 0,
+					       wpa_driver_low_latency_timeout,
+					       NULL, NULL);
+		return 0;
+	}
+	if (os_strcasecmp(arg, "STOP") != 0)
+		return -1;
+	if (!low_latency.holds)
+		return 0;
+	if (--low_latency.holds == 0) {
+		wpa_driver_low_latency_set(bss, 0);
+		wpa_driver_low_latency_reset();
+	}
+	return 0;
+}
+
+static int wpa_driver_cmd_stop(struct i802_bss *bss, char *cmd, char *arg,
+			       char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+
+	wpa_driver_set_ps_policy(drv, "OFF");
+	wpa_driver_flush_ap_ie_cache();
+	/* the driver comes back with its default filters and coex settings */
+	os_memset(&rx_filter, 0, sizeof(rx_filter));
+	wpa_driver_btcoex_reset(drv, 1);
+	wpa_driver_low_latency_reset();
+	pno_started = 0;
+	linux_set_iface_flags(drv->global->ioctl_sock, bss->ifname, 0);
+	wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "STOPPED");
+	return 0;
+}
+
+static int wpa_driver_cmd_start(struct i802_bss *bss, char *cmd, char *arg,
+				char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+
+	linux_set_iface_flags(drv->global->ioctl_sock, bss->ifname, 1);
+	wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "STARTED");
+	return 0;
+}
+
+static int wpa_driver_cmd_macaddr(struct i802_bss *bss, char *cmd, char *arg,
+				  char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	u8 macaddr[ETH_ALEN] = {};
+	int ret;
+
+	ret = linux_get_ifhwaddr(drv->global->ioctl_sock, bss->ifname, macaddr);
+	if (!ret)
+		ret = os_snprintf(buf, buf_len,
+				  "Macaddr = " MACSTR "\n", MAC2STR(macaddr));
+	return ret;
+}
+
+static int wpa_driver_cmd_reload(struct i802_bss *bss, char *cmd, char *arg,
+				 char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+
+	wpa_driver_flush_ap_ie_cache();
+	os_memset(&rx_filter, 0, sizeof(rx_filter));
+	wpa_driver_btcoex_reset(drv, 1);
+	wpa_driver_low_latency_reset();
+	pno_started = 0;
+	wpa_msg(drv->ctx, MSG_INFO, WPA_EVENT_DRIVER_STATE "HANGED");
+	return 0;
+}
+
+static void wpa_driver_rx_filter_reset(struct wpa_driver_nl80211_data *drv)
+{
+	if (rx_filter.ifindex == drv->ifindex)
+		return;
+	os_memset(&rx_filter, 0, sizeof(rx_filter));
+	rx_filter.ifindex = drv->ifindex;
+}
+
+/* the framework's own filter changes, remembered so screen off keeps them */
+static int wpa_driver_cmd_rxfilter(struct i802_bss *bss, char *cmd,
+				   char *arg, char *buf, size_t buf_len)
+{
+	int add = os_strncasecmp(cmd, "RXFILTER-ADD ", 13) == 0;
+	int num = atoi(arg), ret;
+
+	wpa_driver_rx_filter_reset(bss->drv);
+	ret = wpa_driver_private_cmd(bss, cmd, buf, buf_len, 0);
+	if (ret < 0 || num < 0 || num >= 32)
+		return ret;
+	if (add) {
+		rx_filter.keep |= 1 << num;
+		rx_filter.dropped &= ~(1 << num);
+	} else {
+		rx_filter.keep &= ~(1 << num);
+	}
+	return ret;
+}
+
+/*
+ * "SETSUSPENDMODE <1|0>", sent by the framework on screen off and on.
+ * Screen off removes the broadcast and multicast pass filters the
+ * framework does not hold and then puts the driver in suspend mode, where
+ * it answers ARP for the host addresses itself. Screen on undoes both.
+ * The bcmdhd ioctl takes one command at a time, so the transition is one
+ * pass over the steps it needs, stopping at the first failure, whose
+ * error is what the framework gets back.
+ */
+static int wpa_driver_cmd_suspendmode(struct i802_bss *bss, char *cmd,
+				      char *arg, char *buf, size_t buf_len)
+{
+	struct {
+		char cmd[24];
+		int filter;	/* filter the step adds or removes, 0 if none */
+	} steps[RX_FILTER_STEPS_MAX];
+	int suspend = atoi(arg) != 0, change, n = 0, i, f, ret = 0;
+
+	wpa_driver_rx_filter_reset(bss->drv);
+	if (suspend)
+		change = RX_FILTER_SCREEN_OFF_DROP & ~rx_filter.keep &
+			~rx_filter.dropped;
+	else
+		change = rx_filter.dropped;
+
+	if (!suspend) {
+		os_strlcpy(steps[n].cmd, "SETSUSPENDMODE 0", sizeof(steps[n].cmd));
+		steps[n++].filter = 0;
+	}
+	if (change) {
+		os_strlcpy(steps[n].cmd, "RXFILTER-STOP", sizeof(steps[n].cmd));
+		steps[n++].filter = 0;
+		for (f = RX_FILTER_BROADCAST; f <= RX_FILTER_MULTICAST6; f++) {
+			if (!(change & (1 << f)))
+				continue;
+			os_snprintf(steps[n].cmd, sizeof(steps[n].cmd),
+				    "RXFILTER-%s %d", suspend ? "REMOVE" : "ADD",
+				    f);
+			steps[n++].filter = f;
+		}
+		os_strlcpy(steps[n].cmd, "RXFILTER-START", sizeof(steps[n].cmd));
+		steps[n++].filter = 0;
+	}
+	if (suspend) {
+		os_strlcpy(steps[n].cmd, "SETSUSPENDMODE 1", sizeof(steps[n].cmd));
+		steps[n++].filter = 0;
+	}
+
+	for (i = 0; i < n; i++) {
+		ret = wpa_driver_private_cmd(bss, steps[i].cmd, buf, buf_len,
+					     0);
+		if (ret < 0) {
+			wpa_printf(MSG_ERROR, "%s: '%s' failed (%d), step %d "
+				   "of %d", __func__, steps[i].cmd, ret, i + 1,
+				   n);
+			return ret;
+		}
+		if (!steps[i].filter)
+			continue;
+		if (suspend)
+			rx_filter.dropped |= 1 << steps[i].filter;
+		else
+			rx_filter.dropped &= ~(1 << steps[i].filter);
+	}
+	wpa_printf(MSG_DEBUG, "%s: screen %s, %d commands, filters dropped "
+		   "0x%x", __func__, suspend ? "off" : "on", n,
+		   rx_filter.dropped);
+	return 0;
+}
+
+static int wpa_driver_cmd_powermode(struct i802_bss *bss, char *cmd,
+				    char *arg, char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	int state, ret, attempt = 0;
+
+	state = atoi(arg);
+	if (low_latency.holds && low_latency.ifindex == drv->ifindex) {
+		/* applies when the low latency mode ends */
+		low_latency.saved_ps = state;
+		low_latency.saved_paused = (state == WPA_PS_DISABLED);
+		return 0;
+	}
+	if (ps_policy.ifindex == drv->ifindex) {
+		/* an explicit active mode holds until auto again */
+		ps_policy.paused = (state == WPA_PS_DISABLED);
+		ps_policy.active = ps_policy.paused;
+		ps_policy.idle = 0;
+		ps_policy.have_sample = 0;
+	}
+	while ((ret = wpa_driver_set_power_save(bss, state)) < 0 &&
+	       wpa_driver_cmd_retry(ret, attempt++))
+		;
+	if (ret < 0)
+		wpa_driver_cmd_error(drv, ret);
+	else
+		drv_errors = 0;
+	return ret;
+}
+
+static int wpa_driver_cmd_getpower(struct i802_bss *bss, char *cmd,
+				   char *arg, char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	int state = -1, ret, attempt = 0;
+
+	while ((ret = wpa_driver_get_power_save(bss, &state)) < 0 &&
+	       wpa_driver_cmd_retry(ret, attempt++))
+		;
+	if (!ret && (state != -1)) {
+		ret = os_snprintf(buf, buf_len, "POWERMODE = %d\n", state);
+		drv_errors = 0;
+	} else {
+		/* no PS state in the reply means it is not supported */
+		wpa_driver_cmd_error(drv, ret < 0 ? ret : -EOPNOTSUPP);
+	}
+	return ret;
+}
+
+/* same answers as the private commands give, from one cached poll */
+static int wpa_driver_cmd_signal(struct i802_bss *bss, char *cmd, char *arg,
+				 char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	int linkspeed = os_strcasecmp(cmd, "LINKSPEED") == 0;
+	struct wpa_signal_info si;
+	int ret;
+
+	if (wpa_driver_nl80211_signal_poll(bss, &si) != 0)
+		return wpa_driver_private_cmd(bss, cmd, buf, buf_len,
+					      os_strcasecmp(cmd, "RSSI") == 0 ||
+					      linkspeed ? DRV_CMD_RET_LEN : 0);
+
+	if (linkspeed)
+		ret = os_snprintf(buf, buf_len, "LinkSpeed %d\n",
+				  si.current_txrate / 1000);
+	else
+		ret = os_snprintf(buf, buf_len, "%.*s rssi %d\n",
+				  (int)drv->ssid_len, drv->ssid,
+				  si.current_signal);
+	drv_errors = 0;
+	return ret;
+}
+
+static int wpa_driver_cmd_pspolicy(struct i802_bss *bss, char *cmd,
+				   char *arg, char *buf, size_t buf_len)
+{
+	int ret;
+
+	ret = wpa_driver_set_ps_policy(bss->drv, arg);
+	if (ret < 0)
+		wpa_printf(MSG_ERROR, "%s: bad PS policy '%s'", __func__, arg);
+	return ret;
+}
+
+static int wpa_driver_cmd_stats(struct i802_bss *bss, char *cmd, char *arg,
+				char *buf, size_t buf_len)
+{
+	return wpa_driver_stats_report(buf, buf_len);
+}
+
+static int wpa_driver_cmd_stats_reset(struct i802_bss *bss, char *cmd,
+				      char *arg, char *buf, size_t buf_len)
+{
+	os_memset(drv_stats, 0, sizeof(drv_stats));
+	drv_stats_hangs = 0;
+	drv_stats_retries = 0;
+	return 0;
+}
+
+/* "ROAMPARAMS <trigger> <delta> <scan_period> [ch,ch,...]" */
+static int wpa_driver_cmd_roamparams(struct i802_bss *bss, char *cmd,
+				     char *arg, char *buf, size_t buf_len)
+{
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	struct wpa_roam_params rp;
+	char *pos;
+	int n = -1, chan;
+
+	os_memset(&rp, 0, sizeof(rp));
+	if (!drv->associated ||
+	    sscanf(arg, "%d %d %d %n", &rp.trigger, &rp.delta,
+		   &rp.scan_period, &n) != 3)
+		return -1;
+	for (pos = arg + n; n >= 0 && *pos &&
+		     rp.num_channels < ROAM_MAX_CHANNELS;) {
+		chan = strtol(pos, &pos, 10);
+		if (chan > 0 && chan < 256)
+			rp.channels[rp.num_channels++] = chan;
+		if (*pos == ',')
+			pos++;
+		else
+			break;
+	}
+	return wpa_driver_set_roam_params(bss, drv->ssid, drv->ssid_len, &rp);
+}
+
+/* "P2P_STREAM_PROFILE <fps> <max_latency_ms>" or "OFF" */
+static int wpa_driver_cmd_p2p_stream_profile(struct i802_bss *bss, char *cmd,
+					     char *arg, char *buf,
+					     size_t buf_len)
+{
+	int fps = 0, latency = 0;
+
+	if (os_strcasecmp(arg, "OFF") != 0 &&
+	    (sscanf(arg, "%d %d", &fps, &latency) != 2 ||
+	     fps <= 0 || latency < 0))
+		return -1;
+	return wpa_driver_set_p2p_stream_profile(bss, fps, latency);
+}
+
+/* used by the next BGSCAN-START */
+static int wpa_driver_cmd_pnoprofile(struct i802_bss *bss, char *cmd,
+				     char *arg, char *buf, size_t buf_len)
+{
+	int ret;
+
+	ret = wpa_driver_set_pno_profile(arg);
+	if (ret < 0)
+		wpa_printf(MSG_ERROR, "%s: bad PNO profile '%s'", __func__, arg);
+	return ret;
+}
+
+static int wpa_driver_cmd_bgscan_start(struct i802_bss *bss, char *cmd,
+				       char *arg, char *buf, size_t buf_len)
+{
+	int ret;
+
+	ret = wpa_driver_set_backgroundscan_params(bss);
+	if (ret < 0)
+		return ret;
+	pno_started = 1;
+	if (low_latency.holds)
+		return 0;
+	os_memcpy(buf, "PNOFORCE 1", 11);
+	return wpa_driver_private_cmd(bss, buf, buf, buf_len, 0);
+}
+
+static int wpa_driver_cmd_bgscan_stop(struct i802_bss *bss, char *cmd,
+				      char *arg, char *buf, size_t buf_len)
+{
+	pno_started = 0;
+	os_memcpy(buf, "PNOFORCE 0", 11);
+	return wpa_driver_private_cmd(bss, buf, buf, buf_len, 0);
+}
+
+/*
+ * Framework commands handled here, sorted by name as os_strcasecmp()
+ * orders them. Entries without a handler go to the driver as private
+ * commands, as does anything not in the table.
+ */
+static const struct drv_cmd {
+	const char *name;
+	drv_cmd_handler handler;
+	int flags;
+} drv_cmds[] = {
+	{ "BGSCAN-START",	wpa_driver_cmd_bgscan_start,	0 },
+	{ "BGSCAN-STOP",	wpa_driver_cmd_bgscan_stop,	0 },
+	{ "BTCOEXMODE ",	wpa_driver_cmd_btcoexmode,	DRV_CMD_ARGS },
+	{ "BTCOEXPROFILE ",	wpa_driver_cmd_btcoexprofile,	DRV_CMD_ARGS },
+	{ "COUNTRY ",		NULL,		DRV_CMD_ARGS | DRV_CMD_CHANLIST },
+	{ "GETBAND",		NULL,				DRV_CMD_RET_LEN },
+	{ "GETPOWER",		wpa_driver_cmd_getpower,	DRV_CMD_ARGS },
+	{ "LINKSPEED",		wpa_driver_cmd_signal,		0 },
+	{ "LOWLATENCY ",	wpa_driver_cmd_lowlatency,	DRV_CMD_ARGS },
+	{ "MACADDR",		wpa_driver_cmd_macaddr,		0 },
+	{ "P2P_GET_NOA",	NULL,				DRV_CMD_RET_LEN },
+	{ "P2P_STREAM_PROFILE ", wpa_driver_cmd_p2p_stream_profile,
+							DRV_CMD_ARGS },
+	{ "PNOPROFILE ",	wpa_driver_cmd_pnoprofile,	DRV_CMD_ARGS },
+	{ "POWERMODE ",		wpa_driver_cmd_powermode,	DRV_CMD_ARGS },
+	{ "PSPOLICY ",		wpa_driver_cmd_pspolicy,	DRV_CMD_ARGS },
+	{ "RELOAD",		wpa_driver_cmd_reload,		0 },
+	{ "ROAMPARAMS ",	wpa_driver_cmd_roamparams,	DRV_CMD_ARGS },
+	{ "RSSI",		wpa_driver_cmd_signal,		0 },
+	{ "RSSI-APPROX",	wpa_driver_cmd_signal,		0 },
+	{ "RXFILTER-ADD ",	wpa_driver_cmd_rxfilter,	DRV_CMD_ARGS },
+	{ "RXFILTER-REMOVE ",	wpa_driver_cmd_rxfilter,	DRV_CMD_ARGS },
+	{ "SETSUSPENDMODE ",	wpa_driver_cmd_suspendmode,	DRV_CMD_ARGS },
+	{ "START",		wpa_driver_cmd_start,		0 },
+	{ "STATS",		wpa_driver_cmd_stats,		0 },
+	{ "STATS RESET",	wpa_driver_cmd_stats_reset,	0 },
+	{ "STOP",		wpa_driver_cmd_stop,		0 },
+};
+
+/*
+ * Binary search of the command table. No name in it is a prefix of
+ * another argument taking one, so prefix matches keep the order.
+ */
+static const struct drv_cmd *wpa_driver_find_cmd(const char *cmd)
+{
+	int lo = 0, hi = sizeof(drv_cmds) / sizeof(drv_cmds[0]) - 1;
+	int mid, cmp;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (drv_cmds[mid].flags & DRV_CMD_ARGS)
+			cmp = os_strncasecmp(cmd, drv_cmds[mid].name,
+					     os_strlen(drv_cmds[mid].name));
+		else
+			cmp = os_strcasecmp(cmd, drv_cmds[mid].name);
+		if (cmp == 0)
+			return &drv_cmds[mid];
+		if (cmp < 0)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+int wpa_driver_nl80211_driver_cmd(void *priv, char *cmd, char *buf,
+				  size_t buf_len )
+{
+	struct i802_bss *bss = priv;
+	struct wpa_driver_nl80211_data *drv = bss->drv;
+	const struct drv_cmd *dc;
+
+	/* a new association gets the roam settings of its network */
+	if (drv->associated && (roam_applied.ifindex != drv->ifindex ||
+	    os_memcmp(roam_applied.bssid, drv->bssid, ETH_ALEN) != 0))
+		wpa_driver_apply_roam_params(bss);
+
+	dc = wpa_driver_find_cmd(cmd);
+	if (dc == NULL)
+		return wpa_driver_private_cmd(bss, cmd, buf, buf_len, 0);
+	if (dc->handler == NULL)
+		return wpa_driver_private_cmd(bss, cmd, buf, buf_len,
+					      dc->flags);
+	return dc->handler(bss, cmd, cmd + os_strlen(dc->name), buf, buf_len);
+}
+
+int wpa_driver_set_p2p_noa(void *priv, u8 count, int start, int duration)
+{
+	char buf[MAX_DRV_CMD_SIZE];
+
+	memset(buf, 0, sizeof(buf));
+	wpa_printf(MSG_DEBUG, "%s: Entry", __func__);
+	snprintf(buf, sizeof(buf), "P2P_SET_NOA %d %d %d", count, start, duration);
+	return wpa_driver_nl80211_driver_cmd(priv, buf, buf, strlen(buf)+1);
+}
+
+int wpa_driver_get_p2p_noa(void *priv, u8 *buf, size_t len)
+{
+	char cmd[] = "P2P_GET_NOA";
+	char rbuf[MAX_DRV_CMD_SIZE];
+	int ret, hexlen;
+
+	memset(rbuf, 0, sizeof(rbuf));
+	ret = wpa_driver_nl80211_driver_cmd(priv, cmd, rbuf, sizeof(rbuf));
+	if (ret <= 0)
+		return 0;
+
+	/* The driver answers with the NoA attribute as a hex string */
+	for (hexlen = 0; hexlen < ret && isxdigit((unsigned char)rbuf[hexlen]);
+	     hexlen++)
+		;
+	if (hexlen == 0 || hexlen & 1 || (size_t)hexlen / 2 > len ||
+	    hexstr2bin(rbuf, buf, hexlen / 2) < 0) {
+		wpa_printf(MSG_DEBUG, "%s: no NoA in '%s'", __func__, rbuf);
+		return 0;
+	}
+	return hexlen / 2;
+}
+
+int wpa_driver_set_p2p_ps(void *priv, int legacy_ps, int opp_ps, int ctwindow)
+{
+	char buf[MAX_DRV_CMD_SIZE];
+
+	memset(buf, 0, sizeof(buf));
+	wpa_printf(MSG_DEBUG, "%s: Entry", __func__);
+	snprintf(buf, sizeof(buf), "P2P_SET_PS %d %d %d", legacy_ps, opp_ps, ctwindow);
+	return wpa_driver_nl80211_driver_cmd(priv, buf, buf, strlen(buf) + 1);
+}
+
+/**
+ * wpa_driver_set_p2p_stream_profile - Schedule GO power save for streaming
+ * @priv: Pointer to private driver data (struct i802_bss)
+ * @fps: Frame rate of the stream, 0 to go back to no NoA and no opp PS
+ * @max_latency_ms: Delay a frame may pick up from an absence period
+ * Returns: 0 on success, negative on failure
+ *
+ * The GO beacon interval is 100 TU, which no common frame rate divides
+ * exactly, so absences drift across the frames of a Miracast stream.
+ * Each absence is therefore kept shorter than the gap between two frames
+ * and within the latency budget: a frame delays at most that long and
+ * never queues behind another. The CTWindow keeps the GO awake for one
+ * frame period after every TBTT with opportunistic power save.
+ */
+int wpa_driver_set_p2p_stream_profile(void *priv, int fps, int max_latency_ms)
+{
+	int frame_ms, ctwindow, duration, ret;
+
+	if (fps <= 0) {
+		ret = wpa_driver_set_p2p_noa(priv, 0, 0, 0);
+		if (ret >= 0)
+			ret = wpa_driver_set_p2p_ps(priv, -1, 0, 0);
+		return ret;
+	}
+
+	frame_ms = (1000 + fps - 1) / fps;
+	ctwindow = frame_ms < P2P_CTWINDOW_MAX ? frame_ms : P2P_CTWINDOW_MAX;
+	duration = frame_ms - P2P_STREAM_TX_GUARD_MS;
+	if (duration > max_latency_ms)
+		duration = max_latency_ms;
+
+	wpa_printf(MSG_DEBUG, "%s: %d fps, CTWindow %d, absence %d ms",
+		   __func__, fps, ctwindow, duration);
+
+	ret = wpa_driver_set_p2p_ps(priv, -1, 1, ctwindow);
+	if (ret < 0)
+		return ret;
+	if (duration < P2P_NOA_MIN_MS)
+		/* the budget leaves no useful absence, stay present */
+		return wpa_driver_set_p2p_noa(priv, 0, 0, 0);
+	/* continuous absences starting after the CTWindow */
+	return wpa_driver_set_p2p_noa(priv, 255, ctwindow, duration);
+}
+
+int wpa_driver_set_ap_wps_p2p_ie(void *priv, const struct wpabuf *beacon,
+				 const struct wpabuf *proberesp,
 				 const struct wpabuf *assocresp)
 {
+	struct i802_bss *bss = priv;
 	char buf[MAX_WPSP2PIE_CMD_SIZE];
-	struct wpabuf *ap_wps_p2p_ie = NULL;
 	char *_cmd = "SET_AP_WPS_P2P_IE";
-	char *pbuf;
+	int hdr_len = strlen(_cmd) + 3;
+	struct ap_ie_cache *cache;
+	size_t ie_len;
 	int ret = 0;
 	int i;
 	struct cmd_desc {
@@ -333,21 +1885,41 @@ int wpa_driver_set_ap_wps_p2p_ie(void *priv, const struct wpabuf *beacon,
 	};
 
 	wpa_printf(MSG_DEBUG, "%s: Entry", __func__);
+	if (os_strcmp(ap_ie_ifname, bss->ifname) != 0) {
+		wpa_driver_flush_ap_ie_cache();
+		os_strlcpy(ap_ie_ifname, bss->ifname, sizeof(ap_ie_ifname));
+	}
+
 	for (i = 0; cmd_arr[i].cmd != -1; i++) {
-		os_memset(buf, 0, sizeof(buf));
-		pbuf = buf;
-		pbuf += sprintf(pbuf, "%s %d", _cmd, cmd_arr[i].cmd);
-		*pbuf++ = '\0';
-		ap_wps_p2p_ie = cmd_arr[i].src ?
-			wpabuf_dup(cmd_arr[i].src) : NULL;
-		if (ap_wps_p2p_ie) {
-			os_memcpy(pbuf, wpabuf_head(ap_wps_p2p_ie), wpabuf_len(ap_wps_p2p_ie));
-			ret = wpa_driver_nl80211_driver_cmd(priv, buf, buf,
-				strlen(_cmd) + 3 + wpabuf_len(ap_wps_p2p_ie));
-			wpabuf_free(ap_wps_p2p_ie);
-			if (ret < 0)
-				break;
+		if (!cmd_arr[i].src)
+			continue;
+		cache = &ap_ie_cache[i];
+		ie_len = wpabuf_len(cmd_arr[i].src);
+
+		/* the driver already has these IEs for this frame */
+		if (cache->valid && cache->len == ie_len &&
+		    os_memcmp(cache->ie, wpabuf_head(cmd_arr[i].src),
+			      ie_len) == 0)
+			continue;
+
+		if (hdr_len + ie_len > sizeof(buf)) {
+			wpa_printf(MSG_ERROR, "%s: IEs too long (%u)", __func__,
+				   (unsigned int)ie_len);
+			ret = -1;
+			break;
+		}
+		/* "SET_AP_WPS_P2P_IE <type>\0" followed by the IEs */
+		os_snprintf(buf, sizeof(buf), "%s %d", _cmd, cmd_arr[i].cmd);
+		os_memcpy(buf + hdr_len, wpabuf_head(cmd_arr[i].src), ie_len);
+		ret = wpa_driver_nl80211_driver_cmd(priv, buf, buf,
+						    hdr_len + ie_len);
+		if (ret < 0) {
+			cache->valid = 0;
+			break;
 		}
+		os_memcpy(cache->ie, wpabuf_head(cmd_arr[i].src), ie_len);
+		cache->len = ie_len;
+		cache->valid = 1;
 	}
 
 	return ret;
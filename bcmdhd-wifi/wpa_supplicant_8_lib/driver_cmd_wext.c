@@ -28,6 +28,7 @@
 #include "config.h"
 #include "linux_ioctl.h"
 #include "scan.h"
+#include "bss.h"
 
 #include "driver_cmd_wext.h"
 #ifdef ANDROID
@@ -66,19 +67,80 @@ static void wpa_driver_wext_set_scan_timeout(void *priv)
 			       drv->ctx);
 }
 
+static u8 wpa_driver_wext_freq_to_chan(int freq)
+{
+	if (freq == 2484)
+		return 14;
+	if (freq >= 2412 && freq < 2484)
+		return (freq - 2407) / 5;
+	if (freq > 5000 && freq < 5900)
+		return (freq - 5000) / 5;
+	return 0;
+}
+
+/**
+ * wpa_driver_wext_known_chans - Mark channels of known APs for a scan
+ * @wpa_s: Pointer to wpa_supplicant data
+ * @params: Scan parameters
+ * @known: Per channel flags, set for channels with an AP of a scanned SSID
+ * @known_dfs: Set if one of those APs is on a DFS channel
+ * Returns: Number of known APs of the scanned SSIDs in the BSS table
+ */
+static int wpa_driver_wext_known_chans(struct wpa_supplicant *wpa_s,
+				       struct wpa_driver_scan_params *params,
+				       u8 *known, int *known_dfs)
+{
+	struct wpa_bss *bss;
+	unsigned i;
+	int n = 0;
+	u8 chan;
+
+	*known_dfs = 0;
+	dl_list_for_each(bss, &wpa_s->bss, struct wpa_bss, list) {
+		for (i = 0; i < params->num_ssids; i++) {
+			if (params->ssids[i].ssid_len == 0 ||
+			    params->ssids[i].ssid_len != bss->ssid_len ||
+			    os_memcmp(params->ssids[i].ssid, bss->ssid,
+				      bss->ssid_len) != 0)
+				continue;
+			chan = wpa_driver_wext_freq_to_chan(bss->freq);
+			if (chan == 0)
+				break;
+			known[chan] = 1;
+			if (WEXT_CSCAN_IS_DFS(chan))
+				*known_dfs = 1;
+			n++;
+			break;
+		}
+	}
+	return n;
+}
+
 /**
  * wpa_driver_wext_combo_scan - Request the driver to initiate combo scan
  * @priv: Pointer to private wext data from wpa_driver_wext_init()
  * @params: Scan parameters
  * Returns: 0 on success, -1 on failure
+ *
+ * When params->freqs is set only those channels are scanned. If the BSS
+ * table already has APs of the scanned SSIDs, the scan is a reconnect or
+ * roam: DFS channels with none of them are dropped, since they can only
+ * be scanned passively, and if every remaining channel has such an AP a
+ * short active dwell is requested. CSCAN dwell times apply to the whole
+ * scan, not to single channels.
  */
 int wpa_driver_wext_combo_scan(void *priv, struct wpa_driver_scan_params *params)
 {
 	char buf[WEXT_CSCAN_BUF_LEN];
 	struct wpa_driver_wext_data *drv = priv;
+	struct wpa_supplicant *wpa_s = (struct wpa_supplicant *)(drv->ctx);
+	u8 known[256], chans[WEXT_CSCAN_MAX_CHANNELS];
 	struct iwreq iwr;
-	int ret, bp;
+	int ret, bp, known_dfs = 0, reconnect = 0, all_known = 1;
+	int nchans = 0, skipped = 0;
 	unsigned i;
+	int j;
+	u8 chan;
 
 	if (!drv->driver_is_started) {
 		wpa_printf(MSG_DEBUG, "%s: Driver stopped", __func__);
@@ -87,6 +149,33 @@ int wpa_driver_wext_combo_scan(void *priv, struct wpa_driver_scan_params *params
 
 	wpa_printf(MSG_DEBUG, "%s: Start", __func__);
 
+	os_memset(known, 0, sizeof(known));
+	if (params->freqs)
+		reconnect = wpa_driver_wext_known_chans(wpa_s, params, known,
+							&known_dfs) > 0;
+
+	for (i = 0; params->freqs && params->freqs[i] &&
+		    nchans < WEXT_CSCAN_MAX_CHANNELS; i++) {
+		chan = wpa_driver_wext_freq_to_chan(params->freqs[i]);
+		if (chan == 0)
+			continue;
+		for (j = 0; j < nchans && chans[j] != chan; j++)
+			;
+		if (j < nchans)
+			continue;
+		if (reconnect && !known_dfs && !known[chan] &&
+		    WEXT_CSCAN_IS_DFS(chan)) {
+			skipped++;
+			continue;
+		}
+		if (!known[chan])
+			all_known = 0;
+		chans[nchans++] = chan;
+	}
+	if (skipped)
+		wpa_printf(MSG_DEBUG, "%s: skip %d DFS channels", __func__,
+			   skipped);
+
 	/* Set list of SSIDs */
 	bp = WEXT_CSCAN_HEADER_SIZE;
 	os_memcpy(buf, WEXT_CSCAN_HEADER, bp);
@@ -100,9 +189,27 @@ int wpa_driver_wext_combo_scan(void *priv, struct wpa_driver_scan_params *params
 		bp += params->ssids[i].ssid_len;
 	}
 
-	/* Set list of channels */
-	buf[bp++] = WEXT_CSCAN_CHANNEL_SECTION;
-	buf[bp++] = 0;
+	/* Set list of channels, a single 0 means all of them */
+	for (j = 0; j < nchans; j++) {
+		/* leave room for the dwell time sections */
+		if ((bp + 2 + 9) >= (int)sizeof(buf)) {
+			all_known = 0;
+			break;
+		}
+		buf[bp++] = WEXT_CSCAN_CHANNEL_SECTION;
+		buf[bp++] = chans[j];
+	}
+	if (nchans == 0) {
+		buf[bp++] = WEXT_CSCAN_CHANNEL_SECTION;
+		buf[bp++] = 0;
+	}
+
+	/* Short active dwell when we only visit channels of known APs */
+	if (nchans && reconnect && all_known) {
+		buf[bp++] = WEXT_CSCAN_ACTV_DWELL_SECTION;
+		buf[bp++] = (u8)WEXT_CSCAN_ACTV_DWELL_TIME_KNOWN;
+		buf[bp++] = (u8)(WEXT_CSCAN_ACTV_DWELL_TIME_KNOWN >> 8);
+	}
 
 	/* Set passive dwell time (default is 250) */
 	buf[bp++] = WEXT_CSCAN_PASV_DWELL_SECTION;
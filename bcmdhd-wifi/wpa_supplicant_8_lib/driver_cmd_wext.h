@@ -33,5 +33,8 @@
 #define WEXT_CSCAN_PASV_DWELL_TIME_DEF	250
 #define WEXT_CSCAN_PASV_DWELL_TIME_MAX	3000
 #define WEXT_CSCAN_HOME_DWELL_TIME	130
+#define WEXT_CSCAN_ACTV_DWELL_TIME_KNOWN	40
+#define WEXT_CSCAN_MAX_CHANNELS		64
+#define WEXT_CSCAN_IS_DFS(chan)		((chan) >= 52 && (chan) <= 144)
 
 #endif /* DRIVER_CMD_WEXT_H */
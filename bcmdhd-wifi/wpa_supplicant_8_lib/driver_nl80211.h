@@ -190,4 +190,18 @@ struct wpa_driver_nl80211_data {
 	int auth_p2p;
 };
 
+#define ROAM_MAX_CHANNELS 20
+
+/* Firmware roam offload settings for one network, 0 keeps a default */
+struct wpa_roam_params {
+	int trigger;		/* roam below this RSSI, dBm */
+	int delta;		/* candidate must be this much better, dB */
+	int scan_period;	/* seconds between roam scans */
+	int num_channels;	/* 0 to use the channels the network was seen on */
+	u8 channels[ROAM_MAX_CHANNELS];
+};
+
+int wpa_driver_set_roam_params(void *priv, const u8 *ssid, size_t ssid_len,
+			       const struct wpa_roam_params *params);
+
 #endif
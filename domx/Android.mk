@@ -5,6 +5,13 @@ ifneq ($(TARGET_BOARD_PLATFORM),omap3)
     HARDWARE_TI_OMAP4_BASE:= hardware/ti/omap4xxx
     OMAP4_DEBUG_MEMLEAK:= false
 
+    # user builds compile out every trace above warnings
+    ifeq ($(TARGET_BUILD_VARIANT),user)
+        DOMX_TRACE_CFLAGS:= -DTIMM_OSAL_DEBUG_TRACE_LEVEL_MAX=2
+    else
+        DOMX_TRACE_CFLAGS:=
+    endif
+
     BUILD_HEAPTRACKED_SHARED_LIBRARY:=$(BUILD_SHARED_LIBRARY)
     BUILD_HEAPTRACKED_EXECUTABLE:= $(BUILD_EXECUTABLE)
 
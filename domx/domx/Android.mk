@@ -8,6 +8,7 @@ LOCAL_SRC_FILES:= \
     omx_rpc/src/omx_rpc_stub.c \
     omx_rpc/src/omx_rpc_config.c \
     omx_rpc/src/omx_rpc_platform.c \
+    omx_rpc/src/omx_rpc_record.c \
     omx_proxy_common/src/omx_proxy_common.c \
     profiling/src/profile.c \
     plugins/memplugin.c \
@@ -26,6 +27,8 @@ LOCAL_C_INCLUDES += \
     hardware/libhardware/include
 
 LOCAL_CFLAGS += -D_Android -DENABLE_GRALLOC_BUFFERS -DUSE_ENHANCED_PORTRECONFIG -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
+# Add -DRPC_ASYNC_MODE to send ETB/FTB without waiting for the remote reply
 
 
 LOCAL_SHARED_LIBRARIES := \
@@ -12,6 +12,7 @@ LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH)/../../../domx
 
 LOCAL_CFLAGS += -D_Android
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 
 LOCAL_SHARED_LIBRARIES := \
 	libOMX_CoreOsal \
@@ -67,6 +67,7 @@ extern "C"
  ******************************************************************/
 /* ----- system and platform files ----------------------------*/
 #include <OMX_Core.h>
+#include <OMX_TI_Common.h>
 /*-------program files ----------------------------------------*/
 #include "omx_rpc.h"
 #include "omx_rpc_internal.h"
@@ -81,9 +82,19 @@ extern "C"
 #define OMX_VER_MAJOR 0x1
 #define OMX_VER_MINOR 0x1
 
-#define MAX_NUM_PROXY_BUFFERS             100
+/*tBufList is grown on demand a chunk of entries at a time. Chunks never
+  move once allocated, callbacks may be updating entries while the table
+  grows for another port*/
+#define PROXY_BUFLIST_CHUNK_SHIFT         4
+#define PROXY_BUFLIST_CHUNK_ENTRIES       (1 << PROXY_BUFLIST_CHUNK_SHIFT)
+#define PROXY_BUFLIST_MAX_CHUNKS          256
+#define PROXY_BUFLIST_ALIGNMENT           64
 #define MAX_COMPONENT_NAME_LENGTH         128
 #define PROXY_MAXNUMOFPORTS               8
+/*Buffer headers start on this boundary and are padded to a multiple of it */
+#define PROXY_BUFHDR_ALIGNMENT            64
+/*Coding, width, height, bitrate and frame rate of an encoder output port */
+#define PROXY_OUTSIZE_KEY_LEN             5
 
 /******************************************************************
  *   MACROS - ASSERTS
@@ -165,9 +176,25 @@ extern "C"
 	    OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1,
 	    OMX_U32 nData2, OMX_PTR pEventData);
 
+	typedef OMX_ERRORTYPE(*PROXY_FLUSH_DONE) (OMX_HANDLETYPE hComponent,
+	    OMX_U32 nPortIndex, OMX_DIRTYPE eDir, OMX_U32 nCount,
+	    OMX_U32 * pRemoteBufHdrs);
+
 /*******************************************************************************
 * Structures
 *******************************************************************************/
+/*===============================================================*/
+/** PROXY_BUFFER_OWNER       : Who a buffer of the table currently belongs to.
+ *                             Only changed with atomic compare and swap.
+ */
+/*===============================================================*/
+	typedef enum PROXY_BUFFER_OWNER
+	{
+		PROXY_BUFFER_OWNER_NONE = 0,	/* Free table entry */
+		PROXY_BUFFER_OWNER_CLIENT,	/* With the IL client */
+		PROXY_BUFFER_OWNER_REMOTE	/* Between ETB/FTB and EBD/FBD */
+	} PROXY_BUFFER_OWNER;
+
 /*===============================================================*/
 /** PROXY_BUFFER_INFO        : This structure maintains a table of A9 and
  *                             Ducati side buffers and headers.
@@ -178,6 +205,10 @@ extern "C"
  *
  * @param bufferAccessors[]	: This array contains the accessors {handle,reg handle, fd}
  * 							  for Y,UV and metadata buffer in elements [0] [1] [2]
+ *
+ * @param nPortIndex         : Port the buffer was allocated on.
+ *
+ * @param eOwner             : PROXY_BUFFER_OWNER of the buffer.
  */
 /*===============================================================*/
 	typedef struct PROXY_BUFFER_INFO
@@ -185,8 +216,35 @@ extern "C"
 		OMX_BUFFERHEADERTYPE *pBufHeader;
 		OMX_U32 pBufHeaderRemote;
 		MEMPLUGIN_BUFFER_ACCESSOR bufferAccessors[3];
+		OMX_U32 nPortIndex;
+		volatile OMX_U32 eOwner;
 	} PROXY_BUFFER_INFO;
 
+/*===============================================================*/
+/** PROXY_BUFFER_HEADER      : Buffer headers handed out by the proxy are
+ *                             allocated as this structure, from the
+ *                             hBufHdrArena of their port. Headers of a port
+ *                             sit next to each other on cache line
+ *                             boundaries.
+ *
+ * @param tHeader            : The OMX buffer header seen by the client.
+ *
+ * @param nBufListIndex      : Index of this header in tBufList, lets ETB/FTB
+ *                             and FreeBuffer find their entry without a
+ *                             search.
+ *
+ * @param tPlatformPrivate   : What tHeader.pPlatformPrivate points to, which
+ *                             is also how a header is recognized as one of
+ *                             these before nBufListIndex is read.
+ */
+/*===============================================================*/
+	typedef struct PROXY_BUFFER_HEADER
+	{
+		OMX_BUFFERHEADERTYPE tHeader;
+		OMX_U32 nBufListIndex;
+		OMX_TI_PLATFORMPRIVATE tPlatformPrivate;
+	} PROXY_BUFFER_HEADER;
+
 /*===============================================================*/
 /** PROXY_BUFFER_TYPE        : This enumeration tells the type of buffer pointers coming to OMX in 
 				UseBuffer call.
@@ -204,14 +262,61 @@ extern "C"
 /*===============================================================*/
 /** PROXY_BUFFER_TYPE        : This enumeration tells the type of buffer pointers coming to OMX in
                                UseBuffer call.
+ *
+ * @param tPortDef           : Last port definition read from the remote
+ *                             component, see PROXY_GetCachedPortDefinition.
+ * @param bPortDefValid      : tPortDef was read in the current nPortDefEpoch
+ *                             of the component.
+ * @param bTunneled          : The port is tunneled to another component on
+ *                             the remote core, which then owns its buffers.
+ * @param nRemoteBuffers     : Buffers of the port the remote component
+ *                             currently holds.
+ * @param bOutSizeTrack      : Encoded frame sizes of this compressed video
+ *                             output port are recorded, see
+ *                             PROXY_OutSizeStart.
+ * @param nOutSizeKey        : Coding, frame size, bitrate and frame rate the
+ *                             recorded sizes belong to.
+ * @param nOutSizePeak       : Largest frame of the current session.
+ * @param nOutSizeFrames     : Frames seen in the current session.
+ * @param bOutSizeOverflow   : A frame came close to filling its buffer.
+ * @param bPartialFrames     : The remote component returns each frame in
+ *                             bands, see PROXY_IS_PARTIAL_FBD.
+ * @param nLoad              : Macroblocks per second the port adds to the
+ *                             workload hint, see PROXY_LoadSet.
+ * @param nLoadFrames        : FillThisBuffers in the current window.
+ * @param nLoadWindowStart   : ms the current window started at.
+ * @param nAdmitMbs          : Macroblocks per second the port definition
+ *                             asks for, see PROXY_AdmitUpdate.
  */
 /*===============================================================*/
 	typedef struct PROXY_PORT_TYPE
 	{
 		PROXY_BUFFER_TYPE proxyBufferType;   /*Used when buffer pointers come from the normal A9 virtual space */
 		OMX_U32 IsBuffer2D;   /*Used when buffer pointers come from Gralloc allocations */
+		OMX_PARAM_PORTDEFINITIONTYPE tPortDef;
+		OMX_BOOL bPortDefValid;
+		OMX_U32 nPortDefEpoch;
+		OMX_BOOL bTunneled;
+		volatile OMX_U32 nRemoteBuffers;
+		OMX_BOOL bOutSizeTrack;
+		OMX_U32 nOutSizeKey[PROXY_OUTSIZE_KEY_LEN];
+		OMX_U32 nOutSizePeak;
+		OMX_U32 nOutSizeFrames;
+		OMX_BOOL bOutSizeOverflow;
+		OMX_BOOL bPartialFrames;
+		OMX_U32 nLoad;
+		OMX_U32 nLoadFrames;
+		OMX_U32 nLoadWindowStart;
+		OMX_U32 nAdmitMbs;
 	} PROXY_PORT_TYPE;
 
+/*A FillBufferDone that only reports a band of a frame still being produced.
+  The buffer stays with the remote component, the client is told through
+  OMX_TI_EventPartialFrame. Flushed buffers come back empty and are done */
+#define PROXY_IS_PARTIAL_FBD(pPort, nFlags, nFilledLen) \
+	((pPort)->bPartialFrames && (nFilledLen) != 0 && \
+	 !((nFlags) & (OMX_BUFFERFLAG_ENDOFFRAME | OMX_BUFFERFLAG_EOS)))
+
 #ifdef ENABLE_RAW_BUFFERS_DUMP_UTILITY
 /*===============================================================*/
 /** DebugFrame_Dump     : Structure holding the info about frames to dump
@@ -223,6 +328,7 @@ extern "C"
  *  @param padded_height: Height of the buffer
  *  @param stride: Stride of the Buffer
  *  @param runningFrame: running counter to track the frames
+ *  @param hWriter: background thread writing the dumped frames out
  */
 /*===============================================================*/
 	typedef struct DebugFrame_Dump
@@ -237,6 +343,7 @@ extern "C"
 		OMX_U32 stride;
 		OMX_S32 runningFrame;
 		OMX_U32 *y_uv[2];
+		OMX_PTR hWriter;
 	}DebugFrame_Dump;
 #endif
 
@@ -245,6 +352,46 @@ extern "C"
 * struct PROXY_COMPONENT_PRIVATE
 *		@param nMemmgr_client_desc: Memory manager client descriptor
 * 		@param bMapBuffers: buffers need to be mapped or not
+* 		@param tBufList: chunks of the buffer table, nBufListSize entries,
+* 		                 grown when a port needs more buffers than there
+* 		                 are free entries. Use PROXY_BUFLIST_ENTRY
+* 		@param pBufListBlock: hash of pBufHeaderRemote to tBufList index
+* 		@param nPortDefEpoch: bumped whenever cached port definitions may
+* 		                      have gone stale
+* 		@param pKpiMonitor: KPI counters and latency traces of the
+* 		                    component, owned by domx/profiling
+* 		@param hBufHdrArena: arenas of PROXY_BUFFER_HEADER, one per port,
+* 		                     whatever is left in them goes in one go on
+* 		                     deinit
+* 		@param pParamCache: GetParameter and version answers served
+* 		                    locally, private to omx_proxy_common.c
+* 		@param pConfigQueue: SetConfig calls held back until the next
+* 		                     EmptyThisBuffer, see PROXY_EnableConfigQueue
+* 		@param pRecovery: settings replayed on a new remote instance
+* 		                  after the remote core died, private to
+* 		                  omx_proxy_common.c
+* 		@param eState: state of the last transition the remote component
+* 		               completed, GetState is answered from it
+* 		@param nStatePending: StateSet commands sent but not completed
+* 		@param nStateEpoch: bumped on every completed StateSet
+* 		@param bStateKnown: cleared on OMX_EventError as the remote side
+* 		                    may have changed state on its own
+* 		@param tStatusPage: page shared with the remote component, see
+* 		                    OMX_TI_IndexParamStatusPage
+* 		@param pStatusPage: mapping of tStatusPage, NULL when the remote
+* 		                    component does not publish its status
+* 		@param bMapOnceProbed: OMX_TI_IndexParamBufferMapOnce was offered
+* 		                       to the remote instance, the answer is in
+* 		                       its RPC context
+* 		@param bFlushDoneProbed: OMX_TI_IndexParamBulkFlushDone was
+* 		                         offered to the remote instance
+* 		@param tStructScratch: buffer oversized param/config structures
+* 		                       are passed in, see
+* 		                       OMX_TI_IndexParamStructScratch
+* 		@param bLoadHintRefused: the remote instance does not take
+* 		                         OMX_TI_IndexConfigWorkloadHint
+* 		@param nAdmitted: share of the codec budget the instance holds
+* 		@param bAdmitHighProfile: AVC high profile was set, costs more
 */
 /* ========================================================================== */
 	typedef struct PROXY_COMPONENT_PRIVATE
@@ -254,8 +401,11 @@ extern "C"
 		OMX_PTR pILAppData;
 		OMX_HANDLETYPE hRemoteComp;
 
-		PROXY_BUFFER_INFO tBufList[MAX_NUM_PROXY_BUFFERS];
+		PROXY_BUFFER_INFO *tBufList[PROXY_BUFLIST_MAX_CHUNKS];
+		OMX_U32 nBufListSize;
+		OMX_PTR pBufListBlock;
 		PROXY_PORT_TYPE proxyPortBuffers[PROXY_MAXNUMOFPORTS];
+		OMX_U32 nPortDefEpoch;
 		OMX_BOOL IsLoadedState;
 		OMX_U32 nTotalBuffers;
 		OMX_U32 nAllocatedBuffers;
@@ -267,6 +417,7 @@ extern "C"
 		PROXY_EMPTYBUFFER_DONE proxyEmptyBufferDone;
 		PROXY_FILLBUFFER_DONE proxyFillBufferDone;
 		PROXY_EVENTHANDLER proxyEventHandler;
+		PROXY_FLUSH_DONE proxyFlushDone;
 
 #ifdef ANDROID_QUIRK_LOCK_BUFFER
 		gralloc_module_t const *grallocModule;
@@ -278,8 +429,30 @@ extern "C"
 		DebugFrame_Dump debugframeInfo;
 #endif
 		int secure_misc_drv_fd;
+		OMX_PTR pKpiMonitor;
+		OMX_PTR hBufHdrArena[PROXY_MAXNUMOFPORTS];
+		OMX_PTR pParamCache;
+		OMX_PTR pConfigQueue;
+		OMX_PTR pRecovery;
+		volatile OMX_STATETYPE eState;
+		volatile OMX_U32 nStatePending;
+		volatile OMX_U32 nStateEpoch;
+		volatile OMX_BOOL bStateKnown;
+		MEMPLUGIN_BUFFER_ACCESSOR tStatusPage;
+		volatile OMX_TI_STATUSPAGE *pStatusPage;
+		OMX_BOOL bMapOnceProbed;
+		OMX_BOOL bFlushDoneProbed;
+		MEMPLUGIN_BUFFER_ACCESSOR tStructScratch;
+		OMX_BOOL bLoadHintRefused;
+		OMX_U32 nAdmitted;
+		OMX_BOOL bAdmitHighProfile;
 	} PROXY_COMPONENT_PRIVATE;
 
+/*Entry nIndex of the buffer table, see PROXY_BUFLIST_CHUNK_SHIFT */
+#define PROXY_BUFLIST_ENTRY(pCompPrv, nIndex) \
+	((pCompPrv)->tBufList[(nIndex) >> PROXY_BUFLIST_CHUNK_SHIFT] \
+	 [(nIndex) & (PROXY_BUFLIST_CHUNK_ENTRIES - 1)])
+
 
 
 /*===============================================================*/
@@ -307,6 +480,12 @@ extern "C"
 	    OMX_IN OMX_INDEXTYPE nParamIndex, OMX_INOUT OMX_PTR pParamStruct);
 	OMX_ERRORTYPE PROXY_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	    OMX_IN OMX_INDEXTYPE nParamIndex, OMX_INOUT OMX_PTR pParamStruct);
+	OMX_ERRORTYPE PROXY_GetCachedPortDefinition(OMX_IN OMX_HANDLETYPE
+	    hComponent, OMX_INOUT OMX_PARAM_PORTDEFINITIONTYPE * pPortDef);
+	OMX_ERRORTYPE PROXY_GetConfig(OMX_HANDLETYPE hComponent,
+	    OMX_INDEXTYPE nConfigIndex, OMX_PTR pConfigStruct);
+	OMX_ERRORTYPE PROXY_SetConfig(OMX_IN OMX_HANDLETYPE hComponent,
+	    OMX_IN OMX_INDEXTYPE nConfigIndex, OMX_IN OMX_PTR pConfigStruct);
 	OMX_ERRORTYPE PROXY_EventHandler(OMX_HANDLETYPE hComponent,
 	    OMX_PTR pAppData, OMX_EVENTTYPE eEvent, OMX_U32 nData1, OMX_U32 nData2,
 	    OMX_PTR pEventData);
@@ -329,6 +508,11 @@ extern "C"
 	OMX_ERRORTYPE PROXY_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	    OMX_IN OMX_U32 nPortIndex, OMX_IN OMX_BUFFERHEADERTYPE * pBufferHdr);
 	OMX_ERRORTYPE PROXY_ComponentDeInit(OMX_HANDLETYPE hComponent);
+	OMX_ERRORTYPE PROXY_EnableConfigQueue(OMX_HANDLETYPE hComponent);
+	OMX_U32 PROXY_FindBufferByRemote(PROXY_COMPONENT_PRIVATE * pCompPrv,
+	    OMX_U32 pBufHeaderRemote);
+	OMX_U32 PROXY_FindBufferByLocal(PROXY_COMPONENT_PRIVATE * pCompPrv,
+	    OMX_BUFFERHEADERTYPE * pBufHeader);
 
 
 #ifdef __cplusplus
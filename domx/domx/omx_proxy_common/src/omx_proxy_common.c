@@ -58,6 +58,8 @@
  ******************************************************************/
 /* ----- system and platform files ----------------------------*/
 #include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
 
 #include "timm_osal_memory.h"
 #include "timm_osal_mutex.h"
@@ -75,6 +77,11 @@
 #ifdef ALLOCATE_TILER_BUFFER_IN_PROXY
 #ifdef USE_ION
 #include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#ifdef _Android
+#include <cutils/properties.h>
+#endif
 #include <ion_ti/ion.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -133,6 +140,7 @@ RPC_OMX_ERRORTYPE RPC_RegisterBuffer(OMX_HANDLETYPE hRPCCtx, int fd1, int fd2,
 	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
 	int status;
 	RPC_OMX_CONTEXT *pRPCCtx = (RPC_OMX_CONTEXT *) hRPCCtx;
+	OMX_BOOL bRegistered = OMX_FALSE;
 
 	if ((fd1 < 0) || (handle1 ==  NULL) ||
 	    (((proxyBufferType == GrallocPointers) || (proxyBufferType == BufferDescriptorVirtual2D)) && (handle2 ==  NULL))) {
@@ -181,6 +189,7 @@ RPC_OMX_ERRORTYPE RPC_RegisterBuffer(OMX_HANDLETYPE hRPCCtx, int fd1, int fd2,
 	     eRPCError = RPC_OMX_ErrorBadParameter;
 	     goto EXIT;
 	}
+	bRegistered = OMX_TRUE;
     }
     else if(proxyBufferType == GrallocPointers)
     {
@@ -224,6 +233,7 @@ RPC_OMX_ERRORTYPE RPC_RegisterBuffer(OMX_HANDLETYPE hRPCCtx, int fd1, int fd2,
 			DOMX_DEBUG("Gralloc buffer has only one component");
 			*handle2 = NULL;
 		}
+		bRegistered = OMX_TRUE;
 #else
  DOMX_ERROR("No Registerbuffer implementation for gralloc - macro mess up!");
 #endif
@@ -247,6 +257,7 @@ RPC_OMX_ERRORTYPE RPC_RegisterBuffer(OMX_HANDLETYPE hRPCCtx, int fd1, int fd2,
 			eRPCError = RPC_OMX_ErrorBadParameter;
 			goto EXIT;
 		}
+		bRegistered = OMX_TRUE;
     }
     else
     {
@@ -256,6 +267,12 @@ RPC_OMX_ERRORTYPE RPC_RegisterBuffer(OMX_HANDLETYPE hRPCCtx, int fd1, int fd2,
 		 goto EXIT;
      }
 EXIT:
+	/*The driver hands back the same handles for a buffer registered earlier
+	on this context - the cache keeps one reference and the remote mapping */
+	if (bRegistered)
+		RPC_RegCacheAdd(pRPCCtx, proxyBufferType, *handle1,
+		    (proxyBufferType == BufferDescriptorVirtual2D ||
+			proxyBufferType == GrallocPointers) ? *handle2 : NULL);
 	return eRPCError;
 }
 
@@ -272,6 +289,10 @@ RPC_OMX_ERRORTYPE RPC_UnRegisterBuffer(OMX_HANDLETYPE hRPCCtx, OMX_PTR handle1,
 		eRPCError = RPC_OMX_ErrorBadParameter;
 		goto EXIT;
 	}
+
+	/*Cached registrations stay with the context until evicted */
+	if (RPC_RegCacheRelease(pRPCCtx, handle1))
+		goto EXIT;
     if(proxyBufferType == BufferDescriptorVirtual2D || proxyBufferType == GrallocPointers)
     {
 		data.handle = handle1;
@@ -317,6 +338,1950 @@ RPC_OMX_ERRORTYPE RPC_UnRegisterBuffer(OMX_HANDLETYPE hRPCCtx, OMX_PTR handle1,
 }
 #endif
 
+/*PROXY_MARK_DATA of every proxy instance. A mark may come back through
+  another component than the one that sent it, so the arena is shared. It
+  grows to the most marks ever in flight, which the buffer count bounds, and
+  is reused from then on*/
+static TIMM_OSAL_PTR hMarkDataArena = NULL;
+static pthread_once_t tMarkDataOnce = PTHREAD_ONCE_INIT;
+
+static void PROXY_MarkDataInit(void)
+{
+	if (TIMM_OSAL_CreateArena(&hMarkDataArena, sizeof(PROXY_MARK_DATA),
+		0) != TIMM_OSAL_ERR_NONE)
+		hMarkDataArena = NULL;
+}
+
+static PROXY_MARK_DATA *PROXY_MarkDataAlloc(void)
+{
+	pthread_once(&tMarkDataOnce, PROXY_MarkDataInit);
+	if (hMarkDataArena == NULL)
+		return NULL;
+	return (PROXY_MARK_DATA *) TIMM_OSAL_ArenaAlloc(hMarkDataArena);
+}
+
+static void PROXY_MarkDataFree(OMX_PTR pMarkData)
+{
+	if (pMarkData != NULL)
+		TIMM_OSAL_ArenaFree(hMarkDataArena, pMarkData);
+}
+
+/*The remote header hash of a proxy, sized for nBufListSize entries and
+  replaced when tBufList grows. Replaced blocks stay allocated until the
+  component is deinitialized as the callback thread may still be looking at
+  them, the indices they hold stay valid as tBufList entries never move*/
+typedef struct PROXY_BUFLIST_BLOCK
+{
+	struct PROXY_BUFLIST_BLOCK *pRetired;
+	OMX_U16 *pRemoteHash;
+	OMX_U32 nHashBits;
+} PROXY_BUFLIST_BLOCK;
+
+/*Arena the headers of a port come from, ports past PROXY_MAXNUMOFPORTS share
+  the last one*/
+#define PROXY_BufHdrArena(pCompPrv, nPort) \
+    ((pCompPrv)->hBufHdrArena[(nPort) < PROXY_MAXNUMOFPORTS ? (nPort) : \
+    PROXY_MAXNUMOFPORTS - 1])
+
+/*Home bucket of a remote header. Remote headers are word aligned so the low
+  bits carry no information*/
+#define PROXY_REMOTE_HASH(pBlock, pBufHeaderRemote) \
+    (((((OMX_U32)(pBufHeaderRemote)) >> 2) * 2654435761U) >> \
+    (32 - (pBlock)->nHashBits))
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_RemoteHashInsert()
+ * @brief Adds tBufList[nIndex] to the remote header hash of pBlock. Called
+ *        once the remote header of a new buffer is known.
+ * @param pCompPrv : Proxy component private
+ * @param pBlock   : Remote header hash
+ * @param nIndex   : Index of the buffer in tBufList
+ * @return none
+ */
+/* ===========================================================================*/
+static void PROXY_RemoteHashInsert(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    PROXY_BUFLIST_BLOCK * pBlock, OMX_U32 nIndex)
+{
+	OMX_U32 nMask = (1 << pBlock->nHashBits) - 1;
+	OMX_U32 nBucket = PROXY_REMOTE_HASH(pBlock,
+	    PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).pBufHeaderRemote);
+
+	while (pBlock->pRemoteHash[nBucket] != 0)
+		nBucket = (nBucket + 1) & nMask;
+	pBlock->pRemoteHash[nBucket] = (OMX_U16) (nIndex + 1);
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_RemoteHashRemove()
+ * @brief Removes tBufList[nIndex] from the remote header hash. Entries after
+ *        it in the probe sequence are shifted back so that no tombstones are
+ *        needed.
+ * @param pCompPrv : Proxy component private
+ * @param nIndex   : Index of the buffer in tBufList
+ * @return none
+ */
+/* ===========================================================================*/
+static void PROXY_RemoteHashRemove(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_U32 nIndex)
+{
+	PROXY_BUFLIST_BLOCK *pBlock =
+	    (PROXY_BUFLIST_BLOCK *) pCompPrv->pBufListBlock;
+	OMX_U32 nMask = 0, nHole = 0, nNext = 0, nHome = 0;
+
+	if (pBlock == NULL)
+		return;
+	nMask = (1 << pBlock->nHashBits) - 1;
+	nHole = PROXY_REMOTE_HASH(pBlock,
+	    PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).pBufHeaderRemote);
+
+	while (pBlock->pRemoteHash[nHole] != (OMX_U16) (nIndex + 1))
+	{
+		if (pBlock->pRemoteHash[nHole] == 0)
+			return;
+		nHole = (nHole + 1) & nMask;
+	}
+
+	nNext = nHole;
+	while (1)
+	{
+		nNext = (nNext + 1) & nMask;
+		if (pBlock->pRemoteHash[nNext] == 0)
+			break;
+		nHome = PROXY_REMOTE_HASH(pBlock,
+		    PROXY_BUFLIST_ENTRY(pCompPrv,
+			pBlock->pRemoteHash[nNext] - 1).pBufHeaderRemote);
+		/*Leave the entry alone if its home is cyclically in (nHole, nNext] */
+		if ((nHole <= nNext) ? (nHole < nHome && nHome <= nNext) :
+		    (nHole < nHome || nHome <= nNext))
+			continue;
+		pBlock->pRemoteHash[nHole] = pBlock->pRemoteHash[nNext];
+		nHole = nNext;
+	}
+	pBlock->pRemoteHash[nHole] = 0;
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_GrowBufList()
+ * @brief Makes sure tBufList has an entry nIndex. Chunks are added for all
+ *        buffers of the port, at least doubling the table, and the remote
+ *        header hash is rebuilt for the new size. Existing chunks are left
+ *        where they are, callbacks may be updating their entries meanwhile.
+ * @param hComponent : Proxy handle
+ * @param nPortIndex : Port the new buffer belongs to
+ * @param nIndex     : Index of the entry the buffer will use
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE PROXY_GrowBufList(OMX_HANDLETYPE hComponent,
+    OMX_U32 nPortIndex, OMX_U32 nIndex)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	PROXY_COMPONENT_PRIVATE *pCompPrv =
+	    (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+	PROXY_BUFLIST_BLOCK *pOldBlock =
+	    (PROXY_BUFLIST_BLOCK *) pCompPrv->pBufListBlock;
+	PROXY_BUFLIST_BLOCK *pBlock = NULL;
+	OMX_PARAM_PORTDEFINITIONTYPE tParamPortDef;
+	OMX_U32 nNewSize = 0, nHashBits = 0, nChunk = 0, i = 0;
+	OMX_U8 *pAlloc = NULL;
+
+	if (nIndex < pCompPrv->nBufListSize)
+		goto EXIT;
+
+	nNewSize = pCompPrv->nBufListSize * 2;
+
+	/*Make room for every buffer of the port in one step, if the query fails
+	  doubling is still enough to make progress*/
+	tParamPortDef.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+	tParamPortDef.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+	tParamPortDef.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+	tParamPortDef.nVersion.s.nRevision = 0x0;
+	tParamPortDef.nVersion.s.nStep = 0x0;
+	tParamPortDef.nPortIndex = nPortIndex;
+	if (PROXY_GetParameter(hComponent, OMX_IndexParamPortDefinition,
+		&tParamPortDef) == OMX_ErrorNone &&
+	    nNewSize < nIndex + tParamPortDef.nBufferCountActual)
+	{
+		nNewSize = nIndex + tParamPortDef.nBufferCountActual;
+	}
+	if (nNewSize <= nIndex)
+		nNewSize = nIndex + 1;
+	nNewSize = (nNewSize + PROXY_BUFLIST_CHUNK_ENTRIES - 1) &
+	    ~(PROXY_BUFLIST_CHUNK_ENTRIES - 1);
+	PROXY_assert(nNewSize <=
+	    PROXY_BUFLIST_MAX_CHUNKS * PROXY_BUFLIST_CHUNK_ENTRIES,
+	    OMX_ErrorInsufficientResources,
+	    "Too many buffers for the proxy buffer table");
+
+	/*TIMM_OSAL_Malloc does not guarantee alignment, over allocate and place
+	  the entries on a cache line boundary ourselves. The allocation itself
+	  is kept in front of the entries. Chunks left over from an earlier grow
+	  that failed half way are reused*/
+	for (nChunk = pCompPrv->nBufListSize >> PROXY_BUFLIST_CHUNK_SHIFT;
+	    nChunk < (nNewSize >> PROXY_BUFLIST_CHUNK_SHIFT); nChunk++)
+	{
+		if (pCompPrv->tBufList[nChunk] != NULL)
+			continue;
+		pAlloc = (OMX_U8 *) TIMM_OSAL_Malloc(PROXY_BUFLIST_ALIGNMENT +
+		    sizeof(OMX_PTR) +
+		    PROXY_BUFLIST_CHUNK_ENTRIES * sizeof(PROXY_BUFFER_INFO),
+		    TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT);
+		PROXY_assert(pAlloc != NULL, OMX_ErrorInsufficientResources,
+		    "Allocation of buffer table chunk failed");
+		pCompPrv->tBufList[nChunk] = (PROXY_BUFFER_INFO *)
+		    (((OMX_U32) pAlloc + sizeof(OMX_PTR) +
+			PROXY_BUFLIST_ALIGNMENT - 1) &
+		    ~(PROXY_BUFLIST_ALIGNMENT - 1));
+		((OMX_PTR *) pCompPrv->tBufList[nChunk])[-1] = pAlloc;
+		TIMM_OSAL_Memset(pCompPrv->tBufList[nChunk], 0,
+		    PROXY_BUFLIST_CHUNK_ENTRIES * sizeof(PROXY_BUFFER_INFO));
+	}
+
+	/*Keep the hash at most half full*/
+	nHashBits = 1;
+	while ((1U << nHashBits) < nNewSize * 2)
+		nHashBits++;
+
+	pBlock =
+	    (PROXY_BUFLIST_BLOCK *)
+	    TIMM_OSAL_Malloc(sizeof(PROXY_BUFLIST_BLOCK) +
+	    (1 << nHashBits) * sizeof(OMX_U16), TIMM_OSAL_TRUE, 0,
+	    TIMMOSAL_MEM_SEGMENT_INT);
+	PROXY_assert(pBlock != NULL, OMX_ErrorInsufficientResources,
+	    "Allocation of buffer table hash failed");
+
+	pBlock->pRetired = pOldBlock;
+	pBlock->pRemoteHash = (OMX_U16 *) (pBlock + 1);
+	pBlock->nHashBits = nHashBits;
+	TIMM_OSAL_Memset(pBlock->pRemoteHash, 0,
+	    (1 << nHashBits) * sizeof(OMX_U16));
+
+	for (i = 0; i < pCompPrv->nBufListSize; i++)
+	{
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, i).pBufHeader)
+			PROXY_RemoteHashInsert(pCompPrv, pBlock, i);
+	}
+
+	/*The callback thread may be looking buffers up concurrently. The new
+	  chunks are in place before the hash that can point into them*/
+	__sync_synchronize();
+	pCompPrv->pBufListBlock = pBlock;
+	pCompPrv->nBufListSize = nNewSize;
+
+	DOMX_DEBUG("Buffer table grown to %d entries", nNewSize);
+
+      EXIT:
+	return eError;
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_FreeBufList()
+ * @brief Frees the chunks of tBufList along with every hash replaced.
+ * @param pCompPrv : Proxy component private
+ * @return none
+ */
+/* ===========================================================================*/
+static void PROXY_FreeBufList(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	PROXY_BUFLIST_BLOCK *pBlock =
+	    (PROXY_BUFLIST_BLOCK *) pCompPrv->pBufListBlock;
+	PROXY_BUFLIST_BLOCK *pRetired = NULL;
+	OMX_U32 nChunk = 0;
+
+	while (pBlock != NULL)
+	{
+		pRetired = pBlock->pRetired;
+		TIMM_OSAL_Free(pBlock);
+		pBlock = pRetired;
+	}
+	for (nChunk = 0; nChunk < PROXY_BUFLIST_MAX_CHUNKS; nChunk++)
+	{
+		if (pCompPrv->tBufList[nChunk] == NULL)
+			continue;
+		TIMM_OSAL_Free(((OMX_PTR *) pCompPrv->tBufList[nChunk])[-1]);
+		pCompPrv->tBufList[nChunk] = NULL;
+	}
+	pCompPrv->pBufListBlock = NULL;
+	pCompPrv->nBufListSize = 0;
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_FindBufferByRemote()
+ * @brief Finds the tBufList entry of a remote buffer header.
+ * @param pCompPrv         : Proxy component private
+ * @param pBufHeaderRemote : Remote buffer header
+ * @return Index in tBufList, nTotalBuffers if the header is not known
+ */
+/* ===========================================================================*/
+OMX_U32 PROXY_FindBufferByRemote(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_U32 pBufHeaderRemote)
+{
+	PROXY_BUFLIST_BLOCK *pBlock =
+	    (PROXY_BUFLIST_BLOCK *) pCompPrv->pBufListBlock;
+	OMX_U32 nMask = 0, nBucket = 0, nIndex = 0;
+
+	if (pBlock == NULL)
+		return pCompPrv->nTotalBuffers;
+	nMask = (1 << pBlock->nHashBits) - 1;
+	nBucket = PROXY_REMOTE_HASH(pBlock, pBufHeaderRemote);
+
+	while (pBlock->pRemoteHash[nBucket] != 0)
+	{
+		nIndex = pBlock->pRemoteHash[nBucket] - 1;
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).pBufHeaderRemote ==
+		    pBufHeaderRemote &&
+		    PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).pBufHeader)
+			return nIndex;
+		nBucket = (nBucket + 1) & nMask;
+	}
+	return pCompPrv->nTotalBuffers;
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_FindBufferByLocal()
+ * @brief Finds the tBufList entry of a buffer header handed out by the proxy.
+ *        The index is kept next to the header, the list is only searched for
+ *        headers the proxy does not know. Whether the header is one of ours
+ *        is told from pPlatformPrivate, which the proxy points at the
+ *        tPlatformPrivate following it, before anything past the
+ *        OMX_BUFFERHEADERTYPE is read.
+ * @param pCompPrv   : Proxy component private
+ * @param pBufHeader : Local buffer header
+ * @return Index in tBufList, nTotalBuffers if the header is not known
+ */
+/* ===========================================================================*/
+OMX_U32 PROXY_FindBufferByLocal(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_BUFFERHEADERTYPE * pBufHeader)
+{
+	PROXY_BUFFER_HEADER *pProxyHeader = (PROXY_BUFFER_HEADER *) pBufHeader;
+	OMX_U32 nIndex = 0;
+
+	if (pBufHeader->pPlatformPrivate == &pProxyHeader->tPlatformPrivate)
+	{
+		nIndex = pProxyHeader->nBufListIndex;
+		if (nIndex < pCompPrv->nTotalBuffers &&
+		    PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).pBufHeader == pBufHeader)
+			return nIndex;
+	}
+
+	for (nIndex = 0; nIndex < pCompPrv->nTotalBuffers; nIndex++)
+	{
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).pBufHeader == pBufHeader)
+			break;
+	}
+	return nIndex;
+}
+
+/*Drops every cached port definition of the component, see
+  PROXY_GetCachedPortDefinition */
+static void PROXY_InvalidatePortDefinitions(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	__sync_fetch_and_add(&pCompPrv->nPortDefEpoch, 1);
+}
+
+/*Hands buffer nIndex from eFrom to eTo. Fails when the buffer is not owned
+  by eFrom, e.g. a second ETB of a buffer already at the remote side or a
+  done callback for a buffer that was never sent */
+static OMX_BOOL PROXY_BufferSetOwner(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_U32 nIndex, PROXY_BUFFER_OWNER eFrom, PROXY_BUFFER_OWNER eTo)
+{
+	OMX_U32 nPort = PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).nPortIndex;
+
+	if (!__sync_bool_compare_and_swap(
+		&PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).eOwner, eFrom, eTo))
+		return OMX_FALSE;
+
+	if (nPort < PROXY_MAXNUMOFPORTS)
+	{
+		if (eTo == PROXY_BUFFER_OWNER_REMOTE)
+			__sync_fetch_and_add(&pCompPrv->proxyPortBuffers[nPort].
+			    nRemoteBuffers, 1);
+		else if (eFrom == PROXY_BUFFER_OWNER_REMOTE)
+			__sync_fetch_and_sub(&pCompPrv->proxyPortBuffers[nPort].
+			    nRemoteBuffers, 1);
+	}
+	return OMX_TRUE;
+}
+
+/*Logs the buffers of nPort (or all ports for OMX_ALL) that the remote
+  component still holds. Called once it reported a flush, port disable or
+  state change done, when all of them should have come back */
+static void PROXY_ReportRemoteBuffers(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_U32 nPort)
+{
+	PROXY_BUFFER_INFO *pInfo = NULL;
+	OMX_U32 i = 0;
+
+	for (i = 0; i < pCompPrv->nTotalBuffers; i++)
+	{
+		pInfo = &PROXY_BUFLIST_ENTRY(pCompPrv, i);
+		if (pInfo->eOwner != PROXY_BUFFER_OWNER_REMOTE ||
+		    (nPort != OMX_ALL && pInfo->nPortIndex != nPort))
+			continue;
+		DOMX_WARN("%s: buffer %p (remote 0x%x) of port %d still held "
+		    "by the remote component", pCompPrv->cCompName,
+		    pInfo->pBufHeader, pInfo->pBufHeaderRemote,
+		    pInfo->nPortIndex);
+	}
+}
+
+/*GetParameter answers the proxy may serve itself, see tProxyParamCachePolicy */
+#define PROXY_PARAM_CACHE_ENTRIES 32
+#define PROXY_PARAM_CACHE_MAX_STRUCT 160
+#define PROXY_PARAM_NO_KEY ((OMX_U32) -1)
+
+typedef enum PROXY_PARAM_CACHE_POLICY
+{
+	PROXY_PARAM_CACHE_NEVER = 0,	/*Always asked from the remote component */
+	PROXY_PARAM_CACHE_PORT_SETTINGS,	/*Until cached port definitions go stale */
+	PROXY_PARAM_CACHE_IMMUTABLE	/*Until the component role is changed */
+} PROXY_PARAM_CACHE_POLICY;
+
+typedef struct PROXY_PARAM_CACHE_RULE
+{
+	OMX_INDEXTYPE nIndex;
+	PROXY_PARAM_CACHE_POLICY ePolicy;
+	OMX_U32 nPortOffset;	/*Offset of the port index or PROXY_PARAM_NO_KEY */
+	OMX_U32 nEnumOffset;	/*Offset of the enumeration index or PROXY_PARAM_NO_KEY */
+} PROXY_PARAM_CACHE_RULE;
+
+/*Indices not listed here are PROXY_PARAM_CACHE_NEVER */
+static const PROXY_PARAM_CACHE_RULE tProxyParamCachePolicy[] = {
+	{OMX_IndexParamAudioInit, PROXY_PARAM_CACHE_IMMUTABLE,
+	    PROXY_PARAM_NO_KEY, PROXY_PARAM_NO_KEY},
+	{OMX_IndexParamImageInit, PROXY_PARAM_CACHE_IMMUTABLE,
+	    PROXY_PARAM_NO_KEY, PROXY_PARAM_NO_KEY},
+	{OMX_IndexParamVideoInit, PROXY_PARAM_CACHE_IMMUTABLE,
+	    PROXY_PARAM_NO_KEY, PROXY_PARAM_NO_KEY},
+	{OMX_IndexParamOtherInit, PROXY_PARAM_CACHE_IMMUTABLE,
+	    PROXY_PARAM_NO_KEY, PROXY_PARAM_NO_KEY},
+	{OMX_IndexParamStandardComponentRole, PROXY_PARAM_CACHE_IMMUTABLE,
+	    PROXY_PARAM_NO_KEY, PROXY_PARAM_NO_KEY},
+	{OMX_IndexParamVideoProfileLevelQuerySupported,
+	    PROXY_PARAM_CACHE_IMMUTABLE,
+	    offsetof(OMX_VIDEO_PARAM_PROFILELEVELTYPE, nPortIndex),
+	    offsetof(OMX_VIDEO_PARAM_PROFILELEVELTYPE, nProfileIndex)},
+	{OMX_IndexParamVideoPortFormat, PROXY_PARAM_CACHE_PORT_SETTINGS,
+	    offsetof(OMX_VIDEO_PARAM_PORTFORMATTYPE, nPortIndex),
+	    offsetof(OMX_VIDEO_PARAM_PORTFORMATTYPE, nIndex)},
+	{OMX_IndexParamImagePortFormat, PROXY_PARAM_CACHE_PORT_SETTINGS,
+	    offsetof(OMX_IMAGE_PARAM_PORTFORMATTYPE, nPortIndex),
+	    offsetof(OMX_IMAGE_PARAM_PORTFORMATTYPE, nIndex)},
+	{OMX_IndexParamAudioPortFormat, PROXY_PARAM_CACHE_PORT_SETTINGS,
+	    offsetof(OMX_AUDIO_PARAM_PORTFORMATTYPE, nPortIndex),
+	    offsetof(OMX_AUDIO_PARAM_PORTFORMATTYPE, nIndex)}
+};
+
+typedef struct PROXY_PARAM_CACHE_ENTRY
+{
+	OMX_BOOL bValid;
+	OMX_INDEXTYPE nIndex;
+	OMX_U32 nPortKey;
+	OMX_U32 nEnumKey;
+	OMX_U32 nEpoch;
+	OMX_ERRORTYPE eResult;	/*OMX_ErrorNoMore ends enumerations */
+	OMX_U8 aData[PROXY_PARAM_CACHE_MAX_STRUCT];
+} PROXY_PARAM_CACHE_ENTRY;
+
+typedef struct PROXY_PARAM_CACHE
+{
+	TIMM_OSAL_PTR hLock;
+	OMX_U32 nNextVictim;
+	PROXY_PARAM_CACHE_ENTRY tEntries[PROXY_PARAM_CACHE_ENTRIES];
+	OMX_BOOL bVersionValid;
+	OMX_U8 cCompName[OMX_MAX_STRINGNAME_SIZE];
+	OMX_VERSIONTYPE tCompVersion;
+	OMX_VERSIONTYPE tSpecVersion;
+	OMX_UUIDTYPE tCompUUID;
+} PROXY_PARAM_CACHE;
+
+static const PROXY_PARAM_CACHE_RULE *PROXY_ParamCacheRule(OMX_INDEXTYPE
+    nIndex)
+{
+	OMX_U32 i = 0;
+
+	for (i = 0; i < sizeof(tProxyParamCachePolicy) /
+	    sizeof(tProxyParamCachePolicy[0]); i++)
+	{
+		if (tProxyParamCachePolicy[i].nIndex == nIndex)
+			return &tProxyParamCachePolicy[i];
+	}
+	return NULL;
+}
+
+static OMX_U32 PROXY_ParamCacheKey(OMX_PTR pParamStruct, OMX_U32 nOffset)
+{
+	if (nOffset == PROXY_PARAM_NO_KEY)
+		return PROXY_PARAM_NO_KEY;
+	return *((OMX_U32 *) ((OMX_U8 *) pParamStruct + nOffset));
+}
+
+/*Returns the slot caching (nIndex, pParamStruct keys), call with hLock held */
+static PROXY_PARAM_CACHE_ENTRY *PROXY_ParamCacheFind(PROXY_PARAM_CACHE *
+    pCache, const PROXY_PARAM_CACHE_RULE * pRule, OMX_PTR pParamStruct)
+{
+	PROXY_PARAM_CACHE_ENTRY *pEntry = NULL;
+	OMX_U32 nPortKey = PROXY_ParamCacheKey(pParamStruct, pRule->nPortOffset);
+	OMX_U32 nEnumKey = PROXY_ParamCacheKey(pParamStruct, pRule->nEnumOffset);
+	OMX_U32 i = 0;
+
+	for (i = 0; i < PROXY_PARAM_CACHE_ENTRIES; i++)
+	{
+		pEntry = &(pCache->tEntries[i]);
+		if (pEntry->bValid && pEntry->nIndex == pRule->nIndex &&
+		    pEntry->nPortKey == nPortKey && pEntry->nEnumKey == nEnumKey)
+			return pEntry;
+	}
+	return NULL;
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_ParamCacheLookup()
+ * @brief Answers GetParameter locally if tProxyParamCachePolicy allows it and
+ *        an answer of the same size is cached.
+ * @param peResult [OUT] : What the remote component returned for the query.
+ * @return OMX_TRUE if pParamStruct was filled from the cache
+ */
+/* ===========================================================================*/
+static OMX_BOOL PROXY_ParamCacheLookup(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_INDEXTYPE nIndex, OMX_PTR pParamStruct, OMX_ERRORTYPE * peResult)
+{
+	PROXY_PARAM_CACHE *pCache = pCompPrv->pParamCache;
+	const PROXY_PARAM_CACHE_RULE *pRule = NULL;
+	PROXY_PARAM_CACHE_ENTRY *pEntry = NULL;
+	OMX_BOOL bHit = OMX_FALSE;
+
+	pRule = PROXY_ParamCacheRule(nIndex);
+	if (pCache == NULL || pRule == NULL)
+		return OMX_FALSE;
+
+	TIMM_OSAL_MutexObtain(pCache->hLock, TIMM_OSAL_SUSPEND);
+	pEntry = PROXY_ParamCacheFind(pCache, pRule, pParamStruct);
+	if (pEntry != NULL &&
+	    *((OMX_U32 *) pEntry->aData) == *((OMX_U32 *) pParamStruct) &&
+	    (pRule->ePolicy == PROXY_PARAM_CACHE_IMMUTABLE ||
+		pEntry->nEpoch == pCompPrv->nPortDefEpoch))
+	{
+		TIMM_OSAL_Memcpy(pParamStruct, pEntry->aData,
+		    *((OMX_U32 *) pEntry->aData));
+		*peResult = pEntry->eResult;
+		bHit = OMX_TRUE;
+	}
+	TIMM_OSAL_MutexRelease(pCache->hLock);
+
+	return bHit;
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_ParamCacheStore()
+ * @brief Keeps the remote answer to a GetParameter for PROXY_ParamCacheLookup.
+ * @param nEpoch : nPortDefEpoch sampled before the query was sent.
+ */
+/* ===========================================================================*/
+static void PROXY_ParamCacheStore(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_INDEXTYPE nIndex, OMX_PTR pParamStruct, OMX_ERRORTYPE eResult,
+    OMX_U32 nEpoch)
+{
+	PROXY_PARAM_CACHE *pCache = pCompPrv->pParamCache;
+	const PROXY_PARAM_CACHE_RULE *pRule = NULL;
+	PROXY_PARAM_CACHE_ENTRY *pEntry = NULL;
+	OMX_U32 nSize = *((OMX_U32 *) pParamStruct);
+	OMX_U32 i = 0;
+
+	pRule = PROXY_ParamCacheRule(nIndex);
+	if (pCache == NULL || pRule == NULL ||
+	    nSize < sizeof(OMX_U32) || nSize > PROXY_PARAM_CACHE_MAX_STRUCT)
+		return;
+
+	/*Same rule as for port definitions, an invalidation while the query
+	  was in flight means the answer may already be stale */
+	__sync_synchronize();
+	if (pRule->ePolicy == PROXY_PARAM_CACHE_PORT_SETTINGS &&
+	    pCompPrv->nPortDefEpoch != nEpoch)
+		return;
+
+	TIMM_OSAL_MutexObtain(pCache->hLock, TIMM_OSAL_SUSPEND);
+	pEntry = PROXY_ParamCacheFind(pCache, pRule, pParamStruct);
+	for (i = 0; pEntry == NULL && i < PROXY_PARAM_CACHE_ENTRIES; i++)
+	{
+		if (!pCache->tEntries[i].bValid)
+			pEntry = &(pCache->tEntries[i]);
+	}
+	if (pEntry == NULL)
+	{
+		pEntry = &(pCache->tEntries[pCache->nNextVictim]);
+		pCache->nNextVictim =
+		    (pCache->nNextVictim + 1) % PROXY_PARAM_CACHE_ENTRIES;
+	}
+	pEntry->nIndex = nIndex;
+	pEntry->nPortKey = PROXY_ParamCacheKey(pParamStruct, pRule->nPortOffset);
+	pEntry->nEnumKey = PROXY_ParamCacheKey(pParamStruct, pRule->nEnumOffset);
+	pEntry->nEpoch = nEpoch;
+	pEntry->eResult = eResult;
+	TIMM_OSAL_Memcpy(pEntry->aData, pParamStruct, nSize);
+	pEntry->bValid = OMX_TRUE;
+	TIMM_OSAL_MutexRelease(pCache->hLock);
+}
+
+/*Drops every cached GetParameter answer, needed when the role changes since
+  that changes what the component supports */
+static void PROXY_ParamCacheFlush(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	PROXY_PARAM_CACHE *pCache = pCompPrv->pParamCache;
+	OMX_U32 i = 0;
+
+	if (pCache == NULL)
+		return;
+
+	TIMM_OSAL_MutexObtain(pCache->hLock, TIMM_OSAL_SUSPEND);
+	for (i = 0; i < PROXY_PARAM_CACHE_ENTRIES; i++)
+		pCache->tEntries[i].bValid = OMX_FALSE;
+	TIMM_OSAL_MutexRelease(pCache->hLock);
+}
+
+/*SetConfig calls the proxy may hold back and send with the next
+  EmptyThisBuffer. Only rate control settings that a client retunes while
+  streaming are queued, a newer request for the same port replaces the
+  pending one so a burst of changes between two frames costs one RPC */
+#define PROXY_CONFIG_QUEUE_ENTRIES 4
+
+typedef struct PROXY_CONFIG_QUEUE_ENTRY
+{
+	OMX_BOOL bPending;
+	OMX_INDEXTYPE nIndex;
+	OMX_U32 nPortIndex;
+	union
+	{
+		OMX_CONFIG_FRAMERATETYPE tFrameRate;
+		OMX_VIDEO_CONFIG_BITRATETYPE tBitRate;
+		OMX_CONFIG_INTRAREFRESHVOPTYPE tIntraRefresh;
+	} uData;
+} PROXY_CONFIG_QUEUE_ENTRY;
+
+typedef struct PROXY_CONFIG_QUEUE
+{
+	TIMM_OSAL_PTR hLock;
+	OMX_U32 nPending;
+	PROXY_CONFIG_QUEUE_ENTRY tEntries[PROXY_CONFIG_QUEUE_ENTRIES];
+} PROXY_CONFIG_QUEUE;
+
+static OMX_U32 PROXY_ConfigQueueSize(OMX_INDEXTYPE nIndex)
+{
+	switch (nIndex)
+	{
+	case OMX_IndexConfigVideoFramerate:
+		return sizeof(OMX_CONFIG_FRAMERATETYPE);
+	case OMX_IndexConfigVideoBitrate:
+		return sizeof(OMX_VIDEO_CONFIG_BITRATETYPE);
+	case OMX_IndexConfigVideoIntraVOPRefresh:
+		return sizeof(OMX_CONFIG_INTRAREFRESHVOPTYPE);
+	default:
+		return 0;
+	}
+}
+
+/*Returns OMX_TRUE if pConfigStruct was queued, otherwise it has to go to
+  the remote side right away */
+static OMX_BOOL PROXY_ConfigQueuePut(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_INDEXTYPE nIndex, OMX_PTR pConfigStruct)
+{
+	PROXY_CONFIG_QUEUE *pQueue = pCompPrv->pConfigQueue;
+	PROXY_CONFIG_QUEUE_ENTRY *pEntry = NULL;
+	OMX_U32 nSize = PROXY_ConfigQueueSize(nIndex);
+	OMX_U32 nPortIndex = 0, i = 0;
+	OMX_BOOL bIntraRefresh = OMX_FALSE;
+
+	/*Anything the remote side would reject is left for it to report */
+	if (pQueue == NULL || nSize == 0 ||
+	    ((OMX_CONFIG_FRAMERATETYPE *) pConfigStruct)->nSize != nSize)
+		return OMX_FALSE;
+	/*nPortIndex sits at the same offset in all queued structures */
+	nPortIndex = ((OMX_CONFIG_FRAMERATETYPE *) pConfigStruct)->nPortIndex;
+
+	TIMM_OSAL_MutexObtain(pQueue->hLock, TIMM_OSAL_SUSPEND);
+	for (i = 0; i < PROXY_CONFIG_QUEUE_ENTRIES; i++)
+	{
+		if (pQueue->tEntries[i].bPending &&
+		    pQueue->tEntries[i].nIndex == nIndex &&
+		    pQueue->tEntries[i].nPortIndex == nPortIndex)
+		{
+			pEntry = &pQueue->tEntries[i];
+			break;
+		}
+		if (pEntry == NULL && !pQueue->tEntries[i].bPending)
+			pEntry = &pQueue->tEntries[i];
+	}
+	if (pEntry != NULL)
+	{
+		/*An IDR that is still pending must not be lost to a later
+		  request clearing it */
+		if (pEntry->bPending &&
+		    nIndex == OMX_IndexConfigVideoIntraVOPRefresh)
+			bIntraRefresh =
+			    pEntry->uData.tIntraRefresh.IntraRefreshVOP;
+		TIMM_OSAL_Memcpy(&pEntry->uData, pConfigStruct, nSize);
+		if (bIntraRefresh)
+			pEntry->uData.tIntraRefresh.IntraRefreshVOP = OMX_TRUE;
+		if (!pEntry->bPending)
+			pQueue->nPending++;
+		pEntry->bPending = OMX_TRUE;
+		pEntry->nIndex = nIndex;
+		pEntry->nPortIndex = nPortIndex;
+	}
+	TIMM_OSAL_MutexRelease(pQueue->hLock);
+	return pEntry != NULL ? OMX_TRUE : OMX_FALSE;
+}
+
+/*Sends whatever is queued. The client got OMX_ErrorNone when it queued the
+  settings, so a failure here can only be logged. Called ahead of every
+  EmptyThisBuffer, SendCommand, GetConfig and any SetConfig or SetParameter
+  that is not queued, so the remote side sees the settings in the order the
+  client made them */
+static void PROXY_ConfigQueueFlush(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	PROXY_CONFIG_QUEUE *pQueue = pCompPrv->pConfigQueue;
+	PROXY_CONFIG_QUEUE_ENTRY tSend[PROXY_CONFIG_QUEUE_ENTRIES];
+	OMX_ERRORTYPE eCompReturn = OMX_ErrorNone;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	OMX_U32 i = 0, nSend = 0;
+
+	if (pQueue == NULL)
+		return;
+
+	/*Not held over the RPCs, the client may keep queueing meanwhile */
+	TIMM_OSAL_MutexObtain(pQueue->hLock, TIMM_OSAL_SUSPEND);
+	if (pQueue->nPending == 0)
+	{
+		TIMM_OSAL_MutexRelease(pQueue->hLock);
+		return;
+	}
+	for (i = 0; i < PROXY_CONFIG_QUEUE_ENTRIES; i++)
+	{
+		if (!pQueue->tEntries[i].bPending)
+			continue;
+		tSend[nSend++] = pQueue->tEntries[i];
+		pQueue->tEntries[i].bPending = OMX_FALSE;
+	}
+	pQueue->nPending = 0;
+	TIMM_OSAL_MutexRelease(pQueue->hLock);
+
+	for (i = 0; i < nSend; i++)
+	{
+		eCompReturn = OMX_ErrorNone;
+		eRPCError = RPC_SetConfig(pCompPrv->hRemoteComp,
+		    tSend[i].nIndex, &tSend[i].uData, NULL, &eCompReturn);
+		if (eRPCError != RPC_OMX_ErrorNone ||
+		    eCompReturn != OMX_ErrorNone)
+			DOMX_ERROR("%s: queued SetConfig 0x%x on port %d "
+			    "failed, RPC error 0x%x, component error 0x%x",
+			    pCompPrv->cCompName, tSend[i].nIndex,
+			    tSend[i].nPortIndex, eRPCError, eCompReturn);
+	}
+}
+
+/* ===========================================================================*/
+/**
+ * @name PROXY_EnableConfigQueue()
+ * @brief Lets SetConfig of frame rate, bitrate and intra refresh return
+ *        right away, the settings go out with the next EmptyThisBuffer.
+ *        Meant for encoders whose clients retune rate control per frame.
+ * @param hComponent : proxy component, after OMX_ProxyCommonInit()
+ * @return OMX_ErrorNone = Successful
+ *
+ */
+/* ===========================================================================*/
+OMX_ERRORTYPE PROXY_EnableConfigQueue(OMX_HANDLETYPE hComponent)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	PROXY_CONFIG_QUEUE *pQueue = NULL;
+
+	PROXY_require((hComp->pComponentPrivate != NULL),
+	    OMX_ErrorBadParameter, NULL);
+	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+	PROXY_require(pCompPrv->pConfigQueue == NULL,
+	    OMX_ErrorIncorrectStateOperation, "Config queue already enabled");
+
+	pQueue = TIMM_OSAL_Malloc(sizeof(PROXY_CONFIG_QUEUE), TIMM_OSAL_TRUE,
+	    0, TIMMOSAL_MEM_SEGMENT_INT);
+	PROXY_assert(pQueue != NULL, OMX_ErrorInsufficientResources,
+	    "Config queue not allocated");
+	TIMM_OSAL_Memset(pQueue, 0, sizeof(PROXY_CONFIG_QUEUE));
+
+	eOSALStatus = TIMM_OSAL_MutexCreate(&pQueue->hLock);
+	if (eOSALStatus != TIMM_OSAL_ERR_NONE)
+	{
+		TIMM_OSAL_Free(pQueue);
+		pQueue = NULL;
+	}
+	PROXY_assert(pQueue != NULL, OMX_ErrorInsufficientResources,
+	    "Config queue lock not created");
+
+	pCompPrv->pConfigQueue = pQueue;
+
+      EXIT:
+	return eError;
+}
+
+/*Extension names resolved by the remote side, shared by all proxy instances
+  of the process. The answer depends on the component only, so the next
+  instance of a codec skips the RPC marshalling the name. Unsupported
+  extensions are kept too, clients probe for those on every instance */
+#define PROXY_EXT_CACHE_ENTRIES 64
+#define PROXY_EXT_NAME_SIZE 128
+
+typedef struct PROXY_EXT_CACHE_ENTRY
+{
+	OMX_BOOL bValid;
+	char cCompName[MAX_COMPONENT_NAME_LENGTH];
+	char cExtName[PROXY_EXT_NAME_SIZE];
+	OMX_INDEXTYPE nIndex;
+	OMX_ERRORTYPE eResult;
+} PROXY_EXT_CACHE_ENTRY;
+
+static struct
+{
+	pthread_mutex_t tLock;
+	OMX_U32 nNextVictim;
+	PROXY_EXT_CACHE_ENTRY tEntries[PROXY_EXT_CACHE_ENTRIES];
+} gProxyExtCache = { PTHREAD_MUTEX_INITIALIZER, 0, { { 0 } } };
+
+static OMX_BOOL PROXY_ExtCacheLookup(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_STRING cParameterName, OMX_INDEXTYPE * pIndexType,
+    OMX_ERRORTYPE * peResult)
+{
+	PROXY_EXT_CACHE_ENTRY *pEntry = NULL;
+	OMX_BOOL bFound = OMX_FALSE;
+	OMX_U32 i = 0;
+
+	pthread_mutex_lock(&gProxyExtCache.tLock);
+	for (i = 0; i < PROXY_EXT_CACHE_ENTRIES; i++)
+	{
+		pEntry = &gProxyExtCache.tEntries[i];
+		if (pEntry->bValid &&
+		    strcmp(pEntry->cExtName, cParameterName) == 0 &&
+		    strcmp(pEntry->cCompName, pCompPrv->cCompName) == 0)
+		{
+			*pIndexType = pEntry->nIndex;
+			*peResult = pEntry->eResult;
+			bFound = OMX_TRUE;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&gProxyExtCache.tLock);
+	return bFound;
+}
+
+static void PROXY_ExtCacheStore(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_STRING cParameterName, OMX_INDEXTYPE nIndex, OMX_ERRORTYPE eResult)
+{
+	PROXY_EXT_CACHE_ENTRY *pEntry = NULL;
+
+	if (strlen(cParameterName) >= PROXY_EXT_NAME_SIZE ||
+	    strlen(pCompPrv->cCompName) >= MAX_COMPONENT_NAME_LENGTH)
+		return;
+
+	pthread_mutex_lock(&gProxyExtCache.tLock);
+	pEntry = &gProxyExtCache.tEntries[gProxyExtCache.nNextVictim];
+	gProxyExtCache.nNextVictim =
+	    (gProxyExtCache.nNextVictim + 1) % PROXY_EXT_CACHE_ENTRIES;
+	strcpy(pEntry->cCompName, pCompPrv->cCompName);
+	strcpy(pEntry->cExtName, cParameterName);
+	pEntry->nIndex = nIndex;
+	pEntry->eResult = eResult;
+	pEntry->bValid = OMX_TRUE;
+	pthread_mutex_unlock(&gProxyExtCache.tLock);
+}
+
+/*Encoders ask for output buffers of the worst case frame size for the whole
+  session. The frame sizes really produced on a compressed video output port
+  are kept per component, frame size, bitrate and frame rate, and a later
+  session with the same setup asks the remote side for buffers of the seen
+  peak plus a margin instead. A frame that comes close to the end of its
+  buffer stops the shrinking for that setup for good */
+#define PROXY_OUTSIZE_ENTRIES 16
+#define PROXY_OUTSIZE_MIN_FRAMES 100
+#define PROXY_OUTSIZE_FLOOR (64 * 1024)
+#define PROXY_OUTSIZE_WITH_MARGIN(n) ((n) + (n) / 2)
+#define PROXY_OUTSIZE_NEAR_FULL(nLen, nAlloc) ((nLen) > (nAlloc) - (nAlloc) / 8)
+
+typedef struct PROXY_OUTSIZE_ENTRY
+{
+	OMX_BOOL bValid;
+	char cCompName[MAX_COMPONENT_NAME_LENGTH];
+	OMX_U32 nKey[PROXY_OUTSIZE_KEY_LEN];
+	OMX_U32 nPeak;
+	OMX_U32 nFrames;
+	OMX_BOOL bOverflow;
+} PROXY_OUTSIZE_ENTRY;
+
+static struct
+{
+	pthread_mutex_t tLock;
+	OMX_U32 nNextVictim;
+	PROXY_OUTSIZE_ENTRY tEntries[PROXY_OUTSIZE_ENTRIES];
+} gProxyOutSize = { PTHREAD_MUTEX_INITIALIZER, 0, { { 0 } } };
+
+/*Called with gProxyOutSize.tLock held */
+static PROXY_OUTSIZE_ENTRY *PROXY_OutSizeFind(PROXY_COMPONENT_PRIVATE *
+    pCompPrv, PROXY_PORT_TYPE * pPort)
+{
+	PROXY_OUTSIZE_ENTRY *pEntry = NULL;
+	OMX_U32 i = 0;
+
+	for (i = 0; i < PROXY_OUTSIZE_ENTRIES; i++)
+	{
+		pEntry = &gProxyOutSize.tEntries[i];
+		if (pEntry->bValid &&
+		    memcmp(pEntry->nKey, pPort->nOutSizeKey,
+			sizeof(pEntry->nKey)) == 0 &&
+		    strcmp(pEntry->cCompName, pCompPrv->cCompName) == 0)
+			return pEntry;
+	}
+	return NULL;
+}
+
+/*Starts recording the encoded frame sizes of port nPort and, when an
+  earlier session with the same setup gives a safe bound, lowers the buffer
+  size of the port on the remote side. Only called while the port has no
+  buffers, the remote component may still refuse or round the new size.
+  Returns OMX_FALSE when the component has no port nPort */
+static OMX_BOOL PROXY_OutSizeStart(OMX_HANDLETYPE hComponent,
+    PROXY_COMPONENT_PRIVATE * pCompPrv, OMX_U32 nPort)
+{
+	PROXY_PORT_TYPE *pPort = &(pCompPrv->proxyPortBuffers[nPort]);
+	OMX_PARAM_PORTDEFINITIONTYPE tPortDef;
+	PROXY_OUTSIZE_ENTRY *pEntry = NULL;
+	OMX_U32 nSize = 0;
+
+	tPortDef.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+	tPortDef.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+	tPortDef.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+	tPortDef.nVersion.s.nRevision = 0x0;
+	tPortDef.nVersion.s.nStep = 0x0;
+	tPortDef.nPortIndex = nPort;
+	pPort->bOutSizeTrack = OMX_FALSE;
+	if (PROXY_GetCachedPortDefinition(hComponent, &tPortDef) !=
+	    OMX_ErrorNone)
+		return OMX_FALSE;
+	/*Sizes of frames delivered in slices say nothing about whole frames */
+	if (pPort->bPartialFrames || tPortDef.eDir != OMX_DirOutput ||
+	    tPortDef.eDomain != OMX_PortDomainVideo ||
+	    tPortDef.format.video.eCompressionFormat == OMX_VIDEO_CodingUnused)
+		return OMX_TRUE;
+
+	pPort->nOutSizeKey[0] = tPortDef.format.video.eCompressionFormat;
+	pPort->nOutSizeKey[1] = tPortDef.format.video.nFrameWidth;
+	pPort->nOutSizeKey[2] = tPortDef.format.video.nFrameHeight;
+	pPort->nOutSizeKey[3] = tPortDef.format.video.nBitrate;
+	pPort->nOutSizeKey[4] = tPortDef.format.video.xFramerate;
+	pPort->nOutSizePeak = 0;
+	pPort->nOutSizeFrames = 0;
+	pPort->bOutSizeOverflow = OMX_FALSE;
+	pPort->bOutSizeTrack = OMX_TRUE;
+
+	pthread_mutex_lock(&gProxyOutSize.tLock);
+	pEntry = PROXY_OutSizeFind(pCompPrv, pPort);
+	if (pEntry != NULL && !pEntry->bOverflow &&
+	    pEntry->nFrames >= PROXY_OUTSIZE_MIN_FRAMES)
+		nSize = PROXY_OUTSIZE_WITH_MARGIN(pEntry->nPeak);
+	pthread_mutex_unlock(&gProxyOutSize.tLock);
+
+	if (nSize < PROXY_OUTSIZE_FLOOR)
+		nSize = PROXY_OUTSIZE_FLOOR;
+	nSize = (nSize + LINUX_PAGE_SIZE - 1) & ~(LINUX_PAGE_SIZE - 1);
+	if (pEntry == NULL || nSize >= tPortDef.nBufferSize)
+		return OMX_TRUE;
+
+	DOMX_DEBUG("%s: port %d buffers %d -> %d bytes", pCompPrv->cCompName,
+	    nPort, tPortDef.nBufferSize, nSize);
+	tPortDef.nBufferSize = nSize;
+	if (PROXY_SetParameter(hComponent, OMX_IndexParamPortDefinition,
+		&tPortDef) != OMX_ErrorNone)
+		DOMX_DEBUG("%s: smaller output buffers refused",
+		    pCompPrv->cCompName);
+	return OMX_TRUE;
+}
+
+static void PROXY_OutSizeRecord(PROXY_PORT_TYPE * pPort,
+    OMX_BUFFERHEADERTYPE * pBufHdr)
+{
+	OMX_U32 nLen = pBufHdr->nOffset + pBufHdr->nFilledLen;
+
+	if (pBufHdr->nFilledLen == 0)
+		return;
+	if (nLen > pPort->nOutSizePeak)
+		pPort->nOutSizePeak = nLen;
+	pPort->nOutSizeFrames++;
+	if (PROXY_OUTSIZE_NEAR_FULL(nLen, pBufHdr->nAllocLen))
+		pPort->bOutSizeOverflow = OMX_TRUE;
+}
+
+/*Hands the sizes recorded on port nPort over to the process wide table,
+  done once the buffers of the session are going away */
+static void PROXY_OutSizeFinish(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_U32 nPort)
+{
+	PROXY_PORT_TYPE *pPort = &(pCompPrv->proxyPortBuffers[nPort]);
+	PROXY_OUTSIZE_ENTRY *pEntry = NULL;
+
+	if (!pPort->bOutSizeTrack || (pPort->nOutSizeFrames == 0 &&
+		!pPort->bOutSizeOverflow) ||
+	    strlen(pCompPrv->cCompName) >= MAX_COMPONENT_NAME_LENGTH)
+		return;
+
+	pthread_mutex_lock(&gProxyOutSize.tLock);
+	pEntry = PROXY_OutSizeFind(pCompPrv, pPort);
+	if (pEntry == NULL)
+	{
+		pEntry = &gProxyOutSize.tEntries[gProxyOutSize.nNextVictim];
+		gProxyOutSize.nNextVictim =
+		    (gProxyOutSize.nNextVictim + 1) % PROXY_OUTSIZE_ENTRIES;
+		TIMM_OSAL_Memset(pEntry, 0, sizeof(*pEntry));
+		strcpy(pEntry->cCompName, pCompPrv->cCompName);
+		TIMM_OSAL_Memcpy(pEntry->nKey, pPort->nOutSizeKey,
+		    sizeof(pEntry->nKey));
+		pEntry->bValid = OMX_TRUE;
+	}
+	if (pPort->nOutSizePeak > pEntry->nPeak)
+		pEntry->nPeak = pPort->nOutSizePeak;
+	pEntry->nFrames += pPort->nOutSizeFrames;
+	if (pPort->bOutSizeOverflow)
+		pEntry->bOverflow = OMX_TRUE;
+	pthread_mutex_unlock(&gProxyOutSize.tLock);
+
+	pPort->nOutSizePeak = 0;
+	pPort->nOutSizeFrames = 0;
+	pPort->bOutSizeOverflow = OMX_FALSE;
+}
+
+/*Load of all proxy instances of the process for the DVFS of the remote core,
+  in macroblocks per second. Each output port counts with the frame size of
+  its port definition times the FillThisBuffer cadence measured over
+  PROXY_LOAD_WINDOW_MS, or its xFramerate when the component is started and
+  nothing was measured yet. Whenever the sum moves to another level the
+  remote side is sent OMX_TI_IndexConfigWorkloadHint, so it can raise its
+  operating point before the first frames are late and lower it again once
+  the instances go idle. A level is only left downwards once the load is an
+  eighth below its boundary, a load sitting on a boundary does not flap.
+  Hints go out from client calls only, the callback thread has to be free to
+  read their reply */
+#define PROXY_LOAD_INSTANCES 16
+#define PROXY_LOAD_WINDOW_MS 1000
+/*Instances that did not queue a buffer for this long count as idle */
+#define PROXY_LOAD_STALE_MS (3 * PROXY_LOAD_WINDOW_MS)
+#define PROXY_LOAD_LEVEL_UNKNOWN ((OMX_U32) -1)
+#define PROXY_LOAD_MBS(nWidth, nHeight) \
+	((((nWidth) + 15) / 16) * (((nHeight) + 15) / 16))
+
+/*Level boundaries: VGA, 720p and 1080p at 30 fps, 1080p at 60 fps */
+static const OMX_U32 gProxyLoadLevels[] = { 36000, 108000, 244800, 489600 };
+#define PROXY_LOAD_LEVELS (sizeof(gProxyLoadLevels) / sizeof(OMX_U32))
+
+typedef struct PROXY_LOAD_ENTRY
+{
+	PROXY_COMPONENT_PRIVATE *pOwner;	/* NULL when unused */
+	OMX_U32 nLoad;
+	OMX_U32 nUpdated;
+} PROXY_LOAD_ENTRY;
+
+static struct
+{
+	pthread_mutex_t tLock;
+	OMX_U32 nLevel;
+	PROXY_LOAD_ENTRY tEntries[PROXY_LOAD_INSTANCES];
+} gProxyLoad = { PTHREAD_MUTEX_INITIALIZER, 0, { { 0 } } };
+
+static OMX_U32 PROXY_LoadNowMs(void)
+{
+	struct timespec tNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return (OMX_U32) (tNow.tv_sec * 1000 + tNow.tv_nsec / 1000000);
+}
+
+static OMX_U32 PROXY_LoadLevel(OMX_U32 nLoad, OMX_U32 nLevel)
+{
+	OMX_U32 nNew = 0;
+
+	while (nNew < PROXY_LOAD_LEVELS && nLoad >= gProxyLoadLevels[nNew])
+		nNew++;
+	if (nLevel == PROXY_LOAD_LEVEL_UNKNOWN)
+		return nNew;
+	while (nNew < nLevel && nLoad + gProxyLoadLevels[nNew] / 8 >=
+	    gProxyLoadLevels[nNew])
+		nNew++;
+	return nNew;
+}
+
+/*Records the load of the instance, 0 takes it out, and sends the hint
+  through it when the sum of all instances moved to another level */
+static void PROXY_LoadSet(PROXY_COMPONENT_PRIVATE * pCompPrv, OMX_U32 nLoad)
+{
+	PROXY_LOAD_ENTRY *pEntry = NULL, *pFree = NULL, *pSlot = NULL;
+	OMX_PARAM_U32TYPE tHint;
+	OMX_ERRORTYPE eCompReturn = OMX_ErrorNone;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	OMX_U32 nNow = PROXY_LoadNowMs(), nTotal = 0, nLevel = 0, i = 0;
+
+	pthread_mutex_lock(&gProxyLoad.tLock);
+	for (i = 0; i < PROXY_LOAD_INSTANCES; i++)
+	{
+		pSlot = &gProxyLoad.tEntries[i];
+		if (pSlot->pOwner == pCompPrv)
+			pEntry = pSlot;
+		else if (pSlot->pOwner == NULL)
+			pFree = pFree ? pFree : pSlot;
+		else if (nNow - pSlot->nUpdated <= PROXY_LOAD_STALE_MS)
+			nTotal += pSlot->nLoad;
+	}
+	if (pEntry == NULL && nLoad != 0)
+		pEntry = pFree;
+	if (pEntry != NULL)
+	{
+		pEntry->pOwner = (nLoad != 0) ? pCompPrv : NULL;
+		pEntry->nLoad = nLoad;
+		pEntry->nUpdated = nNow;
+		nTotal += nLoad;
+	}
+	nLevel = PROXY_LoadLevel(nTotal, gProxyLoad.nLevel);
+	if (nLevel == gProxyLoad.nLevel || pCompPrv->bLoadHintRefused)
+	{
+		pthread_mutex_unlock(&gProxyLoad.tLock);
+		return;
+	}
+	gProxyLoad.nLevel = nLevel;
+	pthread_mutex_unlock(&gProxyLoad.tLock);
+
+	tHint.nSize = sizeof(OMX_PARAM_U32TYPE);
+	tHint.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+	tHint.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+	tHint.nVersion.s.nRevision = 0x0;
+	tHint.nVersion.s.nStep = 0x0;
+	tHint.nPortIndex = OMX_ALL;
+	tHint.nU32 = nTotal;
+	eRPCError = RPC_SetConfig(pCompPrv->hRemoteComp,
+	    (OMX_INDEXTYPE) OMX_TI_IndexConfigWorkloadHint, &tHint, NULL,
+	    &eCompReturn);
+	DOMX_DEBUG("%s: workload hint %d MB/s, level %d, RPC error 0x%x, "
+	    "component error 0x%x", pCompPrv->cCompName, nTotal, nLevel,
+	    eRPCError, eCompReturn);
+	if (eRPCError != RPC_OMX_ErrorNone || eCompReturn != OMX_ErrorNone)
+	{
+		/*Whoever comes next sends the level again */
+		pCompPrv->bLoadHintRefused = (eRPCError == RPC_OMX_ErrorNone) ?
+		    OMX_TRUE : OMX_FALSE;
+		pthread_mutex_lock(&gProxyLoad.tLock);
+		gProxyLoad.nLevel = PROXY_LOAD_LEVEL_UNKNOWN;
+		pthread_mutex_unlock(&gProxyLoad.tLock);
+	}
+}
+
+/*Frame size of an output port in macroblocks, 0 for other ports */
+static OMX_U32 PROXY_LoadPortMbs(OMX_HANDLETYPE hComponent, OMX_U32 nPort,
+    OMX_U32 * pFramerate)
+{
+	OMX_PARAM_PORTDEFINITIONTYPE tPortDef;
+
+	tPortDef.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+	tPortDef.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+	tPortDef.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+	tPortDef.nVersion.s.nRevision = 0x0;
+	tPortDef.nVersion.s.nStep = 0x0;
+	tPortDef.nPortIndex = nPort;
+	*pFramerate = 0;
+	if (PROXY_GetCachedPortDefinition(hComponent, &tPortDef) !=
+	    OMX_ErrorNone || tPortDef.eDir != OMX_DirOutput)
+		return 0;
+	if (tPortDef.eDomain == OMX_PortDomainVideo)
+	{
+		*pFramerate = tPortDef.format.video.xFramerate >> 16;
+		return PROXY_LOAD_MBS(tPortDef.format.video.nFrameWidth,
+		    tPortDef.format.video.nFrameHeight);
+	}
+	if (tPortDef.eDomain == OMX_PortDomainImage)
+		return PROXY_LOAD_MBS(tPortDef.format.image.nFrameWidth,
+		    tPortDef.format.image.nFrameHeight);
+	return 0;
+}
+
+static OMX_U32 PROXY_LoadSum(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	OMX_U32 nLoad = 0, i = 0;
+
+	for (i = 0; i < PROXY_MAXNUMOFPORTS; i++)
+		nLoad += pCompPrv->proxyPortBuffers[i].nLoad;
+	return nLoad;
+}
+
+/*Counts a FillThisBuffer on nPort, the load of the port is updated once a
+  window is full */
+static void PROXY_LoadFrame(OMX_HANDLETYPE hComponent,
+    PROXY_COMPONENT_PRIVATE * pCompPrv, OMX_U32 nPort)
+{
+	PROXY_PORT_TYPE *pPort = NULL;
+	OMX_U32 nNow = 0, nElapsed = 0, nMbs = 0, nFramerate = 0;
+
+	if (nPort >= PROXY_MAXNUMOFPORTS)
+		return;
+	pPort = &(pCompPrv->proxyPortBuffers[nPort]);
+	nNow = PROXY_LoadNowMs();
+	if (pPort->nLoadFrames++ == 0)
+	{
+		pPort->nLoadWindowStart = nNow;
+		return;
+	}
+	nElapsed = nNow - pPort->nLoadWindowStart;
+	if (nElapsed < PROXY_LOAD_WINDOW_MS)
+		return;
+
+	nMbs = PROXY_LoadPortMbs(hComponent, nPort, &nFramerate);
+	pPort->nLoad = (OMX_U32) ((OMX_U64) nMbs * (pPort->nLoadFrames - 1) *
+	    1000 / nElapsed);
+	pPort->nLoadFrames = 1;
+	pPort->nLoadWindowStart = nNow;
+	PROXY_LoadSet(pCompPrv, PROXY_LoadSum(pCompPrv));
+}
+
+/*Executing starts every output port at the load its port definition
+  announces, any other state drops the instance out */
+static void PROXY_LoadState(OMX_HANDLETYPE hComponent,
+    PROXY_COMPONENT_PRIVATE * pCompPrv, OMX_STATETYPE eState)
+{
+	OMX_U32 nMbs = 0, nFramerate = 0, i = 0;
+
+	for (i = 0; i < PROXY_MAXNUMOFPORTS; i++)
+	{
+		pCompPrv->proxyPortBuffers[i].nLoad = 0;
+		pCompPrv->proxyPortBuffers[i].nLoadFrames = 0;
+		if (eState != OMX_StateExecuting)
+			continue;
+		nMbs = PROXY_LoadPortMbs(hComponent, i, &nFramerate);
+		pCompPrv->proxyPortBuffers[i].nLoad = nMbs * nFramerate;
+	}
+	PROXY_LoadSet(pCompPrv, PROXY_LoadSum(pCompPrv));
+}
+
+/*Admission control for the codec instances of the process. Each instance
+  reserves the macroblocks per second of its largest port definition (at
+  xFramerate, PROXY_ADMIT_FPS when the port does not tell) weighted by its
+  role, encoders cost twice a decoder and AVC high profile a quarter more.
+  A port definition that would take the reservations of all instances over
+  the budget is refused with OMX_ErrorInsufficientResources before it
+  reaches the remote side, the caller may set a smaller one or give up, and
+  no new codec instance is created while the budget is used up. This way a
+  client can fall back to another codec at configuration time instead of
+  every running stream missing its deadlines. The budget is in decoded
+  macroblocks per second and set with debug.domx.admit_budget. It is off by
+  default: the weights are not calibrated against what the device
+  advertises in media_profiles.xml (1080p30 high profile recording, 1080p
+  editor transcodes, 1080p60 playback) and a fixed budget would refuse
+  those */
+#define PROXY_ADMIT_BUDGET 0
+#define PROXY_ADMIT_FPS 30
+/*Weights are in eighths */
+#define PROXY_ADMIT_WEIGHT_DEC 8
+#define PROXY_ADMIT_WEIGHT_ENC 16
+#define PROXY_ADMIT_WEIGHT_HIGH_PROFILE 2
+
+static struct
+{
+	pthread_mutex_t tLock;
+	OMX_U32 nCommitted;
+} gProxyAdmit = { PTHREAD_MUTEX_INITIALIZER, 0 };
+
+static OMX_U32 PROXY_AdmitBudget(void)
+{
+	char *val = getenv("DEBUG_DOMX_ADMIT_BUDGET");
+#ifdef _Android
+	char value[PROPERTY_VALUE_MAX];
+
+	if (val == NULL && property_get("debug.domx.admit_budget", value,
+		NULL) > 0)
+		val = value;
+#endif
+	return (val != NULL) ? (OMX_U32) strtoul(val, NULL, 0) :
+	    PROXY_ADMIT_BUDGET;
+}
+
+/*0 for components that are not codecs */
+static OMX_U32 PROXY_AdmitWeight(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	OMX_U32 nWeight = 0;
+
+	if (strncmp(pCompPrv->cCompName, "OMX.TI.DUCATI1.VIDEO.DECODER",
+		strlen("OMX.TI.DUCATI1.VIDEO.DECODER")) == 0)
+		nWeight = PROXY_ADMIT_WEIGHT_DEC;
+	else if (strncmp(pCompPrv->cCompName, "OMX.TI.DUCATI1.VIDEO.",
+		strlen("OMX.TI.DUCATI1.VIDEO.")) == 0 &&
+	    strstr(pCompPrv->cCompName, ".CAMERA") == NULL)
+		nWeight = PROXY_ADMIT_WEIGHT_ENC;
+	if (nWeight != 0 && pCompPrv->bAdmitHighProfile)
+		nWeight += PROXY_ADMIT_WEIGHT_HIGH_PROFILE;
+	return nWeight;
+}
+
+/*Recomputes the reservation of the instance, a larger one is only taken
+  while it fits the budget */
+static OMX_ERRORTYPE PROXY_AdmitUpdate(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_U32 nBudget = PROXY_AdmitBudget(), nCost = 0, i = 0;
+
+	for (i = 0; i < PROXY_MAXNUMOFPORTS; i++)
+		if (pCompPrv->proxyPortBuffers[i].nAdmitMbs > nCost)
+			nCost = pCompPrv->proxyPortBuffers[i].nAdmitMbs;
+	nCost = (OMX_U32) ((OMX_U64) nCost * PROXY_AdmitWeight(pCompPrv) / 8);
+
+	pthread_mutex_lock(&gProxyAdmit.tLock);
+	if (nBudget != 0 && nCost > pCompPrv->nAdmitted &&
+	    gProxyAdmit.nCommitted - pCompPrv->nAdmitted + nCost > nBudget)
+	{
+		DOMX_ERROR("%s: %d MB/s refused, %d of %d MB/s committed",
+		    pCompPrv->cCompName, nCost, gProxyAdmit.nCommitted,
+		    nBudget);
+		eError = OMX_ErrorInsufficientResources;
+	} else
+	{
+		gProxyAdmit.nCommitted =
+		    gProxyAdmit.nCommitted - pCompPrv->nAdmitted + nCost;
+		pCompPrv->nAdmitted = nCost;
+	}
+	pthread_mutex_unlock(&gProxyAdmit.tLock);
+	return eError;
+}
+
+/*Whether the process may create another codec instance */
+static OMX_BOOL PROXY_AdmitInstance(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	OMX_U32 nBudget = PROXY_AdmitBudget();
+	OMX_BOOL bAdmit = OMX_TRUE;
+
+	if (nBudget == 0 || PROXY_AdmitWeight(pCompPrv) == 0)
+		return OMX_TRUE;
+	pthread_mutex_lock(&gProxyAdmit.tLock);
+	if (gProxyAdmit.nCommitted >= nBudget)
+		bAdmit = OMX_FALSE;
+	pthread_mutex_unlock(&gProxyAdmit.tLock);
+	return bAdmit;
+}
+
+/*Takes the cost of a port definition or profile the client is about to set,
+  *pnPrev gets what has to be put back if the remote side refuses it */
+static OMX_ERRORTYPE PROXY_AdmitParam(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_INDEXTYPE nParamIndex, OMX_PTR pParamStruct, OMX_U32 * pnPrev)
+{
+	OMX_PARAM_PORTDEFINITIONTYPE *pPortDef = NULL;
+	OMX_VIDEO_PARAM_AVCTYPE *pAvc = NULL;
+	OMX_U32 nFramerate = 0;
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+
+	if (nParamIndex == OMX_IndexParamPortDefinition)
+	{
+		pPortDef = (OMX_PARAM_PORTDEFINITIONTYPE *) pParamStruct;
+		if (pPortDef->nPortIndex >= PROXY_MAXNUMOFPORTS ||
+		    pPortDef->eDomain != OMX_PortDomainVideo)
+			return OMX_ErrorNone;
+		nFramerate = pPortDef->format.video.xFramerate >> 16;
+		if (nFramerate == 0)
+			nFramerate = PROXY_ADMIT_FPS;
+		*pnPrev = pCompPrv->proxyPortBuffers[pPortDef->nPortIndex].
+		    nAdmitMbs;
+		pCompPrv->proxyPortBuffers[pPortDef->nPortIndex].nAdmitMbs =
+		    PROXY_LOAD_MBS(pPortDef->format.video.nFrameWidth,
+		    pPortDef->format.video.nFrameHeight) * nFramerate;
+		eError = PROXY_AdmitUpdate(pCompPrv);
+		if (eError != OMX_ErrorNone)
+			pCompPrv->proxyPortBuffers[pPortDef->nPortIndex].
+			    nAdmitMbs = *pnPrev;
+	} else if (nParamIndex == OMX_IndexParamVideoAvc)
+	{
+		pAvc = (OMX_VIDEO_PARAM_AVCTYPE *) pParamStruct;
+		*pnPrev = pCompPrv->bAdmitHighProfile;
+		pCompPrv->bAdmitHighProfile =
+		    (pAvc->eProfile >= OMX_VIDEO_AVCProfileHigh &&
+		    pAvc->eProfile <= OMX_VIDEO_AVCProfileHigh444) ?
+		    OMX_TRUE : OMX_FALSE;
+		eError = PROXY_AdmitUpdate(pCompPrv);
+		if (eError != OMX_ErrorNone)
+			pCompPrv->bAdmitHighProfile = (OMX_BOOL) *pnPrev;
+	}
+	return eError;
+}
+
+/*Puts back what PROXY_AdmitParam took, the reservation can only shrink */
+static void PROXY_AdmitParamRevert(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_INDEXTYPE nParamIndex, OMX_PTR pParamStruct, OMX_U32 nPrev)
+{
+	OMX_U32 nPort = 0;
+
+	if (nParamIndex == OMX_IndexParamPortDefinition)
+	{
+		nPort = ((OMX_PARAM_PORTDEFINITIONTYPE *) pParamStruct)->
+		    nPortIndex;
+		if (nPort >= PROXY_MAXNUMOFPORTS)
+			return;
+		pCompPrv->proxyPortBuffers[nPort].nAdmitMbs = nPrev;
+	} else if (nParamIndex == OMX_IndexParamVideoAvc)
+		pCompPrv->bAdmitHighProfile = (OMX_BOOL) nPrev;
+	else
+		return;
+	PROXY_AdmitUpdate(pCompPrv);
+}
+
+static void PROXY_AdmitRelease(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	OMX_U32 i = 0;
+
+	for (i = 0; i < PROXY_MAXNUMOFPORTS; i++)
+		pCompPrv->proxyPortBuffers[i].nAdmitMbs = 0;
+	PROXY_AdmitUpdate(pCompPrv);
+}
+
+/*Status page, one page the remote component publishes its state, enabled
+  ports, held buffers and errors in, read here without an RPC. Remote
+  components that do not know OMX_TI_IndexParamStatusPage refuse it and
+  everything keeps going through RPC. The remote side bumps nSequence before
+  and after each update, a copy taken while the count was odd or changed
+  underneath is thrown away */
+#define PROXY_STATUSPAGE_READ_RETRIES 4
+
+#ifdef USE_ION
+/*Whether the remote side takes a shared buffer index, learnt from the first
+  instance of the process that hands one over. Once refused, later instances
+  skip the allocation, registration and SetParameter altogether */
+typedef enum PROXY_SHARED_SUPPORT
+{
+	PROXY_SHARED_UNKNOWN = 0,
+	PROXY_SHARED_ACCEPTED,
+	PROXY_SHARED_REFUSED
+} PROXY_SHARED_SUPPORT;
+
+static volatile PROXY_SHARED_SUPPORT gStatusPageSupport =
+    PROXY_SHARED_UNKNOWN;
+static volatile PROXY_SHARED_SUPPORT gStructScratchSupport =
+    PROXY_SHARED_UNKNOWN;
+
+/*Shared buffers are on unless debug.domx.shared_buffers is set to 0 */
+static OMX_BOOL PROXY_SharedBuffEnabled(void)
+{
+	char *val = getenv("DEBUG_DOMX_SHARED_BUFFERS");
+#ifdef _Android
+	char value[PROPERTY_VALUE_MAX];
+
+	if (val == NULL)
+	{
+		property_get("debug.domx.shared_buffers", value, "1");
+		val = value;
+	}
+#endif
+	return (val == NULL || atoi(val) > 0) ? OMX_TRUE : OMX_FALSE;
+}
+
+/*Registers a buffer of the proxy with the current remote instance and hands
+  it over with nIndex. Returns the registration, NULL if the remote component
+  refused the buffer. A refusal by the component itself, as opposed to a
+  failed registration or RPC, is kept in pSupport */
+static OMX_PTR PROXY_SharedBuffAttach(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    MEMPLUGIN_BUFFER_ACCESSOR * pBuf, OMX_INDEXTYPE nIndex, OMX_U32 nSize,
+    volatile PROXY_SHARED_SUPPORT * pSupport)
+{
+	OMX_TI_CONFIG_SHAREDBUFFER tShared;
+	OMX_ERRORTYPE eCompReturn = OMX_ErrorNone;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	OMX_PTR pRegistered = NULL;
+
+	eRPCError = RPC_RegisterBuffer(pCompPrv->hRemoteComp,
+	    pBuf->bufferFd, -1, &pRegistered, NULL, IONPointers);
+	if (eRPCError != RPC_OMX_ErrorNone || pRegistered == NULL)
+		return NULL;
+
+	tShared.nSize = sizeof(OMX_TI_CONFIG_SHAREDBUFFER);
+	tShared.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+	tShared.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+	tShared.nVersion.s.nRevision = 0x0;
+	tShared.nVersion.s.nStep = 0x0;
+	tShared.nPortIndex = OMX_ALL;
+	tShared.nSharedBuffSize = nSize;
+	tShared.pSharedBuff = (OMX_U8 *) pRegistered;
+	eRPCError = RPC_SetParameter(pCompPrv->hRemoteComp, nIndex, &tShared,
+	    &(tShared.pSharedBuff), 1, &eCompReturn);
+	if (eRPCError != RPC_OMX_ErrorNone || eCompReturn != OMX_ErrorNone)
+	{
+		DOMX_DEBUG("%s: index 0x%x refused, RPC error 0x%x, component "
+		    "error 0x%x", pCompPrv->cCompName, nIndex, eRPCError,
+		    eCompReturn);
+		RPC_UnRegisterBuffer(pCompPrv->hRemoteComp, pRegistered, NULL,
+		    IONPointers);
+		if (eRPCError == RPC_OMX_ErrorNone)
+			*pSupport = PROXY_SHARED_REFUSED;
+		return NULL;
+	}
+	*pSupport = PROXY_SHARED_ACCEPTED;
+	return pRegistered;
+}
+
+/*Registers the page with the current remote instance and hands it over,
+  the registration is held until PROXY_StatusPageClose */
+static void PROXY_StatusPageAttach(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	pCompPrv->pStatusPage = NULL;
+	pCompPrv->tStatusPage.pRegBufferHandle = NULL;
+	if (pCompPrv->tStatusPage.pBufferMappedAddress == NULL)
+		return;
+	TIMM_OSAL_Memset(pCompPrv->tStatusPage.pBufferMappedAddress, 0,
+	    sizeof(OMX_TI_STATUSPAGE));
+
+	pCompPrv->tStatusPage.pRegBufferHandle =
+	    PROXY_SharedBuffAttach(pCompPrv, &pCompPrv->tStatusPage,
+	    (OMX_INDEXTYPE) OMX_TI_IndexParamStatusPage,
+	    sizeof(OMX_TI_STATUSPAGE), &gStatusPageSupport);
+	if (pCompPrv->tStatusPage.pRegBufferHandle == NULL)
+		return;
+	pCompPrv->pStatusPage = (volatile OMX_TI_STATUSPAGE *)
+	    pCompPrv->tStatusPage.pBufferMappedAddress;
+}
+
+/*The page is read without cache maintenance (there is no cache API on the
+  rpmsg path), so it has to come from the carveout heap the plugin uses by
+  default, which ION maps to user space uncached. That is why it is opened
+  before MemPlugin_ConfigureComponent can point the plugin at another heap,
+  and why a page the plugin fell back to tiler for is not used */
+static void PROXY_StatusPageOpen(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	MEMPLUGIN_BUFFER_PARAMS tParams;
+	MEMPLUGIN_BUFFER_PROPERTIES tProp;
+
+	if (gStatusPageSupport == PROXY_SHARED_REFUSED ||
+	    !PROXY_SharedBuffEnabled())
+		return;
+	MEMPLUGIN_BUFFER_PARAMS_INIT(tParams);
+	tParams.nWidth = LINUX_PAGE_SIZE;
+	tParams.bMap = OMX_TRUE;
+	if (MemPlugin_Alloc(pCompPrv->pMemPluginHandle,
+		pCompPrv->nMemmgrClientDesc, &tParams,
+		&tProp) != MEMPLUGIN_ERROR_NONE)
+		return;
+	pCompPrv->tStatusPage = tProp.sBuffer_accessor;
+	if (tParams.eBuffer_type == DEFAULT)
+		PROXY_StatusPageAttach(pCompPrv);
+	if (pCompPrv->pStatusPage == NULL)
+	{
+		MemPlugin_Free(pCompPrv->pMemPluginHandle,
+		    pCompPrv->nMemmgrClientDesc, &tParams, &tProp);
+		TIMM_OSAL_Memset(&pCompPrv->tStatusPage, 0,
+		    sizeof(pCompPrv->tStatusPage));
+	}
+}
+
+/*Before MemPlugin_Close and while the remote instance is still there */
+static void PROXY_StatusPageClose(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	MEMPLUGIN_BUFFER_PARAMS tParams;
+	MEMPLUGIN_BUFFER_PROPERTIES tProp;
+
+	if (pCompPrv->tStatusPage.pBufferMappedAddress == NULL)
+		return;
+	pCompPrv->pStatusPage = NULL;
+	if (pCompPrv->tStatusPage.pRegBufferHandle != NULL)
+		RPC_UnRegisterBuffer(pCompPrv->hRemoteComp,
+		    pCompPrv->tStatusPage.pRegBufferHandle, NULL, IONPointers);
+
+	MEMPLUGIN_BUFFER_PARAMS_INIT(tParams);
+	tParams.nWidth = LINUX_PAGE_SIZE;
+	tParams.bMap = OMX_TRUE;
+	tProp.sBuffer_accessor = pCompPrv->tStatusPage;
+	MemPlugin_Free(pCompPrv->pMemPluginHandle, pCompPrv->nMemmgrClientDesc,
+	    &tParams, &tProp);
+	TIMM_OSAL_Memset(&pCompPrv->tStatusPage, 0,
+	    sizeof(pCompPrv->tStatusPage));
+}
+#else
+#define PROXY_StatusPageAttach(pCompPrv)
+#define PROXY_StatusPageOpen(pCompPrv)
+#define PROXY_StatusPageClose(pCompPrv)
+#endif
+
+/*Scratch buffer for param and config structures too large for an RPC
+  packet, the packet then only says where in the buffer the structure is
+  (see RPC_StructPut). The remote side maps the buffer once when it is
+  handed over. Remote components that do not know
+  OMX_TI_IndexParamStructScratch refuse it and such structures are not
+  sent, later instances of the process then do not allocate one at all. The
+  buffer comes from the same uncached heap as the status page, neither side
+  needs cache maintenance */
+#ifdef USE_ION
+static void PROXY_StructScratchAttach(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	RPC_OMX_CONTEXT *pRPCCtx = (RPC_OMX_CONTEXT *) pCompPrv->hRemoteComp;
+
+	pRPCCtx->pStructScratch = NULL;
+	pRPCCtx->nStructScratchSize = 0;
+	pCompPrv->tStructScratch.pRegBufferHandle = NULL;
+	if (pCompPrv->tStructScratch.pBufferMappedAddress == NULL)
+		return;
+
+	pCompPrv->tStructScratch.pRegBufferHandle =
+	    PROXY_SharedBuffAttach(pCompPrv, &pCompPrv->tStructScratch,
+	    (OMX_INDEXTYPE) OMX_TI_IndexParamStructScratch,
+	    RPC_STRUCT_SCRATCH_SIZE, &gStructScratchSupport);
+	if (pCompPrv->tStructScratch.pRegBufferHandle == NULL)
+		return;
+	pRPCCtx->nStructScratchSize = RPC_STRUCT_SCRATCH_SIZE;
+	pRPCCtx->pStructScratch =
+	    (OMX_U8 *) pCompPrv->tStructScratch.pBufferMappedAddress;
+}
+
+static void PROXY_StructScratchOpen(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	MEMPLUGIN_BUFFER_PARAMS tParams;
+	MEMPLUGIN_BUFFER_PROPERTIES tProp;
+
+	if (gStructScratchSupport == PROXY_SHARED_REFUSED ||
+	    !PROXY_SharedBuffEnabled())
+		return;
+	MEMPLUGIN_BUFFER_PARAMS_INIT(tParams);
+	tParams.nWidth = RPC_STRUCT_SCRATCH_SIZE;
+	tParams.bMap = OMX_TRUE;
+	if (MemPlugin_Alloc(pCompPrv->pMemPluginHandle,
+		pCompPrv->nMemmgrClientDesc, &tParams,
+		&tProp) != MEMPLUGIN_ERROR_NONE)
+		return;
+	pCompPrv->tStructScratch = tProp.sBuffer_accessor;
+	if (tParams.eBuffer_type == DEFAULT)
+		PROXY_StructScratchAttach(pCompPrv);
+	if (pCompPrv->tStructScratch.pRegBufferHandle == NULL)
+	{
+		MemPlugin_Free(pCompPrv->pMemPluginHandle,
+		    pCompPrv->nMemmgrClientDesc, &tParams, &tProp);
+		TIMM_OSAL_Memset(&pCompPrv->tStructScratch, 0,
+		    sizeof(pCompPrv->tStructScratch));
+	}
+}
+
+/*Before MemPlugin_Close and while the remote instance is still there */
+static void PROXY_StructScratchClose(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	RPC_OMX_CONTEXT *pRPCCtx = (RPC_OMX_CONTEXT *) pCompPrv->hRemoteComp;
+	MEMPLUGIN_BUFFER_PARAMS tParams;
+	MEMPLUGIN_BUFFER_PROPERTIES tProp;
+
+	if (pCompPrv->tStructScratch.pBufferMappedAddress == NULL)
+		return;
+	pRPCCtx->pStructScratch = NULL;
+	pRPCCtx->nStructScratchSize = 0;
+	if (pCompPrv->tStructScratch.pRegBufferHandle != NULL)
+		RPC_UnRegisterBuffer(pCompPrv->hRemoteComp,
+		    pCompPrv->tStructScratch.pRegBufferHandle, NULL,
+		    IONPointers);
+
+	MEMPLUGIN_BUFFER_PARAMS_INIT(tParams);
+	tParams.nWidth = RPC_STRUCT_SCRATCH_SIZE;
+	tParams.bMap = OMX_TRUE;
+	tProp.sBuffer_accessor = pCompPrv->tStructScratch;
+	MemPlugin_Free(pCompPrv->pMemPluginHandle, pCompPrv->nMemmgrClientDesc,
+	    &tParams, &tProp);
+	TIMM_OSAL_Memset(&pCompPrv->tStructScratch, 0,
+	    sizeof(pCompPrv->tStructScratch));
+}
+#else
+#define PROXY_StructScratchAttach(pCompPrv)
+#define PROXY_StructScratchOpen(pCompPrv)
+#define PROXY_StructScratchClose(pCompPrv)
+#endif
+
+/*Copies the status page, OMX_FALSE when there is none, the remote side has
+  not filled it in yet or kept writing to it */
+static OMX_BOOL PROXY_StatusPageRead(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_TI_STATUSPAGE * pStatus)
+{
+	volatile OMX_TI_STATUSPAGE *pPage = pCompPrv->pStatusPage;
+	OMX_U32 nSequence = 0, i = 0;
+
+	if (pPage == NULL || pPage->nMagic != OMX_TI_STATUSPAGE_MAGIC)
+		return OMX_FALSE;
+	for (i = 0; i < PROXY_STATUSPAGE_READ_RETRIES; i++)
+	{
+		nSequence = pPage->nSequence;
+		if (nSequence & 1)
+			continue;
+		__sync_synchronize();
+		TIMM_OSAL_Memcpy(pStatus, (void *)pPage, sizeof(*pStatus));
+		__sync_synchronize();
+		if (pPage->nSequence == nSequence)
+			return OMX_TRUE;
+	}
+	return OMX_FALSE;
+}
+
+/*Remote instance recovery, off unless debug.domx.recovery is set. The
+  SetParameter and SetConfig calls of the client are kept so that when the
+  remote core dies while the component is still in Loaded state without
+  buffers, a fresh remote instance is set up the same way behind the
+  client's back. Anything further along has buffers and a remote state
+  that cannot be rebuilt from here, the client gets OMX_ErrorHardware */
+#define PROXY_RECOVERY_ENTRIES 64
+#define PROXY_RECOVERY_MAX_STRUCT 512
+#define PROXY_RECOVERY_RETRIES 50
+#define PROXY_RECOVERY_RETRY_US 100000
+
+typedef struct PROXY_RECOVERY_ENTRY
+{
+	OMX_BOOL bConfig;
+	OMX_INDEXTYPE nIndex;
+	OMX_U32 nPortKey;
+	OMX_U32 nSize;
+	OMX_U8 aData[PROXY_RECOVERY_MAX_STRUCT];
+} PROXY_RECOVERY_ENTRY;
+
+typedef struct PROXY_RECOVERY
+{
+	pthread_mutex_t tLock;
+	pthread_cond_t tDone;
+	volatile OMX_BOOL bRecovering;
+	OMX_BOOL bThreadValid;
+	pthread_t tThread;
+	OMX_BOOL bIncomplete;	/*a call could not be kept, no recovery */
+	OMX_U32 nEntries;
+	PROXY_RECOVERY_ENTRY tEntries[PROXY_RECOVERY_ENTRIES];
+} PROXY_RECOVERY;
+
+static OMX_BOOL PROXY_RecoveryEnabled(void)
+{
+	char *val = getenv("DEBUG_DOMX_RECOVERY");
+#ifdef _Android
+	char value[PROPERTY_VALUE_MAX];
+
+	if (val == NULL)
+	{
+		property_get("debug.domx.recovery", value, "0");
+		val = value;
+	}
+#endif
+	return (val != NULL && atoi(val) > 0) ? OMX_TRUE : OMX_FALSE;
+}
+
+/*Keeps a call the remote side accepted, a newer one for the same index and
+  port replaces the older and moves to the end to keep the order */
+static void PROXY_RecoveryRecord(PROXY_COMPONENT_PRIVATE * pCompPrv,
+    OMX_BOOL bConfig, OMX_INDEXTYPE nIndex, OMX_PTR pStruct,
+    OMX_PTR pLocBufNeedMap)
+{
+	PROXY_RECOVERY *pRec = pCompPrv->pRecovery;
+	OMX_U32 nSize = 0, nPortKey = 0, i = 0;
+
+	if (pRec == NULL)
+		return;
+	/*One shot requests, nothing to restore */
+	if (bConfig && nIndex == OMX_IndexConfigVideoIntraVOPRefresh)
+		return;
+
+	nSize = *((OMX_U32 *) pStruct);
+	pthread_mutex_lock(&pRec->tLock);
+	if (pLocBufNeedMap != NULL || nSize < sizeof(OMX_U32) ||
+	    nSize > PROXY_RECOVERY_MAX_STRUCT)
+	{
+		/*Buffers mapped for the call or a structure not kept */
+		pRec->bIncomplete = OMX_TRUE;
+		goto EXIT;
+	}
+	/*The port index follows nSize and nVersion in most structures */
+	if (nSize >= 3 * sizeof(OMX_U32))
+		nPortKey = ((OMX_U32 *) pStruct)[2];
+
+	for (i = 0; i < pRec->nEntries; i++)
+	{
+		if (pRec->tEntries[i].bConfig == bConfig &&
+		    pRec->tEntries[i].nIndex == nIndex &&
+		    pRec->tEntries[i].nPortKey == nPortKey)
+			break;
+	}
+	if (i < pRec->nEntries)
+	{
+		memmove(&pRec->tEntries[i], &pRec->tEntries[i + 1],
+		    (pRec->nEntries - i - 1) * sizeof(PROXY_RECOVERY_ENTRY));
+		pRec->nEntries--;
+	}
+	if (pRec->nEntries == PROXY_RECOVERY_ENTRIES)
+	{
+		pRec->bIncomplete = OMX_TRUE;
+		goto EXIT;
+	}
+
+	pRec->tEntries[pRec->nEntries].bConfig = bConfig;
+	pRec->tEntries[pRec->nEntries].nIndex = nIndex;
+	pRec->tEntries[pRec->nEntries].nPortKey = nPortKey;
+	pRec->tEntries[pRec->nEntries].nSize = nSize;
+	TIMM_OSAL_Memcpy(pRec->tEntries[pRec->nEntries].aData, pStruct, nSize);
+	pRec->nEntries++;
+
+      EXIT:
+	pthread_mutex_unlock(&pRec->tLock);
+}
+
+/*Client calls made while a recovery runs wait for its outcome */
+static void PROXY_RecoveryWait(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	PROXY_RECOVERY *pRec = pCompPrv->pRecovery;
+
+	if (pRec == NULL || !pRec->bRecovering)
+		return;
+	pthread_mutex_lock(&pRec->tLock);
+	while (pRec->bRecovering)
+		pthread_cond_wait(&pRec->tDone, &pRec->tLock);
+	pthread_mutex_unlock(&pRec->tLock);
+}
+
+static void *PROXY_RecoveryThread(void *pArg)
+{
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) pArg;
+	PROXY_COMPONENT_PRIVATE *pCompPrv =
+	    (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+	PROXY_RECOVERY *pRec = pCompPrv->pRecovery;
+	PROXY_RECOVERY_ENTRY *pEntry = NULL;
+	OMX_HANDLETYPE hRemoteComp = NULL, hOldRemoteComp = NULL;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	OMX_ERRORTYPE eCompReturn = OMX_ErrorNone;
+	OMX_BOOL bRecovered = OMX_FALSE;
+	OMX_U32 i = 0;
+
+	/*Connecting fails until the remote processor has been reloaded */
+	for (i = 0; i < PROXY_RECOVERY_RETRIES; i++)
+	{
+		hRemoteComp = NULL;
+		eRPCError = RPC_InstanceInit(pCompPrv->cCompName, &hRemoteComp);
+		if (eRPCError == RPC_OMX_ErrorNone && hRemoteComp != NULL)
+			break;
+		hRemoteComp = NULL;
+		usleep(PROXY_RECOVERY_RETRY_US);
+	}
+	if (hRemoteComp == NULL)
+	{
+		DOMX_ERROR("%s: remote core did not come back",
+		    pCompPrv->cCompName);
+		goto EXIT;
+	}
+	/*Keep the remote pool picked for the old instance */
+	((RPC_OMX_CONTEXT *) hRemoteComp)->nPoolId =
+	    ((RPC_OMX_CONTEXT *) pCompPrv->hRemoteComp)->nPoolId;
+
+	eRPCError = RPC_GetHandle(hRemoteComp, pCompPrv->cCompName,
+	    (OMX_PTR) hComp, NULL, &eCompReturn);
+	if (eRPCError != RPC_OMX_ErrorNone || eCompReturn != OMX_ErrorNone)
+	{
+		DOMX_ERROR("%s: GetHandle failed on the new remote instance",
+		    pCompPrv->cCompName);
+		RPC_InstanceDeInit(hRemoteComp);
+		goto EXIT;
+	}
+
+	/*The client is held in PROXY_RecoveryWait, the history stays put */
+	for (i = 0; i < pRec->nEntries; i++)
+	{
+		pEntry = &pRec->tEntries[i];
+		eCompReturn = OMX_ErrorNone;
+		if (pEntry->bConfig)
+			eRPCError = RPC_SetConfig(hRemoteComp, pEntry->nIndex,
+			    pEntry->aData, NULL, &eCompReturn);
+		else
+			eRPCError = RPC_SetParameter(hRemoteComp,
+			    pEntry->nIndex, pEntry->aData, NULL, 0,
+			    &eCompReturn);
+		if (eRPCError != RPC_OMX_ErrorNone ||
+		    eCompReturn != OMX_ErrorNone)
+		{
+			DOMX_ERROR("%s: replaying index 0x%x failed, RPC "
+			    "error 0x%x, component error 0x%x",
+			    pCompPrv->cCompName, pEntry->nIndex, eRPCError,
+			    eCompReturn);
+			RPC_FreeHandle(hRemoteComp, &eCompReturn);
+			RPC_InstanceDeInit(hRemoteComp);
+			goto EXIT;
+		}
+	}
+
+	hOldRemoteComp = pCompPrv->hRemoteComp;
+	pCompPrv->pStatusPage = NULL;
+	pCompPrv->hRemoteComp = hRemoteComp;
+	/*The registrations of the old instance go with it */
+	RPC_InstanceDeInit(hOldRemoteComp);
+	PROXY_StatusPageAttach(pCompPrv);
+	PROXY_StructScratchAttach(pCompPrv);
+	pCompPrv->bMapOnceProbed = OMX_FALSE;
+	pCompPrv->bFlushDoneProbed = OMX_FALSE;
+	PROXY_InvalidatePortDefinitions(pCompPrv);
+	bRecovered = OMX_TRUE;
+	DOMX_WARN("%s: new remote instance set up, %d calls replayed",
+	    pCompPrv->cCompName, pRec->nEntries);
+
+      EXIT:
+	pthread_mutex_lock(&pRec->tLock);
+	pRec->bRecovering = OMX_FALSE;
+	pthread_cond_broadcast(&pRec->tDone);
+	pthread_mutex_unlock(&pRec->tLock);
+
+	if (!bRecovered)
+		pCompPrv->tCBFunc.EventHandler(hComp, pCompPrv->pILAppData,
+		    OMX_EventError, OMX_ErrorHardware, 0, NULL);
+	return NULL;
+}
+
+/*Returns OMX_TRUE if a recovery runs for the OMX_ErrorHardware just
+  reported, the client does not get to see it then */
+static OMX_BOOL PROXY_RecoveryStart(OMX_HANDLETYPE hComponent,
+    PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	PROXY_RECOVERY *pRec = pCompPrv->pRecovery;
+	OMX_BOOL bStarted = OMX_FALSE;
+
+	if (pRec == NULL)
+		return OMX_FALSE;
+
+	pthread_mutex_lock(&pRec->tLock);
+	if (pRec->bRecovering)
+	{
+		bStarted = OMX_TRUE;
+		goto EXIT;
+	}
+	if (pRec->bIncomplete || pCompPrv->nStatePending != 0 ||
+	    pCompPrv->eState != OMX_StateLoaded ||
+	    pCompPrv->nAllocatedBuffers != 0)
+	{
+		DOMX_WARN("%s: past Loaded state or history incomplete, "
+		    "no recovery", pCompPrv->cCompName);
+		goto EXIT;
+	}
+	/*A previous recovery already signalled it is done */
+	if (pRec->bThreadValid)
+		pthread_join(pRec->tThread, NULL);
+	pRec->bThreadValid = OMX_FALSE;
+
+	pRec->bRecovering = OMX_TRUE;
+	if (pthread_create(&pRec->tThread, NULL, PROXY_RecoveryThread,
+		hComponent) != 0)
+	{
+		pRec->bRecovering = OMX_FALSE;
+		goto EXIT;
+	}
+	pRec->bThreadValid = OMX_TRUE;
+	bStarted = OMX_TRUE;
+
+      EXIT:
+	pthread_mutex_unlock(&pRec->tLock);
+	return bStarted;
+}
+
 /* ===========================================================================*/
 /**
  * @name PROXY_EventHandler()
@@ -360,13 +2325,13 @@ OMX_ERRORTYPE PROXY_EventHandler(OMX_HANDLETYPE hComponent,
 		/*find local buffer header equivalent */
 		for (count = 0; count < pCompPrv->nTotalBuffers; ++count)
 		{
-			if (pCompPrv->tBufList[count].pBufHeaderRemote ==
+			if (PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeaderRemote ==
 			    nData1)
 			{
 				pLocalBufHdr =
-				    pCompPrv->tBufList[count].pBufHeader;
+				    PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader;
 				pLocalBufHdr->pBuffer =
-				    (OMX_U8 *) pCompPrv->tBufList[count].
+				    (OMX_U8 *) PROXY_BUFLIST_ENTRY(pCompPrv, count).
 				    pBufferActual;
 				break;
 			}
@@ -386,7 +2351,42 @@ OMX_ERRORTYPE PROXY_EventHandler(OMX_HANDLETYPE hComponent,
 		pTmpData = pEventData;
 		pEventData =
 		    ((PROXY_MARK_DATA *) pEventData)->pMarkDataActual;
-		TIMM_OSAL_Free(pTmpData);
+		PROXY_MarkDataFree(pTmpData);
+		break;
+
+	case OMX_EventCmdComplete:
+		if (nData1 == OMX_CommandStateSet)
+		{
+			pCompPrv->eState = (OMX_STATETYPE) nData2;
+			__sync_fetch_and_add(&pCompPrv->nStateEpoch, 1);
+			if (pCompPrv->nStatePending != 0)
+				__sync_fetch_and_sub(&pCompPrv->nStatePending, 1);
+		}
+		if (nData1 == OMX_CommandFlush || nData1 == OMX_CommandPortDisable)
+			PROXY_ReportRemoteBuffers(pCompPrv, nData2);
+		else if (nData1 == OMX_CommandStateSet &&
+		    (nData2 == OMX_StateIdle || nData2 == OMX_StateLoaded))
+			PROXY_ReportRemoteBuffers(pCompPrv, OMX_ALL);
+		PROXY_InvalidatePortDefinitions(pCompPrv);
+		break;
+
+	case OMX_EventPortSettingsChanged:
+		/*A crop update leaves the port definitions as they were */
+		if (nData2 != (OMX_U32) OMX_IndexConfigCommonOutputCrop)
+			PROXY_InvalidatePortDefinitions(pCompPrv);
+		break;
+
+	case OMX_EventError:
+		if (nData1 == (OMX_U32) OMX_ErrorHardware &&
+		    PROXY_RecoveryStart(hComponent, pCompPrv))
+		{
+			DOMX_WARN("%s: remote core lost, recovering",
+			    pCompPrv->cCompName);
+			goto LEAVE;
+		}
+		/*A failed transition or a move to Invalid is not reported
+		  through CmdComplete, ask the remote side next time */
+		pCompPrv->bStateKnown = OMX_FALSE;
 		break;
 
 	default:
@@ -404,6 +2404,7 @@ OMX_ERRORTYPE PROXY_EventHandler(OMX_HANDLETYPE hComponent,
 		    pCompPrv->pILAppData, OMX_EventError, eError, 0, NULL);
 	}
 
+      LEAVE:
 	DOMX_EXIT("eError: %d", eError);
 	return OMX_ErrorNone;
 }
@@ -426,6 +2427,7 @@ static OMX_ERRORTYPE PROXY_EmptyBufferDone(OMX_HANDLETYPE hComponent,
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	OMX_U16 count;
 	OMX_BUFFERHEADERTYPE *pBufHdr = NULL;
+	DOMX_TRACE_BEGIN(remoteBufHdr);
 
 	PROXY_require((hComp->pComponentPrivate != NULL),
 	    OMX_ErrorBadParameter,
@@ -437,28 +2439,27 @@ static OMX_ERRORTYPE PROXY_EmptyBufferDone(OMX_HANDLETYPE hComponent,
 	    ("hComponent=%p, pCompPrv=%p, remoteBufHdr=%p, nFilledLen=%d, nOffset=%d, nFlags=%08x",
 	    hComponent, pCompPrv, remoteBufHdr, nfilledLen, nOffset, nFlags);
 
-	for (count = 0; count < pCompPrv->nTotalBuffers; ++count)
-	{
-		if (pCompPrv->tBufList[count].pBufHeaderRemote ==
-		    remoteBufHdr)
-		{
-			pBufHdr = pCompPrv->tBufList[count].pBufHeader;
-			pBufHdr->nFilledLen = nfilledLen;
-			pBufHdr->nOffset = nOffset;
-			pBufHdr->nFlags = nFlags;
-			/* Setting mark info to NULL. This would always be
-			   NULL in EBD, whether component has propagated the
-			   mark or has generated mark event */
-			pBufHdr->hMarkTargetComponent = NULL;
-			pBufHdr->pMarkData = NULL;
-			break;
-		}
-	}
+	count = PROXY_FindBufferByRemote(pCompPrv, remoteBufHdr);
 	PROXY_assert((count != pCompPrv->nTotalBuffers),
 	    OMX_ErrorBadParameter,
 	    "Received invalid-buffer header from OMX component");
 
-	KPI_OmxCompBufferEvent(KPI_BUFFER_EBD, hComponent, &(pCompPrv->tBufList[count]));
+	pBufHdr = PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader;
+	/*Still delivered, the client must get its buffer back either way */
+	if (!PROXY_BufferSetOwner(pCompPrv, count, PROXY_BUFFER_OWNER_REMOTE,
+		PROXY_BUFFER_OWNER_CLIENT))
+		DOMX_ERROR("EBD of buffer %p that was not sent", pBufHdr);
+	pBufHdr->nFilledLen = nfilledLen;
+	pBufHdr->nOffset = nOffset;
+	pBufHdr->nFlags = nFlags;
+	/* Setting mark info to NULL. This would always be
+	   NULL in EBD, whether component has propagated the
+	   mark or has generated mark event */
+	pBufHdr->hMarkTargetComponent = NULL;
+	pBufHdr->pMarkData = NULL;
+
+	KPI_OmxCompBufferEvent(KPI_BUFFER_EBD, hComponent,
+	    &(PROXY_BUFLIST_ENTRY(pCompPrv, count)));
 
       EXIT:
 	if (eError == OMX_ErrorNone)
@@ -472,6 +2473,7 @@ static OMX_ERRORTYPE PROXY_EmptyBufferDone(OMX_HANDLETYPE hComponent,
 	}
 
 	DOMX_EXIT("eError: %d", eError);
+	DOMX_TRACE_END();
 	return OMX_ErrorNone;
 }
 
@@ -495,7 +2497,10 @@ OMX_ERRORTYPE PROXY_FillBufferDone(OMX_HANDLETYPE hComponent,
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	OMX_U16 count;
+	OMX_U32 nPort = 0;
+	OMX_BOOL bPartial = OMX_FALSE;
 	OMX_BUFFERHEADERTYPE *pBufHdr = NULL;
+	DOMX_TRACE_BEGIN(remoteBufHdr);
 
 	PROXY_require((hComp->pComponentPrivate != NULL),
 	    OMX_ErrorBadParameter,
@@ -507,38 +2512,55 @@ OMX_ERRORTYPE PROXY_FillBufferDone(OMX_HANDLETYPE hComponent,
 	    ("hComponent=%p, pCompPrv=%p, remoteBufHdr=%p, nFilledLen=%d, nOffset=%d, nFlags=%08x",
 	    hComponent, pCompPrv, remoteBufHdr, nfilledLen, nOffset, nFlags);
 
-	for (count = 0; count < pCompPrv->nTotalBuffers; ++count)
-	{
-		if (pCompPrv->tBufList[count].pBufHeaderRemote ==
-		    remoteBufHdr)
-		{
-			pBufHdr = pCompPrv->tBufList[count].pBufHeader;
-			pBufHdr->nFilledLen = nfilledLen;
-			pBufHdr->nOffset = nOffset;
-			pBufHdr->nFlags = nFlags;
-			pBufHdr->nTimeStamp = nTimeStamp;
-			if (pMarkData != NULL)
-			{
-				/*Update mark info in the buffer header */
-				pBufHdr->pMarkData =
-				    ((PROXY_MARK_DATA *)
-				    pMarkData)->pMarkDataActual;
-				pBufHdr->hMarkTargetComponent =
-				    ((PROXY_MARK_DATA *)
-				    pMarkData)->hComponentActual;
-				TIMM_OSAL_Free(pMarkData);
-			}
-			break;
-		}
-	}
+	count = PROXY_FindBufferByRemote(pCompPrv, remoteBufHdr);
 	PROXY_assert((count != pCompPrv->nTotalBuffers),
 	    OMX_ErrorBadParameter,
 	    "Received invalid-buffer header from OMX component");
 
-	KPI_OmxCompBufferEvent(KPI_BUFFER_FBD, hComponent, &(pCompPrv->tBufList[count]));
+	pBufHdr = PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader;
+	nPort = PROXY_BUFLIST_ENTRY(pCompPrv, count).nPortIndex;
+	if (nPort < PROXY_MAXNUMOFPORTS && pMarkData == NULL &&
+	    PROXY_IS_PARTIAL_FBD(&(pCompPrv->proxyPortBuffers[nPort]), nFlags,
+		nfilledLen))
+	{
+		pBufHdr->nFilledLen = nfilledLen;
+		pBufHdr->nOffset = nOffset;
+		pBufHdr->nTimeStamp = nTimeStamp;
+		bPartial = OMX_TRUE;
+		goto EXIT;
+	}
+	/*Still delivered, the client must get its buffer back either way */
+	if (!PROXY_BufferSetOwner(pCompPrv, count, PROXY_BUFFER_OWNER_REMOTE,
+		PROXY_BUFFER_OWNER_CLIENT))
+		DOMX_ERROR("FBD of buffer %p that was not sent", pBufHdr);
+	pBufHdr->nFilledLen = nfilledLen;
+	pBufHdr->nOffset = nOffset;
+	pBufHdr->nFlags = nFlags;
+	pBufHdr->nTimeStamp = nTimeStamp;
+	if (nPort < PROXY_MAXNUMOFPORTS &&
+	    pCompPrv->proxyPortBuffers[nPort].bOutSizeTrack)
+		PROXY_OutSizeRecord(&(pCompPrv->proxyPortBuffers[nPort]), pBufHdr);
+	if (pMarkData != NULL)
+	{
+		/*Update mark info in the buffer header */
+		pBufHdr->pMarkData =
+		    ((PROXY_MARK_DATA *) pMarkData)->pMarkDataActual;
+		pBufHdr->hMarkTargetComponent =
+		    ((PROXY_MARK_DATA *) pMarkData)->hComponentActual;
+		PROXY_MarkDataFree(pMarkData);
+	}
+
+	KPI_OmxCompBufferEvent(KPI_BUFFER_FBD, hComponent,
+	    &(PROXY_BUFLIST_ENTRY(pCompPrv, count)));
 
       EXIT:
-	if (eError == OMX_ErrorNone)
+	if (eError == OMX_ErrorNone && bPartial)
+	{
+		pCompPrv->tCBFunc.EventHandler(hComponent,
+		    pCompPrv->pILAppData,
+		    (OMX_EVENTTYPE) OMX_TI_EventPartialFrame, nPort,
+		    nfilledLen, pBufHdr);
+	} else if (eError == OMX_ErrorNone)
 	{
 		pCompPrv->tCBFunc.FillBufferDone(hComponent,
 		    pCompPrv->pILAppData, pBufHdr);
@@ -549,9 +2571,108 @@ OMX_ERRORTYPE PROXY_FillBufferDone(OMX_HANDLETYPE hComponent,
 	}
 
 	DOMX_EXIT("eError: %d", eError);
+	DOMX_TRACE_END();
 	return OMX_ErrorNone;
 }
 
+/* ===========================================================================*/
+/**
+ * @name PROXY_FlushDone()
+ * @brief Hands back the buffers a flushed port returned in one message. Each
+ *        one goes through proxyEmptyBufferDone/proxyFillBufferDone as an
+ *        empty buffer, so proxies hooking those see flushed buffers as
+ *        before, only without one RPC message and wakeup per buffer.
+ * @param hComponent     : Proxy handle
+ * @param nPortIndex     : Port that was flushed
+ * @param eDir           : Direction of the port
+ * @param nCount         : Number of buffers returned
+ * @param pRemoteBufHdrs : Remote headers of the buffers
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE PROXY_FlushDone(OMX_HANDLETYPE hComponent,
+    OMX_U32 nPortIndex, OMX_DIRTYPE eDir, OMX_U32 nCount,
+    OMX_U32 * pRemoteBufHdrs)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	OMX_U32 i = 0;
+
+	PROXY_require((hComp->pComponentPrivate != NULL),
+	    OMX_ErrorBadParameter,
+	    "This is fatal error, processing cant proceed - please debug");
+
+	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+
+	DOMX_DEBUG("%s: flush of port %d returned %d buffers",
+	    pCompPrv->cCompName, nPortIndex, nCount);
+
+	for (i = 0; i < nCount; i++)
+	{
+		if (eDir == OMX_DirInput)
+			pCompPrv->proxyEmptyBufferDone(hComponent,
+			    pRemoteBufHdrs[i], 0, 0, 0);
+		else
+			pCompPrv->proxyFillBufferDone(hComponent,
+			    pRemoteBufHdrs[i], 0, 0, 0, 0, NULL, NULL);
+	}
+
+      EXIT:
+	return eError;
+}
+
+/*Offers the single flush-done message to the remote instance before its
+  first flush. Remote components that do not know the index refuse it and
+  keep returning flushed buffers one EBD/FBD at a time */
+static void PROXY_FlushDoneProbe(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	OMX_CONFIG_BOOLEANTYPE tFlushDone;
+	OMX_ERRORTYPE eCompReturn = OMX_ErrorNone;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+
+	pCompPrv->bFlushDoneProbed = OMX_TRUE;
+	tFlushDone.nSize = sizeof(OMX_CONFIG_BOOLEANTYPE);
+	tFlushDone.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+	tFlushDone.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+	tFlushDone.nVersion.s.nRevision = 0x0;
+	tFlushDone.nVersion.s.nStep = 0x0;
+	tFlushDone.bEnabled = OMX_TRUE;
+	eRPCError = RPC_SetParameter(pCompPrv->hRemoteComp,
+	    (OMX_INDEXTYPE) OMX_TI_IndexParamBulkFlushDone, &tFlushDone, NULL,
+	    0, &eCompReturn);
+	DOMX_DEBUG("%s: bulk flush done %s", pCompPrv->cCompName,
+	    (eRPCError == RPC_OMX_ErrorNone && eCompReturn == OMX_ErrorNone) ?
+	    "on" : "off");
+}
+
+/*Offers map-once ETBs to the remote instance the first time a buffer that
+  needs mapping is queued. Remote components that do not know the index
+  refuse it and get the buffer pointers with every ETB as before */
+static void PROXY_MapOnceProbe(PROXY_COMPONENT_PRIVATE * pCompPrv)
+{
+	OMX_CONFIG_BOOLEANTYPE tMapOnce;
+	OMX_ERRORTYPE eCompReturn = OMX_ErrorNone;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+
+	pCompPrv->bMapOnceProbed = OMX_TRUE;
+	tMapOnce.nSize = sizeof(OMX_CONFIG_BOOLEANTYPE);
+	tMapOnce.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+	tMapOnce.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+	tMapOnce.nVersion.s.nRevision = 0x0;
+	tMapOnce.nVersion.s.nStep = 0x0;
+	tMapOnce.bEnabled = OMX_TRUE;
+	eRPCError = RPC_SetParameter(pCompPrv->hRemoteComp,
+	    (OMX_INDEXTYPE) OMX_TI_IndexParamBufferMapOnce, &tMapOnce, NULL, 0,
+	    &eCompReturn);
+	((RPC_OMX_CONTEXT *) pCompPrv->hRemoteComp)->bMapOnce =
+	    (eRPCError == RPC_OMX_ErrorNone && eCompReturn == OMX_ErrorNone) ?
+	    OMX_TRUE : OMX_FALSE;
+	DOMX_DEBUG("%s: map-once ETBs %s", pCompPrv->cCompName,
+	    ((RPC_OMX_CONTEXT *) pCompPrv->hRemoteComp)->bMapOnce ?
+	    "on" : "off");
+}
+
 /* ===========================================================================*/
 /**
  * @name PROXY_EmptyThisBuffer()
@@ -575,6 +2696,8 @@ OMX_ERRORTYPE PROXY_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	OMX_PTR pMarkData = NULL;
 	OMX_BOOL bFreeMarkIfError = OMX_FALSE;
 	OMX_BOOL bIsProxy = OMX_FALSE , bMapBuffer;
+	OMX_BOOL bSent = OMX_FALSE;
+	DOMX_TRACE_BEGIN(pBufferHdr);
 
 	PROXY_require(pBufferHdr != NULL, OMX_ErrorBadParameter, NULL);
 	PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
@@ -589,14 +2712,8 @@ OMX_ERRORTYPE PROXY_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	    pBufferHdr->nOffset, pBufferHdr->nFlags);
 
 	/*First find the index of this buffer header to retrieve remote buffer header */
-	for (count = 0; count < pCompPrv->nTotalBuffers; count++)
-	{
-		if (pCompPrv->tBufList[count].pBufHeader == pBufferHdr)
-		{
-			DOMX_DEBUG("Buffer Index of Match %d ", count);
-			break;
-		}
-	}
+	count = PROXY_FindBufferByLocal(pCompPrv, pBufferHdr);
+	DOMX_DEBUG("Buffer Index of Match %d", count);
 	PROXY_assert((count != pCompPrv->nTotalBuffers),
 	    OMX_ErrorBadParameter,
 	    "Could not find the remote header in buffer list");
@@ -611,11 +2728,9 @@ OMX_ERRORTYPE PROXY_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 
 		/*Replacing original mark data with proxy specific structure */
 		pMarkData = pBufferHdr->pMarkData;
-		pBufferHdr->pMarkData =
-		    TIMM_OSAL_Malloc(sizeof(PROXY_MARK_DATA), TIMM_OSAL_TRUE,
-		    0, TIMMOSAL_MEM_SEGMENT_INT);
+		pBufferHdr->pMarkData = PROXY_MarkDataAlloc();
 		PROXY_assert(pBufferHdr->pMarkData != NULL,
-		    OMX_ErrorInsufficientResources, "Malloc failed");
+		    OMX_ErrorInsufficientResources, "Mark data allocation failed");
 		bFreeMarkIfError = OMX_TRUE;
 		((PROXY_MARK_DATA *) (pBufferHdr->
 			pMarkData))->hComponentActual = pMarkComp;
@@ -640,16 +2755,33 @@ OMX_ERRORTYPE PROXY_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	bMapBuffer =
 		pCompPrv->proxyPortBuffers[pBufferHdr->nInputPortIndex].proxyBufferType ==
 			EncoderMetadataPointers;
+	if (bMapBuffer && !pCompPrv->bMapOnceProbed)
+		PROXY_MapOnceProbe(pCompPrv);
 
-	KPI_OmxCompBufferEvent(KPI_BUFFER_ETB, hComponent, &(pCompPrv->tBufList[count]));
+	/*Owned by the remote side before the call, its EBD may be processed
+	  before the call returns */
+	PROXY_assert(PROXY_BufferSetOwner(pCompPrv, count,
+		PROXY_BUFFER_OWNER_CLIENT, PROXY_BUFFER_OWNER_REMOTE),
+	    OMX_ErrorIncorrectStateOperation,
+	    "ETB of a buffer the client does not own");
+	bSent = OMX_TRUE;
+
+	/*Rate control settings queued since the last frame apply to this one */
+	PROXY_ConfigQueueFlush(pCompPrv);
+
+	KPI_OmxCompBufferEvent(KPI_BUFFER_ETB, hComponent,
+	    &(PROXY_BUFLIST_ENTRY(pCompPrv, count)));
 
 	eRPCError =
 	    RPC_EmptyThisBuffer(pCompPrv->hRemoteComp, pBufferHdr,
-	    pCompPrv->tBufList[count].pBufHeaderRemote, &eCompReturn,bMapBuffer);
+	    PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeaderRemote, &eCompReturn,bMapBuffer);
 
 	PROXY_checkRpcError();
 
       EXIT:
+	if (eError != OMX_ErrorNone && bSent)
+		PROXY_BufferSetOwner(pCompPrv, count,
+		    PROXY_BUFFER_OWNER_REMOTE, PROXY_BUFFER_OWNER_CLIENT);
 	/*If ETB is about to return an error then this means that buffer has not
 	   been accepted by the component. Thus the allocated mark data will be
 	   lost so free it here. Also replace original mark data in the header */
@@ -661,11 +2793,12 @@ OMX_ERRORTYPE PROXY_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 		pMarkData =
 		    ((PROXY_MARK_DATA *) (pBufferHdr->
 			pMarkData))->pMarkDataActual;
-		TIMM_OSAL_Free(pBufferHdr->pMarkData);
+		PROXY_MarkDataFree(pBufferHdr->pMarkData);
 		pBufferHdr->pMarkData = pMarkData;
 	}
 
 	DOMX_EXIT("eError: %d", eError);
+	DOMX_TRACE_END();
 	return eError;
 }
 
@@ -688,6 +2821,8 @@ OMX_ERRORTYPE PROXY_FillThisBuffer(OMX_HANDLETYPE hComponent,
 	PROXY_COMPONENT_PRIVATE *pCompPrv;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	OMX_U32 count = 0;
+	OMX_BOOL bSent = OMX_FALSE;
+	DOMX_TRACE_BEGIN(pBufferHdr);
 
 	PROXY_require(pBufferHdr != NULL, OMX_ErrorBadParameter, NULL);
 	PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
@@ -702,27 +2837,33 @@ OMX_ERRORTYPE PROXY_FillThisBuffer(OMX_HANDLETYPE hComponent,
 	    pBufferHdr->nOffset, pBufferHdr->nFlags);
 
 	/*First find the index of this buffer header to retrieve remote buffer header */
-	for (count = 0; count < pCompPrv->nTotalBuffers; count++)
-	{
-		if (pCompPrv->tBufList[count].pBufHeader == pBufferHdr)
-		{
-			DOMX_DEBUG("Buffer Index of Match %d ", count);
-			break;
-		}
-	}
+	count = PROXY_FindBufferByLocal(pCompPrv, pBufferHdr);
+	DOMX_DEBUG("Buffer Index of Match %d", count);
 	PROXY_assert((count != pCompPrv->nTotalBuffers),
 	    OMX_ErrorBadParameter,
 	    "Could not find the remote header in buffer list");
 
-	KPI_OmxCompBufferEvent(KPI_BUFFER_FTB, hComponent, &(pCompPrv->tBufList[count]));
+	PROXY_assert(PROXY_BufferSetOwner(pCompPrv, count,
+		PROXY_BUFFER_OWNER_CLIENT, PROXY_BUFFER_OWNER_REMOTE),
+	    OMX_ErrorIncorrectStateOperation,
+	    "FTB of a buffer the client does not own");
+	bSent = OMX_TRUE;
+
+	KPI_OmxCompBufferEvent(KPI_BUFFER_FTB, hComponent,
+	    &(PROXY_BUFLIST_ENTRY(pCompPrv, count)));
 
 	eRPCError = RPC_FillThisBuffer(pCompPrv->hRemoteComp, pBufferHdr,
-	    pCompPrv->tBufList[count].pBufHeaderRemote, &eCompReturn);
+	    PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeaderRemote, &eCompReturn);
 
 	PROXY_checkRpcError();
+	PROXY_LoadFrame(hComponent, pCompPrv, pBufferHdr->nOutputPortIndex);
 
       EXIT:
+	if (eError != OMX_ErrorNone && bSent)
+		PROXY_BufferSetOwner(pCompPrv, count,
+		    PROXY_BUFFER_OWNER_REMOTE, PROXY_BUFFER_OWNER_CLIENT);
 	DOMX_EXIT("eError: %d", eError);
+	DOMX_TRACE_END();
 	return eError;
 }
 
@@ -758,6 +2899,7 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	OMX_U8* pMemptr = NULL;
 	OMX_CONFIG_RECTTYPE tParamRect;
 	OMX_PARAM_PORTDEFINITIONTYPE tParamPortDef;
+	DOMX_TRACE_BEGIN(nPortIndex);
 
 	PROXY_require((hComp->pComponentPrivate != NULL),
 	    OMX_ErrorBadParameter, NULL);
@@ -766,10 +2908,17 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER
 	    ("hComponent = %p, pCompPrv = %p, nPortIndex = %p, pAppPrivate = %p, nSizeBytes = %d",
 	    hComponent, pCompPrv, nPortIndex, pAppPrivate, nSizeBytes);
 
+	PROXY_require(nPortIndex >= PROXY_MAXNUMOFPORTS ||
+	    pCompPrv->proxyPortBuffers[nPortIndex].bTunneled == OMX_FALSE,
+	    OMX_ErrorIncorrectStateOperation,
+	    "Buffers of a tunneled port are owned by the remote core");
+
 	/*Pick up 1st empty slot */
 	/*The same empty spot will be picked up by the subsequent
 	Use buffer call to fill in the corresponding buffer
@@ -778,7 +2927,7 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	bSlotFound = OMX_FALSE;
 	for (i = 0; i < pCompPrv->nTotalBuffers; i++)
 	{
-		if (pCompPrv->tBufList[i].pBufHeader == NULL)
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, i).pBufHeader == NULL)
 		{
 			currentBuffer = i;
 			bSlotFound = OMX_TRUE;
@@ -790,6 +2939,9 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	{
 		currentBuffer = pCompPrv->nTotalBuffers;
 	}
+	eError = PROXY_GrowBufList(hComponent, nPortIndex, currentBuffer);
+	PROXY_assert(eError == OMX_ErrorNone, eError,
+	    "Proxy buffer table could not be grown");
 
 		MEMPLUGIN_BUFFER_PARAMS_INIT(newbuffer_params);
 		newbuffer_params.nWidth = nSize;
@@ -801,11 +2953,11 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 			eError = OMX_ErrorInsufficientResources;
 			goto EXIT;
 		}
-		pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pBufferHandle = newbuffer_prop.sBuffer_accessor.pBufferHandle;
-		pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pBufferMappedAddress = newbuffer_prop.sBuffer_accessor.pBufferMappedAddress;
-		pCompPrv->tBufList[currentBuffer].bufferAccessors[0].bufferFd = newbuffer_prop.sBuffer_accessor.bufferFd;
-		pMemptr = pCompPrv->tBufList[currentBuffer].bufferAccessors[0].bufferFd;
-		DOMX_DEBUG ("Ion handle recieved = %x",pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pBufferHandle);
+		PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pBufferHandle = newbuffer_prop.sBuffer_accessor.pBufferHandle;
+		PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pBufferMappedAddress = newbuffer_prop.sBuffer_accessor.pBufferMappedAddress;
+		PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].bufferFd = newbuffer_prop.sBuffer_accessor.bufferFd;
+		pMemptr = PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].bufferFd;
+		DOMX_DEBUG ("Ion handle recieved = %x",PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pBufferHandle);
 
 	/*No need to increment Allocated buffers here.
 	It will be done in the subsequent use buffer call below*/
@@ -818,10 +2970,10 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	}
 	if (pCompPrv->bMapBuffers == OMX_TRUE)
 	{
-		DOMX_DEBUG("before mapping, handle = %x, nSize = %d",pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pBufferHandle,nSize);
-		(*ppBufferHdr)->pBuffer =  pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pBufferMappedAddress;
+		DOMX_DEBUG("before mapping, handle = %x, nSize = %d",PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pBufferHandle,nSize);
+		(*ppBufferHdr)->pBuffer =  PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pBufferMappedAddress;
 	} else {
-		(*ppBufferHdr)->pBuffer = pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pBufferHandle;
+		(*ppBufferHdr)->pBuffer = PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pBufferHandle;
 	}
 
 
@@ -847,10 +2999,15 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	    ("hComponent = %p, pCompPrv = %p, nPortIndex = %p, pAppPrivate = %p, nSizeBytes = %d",
 	    hComponent, pCompPrv, nPortIndex, pAppPrivate, nSizeBytes);
 
+	PROXY_require(nPortIndex >= PROXY_MAXNUMOFPORTS ||
+	    pCompPrv->proxyPortBuffers[nPortIndex].bTunneled == OMX_FALSE,
+	    OMX_ErrorIncorrectStateOperation,
+	    "Buffers of a tunneled port are owned by the remote core");
+
 	/*Pick up 1st empty slot */
 	for (i = 0; i < pCompPrv->nTotalBuffers; i++)
 	{
-		if (pCompPrv->tBufList[i].pBufHeader == 0)
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, i).pBufHeader == 0)
 		{
 			currentBuffer = i;
 			bSlotFound = OMX_TRUE;
@@ -863,24 +3020,19 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	}
 
 	DOMX_DEBUG("In AB, no. of buffers = %d", pCompPrv->nTotalBuffers);
-	PROXY_assert((pCompPrv->nTotalBuffers < MAX_NUM_PROXY_BUFFERS),
-	    OMX_ErrorInsufficientResources,
-	    "Proxy cannot handle more than MAX buffers");
+	eError = PROXY_GrowBufList(hComponent, nPortIndex, currentBuffer);
+	PROXY_assert(eError == OMX_ErrorNone, eError,
+	    "Proxy buffer table could not be grown");
 
 	//Allocating Local bufferheader to be maintained locally within proxy
 	pBufferHeader =
-	    (OMX_BUFFERHEADERTYPE *)
-	    TIMM_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE), TIMM_OSAL_TRUE, 0,
-	    TIMMOSAL_MEM_SEGMENT_INT);
+	    (OMX_BUFFERHEADERTYPE *) TIMM_OSAL_ArenaAlloc(PROXY_BufHdrArena(pCompPrv,
+	    nPortIndex));
 	PROXY_assert((pBufferHeader != NULL), OMX_ErrorInsufficientResources,
 	    "Allocation of Buffer Header structure failed");
 
 	pPlatformPrivate =
-	    (OMX_TI_PLATFORMPRIVATE *)
-	    TIMM_OSAL_Malloc(sizeof(OMX_TI_PLATFORMPRIVATE), TIMM_OSAL_TRUE,
-	    0, TIMMOSAL_MEM_SEGMENT_INT);
-	PROXY_assert(pPlatformPrivate != NULL, OMX_ErrorInsufficientResources,
-	    "Allocation of platform private structure failed");
+	    &(((PROXY_BUFFER_HEADER *) pBufferHeader)->tPlatformPrivate);
 	pBufferHeader->pPlatformPrivate = pPlatformPrivate;
 
 	DOMX_DEBUG(" Calling RPC ");
@@ -896,8 +3048,14 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	DOMX_DEBUG("Value of pBufHeaderRemote: %p   LocalBufferHdr :%p",
 	    pBufHeaderRemote, pBufferHeader);
 
-	pCompPrv->tBufList[currentBuffer].pBufHeader = pBufferHeader;
-	pCompPrv->tBufList[currentBuffer].pBufHeaderRemote = pBufHeaderRemote;
+	PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).pBufHeader = pBufferHeader;
+	PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).pBufHeaderRemote = pBufHeaderRemote;
+	((PROXY_BUFFER_HEADER *) pBufferHeader)->nBufListIndex = currentBuffer;
+	PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).nPortIndex = nPortIndex;
+	PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).eOwner = PROXY_BUFFER_OWNER_CLIENT;
+	PROXY_RemoteHashInsert(pCompPrv,
+	    (PROXY_BUFLIST_BLOCK *) pCompPrv->pBufListBlock,
+	    currentBuffer);
 
 
 	//keeping track of number of Buffers
@@ -913,12 +3071,12 @@ OMX_ERRORTYPE PROXY_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
       EXIT:
 	if (eError != OMX_ErrorNone)
 	{
-		if (pPlatformPrivate)
-			TIMM_OSAL_Free(pPlatformPrivate);
 		if (pBufferHeader)
-			TIMM_OSAL_Free(pBufferHeader);
+			TIMM_OSAL_ArenaFree(PROXY_BufHdrArena(pCompPrv,
+			    nPortIndex), pBufferHeader);
 	}
 	DOMX_EXIT("eError: %d", eError);
+	DOMX_TRACE_END();
 	return eError;
 #endif //ALLOCATE_TILER_BUFFER_IN_PROXY
 
@@ -961,6 +3119,8 @@ static OMX_ERRORTYPE PROXY_UseBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	MEMPLUGIN_BUFFER_PROPERTIES metadataBuffer_prop;
 	MEMPLUGIN_BUFFER_PARAMS metadataBuffer_params;
 	MEMPLUGIN_ERRORTYPE eMemError = MEMPLUGIN_ERROR_NONE;
+	DOMX_TRACE_BEGIN(nPortIndex);
+
 	PROXY_require((hComp->pComponentPrivate != NULL),
 	    OMX_ErrorBadParameter, NULL);
 	PROXY_require(pBuffer != NULL, OMX_ErrorBadParameter, "Pointer to buffer is NULL");
@@ -969,15 +3129,22 @@ static OMX_ERRORTYPE PROXY_UseBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER
 	    ("hComponent = %p, pCompPrv = %p, nPortIndex = %p, pAppPrivate = %p, nSizeBytes = %d, pBuffer = %p",
 	    hComponent, pCompPrv, nPortIndex, pAppPrivate, nSizeBytes,
 	    pBuffer);
 
+	PROXY_require(nPortIndex >= PROXY_MAXNUMOFPORTS ||
+	    pCompPrv->proxyPortBuffers[nPortIndex].bTunneled == OMX_FALSE,
+	    OMX_ErrorIncorrectStateOperation,
+	    "Buffers of a tunneled port are owned by the remote core");
+
 	/*Pick up 1st empty slot */
 	for (i = 0; i < pCompPrv->nTotalBuffers; i++)
 	{
-		if (pCompPrv->tBufList[i].pBufHeader == 0)
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, i).pBufHeader == 0)
 		{
 			currentBuffer = i;
 			bSlotFound = OMX_TRUE;
@@ -990,24 +3157,19 @@ static OMX_ERRORTYPE PROXY_UseBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	}
 	DOMX_DEBUG("In UB, no. of buffers = %d", pCompPrv->nTotalBuffers);
 
-	PROXY_assert((pCompPrv->nTotalBuffers < MAX_NUM_PROXY_BUFFERS),
-	    OMX_ErrorInsufficientResources,
-	    "Proxy cannot handle more than MAX buffers");
+	eError = PROXY_GrowBufList(hComponent, nPortIndex, currentBuffer);
+	PROXY_assert(eError == OMX_ErrorNone, eError,
+	    "Proxy buffer table could not be grown");
 
 	//Allocating Local bufferheader to be maintained locally within proxy
 	pBufferHeader =
-	    (OMX_BUFFERHEADERTYPE *)
-	    TIMM_OSAL_Malloc(sizeof(OMX_BUFFERHEADERTYPE), TIMM_OSAL_TRUE, 0,
-	    TIMMOSAL_MEM_SEGMENT_INT);
+	    (OMX_BUFFERHEADERTYPE *) TIMM_OSAL_ArenaAlloc(PROXY_BufHdrArena(pCompPrv,
+	    nPortIndex));
 	PROXY_assert((pBufferHeader != NULL), OMX_ErrorInsufficientResources,
 	    "Allocation of Buffer Header structure failed");
 
 	pPlatformPrivate =
-	    (OMX_TI_PLATFORMPRIVATE *)
-	    TIMM_OSAL_Malloc(sizeof(OMX_TI_PLATFORMPRIVATE), TIMM_OSAL_TRUE,
-	    0, TIMMOSAL_MEM_SEGMENT_INT);
-	PROXY_assert(pPlatformPrivate != NULL, OMX_ErrorInsufficientResources,
-	    "Allocation of platform private structure failed");
+	    &(((PROXY_BUFFER_HEADER *) pBufferHeader)->tPlatformPrivate);
 	TIMM_OSAL_Memset(pPlatformPrivate, 0, sizeof(OMX_TI_PLATFORMPRIVATE));
 
 	pBufferHeader->pPlatformPrivate = pPlatformPrivate;
@@ -1075,31 +3237,31 @@ static OMX_ERRORTYPE PROXY_UseBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 		}
 		((OMX_TI_PLATFORMPRIVATE *)pBufferHeader->
 			pPlatformPrivate)->pMetaDataBuffer = metadataBuffer_prop.sBuffer_accessor.pBufferHandle;
-		pCompPrv->tBufList[currentBuffer].bufferAccessors[2].pBufferHandle = metadataBuffer_prop.sBuffer_accessor.pBufferHandle;
+		PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[2].pBufferHandle = metadataBuffer_prop.sBuffer_accessor.pBufferHandle;
 		DOMX_DEBUG("Metadata buffer ion handle = %d",((OMX_TI_PLATFORMPRIVATE *)pBufferHeader->pPlatformPrivate)->pMetaDataBuffer);
-		pCompPrv->tBufList[currentBuffer].bufferAccessors[2].pBufferMappedAddress = metadataBuffer_prop.sBuffer_accessor.pBufferMappedAddress;
-		pCompPrv->tBufList[currentBuffer].bufferAccessors[2].bufferFd = metadataBuffer_prop.sBuffer_accessor.bufferFd;
+		PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[2].pBufferMappedAddress = metadataBuffer_prop.sBuffer_accessor.pBufferMappedAddress;
+		PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[2].bufferFd = metadataBuffer_prop.sBuffer_accessor.bufferFd;
 	}
 
 #ifdef USE_ION
 	{
 		// Need to register buffers when using ion and rpmsg
 		eRPCError = RPC_RegisterBuffer(pCompPrv->hRemoteComp, pAuxBuf0,(int)((OMX_TI_PLATFORMPRIVATE *) pBufferHeader->pPlatformPrivate)->pAuxBuf1,
-							&pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pRegBufferHandle,&pCompPrv->tBufList[currentBuffer].bufferAccessors[1].pRegBufferHandle,
+							&PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pRegBufferHandle,&PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[1].pRegBufferHandle,
 		                    pCompPrv->proxyPortBuffers[nPortIndex].proxyBufferType);
 		 PROXY_checkRpcError();
-		if (pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pRegBufferHandle)
-			pAuxBuf0 = pCompPrv->tBufList[currentBuffer].bufferAccessors[0].pRegBufferHandle;
-		if (pCompPrv->tBufList[currentBuffer].bufferAccessors[1].pRegBufferHandle)
-			pPlatformPrivate->pAuxBuf1 = pCompPrv->tBufList[currentBuffer].bufferAccessors[1].pRegBufferHandle;
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pRegBufferHandle)
+			pAuxBuf0 = PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[0].pRegBufferHandle;
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[1].pRegBufferHandle)
+			pPlatformPrivate->pAuxBuf1 = PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[1].pRegBufferHandle;
 
 		if (pPlatformPrivate->pMetaDataBuffer != NULL)
 		{
-			eRPCError = RPC_RegisterBuffer(pCompPrv->hRemoteComp, pCompPrv->tBufList[currentBuffer].bufferAccessors[2].bufferFd, -1,
-					   &(pCompPrv->tBufList[currentBuffer].bufferAccessors[2].pRegBufferHandle), NULL, IONPointers);
+			eRPCError = RPC_RegisterBuffer(pCompPrv->hRemoteComp, PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[2].bufferFd, -1,
+					   &(PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[2].pRegBufferHandle), NULL, IONPointers);
 			PROXY_checkRpcError();
-			if (pCompPrv->tBufList[currentBuffer].bufferAccessors[2].pRegBufferHandle)
-				pPlatformPrivate->pMetaDataBuffer = pCompPrv->tBufList[currentBuffer].bufferAccessors[2].pRegBufferHandle;
+			if (PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[2].pRegBufferHandle)
+				pPlatformPrivate->pMetaDataBuffer = PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[2].pRegBufferHandle;
 		}
 	}
 #endif
@@ -1116,15 +3278,21 @@ static OMX_ERRORTYPE PROXY_UseBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 
 	if (pCompPrv->bMapBuffers == OMX_TRUE && tMetaDataBuffer.bIsMetaDataEnabledOnPort)
 	{
-		((OMX_TI_PLATFORMPRIVATE *)pBufferHeader->pPlatformPrivate)->pMetaDataBuffer = pCompPrv->tBufList[currentBuffer].bufferAccessors[2].pBufferMappedAddress;
+		((OMX_TI_PLATFORMPRIVATE *)pBufferHeader->pPlatformPrivate)->pMetaDataBuffer = PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).bufferAccessors[2].pBufferMappedAddress;
 		//ion_free(pCompPrv->nMemmgrClientDesc, handleToMap);
 		memset(((OMX_TI_PLATFORMPRIVATE *)pBufferHeader->pPlatformPrivate)->pMetaDataBuffer,
 			0x0, tMetaDataBuffer.nMetaDataSize);
 	}
 
 	//Storing details of pBufferHeader/Mapped/Actual buffer address locally.
-	pCompPrv->tBufList[currentBuffer].pBufHeader = pBufferHeader;
-	pCompPrv->tBufList[currentBuffer].pBufHeaderRemote = pBufHeaderRemote;
+	PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).pBufHeader = pBufferHeader;
+	PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).pBufHeaderRemote = pBufHeaderRemote;
+	((PROXY_BUFFER_HEADER *) pBufferHeader)->nBufListIndex = currentBuffer;
+	PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).nPortIndex = nPortIndex;
+	PROXY_BUFLIST_ENTRY(pCompPrv, currentBuffer).eOwner = PROXY_BUFFER_OWNER_CLIENT;
+	PROXY_RemoteHashInsert(pCompPrv,
+	    (PROXY_BUFLIST_BLOCK *) pCompPrv->pBufListBlock,
+	    currentBuffer);
 
 	//keeping track of number of Buffers
 	pCompPrv->nAllocatedBuffers++;
@@ -1138,12 +3306,12 @@ static OMX_ERRORTYPE PROXY_UseBuffer(OMX_IN OMX_HANDLETYPE hComponent,
       EXIT:
 	if (eError != OMX_ErrorNone)
 	{
-		if (pPlatformPrivate)
-			TIMM_OSAL_Free(pPlatformPrivate);
 		if (pBufferHeader)
-			TIMM_OSAL_Free(pBufferHeader);
+			TIMM_OSAL_ArenaFree(PROXY_BufHdrArena(pCompPrv,
+			    nPortIndex), pBufferHeader);
 	}
 	DOMX_EXIT("eError: %d", eError);
+	DOMX_TRACE_END();
 	return eError;
 }
 
@@ -1172,6 +3340,7 @@ OMX_ERRORTYPE PROXY_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	OMX_TI_PLATFORMPRIVATE * pPlatformPrivate = NULL;
 	MEMPLUGIN_BUFFER_PROPERTIES delBuffer_prop;
 	MEMPLUGIN_BUFFER_PARAMS delBuffer_params;
+	DOMX_TRACE_BEGIN(pBufferHdr);
 
 	PROXY_require(pBufferHdr != NULL, OMX_ErrorBadParameter, NULL);
 	PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
@@ -1180,23 +3349,22 @@ OMX_ERRORTYPE PROXY_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER
 	    ("hComponent = %p, pCompPrv = %p, nPortIndex = %p, pBufferHdr = %p, pBuffer = %p",
 	    hComponent, pCompPrv, nPortIndex, pBufferHdr,
 	    pBufferHdr->pBuffer);
 
-	for (count = 0; count < pCompPrv->nTotalBuffers; count++)
-	{
-		if (pCompPrv->tBufList[count].pBufHeader == pBufferHdr)
-		{
-			DOMX_DEBUG("Buffer Index of Match %d", count);
-			break;
-		}
-	}
+	count = PROXY_FindBufferByLocal(pCompPrv, pBufferHdr);
+	DOMX_DEBUG("Buffer Index of Match %d", count);
 	PROXY_assert((count != pCompPrv->nTotalBuffers),
 	    OMX_ErrorBadParameter,
 	    "Could not find the mapped address in component private buffer list");
 
+	if (nPortIndex < PROXY_MAXNUMOFPORTS)
+		PROXY_OutSizeFinish(pCompPrv, nPortIndex);
+
 	pBuffer = (OMX_U32)pBufferHdr->pBuffer;
     pAuxBuf0 = (OMX_PTR) pBuffer;
 
@@ -1216,38 +3384,38 @@ OMX_ERRORTYPE PROXY_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 	/*Not having asserts from this point since even if error occurs during
 	   unmapping/freeing, still trying to clean up as much as possible */
 
-	if (pCompPrv->tBufList[count].bufferAccessors[0].pRegBufferHandle != NULL)
-		pAuxBuf0 = pCompPrv->tBufList[count].bufferAccessors[0].pRegBufferHandle;
+	if (PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pRegBufferHandle != NULL)
+		pAuxBuf0 = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pRegBufferHandle;
 
 	eRPCError =
 	    RPC_FreeBuffer(pCompPrv->hRemoteComp, nPortIndex,
-	    pCompPrv->tBufList[count].pBufHeaderRemote, (OMX_U32) pAuxBuf0,
+	    PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeaderRemote, (OMX_U32) pAuxBuf0,
 	    &eCompReturn);
 
 	if (eRPCError != RPC_OMX_ErrorNone)
 		eTmpRPCError = eRPCError;
 
-	pPlatformPrivate = (OMX_TI_PLATFORMPRIVATE *)(pCompPrv->tBufList[count].pBufHeader)->
+	pPlatformPrivate = (OMX_TI_PLATFORMPRIVATE *)(PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader)->
 			pPlatformPrivate;
 
-	if (pCompPrv->tBufList[count].pBufHeader)
+	if (PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader)
 	{
 #ifdef ALLOCATE_TILER_BUFFER_IN_PROXY
-		if(pCompPrv->tBufList[count].bufferAccessors[0].pBufferHandle)
+		if(PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferHandle)
 		{
 				if(pBufferHdr->pBuffer)
 				{
 					MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
-					delBuffer_prop.sBuffer_accessor.pBufferHandle = pCompPrv->tBufList[count].bufferAccessors[0].pBufferHandle;
-					delBuffer_prop.sBuffer_accessor.pBufferMappedAddress = pCompPrv->tBufList[count].bufferAccessors[0].pBufferMappedAddress;
-					delBuffer_prop.sBuffer_accessor.bufferFd = pCompPrv->tBufList[count].bufferAccessors[0].bufferFd;
+					delBuffer_prop.sBuffer_accessor.pBufferHandle = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferHandle;
+					delBuffer_prop.sBuffer_accessor.pBufferMappedAddress = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferMappedAddress;
+					delBuffer_prop.sBuffer_accessor.bufferFd = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].bufferFd;
 					delBuffer_params.bMap = pCompPrv->bMapBuffers;
 					delBuffer_params.nWidth = pBufferHdr->nAllocLen;
 					MemPlugin_Free(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc,&delBuffer_params,&delBuffer_prop);
 				}
-				pCompPrv->tBufList[count].bufferAccessors[0].pBufferHandle = NULL;
-				pCompPrv->tBufList[count].bufferAccessors[0].pBufferMappedAddress = NULL;
-				pCompPrv->tBufList[count].bufferAccessors[0].bufferFd = -1;
+				PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferHandle = NULL;
+				PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferMappedAddress = NULL;
+				PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].bufferFd = -1;
 		}
 #endif
 	}
@@ -1255,47 +3423,49 @@ OMX_ERRORTYPE PROXY_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 		if (pMetaDataBuffer)
 		{
 				MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
-				delBuffer_prop.sBuffer_accessor.pBufferHandle = pCompPrv->tBufList[count].bufferAccessors[2].pBufferHandle;
-				delBuffer_prop.sBuffer_accessor.pBufferMappedAddress = pCompPrv->tBufList[count].bufferAccessors[2].pBufferMappedAddress;
-				delBuffer_prop.sBuffer_accessor.bufferFd = pCompPrv->tBufList[count].bufferAccessors[2].bufferFd;
+				delBuffer_prop.sBuffer_accessor.pBufferHandle = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pBufferHandle;
+				delBuffer_prop.sBuffer_accessor.pBufferMappedAddress = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pBufferMappedAddress;
+				delBuffer_prop.sBuffer_accessor.bufferFd = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].bufferFd;
 				delBuffer_params.bMap = pCompPrv->bMapBuffers;
 				delBuffer_params.nWidth = pPlatformPrivate->nMetaDataSize;
 				MemPlugin_Free(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc,&delBuffer_params,&delBuffer_prop);
 				pPlatformPrivate->pMetaDataBuffer = NULL;
-				pCompPrv->tBufList[count].bufferAccessors[2].pBufferHandle=NULL;
-				pCompPrv->tBufList[count].bufferAccessors[2].pBufferMappedAddress = NULL;
-				pCompPrv->tBufList[count].bufferAccessors[2].bufferFd = -1;
+				PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pBufferHandle=NULL;
+				PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pBufferMappedAddress = NULL;
+				PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].bufferFd = -1;
 		}
 #ifdef USE_ION
 	{
 		// Need to unregister buffers when using ion and rpmsg
-		if (pCompPrv->tBufList[count].bufferAccessors[0].pRegBufferHandle != NULL)
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pRegBufferHandle != NULL)
 		{
 			eTmpRPCError = RPC_UnRegisterBuffer(pCompPrv->hRemoteComp,
-								pCompPrv->tBufList[count].bufferAccessors[0].pRegBufferHandle,pCompPrv->tBufList[count].bufferAccessors[1].pRegBufferHandle,
+								PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pRegBufferHandle,PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[1].pRegBufferHandle,
 								pCompPrv->proxyPortBuffers[nPortIndex].proxyBufferType);
 			if (eTmpRPCError != RPC_OMX_ErrorNone) {
 				eRPCError = eTmpRPCError;
 			}
 		}
 
-		if (pCompPrv->tBufList[count].bufferAccessors[2].pRegBufferHandle != NULL)
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pRegBufferHandle != NULL)
 		{
 			eTmpRPCError = RPC_UnRegisterBuffer(pCompPrv->hRemoteComp,
-								pCompPrv->tBufList[count].bufferAccessors[2].pRegBufferHandle, NULL, IONPointers);
+								PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pRegBufferHandle, NULL, IONPointers);
 			if (eTmpRPCError != RPC_OMX_ErrorNone) {
 				eRPCError = eTmpRPCError;
 			}
 		}
 	}
 #endif
-		if (pCompPrv->tBufList[count].pBufHeader->pPlatformPrivate)
-		{
-			TIMM_OSAL_Free(pCompPrv->tBufList[count].pBufHeader->
-			    pPlatformPrivate);
-		}
-		TIMM_OSAL_Free(pCompPrv->tBufList[count].pBufHeader);
-		TIMM_OSAL_Memset(&(pCompPrv->tBufList[count]), 0,
+		if (PROXY_BufferSetOwner(pCompPrv, count,
+			PROXY_BUFFER_OWNER_REMOTE, PROXY_BUFFER_OWNER_NONE))
+			DOMX_WARN("Freeing buffer %p still held by the remote "
+			    "component", pBufferHdr);
+		PROXY_RemoteHashRemove(pCompPrv, count);
+		TIMM_OSAL_ArenaFree(PROXY_BufHdrArena(pCompPrv,
+			PROXY_BUFLIST_ENTRY(pCompPrv, count).nPortIndex),
+		    PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader);
+		TIMM_OSAL_Memset(&(PROXY_BUFLIST_ENTRY(pCompPrv, count)), 0,
 		    sizeof(PROXY_BUFFER_INFO));
 	pCompPrv->nAllocatedBuffers--;
 
@@ -1303,6 +3473,7 @@ OMX_ERRORTYPE PROXY_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
 
       EXIT:
 	DOMX_EXIT("eError: %d", eError);
+	DOMX_TRACE_END();
 	return eError;
 }
 
@@ -1333,6 +3504,8 @@ OMX_ERRORTYPE __PROXY_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	OMX_PTR *pAuxBuf = pLocBufNeedMap;
 	OMX_PTR pRegistered = NULL;
 #endif
+	OMX_BOOL bAdmitted = OMX_FALSE;
+	OMX_U32 nAdmitPrev = 0;
 
 	PROXY_require((pParamStruct != NULL), OMX_ErrorBadParameter, NULL);
 	PROXY_require((hComp->pComponentPrivate != NULL),
@@ -1340,10 +3513,25 @@ OMX_ERRORTYPE __PROXY_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER
 		("hComponent = %p, pCompPrv = %p, nParamIndex = %d, pParamStruct = %p",
 		hComponent, pCompPrv, nParamIndex, pParamStruct);
 
+	PROXY_ConfigQueueFlush(pCompPrv);
+
+	eError = PROXY_AdmitParam(pCompPrv, nParamIndex, pParamStruct,
+	    &nAdmitPrev);
+	PROXY_assert(eError == OMX_ErrorNone, eError,
+	    "Over the codec budget");
+	bAdmitted = OMX_TRUE;
+
+	/*Almost any parameter can change buffer sizes on the remote side */
+	PROXY_InvalidatePortDefinitions(pCompPrv);
+	if (nParamIndex == OMX_IndexParamStandardComponentRole)
+		PROXY_ParamCacheFlush(pCompPrv);
+
 	switch(nParamIndex)
 	{
 #ifdef ENABLE_GRALLOC_BUFFERS
@@ -1413,8 +3601,14 @@ OMX_ERRORTYPE __PROXY_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	}
 
 	PROXY_checkRpcError();
+	if (nParamIndex != (OMX_INDEXTYPE) OMX_TI_IndexUseNativeBuffers)
+		PROXY_RecoveryRecord(pCompPrv, OMX_FALSE, nParamIndex,
+		    pParamStruct, pLocBufNeedMap);
 
  EXIT:
+	if (bAdmitted && eError != OMX_ErrorNone)
+		PROXY_AdmitParamRevert(pCompPrv, nParamIndex, pParamStruct,
+		    nAdmitPrev);
 	DOMX_EXIT("eError: %d", eError);
 	return eError;
 }
@@ -1455,6 +3649,7 @@ OMX_ERRORTYPE __PROXY_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	OMX_TI_PARAM_USEBUFFERDESCRIPTOR *ptBufDescParam = NULL;
+	OMX_U32 nEpoch = 0;
 #ifdef USE_ION
 	OMX_PTR *pAuxBuf = pLocBufNeedMap;
 	OMX_PTR pRegistered = NULL;
@@ -1466,10 +3661,19 @@ OMX_ERRORTYPE __PROXY_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER
 		("hComponent = %p, pCompPrv = %p, nParamIndex = %d, pParamStruct = %p",
 		 hComponent, pCompPrv, nParamIndex, pParamStruct);
 
+	if (pLocBufNeedMap == NULL &&
+	    PROXY_ParamCacheLookup(pCompPrv, nParamIndex, pParamStruct, &eError))
+	{
+		goto EXIT;
+	}
+	nEpoch = pCompPrv->nPortDefEpoch;
+
 	switch(nParamIndex)
 	{
 		case OMX_TI_IndexUseBufferDescriptor:
@@ -1512,6 +3716,10 @@ OMX_ERRORTYPE __PROXY_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 
 	PROXY_checkRpcError();
 
+	if (pLocBufNeedMap == NULL)
+		PROXY_ParamCacheStore(pCompPrv, nParamIndex, pParamStruct,
+		    eError, nEpoch);
+
 EXIT:
 	DOMX_EXIT("eError: %d index: 0x%x", eError, nParamIndex);
 	return eError;
@@ -1533,6 +3741,68 @@ OMX_ERRORTYPE PROXY_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	return __PROXY_GetParameter(hComponent, nParamIndex, pParamStruct, NULL);
 }
 
+/* ===========================================================================*/
+/**
+ * @name PROXY_GetCachedPortDefinition()
+ * @brief Same as GetParameter(OMX_IndexParamPortDefinition) but answered
+ *        locally while nothing that could change the port has happened since
+ *        the last remote read. Meant for per-buffer paths that only need the
+ *        buffer geometry - bEnabled/bPopulated may be out of date.
+ * @param pPortDef [INOUT] : nPortIndex selects the port.
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+OMX_ERRORTYPE PROXY_GetCachedPortDefinition(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_INOUT OMX_PARAM_PORTDEFINITIONTYPE * pPortDef)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	PROXY_PORT_TYPE *pPort = NULL;
+	OMX_U32 nEpoch = 0;
+
+	PROXY_require((pPortDef != NULL), OMX_ErrorBadParameter, NULL);
+	PROXY_require((hComp->pComponentPrivate != NULL),
+	    OMX_ErrorBadParameter, NULL);
+
+	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+
+	if (pPortDef->nPortIndex >= PROXY_MAXNUMOFPORTS)
+	{
+		eError = PROXY_GetParameter(hComponent,
+		    OMX_IndexParamPortDefinition, pPortDef);
+		goto EXIT;
+	}
+	pPort = &(pCompPrv->proxyPortBuffers[pPortDef->nPortIndex]);
+
+	nEpoch = pCompPrv->nPortDefEpoch;
+	if (pPort->bPortDefValid && pPort->nPortDefEpoch == nEpoch)
+	{
+		TIMM_OSAL_Memcpy(pPortDef, &(pPort->tPortDef),
+		    sizeof(OMX_PARAM_PORTDEFINITIONTYPE));
+		goto EXIT;
+	}
+
+	eError = PROXY_GetParameter(hComponent, OMX_IndexParamPortDefinition,
+	    pPortDef);
+	PROXY_assert(eError == OMX_ErrorNone, eError,
+	    "Port definition read failed");
+
+	/*An invalidation while the read was in flight means the answer may
+	  already be stale, don't keep it */
+	__sync_synchronize();
+	if (pCompPrv->nPortDefEpoch == nEpoch)
+	{
+		TIMM_OSAL_Memcpy(&(pPort->tPortDef), pPortDef,
+		    sizeof(OMX_PARAM_PORTDEFINITIONTYPE));
+		pPort->nPortDefEpoch = nEpoch;
+		pPort->bPortDefValid = OMX_TRUE;
+	}
+
+      EXIT:
+	return eError;
+}
+
 /* ===========================================================================*/
 /**
  * @name __PROXY_GetConfig()
@@ -1564,11 +3834,16 @@ OMX_ERRORTYPE __PROXY_GetConfig(OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER("hComponent = %p, pCompPrv = %p, nConfigIndex = %d, "
 				"pConfigStruct = %p",
 				hComponent, pCompPrv, nConfigIndex,
 				pConfigStruct);
 
+	/*Reads what the client set even if it is still queued */
+	PROXY_ConfigQueueFlush(pCompPrv);
+
 #if 0
 #ifdef USE_ION
 	if (pAuxBuf != NULL) {
@@ -1651,11 +3926,22 @@ OMX_ERRORTYPE __PROXY_SetConfig(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER("hComponent = %p, pCompPrv = %p, nConfigIndex = %d, "
 				"pConfigStruct = %p",
 				hComponent, pCompPrv, nConfigIndex,
 				pConfigStruct);
 
+	if (pLocBufNeedMap == NULL &&
+	    PROXY_ConfigQueuePut(pCompPrv, nConfigIndex, pConfigStruct))
+	{
+		PROXY_RecoveryRecord(pCompPrv, OMX_TRUE, nConfigIndex,
+		    pConfigStruct, NULL);
+		goto EXIT;
+	}
+	PROXY_ConfigQueueFlush(pCompPrv);
+
 #ifdef USE_ION
 	if (pAuxBuf != NULL) {
 		int fd = *((int*)pAuxBuf);
@@ -1682,6 +3968,8 @@ OMX_ERRORTYPE __PROXY_SetConfig(OMX_IN OMX_HANDLETYPE hComponent,
 #endif
 
 	PROXY_checkRpcError();
+	PROXY_RecoveryRecord(pCompPrv, OMX_TRUE, nConfigIndex, pConfigStruct,
+	    pLocBufNeedMap);
 
       EXIT:
 	DOMX_EXIT("eError: %d", eError);
@@ -1722,6 +4010,8 @@ static OMX_ERRORTYPE PROXY_GetState(OMX_IN OMX_HANDLETYPE hComponent,
 	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
 	OMX_COMPONENTTYPE *hComp = hComponent;
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+	OMX_TI_STATUSPAGE tStatus;
+	OMX_U32 nEpoch = 0;
 
 	PROXY_require((pState != NULL), OMX_ErrorBadParameter, NULL);
 	PROXY_require((hComp->pComponentPrivate != NULL),
@@ -1729,14 +4019,41 @@ static OMX_ERRORTYPE PROXY_GetState(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER("hComponent = %p, pCompPrv = %p", hComponent, pCompPrv);
 
+	PROXY_assert(!((RPC_OMX_CONTEXT *) pCompPrv->hRemoteComp)->bRemoteDead,
+	    OMX_ErrorHardware, "Remote core is gone");
+
+	/*Between transitions the remote side only changes state on errors */
+	if (pCompPrv->nStatePending == 0 && pCompPrv->bStateKnown)
+	{
+		*pState = pCompPrv->eState;
+		goto EXIT;
+	}
+
+	/*The remote side keeps the page current through transitions too */
+	if (PROXY_StatusPageRead(pCompPrv, &tStatus))
+	{
+		*pState = tStatus.eState;
+		goto EXIT;
+	}
+
+	nEpoch = pCompPrv->nStateEpoch;
 	eRPCError = RPC_GetState(pCompPrv->hRemoteComp, pState, &eCompReturn);
 
 	DOMX_DEBUG("Returned from RPC_GetState, state: = %x", *pState);
 
 	PROXY_checkRpcError();
 
+	/*Only kept if no transition completed while the query was out */
+	if (pCompPrv->nStatePending == 0 && nEpoch == pCompPrv->nStateEpoch)
+	{
+		pCompPrv->eState = *pState;
+		pCompPrv->bStateKnown = OMX_TRUE;
+	}
+
       EXIT:
 	if (eError == OMX_ErrorHardware)
 	{
@@ -1772,12 +4089,15 @@ OMX_ERRORTYPE PROXY_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
 	PROXY_COMPONENT_PRIVATE *pMarkCompPrv = NULL;
 	OMX_PTR pMarkData = NULL, pMarkToBeFreedIfError = NULL;
 	OMX_BOOL bIsProxy = OMX_FALSE;
+	OMX_U32 i = 0;
 
 	PROXY_require((hComp->pComponentPrivate != NULL),
 	    OMX_ErrorBadParameter, NULL);
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER
 	    ("hComponent = %p, pCompPrv = %p, eCmd = %d, nParam = %d, pCmdData = %p",
 	    hComponent, pCompPrv, eCmd, nParam, pCmdData);
@@ -1795,11 +4115,9 @@ OMX_ERRORTYPE PROXY_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
 
 		/*Replacing original mark data with proxy specific structure */
 		pMarkData = ((OMX_MARKTYPE *) pCmdData)->pMarkData;
-		((OMX_MARKTYPE *) pCmdData)->pMarkData =
-		    TIMM_OSAL_Malloc(sizeof(PROXY_MARK_DATA), TIMM_OSAL_TRUE,
-		    0, TIMMOSAL_MEM_SEGMENT_INT);
+		((OMX_MARKTYPE *) pCmdData)->pMarkData = PROXY_MarkDataAlloc();
 		PROXY_assert(((OMX_MARKTYPE *) pCmdData)->pMarkData != NULL,
-		    OMX_ErrorInsufficientResources, "Malloc failed");
+		    OMX_ErrorInsufficientResources, "Mark data allocation failed");
 		pMarkToBeFreedIfError =
 		    ((OMX_MARKTYPE *) pCmdData)->pMarkData;
 		((PROXY_MARK_DATA *) (((OMX_MARKTYPE *)
@@ -1824,9 +4142,35 @@ OMX_ERRORTYPE PROXY_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
 		}
 	}
 
+	PROXY_ConfigQueueFlush(pCompPrv);
+	if ((eCmd == OMX_CommandStateSet && nParam == OMX_StateIdle &&
+		pCompPrv->eState == OMX_StateLoaded) ||
+	    eCmd == OMX_CommandPortEnable)
+	{
+		for (i = 0; i < PROXY_MAXNUMOFPORTS; i++)
+		{
+			if (eCmd == OMX_CommandPortEnable && nParam != OMX_ALL &&
+			    nParam != i)
+				continue;
+			if (!PROXY_OutSizeStart(hComponent, pCompPrv, i))
+				break;
+		}
+	}
+	if (eCmd == OMX_CommandStateSet)
+	{
+		PROXY_LoadState(hComponent, pCompPrv, (OMX_STATETYPE) nParam);
+		__sync_fetch_and_add(&pCompPrv->nStatePending, 1);
+	}
+	if (eCmd == OMX_CommandFlush && !pCompPrv->bFlushDoneProbed)
+		PROXY_FlushDoneProbe(pCompPrv);
+
 	eRPCError =
 	    RPC_SendCommand(pCompPrv->hRemoteComp, eCmd, nParam, pCmdData,
 	    &eCompReturn);
+	/*Not accepted, no CmdComplete will come for it */
+	if (eCmd == OMX_CommandStateSet && (eRPCError != RPC_OMX_ErrorNone ||
+		eCompReturn != OMX_ErrorNone))
+		__sync_fetch_and_sub(&pCompPrv->nStatePending, 1);
 
 	if (eCmd == OMX_CommandMarkBuffer && bIsProxy)
 	{
@@ -1843,7 +4187,7 @@ OMX_ERRORTYPE PROXY_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
 	   will be lost so free it here */
 	if ((eError != OMX_ErrorNone) && pMarkToBeFreedIfError)
 	{
-		TIMM_OSAL_Free(pMarkToBeFreedIfError);
+		PROXY_MarkDataFree(pMarkToBeFreedIfError);
 	}
 	DOMX_EXIT("eError: %d", eError);
 	return eError;
@@ -1871,6 +4215,7 @@ static OMX_ERRORTYPE PROXY_GetComponentVersion(OMX_IN OMX_HANDLETYPE
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 	OMX_COMPONENTTYPE *hComp = hComponent;
 	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	PROXY_PARAM_CACHE *pCache = NULL;
 
 	DOMX_ENTER("hComponent = %p, pCompPrv = %p", hComponent, pCompPrv);
 
@@ -1882,6 +4227,19 @@ static OMX_ERRORTYPE PROXY_GetComponentVersion(OMX_IN OMX_HANDLETYPE
 	PROXY_require(pComponentUUID != NULL, OMX_ErrorBadParameter, NULL);
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+	pCache = pCompPrv->pParamCache;
+
+	/*Versions of the remote component don't change for its lifetime */
+	if (pCache != NULL && pCache->bVersionValid)
+	{
+		TIMM_OSAL_Memcpy(pComponentName, pCache->cCompName,
+		    OMX_MAX_STRINGNAME_SIZE);
+		*pComponentVersion = pCache->tCompVersion;
+		*pSpecVersion = pCache->tSpecVersion;
+		TIMM_OSAL_Memcpy(pComponentUUID, pCache->tCompUUID,
+		    sizeof(OMX_UUIDTYPE));
+		goto EXIT;
+	}
 
 	eRPCError = RPC_GetComponentVersion(pCompPrv->hRemoteComp,
 	    pComponentName,
@@ -1889,6 +4247,19 @@ static OMX_ERRORTYPE PROXY_GetComponentVersion(OMX_IN OMX_HANDLETYPE
 
 	PROXY_checkRpcError();
 
+	if (pCache != NULL)
+	{
+		TIMM_OSAL_MutexObtain(pCache->hLock, TIMM_OSAL_SUSPEND);
+		strncpy((char *)pCache->cCompName, pComponentName,
+		    OMX_MAX_STRINGNAME_SIZE - 1);
+		pCache->tCompVersion = *pComponentVersion;
+		pCache->tSpecVersion = *pSpecVersion;
+		TIMM_OSAL_Memcpy(pCache->tCompUUID, pComponentUUID,
+		    sizeof(OMX_UUIDTYPE));
+		pCache->bVersionValid = OMX_TRUE;
+		TIMM_OSAL_MutexRelease(pCache->hLock);
+	}
+
       EXIT:
 	DOMX_EXIT("eError: %d", eError);
 	return eError;
@@ -1922,6 +4293,8 @@ OMX_ERRORTYPE PROXY_GetExtensionIndex(OMX_IN OMX_HANDLETYPE hComponent,
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
 	DOMX_ENTER("hComponent = %p, pCompPrv = %p, cParameterName = %s",
 	    hComponent, pCompPrv, cParameterName);
 
@@ -1946,19 +4319,20 @@ OMX_ERRORTYPE PROXY_GetExtensionIndex(OMX_IN OMX_HANDLETYPE hComponent,
 		*pIndexType = (OMX_INDEXTYPE) NULL;
 		goto EXIT;
 	}
-	else
-	{
-		eRPCError = RPC_GetExtensionIndex(pCompPrv->hRemoteComp,
-                   cParameterName, pIndexType, &eCompReturn);
+#endif
+
+	if (PROXY_ExtCacheLookup(pCompPrv, cParameterName, pIndexType,
+		&eError))
+		goto EXIT;
 
-		PROXY_checkRpcError();
-	}
-#else
 	eRPCError = RPC_GetExtensionIndex(pCompPrv->hRemoteComp,
 	    cParameterName, pIndexType, &eCompReturn);
+	/*Only what the component itself answered, not transport failures */
+	if (eRPCError == RPC_OMX_ErrorNone)
+		PROXY_ExtCacheStore(pCompPrv, cParameterName, *pIndexType,
+		    eCompReturn);
 
 	PROXY_checkRpcError();
-#endif
 
       EXIT:
 	DOMX_EXIT("eError: %d", eError);
@@ -1994,10 +4368,15 @@ static OMX_ERRORTYPE PROXY_ComponentRoleEnum(OMX_IN OMX_HANDLETYPE hComponent,
 /* ===========================================================================*/
 /**
  * @name PROXY_ComponentTunnelRequest()
- * @brief
- * @param void
+ * @brief Sets up or tears down a tunnel between this component and another
+ *        proxy. Both components live on the remote core, the tunnel is made
+ *        there so buffers of the port never travel through the A9.
+ * @param hComponent [IN]    : This component.
+ * @param nPort [IN]         : Port of this component.
+ * @param hTunneledComp [IN] : Peer proxy, NULL to tear the tunnel down.
+ * @param nTunneledPort [IN] : Port of the peer.
+ * @param pTunnelSetup [INOUT] : Negotiated supplier and flags.
  * @return OMX_ErrorNone = Successful
- * @sa TBD
  *
  */
 /* ===========================================================================*/
@@ -2006,37 +4385,48 @@ static OMX_ERRORTYPE PROXY_ComponentTunnelRequest(OMX_IN OMX_HANDLETYPE
     OMX_IN OMX_U32 nTunneledPort,
     OMX_INOUT OMX_TUNNELSETUPTYPE * pTunnelSetup)
 {
-	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_ERRORTYPE eError = OMX_ErrorNone, eCompReturn = OMX_ErrorNone;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+	PROXY_COMPONENT_PRIVATE *pTunneledCompPrv = NULL;
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	OMX_COMPONENTTYPE *hTunneled = (OMX_COMPONENTTYPE *) hTunneledComp;
+	OMX_HANDLETYPE hTunneledRemote = NULL;
 
-	DOMX_ENTER("hComponent = %p", hComponent);
-	DOMX_DEBUG(" EMPTY IMPLEMENTATION ");
-	PROXY_COMPONENT_PRIVATE *pOutCompPrv = NULL;
-	PROXY_COMPONENT_PRIVATE *pInCompPrv  = NULL;
-	OMX_COMPONENTTYPE       *hOutComp    = hComponent;
-	OMX_COMPONENTTYPE       *hInComp     = hTunneledComp;
-	OMX_ERRORTYPE           eCompReturn = OMX_ErrorNone;
-	RPC_OMX_ERRORTYPE       eRPCError    = RPC_OMX_ErrorNone;
-	PROXY_assert((hOutComp->pComponentPrivate != NULL),
-	    OMX_ErrorBadParameter, NULL);
-	PROXY_assert((hInComp->pComponentPrivate != NULL),
+	PROXY_require((hComp->pComponentPrivate != NULL),
 	    OMX_ErrorBadParameter, NULL);
+	PROXY_require(nPort < PROXY_MAXNUMOFPORTS, OMX_ErrorBadPortIndex, NULL);
 
-        //TBD
-        //PROXY_assert(nPort != 1, OMX_ErrorBadParameter, NULL);
-        //PROXY_assert(nTunnelPort != 0, OMX_ErrorBadParameter, NULL);
-	pOutCompPrv = (PROXY_COMPONENT_PRIVATE *) hOutComp->pComponentPrivate;
-	pInCompPrv  = (PROXY_COMPONENT_PRIVATE *) hInComp->pComponentPrivate;
-	DOMX_ENTER("hOutComp=%p, pOutCompPrv=%p, hInComp=%p, pInCompPrv=%p, nOutPort=%d, nInPort=%d \n",
-	        hOutComp, pOutCompPrv, hInComp, pInCompPrv, nPort, nTunneledPort);
-
-	DOMX_INFO("PROXY_ComponentTunnelRequest:: hOutComp=%p, pOutCompPrv=%p, hInComp=%p, pInCompPrv=%p, nOutPort=%d, nInPort=%d \n ",
-	        hOutComp, pOutCompPrv, hInComp, pInCompPrv, nPort, nTunneledPort);
-       eRPCError = RPC_ComponentTunnelRequest(pOutCompPrv->hRemoteComp, nPort,
-	        pInCompPrv->hRemoteComp, nTunneledPort, pTunnelSetup, &eCompReturn);
-        DOMX_INFO("\nafter: RPC_ComponentTunnelRequest = 0x%x\n ", eRPCError);
-        PROXY_checkRpcError();
+	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
-EXIT:
+	DOMX_ENTER("hComponent = %p, nPort = %d, hTunneledComp = %p, "
+	    "nTunneledPort = %d", hComponent, nPort, hTunneledComp,
+	    nTunneledPort);
+
+	if (hTunneled != NULL)
+	{
+		/*Only another proxy has a counterpart on the remote core that
+		  the tunnel can be made to*/
+		PROXY_require(hTunneled->ComponentTunnelRequest ==
+		    PROXY_ComponentTunnelRequest &&
+		    hTunneled->pComponentPrivate != NULL,
+		    OMX_ErrorPortsNotCompatible,
+		    "Remote components can only be tunneled to each other");
+		pTunneledCompPrv =
+		    (PROXY_COMPONENT_PRIVATE *) hTunneled->pComponentPrivate;
+		hTunneledRemote = pTunneledCompPrv->hRemoteComp;
+	}
+
+	eRPCError = RPC_ComponentTunnelRequest(pCompPrv->hRemoteComp, nPort,
+	    hTunneledRemote, nTunneledPort, pTunnelSetup, &eCompReturn);
+	PROXY_checkRpcError();
+
+	pCompPrv->proxyPortBuffers[nPort].bTunneled =
+	    (hTunneled != NULL) ? OMX_TRUE : OMX_FALSE;
+	/*The remote side may change buffer counts and sizes of the port */
+	PROXY_InvalidatePortDefinitions(pCompPrv);
+
+      EXIT:
 	DOMX_EXIT("eError: %d", eError);
 	return eError;
 }
@@ -2124,67 +4514,73 @@ OMX_ERRORTYPE PROXY_ComponentDeInit(OMX_HANDLETYPE hComponent)
 
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
+	PROXY_RecoveryWait(pCompPrv);
+
+	PROXY_LoadState(hComponent, pCompPrv, OMX_StateLoaded);
+	PROXY_AdmitRelease(pCompPrv);
+	PROXY_StatusPageClose(pCompPrv);
+	PROXY_StructScratchClose(pCompPrv);
 	MemPlugin_Close(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc);
 	for (count = 0; count < pCompPrv->nTotalBuffers; count++)
 	{
-		if (pCompPrv->tBufList[count].pBufHeader)
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader)
 		{
 			//find the input or output port index
-			if(pCompPrv->tBufList[count].pBufHeader->nInputPortIndex >= 0)
-				nPortIndex = pCompPrv->tBufList[count].pBufHeader->nInputPortIndex;
-			else if(pCompPrv->tBufList[count].pBufHeader->nOutputPortIndex >= 0)
-				nPortIndex = pCompPrv->tBufList[count].pBufHeader->nOutputPortIndex;
+			if(PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader->nInputPortIndex >= 0)
+				nPortIndex = PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader->nInputPortIndex;
+			else if(PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader->nOutputPortIndex >= 0)
+				nPortIndex = PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader->nOutputPortIndex;
 #ifdef ALLOCATE_TILER_BUFFER_IN_PROXY
-				if(pCompPrv->tBufList[count].bufferAccessors[0].pBufferHandle)
+				if(PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferHandle)
 				{
 						MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
-						delBuffer_prop.sBuffer_accessor.pBufferHandle = pCompPrv->tBufList[count].bufferAccessors[0].pBufferHandle;
-						delBuffer_prop.sBuffer_accessor.pBufferMappedAddress = pCompPrv->tBufList[count].bufferAccessors[0].pBufferMappedAddress;
-						delBuffer_prop.sBuffer_accessor.bufferFd = pCompPrv->tBufList[count].bufferAccessors[0].bufferFd;
+						delBuffer_prop.sBuffer_accessor.pBufferHandle = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferHandle;
+						delBuffer_prop.sBuffer_accessor.pBufferMappedAddress = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferMappedAddress;
+						delBuffer_prop.sBuffer_accessor.bufferFd = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].bufferFd;
 						delBuffer_params.bMap = pCompPrv->bMapBuffers;
-						delBuffer_params.nWidth = pCompPrv->tBufList[count].pBufHeader->nAllocLen;
+						delBuffer_params.nWidth = PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader->nAllocLen;
 						MemPlugin_Free(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc,&delBuffer_params,&delBuffer_prop);
 
-						pCompPrv->tBufList[count].bufferAccessors[0].pBufferHandle = NULL;
-						pCompPrv->tBufList[count].bufferAccessors[0].pBufferMappedAddress = NULL;
-						pCompPrv->tBufList[count].bufferAccessors[0].bufferFd = -1;
+						PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferHandle = NULL;
+						PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pBufferMappedAddress = NULL;
+						PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].bufferFd = -1;
 				}
 #endif
-			pMetaDataBuffer = ((OMX_TI_PLATFORMPRIVATE *)(pCompPrv->tBufList[count].pBufHeader)->
+			pMetaDataBuffer = ((OMX_TI_PLATFORMPRIVATE *)(PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader)->
 				pPlatformPrivate)->pMetaDataBuffer;
 			if (pMetaDataBuffer)
 			{
 					MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
-					delBuffer_prop.sBuffer_accessor.pBufferHandle = pCompPrv->tBufList[count].bufferAccessors[2].pBufferHandle;
-					delBuffer_prop.sBuffer_accessor.pBufferMappedAddress = pCompPrv->tBufList[count].bufferAccessors[2].pBufferMappedAddress;
-					delBuffer_prop.sBuffer_accessor.bufferFd = pCompPrv->tBufList[count].bufferAccessors[2].bufferFd;
+					delBuffer_prop.sBuffer_accessor.pBufferHandle = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pBufferHandle;
+					delBuffer_prop.sBuffer_accessor.pBufferMappedAddress = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pBufferMappedAddress;
+					delBuffer_prop.sBuffer_accessor.bufferFd = PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].bufferFd;
 					delBuffer_params.bMap = pCompPrv->bMapBuffers;
-					delBuffer_params.nWidth = ((OMX_TI_PLATFORMPRIVATE *)(pCompPrv->tBufList[count].pBufHeader)->pPlatformPrivate)->nMetaDataSize;
+					delBuffer_params.nWidth = ((OMX_TI_PLATFORMPRIVATE *)(PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader)->pPlatformPrivate)->nMetaDataSize;
 					MemPlugin_Free(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc,&delBuffer_params,&delBuffer_prop);
-					((OMX_TI_PLATFORMPRIVATE *)(pCompPrv->tBufList[count].pBufHeader)->
+					((OMX_TI_PLATFORMPRIVATE *)(PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader)->
 					pPlatformPrivate)->pMetaDataBuffer = NULL;
-					pCompPrv->tBufList[count].bufferAccessors[2].pBufferHandle = NULL;
-					pCompPrv->tBufList[count].bufferAccessors[2].pBufferMappedAddress = NULL;
-					pCompPrv->tBufList[count].bufferAccessors[2].bufferFd = -1;
+					PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pBufferHandle = NULL;
+					PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pBufferMappedAddress = NULL;
+					PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].bufferFd = -1;
 			}
 #ifdef USE_ION
 	{
 		// Need to unregister buffers when using ion and rpmsg
-		if (pCompPrv->tBufList[count].bufferAccessors[0].pRegBufferHandle != NULL)
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pRegBufferHandle != NULL)
 		{
 			eTmpRPCError = RPC_UnRegisterBuffer(pCompPrv->hRemoteComp,
-								pCompPrv->tBufList[count].bufferAccessors[0].pRegBufferHandle,
-								pCompPrv->tBufList[count].bufferAccessors[1].pRegBufferHandle,
+								PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[0].pRegBufferHandle,
+								PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[1].pRegBufferHandle,
 								pCompPrv->proxyPortBuffers[nPortIndex].proxyBufferType);
 			if (eTmpRPCError != RPC_OMX_ErrorNone) {
 				eRPCError = eTmpRPCError;
 			}
 		}
 
-		if (pCompPrv->tBufList[count].bufferAccessors[2].pRegBufferHandle != NULL)
+		if (PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pRegBufferHandle != NULL)
 		{
 			eTmpRPCError |= RPC_UnRegisterBuffer(pCompPrv->hRemoteComp,
-								pCompPrv->tBufList[count].bufferAccessors[2].pRegBufferHandle, NULL, IONPointers);
+								PROXY_BUFLIST_ENTRY(pCompPrv, count).bufferAccessors[2].pRegBufferHandle, NULL, IONPointers);
 			if (eTmpRPCError != RPC_OMX_ErrorNone) {
 				eRPCError |= eTmpRPCError;
 			}
@@ -2192,13 +4588,9 @@ OMX_ERRORTYPE PROXY_ComponentDeInit(OMX_HANDLETYPE hComponent)
 	}
 #endif
 
-			if (pCompPrv->tBufList[count].pBufHeader->pPlatformPrivate)
-			{
-				TIMM_OSAL_Free(pCompPrv->tBufList[count].pBufHeader->
-				    pPlatformPrivate);
-			}
-			TIMM_OSAL_Free(pCompPrv->tBufList[count].pBufHeader);
-			TIMM_OSAL_Memset(&(pCompPrv->tBufList[count]), 0,
+			/*The header itself goes with the hBufHdrArena below */
+			PROXY_RemoteHashRemove(pCompPrv, count);
+			TIMM_OSAL_Memset(&(PROXY_BUFLIST_ENTRY(pCompPrv, count)), 0,
 			    sizeof(PROXY_BUFFER_INFO));
 		}
 	}
@@ -2213,6 +4605,34 @@ OMX_ERRORTYPE PROXY_ComponentDeInit(OMX_HANDLETYPE hComponent)
 	if (eRPCError != RPC_OMX_ErrorNone)
 		eTmpRPCError = eRPCError;
 
+	/*No callbacks can come in any more*/
+	PROXY_FreeBufList(pCompPrv);
+	for (count = 0; count < PROXY_MAXNUMOFPORTS; count++)
+		if (pCompPrv->hBufHdrArena[count])
+			TIMM_OSAL_DeleteArena(pCompPrv->hBufHdrArena[count]);
+	if (pCompPrv->pParamCache)
+	{
+		TIMM_OSAL_MutexDelete(((PROXY_PARAM_CACHE *)
+			pCompPrv->pParamCache)->hLock);
+		TIMM_OSAL_Free(pCompPrv->pParamCache);
+	}
+	if (pCompPrv->pConfigQueue)
+	{
+		TIMM_OSAL_MutexDelete(((PROXY_CONFIG_QUEUE *)
+			pCompPrv->pConfigQueue)->hLock);
+		TIMM_OSAL_Free(pCompPrv->pConfigQueue);
+	}
+	if (pCompPrv->pRecovery)
+	{
+		PROXY_RECOVERY *pRec = pCompPrv->pRecovery;
+
+		if (pRec->bThreadValid)
+			pthread_join(pRec->tThread, NULL);
+		pthread_cond_destroy(&pRec->tDone);
+		pthread_mutex_destroy(&pRec->tLock);
+		TIMM_OSAL_Free(pRec);
+	}
+
 	eMemError = MemPlugin_DeInit(pCompPrv->pMemPluginHandle);
 	if (pCompPrv->cCompName)
 	{
@@ -2223,6 +4643,8 @@ OMX_ERRORTYPE PROXY_ComponentDeInit(OMX_HANDLETYPE hComponent)
 	{
 		TIMM_OSAL_Free(pCompPrv);
 	}
+	/*Whatever is still live now is either shared or leaked*/
+	TIMM_OSAL_DumpMemStats();
 
 	eRPCError = eTmpRPCError;
 	PROXY_checkRpcError();
@@ -2245,14 +4667,16 @@ OMX_ERRORTYPE OMX_ProxyCommonInit(OMX_HANDLETYPE hComponent)
 {
 	OMX_ERRORTYPE eError = OMX_ErrorNone, eCompReturn = OMX_ErrorNone;
 	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
-	PROXY_COMPONENT_PRIVATE *pCompPrv;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	OMX_HANDLETYPE hRemoteComp = NULL;
+	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
     OMX_U32 i = 0;
     MEMPLUGIN_ERRORTYPE eMemError = MEMPLUGIN_ERROR_NONE;
 	DOMX_ENTER("hComponent = %p", hComponent);
 
 	TIMM_OSAL_UpdateTraceLevel();
+	TIMM_OSAL_UpdateTraceMarker();
 
 	PROXY_require((hComp->pComponentPrivate != NULL),
 	    OMX_ErrorBadParameter, NULL);
@@ -2264,12 +4688,60 @@ OMX_ERRORTYPE OMX_ProxyCommonInit(OMX_HANDLETYPE hComponent)
 	pCompPrv->proxyEmptyBufferDone = PROXY_EmptyBufferDone;
 	pCompPrv->proxyFillBufferDone = PROXY_FillBufferDone;
 	pCompPrv->proxyEventHandler = PROXY_EventHandler;
+	pCompPrv->proxyFlushDone = PROXY_FlushDone;
+
+	for (i = 0; i < PROXY_MAXNUMOFPORTS; i++)
+	{
+		eOSALStatus = TIMM_OSAL_CreateArena(&(pCompPrv->hBufHdrArena[i]),
+		    sizeof(PROXY_BUFFER_HEADER), PROXY_BUFHDR_ALIGNMENT);
+		PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE,
+		    OMX_ErrorInsufficientResources,
+		    "Buffer header arena not created");
+	}
+
+	/*Without it every GetParameter simply goes to the remote side */
+	pCompPrv->pParamCache =
+	    TIMM_OSAL_Malloc(sizeof(PROXY_PARAM_CACHE), TIMM_OSAL_TRUE, 0,
+	    TIMMOSAL_MEM_SEGMENT_INT);
+	if (pCompPrv->pParamCache != NULL)
+	{
+		TIMM_OSAL_Memset(pCompPrv->pParamCache, 0,
+		    sizeof(PROXY_PARAM_CACHE));
+		eOSALStatus = TIMM_OSAL_MutexCreate(&(((PROXY_PARAM_CACHE *)
+			    pCompPrv->pParamCache)->hLock));
+		if (eOSALStatus != TIMM_OSAL_ERR_NONE)
+		{
+			TIMM_OSAL_Free(pCompPrv->pParamCache);
+			pCompPrv->pParamCache = NULL;
+		}
+	}
+	if (pCompPrv->pParamCache == NULL)
+		DOMX_WARN("GetParameter cache not available");
+
+	if (PROXY_RecoveryEnabled())
+	{
+		pCompPrv->pRecovery =
+		    TIMM_OSAL_Malloc(sizeof(PROXY_RECOVERY), TIMM_OSAL_TRUE,
+		    0, TIMMOSAL_MEM_SEGMENT_INT);
+		if (pCompPrv->pRecovery != NULL)
+		{
+			PROXY_RECOVERY *pRec = pCompPrv->pRecovery;
+
+			TIMM_OSAL_Memset(pRec, 0, sizeof(PROXY_RECOVERY));
+			pthread_mutex_init(&pRec->tLock, NULL);
+			pthread_cond_init(&pRec->tDone, NULL);
+		} else
+			DOMX_WARN("Remote instance recovery not available");
+	}
 
         for (i=0; i<PROXY_MAXNUMOFPORTS ; i++)
         {
               pCompPrv->proxyPortBuffers[i].proxyBufferType = VirtualPointers;
         }
 
+	PROXY_assert(PROXY_AdmitInstance(pCompPrv),
+	    OMX_ErrorInsufficientResources, "Codec budget used up");
+
 	eRPCError = RPC_InstanceInit(pCompPrv->cCompName, &hRemoteComp);
 	PROXY_assert(eRPCError == RPC_OMX_ErrorNone,
 	    OMX_ErrorUndefined, "Error initializing RPC");
@@ -2282,6 +4754,8 @@ OMX_ERRORTYPE OMX_ProxyCommonInit(OMX_HANDLETYPE hComponent)
 	    (OMX_PTR) hComponent, NULL, &eCompReturn);
 
 	PROXY_checkRpcError();
+	pCompPrv->eState = OMX_StateLoaded;
+	pCompPrv->bStateKnown = OMX_TRUE;
 
 	hComp->SetCallbacks = PROXY_SetCallbacks;
 	hComp->ComponentDeInit = PROXY_ComponentDeInit;
@@ -2318,11 +4792,39 @@ OMX_ERRORTYPE OMX_ProxyCommonInit(OMX_HANDLETYPE hComponent)
 		DOMX_ERROR("Mem manager client creation failed!!!");
 		return OMX_ErrorInsufficientResources;
 	}
+	/*Still on the default heap, see PROXY_StatusPageOpen */
+	PROXY_StatusPageOpen(pCompPrv);
+	PROXY_StructScratchOpen(pCompPrv);
+	/*Heap, alignment and reservations per component come from
+	  MemPlugins_ComponentConfig*/
+	eMemError = MemPlugin_ConfigureComponent(pCompPrv->pMemPluginHandle,
+	    pCompPrv->nMemmgrClientDesc, pCompPrv->cCompName);
+	if(eMemError != MEMPLUGIN_ERROR_NONE)
+	{
+		DOMX_ERROR("Mem manager client configuration failed %d", eMemError);
+	}
 	KPI_OmxCompInit(hComponent);
 
       EXIT:
 	if (eError != OMX_ErrorNone)
+	{
 		RPC_InstanceDeInit(hRemoteComp);
+		for (i = 0; pCompPrv && i < PROXY_MAXNUMOFPORTS; i++)
+		{
+			if (pCompPrv->hBufHdrArena[i])
+				TIMM_OSAL_DeleteArena(pCompPrv->hBufHdrArena[i]);
+			pCompPrv->hBufHdrArena[i] = NULL;
+		}
+		if (pCompPrv && pCompPrv->pRecovery)
+		{
+			pthread_cond_destroy(&((PROXY_RECOVERY *)
+				pCompPrv->pRecovery)->tDone);
+			pthread_mutex_destroy(&((PROXY_RECOVERY *)
+				pCompPrv->pRecovery)->tLock);
+			TIMM_OSAL_Free(pCompPrv->pRecovery);
+			pCompPrv->pRecovery = NULL;
+		}
+	}
 	DOMX_EXIT("eError: %d", eError);
 
 	return eError;
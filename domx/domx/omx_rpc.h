@@ -101,6 +101,13 @@ extern "C"
 
 	} RPC_OMX_ERRORTYPE;
 
+	typedef enum RPC_OMX_PRIORITY
+	{
+		RPC_OMX_PRIORITY_DEFAULT = 0,
+		RPC_OMX_PRIORITY_HIGH,	/* Interactive work: preview, video call */
+		RPC_OMX_PRIORITY_LOW	/* Batch work: thumbnails, transcoding */
+	} RPC_OMX_PRIORITY;
+
 
 /****************************************************************
  * PUBLIC DECLARATIONS Defined here, used elsewhere
@@ -142,6 +149,26 @@ extern "C"
 
 
 
+/* ===========================================================================*/
+/**
+ * @name RPC_SetPriority()
+ * @brief Selects the remote pool all further messages of this instance are
+ *        sent to. Instances get a default from their component name in
+ *        RPC_InstanceInit, proxies can change it at any time. Pools other
+ *        than the default one are only used when debug.domx.rpc_pools is set,
+ *        as the remote firmware has to provide them.
+ * @param hRPCCtx  : RPC context handle.
+ * @param ePriority : Priority class of the instance.
+ * @return RPC_OMX_ErrorNone = Successful
+ * @sa TBD
+ *
+ */
+/* ===========================================================================*/
+	RPC_OMX_ERRORTYPE RPC_SetPriority(OMX_HANDLETYPE hRPCCtx,
+	    RPC_OMX_PRIORITY ePriority);
+
+
+
 #ifdef __cplusplus
 }
 #endif				/* __cplusplus */
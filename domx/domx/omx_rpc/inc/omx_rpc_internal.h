@@ -74,6 +74,7 @@ extern "C"
 
 /*-------program files ----------------------------------------*/
 #include "omx_rpc.h"
+#include "omx_rpc_record.h"
 
 
 /******************************************************************
@@ -82,10 +83,56 @@ extern "C"
 /* *********************** OMX RPC DEFINES***********************************/
 
 /*This defines the maximum number of remote functions that can be registered*/
-#define RPC_OMX_MAX_FUNCTION_LIST 21
+#define RPC_OMX_MAX_FUNCTION_LIST 23
+/*Large enough for the header of struct omx_packet */
+#define RPC_ERROR_PACKET_WORDS 8
 /*Packet size for each message*/
 #define RPC_PACKET_SIZE 0x12C
 
+/* When this is defined ETB/FTB calls are made in sync mode. Building with
+ * RPC_ASYNC_MODE will result in these calls being sent via async mode. Sync
+ * mode leads to correct functionality as per OMX spec but has a slight
+ * performance penalty. Async mode sacrifices strict adherence to spec for some
+ * gain in performance - ETB/FTB return as soon as the packet is queued and any
+ * error returned by the remote component is reported later through the
+ * EventHandler callback. */
+#ifndef RPC_ASYNC_MODE
+#define RPC_SYNC_MODE
+#endif
+
+/*Number of preallocated packets per RPC context. Requests beyond this fall back
+  to heap allocation. Outstanding packets are bounded by one request per caller
+  thread plus one pending reply per function index, so this is rarely hit*/
+#define RPC_PACKET_POOL_SIZE 32
+/*Marks the end of the packet pool free list*/
+#define RPC_PACKET_POOL_EMPTY 0xFFFF
+
+/*Max buffer headers returned by one flush-done packet. The four word header
+  plus this many remote headers has to fit in the data area of an
+  RPC_PACKET_SIZE packet, ports holding more are returned in several*/
+#define RPC_FLUSH_DONE_MAX 56
+
+/*Buffer registrations kept per RPC context. Unused registrations stay
+  until their slot is needed or the context goes away*/
+#define RPC_REGCACHE_SIZE 32
+
+/*Unused registrations kept at most. Each one keeps its buffer allocated*/
+#define RPC_REGCACHE_IDLE_MAX 8
+
+/*Map ids hand out the cache slot in the low byte and a count of the
+  registrations made so far above it, so an id is not reused for a
+  different buffer before the count wraps*/
+#define RPC_REGCACHE_MAPID(nSlot, nGen) ((((nGen) & 0xFFFFFF) << 8) | ((nSlot) + 1))
+
+/*Size of the buffer param/config structures too large for a packet are
+  passed in, see OMX_TI_IndexParamStructScratch*/
+#define RPC_STRUCT_SCRATCH_SIZE (16 * 1024)
+
+/*Sent in place of nSize of a structure that was put in the scratch buffer,
+  the offset and size of the structure in the buffer follow. No structure
+  has a size of 0*/
+#define RPC_STRUCT_IN_SCRATCH 0
+
 
 
 /*******************************************************************************
@@ -129,6 +176,7 @@ extern "C"
 		RPC_OMX_FXN_IDX_EVENTHANDLER = 16,
 		RPC_OMX_FXN_IDX_ALLOCATE_BUFFER = 17,
 		RPC_OMX_FXN_IDX_COMP_TUNNEL_REQUEST = 18,
+		RPC_OMX_FXN_IDX_FLUSH_DONE = 22,
 		RPC_OMX_FXN_IDX_MAX = RPC_OMX_MAX_FUNCTION_LIST
 	} RPC_OMX_FXN_IDX_TYPE;
 
@@ -154,6 +202,74 @@ extern "C"
 * STRUCTURES
 *******************************************************************************/
 
+/*===============================================================*/
+/** RPC_OMX_PACKET_POOL             : Fixed size pool of RPC packets
+ *
+ *  @ param pPackets                : RPC_PACKET_POOL_SIZE contiguous packets
+ *                                    of RPC_PACKET_SIZE bytes each.
+ *  @ param nNext                   : Free list link for each packet.
+ *  @ param nHead                   : Free list head. Bits [15:0] hold the index
+ *                                    of the first free packet, bits [31:16]
+ *                                    hold a tag bumped on every update so that
+ *                                    the lock-free pop is safe against ABA.
+ */
+/*===============================================================*/
+	typedef struct RPC_OMX_PACKET_POOL
+	{
+		OMX_U8 *pPackets;
+		volatile OMX_U16 nNext[RPC_PACKET_POOL_SIZE];
+		volatile OMX_U32 nHead;
+	} RPC_OMX_PACKET_POOL;
+
+/*===============================================================*/
+/** RPC_OMX_REGCACHE_ENTRY          : A buffer registration with the remote
+ *                                    core that can be handed out again
+ *
+ *  @ param pHandles                : Handles returned by the registration,
+ *                                    pHandles[0] is NULL for a free entry.
+ *                                    The entry owns one driver reference on
+ *                                    them, which keeps the buffer alive.
+ *  @ param nType                   : PROXY_BUFFER_TYPE of the registration.
+ *  @ param nRefCount               : Outstanding RPC_RegisterBuffer calls.
+ *  @ param nLastUse                : Age of the entry, the least recently used
+ *                                    unreferenced entry is evicted first.
+ *  @ param nMapId                  : Id the remote side knows the mapping of
+ *                                    the buffer by in map-once mode.
+ *  @ param bRemoteMapped           : The remote side was sent the buffer with
+ *                                    nMapId and keeps its mapping.
+ */
+/*===============================================================*/
+	typedef struct RPC_OMX_REGCACHE_ENTRY
+	{
+		OMX_PTR pHandles[2];
+		OMX_U32 nType;
+		OMX_U32 nRefCount;
+		OMX_U32 nLastUse;
+		OMX_U32 nMapId;
+		OMX_BOOL bRemoteMapped;
+	} RPC_OMX_REGCACHE_ENTRY;
+
+/*===============================================================*/
+/** RPC_OMX_REGCACHE                : Buffer registrations of a context
+ *
+ *  @ param tLock                   : Protects the entries.
+ *  @ param bDisabled               : Set when the cache is turned off or the
+ *                                    kernel cannot compare files.
+ *  @ param nUseCount               : Source of nLastUse.
+ *  @ param nMapGen                 : Registrations added so far, part of
+ *                                    nMapId.
+ *  @ param tEntries                : The registrations.
+ */
+/*===============================================================*/
+	typedef struct RPC_OMX_REGCACHE
+	{
+		pthread_mutex_t tLock;
+		OMX_BOOL bDisabled;
+		OMX_U32 nUseCount;
+		OMX_U32 nMapGen;
+		RPC_OMX_REGCACHE_ENTRY tEntries[RPC_REGCACHE_SIZE];
+	} RPC_OMX_REGCACHE;
+
 /*===============================================================*/
 /** RPC_OMX_CONTEXT                 : RPC context structure
  *
@@ -169,6 +285,35 @@ extern "C"
  *                                    remote core.
  *  @ param hActualRemoteCompHandle : Actual component handle on remote core.
  *  @ param pAppData                : App data of RPC caller
+ *  @ param tPacketPool             : Packets shared by the stubs and the
+ *                                    callback thread of this instance.
+ *  @ param bSharedListener         : Messages of this instance are read by
+ *                                    the process wide listener instead of
+ *                                    cbThread.
+ *  @ param tRegCache               : Buffer registrations reused by
+ *                                    RPC_RegisterBuffer.
+ *  @ param bRemoteDead             : Set once the remote core is gone, stubs
+ *                                    fail at once instead of sending.
+ *  @ param aErrorPacket            : Reply handed to waiting stubs when the
+ *                                    remote core is gone, only its result is
+ *                                    read.
+ *  @ param nPoolId                 : Pool/job id put in the flags of every
+ *                                    packet, see RPC_SetPriority.
+ *  @ param nPipeDepth              : Depth pMsgPipe[i] was created with.
+ *  @ param nPipeHighWater          : Most replies ever queued on pMsgPipe[i].
+ *  @ param nReplyTimeout           : ms a sync call waits for its reply,
+ *                                    TIMM_OSAL_SUSPEND for no limit.
+ *  @ param bMapOnce                : The remote component keeps the mapping
+ *                                    of cached registrations, ETBs of mapped
+ *                                    buffers only carry the map id after the
+ *                                    first one. Set by the proxy.
+ *  @ param tScratchLock            : Held while pStructScratch carries a
+ *                                    structure, up to the reply.
+ *  @ param pStructScratch          : Mapping of the buffer the remote
+ *                                    instance was handed with
+ *                                    OMX_TI_IndexParamStructScratch, NULL if
+ *                                    it has none. Set by the proxy.
+ *  @ param nStructScratchSize      : Size of pStructScratch.
  *
  */
 /*===============================================================*/
@@ -181,8 +326,40 @@ extern "C"
 		OMX_HANDLETYPE hRemoteHandle;
 		OMX_HANDLETYPE hActualRemoteCompHandle;
 		OMX_PTR pAppData;
+		RPC_OMX_PACKET_POOL tPacketPool;
+		OMX_BOOL bSharedListener;
+		RPC_OMX_REGCACHE tRegCache;
+		OMX_U32 nRecordId;	/* Non zero while packets are recorded */
+		volatile OMX_U32 bRemoteDead;
+		OMX_U32 aErrorPacket[RPC_ERROR_PACKET_WORDS];
+		volatile OMX_U32 nPoolId;
+		OMX_U32 nPipeDepth[RPC_OMX_MAX_FUNCTION_LIST];
+		volatile OMX_U32 nPipeHighWater[RPC_OMX_MAX_FUNCTION_LIST];
+		OMX_S32 nReplyTimeout;
+		OMX_BOOL bMapOnce;
+		pthread_mutex_t tScratchLock;
+		OMX_U8 *pStructScratch;
+		OMX_U32 nStructScratchSize;
 	} RPC_OMX_CONTEXT;
 
+/*******************************************************************************
+* Functions
+*******************************************************************************/
+	OMX_PTR RPC_AllocPacket(RPC_OMX_CONTEXT * pRPCCtx);
+	void RPC_ReleasePacket(RPC_OMX_CONTEXT * pRPCCtx, OMX_PTR pPacket);
+	void RPC_RegCacheAdd(RPC_OMX_CONTEXT * pRPCCtx, OMX_U32 nType,
+	    OMX_PTR handle1, OMX_PTR handle2);
+	OMX_BOOL RPC_RegCacheRelease(RPC_OMX_CONTEXT * pRPCCtx,
+	    OMX_PTR handle1);
+	void RPC_ReplyTimeout(RPC_OMX_CONTEXT * pRPCCtx, OMX_U32 nFxnIdx);
+	OMX_U32 RPC_RegCacheMapId(RPC_OMX_CONTEXT * pRPCCtx, OMX_PTR handle1,
+	    OMX_BOOL * bRemoteMapped);
+	void RPC_RecordOpen(RPC_OMX_CONTEXT * pRPCCtx,
+	    OMX_STRING cComponentName);
+	void RPC_RecordClose(RPC_OMX_CONTEXT * pRPCCtx);
+	void RPC_RecordPacket(RPC_OMX_CONTEXT * pRPCCtx, OMX_U32 nType,
+	    OMX_PTR pPacket, OMX_U32 nSize);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ *  @file  omx_rpc_record.h
+ *         Layout of the RPC trace files written by the DOMX RPC recorder
+ *         and read back by the rpc_replay test tool.
+ *
+ *  @path \WTSD_DucatiMMSW\framework\domx\omx_rpc\inc
+ *
+ *  @rev 1.0
+ */
+
+#ifndef OMXRPC_RECORD_H
+#define OMXRPC_RECORD_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif				/* __cplusplus */
+
+#include <OMX_Types.h>
+
+/*
+ * A trace is one RPC_RECORD_FILE_HEADER followed by RPC_RECORD_ENTRY
+ * records, each one directly followed by nSize bytes of payload. Traces are
+ * written in the byte order of the host that recorded them.
+ *
+ * Recording is enabled by setting DEBUG_DOMX_RPC_RECORD in the environment
+ * or the debug.domx.rpc_record property to a file name; the pid of the
+ * process is appended to it.
+ */
+#define RPC_RECORD_MAGIC   (0x52435044)	/* "DPCR" */
+#define RPC_RECORD_VERSION (1)
+
+/** RPC_RECORD_TYPE : What an entry of the trace describes */
+	typedef enum RPC_RECORD_TYPE
+	{
+		/* An RPC context was created, payload is the component name */
+		RPC_RECORD_OPEN = 0,
+		/* The RPC context was destroyed, no payload */
+		RPC_RECORD_CLOSE = 1,
+		/* Packet written to the remote core, payload is the packet */
+		RPC_RECORD_SEND = 2,
+		/* Packet read from the remote core, payload is the packet */
+		RPC_RECORD_RECV = 3
+	} RPC_RECORD_TYPE;
+
+/** RPC_RECORD_FILE_HEADER : Start of every trace file */
+	typedef struct RPC_RECORD_FILE_HEADER
+	{
+		OMX_U32 nMagic;
+		OMX_U32 nVersion;
+		OMX_U32 nPacketSize;	/* RPC_PACKET_SIZE of the recorder */
+		OMX_U32 nPid;
+	} RPC_RECORD_FILE_HEADER;
+
+/** RPC_RECORD_ENTRY : Header of one trace record */
+	typedef struct RPC_RECORD_ENTRY
+	{
+		OMX_U64 nTimeNs;	/* CLOCK_MONOTONIC */
+		OMX_U32 nContext;	/* Per process id of the RPC context */
+		OMX_U16 nType;	/* RPC_RECORD_TYPE */
+		OMX_U16 nReserved;
+		OMX_U32 nFxnIdx;	/* RPC_OMX_FXN_IDX_TYPE, packets only */
+		OMX_U32 nSize;	/* Bytes of payload that follow */
+	} RPC_RECORD_ENTRY;
+
+#ifdef __cplusplus
+}
+#endif
+#endif
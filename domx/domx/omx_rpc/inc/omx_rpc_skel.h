@@ -67,6 +67,7 @@ extern "C"
 	RPC_OMX_ERRORTYPE RPC_SKEL_EmptyBufferDone(void *data);
 	RPC_OMX_ERRORTYPE RPC_SKEL_FillBufferDone(void *data);
 	RPC_OMX_ERRORTYPE RPC_SKEL_EventHandler(void *data);
+	RPC_OMX_ERRORTYPE RPC_SKEL_FlushDone(void *data, OMX_U32 nDataSize);
 
 /*Empty SKEL*/
 	RPC_OMX_ERRORTYPE RPC_SKEL_GetHandle(uint32_t size, uint32_t * data);
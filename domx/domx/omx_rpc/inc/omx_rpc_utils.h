@@ -71,6 +71,9 @@ extern "C"
 #define DOMX_DEBUG(fmt,...)  TIMM_OSAL_Debug(fmt, ##__VA_ARGS__)
 #define DOMX_ENTER(fmt,...)  TIMM_OSAL_Entering(fmt, ##__VA_ARGS__)
 #define DOMX_EXIT(fmt,...)   TIMM_OSAL_Exiting(fmt, ##__VA_ARGS__)
+/* systrace slice named after the calling function, arg shows up in hex */
+#define DOMX_TRACE_BEGIN(arg) TIMM_OSAL_TraceMarkerBegin(__FUNCTION__, (arg))
+#define DOMX_TRACE_END()      TIMM_OSAL_TraceMarkerEnd()
 
 
 /******************************************************************
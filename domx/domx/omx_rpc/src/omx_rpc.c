@@ -51,10 +51,24 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <time.h>
+#include <sched.h>
 #include <unistd.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#ifdef _Android
+#include <cutils/properties.h>
+#endif
+#ifdef USE_ION
+#include <ion_ti/ion.h>
+#include <linux/rpmsg_omx.h>
+#endif
+
 #include <OMX_Types.h>
 #include <timm_osal_interfaces.h>
 #include <timm_osal_trace.h>
@@ -70,23 +84,95 @@
 
 #include "rpmsg_omx_defs.h"
 
-#define RPC_MSGPIPE_SIZE (4)
+/* Number of replies each mailbox can queue before the listener blocks */
+#define RPC_MSGPIPE_SIZE (8)
+/* Buffer functions can have one reply per buffer of a port outstanding,
+   their mailboxes hold as many as the largest port ever allocates */
+#define RPC_MSGPIPE_BUFFER_SIZE (32)
 #define RPC_MSG_SIZE_FOR_PIPE (sizeof(OMX_PTR))
-#define MAX_ATTEMPTS 15
+/* How long (ms) RPC_InstanceInit waits for the rpmsg device to appear */
+#define RPC_DEVICE_WAIT_MS (15000)
+/* How long (ms) a stub waits for the reply to a sync call by default, no
+   remote call takes anywhere near as long unless the remote core is stuck */
+#define RPC_REPLY_TIMEOUT_MS (10000)
+#define RPC_DEVICE_DIR "/dev"
+#define RPC_DEVICE_NAME "rpmsg-omx1"
 
-#define RPC_getPacket(nPacketSize, pPacket) do { \
-    pPacket = TIMM_OSAL_Malloc(nPacketSize, TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT); \
+#define RPC_getPacket(hCtx, nPacketSize, pPacket) do { \
+    pPacket = RPC_AllocPacket(hCtx); \
     RPC_assert(pPacket != NULL, RPC_OMX_ErrorInsufficientResources, \
            "Error Allocating RCM Message Frame"); \
     } while(0)
 
-#define RPC_freePacket(pPacket) do { \
-    if(pPacket != NULL) TIMM_OSAL_Free(pPacket); \
+#define RPC_freePacket(hCtx, pPacket) do { \
+    if(pPacket != NULL) RPC_ReleasePacket(hCtx, pPacket); \
     } while(0)
 
-OMX_U8 pBufferError[RPC_PACKET_SIZE];
+#define RPC_PACKET_POOL_NEXT_HEAD(nHead, nIndex) \
+    ((((nHead) + 0x10000) & 0xFFFF0000) | (nIndex))
+
+/*Max events handled by the shared listener per wakeup*/
+#define RPC_SHARED_LISTENER_MAX_EVENTS 16
+
+/*Max messages read from one context per listener wakeup*/
+#define RPC_CALLBACK_MAX_BATCH 8
+
+/*Messages of the buffer-done lane, dispatched ahead of the replies read
+  before them, see RPC_ProcessMessage*/
+#define RPC_IS_BUFFER_DONE(nFxnIdx) \
+    ((nFxnIdx) == RPC_OMX_FXN_IDX_EMPTYBUFFERDONE || \
+     (nFxnIdx) == RPC_OMX_FXN_IDX_FILLBUFFERDONE || \
+     (nFxnIdx) == RPC_OMX_FXN_IDX_FLUSH_DONE)
+
+/*Process wide listener, used instead of one RPC_CallbackThread per instance
+  when debug.domx.shared_listener is set. tLock serializes register and
+  unregister, tDispatchLock is held while a batch of messages is processed
+  so that an unregistered context is never touched afterwards. Where both
+  are taken tDispatchLock comes first, callbacks run with it held and may
+  unregister. nGeneration is bumped on every unregister to drop events
+  fetched before it. bRunning stays set while the thread is up, which it
+  also is with no users left when the last one went away from a callback
+  on the listener thread itself.*/
+typedef struct RPC_SHARED_LISTENER
+{
+	pthread_mutex_t tLock;
+	pthread_mutex_t tDispatchLock;
+	pthread_t tThread;
+	OMX_BOOL bRunning;
+	OMX_S32 fd_epoll;
+	OMX_S32 fd_kill;
+	OMX_U32 nUsers;
+	volatile OMX_U32 nGeneration;
+} RPC_SHARED_LISTENER;
+
+static RPC_SHARED_LISTENER gSharedListener = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, 0, OMX_FALSE,
+	-1, -1, 0, 0
+};
 
 void *RPC_CallbackThread(void *data);
+static RPC_OMX_ERRORTYPE RPC_SharedListenerRegister(RPC_OMX_CONTEXT *
+    pRPCCtx);
+static RPC_OMX_ERRORTYPE RPC_SharedListenerUnregister(RPC_OMX_CONTEXT *
+    pRPCCtx);
+static void RPC_SetListenerParams(const char *pName);
+static OMX_S32 RPC_GetConfigValue(const char *pEnv, const char *pProperty,
+    OMX_S32 nDefault);
+static OMX_S32 RPC_OpenDevice(OMX_U32 nTimeoutMs);
+static void RPC_RegCacheFlush(RPC_OMX_CONTEXT * pRPCCtx);
+static RPC_OMX_PRIORITY RPC_GetDefaultPriority(OMX_STRING cComponentName);
+static OMX_U32 RPC_GetPipeDepth(OMX_U32 nFxnIdx, OMX_U32 nBufferDepth);
+
+/*Default priority class of the components that need one*/
+static const struct
+{
+	const char *cName;
+	RPC_OMX_PRIORITY ePriority;
+} gRpcPriorityTable[] = {
+	{ "OMX.TI.DUCATI1.VIDEO.CAMERA", RPC_OMX_PRIORITY_HIGH },
+	{ "OMX.TI.DUCATI1.VIDEO.H264SVCE", RPC_OMX_PRIORITY_HIGH },
+	{ "OMX.TI.DUCATI1.MISC.SAMPLE", RPC_OMX_PRIORITY_LOW },
+};
 
 
 /* ===========================================================================*/
@@ -108,7 +194,8 @@ RPC_OMX_ERRORTYPE RPC_InstanceInit(OMX_STRING cComponentName,
 	OMX_S32 status = 0;
 	struct omx_conn_req sReq = { .name = "OMX" };
 	TIMM_OSAL_ERRORTYPE eError = TIMM_OSAL_ERR_NONE;
-	OMX_U32 i = 0, nAttempts = 0;
+	OMX_U32 i = 0;
+	OMX_U32 nBufferDepth = 0;
 
 	*(RPC_OMX_CONTEXT **) phRPCCtx = NULL;
 
@@ -124,21 +211,41 @@ RPC_OMX_ERRORTYPE RPC_InstanceInit(OMX_STRING cComponentName,
 	    "Malloc failed");
 	TIMM_OSAL_Memset(pRPCCtx, 0, sizeof(RPC_OMX_CONTEXT));
 
-	/*Assuming that open maintains an internal count for multi instance */
-	DOMX_DEBUG("Calling open on the device");
-	while (1)
+	/*Packets used for all messages of this instance come from this pool */
+	pRPCCtx->tPacketPool.pPackets =
+	    (OMX_U8 *) TIMM_OSAL_Malloc(RPC_PACKET_POOL_SIZE * RPC_PACKET_SIZE,
+	    TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT);
+	RPC_assert(pRPCCtx->tPacketPool.pPackets != NULL,
+	    RPC_OMX_ErrorInsufficientResources, "Packet pool malloc failed");
+	for (i = 0; i < RPC_PACKET_POOL_SIZE; i++)
 	{
-		pRPCCtx->fd_omx = open("/dev/rpmsg-omx1", O_RDWR);
-		if(pRPCCtx->fd_omx >= 0 || errno != ENOENT || nAttempts == MAX_ATTEMPTS)
-			break;
-		DOMX_DEBUG("errno from open= %d, REATTEMPTING OPEN!!!!",errno);
-		nAttempts++;
-		usleep(1000000);
+		pRPCCtx->tPacketPool.nNext[i] = (i + 1 < RPC_PACKET_POOL_SIZE) ?
+		    (OMX_U16) (i + 1) : RPC_PACKET_POOL_EMPTY;
 	}
+	pRPCCtx->tPacketPool.nHead = 0;
+
+	pthread_mutex_init(&pRPCCtx->tRegCache.tLock, NULL);
+	pthread_mutex_init(&pRPCCtx->tScratchLock, NULL);
+	pRPCCtx->tRegCache.bDisabled =
+	    (RPC_GetConfigValue("DEBUG_DOMX_REGCACHE", "debug.domx.regcache",
+		1) == 0) ? OMX_TRUE : OMX_FALSE;
+
+	/*debug.domx.rpc_timeout 0 waits for replies forever */
+	pRPCCtx->nReplyTimeout = RPC_GetConfigValue("DEBUG_DOMX_RPC_TIMEOUT",
+	    "debug.domx.rpc_timeout", RPC_REPLY_TIMEOUT_MS);
+	if (pRPCCtx->nReplyTimeout <= 0)
+		pRPCCtx->nReplyTimeout = (OMX_S32) TIMM_OSAL_SUSPEND;
+
+	pRPCCtx->nPoolId = OMX_POOLID_JOBID_DEFAULT;
+	RPC_SetPriority(pRPCCtx, RPC_GetDefaultPriority(cComponentName));
+
+	/*Assuming that open maintains an internal count for multi instance */
+	DOMX_DEBUG("Calling open on the device");
+	pRPCCtx->fd_omx = RPC_OpenDevice(RPC_DEVICE_WAIT_MS);
 	if(pRPCCtx->fd_omx < 0)
 	{
 		DOMX_ERROR("Can't open device, errorno from open = %d",errno);
-		eError = RPC_OMX_ErrorInsufficientResources;
+		eRPCError = RPC_OMX_ErrorInsufficientResources;
 		goto EXIT;
 	}
 	DOMX_DEBUG("Open was successful, pRPCCtx->fd_omx = %d",
@@ -150,17 +257,32 @@ RPC_OMX_ERRORTYPE RPC_InstanceInit(OMX_STRING cComponentName,
 	status = ioctl(pRPCCtx->fd_omx, OMX_IOCCONNECT, &sReq);
 	RPC_assert(status >= 0, RPC_OMX_ErrorInsufficientResources,
 	    "Can't connect");
+	RPC_RecordOpen(pRPCCtx, cComponentName);
 
+	nBufferDepth = RPC_GetConfigValue("DEBUG_DOMX_RPC_BUFFER_PIPE",
+	    "debug.domx.rpc_buffer_pipe", RPC_MSGPIPE_BUFFER_SIZE);
 	for (i = 0; i < RPC_OMX_MAX_FUNCTION_LIST; i++)
 	{
+		pRPCCtx->nPipeDepth[i] = RPC_GetPipeDepth(i, nBufferDepth);
 		eError =
-		    TIMM_OSAL_CreatePipe(&(pRPCCtx->pMsgPipe[i]),
-		    RPC_MSGPIPE_SIZE, RPC_MSG_SIZE_FOR_PIPE, 1);
+		    TIMM_OSAL_CreatePipeEx(&(pRPCCtx->pMsgPipe[i]),
+		    pRPCCtx->nPipeDepth[i], RPC_MSG_SIZE_FOR_PIPE, 1,
+		    TIMM_OSAL_PIPE_BACKEND_MAILBOX);
 		RPC_assert(eError == TIMM_OSAL_ERR_NONE,
 		    RPC_OMX_ErrorInsufficientResources,
 		    "Pipe creation failed");
 	}
 
+	if (RPC_GetConfigValue("DEBUG_DOMX_SHARED_LISTENER",
+		"debug.domx.shared_listener", 0) != 0)
+	{
+		/*One thread listens to all instances of this process. Clients
+		  must not block a callback on a sync call into another instance
+		  since that reply is read by the same thread*/
+		eRPCError = RPC_SharedListenerRegister(pRPCCtx);
+		goto EXIT;
+	}
+
 	DOMX_DEBUG("Creating event fd");
 	pRPCCtx->fd_killcb = eventfd(0, 0);
 	RPC_assert(pRPCCtx->fd_killcb >= 0,
@@ -208,6 +330,11 @@ RPC_OMX_ERRORTYPE RPC_InstanceDeInit(OMX_HANDLETYPE hRPCCtx)
 	RPC_assert(hRPCCtx != NULL, RPC_OMX_ErrorUndefined,
 	    "NULL context handle supplied to RPC Deinit");
 
+	if (pRPCCtx->bSharedListener)
+	{
+		eRPCError = RPC_SharedListenerUnregister(pRPCCtx);
+	}
+
 	if (pRPCCtx->fd_killcb)
 	{
 		status =
@@ -251,6 +378,10 @@ RPC_OMX_ERRORTYPE RPC_InstanceDeInit(OMX_HANDLETYPE hRPCCtx)
 		}
 	}
 
+	RPC_RegCacheFlush(pRPCCtx);
+	pthread_mutex_destroy(&pRPCCtx->tScratchLock);
+	RPC_RecordClose(pRPCCtx);
+
 	DOMX_DEBUG("Closing the omx fd");
 	if (pRPCCtx->fd_omx)
 	{
@@ -263,6 +394,12 @@ RPC_OMX_ERRORTYPE RPC_InstanceDeInit(OMX_HANDLETYPE hRPCCtx)
 		}
 	}
 
+	if (pRPCCtx->tPacketPool.pPackets)
+	{
+		TIMM_OSAL_Free(pRPCCtx->tPacketPool.pPackets);
+		pRPCCtx->tPacketPool.pPackets = NULL;
+	}
+
 	TIMM_OSAL_Free(pRPCCtx);
 
 	EXIT:
@@ -271,6 +408,903 @@ RPC_OMX_ERRORTYPE RPC_InstanceDeInit(OMX_HANDLETYPE hRPCCtx)
 
 
 
+/* ===========================================================================*/
+/**
+* @name RPC_AllocPacket()
+* @brief Takes a packet of RPC_PACKET_SIZE bytes from the packet pool of the
+*        context. This is lock free since both the stubs (any client thread)
+*        and the callback thread allocate packets. When the pool is exhausted
+*        the packet is allocated from the heap instead.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @return Pointer to the packet, NULL if allocation failed
+*/
+/* ===========================================================================*/
+OMX_PTR RPC_AllocPacket(RPC_OMX_CONTEXT * pRPCCtx)
+{
+	RPC_OMX_PACKET_POOL *pPool = &(pRPCCtx->tPacketPool);
+	OMX_U32 nHead = 0, nIndex = 0;
+
+	do
+	{
+		nHead = pPool->nHead;
+		nIndex = nHead & 0xFFFF;
+		if (nIndex == RPC_PACKET_POOL_EMPTY)
+		{
+			DOMX_DEBUG("Packet pool exhausted - allocating from heap");
+			return TIMM_OSAL_Malloc(RPC_PACKET_SIZE, TIMM_OSAL_TRUE, 0,
+			    TIMMOSAL_MEM_SEGMENT_INT);
+		}
+	} while (!__sync_bool_compare_and_swap(&(pPool->nHead), nHead,
+		RPC_PACKET_POOL_NEXT_HEAD(nHead, pPool->nNext[nIndex])));
+
+	return pPool->pPackets + (nIndex * RPC_PACKET_SIZE);
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_ReleasePacket()
+* @brief Returns a packet obtained through RPC_AllocPacket().
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param pPacket [IN] : Packet to be released.
+* @return none
+*/
+/* ===========================================================================*/
+void RPC_ReleasePacket(RPC_OMX_CONTEXT * pRPCCtx, OMX_PTR pPacket)
+{
+	RPC_OMX_PACKET_POOL *pPool = &(pRPCCtx->tPacketPool);
+	OMX_U8 *pFirst = pPool->pPackets;
+	OMX_U32 nHead = 0, nIndex = 0;
+
+	if ((OMX_U8 *) pPacket < pFirst ||
+	    (OMX_U8 *) pPacket >= pFirst + (RPC_PACKET_POOL_SIZE * RPC_PACKET_SIZE))
+	{
+		/*Not from the pool */
+		TIMM_OSAL_Free(pPacket);
+		return;
+	}
+
+	nIndex = ((OMX_U8 *) pPacket - pFirst) / RPC_PACKET_SIZE;
+	do
+	{
+		nHead = pPool->nHead;
+		pPool->nNext[nIndex] = (OMX_U16) (nHead & 0xFFFF);
+	} while (!__sync_bool_compare_and_swap(&(pPool->nHead), nHead,
+		RPC_PACKET_POOL_NEXT_HEAD(nHead, nIndex)));
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RegCacheUnregister()
+* @brief Unregisters handles returned by a buffer registration.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param pHandles [IN] : The two handles, either may be NULL.
+* @return none
+*/
+/* ===========================================================================*/
+static void RPC_RegCacheUnregister(RPC_OMX_CONTEXT * pRPCCtx,
+    OMX_PTR pHandles[2])
+{
+#ifdef USE_ION
+	struct ion_fd_data data;
+	OMX_U32 i = 0;
+
+	for (i = 0; i < 2; i++)
+	{
+		if (pHandles[i] == NULL)
+			continue;
+		data.handle = pHandles[i];
+		if (ioctl(pRPCCtx->fd_omx, OMX_IOCIONUNREGISTER, &data) < 0)
+		{
+			DOMX_ERROR("UnregisterBuffer ioctl call failed for handle: 0x%x",
+			    pHandles[i]);
+		}
+	}
+#endif
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RegCacheEvict()
+* @brief Unregisters the buffer of an entry and frees the entry. Called with
+*        the cache lock held.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param pEntry [IN] : Entry to evict.
+* @return none
+*/
+/* ===========================================================================*/
+static void RPC_RegCacheEvict(RPC_OMX_CONTEXT * pRPCCtx,
+    RPC_OMX_REGCACHE_ENTRY * pEntry)
+{
+	RPC_RegCacheUnregister(pRPCCtx, pEntry->pHandles);
+	TIMM_OSAL_Memset(pEntry, 0, sizeof(RPC_OMX_REGCACHE_ENTRY));
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RegCacheAdd()
+* @brief Called with the handles of every new registration. The driver
+*        imports a buffer once per omx fd, registering the same buffer
+*        again returns the same handles with one more reference on them. On
+*        a hit the cached entry is referenced once more and the extra driver
+*        reference is dropped again, so that the entry holds exactly one.
+*        Otherwise the registration is stored with one reference, evicting
+*        the least recently used unreferenced entry when the cache is full.
+*        If all of them are in use the new one is simply not cached.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param nType [IN] : PROXY_BUFFER_TYPE of the registration.
+* @param handle1 [IN] : First registered handle.
+* @param handle2 [IN] : Second registered handle, may be NULL.
+* @return none
+*/
+/* ===========================================================================*/
+void RPC_RegCacheAdd(RPC_OMX_CONTEXT * pRPCCtx, OMX_U32 nType,
+    OMX_PTR handle1, OMX_PTR handle2)
+{
+	RPC_OMX_REGCACHE *pCache = &(pRPCCtx->tRegCache);
+	RPC_OMX_REGCACHE_ENTRY *pEntry = NULL, *pVictim = NULL;
+	OMX_PTR pHandles[2];
+	OMX_U32 i = 0;
+
+	if (pCache->bDisabled || handle1 == NULL)
+		return;
+
+	pthread_mutex_lock(&pCache->tLock);
+	for (i = 0; i < RPC_REGCACHE_SIZE; i++)
+	{
+		pEntry = &(pCache->tEntries[i]);
+		if (pEntry->pHandles[0] == handle1 &&
+		    pEntry->pHandles[1] == handle2 && pEntry->nType == nType)
+		{
+			pEntry->nRefCount++;
+			pEntry->nLastUse = ++pCache->nUseCount;
+			pHandles[0] = handle1;
+			pHandles[1] = handle2;
+			RPC_RegCacheUnregister(pRPCCtx, pHandles);
+			goto EXIT;
+		}
+	}
+	for (i = 0; i < RPC_REGCACHE_SIZE; i++)
+	{
+		pEntry = &(pCache->tEntries[i]);
+		if (pEntry->pHandles[0] == NULL)
+		{
+			pVictim = pEntry;
+			break;
+		}
+		if (pEntry->nRefCount == 0 && (pVictim == NULL ||
+			pEntry->nLastUse < pVictim->nLastUse))
+			pVictim = pEntry;
+	}
+	if (pVictim == NULL)
+		goto EXIT;
+	if (pVictim->pHandles[0] != NULL)
+		RPC_RegCacheEvict(pRPCCtx, pVictim);
+
+	pVictim->pHandles[0] = handle1;
+	pVictim->pHandles[1] = handle2;
+	pVictim->nType = nType;
+	pVictim->nRefCount = 1;
+	pVictim->nLastUse = ++pCache->nUseCount;
+	pVictim->nMapId = RPC_REGCACHE_MAPID(pVictim - pCache->tEntries,
+	    ++pCache->nMapGen);
+	pVictim->bRemoteMapped = OMX_FALSE;
+
+      EXIT:
+	pthread_mutex_unlock(&pCache->tLock);
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RegCacheRelease()
+* @brief Drops a reference on a cached registration. The registration itself
+*        is kept for the next RPC_RegisterBuffer of the same buffer. As a
+*        kept registration also keeps its buffer allocated, no more than
+*        RPC_REGCACHE_IDLE_MAX unreferenced ones are kept, the least
+*        recently used go first.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param handle1 [IN] : First handle returned by the registration.
+* @return OMX_TRUE if the handle belongs to the cache, OMX_FALSE if the caller
+*         has to unregister it
+*/
+/* ===========================================================================*/
+OMX_BOOL RPC_RegCacheRelease(RPC_OMX_CONTEXT * pRPCCtx, OMX_PTR handle1)
+{
+	RPC_OMX_REGCACHE *pCache = &(pRPCCtx->tRegCache);
+	RPC_OMX_REGCACHE_ENTRY *pEntry = NULL, *pOldest = NULL;
+	OMX_BOOL bFound = OMX_FALSE;
+	OMX_U32 i = 0, nIdle = 0;
+
+	pthread_mutex_lock(&pCache->tLock);
+	for (i = 0; i < RPC_REGCACHE_SIZE; i++)
+	{
+		pEntry = &(pCache->tEntries[i]);
+		if (pEntry->pHandles[0] == handle1)
+		{
+			if (pEntry->nRefCount > 0)
+				pEntry->nRefCount--;
+			bFound = OMX_TRUE;
+			break;
+		}
+	}
+	while (bFound)
+	{
+		pOldest = NULL;
+		nIdle = 0;
+		for (i = 0; i < RPC_REGCACHE_SIZE; i++)
+		{
+			pEntry = &(pCache->tEntries[i]);
+			if (pEntry->pHandles[0] == NULL || pEntry->nRefCount != 0)
+				continue;
+			nIdle++;
+			if (pOldest == NULL || pEntry->nLastUse < pOldest->nLastUse)
+				pOldest = pEntry;
+		}
+		if (nIdle <= RPC_REGCACHE_IDLE_MAX)
+			break;
+		RPC_RegCacheEvict(pRPCCtx, pOldest);
+	}
+	pthread_mutex_unlock(&pCache->tLock);
+
+	return bFound;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RegCacheMapId()
+* @brief Returns the map id of a cached registration for a map-once ETB and
+*        tells whether the remote side already has the buffer mapped. The
+*        registration counts as mapped from here on, the packet is sent right
+*        after and only fails to arrive when the remote core is gone. A slot
+*        that gets a new registration gets a new id, the remote side drops the
+*        old mapping of the slot when it first sees it.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param handle1 [IN] : First handle returned by the registration.
+* @param bRemoteMapped [OUT] : OMX_TRUE if the buffer needs no mapping.
+* @return The map id, 0 if the handle is not cached
+*/
+/* ===========================================================================*/
+OMX_U32 RPC_RegCacheMapId(RPC_OMX_CONTEXT * pRPCCtx, OMX_PTR handle1,
+    OMX_BOOL * bRemoteMapped)
+{
+	RPC_OMX_REGCACHE *pCache = &(pRPCCtx->tRegCache);
+	RPC_OMX_REGCACHE_ENTRY *pEntry = NULL;
+	OMX_U32 nMapId = 0, i = 0;
+
+	*bRemoteMapped = OMX_FALSE;
+	if (pCache->bDisabled || handle1 == NULL)
+		return 0;
+
+	pthread_mutex_lock(&pCache->tLock);
+	for (i = 0; i < RPC_REGCACHE_SIZE; i++)
+	{
+		pEntry = &(pCache->tEntries[i]);
+		if (pEntry->pHandles[0] == handle1)
+		{
+			nMapId = pEntry->nMapId;
+			*bRemoteMapped = pEntry->bRemoteMapped;
+			pEntry->bRemoteMapped = OMX_TRUE;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pCache->tLock);
+
+	return nMapId;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RegCacheFlush()
+* @brief Unregisters everything still cached. Called before the omx fd is
+*        closed.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @return none
+*/
+/* ===========================================================================*/
+static void RPC_RegCacheFlush(RPC_OMX_CONTEXT * pRPCCtx)
+{
+	RPC_OMX_REGCACHE *pCache = &(pRPCCtx->tRegCache);
+	OMX_U32 i = 0;
+
+	pthread_mutex_lock(&pCache->tLock);
+	for (i = 0; i < RPC_REGCACHE_SIZE; i++)
+	{
+		if (pCache->tEntries[i].pHandles[0] != NULL)
+			RPC_RegCacheEvict(pRPCCtx, &(pCache->tEntries[i]));
+	}
+	pthread_mutex_unlock(&pCache->tLock);
+	pthread_mutex_destroy(&pCache->tLock);
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_GetConfigValue()
+* @brief Reads an integer tunable, from the environment first and then from
+*        the Android property of the same name.
+* @param pEnv [IN] : Environment variable name.
+* @param pProperty [IN] : Android property name.
+* @param nDefault [IN] : Value used when neither is set.
+* @return Value of the tunable
+*/
+/* ===========================================================================*/
+static OMX_S32 RPC_GetConfigValue(const char *pEnv, const char *pProperty,
+    OMX_S32 nDefault)
+{
+	char *val = getenv(pEnv);
+
+	if (val)
+	{
+		return strtol(val, NULL, 0);
+	}
+#ifdef _Android
+	{
+		char value[PROPERTY_VALUE_MAX];
+
+		if (property_get(pProperty, value, NULL) > 0)
+			return strtol(value, NULL, 0);
+	}
+#endif
+	return nDefault;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_GetDefaultPriority()
+* @brief Priority class of a component as given by gRpcPriorityTable.
+*        DEBUG_DOMX_RPC_PRIORITY / debug.domx.rpc_priority (0 default, 1 high,
+*        2 low) overrides it for every component that is not in the table.
+* @param cComponentName [IN] : Name of the component.
+* @return Priority class
+*/
+/* ===========================================================================*/
+static RPC_OMX_PRIORITY RPC_GetDefaultPriority(OMX_STRING cComponentName)
+{
+	OMX_U32 i;
+
+	for (i = 0; i < sizeof(gRpcPriorityTable) / sizeof(gRpcPriorityTable[0]);
+	    i++)
+	{
+		if (strcmp(cComponentName, gRpcPriorityTable[i].cName) == 0)
+		{
+			return gRpcPriorityTable[i].ePriority;
+		}
+	}
+	return (RPC_OMX_PRIORITY) RPC_GetConfigValue("DEBUG_DOMX_RPC_PRIORITY",
+	    "debug.domx.rpc_priority", RPC_OMX_PRIORITY_DEFAULT);
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_GetPipeDepth()
+* @brief Depth of the reply mailbox of a function. Control calls are made by
+*        one client thread at a time, buffer calls can have a reply per
+*        buffer outstanding.
+* @param nFxnIdx [IN] : RPC_OMX_FXN_IDX_TYPE of the mailbox.
+* @param nBufferDepth [IN] : Depth used for the buffer functions.
+* @return Number of replies the mailbox holds
+*/
+/* ===========================================================================*/
+static OMX_U32 RPC_GetPipeDepth(OMX_U32 nFxnIdx, OMX_U32 nBufferDepth)
+{
+	OMX_U32 nDepth = RPC_MSGPIPE_SIZE;
+
+	switch (nFxnIdx)
+	{
+	case RPC_OMX_FXN_IDX_USE_BUFFER:
+	case RPC_OMX_FXN_IDX_ALLOCATE_BUFFER:
+	case RPC_OMX_FXN_IDX_FREE_BUFFER:
+	case RPC_OMX_FXN_IDX_EMPTYTHISBUFFER:
+	case RPC_OMX_FXN_IDX_FILLTHISBUFFER:
+		/*Mailboxes are a power of two deep */
+		while (nDepth < nBufferDepth)
+			nDepth <<= 1;
+		return nDepth;
+	default:
+		return RPC_MSGPIPE_SIZE;
+	}
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_SetPriority()
+* @brief Picks the remote pool for the next messages of an instance. Messages
+*        already in flight keep the pool they were sent with.
+* @param hRPCCtx [IN] : RPC context handle.
+* @param ePriority [IN] : Priority class.
+* @return RPC_OMX_ErrorNone = Successful
+*/
+/* ===========================================================================*/
+RPC_OMX_ERRORTYPE RPC_SetPriority(OMX_HANDLETYPE hRPCCtx,
+    RPC_OMX_PRIORITY ePriority)
+{
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	RPC_OMX_CONTEXT *pRPCCtx = (RPC_OMX_CONTEXT *) hRPCCtx;
+	OMX_U32 nPoolId = OMX_POOLID_JOBID_DEFAULT;
+
+	RPC_assert(pRPCCtx != NULL, RPC_OMX_ErrorBadParameter,
+	    "NULL context handle");
+
+	/*The remote pools have to exist in the loaded firmware*/
+	if (RPC_GetConfigValue("DEBUG_DOMX_RPC_POOLS", "debug.domx.rpc_pools",
+		0) != 0)
+	{
+		switch (ePriority)
+		{
+		case RPC_OMX_PRIORITY_HIGH:
+			nPoolId = OMX_POOLID_JOBID_HIGH;
+			break;
+		case RPC_OMX_PRIORITY_LOW:
+			nPoolId = OMX_POOLID_JOBID_LOW;
+			break;
+		case RPC_OMX_PRIORITY_DEFAULT:
+			break;
+		default:
+			RPC_assert(0, RPC_OMX_ErrorBadParameter,
+			    "Unknown priority class");
+		}
+	}
+	DOMX_DEBUG("Remote pool 0x%x for priority %d", nPoolId, ePriority);
+	pRPCCtx->nPoolId = nPoolId;
+
+      EXIT:
+	return eRPCError;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_OpenDevice()
+* @brief Opens the rpmsg omx device, waiting for it if the remote core is not
+*        up yet (first use after boot or after a recovery). The wait is on
+*        inotify events of the device directory, so the device is opened as
+*        soon as ueventd has created it and set its permissions. Without
+*        inotify the open is retried every 10 ms.
+* @param nTimeoutMs [IN] : Longest time to wait for the device.
+* @return File descriptor, or -1 with errno set.
+*/
+/* ===========================================================================*/
+static OMX_S32 RPC_OpenDevice(OMX_U32 nTimeoutMs)
+{
+	OMX_S32 fd = -1, fdNotify = -1, nLeft = 0, nErr = 0;
+	struct timespec tStart, tNow;
+	struct pollfd tPoll;
+	char aEvents[256];
+
+	fd = open(RPC_DEVICE_DIR "/" RPC_DEVICE_NAME, O_RDWR);
+	if (fd >= 0 || (errno != ENOENT && errno != EACCES))
+		return fd;
+
+	DOMX_DEBUG("Waiting for " RPC_DEVICE_NAME);
+	clock_gettime(CLOCK_MONOTONIC, &tStart);
+	/*Watch before the next open, a node created in between is then not
+	  missed. Permissions are set after creation, hence IN_ATTRIB */
+	fdNotify = inotify_init();
+	if (fdNotify >= 0 &&
+	    inotify_add_watch(fdNotify, RPC_DEVICE_DIR,
+		IN_CREATE | IN_ATTRIB) < 0)
+	{
+		close(fdNotify);
+		fdNotify = -1;
+	}
+
+	while (1)
+	{
+		fd = open(RPC_DEVICE_DIR "/" RPC_DEVICE_NAME, O_RDWR);
+		nErr = errno;
+		if (fd >= 0 || (nErr != ENOENT && nErr != EACCES))
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &tNow);
+		nLeft = (OMX_S32) nTimeoutMs -
+		    (OMX_S32) ((tNow.tv_sec - tStart.tv_sec) * 1000 +
+		    (tNow.tv_nsec - tStart.tv_nsec) / 1000000);
+		if (nLeft <= 0)
+			break;
+
+		if (fdNotify >= 0)
+		{
+			tPoll.fd = fdNotify;
+			tPoll.events = POLLIN;
+			if (poll(&tPoll, 1, nLeft) > 0)
+			{
+				/*Contents do not matter, every event is a reason to
+				  try again */
+				read(fdNotify, aEvents, sizeof(aEvents));
+			}
+		} else
+		{
+			usleep(10000);
+		}
+	}
+
+	if (fdNotify >= 0)
+		close(fdNotify);
+	if (fd < 0)
+		errno = nErr;
+	return fd;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_SetListenerParams()
+* @brief Names the calling listener thread and applies the listener tunables:
+*        debug.domx.listener_prio (1 to 99) moves it to SCHED_FIFO,
+*        otherwise debug.domx.listener_nice sets its nice value, and
+*        debug.domx.listener_cpus is a mask of the CPUs it may run on
+*        (0, the default, allows all of them). Without any of them the
+*        thread keeps the scheduling it inherited.
+* @param pName [IN] : Thread name.
+* @return none
+*/
+/* ===========================================================================*/
+static void RPC_SetListenerParams(const char *pName)
+{
+	TIMM_OSAL_TASK_PARAMS tParams;
+	OMX_S32 nPrio = RPC_GetConfigValue("DEBUG_DOMX_LISTENER_PRIO",
+	    "debug.domx.listener_prio", 0);
+	OMX_S32 nNice = RPC_GetConfigValue("DEBUG_DOMX_LISTENER_NICE",
+	    "debug.domx.listener_nice", 0);
+
+	tParams.ePolicy = TIMM_OSAL_SCHED_INHERIT;
+	tParams.nPriority = 0;
+	tParams.nNice = nNice;
+	tParams.uCpuMask = RPC_GetConfigValue("DEBUG_DOMX_LISTENER_CPUS",
+	    "debug.domx.listener_cpus", 0);
+	if (nPrio > 0)
+	{
+		tParams.ePolicy = TIMM_OSAL_SCHED_FIFO;
+		tParams.nPriority = nPrio;
+	} else if (nNice != 0)
+	{
+		tParams.ePolicy = TIMM_OSAL_SCHED_OTHER;
+	}
+
+	if (TIMM_OSAL_SetTaskParams(&tParams,
+		(const TIMM_OSAL_S8 *)pName) != TIMM_OSAL_ERR_NONE)
+	{
+		DOMX_ERROR("Can't apply listener prio %d nice %d cpus 0x%x",
+		    nPrio, nNice, tParams.uCpuMask);
+	}
+}
+
+
+
+/*Marks pRPCCtx dead and wakes every stub waiting on one of its pipes. The
+  writes do not block, a pipe that is full already holds a reply for its
+  waiter. Stubs check bRemoteDead before sending, so nothing waits on a dead
+  context afterwards. Returns OMX_FALSE if it was dead already */
+static OMX_BOOL RPC_MarkRemoteDead(RPC_OMX_CONTEXT * pRPCCtx)
+{
+	OMX_PTR pBuff = pRPCCtx->aErrorPacket;
+	OMX_U32 nFxnIdx = 0;
+	TIMM_OSAL_ERRORTYPE eError = TIMM_OSAL_ERR_NONE;
+
+	if (__sync_lock_test_and_set(&pRPCCtx->bRemoteDead, OMX_TRUE))
+		return OMX_FALSE;
+
+	((struct omx_packet *) pRPCCtx->aErrorPacket)->result =
+	    OMX_ErrorHardware;
+	for (nFxnIdx = 0; nFxnIdx < RPC_OMX_MAX_FUNCTION_LIST; nFxnIdx++)
+	{
+		eError = TIMM_OSAL_WriteToPipe(pRPCCtx->pMsgPipe[nFxnIdx],
+		    &pBuff, RPC_MSG_SIZE_FOR_PIPE, TIMM_OSAL_NO_SUSPEND);
+		if (eError != TIMM_OSAL_ERR_NONE)
+			DOMX_DEBUG("Pipe %d already has a reply pending",
+			    nFxnIdx);
+	}
+	return OMX_TRUE;
+}
+
+/* ===========================================================================*/
+/**
+* @name RPC_ReplyTimeout()
+* @brief Called by a stub that got no reply to a sync call in time. A late
+*        reply would be taken for the answer to the next call, so the remote
+*        instance is given up like a dead one: every stub fails from now on
+*        and the proxy gets OMX_ErrorHardware, which starts a recovery when
+*        that is enabled.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @param nFxnIdx [IN] : Function the stub was waiting for.
+* @return none
+*/
+/* ===========================================================================*/
+void RPC_ReplyTimeout(RPC_OMX_CONTEXT * pRPCCtx, OMX_U32 nFxnIdx)
+{
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) pRPCCtx->pAppData;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+
+	DOMX_ERROR("No reply to function %d within %d ms, giving up on the "
+	    "remote instance", nFxnIdx, pRPCCtx->nReplyTimeout);
+	if (!RPC_MarkRemoteDead(pRPCCtx) || hComp == NULL)
+		return;
+	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+	pCompPrv->proxyEventHandler(hComp, pCompPrv->pILAppData,
+	    OMX_EventError, OMX_ErrorHardware, 0, NULL);
+}
+
+/* ===========================================================================*/
+/**
+* @name RPC_ReadMessage()
+* @brief Reads one message from the remote core for the given context.
+* @param pRPCCtx [IN] : RPC Context structure the message is pending on.
+* @param ppBuffer [OUT] : Packet holding the message.
+* @param pSize [OUT] : Number of bytes read.
+* @param pFxnIdx [OUT] : Function index of the message.
+* @return RPC_OMX_ErrorNone = Successful. RPC_OMX_ErrorHardware means the
+*         remote core is gone.
+*/
+/* ===========================================================================*/
+static RPC_OMX_ERRORTYPE RPC_ReadMessage(RPC_OMX_CONTEXT * pRPCCtx,
+    OMX_PTR * ppBuffer, OMX_S32 * pSize, OMX_U32 * pFxnIdx)
+{
+	OMX_PTR pBuffer = NULL;
+	OMX_S32 status = 0;
+	OMX_U32 nFxnIdx = 0, nPacketSize = RPC_PACKET_SIZE;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+
+	DOMX_DEBUG("Recd. omx message");
+	RPC_getPacket(pRPCCtx, nPacketSize, pBuffer);
+	status = read(pRPCCtx->fd_omx, pBuffer, nPacketSize);
+	if (status < 0)
+	{
+		if (errno == ENXIO)
+		{
+			RPC_MarkRemoteDead(pRPCCtx);
+			/*Indicate fatal error and exit*/
+			RPC_assert(0, RPC_OMX_ErrorHardware,
+			    "Remote processor fatal error");
+		} else
+		{
+			RPC_assert(0, RPC_OMX_ErrorUndefined, "read failed");
+		}
+	}
+	if (pRPCCtx->nRecordId)
+		RPC_RecordPacket(pRPCCtx, RPC_RECORD_RECV, pBuffer, status);
+
+	nFxnIdx = ((struct omx_packet *) pBuffer)->fxn_idx;
+	/*Indices from static table will have bit 31 set */
+	if (nFxnIdx & 0x80000000)
+		nFxnIdx &= 0x0FFFFFFF;
+	RPC_assert(nFxnIdx < RPC_OMX_MAX_FUNCTION_LIST,
+	    RPC_OMX_ErrorUndefined, "Bad function index recd");
+
+	*ppBuffer = pBuffer;
+	*pSize = status;
+	*pFxnIdx = nFxnIdx;
+	pBuffer = NULL;
+
+      EXIT:
+	RPC_freePacket(pRPCCtx, pBuffer);
+	return eRPCError;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_DispatchMessage()
+* @brief Dispatches a message read by RPC_ReadMessage - callbacks are handed
+*        to the skeleton, replies are posted to the pipe of the waiting
+*        function. The packet is consumed either way.
+* @param pRPCCtx [IN] : RPC Context structure the message was read from.
+* @param pBuffer [IN] : Packet holding the message.
+* @param status [IN] : Number of bytes read.
+* @param nFxnIdx [IN] : Function index of the message.
+* @return RPC_OMX_ErrorNone = Successful
+*/
+/* ===========================================================================*/
+static RPC_OMX_ERRORTYPE RPC_DispatchMessage(RPC_OMX_CONTEXT * pRPCCtx,
+    OMX_PTR pBuffer, OMX_S32 status, OMX_U32 nFxnIdx)
+{
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	TIMM_OSAL_ERRORTYPE eError = TIMM_OSAL_ERR_NONE;
+	OMX_PTR pBuff = pRPCCtx->aErrorPacket;
+	TIMM_OSAL_U32 nQueued = 0;
+#ifndef RPC_SYNC_MODE
+	OMX_COMPONENTTYPE *hComp = NULL;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+	OMX_ERRORTYPE eCompReturn = OMX_ErrorNone;
+#endif
+
+	switch (nFxnIdx)
+	{
+	case RPC_OMX_FXN_IDX_EVENTHANDLER:
+		RPC_SKEL_EventHandler(((struct omx_packet *) pBuffer)->data);
+		RPC_freePacket(pRPCCtx, pBuffer);
+		pBuffer = NULL;
+		break;
+	case RPC_OMX_FXN_IDX_EMPTYBUFFERDONE:
+		RPC_SKEL_EmptyBufferDone(((struct omx_packet *) pBuffer)->data);
+		RPC_freePacket(pRPCCtx, pBuffer);
+		pBuffer = NULL;
+		break;
+	case RPC_OMX_FXN_IDX_FILLBUFFERDONE:
+		RPC_SKEL_FillBufferDone(((struct omx_packet *) pBuffer)->data);
+		RPC_freePacket(pRPCCtx, pBuffer);
+		pBuffer = NULL;
+		break;
+	case RPC_OMX_FXN_IDX_FLUSH_DONE:
+		RPC_SKEL_FlushDone(((struct omx_packet *) pBuffer)->data,
+		    status - sizeof(struct omx_packet));
+		RPC_freePacket(pRPCCtx, pBuffer);
+		pBuffer = NULL;
+		break;
+#ifndef RPC_SYNC_MODE
+	case RPC_OMX_FXN_IDX_EMPTYTHISBUFFER:
+	case RPC_OMX_FXN_IDX_FILLTHISBUFFER:
+		/*In async mode nobody waits for ETB/FTB replies. Any error from
+		  the remote component is sent to the client as an error event
+		  instead.*/
+		eCompReturn =
+		    (OMX_ERRORTYPE) (((struct omx_packet *) pBuffer)->result);
+		RPC_freePacket(pRPCCtx, pBuffer);
+		pBuffer = NULL;
+		if (eCompReturn != OMX_ErrorNone)
+		{
+			DOMX_ERROR("Async fxn idx %d returned 0x%x", nFxnIdx,
+			    eCompReturn);
+			hComp = (OMX_COMPONENTTYPE *) pRPCCtx->pAppData;
+			if (hComp != NULL)
+			{
+				pCompPrv = (PROXY_COMPONENT_PRIVATE *)
+				    hComp->pComponentPrivate;
+				pCompPrv->proxyEventHandler(hComp,
+				    pCompPrv->pILAppData, OMX_EventError,
+				    eCompReturn, 0, NULL);
+			}
+		}
+		break;
+#endif
+	default:
+		if (((struct omx_packet *) pBuffer)->result == OMX_ErrorHardware)
+		{
+			//On a true OMX_ErrorHardware error, send the error packet of the
+			//context and release the local allocated packet to avoid memory
+			//leaks since the stub will not free the packet on
+			//OMX_ErrorHardware errors.
+			RPC_freePacket(pRPCCtx, pBuffer);
+			pBuffer = NULL;
+			((struct omx_packet *) pRPCCtx->aErrorPacket)->result =
+			    OMX_ErrorHardware;
+			eError = TIMM_OSAL_WriteToPipe(pRPCCtx->pMsgPipe[nFxnIdx],
+			    &pBuff, RPC_MSG_SIZE_FOR_PIPE, TIMM_OSAL_SUSPEND);
+		} else
+		{
+			eError = TIMM_OSAL_WriteToPipe(pRPCCtx->pMsgPipe[nFxnIdx],
+			    &pBuffer, RPC_MSG_SIZE_FOR_PIPE, TIMM_OSAL_SUSPEND);
+		}
+		RPC_assert(eError == TIMM_OSAL_ERR_NONE,
+		    RPC_OMX_ErrorUndefined, "Write to pipe failed");
+		/*Only the listener of this context writes replies, no race */
+		if (TIMM_OSAL_GetPipeReadyMessageCount(pRPCCtx->pMsgPipe[nFxnIdx],
+			&nQueued) == TIMM_OSAL_ERR_NONE &&
+		    nQueued > pRPCCtx->nPipeHighWater[nFxnIdx])
+		{
+			pRPCCtx->nPipeHighWater[nFxnIdx] = nQueued;
+		}
+		break;
+	}
+
+      EXIT:
+	if (eRPCError != RPC_OMX_ErrorNone && pBuffer != NULL)
+	{
+		RPC_freePacket(pRPCCtx, pBuffer);
+		pBuffer = NULL;
+	}
+	return eRPCError;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_ProcessMessage()
+* @brief Reads the messages pending from the remote core for the given
+*        context, up to RPC_CALLBACK_MAX_BATCH, and dispatches them.
+*        Buffer-done messages (EmptyBufferDone/FillBufferDone) are moved
+*        ahead of the replies read before them, so a burst of replies does
+*        not hold back a ready frame. Events are never overtaken: the
+*        buffers a port settings or crop event applies to have to reach the
+*        client after it, so hoisting stops at the first event and the rest
+*        of the batch goes in wire order.
+* @param pRPCCtx [IN] : RPC Context structure the messages are pending on.
+* @return RPC_OMX_ErrorNone = Successful. RPC_OMX_ErrorHardware means the
+*         remote core is gone and the context must not be listened to any
+*         more.
+*/
+/* ===========================================================================*/
+static RPC_OMX_ERRORTYPE RPC_ProcessMessage(RPC_OMX_CONTEXT * pRPCCtx)
+{
+	OMX_PTR pBuffers[RPC_CALLBACK_MAX_BATCH];
+	OMX_S32 nSizes[RPC_CALLBACK_MAX_BATCH];
+	OMX_U32 nFxnIdx[RPC_CALLBACK_MAX_BATCH];
+	OMX_U32 nMsgs = 0, i = 0;
+	struct pollfd tPoll;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	OMX_COMPONENTTYPE *hComp = NULL;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+
+	tPoll.fd = pRPCCtx->fd_omx;
+	tPoll.events = POLLIN;
+	/*The caller saw the fd readable, only the reads after the first one
+	  have to check that they would not block*/
+	do
+	{
+		eRPCError = RPC_ReadMessage(pRPCCtx, &pBuffers[nMsgs],
+		    &nSizes[nMsgs], &nFxnIdx[nMsgs]);
+		if (eRPCError != RPC_OMX_ErrorNone)
+			break;
+		nMsgs++;
+	} while (nMsgs < RPC_CALLBACK_MAX_BATCH && poll(&tPoll, 1, 0) > 0);
+
+	for (i = 0; i < nMsgs && nFxnIdx[i] != RPC_OMX_FXN_IDX_EVENTHANDLER;
+	    i++)
+	{
+		if (RPC_IS_BUFFER_DONE(nFxnIdx[i]))
+		{
+			RPC_DispatchMessage(pRPCCtx, pBuffers[i], nSizes[i],
+			    nFxnIdx[i]);
+			pBuffers[i] = NULL;
+		}
+	}
+	for (i = 0; i < nMsgs; i++)
+	{
+		if (pBuffers[i] != NULL)
+			RPC_DispatchMessage(pRPCCtx, pBuffers[i], nSizes[i],
+			    nFxnIdx[i]);
+	}
+
+	if (eRPCError != RPC_OMX_ErrorNone)
+	{
+		/*Report all hardware errors as fatal, the caller stops listening
+		  to this context*/
+		if (eRPCError == RPC_OMX_ErrorHardware)
+		{
+			/*Implicit detail: pAppData is proxy component handle
+			  updated during RPC_GetHandle*/
+			hComp = (OMX_COMPONENTTYPE *) pRPCCtx->pAppData;
+			if (hComp != NULL)
+			{
+				pCompPrv = (PROXY_COMPONENT_PRIVATE *)
+				    hComp->pComponentPrivate;
+				/*Indicate fatal error. Users are expected to cleanup
+				  the OMX instance to ensure all resources are cleaned
+				  up.*/
+				pCompPrv->proxyEventHandler(hComp,
+				    pCompPrv->pILAppData, OMX_EventError,
+				    OMX_ErrorHardware, 0, NULL);
+			}
+		}
+	}
+	return eRPCError;
+}
+
+
+
 /* ===========================================================================*/
 /**
 * @name RPC_CallbackThread()
@@ -282,17 +1316,11 @@ RPC_OMX_ERRORTYPE RPC_InstanceDeInit(OMX_HANDLETYPE hRPCCtx)
 /* ===========================================================================*/
 void *RPC_CallbackThread(void *data)
 {
-	OMX_PTR pBuffer = NULL;
 	RPC_OMX_CONTEXT *pRPCCtx = (RPC_OMX_CONTEXT *) data;
 	fd_set readfds;
 	OMX_S32 maxfd = 0, status = 0;
-	OMX_U32 nFxnIdx = 0, nPacketSize = RPC_PACKET_SIZE, nPos = 0;
-	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
-	TIMM_OSAL_ERRORTYPE eError = TIMM_OSAL_ERR_NONE;
-	OMX_COMPONENTTYPE *hComp = NULL;
-	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
-        OMX_PTR pBuff = pBufferError;
 
+	RPC_SetListenerParams("domx-rpc-cb");
 	maxfd =
 	    (pRPCCtx->fd_killcb >
 	    pRPCCtx->fd_omx ? pRPCCtx->fd_killcb : pRPCCtx->fd_omx) + 1;
@@ -304,8 +1332,11 @@ void *RPC_CallbackThread(void *data)
 
 		DOMX_DEBUG("Waiting for messages from remote core");
 		status = select(maxfd, &readfds, NULL, NULL, NULL);
-		RPC_assert(status > 0, RPC_OMX_ErrorUndefined,
-		    "select failed");
+		if (status <= 0)
+		{
+			DOMX_ERROR("select failed");
+			continue;
+		}
 
 		if (FD_ISSET(pRPCCtx->fd_killcb, &readfds))
 		{
@@ -315,112 +1346,232 @@ void *RPC_CallbackThread(void *data)
 
 		if (FD_ISSET(pRPCCtx->fd_omx, &readfds))
 		{
-			DOMX_DEBUG("Recd. omx message");
-			RPC_getPacket(nPacketSize, pBuffer);
-			status = read(pRPCCtx->fd_omx, pBuffer, nPacketSize);
-            if(status < 0)
-            {
-                if(errno == ENXIO)
-                {
-		    for(nFxnIdx = 0; nFxnIdx < RPC_OMX_MAX_FUNCTION_LIST; nFxnIdx++)
-		    {
-			((struct omx_packet *) pBufferError)->result = OMX_ErrorHardware;
-			TIMM_OSAL_WriteToPipe(pRPCCtx->pMsgPipe[nFxnIdx], &pBuff, RPC_MSG_SIZE_FOR_PIPE, TIMM_OSAL_SUSPEND);
-			if(eError != TIMM_OSAL_ERR_NONE)
-				DOMX_ERROR("Write to pipe failed");
-		    }
-                    /*Indicate fatal error and exit*/
-                    RPC_assert(0, RPC_OMX_ErrorHardware,
-                    "Remote processor fatal error");
-                }
-                else
-                {
-                    RPC_assert(0, RPC_OMX_ErrorUndefined,
-                    "read failed");
-                }
-            }
-
-			nPos = 0;
-			nFxnIdx = ((struct omx_packet *) pBuffer)->fxn_idx;
-			/*Indices from static table will have bit 31 set */
-			if (nFxnIdx & 0x80000000)
-				nFxnIdx &= 0x0FFFFFFF;
-			RPC_assert(nFxnIdx < RPC_OMX_MAX_FUNCTION_LIST,
-			    RPC_OMX_ErrorUndefined,
-			    "Bad function index recd");
-			switch (nFxnIdx)
-			{
-			case RPC_OMX_FXN_IDX_EVENTHANDLER:
-				RPC_SKEL_EventHandler(((struct omx_packet *)
-					pBuffer)->data);
-				RPC_freePacket(pBuffer);
-				pBuffer = NULL;
-				break;
-			case RPC_OMX_FXN_IDX_EMPTYBUFFERDONE:
-				RPC_SKEL_EmptyBufferDone(((struct omx_packet *)
-					pBuffer)->data);
-				RPC_freePacket(pBuffer);
-				pBuffer = NULL;
-				break;
-			case RPC_OMX_FXN_IDX_FILLBUFFERDONE:
-				RPC_SKEL_FillBufferDone(((struct omx_packet *)
-					pBuffer)->data);
-				RPC_freePacket(pBuffer);
-				pBuffer = NULL;
+			if (RPC_ProcessMessage(pRPCCtx) == RPC_OMX_ErrorHardware)
 				break;
-			default:
-				if (((struct omx_packet *) pBuffer)->result == OMX_ErrorHardware)
-				{
-					//On a true OMX_ErrorHardware error, send the global error packet
-					//and release the local allocated packet to avoid memory leaks since
-					//the listener will not free the packet on OMX_ErrorHardware errors.
-					RPC_freePacket(pBuffer);
-					pBuffer = NULL;
-					((struct omx_packet *) pBufferError)->result = OMX_ErrorHardware;
-					eError = TIMM_OSAL_WriteToPipe(pRPCCtx->pMsgPipe[nFxnIdx],
-													&pBuff,
-													RPC_MSG_SIZE_FOR_PIPE,
-													TIMM_OSAL_SUSPEND);
-				}
-				else
-				{
-					eError = TIMM_OSAL_WriteToPipe(pRPCCtx->pMsgPipe[nFxnIdx],
-													&pBuffer,
-													RPC_MSG_SIZE_FOR_PIPE,
-													TIMM_OSAL_SUSPEND);
-				}
-				RPC_assert(eError == TIMM_OSAL_ERR_NONE,
-				    RPC_OMX_ErrorUndefined,
-				    "Write to pipe failed");
-				break;
-			}
 		}
-EXIT:
-		if (eRPCError != RPC_OMX_ErrorNone)
+	}
+        return (void*)0;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_SharedListenerThread()
+* @brief Entry function of the process wide listener. It waits on the omx fd
+*        of every registered context and processes messages the same way
+*        RPC_CallbackThread does for a single context.
+* @param data [IN] : Unused.
+* @return NULL
+*/
+/* ===========================================================================*/
+static void *RPC_SharedListenerThread(void *data)
+{
+	RPC_SHARED_LISTENER *pListener = &gSharedListener;
+	struct epoll_event tEvents[RPC_SHARED_LISTENER_MAX_EVENTS];
+	RPC_OMX_CONTEXT *pRPCCtx = NULL;
+	OMX_S32 nEvents = 0, i = 0;
+	OMX_U32 nGeneration = 0;
+	OMX_BOOL bExit = OMX_FALSE;
+
+	RPC_SetListenerParams("domx-rpc-shared");
+	while (bExit == OMX_FALSE)
+	{
+		nGeneration = pListener->nGeneration;
+
+		DOMX_DEBUG("Waiting for messages from remote core");
+		nEvents = epoll_wait(pListener->fd_epoll, tEvents,
+		    RPC_SHARED_LISTENER_MAX_EVENTS, -1);
+		if (nEvents <= 0)
+		{
+			if (nEvents < 0 && errno != EINTR)
+				DOMX_ERROR("epoll_wait failed %d", errno);
+			continue;
+		}
+
+		pthread_mutex_lock(&pListener->tDispatchLock);
+		/*A context was removed while we were waiting, its event may be
+		  in this batch. The fds are level triggered so just poll again*/
+		if (nGeneration != pListener->nGeneration)
 		{
-			//AD TODO: Send error CB to client and then go back in loop to wait for killfd
-			if (pBuffer != NULL)
+			pthread_mutex_unlock(&pListener->tDispatchLock);
+			continue;
+		}
+		for (i = 0; i < nEvents; i++)
+		{
+			pRPCCtx = (RPC_OMX_CONTEXT *) tEvents[i].data.ptr;
+			if (pRPCCtx == NULL)
 			{
-				RPC_freePacket(pBuffer);
-				pBuffer = NULL;
+				DOMX_DEBUG("Recd. kill message - exiting the thread");
+				bExit = OMX_TRUE;
+				break;
 			}
-			/*Report all hardware errors as fatal and exit from listener thread*/
-			if (eRPCError == RPC_OMX_ErrorHardware)
+			if (RPC_ProcessMessage(pRPCCtx) == RPC_OMX_ErrorHardware)
 			{
-				/*Implicit detail: pAppData is proxy component handle updated during
-                  RPC_GetHandle*/
-				hComp = (OMX_COMPONENTTYPE *) pRPCCtx->pAppData;
-                if(hComp != NULL)
-				{
-					pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
-                    /*Indicate fatal error. Users are expected to cleanup the OMX instance
-                    to ensure all resources are cleaned up.*/
-					pCompPrv->proxyEventHandler(hComp, pCompPrv->pILAppData, OMX_EventError,
-												OMX_ErrorHardware, 0, NULL);
-				}
+				/*Stop listening to this context, same as the per
+				  instance listener exiting*/
+				epoll_ctl(pListener->fd_epoll, EPOLL_CTL_DEL,
+				    pRPCCtx->fd_omx, NULL);
+			}
+			/*A callback unregistered a context, the rest of the
+			  batch may point to it*/
+			if (nGeneration != pListener->nGeneration)
 				break;
+		}
+		pthread_mutex_unlock(&pListener->tDispatchLock);
+	}
+	return NULL;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_SharedListenerRegister()
+* @brief Adds a context to the shared listener, starting the listener
+*        thread if this is the first context.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @return RPC_OMX_ErrorNone = Successful
+*/
+/* ===========================================================================*/
+static RPC_OMX_ERRORTYPE RPC_SharedListenerRegister(RPC_OMX_CONTEXT *
+    pRPCCtx)
+{
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	RPC_SHARED_LISTENER *pListener = &gSharedListener;
+	struct epoll_event tEvent;
+	OMX_S32 status = 0;
+	OMX_U64 nKillEvent = 1;
+	OMX_BOOL bStarted = OMX_FALSE, bThreadCreated = OMX_FALSE;
+
+	pthread_mutex_lock(&pListener->tLock);
+
+	if (pListener->bRunning == OMX_FALSE)
+	{
+		bStarted = OMX_TRUE;
+		pListener->fd_epoll = epoll_create(RPC_SHARED_LISTENER_MAX_EVENTS);
+		RPC_assert(pListener->fd_epoll >= 0,
+		    RPC_OMX_ErrorInsufficientResources, "Can't create epoll fd");
+		pListener->fd_kill = eventfd(0, 0);
+		RPC_assert(pListener->fd_kill >= 0,
+		    RPC_OMX_ErrorInsufficientResources, "Can't create kill fd");
+
+		tEvent.events = EPOLLIN;
+		tEvent.data.ptr = NULL;
+		status = epoll_ctl(pListener->fd_epoll, EPOLL_CTL_ADD,
+		    pListener->fd_kill, &tEvent);
+		RPC_assert(status == 0, RPC_OMX_ErrorInsufficientResources,
+		    "Can't add kill fd to epoll set");
+
+		DOMX_DEBUG("Create shared listener thread");
+		status = pthread_create(&(pListener->tThread), NULL,
+		    RPC_SharedListenerThread, NULL);
+		RPC_assert(status == 0, RPC_OMX_ErrorInsufficientResources,
+		    "Can't create shared listener thread");
+		bThreadCreated = OMX_TRUE;
+		pListener->bRunning = OMX_TRUE;
+	}
+
+	tEvent.events = EPOLLIN;
+	tEvent.data.ptr = pRPCCtx;
+	status = epoll_ctl(pListener->fd_epoll, EPOLL_CTL_ADD, pRPCCtx->fd_omx,
+	    &tEvent);
+	RPC_assert(status == 0, RPC_OMX_ErrorInsufficientResources,
+	    "Can't add omx fd to epoll set");
+
+	pRPCCtx->bSharedListener = OMX_TRUE;
+	pListener->nUsers++;
+
+      EXIT:
+	if (eRPCError != RPC_OMX_ErrorNone && bStarted == OMX_TRUE)
+	{
+		/*Nobody else uses the listener, tear it down again*/
+		if (bThreadCreated == OMX_TRUE)
+		{
+			write(pListener->fd_kill, &nKillEvent, sizeof(OMX_U64));
+			pthread_join(pListener->tThread, NULL);
+		}
+		if (pListener->fd_kill >= 0)
+			close(pListener->fd_kill);
+		if (pListener->fd_epoll >= 0)
+			close(pListener->fd_epoll);
+		pListener->fd_kill = -1;
+		pListener->fd_epoll = -1;
+		pListener->bRunning = OMX_FALSE;
+	}
+	pthread_mutex_unlock(&pListener->tLock);
+	return eRPCError;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_SharedListenerUnregister()
+* @brief Removes a context from the shared listener. When this returns the
+*        listener is guaranteed not to touch the context any more. The
+*        listener thread is stopped along with the last context, unless
+*        that is removed from a callback on the listener thread itself. The
+*        thread then stays up idle for the next context to reuse, it can
+*        neither wait for tDispatchLock it holds nor join itself.
+* @param pRPCCtx [IN] : RPC Context structure.
+* @return RPC_OMX_ErrorNone = Successful
+*/
+/* ===========================================================================*/
+static RPC_OMX_ERRORTYPE RPC_SharedListenerUnregister(RPC_OMX_CONTEXT *
+    pRPCCtx)
+{
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	RPC_SHARED_LISTENER *pListener = &gSharedListener;
+	OMX_U64 nKillEvent = 1;
+	OMX_S32 status = 0;
+	OMX_BOOL bFromListener = OMX_FALSE;
+
+	/*On the listener thread tDispatchLock is already held by the batch
+	  this callback came from*/
+	bFromListener = pthread_equal(pthread_self(), pListener->tThread) ?
+	    OMX_TRUE : OMX_FALSE;
+	if (bFromListener == OMX_FALSE)
+		pthread_mutex_lock(&pListener->tDispatchLock);
+	pthread_mutex_lock(&pListener->tLock);
+
+	epoll_ctl(pListener->fd_epoll, EPOLL_CTL_DEL, pRPCCtx->fd_omx, NULL);
+	pListener->nGeneration++;
+	if (bFromListener == OMX_FALSE)
+		pthread_mutex_unlock(&pListener->tDispatchLock);
+	pRPCCtx->bSharedListener = OMX_FALSE;
+
+	pListener->nUsers--;
+	if (pListener->nUsers == 0 && bFromListener == OMX_TRUE)
+	{
+		DOMX_DEBUG("Last context removed from a callback, shared "
+		    "listener stays up");
+	} else if (pListener->nUsers == 0)
+	{
+		status = write(pListener->fd_kill, &nKillEvent, sizeof(OMX_U64));
+		if (status <= 0)
+		{
+			DOMX_ERROR
+			    ("Write to kill fd failed - listener may not exit");
+			eRPCError = RPC_OMX_ErrorUndefined;
+		} else
+		{
+			DOMX_DEBUG("Waiting for shared listener to exit");
+			status = pthread_join(pListener->tThread, NULL);
+			if (status != 0)
+			{
+				DOMX_ERROR("Join for shared listener failed");
+				eRPCError = RPC_OMX_ErrorUndefined;
 			}
 		}
+		close(pListener->fd_kill);
+		close(pListener->fd_epoll);
+		pListener->fd_kill = -1;
+		pListener->fd_epoll = -1;
+		pListener->bRunning = OMX_FALSE;
 	}
-        return (void*)0;
+
+	pthread_mutex_unlock(&pListener->tLock);
+	return eRPCError;
 }
+
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ *  @file  omx_rpc_record.c
+ *         Optional recorder of the packets exchanged with the remote core,
+ *         see omx_rpc_record.h for the trace layout.
+ *
+ *  @path \WTSD_DucatiMMSW\framework\domx\omx_rpc\src
+ *
+ *  @rev 1.0
+ */
+
+
+/******************************************************************
+ *   INCLUDE FILES
+ ******************************************************************/
+/* ----- system and platform files ----------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef _Android
+#include <cutils/properties.h>
+#endif
+
+#include <OMX_Types.h>
+#include <timm_osal_interfaces.h>
+#include <timm_osal_trace.h>
+
+/*-------program files ----------------------------------------*/
+#include "omx_rpc.h"
+#include "omx_rpc_internal.h"
+#include "omx_rpc_record.h"
+#include "omx_rpc_utils.h"
+
+#include <linux/rpmsg_omx.h>
+
+/* Records are staged here and written out when it fills up or when an
+   instance goes away, so recording does not add a syscall per packet */
+#define RPC_RECORD_BUFFER_SIZE (64 * 1024)
+#define RPC_RECORD_PATH_MAX (256)
+
+/*Process wide recorder state, all fields but tOnce are protected by tLock.
+  fd_trace stays -1 when recording is disabled or after a write error.*/
+typedef struct RPC_RECORDER
+{
+	pthread_mutex_t tLock;
+	pthread_once_t tOnce;
+	OMX_S32 fd_trace;
+	OMX_U32 nLastId;
+	OMX_U32 nUsed;
+	OMX_U8 aBuffer[RPC_RECORD_BUFFER_SIZE];
+} RPC_RECORDER;
+
+static RPC_RECORDER gRecorder = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, -1, 0, 0, { 0 }
+};
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RecordFlush()
+* @brief Writes the staged records to the trace file. Recording stops for
+*        the whole process on a write error. Called with tLock held.
+*/
+/* ===========================================================================*/
+static void RPC_RecordFlush(void)
+{
+	OMX_U32 nDone = 0;
+	ssize_t status = 0;
+
+	while (gRecorder.fd_trace >= 0 && nDone < gRecorder.nUsed)
+	{
+		status = write(gRecorder.fd_trace, gRecorder.aBuffer + nDone,
+		    gRecorder.nUsed - nDone);
+		if (status < 0 && errno == EINTR)
+			continue;
+		if (status <= 0)
+		{
+			DOMX_ERROR("RPC trace write failed (%d), recording stopped",
+			    errno);
+			close(gRecorder.fd_trace);
+			gRecorder.fd_trace = -1;
+			break;
+		}
+		nDone += status;
+	}
+	gRecorder.nUsed = 0;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RecordAppend()
+* @brief Stages one record. Called with tLock held.
+* @param nContext [IN] : Id of the RPC context.
+* @param nType [IN] : RPC_RECORD_TYPE of the record.
+* @param nFxnIdx [IN] : Function index, 0 for non packet records.
+* @param pData [IN] : Payload.
+* @param nSize [IN] : Payload size.
+*/
+/* ===========================================================================*/
+static void RPC_RecordAppend(OMX_U32 nContext, OMX_U32 nType,
+    OMX_U32 nFxnIdx, const void *pData, OMX_U32 nSize)
+{
+	RPC_RECORD_ENTRY tEntry;
+	struct timespec tNow;
+
+	if (gRecorder.fd_trace < 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	tEntry.nTimeNs = (OMX_U64) tNow.tv_sec * 1000000000ULL + tNow.tv_nsec;
+	tEntry.nContext = nContext;
+	tEntry.nType = (OMX_U16) nType;
+	tEntry.nReserved = 0;
+	tEntry.nFxnIdx = nFxnIdx;
+	tEntry.nSize = nSize;
+
+	if (gRecorder.nUsed + sizeof(tEntry) + nSize > RPC_RECORD_BUFFER_SIZE)
+		RPC_RecordFlush();
+
+	memcpy(gRecorder.aBuffer + gRecorder.nUsed, &tEntry, sizeof(tEntry));
+	gRecorder.nUsed += sizeof(tEntry);
+	if (nSize > 0)
+		memcpy(gRecorder.aBuffer + gRecorder.nUsed, pData, nSize);
+	gRecorder.nUsed += nSize;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RecordSetup()
+* @brief Opens the trace file named by DEBUG_DOMX_RPC_RECORD or
+*        debug.domx.rpc_record, run once per process.
+*/
+/* ===========================================================================*/
+static void RPC_RecordSetup(void)
+{
+	char cPath[RPC_RECORD_PATH_MAX];
+	RPC_RECORD_FILE_HEADER tHeader;
+	const char *pName = getenv("DEBUG_DOMX_RPC_RECORD");
+#ifdef _Android
+	char value[PROPERTY_VALUE_MAX];
+
+	if (pName == NULL && property_get("debug.domx.rpc_record", value,
+		NULL) > 0)
+		pName = value;
+#endif
+
+	if (pName == NULL || pName[0] == '\0')
+		return;
+
+	snprintf(cPath, sizeof(cPath), "%s.%d", pName, (int)getpid());
+	pthread_mutex_lock(&gRecorder.tLock);
+	gRecorder.fd_trace = open(cPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (gRecorder.fd_trace < 0)
+	{
+		DOMX_ERROR("Can't open RPC trace %s (%d)", cPath, errno);
+	} else
+	{
+		DOMX_WARN("Recording RPC traffic to %s", cPath);
+		tHeader.nMagic = RPC_RECORD_MAGIC;
+		tHeader.nVersion = RPC_RECORD_VERSION;
+		tHeader.nPacketSize = RPC_PACKET_SIZE;
+		tHeader.nPid = (OMX_U32) getpid();
+		memcpy(gRecorder.aBuffer, &tHeader, sizeof(tHeader));
+		gRecorder.nUsed = sizeof(tHeader);
+		RPC_RecordFlush();
+	}
+	pthread_mutex_unlock(&gRecorder.tLock);
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RecordOpen()
+* @brief Gives the context a recorder id and records its creation, if
+*        recording is enabled.
+* @param pRPCCtx [IN] : The RPC context.
+* @param cComponentName [IN] : Name of the component of this context.
+*/
+/* ===========================================================================*/
+void RPC_RecordOpen(RPC_OMX_CONTEXT * pRPCCtx, OMX_STRING cComponentName)
+{
+	char cName[OMX_MAX_STRINGNAME_SIZE];
+
+	pthread_once(&gRecorder.tOnce, RPC_RecordSetup);
+
+	pthread_mutex_lock(&gRecorder.tLock);
+	if (gRecorder.fd_trace >= 0)
+	{
+		TIMM_OSAL_Memset(cName, 0, sizeof(cName));
+		strncpy(cName, cComponentName, sizeof(cName) - 1);
+		pRPCCtx->nRecordId = ++gRecorder.nLastId;
+		RPC_RecordAppend(pRPCCtx->nRecordId, RPC_RECORD_OPEN, 0, cName,
+		    sizeof(cName));
+	}
+	pthread_mutex_unlock(&gRecorder.tLock);
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RecordClose()
+* @brief Records the end of the context and writes out everything staged.
+* @param pRPCCtx [IN] : The RPC context.
+*/
+/* ===========================================================================*/
+void RPC_RecordClose(RPC_OMX_CONTEXT * pRPCCtx)
+{
+	if (pRPCCtx->nRecordId == 0)
+		return;
+
+	pthread_mutex_lock(&gRecorder.tLock);
+	RPC_RecordAppend(pRPCCtx->nRecordId, RPC_RECORD_CLOSE, 0, NULL, 0);
+	RPC_RecordFlush();
+	pthread_mutex_unlock(&gRecorder.tLock);
+	pRPCCtx->nRecordId = 0;
+}
+
+
+
+/* ===========================================================================*/
+/**
+* @name RPC_RecordPacket()
+* @brief Records a packet sent to or received from the remote core. Callers
+*        only call this when pRPCCtx->nRecordId is set.
+* @param pRPCCtx [IN] : The RPC context.
+* @param nType [IN] : RPC_RECORD_SEND or RPC_RECORD_RECV.
+* @param pPacket [IN] : The packet, starting with struct omx_packet.
+* @param nSize [IN] : Bytes written or read.
+*/
+/* ===========================================================================*/
+void RPC_RecordPacket(RPC_OMX_CONTEXT * pRPCCtx, OMX_U32 nType,
+    OMX_PTR pPacket, OMX_U32 nSize)
+{
+	OMX_U32 nFxnIdx = ((struct omx_packet *) pPacket)->fxn_idx;
+
+	/*Indices from static table will have bit 31 set */
+	if (nFxnIdx & 0x80000000)
+		nFxnIdx &= 0x0FFFFFFF;
+	if (nSize > RPC_PACKET_SIZE)
+		nSize = RPC_PACKET_SIZE;
+
+	pthread_mutex_lock(&gRecorder.tLock);
+	RPC_RecordAppend(pRPCCtx->nRecordId, nType, nFxnIdx, pPacket, nSize);
+	pthread_mutex_unlock(&gRecorder.tLock);
+}
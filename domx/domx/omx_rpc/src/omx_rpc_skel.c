@@ -98,6 +98,7 @@ RPC_OMX_ERRORTYPE RPC_SKEL_EmptyBufferDone(void *data)
 	//RPC_OMX_MESSAGE *recdMsg;
 	OMX_U8 *pMsgBody = NULL;
 	//recdMsg = (RPC_OMX_MESSAGE *) (data);
+	DOMX_TRACE_BEGIN(0);
 
 	pMsgBody = data;	//&recdMsg->msgBody[0];
 
@@ -120,6 +121,7 @@ RPC_OMX_ERRORTYPE RPC_SKEL_EmptyBufferDone(void *data)
 	    nOffset, nFlags);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return tRPCError;
 }
 
@@ -152,6 +154,7 @@ RPC_OMX_ERRORTYPE RPC_SKEL_FillBufferDone(void *data)
 	OMX_HANDLETYPE hMarkTargetComponent = NULL;
 	OMX_PTR pMarkData = NULL;
 	//recdMsg = (RPC_OMX_MESSAGE *) (data);
+	DOMX_TRACE_BEGIN(0);
 
 	pMsgBody = data;	//&recdMsg->msgBody[0];
 
@@ -177,11 +180,63 @@ RPC_OMX_ERRORTYPE RPC_SKEL_FillBufferDone(void *data)
 	    nOffset, nFlags, nTimeStamp, hMarkTargetComponent, pMarkData);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return tRPCError;
 }
 
 
 
+/* ===========================================================================*/
+/**
+ * @name RPC_SKEL_FlushDone()
+ * @brief Skeleton for the buffers of a flushed port returned in one message.
+ *        The proxy gets the whole list at once instead of one EBD/FBD
+ *        message per buffer.
+ * @param *data     : Pointer to the data section of the message received
+ * @param nDataSize : Number of valid bytes at data
+ * @return RPC_OMX_ErrorNone = Successful
+ *
+ */
+/* ===========================================================================*/
+RPC_OMX_ERRORTYPE RPC_SKEL_FlushDone(void *data, OMX_U32 nDataSize)
+{
+	OMX_HANDLETYPE hComp;
+	RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+	OMX_U32 nPortIndex = 0;
+	OMX_U32 eDir = 0;
+	OMX_COMPONENTTYPE *pHandle = NULL;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+	OMX_U32 nPos = 0, nCount = 0;
+	OMX_U8 *pMsgBody = data;
+	DOMX_TRACE_BEGIN(0);
+
+	DOMX_ENTER("");
+
+	//Marshalled:[>hComp|>nPortIndex|>eDir|>nCount|N x >bufferHdr]
+
+	RPC_GETFIELDVALUE(pMsgBody, nPos, hComp, OMX_HANDLETYPE);
+	pHandle = (OMX_COMPONENTTYPE *) hComp;
+	pCompPrv = (PROXY_COMPONENT_PRIVATE *) pHandle->pComponentPrivate;
+
+	RPC_GETFIELDVALUE(pMsgBody, nPos, nPortIndex, OMX_U32);
+	RPC_GETFIELDVALUE(pMsgBody, nPos, eDir, OMX_U32);
+	RPC_GETFIELDVALUE(pMsgBody, nPos, nCount, OMX_U32);
+	RPC_assert(nCount <= RPC_FLUSH_DONE_MAX &&
+	    nPos + nCount * sizeof(OMX_U32) <= nDataSize,
+	    RPC_OMX_ErrorBadParameter, "Bad flush done");
+
+	if (pCompPrv->proxyFlushDone(hComp, nPortIndex, (OMX_DIRTYPE) eDir,
+		nCount, (OMX_U32 *) (pMsgBody + nPos)) != OMX_ErrorNone)
+		eRPCError = RPC_OMX_ErrorUndefined;
+
+      EXIT:
+	DOMX_EXIT("");
+	DOMX_TRACE_END();
+	return eRPCError;
+}
+
+
+
 /* ===========================================================================*/
 /**
  * @name RPC_SKEL_EventHandler()
@@ -208,6 +263,7 @@ RPC_OMX_ERRORTYPE RPC_SKEL_EventHandler(void *data)
 	OMX_U8 *pMsgBody = NULL;
 	//recdMsg = (RPC_OMX_MESSAGE *) (data);
 	pMsgBody = data;	//&recdMsg->msgBody[0];
+	DOMX_TRACE_BEGIN(0);
 
 	DOMX_ENTER("");
 
@@ -234,6 +290,7 @@ RPC_OMX_ERRORTYPE RPC_SKEL_EventHandler(void *data)
 	    nData1, nData2, pEventData);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return tRPCError;
 
 }
@@ -78,27 +78,30 @@
 //#define RPC_MSGPIPE_SIZE (4)
 #define RPC_MSG_SIZE_FOR_PIPE (sizeof(OMX_PTR))
 
-/* When this is defined ETB/FTB calls are made in sync mode. Undefining will
- * result in these calls being sent via async mode. Sync mode leads to correct
- * functionality as per OMX spec but has a slight performance penalty. Async
- * mode sacrifices strict adherence to spec for some gain in performance. */
-#define RPC_SYNC_MODE
+/* RPC_SYNC_MODE (see omx_rpc_internal.h) selects between sync and async
+ * ETB/FTB calls */
 
-
-#define RPC_getPacket(nPacketSize, pPacket) do { \
-    pPacket = TIMM_OSAL_Malloc(nPacketSize, TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT); \
+#define RPC_getPacket(hCtx, nPacketSize, pPacket) do { \
+    pPacket = RPC_AllocPacket(hCtx); \
     RPC_assert(pPacket != NULL, RPC_OMX_ErrorInsufficientResources, \
            "Error Allocating RCM Message Frame"); \
     TIMM_OSAL_Memset(pPacket, 0, nPacketSize); \
     } while(0)
 
-#define RPC_freePacket(pPacket) do { \
-    if(pPacket != NULL) TIMM_OSAL_Free(pPacket); \
+#define RPC_freePacket(hCtx, pPacket) do { \
+    if(pPacket != NULL) RPC_ReleasePacket(hCtx, pPacket); \
     } while(0)
 
 #define RPC_sendPacket_sync(hCtx, pPacket, nPacketSize, nFxnIdx, pRetPacket, nSize) do { \
+    if(hCtx->bRemoteDead) { \
+         RPC_freePacket(hCtx, pPacket); \
+         pPacket = NULL; \
+         RPC_assert(0, RPC_OMX_ErrorHardware, "Ducati in faulty state"); \
+    }  \
+    if(hCtx->nRecordId) \
+        RPC_RecordPacket(hCtx, RPC_RECORD_SEND, pPacket, nPacketSize); \
     status = write(hCtx->fd_omx, pPacket, nPacketSize); \
-    RPC_freePacket(pPacket); \
+    RPC_freePacket(hCtx, pPacket); \
     pPacket = NULL; \
     if(status < 0 && errno == ENXIO) {  \
          RPC_assert(0, RPC_OMX_ErrorHardware, "Write failed - Ducati in faulty state"); \
@@ -108,48 +111,108 @@
         RPC_assert(0, RPC_OMX_ErrorUndefined, "Write failed"); \
     }  \
     eError = TIMM_OSAL_ReadFromPipe(hCtx->pMsgPipe[nFxnIdx], &pRetPacket, \
-        RPC_MSG_SIZE_FOR_PIPE, (TIMM_OSAL_U32 *)(&nSize), TIMM_OSAL_SUSPEND); \
+        RPC_MSG_SIZE_FOR_PIPE, (TIMM_OSAL_U32 *)(&nSize), hCtx->nReplyTimeout); \
+    if(eError == TIMM_OSAL_ERR_TIMEOUT) { \
+         pRetPacket = NULL; \
+         RPC_ReplyTimeout(hCtx, nFxnIdx); \
+         RPC_assert(0, RPC_OMX_ErrorHardware, "No reply - Ducati in faulty state"); \
+    }  \
     RPC_assert(eError == TIMM_OSAL_ERR_NONE, eError, \
         "Read failed"); \
     } while(0)
 
-/*Set bit 31 on fxn idx as it is static function*/
-#define RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize) do { \
+/*Set bit 31 on fxn idx as it is static function, flags carry the remote pool
+  of the instance*/
+#define RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize) do { \
     pOmxPacket = (struct omx_packet *)pPacket; \
     pData = pOmxPacket->data; \
     pOmxPacket->desc |= OMX_DESC_MSG << OMX_DESC_TYPE_SHIFT; \
     pOmxPacket->msg_id = 0; \
-    pOmxPacket->flags = OMX_POOLID_JOBID_DEFAULT; \
+    pOmxPacket->flags = hCtx->nPoolId; \
     pOmxPacket->fxn_idx = (nFxnIdx | 0x80000000); \
     pOmxPacket->result = 0; \
     pOmxPacket->data_size = nPacketSize; \
     } while(0)
 
-//Async to be checked later - most probably same as sync but without the read
-#if 0
-
-#define RPC_sendPacket_async(HRCM, pPacket, nFxnIdx) do { \
-    pPacket->nFxnIdx = nFxnIdx; \
-    status = RcmClient_execCmd(HRCM, pPacket); \
-    if(status < 0) { \
-    RPC_freePacket(HRCM, pPacket); \
+/*Same as sync send but without waiting for the reply. The packet is marked as
+  a non-blocking command so that the remote core does not need to respond.*/
+#define RPC_sendPacket_async(hCtx, pPacket, nPacketSize) do { \
+    ((struct omx_packet *)pPacket)->desc &= ~OMX_DESC_TYPE_MASK; \
+    ((struct omx_packet *)pPacket)->desc |= OMX_DESC_CMD << OMX_DESC_TYPE_SHIFT; \
+    if(hCtx->bRemoteDead) { \
+         RPC_freePacket(hCtx, pPacket); \
+         pPacket = NULL; \
+         RPC_assert(0, RPC_OMX_ErrorHardware, "Ducati in faulty state"); \
+    }  \
+    if(hCtx->nRecordId) \
+        RPC_RecordPacket(hCtx, RPC_RECORD_SEND, pPacket, nPacketSize); \
+    status = write(hCtx->fd_omx, pPacket, nPacketSize); \
+    RPC_freePacket(hCtx, pPacket); \
     pPacket = NULL; \
-    RPC_assert(0, RPC_OMX_RCM_ErrorExecFail, \
-           "RcmClient_exec failed"); \
-    } \
+    if(status < 0 && errno == ENXIO) {  \
+         RPC_assert(0, RPC_OMX_ErrorHardware, "Write failed - Ducati in faulty state"); \
+    }  \
+    if(status != (signed)nPacketSize) { \
+        DOMX_ERROR("Write failed returning status = 0x%x",status); \
+        RPC_assert(0, RPC_OMX_ErrorUndefined, "Write failed"); \
+    }  \
     } while(0)
 
-#define RPC_checkAsyncErrors(rcmHndl, pPacket) do { \
-    status = RcmClient_checkForError(rcmHndl, &pPacket); \
-    if(status < 0) { \
-        RPC_freePacket(rcmHndl, pPacket); \
-        pPacket = NULL; \
-    } \
-    RPC_assert(status >= 0, RPC_OMX_RCM_ClientFail, \
-        "Async error check returned error"); \
-    } while(0)
+/* ===========================================================================*/
+/**
+ * @name RPC_StructPut()
+ * @brief Puts a param/config structure in the packet. A structure that does
+ *        not fit goes to the scratch buffer of the remote instance instead
+ *        and the packet only carries RPC_STRUCT_IN_SCRATCH, its offset and
+ *        size. The scratch lock is then held until the caller has read the
+ *        reply back and unlocks it.
+ * @param hCtx [IN]         : The RPC context.
+ * @param pData [IN]        : Data area of the packet.
+ * @param pPos [INOUT]      : Write position in pData.
+ * @param nPacketSize [IN]  : Size of the packet.
+ * @param pStruct [IN]      : The structure.
+ * @param nStructSize [IN]  : Its size.
+ * @param bMapInPacket [IN] : The structure has a buffer pointer the kernel
+ *                            patches, it has to be sent in the packet.
+ * @param bInScratch [OUT]  : OMX_TRUE if the scratch buffer was used.
+ * @return RPC_OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+static RPC_OMX_ERRORTYPE RPC_StructPut(RPC_OMX_CONTEXT * hCtx,
+    TIMM_OSAL_PTR pData, OMX_U32 * pPos, OMX_U32 nPacketSize,
+    OMX_PTR pStruct, OMX_U32 nStructSize, OMX_BOOL bMapInPacket,
+    OMX_BOOL * bInScratch)
+{
+	OMX_U32 nPos = *pPos;
+
+	*bInScratch = OMX_FALSE;
+	if (nPos + nStructSize <= nPacketSize - sizeof(struct omx_packet))
+	{
+		RPC_SETFIELDCOPYGEN(pData, nPos, pStruct, nStructSize);
+		*pPos = nPos;
+		return RPC_OMX_ErrorNone;
+	}
+
+	if (bMapInPacket || hCtx->pStructScratch == NULL ||
+	    nStructSize > hCtx->nStructScratchSize)
+	{
+		DOMX_ERROR("%d byte structure does not fit in a packet",
+		    nStructSize);
+		return RPC_OMX_ErrorBadParameter;
+	}
+
+	pthread_mutex_lock(&hCtx->tScratchLock);
+	TIMM_OSAL_Memcpy(hCtx->pStructScratch, pStruct, nStructSize);
+	RPC_SETFIELDVALUE(pData, nPos, RPC_STRUCT_IN_SCRATCH, OMX_U32);
+	RPC_SETFIELDVALUE(pData, nPos, 0, OMX_U32);
+	RPC_SETFIELDVALUE(pData, nPos, nStructSize, OMX_U32);
+	*pPos = nPos;
+	*bInScratch = OMX_TRUE;
+	return RPC_OMX_ErrorNone;
+}
+
+
 
-#endif
 /* ===========================================================================*/
 /**
  * @name RPC_GetHandle()
@@ -180,14 +243,15 @@ RPC_OMX_ERRORTYPE RPC_GetHandle(OMX_HANDLETYPE hRPCCtx,
 	OMX_S32 status = 0;
 	RPC_OMX_FXN_IDX_TYPE nFxnIdx;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(0);
 
 	DOMX_ENTER("");
 	DOMX_DEBUG("RPC_GetHandle: Recieved GetHandle request from %s",
 	    cComponentName);
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_HANDLE;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	DOMX_DEBUG("Packing data");
 	/*No buffer mapping required */
@@ -229,11 +293,12 @@ RPC_OMX_ERRORTYPE RPC_GetHandle(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -261,12 +326,13 @@ RPC_OMX_ERRORTYPE RPC_FreeHandle(OMX_HANDLETYPE hRPCCtx,
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(0);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_FREE_HANDLE;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
 	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE,
@@ -282,11 +348,12 @@ RPC_OMX_ERRORTYPE RPC_FreeHandle(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 
 }
@@ -319,11 +386,13 @@ RPC_OMX_ERRORTYPE RPC_SetParameter(OMX_HANDLETYPE hRPCCtx,
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	OMX_U32 structSize = 0;
+	OMX_BOOL bInScratch = OMX_FALSE;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(nParamIndex);
 
 	nFxnIdx = RPC_OMX_FXN_IDX_SET_PARAMETER;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if (pLocBufNeedMap != NULL && (pLocBufNeedMap - pCompParam) >= 0 ) {
 		if (nNumOfLocalBuf == 1) {
@@ -348,7 +417,11 @@ RPC_OMX_ERRORTYPE RPC_SetParameter(OMX_HANDLETYPE hRPCCtx,
 	RPC_SETFIELDVALUE(pData, nPos, hComp, OMX_HANDLETYPE);
 	RPC_SETFIELDVALUE(pData, nPos, nParamIndex, OMX_INDEXTYPE);
 	structSize = RPC_UTIL_GETSTRUCTSIZE(pCompParam);
-	RPC_SETFIELDCOPYGEN(pData, nPos, pCompParam, structSize);
+	eRPCError = RPC_StructPut(hCtx, pData, &nPos, nPacketSize, pCompParam,
+	    structSize, pLocBufNeedMap != NULL ? OMX_TRUE : OMX_FALSE,
+	    &bInScratch);
+	RPC_assert(eRPCError == RPC_OMX_ErrorNone, eRPCError,
+	    "Structure not sent");
 
 	RPC_sendPacket_sync(hCtx, pPacket, nPacketSize, nFxnIdx, pRetPacket,
 	    nSize);
@@ -356,12 +429,15 @@ RPC_OMX_ERRORTYPE RPC_SetParameter(OMX_HANDLETYPE hRPCCtx,
 	*eCompReturn = (OMX_ERRORTYPE) (((struct omx_packet *) pRetPacket)->result);
 
       EXIT:
+	if (bInScratch)
+		pthread_mutex_unlock(&hCtx->tScratchLock);
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -393,13 +469,15 @@ RPC_OMX_ERRORTYPE RPC_GetParameter(OMX_HANDLETYPE hRPCCtx,
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	OMX_U32 structSize = 0;
+	OMX_BOOL bInScratch = OMX_FALSE;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(nParamIndex);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_PARAMETER;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if (pLocBufNeedMap != NULL && (pLocBufNeedMap - pCompParam) >= 0 ) {
 		RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_ONE_BUF,
@@ -419,7 +497,11 @@ RPC_OMX_ERRORTYPE RPC_GetParameter(OMX_HANDLETYPE hRPCCtx,
 	RPC_SETFIELDVALUE(pData, nPos, nParamIndex, OMX_INDEXTYPE);
 	nDataOffset = nPos;
 	structSize = RPC_UTIL_GETSTRUCTSIZE(pCompParam);
-	RPC_SETFIELDCOPYGEN(pData, nPos, pCompParam, structSize);
+	eRPCError = RPC_StructPut(hCtx, pData, &nPos, nPacketSize, pCompParam,
+	    structSize, pLocBufNeedMap != NULL ? OMX_TRUE : OMX_FALSE,
+	    &bInScratch);
+	RPC_assert(eRPCError == RPC_OMX_ErrorNone, eRPCError,
+	    "Structure not sent");
 
 	RPC_sendPacket_sync(hCtx, pPacket, nPacketSize, nFxnIdx, pRetPacket,
 	    nSize);
@@ -430,18 +512,25 @@ RPC_OMX_ERRORTYPE RPC_GetParameter(OMX_HANDLETYPE hRPCCtx,
 	{
 		pRetData = ((struct omx_packet *) pRetPacket)->data;
 		/*pCompParam is returned in the same location in which it was sent */
-		RPC_GETFIELDCOPYGEN(pRetData, nDataOffset, pCompParam,
-		    structSize);
+		if (bInScratch)
+			TIMM_OSAL_Memcpy(pCompParam, hCtx->pStructScratch,
+			    structSize);
+		else
+			RPC_GETFIELDCOPYGEN(pRetData, nDataOffset, pCompParam,
+			    structSize);
 	}
 
       EXIT:
+	if (bInScratch)
+		pthread_mutex_unlock(&hCtx->tScratchLock);
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	//In case of Error Hardware this packet gets freed in omx_rpc.c
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -472,13 +561,15 @@ RPC_OMX_ERRORTYPE RPC_SetConfig(OMX_HANDLETYPE hRPCCtx,
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	OMX_U32 structSize = 0;
+	OMX_BOOL bInScratch = OMX_FALSE;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(nConfigIndex);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_SET_CONFIG;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if (pLocBufNeedMap != NULL && (pLocBufNeedMap - pCompConfig) >= 0 ) {
 		RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_ONE_BUF,
@@ -497,19 +588,26 @@ RPC_OMX_ERRORTYPE RPC_SetConfig(OMX_HANDLETYPE hRPCCtx,
 	RPC_SETFIELDVALUE(pData, nPos, hComp, OMX_HANDLETYPE);
 	RPC_SETFIELDVALUE(pData, nPos, nConfigIndex, OMX_INDEXTYPE);
 	structSize = RPC_UTIL_GETSTRUCTSIZE(pCompConfig);
-	RPC_SETFIELDCOPYGEN(pData, nPos, pCompConfig, structSize);
+	eRPCError = RPC_StructPut(hCtx, pData, &nPos, nPacketSize, pCompConfig,
+	    structSize, pLocBufNeedMap != NULL ? OMX_TRUE : OMX_FALSE,
+	    &bInScratch);
+	RPC_assert(eRPCError == RPC_OMX_ErrorNone, eRPCError,
+	    "Structure not sent");
 
 	RPC_sendPacket_sync(hCtx, pPacket, nPacketSize, nFxnIdx, pRetPacket,
 	    nSize);
 	*eCompReturn = (OMX_ERRORTYPE) (((struct omx_packet *) pRetPacket)->result);
 
       EXIT:
+	if (bInScratch)
+		pthread_mutex_unlock(&hCtx->tScratchLock);
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -539,13 +637,15 @@ RPC_OMX_ERRORTYPE RPC_GetConfig(OMX_HANDLETYPE hRPCCtx,
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	OMX_U32 structSize = 0;
+	OMX_BOOL bInScratch = OMX_FALSE;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(nConfigIndex);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_CONFIG;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if (pLocBufNeedMap != NULL && (pLocBufNeedMap - pCompConfig) >= 0 ) {
 		RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_ONE_BUF,
@@ -565,7 +665,11 @@ RPC_OMX_ERRORTYPE RPC_GetConfig(OMX_HANDLETYPE hRPCCtx,
 	RPC_SETFIELDVALUE(pData, nPos, nConfigIndex, OMX_INDEXTYPE);
 	nDataOffset = nPos;
 	structSize = RPC_UTIL_GETSTRUCTSIZE(pCompConfig);
-	RPC_SETFIELDCOPYGEN(pData, nPos, pCompConfig, structSize);
+	eRPCError = RPC_StructPut(hCtx, pData, &nPos, nPacketSize, pCompConfig,
+	    structSize, pLocBufNeedMap != NULL ? OMX_TRUE : OMX_FALSE,
+	    &bInScratch);
+	RPC_assert(eRPCError == RPC_OMX_ErrorNone, eRPCError,
+	    "Structure not sent");
 
 	RPC_sendPacket_sync(hCtx, pPacket, nPacketSize, nFxnIdx, pRetPacket,
 	    nSize);
@@ -576,17 +680,24 @@ RPC_OMX_ERRORTYPE RPC_GetConfig(OMX_HANDLETYPE hRPCCtx,
 	{
 		pRetData = ((struct omx_packet *) pRetPacket)->data;
 		/*pCompParam is returned in the same location in which it was sent */
-		RPC_GETFIELDCOPYGEN(pRetData, nDataOffset, pCompConfig,
-		    structSize);
+		if (bInScratch)
+			TIMM_OSAL_Memcpy(pCompConfig, hCtx->pStructScratch,
+			    structSize);
+		else
+			RPC_GETFIELDCOPYGEN(pRetData, nDataOffset, pCompConfig,
+			    structSize);
 	}
 
       EXIT:
+	if (bInScratch)
+		pthread_mutex_unlock(&hCtx->tScratchLock);
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -619,12 +730,13 @@ RPC_OMX_ERRORTYPE RPC_SendCommand(OMX_HANDLETYPE hRPCCtx,
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	OMX_U32 structSize = 0;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(eCmd);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_SEND_CMD;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
 	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE,
@@ -654,11 +766,12 @@ RPC_OMX_ERRORTYPE RPC_SendCommand(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -689,12 +802,13 @@ RPC_OMX_ERRORTYPE RPC_GetState(OMX_HANDLETYPE hRPCCtx, OMX_STATETYPE * pState,
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(0);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_STATE;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
 	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE,
@@ -716,11 +830,12 @@ RPC_OMX_ERRORTYPE RPC_GetState(OMX_HANDLETYPE hRPCCtx, OMX_STATETYPE * pState,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -760,12 +875,13 @@ RPC_OMX_ERRORTYPE RPC_GetComponentVersion(OMX_HANDLETYPE hRPCCtx,
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(0);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_VERSION;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
 	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE,
@@ -793,10 +909,11 @@ RPC_OMX_ERRORTYPE RPC_GetComponentVersion(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -829,11 +946,12 @@ RPC_OMX_ERRORTYPE RPC_GetExtensionIndex(OMX_HANDLETYPE hRPCCtx,
 	OMX_S32 status = 0;
 	RPC_OMX_FXN_IDX_TYPE nFxnIdx;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(0);
 
 	nFxnIdx = RPC_OMX_FXN_IDX_GET_EXT_INDEX;
 
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
 	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE,
@@ -858,10 +976,11 @@ RPC_OMX_ERRORTYPE RPC_GetExtensionIndex(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
+	DOMX_TRACE_END();
 	return eRPCError;
 
 }
@@ -897,12 +1016,13 @@ RPC_OMX_ERRORTYPE RPC_AllocateBuffer(OMX_HANDLETYPE hRPCCtx,
 	OMX_TI_PLATFORMPRIVATE *pPlatformPrivate = NULL;
 	OMX_BUFFERHEADERTYPE *pBufferHdr = *ppBufferHdr;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(nPortIndex);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_ALLOCATE_BUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
 	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE,
@@ -987,11 +1107,12 @@ RPC_OMX_ERRORTYPE RPC_AllocateBuffer(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -1033,12 +1154,13 @@ RPC_OMX_ERRORTYPE RPC_UseBuffer(OMX_HANDLETYPE hRPCCtx,
 	RPC_OMX_MAP_INFO_TYPE eMapInfo = RPC_OMX_MAP_INFO_NONE;
 	OMX_PTR pMetaDataBuffer = NULL;
 	OMX_U32 a =32;
+	DOMX_TRACE_BEGIN(nPortIndex);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_USE_BUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	DOMX_DEBUG("Marshaling data");
 	/*Buffer mapping required */
@@ -1150,11 +1272,12 @@ RPC_OMX_ERRORTYPE RPC_UseBuffer(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -1183,12 +1306,13 @@ RPC_OMX_ERRORTYPE RPC_FreeBuffer(OMX_HANDLETYPE hRPCCtx,
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	struct omx_packet *pOmxPacket = NULL;
+	DOMX_TRACE_BEGIN(BufHdrRemote);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_FREE_BUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*Offset is the location of the buffer pointer from the start of the data packet */
 	nOffset =  sizeof(RPC_OMX_MAP_INFO_TYPE) + sizeof(OMX_U32) +
@@ -1212,11 +1336,12 @@ RPC_OMX_ERRORTYPE RPC_FreeBuffer(OMX_HANDLETYPE hRPCCtx,
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -1248,17 +1373,30 @@ RPC_OMX_ERRORTYPE RPC_EmptyThisBuffer(OMX_HANDLETYPE hRPCCtx,
 	OMX_U8 *pAuxBuf1 = NULL;
 	struct omx_packet *pOmxPacket = NULL;
 	RPC_OMX_MAP_INFO_TYPE eMapInfo = RPC_OMX_MAP_INFO_NONE;
+	TIMM_OSAL_PTR pPacket = NULL, pData = NULL;
+	OMX_BOOL bMapOnce = OMX_FALSE, bRemoteMapped = OMX_FALSE;
+	OMX_U32 nMapId = 0;
 #ifdef RPC_SYNC_MODE
-	TIMM_OSAL_PTR pPacket = NULL, pRetPacket = NULL, pData = NULL;
+	TIMM_OSAL_PTR pRetPacket = NULL;
 #endif
+	DOMX_TRACE_BEGIN(BufHdrRemote);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_EMPTYTHISBUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	if(bMapBuffer == OMX_TRUE)
+	{
+		/*In map-once mode the map id follows the header fields and the
+		  buffer pointers are only sent until the remote side has them */
+		bMapOnce = hCtx->bMapOnce;
+		if (bMapOnce)
+			nMapId = RPC_RegCacheMapId(hCtx, pBufferHdr->pBuffer,
+			    &bRemoteMapped);
+	}
+	if(bMapBuffer == OMX_TRUE && !bRemoteMapped)
 	{
 		pAuxBuf1 = ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1;
 		/*Buffer mapping required */
@@ -1271,6 +1409,8 @@ RPC_OMX_ERRORTYPE RPC_EmptyThisBuffer(OMX_HANDLETYPE hRPCCtx,
 	    		sizeof(RPC_OMX_MAP_INFO_TYPE) + sizeof(OMX_U32) +
 	   		sizeof(OMX_HANDLETYPE) + sizeof(OMX_BUFFERHEADERTYPE *) + 3*sizeof(OMX_U32) +
 			sizeof(OMX_TICKS) + sizeof(OMX_HANDLETYPE) + sizeof(OMX_PTR) + 3*sizeof(OMX_U32);
+		if (bMapOnce)
+			nOffset += sizeof(OMX_U32);
 	}
 
 	RPC_SETFIELDVALUE(pData, nPos, eMapInfo, RPC_OMX_MAP_INFO_TYPE);
@@ -1292,7 +1432,11 @@ RPC_OMX_ERRORTYPE RPC_EmptyThisBuffer(OMX_HANDLETYPE hRPCCtx,
 	RPC_SETFIELDVALUE(pData, nPos, pBufferHdr->nOutputPortIndex, OMX_U32);
 	RPC_SETFIELDVALUE(pData, nPos, pBufferHdr->nInputPortIndex, OMX_U32);
 
-	if(bMapBuffer == OMX_TRUE)
+	/*0 if the buffer is not cached, the remote side maps it for this call */
+	if (bMapOnce)
+		RPC_SETFIELDVALUE(pData, nPos, nMapId, OMX_U32);
+
+	if(eMapInfo != RPC_OMX_MAP_INFO_NONE)
 	{
 		RPC_SETFIELDVALUE(pData, nPos, pBufferHdr->pBuffer, OMX_U32);
 		if (eMapInfo == RPC_OMX_MAP_INFO_TWO_BUF)
@@ -1311,20 +1455,21 @@ RPC_OMX_ERRORTYPE RPC_EmptyThisBuffer(OMX_HANDLETYPE hRPCCtx,
 
 	*eCompReturn = (OMX_ERRORTYPE) (((struct omx_packet *) pRetPacket)->result);
 #else
-	RPC_sendPacket_async(hCtx->ClientHndl[RCM_DEFAULT_CLIENT], pPacket,
-	    nFxnIdx);
-	RPC_checkAsyncErrors(hCtx->ClientHndl[RCM_DEFAULT_CLIENT], pPacket);
+	RPC_sendPacket_async(hCtx, pPacket, nPacketSize);
 
 	*eCompReturn = OMX_ErrorNone;
 #endif
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
+#ifdef RPC_SYNC_MODE
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
+#endif
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -1354,15 +1499,17 @@ RPC_OMX_ERRORTYPE RPC_FillThisBuffer(OMX_HANDLETYPE hRPCCtx,
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
 	OMX_U8 *pAuxBuf1 = NULL;
 	struct omx_packet *pOmxPacket = NULL;
+	TIMM_OSAL_PTR pPacket = NULL, pData = NULL;
 #ifdef RPC_SYNC_MODE
-	TIMM_OSAL_PTR pPacket = NULL, pRetPacket = NULL, pData = NULL;
+	TIMM_OSAL_PTR pRetPacket = NULL;
 #endif
+	DOMX_TRACE_BEGIN(BufHdrRemote);
 
 	DOMX_ENTER("");
 
 	nFxnIdx = RPC_OMX_FXN_IDX_FILLTHISBUFFER;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
 
 	/*No buffer mapping required */
 	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE,
@@ -1390,20 +1537,21 @@ RPC_OMX_ERRORTYPE RPC_FillThisBuffer(OMX_HANDLETYPE hRPCCtx,
 	*eCompReturn = (OMX_ERRORTYPE) (((struct omx_packet *) pRetPacket)->result);
 
 #else
-	RPC_sendPacket_async(hCtx->ClientHndl[RCM_DEFAULT_CLIENT], pPacket,
-	    nFxnIdx);
-	RPC_checkAsyncErrors(hCtx->ClientHndl[RCM_DEFAULT_CLIENT], pPacket);
+	RPC_sendPacket_async(hCtx, pPacket, nPacketSize);
 
 	*eCompReturn = OMX_ErrorNone;
 #endif
 
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
+		RPC_freePacket(hCtx, pPacket);
+#ifdef RPC_SYNC_MODE
 	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pRetPacket);
+#endif
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
 }
 
@@ -1447,43 +1595,71 @@ RPC_OMX_ERRORTYPE RPC_ComponentTunnelRequest(OMX_HANDLETYPE hRPCCtx,
 	OMX_U32 nPacketSize = RPC_PACKET_SIZE;
 	RPC_OMX_CONTEXT *hCtx = hRPCCtx;
 	OMX_HANDLETYPE hComp = hCtx->hRemoteHandle;
-       RPC_OMX_CONTEXT   *hTunneledCtx    = hTunneledRemoteHandle;
-        OMX_HANDLETYPE     hTunneledComp   = hTunneledCtx->hRemoteHandle;
+	RPC_OMX_CONTEXT *hTunneledCtx = hTunneledRemoteHandle;
+	OMX_HANDLETYPE hTunneledComp = NULL;
+	OMX_U32 nTunnelFlags = 0;
+	OMX_BUFFERSUPPLIERTYPE eSupplier = OMX_BufferSupplyUnspecified;
 	RPC_OMX_FXN_IDX_TYPE nFxnIdx;
 	struct omx_packet *pOmxPacket = NULL;
 	OMX_U32 nPos = 0, nSize = 0, nOffset = 0;
 	OMX_S32 status = 0;
-#ifdef RPC_SYNC_MODE
-	TIMM_OSAL_PTR pPacket = NULL, pRetPacket = NULL, pData = NULL;
-#endif
+	TIMM_OSAL_PTR pPacket = NULL, pRetPacket = NULL, pData = NULL,
+	    pRetData = NULL;
+	DOMX_TRACE_BEGIN(nPort);
+
+	DOMX_ENTER("");
 
-        printf(" Entering rpc:domx_stub.c:ComponentTunnelRequest\n");
+	/*A NULL tunneled component tears the tunnel of nPort down */
+	if (hTunneledCtx != NULL)
+		hTunneledComp = hTunneledCtx->hRemoteHandle;
+	if (pTunnelSetup != NULL)
+	{
+		nTunnelFlags = pTunnelSetup->nTunnelFlags;
+		eSupplier = pTunnelSetup->eSupplier;
+	}
 
 	nFxnIdx = RPC_OMX_FXN_IDX_COMP_TUNNEL_REQUEST;
-	RPC_getPacket(nPacketSize, pPacket);
-	RPC_initPacket(pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
-
-        /*Pack the values into a packet*/
-        //Marshalled:[>ParentComp|>ParentPort|>TunnelComp|>TunneledPort>TunnelSetup]
-	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE, RPC_OMX_MAP_INFO_TYPE);
-        RPC_SETFIELDVALUE(pData, nPos, hComp, OMX_HANDLETYPE);
-        RPC_SETFIELDVALUE(pData, nPos, nPort, OMX_U32);
-        RPC_SETFIELDVALUE(pData, nPos, hTunneledComp, OMX_HANDLETYPE);
-        RPC_SETFIELDVALUE(pData, nPos, nTunneledPort, OMX_U32);
-        printf("\n after RPC_sendPacket_sync");
+	RPC_getPacket(hCtx, nPacketSize, pPacket);
+	RPC_initPacket(hCtx, pPacket, pOmxPacket, pData, nFxnIdx, nPacketSize);
+
+	/*Pack the values into a packet*/
+	//Marshalled:[>ParentComp|>ParentPort|>TunnelComp|>TunneledPort>TunnelSetup]
+	/*No buffer mapping required */
+	RPC_SETFIELDVALUE(pData, nPos, RPC_OMX_MAP_INFO_NONE,
+	    RPC_OMX_MAP_INFO_TYPE);
+	RPC_SETFIELDVALUE(pData, nPos, nOffset, OMX_U32);
+
+	RPC_SETFIELDVALUE(pData, nPos, hComp, OMX_HANDLETYPE);
+	RPC_SETFIELDVALUE(pData, nPos, nPort, OMX_U32);
+	RPC_SETFIELDVALUE(pData, nPos, hTunneledComp, OMX_HANDLETYPE);
+	RPC_SETFIELDVALUE(pData, nPos, nTunneledPort, OMX_U32);
+	RPC_SETFIELDVALUE(pData, nPos, nTunnelFlags, OMX_U32);
+	RPC_SETFIELDVALUE(pData, nPos, eSupplier, OMX_BUFFERSUPPLIERTYPE);
+
 	RPC_sendPacket_sync(hCtx, pPacket, nPacketSize, nFxnIdx, pRetPacket,
 	    nSize);
 
-        printf("\n after RPC_sendPacket_sync: *eCompReturn : 0x%x\n", (OMX_ERRORTYPE) (((struct omx_packet *) pRetPacket)->result));
 	*eCompReturn = (OMX_ERRORTYPE) (((struct omx_packet *) pRetPacket)->result);
 
+	if (*eCompReturn == OMX_ErrorNone && pTunnelSetup != NULL)
+	{
+		/*The output side tells the input side what it negotiated */
+		pRetData = ((struct omx_packet *) pRetPacket)->data;
+		nPos = 0;
+		RPC_GETFIELDVALUE(pRetData, nPos, nTunnelFlags, OMX_U32);
+		RPC_GETFIELDVALUE(pRetData, nPos, eSupplier,
+		    OMX_BUFFERSUPPLIERTYPE);
+		pTunnelSetup->nTunnelFlags = nTunnelFlags;
+		pTunnelSetup->eSupplier = eSupplier;
+	}
+
       EXIT:
 	if (pPacket)
-		RPC_freePacket(pPacket);
-	if (pRetPacket)
-		RPC_freePacket(pRetPacket);
+		RPC_freePacket(hCtx, pPacket);
+	if (pRetPacket && *eCompReturn != OMX_ErrorHardware)
+		RPC_freePacket(hCtx, pRetPacket);
 
 	DOMX_EXIT("");
+	DOMX_TRACE_END();
 	return eRPCError;
-
 }
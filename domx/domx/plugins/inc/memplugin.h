@@ -114,6 +114,40 @@ MEMPLUGIN_BUFFER_ACCESSOR sBuffer_accessor;
 OMX_U32 nStride;
 }MEMPLUGIN_BUFFER_PROPERTIES;
 
+/**
+ * MEMPLUGIN_CONFIG: generic configuration handed to MemPlugin_Configure. Every
+ * field left at MEMPLUGIN_CONFIG_KEEP leaves that setting of the plugin alone.
+ *
+ * @param nClient:        client the reserved buffers are allocated for
+ * @param nHeapMask:      heap(s) DEFAULT buffers are allocated from
+ * @param nAlign:         alignment of DEFAULT buffers
+ * @param nRecycleLimit:  bytes of freed buffers the plugin may keep around
+ *                        for reuse, 0 disables recycling
+ * @param nReserveCount:  number of buffers described by sReserveParams to
+ *                        allocate up front. They are kept by the plugin when
+ *                        freed and only released when the client is closed
+ * @param sReserveParams: buffer params of the reserved buffers
+ */
+typedef struct MEMPLUGIN_CONFIG
+{
+OMX_U32 nClient;
+OMX_U32 nHeapMask;
+OMX_U32 nAlign;
+OMX_U32 nRecycleLimit;
+OMX_U32 nReserveCount;
+MEMPLUGIN_BUFFER_PARAMS sReserveParams;
+}MEMPLUGIN_CONFIG;
+
+#define MEMPLUGIN_CONFIG_KEEP ((OMX_U32)-1)
+
+#define MEMPLUGIN_CONFIG_INIT(MEMPLUGIN_config) do {\
+        (MEMPLUGIN_config).nClient = 0;\
+        (MEMPLUGIN_config).nHeapMask = MEMPLUGIN_CONFIG_KEEP;\
+        (MEMPLUGIN_config).nAlign = MEMPLUGIN_CONFIG_KEEP;\
+        (MEMPLUGIN_config).nRecycleLimit = MEMPLUGIN_CONFIG_KEEP;\
+        (MEMPLUGIN_config).nReserveCount = 0;\
+} while(0)
+
 /***************************************************************
  * PART 2
  * PLUGIN INTERFACE RELATED TYPE AND METHOD DEFINITIONS
@@ -125,6 +159,7 @@ OMX_U32 nStride;
 /** @struct MEMPLUGIN_OBJECT - comprises of all plugin related data including:
  *
  * pPluginExtendedInfo - plugin specific extended data structure
+ * pPluginPrivate - plugin internal state, not to be touched by users
  * fpOpen - function pointer interface to Plugin Open()
  * fpAlloc - function pointer interface to Plugin Allocation method
  * fpFree - function pointer interface to Plugin Freeing method
@@ -134,6 +169,7 @@ OMX_U32 nStride;
 typedef struct MEMPLUGIN_OBJECT
 {
     OMX_PTR pPluginExtendedInfo;
+    OMX_PTR pPluginPrivate;
     MEMPLUGIN_ERRORTYPE (*fpConfig)(void *pMemPluginHandle,
                                     void *pConfigData);
     MEMPLUGIN_ERRORTYPE (*fpOpen)(void *pMemPluginHandle,
@@ -155,10 +191,20 @@ typedef MEMPLUGIN_ERRORTYPE (*MEMPLUGIN_CONFIGTYPE)(MEMPLUGIN_OBJECT **);
 
 typedef struct MEMPLUGIN_TABLETYPE
 {
-    char cMemPluginName[50];
+    char *cMemPluginName;
     MEMPLUGIN_CONFIGTYPE pMemPluginConfig;
 }MEMPLUGIN_TABLETYPE;
 
+/** @struct MEMPLUGIN_COMPONENT_CONFIGTYPE - plugin configuration applied to
+ * every component whose name starts with cComponentPrefix, see
+ * MemPlugin_ConfigureComponent. nClient of sConfig is filled in at runtime.
+ */
+typedef struct MEMPLUGIN_COMPONENT_CONFIGTYPE
+{
+    char *cComponentPrefix;
+    MEMPLUGIN_CONFIG sConfig;
+}MEMPLUGIN_COMPONENT_CONFIGTYPE;
+
 /******************************************************************
  *   FUNCTIONS DEFINITION
  ******************************************************************/
@@ -182,6 +228,18 @@ typedef struct MEMPLUGIN_TABLETYPE
   */
  MEMPLUGIN_ERRORTYPE MemPlugin_Configure(void *pMemPluginHandle,
                                             void *pConfigData);
+ /*MemPlugin_ConfigureComponent: To apply the configurations listed for
+  *                     a component in MemPlugins_ComponentConfig.
+  *                     Called once the client is open.
+  *
+  * @param pMemPluginHandle: handle that provides access for APIs
+  *                          corresponding to the plugin
+  * @param nClient: MemPlugin client of the component
+  * @param cComponentName: name of the component
+  */
+ MEMPLUGIN_ERRORTYPE MemPlugin_ConfigureComponent(void *pMemPluginHandle,
+                                            OMX_U32 nClient,
+                                            char *cComponentName);
  /*MemPlugin_Open: To open and obtain a client for the MemPlugin
   *
   * @param pMemPluginHandle: handle that provides access for APIs
@@ -90,7 +90,8 @@ MEMPLUGIN_ERRORTYPE MemPlugin_ION_Init(void **pMemPluginHandle);
   *
   * @param pMemPluginHandle: handle that provides access for APIs
   *                          corresponding to the plugin
-  * @param pConfigData: data specific to configuration to be done
+  * @param pConfigData: MEMPLUGIN_CONFIG, nHeapMask and nAlign map to
+  *                     alloc_flags and nAlign of MEMPLUGIN_ION_PARAMS
   */
 MEMPLUGIN_ERRORTYPE MemPlugin_ION_Configure(void *pMemPluginHandle,
                                         void *pConfigData);
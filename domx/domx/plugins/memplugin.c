@@ -47,11 +47,12 @@
 #include "omx_rpc_utils.h"
 
 extern MEMPLUGIN_TABLETYPE    MemPlugins_Map[];
+extern MEMPLUGIN_COMPONENT_CONFIGTYPE    MemPlugins_ComponentConfig[];
 
 MEMPLUGIN_ERRORTYPE MemPlugin_Init(char *cMemPluginName, void **pMemPluginHandle)
 {
     MEMPLUGIN_OBJECT *pMemPluginHdl;
-    OMX_BOOL bFound;
+    OMX_BOOL bFound = OMX_FALSE;
     OMX_U16 i = 0;
     MEMPLUGIN_ERRORTYPE eError = MEMPLUGIN_ERROR_NONE;
 
@@ -165,9 +166,65 @@ EXIT:
 }
 MEMPLUGIN_ERRORTYPE MemPlugin_Configure(void *pMemPluginHandle, void *pConfigData)
 {
-    //implementation to be added later
+    MEMPLUGIN_ERRORTYPE eError = MEMPLUGIN_ERROR_NONE;
+
+    if(pMemPluginHandle == NULL || pConfigData == NULL)
+    {
+        eError = MEMPLUGIN_ERROR_BADPARAMETER;
+        DOMX_ERROR("%s: Invalid parameter to function",__FUNCTION__);
+        goto EXIT;
+    }
+    eError = ((MEMPLUGIN_OBJECT *)pMemPluginHandle)->fpConfig(pMemPluginHandle,pConfigData);
 EXIT:
-    return(MEMPLUGIN_ERROR_NONE);
+    if(eError != MEMPLUGIN_ERROR_NONE)
+    {
+        DOMX_EXIT("%s: failed with error %d",__FUNCTION__,eError);
+    }
+    else
+    {
+        DOMX_EXIT("%s: executed successfully",__FUNCTION__);
+    }
+    return eError;
+}
+
+MEMPLUGIN_ERRORTYPE MemPlugin_ConfigureComponent(void *pMemPluginHandle, OMX_U32 nClient,
+                                    char *cComponentName)
+{
+    MEMPLUGIN_ERRORTYPE eError = MEMPLUGIN_ERROR_NONE;
+    MEMPLUGIN_CONFIG sConfig;
+    OMX_U16 i = 0;
+
+    if(pMemPluginHandle == NULL || cComponentName == NULL)
+    {
+        eError = MEMPLUGIN_ERROR_BADPARAMETER;
+        DOMX_ERROR("%s: Invalid parameter to function",__FUNCTION__);
+        goto EXIT;
+    }
+    for(i = 0; MemPlugins_ComponentConfig[i].cComponentPrefix != NULL; i++)
+    {
+        if(strncmp(cComponentName, MemPlugins_ComponentConfig[i].cComponentPrefix,
+                   strlen(MemPlugins_ComponentConfig[i].cComponentPrefix)) != 0)
+        {
+            continue;
+        }
+        sConfig = MemPlugins_ComponentConfig[i].sConfig;
+        sConfig.nClient = nClient;
+        eError = MemPlugin_Configure(pMemPluginHandle, &sConfig);
+        if(eError != MEMPLUGIN_ERROR_NONE)
+        {
+            goto EXIT;
+        }
+    }
+EXIT:
+    if(eError != MEMPLUGIN_ERROR_NONE)
+    {
+        DOMX_EXIT("%s: failed with error %d",__FUNCTION__,eError);
+    }
+    else
+    {
+        DOMX_EXIT("%s: executed successfully",__FUNCTION__);
+    }
+    return eError;
 }
 
 MEMPLUGIN_ERRORTYPE MemPlugin_Alloc(void *pMemPluginHandle, OMX_U32 nClient,
@@ -31,14 +31,19 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
 #include "memplugin_ion.h"
 #include <timm_osal_types.h>
 #include <timm_osal_memory.h>
+#include <timm_osal_mutex.h>
 #include <timm_osal_trace.h>
 #include "omx_rpc_utils.h"
+#ifdef _Android
+#include <cutils/properties.h>
+#endif
 
 /******************************************************************
  *   MACROS DEFINITION
@@ -51,11 +56,187 @@
         ion_params_dest.nOffset =  ion_params_src->nOffset ;\
 }while(0)
 
+/* Buffers freed by the proxy are kept mapped/shared for reuse up to this many
+ * KB per plugin object. Can be overridden with debug.domx.ion_cache_kb,
+ * 0 disables the cache */
+#define MEMPLUGIN_ION_CACHE_DEFAULT_KB 32768
+/* Free buffers are bucketed by buffer type and by log2 of their size */
+#define MEMPLUGIN_ION_CACHE_SIZE_CLASSES 16
+#define MEMPLUGIN_ION_CACHE_BUCKETS ((TILER2D + 1) * MEMPLUGIN_ION_CACHE_SIZE_CLASSES)
+
+/* struct MEMPLUGIN_ION_BUFFER : one buffer allocated through the plugin
+ * @param sReqParams: buffer params as requested, used as the cache key
+ * @param sIonParams: ION params in effect for the request, part of the key
+ * @param sParams: buffer params the buffer was really allocated with
+ * @param sProp: buffer properties returned for the buffer
+ * @param nStamp: time of release, oldest free buffers are trimmed first
+ * @param bReserved: reserved through MemPlugin_ION_Configure, always goes
+ *                   back to the cache and is only freed with its client
+ */
+typedef struct MEMPLUGIN_ION_BUFFER {
+    struct MEMPLUGIN_ION_BUFFER *pNext;
+    OMX_U32 nClient;
+    MEMPLUGIN_BUFFER_PARAMS sReqParams;
+    MEMPLUGIN_ION_PARAMS sIonParams;
+    MEMPLUGIN_BUFFER_PARAMS sParams;
+    MEMPLUGIN_BUFFER_PROPERTIES sProp;
+    OMX_U32 nStamp;
+    OMX_BOOL bReserved;
+}MEMPLUGIN_ION_BUFFER;
+
+/* struct MEMPLUGIN_ION_CACHE : recycling cache of an ION plugin object
+ * @param pLock: protects everything below
+ * @param pInUse: buffers handed out by MemPlugin_ION_Alloc
+ * @param pFree: freed buffers kept for reuse, most recent first
+ * @param nCachedBytes: total size of the buffers in pFree, reserved buffers
+ *                      are not counted
+ * @param nHighWater: pFree is trimmed to stay below this many bytes
+ */
+typedef struct MEMPLUGIN_ION_CACHE {
+    OMX_PTR pLock;
+    MEMPLUGIN_ION_BUFFER *pInUse;
+    MEMPLUGIN_ION_BUFFER *pFree[MEMPLUGIN_ION_CACHE_BUCKETS];
+    OMX_U32 nCachedBytes;
+    OMX_U32 nHighWater;
+    OMX_U32 nStamp;
+}MEMPLUGIN_ION_CACHE;
+
+static MEMPLUGIN_ERRORTYPE MemPlugin_ION_AllocBuffer(void *pMemPluginHandle, OMX_U32 nClient,
+                                    MEMPLUGIN_BUFFER_PARAMS *pIonBufferParams,
+                                    MEMPLUGIN_BUFFER_PROPERTIES *pIonBufferProp);
+static MEMPLUGIN_ERRORTYPE MemPlugin_ION_FreeBuffer(OMX_U32 nClient,
+                                    MEMPLUGIN_BUFFER_PARAMS *pIonBufferParams,
+                                    MEMPLUGIN_BUFFER_PROPERTIES *pIonBufferProp);
+
+/* Bytes spanned by a buffer. 2D TILER buffers are laid out with the stride
+ * returned by the allocation, everything else is nWidth * nHeight bytes */
+static OMX_U32 MemPlugin_ION_BufferSize(MEMPLUGIN_BUFFER_PARAMS *pParams,
+                                    MEMPLUGIN_BUFFER_PROPERTIES *pProp)
+{
+    if(pParams->eBuffer_type == TILER2D)
+    {
+        return pProp->nStride * pParams->nHeight;
+    }
+    return pParams->nWidth * pParams->nHeight;
+}
+
+static OMX_U32 MemPlugin_ION_CacheBucket(MEMPLUGIN_BUFFER_PARAMS *pParams)
+{
+    OMX_U32 nSize = pParams->nWidth * pParams->nHeight;
+    OMX_U32 nClass = 0;
+
+    /* Size classes start at one page */
+    nSize >>= 12;
+    while(nSize > 1 && nClass < MEMPLUGIN_ION_CACHE_SIZE_CLASSES - 1)
+    {
+        nSize >>= 1;
+        nClass++;
+    }
+    return (pParams->eBuffer_type % (TILER2D + 1)) * MEMPLUGIN_ION_CACHE_SIZE_CLASSES + nClass;
+}
+
+static OMX_U32 MemPlugin_ION_CacheConfig(void)
+{
+    char *val = getenv("DEBUG_DOMX_ION_CACHE_KB");
+
+    if(val)
+    {
+        return strtoul(val, NULL, 0) * 1024;
+    }
+#ifdef _Android
+    {
+        char value[PROPERTY_VALUE_MAX];
+
+        if(property_get("debug.domx.ion_cache_kb", value, NULL) > 0)
+        {
+            return strtoul(value, NULL, 0) * 1024;
+        }
+    }
+#endif
+    return MEMPLUGIN_ION_CACHE_DEFAULT_KB * 1024;
+}
+
+/* ION params the next allocation will use. Zeroed first as they are compared
+ * with memcmp */
+static void MemPlugin_ION_CurrentParams(MEMPLUGIN_OBJECT *pMemPluginHdl,
+                                    MEMPLUGIN_ION_PARAMS *pIonParams)
+{
+    TIMM_OSAL_Memset(pIonParams, 0, sizeof(MEMPLUGIN_ION_PARAMS));
+    if(pMemPluginHdl->pPluginExtendedInfo == NULL)
+    {
+        MEMPLUGIN_ION_PARAMS_INIT(pIonParams);
+    }
+    else
+    {
+        MEMPLUGIN_ION_PARAMS_COPY(((MEMPLUGIN_ION_PARAMS *)pMemPluginHdl->pPluginExtendedInfo),(*pIonParams));
+    }
+}
+
+/* Takes the oldest free buffers, of nClient only if it is non zero, out of
+ * the cache until at most nLimit bytes stay cached. With bReserved reserved
+ * buffers are taken as well and nLimit is ignored. Called with the cache lock
+ * held, returns the buffers taken linked through pNext. They are really freed
+ * with MemPlugin_ION_FreeList once the lock is released */
+static MEMPLUGIN_ION_BUFFER *MemPlugin_ION_CacheTrim(MEMPLUGIN_ION_CACHE *pCache, OMX_U32 nClient,
+                                    OMX_U32 nLimit, OMX_BOOL bReserved)
+{
+    MEMPLUGIN_ION_BUFFER **ppOldest, **ppEntry, *pEntry, *pTrimmed = NULL;
+    OMX_U32 i;
+
+    while(bReserved || pCache->nCachedBytes > nLimit)
+    {
+        ppOldest = NULL;
+        for(i = 0; i < MEMPLUGIN_ION_CACHE_BUCKETS; i++)
+        {
+            for(ppEntry = &pCache->pFree[i]; *ppEntry != NULL; ppEntry = &(*ppEntry)->pNext)
+            {
+                if((nClient != 0 && (*ppEntry)->nClient != nClient) ||
+                   ((*ppEntry)->bReserved && !bReserved))
+                {
+                    continue;
+                }
+                if(ppOldest == NULL || (OMX_S32)((*ppEntry)->nStamp - (*ppOldest)->nStamp) < 0)
+                {
+                    ppOldest = ppEntry;
+                }
+            }
+        }
+        if(ppOldest == NULL)
+        {
+            break;
+        }
+        pEntry = *ppOldest;
+        *ppOldest = pEntry->pNext;
+        if(!pEntry->bReserved)
+        {
+            pCache->nCachedBytes -= MemPlugin_ION_BufferSize(&pEntry->sParams, &pEntry->sProp);
+        }
+        pEntry->pNext = pTrimmed;
+        pTrimmed = pEntry;
+    }
+    return pTrimmed;
+}
+
+/* Unmaps and frees buffers taken out of the cache by MemPlugin_ION_CacheTrim */
+static void MemPlugin_ION_FreeList(MEMPLUGIN_ION_BUFFER *pList)
+{
+    MEMPLUGIN_ION_BUFFER *pEntry;
+
+    while(pList != NULL)
+    {
+        pEntry = pList;
+        pList = pEntry->pNext;
+        MemPlugin_ION_FreeBuffer(pEntry->nClient, &pEntry->sParams, &pEntry->sProp);
+        TIMM_OSAL_Free(pEntry);
+    }
+}
+
 
 MEMPLUGIN_ERRORTYPE MemPlugin_ION_Init(void **pMemPluginHandle)
 {
     MEMPLUGIN_ERRORTYPE    eError = MEMPLUGIN_ERROR_NONE;
     MEMPLUGIN_OBJECT      *pMemPluginHdl;
+    MEMPLUGIN_ION_CACHE   *pCache;
 
     pMemPluginHdl = TIMM_OSAL_MallocExtn(sizeof(MEMPLUGIN_OBJECT), TIMM_OSAL_TRUE,
                                       0, TIMMOSAL_MEM_SEGMENT_EXT, NULL);
@@ -68,6 +249,27 @@ MEMPLUGIN_ERRORTYPE MemPlugin_ION_Init(void **pMemPluginHandle)
 
     TIMM_OSAL_Memset(pMemPluginHdl, 0, sizeof(MEMPLUGIN_OBJECT));
 
+    pCache = TIMM_OSAL_MallocExtn(sizeof(MEMPLUGIN_ION_CACHE), TIMM_OSAL_TRUE,
+                                      0, TIMMOSAL_MEM_SEGMENT_EXT, NULL);
+    if(pCache == NULL)
+    {
+        eError = MEMPLUGIN_ERROR_NORESOURCES;
+        DOMX_ERROR("%s: cache allocation failed",__FUNCTION__);
+        TIMM_OSAL_Free(pMemPluginHdl);
+        goto EXIT;
+    }
+    TIMM_OSAL_Memset(pCache, 0, sizeof(MEMPLUGIN_ION_CACHE));
+    if(TIMM_OSAL_MutexCreate(&pCache->pLock) != TIMM_OSAL_ERR_NONE)
+    {
+        eError = MEMPLUGIN_ERROR_NORESOURCES;
+        DOMX_ERROR("%s: cache lock creation failed",__FUNCTION__);
+        TIMM_OSAL_Free(pCache);
+        TIMM_OSAL_Free(pMemPluginHdl);
+        goto EXIT;
+    }
+    pCache->nHighWater = MemPlugin_ION_CacheConfig();
+    pMemPluginHdl->pPluginPrivate = pCache;
+
     pMemPluginHdl->fpOpen = MemPlugin_ION_Open;
     pMemPluginHdl->fpClose = MemPlugin_ION_Close;
     pMemPluginHdl->fpConfig = MemPlugin_ION_Configure;
@@ -118,6 +320,28 @@ EXIT:
 MEMPLUGIN_ERRORTYPE MemPlugin_ION_Close(void *pMemPluginHandle, OMX_U32 nClient)
 {
     MEMPLUGIN_ERRORTYPE    eError = MEMPLUGIN_ERROR_NONE;
+    MEMPLUGIN_ION_CACHE   *pCache = ((MEMPLUGIN_OBJECT *)pMemPluginHandle)->pPluginPrivate;
+    MEMPLUGIN_ION_BUFFER **ppEntry, *pEntry, *pTrimmed;
+
+    //cached buffers cannot outlive their client, buffers still in use go with it
+    TIMM_OSAL_MutexObtain(pCache->pLock, TIMM_OSAL_SUSPEND);
+    pTrimmed = MemPlugin_ION_CacheTrim(pCache, nClient, 0, OMX_TRUE);
+    ppEntry = &pCache->pInUse;
+    while(*ppEntry != NULL)
+    {
+        pEntry = *ppEntry;
+        if(pEntry->nClient == nClient)
+        {
+            *ppEntry = pEntry->pNext;
+            TIMM_OSAL_Free(pEntry);
+        }
+        else
+        {
+            ppEntry = &pEntry->pNext;
+        }
+    }
+    TIMM_OSAL_MutexRelease(pCache->pLock);
+    MemPlugin_ION_FreeList(pTrimmed);
 
     ion_close(nClient);
 
@@ -126,18 +350,92 @@ EXIT:
 }
 MEMPLUGIN_ERRORTYPE MemPlugin_ION_Configure(void *pMemPluginHandle, void *pConfigData)
 {
-    //implementation to be added later
+    MEMPLUGIN_ERRORTYPE eError = MEMPLUGIN_ERROR_NONE;
+    MEMPLUGIN_OBJECT    *pMemPluginHdl = (MEMPLUGIN_OBJECT *)pMemPluginHandle;
+    MEMPLUGIN_ION_CACHE *pCache = pMemPluginHdl->pPluginPrivate;
+    MEMPLUGIN_CONFIG    *pConfig = (MEMPLUGIN_CONFIG *)pConfigData;
+    MEMPLUGIN_ION_PARAMS *pIonParams = (MEMPLUGIN_ION_PARAMS *)pMemPluginHdl->pPluginExtendedInfo;
+    MEMPLUGIN_ION_BUFFER *pEntry, *pTrimmed;
+    OMX_U32 i, nBucket;
+
+    if(pConfig->nHeapMask != MEMPLUGIN_CONFIG_KEEP || pConfig->nAlign != MEMPLUGIN_CONFIG_KEEP)
+    {
+        if(pIonParams == NULL)
+        {
+            pIonParams = TIMM_OSAL_MallocExtn(sizeof(MEMPLUGIN_ION_PARAMS), TIMM_OSAL_TRUE,
+                                      0, TIMMOSAL_MEM_SEGMENT_EXT, NULL);
+            if(pIonParams == NULL)
+            {
+                eError = MEMPLUGIN_ERROR_NORESOURCES;
+                DOMX_ERROR("%s: allocation failed",__FUNCTION__);
+                goto EXIT;
+            }
+            MEMPLUGIN_ION_PARAMS_INIT(pIonParams);
+            pMemPluginHdl->pPluginExtendedInfo = pIonParams;
+        }
+        if(pConfig->nHeapMask != MEMPLUGIN_CONFIG_KEEP)
+        {
+            pIonParams->alloc_flags = pConfig->nHeapMask;
+        }
+        if(pConfig->nAlign != MEMPLUGIN_CONFIG_KEEP)
+        {
+            pIonParams->nAlign = pConfig->nAlign;
+        }
+    }
+
+    if(pConfig->nRecycleLimit != MEMPLUGIN_CONFIG_KEEP)
+    {
+        TIMM_OSAL_MutexObtain(pCache->pLock, TIMM_OSAL_SUSPEND);
+        pCache->nHighWater = pConfig->nRecycleLimit;
+        pTrimmed = MemPlugin_ION_CacheTrim(pCache, 0, pCache->nHighWater, OMX_FALSE);
+        TIMM_OSAL_MutexRelease(pCache->pLock);
+        MemPlugin_ION_FreeList(pTrimmed);
+    }
+
+    //reserved buffers are allocated once and parked in the cache right away
+    for(i = 0; i < pConfig->nReserveCount; i++)
+    {
+        pEntry = TIMM_OSAL_MallocExtn(sizeof(MEMPLUGIN_ION_BUFFER), TIMM_OSAL_TRUE,
+                                      0, TIMMOSAL_MEM_SEGMENT_EXT, NULL);
+        if(pEntry == NULL)
+        {
+            eError = MEMPLUGIN_ERROR_NORESOURCES;
+            DOMX_ERROR("%s: allocation failed",__FUNCTION__);
+            goto EXIT;
+        }
+        TIMM_OSAL_Memset(pEntry, 0, sizeof(MEMPLUGIN_ION_BUFFER));
+        pEntry->sParams = pConfig->sReserveParams;
+        eError = MemPlugin_ION_AllocBuffer(pMemPluginHandle, pConfig->nClient, &pEntry->sParams, &pEntry->sProp);
+        if(eError != MEMPLUGIN_ERROR_NONE)
+        {
+            DOMX_ERROR("%s: reserving buffer %d of %d failed",__FUNCTION__, i, pConfig->nReserveCount);
+            TIMM_OSAL_Free(pEntry);
+            goto EXIT;
+        }
+        pEntry->nClient = pConfig->nClient;
+        pEntry->sReqParams = pConfig->sReserveParams;
+        MemPlugin_ION_CurrentParams(pMemPluginHdl, &pEntry->sIonParams);
+        pEntry->bReserved = OMX_TRUE;
+
+        TIMM_OSAL_MutexObtain(pCache->pLock, TIMM_OSAL_SUSPEND);
+        nBucket = MemPlugin_ION_CacheBucket(&pEntry->sReqParams);
+        pEntry->nStamp = pCache->nStamp++;
+        pEntry->pNext = pCache->pFree[nBucket];
+        pCache->pFree[nBucket] = pEntry;
+        TIMM_OSAL_MutexRelease(pCache->pLock);
+    }
+
 EXIT:
-    return(MEMPLUGIN_ERROR_NONE);
+    return eError;
 }
 
-MEMPLUGIN_ERRORTYPE MemPlugin_ION_Alloc(void *pMemPluginHandle, OMX_U32 nClient,
+static MEMPLUGIN_ERRORTYPE MemPlugin_ION_AllocBuffer(void *pMemPluginHandle, OMX_U32 nClient,
                                     MEMPLUGIN_BUFFER_PARAMS *pIonBufferParams,
                                     MEMPLUGIN_BUFFER_PROPERTIES *pIonBufferProp)
 {
     OMX_S16 ret;
-    struct ion_handle *temp;
-    size_t stride;
+    struct ion_handle *temp = NULL;
+    size_t stride = 0;
     MEMPLUGIN_ERRORTYPE eError = MEMPLUGIN_ERROR_NONE;
     MEMPLUGIN_ION_PARAMS sIonParams;
     MEMPLUGIN_OBJECT    *pMemPluginHdl = (MEMPLUGIN_OBJECT *)pMemPluginHandle;
@@ -184,35 +482,43 @@ MEMPLUGIN_ERRORTYPE MemPlugin_ION_Alloc(void *pMemPluginHandle, OMX_U32 nClient,
             }
         }
     }
-    if(pIonBufferParams->eBuffer_type == TILER1D)
+    if(pIonBufferParams->eBuffer_type == TILER2D &&
+       pIonBufferParams->eTiler_format == MEMPLUGIN_TILER_FORMAT_PAGE)
     {
+        DOMX_ERROR("Tiler 2D needs an 8, 16 or 32 bit container format");
+        eError = MEMPLUGIN_ERROR_BADPARAMETER;
+        goto EXIT;
+    }
+    if(pIonBufferParams->eBuffer_type == TILER1D ||
+       pIonBufferParams->eBuffer_type == TILER2D)
+    {
+        //for 2D nWidth/nHeight are in pixels of eTiler_format, the stride comes back in bytes
         ret = (OMX_S16)ion_alloc_tiler(nClient,
                                         pIonBufferParams->nWidth,
                                         pIonBufferParams->nHeight,
                                         pIonBufferParams->eTiler_format,
-                                        sIonParams.alloc_flags,
+                                        (pIonBufferParams->eBuffer_type == TILER2D) ?
+                                            OMAP_ION_HEAP_TILER_MASK : sIonParams.alloc_flags,
                                         &temp,
-                                        &(pIonBufferProp->nStride));
+                                        &stride);
 
          if (ret || ((int)temp == -ENOMEM))
          {
-               DOMX_ERROR("FAILED to allocate buffer of size=%d. ret=0x%x",pIonBufferParams->nWidth, ret);
+               DOMX_ERROR("FAILED to allocate buffer of size=%dx%d. ret=0x%x",pIonBufferParams->nWidth, pIonBufferParams->nHeight, ret);
                eError = MEMPLUGIN_ERROR_NORESOURCES;
                goto EXIT;
          }
     }
-    else if(pIonBufferParams->eBuffer_type == TILER2D)
-    {
-        DOMX_ERROR("Tiler 2D not implemented");
-        eError = MEMPLUGIN_ERROR_NOTIMPLEMENTED;
-        goto EXIT;
-    }
     else if(!temp)
     {
         DOMX_ERROR("Undefined option for buffer type");
         eError = MEMPLUGIN_ERROR_UNDEFINED;
         goto EXIT;
     }
+    else
+    {
+        stride = pIonBufferParams->nWidth;
+    }
     pIonBufferProp->sBuffer_accessor.pBufferHandle = (OMX_PTR)temp;
     pIonBufferProp->nStride =  stride;
 
@@ -220,7 +526,7 @@ MEMPLUGIN_ERRORTYPE MemPlugin_ION_Alloc(void *pMemPluginHandle, OMX_U32 nClient,
     {
         ret = (OMX_S16) ion_map(nClient,
                                 pIonBufferProp->sBuffer_accessor.pBufferHandle,
-                                pIonBufferParams->nWidth*pIonBufferParams->nHeight,
+                                MemPlugin_ION_BufferSize(pIonBufferParams, pIonBufferProp),
                                 sIonParams.prot,
                                 sIonParams.map_flags,
                                 sIonParams.nOffset,
@@ -231,6 +537,7 @@ MEMPLUGIN_ERRORTYPE MemPlugin_ION_Alloc(void *pMemPluginHandle, OMX_U32 nClient,
         {
                 DOMX_ERROR("userspace mapping of ION buffers returned error");
                 eError = MEMPLUGIN_ERROR_NORESOURCES;
+                ion_free(nClient, temp);
                 goto EXIT;
         }
     }
@@ -243,6 +550,7 @@ MEMPLUGIN_ERRORTYPE MemPlugin_ION_Alloc(void *pMemPluginHandle, OMX_U32 nClient,
         {
                 DOMX_ERROR("ION share returned error");
                 eError = MEMPLUGIN_ERROR_NORESOURCES;
+                ion_free(nClient, temp);
                 goto EXIT;
         }
     }
@@ -257,7 +565,7 @@ EXIT:
       }
 }
 
-MEMPLUGIN_ERRORTYPE MemPlugin_ION_Free(void *pMemPluginHandle,OMX_U32 nClient,
+static MEMPLUGIN_ERRORTYPE MemPlugin_ION_FreeBuffer(OMX_U32 nClient,
                                     MEMPLUGIN_BUFFER_PARAMS *pIonBufferParams,
                                     MEMPLUGIN_BUFFER_PROPERTIES *pIonBufferProp)
 {
@@ -267,7 +575,7 @@ MEMPLUGIN_ERRORTYPE MemPlugin_ION_Free(void *pMemPluginHandle,OMX_U32 nClient,
     //unmap
     if(pIonBufferParams->bMap == OMX_TRUE)
     {
-    munmap(pIonBufferProp->sBuffer_accessor.pBufferMappedAddress, pIonBufferParams->nHeight * pIonBufferParams->nWidth);
+    munmap(pIonBufferProp->sBuffer_accessor.pBufferMappedAddress, MemPlugin_ION_BufferSize(pIonBufferParams, pIonBufferProp));
     }
     //close
     close(pIonBufferProp->sBuffer_accessor.bufferFd);
@@ -284,10 +592,181 @@ EXIT:
          return MEMPLUGIN_ERROR_NONE;
       }
 }
+MEMPLUGIN_ERRORTYPE MemPlugin_ION_Alloc(void *pMemPluginHandle, OMX_U32 nClient,
+                                    MEMPLUGIN_BUFFER_PARAMS *pIonBufferParams,
+                                    MEMPLUGIN_BUFFER_PROPERTIES *pIonBufferProp)
+{
+    MEMPLUGIN_ERRORTYPE eError = MEMPLUGIN_ERROR_NONE;
+    MEMPLUGIN_OBJECT    *pMemPluginHdl = (MEMPLUGIN_OBJECT *)pMemPluginHandle;
+    MEMPLUGIN_ION_CACHE *pCache = pMemPluginHdl->pPluginPrivate;
+    MEMPLUGIN_ION_BUFFER **ppEntry, *pEntry = NULL, *pTrimmed;
+    MEMPLUGIN_BUFFER_PARAMS sReqParams = *pIonBufferParams;
+    MEMPLUGIN_ION_PARAMS sIonParams;
+    OMX_U32 nCachedBytes;
+
+    MemPlugin_ION_CurrentParams(pMemPluginHdl, &sIonParams);
+
+    TIMM_OSAL_MutexObtain(pCache->pLock, TIMM_OSAL_SUSPEND);
+    for(ppEntry = &pCache->pFree[MemPlugin_ION_CacheBucket(&sReqParams)]; *ppEntry != NULL; ppEntry = &(*ppEntry)->pNext)
+    {
+        pEntry = *ppEntry;
+        if(pEntry->nClient == nClient &&
+           pEntry->sReqParams.nWidth == sReqParams.nWidth &&
+           pEntry->sReqParams.nHeight == sReqParams.nHeight &&
+           pEntry->sReqParams.bMap == sReqParams.bMap &&
+           pEntry->sReqParams.eBuffer_type == sReqParams.eBuffer_type &&
+           pEntry->sReqParams.eTiler_format == sReqParams.eTiler_format &&
+           memcmp(&pEntry->sIonParams, &sIonParams, sizeof(MEMPLUGIN_ION_PARAMS)) == 0)
+        {
+            *ppEntry = pEntry->pNext;
+            if(!pEntry->bReserved)
+            {
+                pCache->nCachedBytes -= MemPlugin_ION_BufferSize(&pEntry->sParams, &pEntry->sProp);
+            }
+            break;
+        }
+        pEntry = NULL;
+    }
+    TIMM_OSAL_MutexRelease(pCache->pLock);
+
+    if(pEntry != NULL)
+    {
+        DOMX_DEBUG("%s: reusing cached buffer %p", __FUNCTION__, pEntry->sProp.sBuffer_accessor.pBufferHandle);
+        //report the buffer exactly as the original allocation did
+        pIonBufferParams->eBuffer_type = pEntry->sParams.eBuffer_type;
+        pIonBufferParams->eTiler_format = pEntry->sParams.eTiler_format;
+        *pIonBufferProp = pEntry->sProp;
+    }
+    else
+    {
+        pEntry = TIMM_OSAL_MallocExtn(sizeof(MEMPLUGIN_ION_BUFFER), TIMM_OSAL_TRUE,
+                                      0, TIMMOSAL_MEM_SEGMENT_EXT, NULL);
+        if(pEntry == NULL)
+        {
+            eError = MEMPLUGIN_ERROR_NORESOURCES;
+            DOMX_ERROR("%s: allocation failed",__FUNCTION__);
+            goto EXIT;
+        }
+        eError = MemPlugin_ION_AllocBuffer(pMemPluginHandle, nClient, pIonBufferParams, pIonBufferProp);
+        if(eError == MEMPLUGIN_ERROR_NORESOURCES)
+        {
+            //memory pressure - give back everything cached and try once more
+            TIMM_OSAL_MutexObtain(pCache->pLock, TIMM_OSAL_SUSPEND);
+            nCachedBytes = pCache->nCachedBytes;
+            pTrimmed = MemPlugin_ION_CacheTrim(pCache, 0, 0, OMX_FALSE);
+            TIMM_OSAL_MutexRelease(pCache->pLock);
+            if(pTrimmed != NULL)
+            {
+                DOMX_DEBUG("%s: allocation failed, trimming %d cached bytes", __FUNCTION__, nCachedBytes);
+                MemPlugin_ION_FreeList(pTrimmed);
+                *pIonBufferParams = sReqParams;
+                eError = MemPlugin_ION_AllocBuffer(pMemPluginHandle, nClient, pIonBufferParams, pIonBufferProp);
+            }
+        }
+        if(eError != MEMPLUGIN_ERROR_NONE)
+        {
+            TIMM_OSAL_Free(pEntry);
+            goto EXIT;
+        }
+        pEntry->nClient = nClient;
+        pEntry->sReqParams = sReqParams;
+        pEntry->sIonParams = sIonParams;
+        pEntry->sParams = *pIonBufferParams;
+        pEntry->sProp = *pIonBufferProp;
+    }
+
+    TIMM_OSAL_MutexObtain(pCache->pLock, TIMM_OSAL_SUSPEND);
+    pEntry->pNext = pCache->pInUse;
+    pCache->pInUse = pEntry;
+    TIMM_OSAL_MutexRelease(pCache->pLock);
+
+EXIT:
+      if (eError != MEMPLUGIN_ERROR_NONE) {
+          DOMX_EXIT("%s exited with error 0x%x",__FUNCTION__,eError);
+         return eError;
+      }
+      else {
+          DOMX_EXIT("%s executed successfully",__FUNCTION__);
+         return MEMPLUGIN_ERROR_NONE;
+      }
+}
+
+MEMPLUGIN_ERRORTYPE MemPlugin_ION_Free(void *pMemPluginHandle,OMX_U32 nClient,
+                                    MEMPLUGIN_BUFFER_PARAMS *pIonBufferParams,
+                                    MEMPLUGIN_BUFFER_PROPERTIES *pIonBufferProp)
+{
+    MEMPLUGIN_ERRORTYPE eError = MEMPLUGIN_ERROR_NONE;
+    MEMPLUGIN_ION_CACHE *pCache = ((MEMPLUGIN_OBJECT *)pMemPluginHandle)->pPluginPrivate;
+    MEMPLUGIN_ION_BUFFER **ppEntry, *pEntry = NULL, *pTrimmed = NULL;
+    OMX_U32 nBucket, nSize;
+
+    TIMM_OSAL_MutexObtain(pCache->pLock, TIMM_OSAL_SUSPEND);
+    for(ppEntry = &pCache->pInUse; *ppEntry != NULL; ppEntry = &(*ppEntry)->pNext)
+    {
+        if((*ppEntry)->sProp.sBuffer_accessor.pBufferHandle == pIonBufferProp->sBuffer_accessor.pBufferHandle &&
+           (*ppEntry)->nClient == nClient)
+        {
+            pEntry = *ppEntry;
+            *ppEntry = pEntry->pNext;
+            break;
+        }
+    }
+    if(pEntry == NULL)
+    {
+        TIMM_OSAL_MutexRelease(pCache->pLock);
+        //not allocated through the cache, free just as described by the caller
+        eError = MemPlugin_ION_FreeBuffer(nClient, pIonBufferParams, pIonBufferProp);
+        goto EXIT;
+    }
+
+    nSize = MemPlugin_ION_BufferSize(&pEntry->sParams, &pEntry->sProp);
+    if(!pEntry->bReserved)
+    {
+        if(nSize > pCache->nHighWater)
+        {
+            TIMM_OSAL_MutexRelease(pCache->pLock);
+            eError = MemPlugin_ION_FreeBuffer(nClient, &pEntry->sParams, &pEntry->sProp);
+            TIMM_OSAL_Free(pEntry);
+            goto EXIT;
+        }
+        pTrimmed = MemPlugin_ION_CacheTrim(pCache, 0, pCache->nHighWater - nSize, OMX_FALSE);
+        pCache->nCachedBytes += nSize;
+    }
+    nBucket = MemPlugin_ION_CacheBucket(&pEntry->sReqParams);
+    pEntry->nStamp = pCache->nStamp++;
+    pEntry->pNext = pCache->pFree[nBucket];
+    pCache->pFree[nBucket] = pEntry;
+    TIMM_OSAL_MutexRelease(pCache->pLock);
+    MemPlugin_ION_FreeList(pTrimmed);
+
+EXIT:
+      if (eError != MEMPLUGIN_ERROR_NONE) {
+          DOMX_EXIT("%s exited with error 0x%x",__FUNCTION__,eError);
+         return eError;
+      }
+      else {
+          DOMX_EXIT("%s executed successfully",__FUNCTION__);
+         return MEMPLUGIN_ERROR_NONE;
+      }
+}
+
 MEMPLUGIN_ERRORTYPE MemPlugin_ION_DeInit(void *pMemPluginHandle)
 {
     MEMPLUGIN_ERRORTYPE eError = MEMPLUGIN_ERROR_NONE;
     MEMPLUGIN_OBJECT    *pMemPluginHdl = (MEMPLUGIN_OBJECT *)pMemPluginHandle;
+    MEMPLUGIN_ION_CACHE *pCache = pMemPluginHdl->pPluginPrivate;
+    MEMPLUGIN_ION_BUFFER *pEntry;
+
+    //normally emptied by MemPlugin_ION_Close already
+    MemPlugin_ION_FreeList(MemPlugin_ION_CacheTrim(pCache, 0, 0, OMX_TRUE));
+    while(pCache->pInUse != NULL)
+    {
+        pEntry = pCache->pInUse;
+        pCache->pInUse = pEntry->pNext;
+        TIMM_OSAL_Free(pEntry);
+    }
+    TIMM_OSAL_MutexDelete(pCache->pLock);
+    TIMM_OSAL_Free(pCache);
 
     if(pMemPluginHdl->pPluginExtendedInfo != NULL)
     {
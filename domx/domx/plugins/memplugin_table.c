@@ -34,7 +34,8 @@
  * date:    28 sept 2012
  * This file contains the table that
  * maps a specific Plugin name to the
- * specific plugin init method.
+ * specific plugin init method, and the
+ * per component plugin configurations.
  */
 #include <stdio.h>
 #include "memplugin.h"
@@ -50,3 +51,12 @@ MEMPLUGIN_TABLETYPE    MemPlugins_Map[] =
     //   {"MEMPLUGIN_DRM" ,  &MemPlugin_DRM_Configure},
     { NULL, NULL }
 };
+
+/* Entries are applied in order, all entries whose prefix matches are used.
+ * Fields left at MEMPLUGIN_CONFIG_KEEP keep the plugin default. */
+MEMPLUGIN_COMPONENT_CONFIGTYPE    MemPlugins_ComponentConfig[] =
+{
+    //   { "OMX.TI.DUCATI1.VIDEO.DECODER",
+    //     { 0, MEMPLUGIN_CONFIG_KEEP, MEMPLUGIN_CONFIG_KEEP, 64 * 1024 * 1024, 0 } },
+    { NULL }
+};
@@ -80,6 +80,14 @@ void KPI_OmxCompDeinit(OMX_HANDLETYPE hComponent);
  */
 void KPI_OmxCompBufferEvent(enum KPI_BUFFER_EVENT event, OMX_HANDLETYPE hComponent, PROXY_BUFFER_INFO* pBuffer);
 
+/**
+ * OMX monitoring latency dump. Writes ETB->EBD and FTB->FBD p50/p95/p99 of
+ * every monitored component, the buffers of each port the remote side
+ * holds and the fill of its RPC reply pipes, to debug.domx.kpi_latency_file, enabled by bit 2 of
+ * debug.domx.kpi_status. Also done every 256 buffers and on deinit
+ */
+void KPI_OmxCompLatencyDump(void);
+
 #ifdef __cplusplus
 }
 #endif /* #ifdef __cplusplus */
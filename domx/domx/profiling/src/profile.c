@@ -44,8 +44,12 @@
  ******************************************************************/
 /* ----- system and platform files ----------------------------*/
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
 
 #ifdef _Android
 #include <cutils/properties.h>
@@ -65,32 +69,79 @@
  ******************************************************************/
 /* Events that can be dynamically enabled */
 enum KPI_STATUS {
-	KPI_BUFFER_EVENTS = 1
+	KPI_BUFFER_EVENTS = 1,
+	KPI_BUFFER_LATENCY = 2
 };
 
-/* OMX buffer events per component */
+/* Buffers in flight per direction, must be a power of two */
+#define KPI_LATENCY_PENDING 64
+/* Latency samples kept per direction for percentiles, power of two */
+#define KPI_LATENCY_RING 256
+/* Dump file is rewritten every KPI_LATENCY_DUMP_PERIOD completions */
+#define KPI_LATENCY_DUMP_PERIOD 256
+/* log2 buckets in us, the last one collects everything above 2^15 us */
+#define KPI_LATENCY_BUCKETS 16
+#define KPI_LATENCY_FILE_DEFAULT "/data/local/tmp/domx_latency.txt"
+
+/* ETB -> EBD is the input direction, FTB -> FBD the output one */
+enum KPI_LATENCY_DIR {
+	KPI_LATENCY_INPUT = 0,
+	KPI_LATENCY_OUTPUT = 1,
+	KPI_LATENCY_DIRS = 2
+};
+
+/* A buffer handed to the remote component, keyed by its remote header */
+typedef struct {
+	OMX_U32 nRemote;
+	OMX_U64 nStart;
+} kpi_latency_pending;
+
+/* Latency trace of one direction. Writers only use atomics, the dump
+ * works on a snapshot so nothing on the buffer path takes a lock */
+typedef struct {
+	kpi_latency_pending pending[KPI_LATENCY_PENDING];
+	OMX_U32 samples[KPI_LATENCY_RING];
+	OMX_U32 count;      /* samples ever written, ring index */
+	OMX_U32 dropped;    /* starts that found no free pending slot */
+	OMX_U32 histo[KPI_LATENCY_BUCKETS];
+} kpi_latency_trace;
+
+/* L1 line of the Cortex-A9 */
+#define KPI_CACHE_LINE 32
+
+/* ETB/EBD and FTB/FBD come from different threads, every counter gets a
+ * line of its own so that counting does not bounce lines between cores */
 typedef struct {
+	OMX_U32 count;
+	OMX_U8 pad[KPI_CACHE_LINE - sizeof(OMX_U32)];
+} kpi_omx_counter;
+
+/* OMX buffer events per component, hung off PROXY_COMPONENT_PRIVATE */
+typedef struct {
+	kpi_omx_counter counts[KPI_BUFFER_FBD];  /* indexed by event - 1 */
 	OMX_HANDLETYPE hComponent;
-	OMX_U32 count_ftb;
-	OMX_U32 count_fbd;
-	OMX_U32 count_etb;
-	OMX_U32 count_ebd;
+	OMX_U32 slot;
 	char name[50];
+	kpi_latency_trace *latency;  /* KPI_LATENCY_DIRS traces, NULL when off */
 } kpi_omx_component;
 
-/* we trace up to MAX_OMX_COMP components */
+/* up to MAX_OMX_COMP components are listed in the latency dump */
 #define MAX_OMX_COMP 8
 
 
 /***************************************************************
- * kpi_omx_monitor
+ * kpi_omx_registry
  * -------------------------------------------------------------
- * Contains up to 8 components data
+ * Components known to the dump, slots are claimed and released
+ * with atomics. The buffer path never looks at it.
  *
  ***************************************************************/
-kpi_omx_component kpi_omx_monitor[MAX_OMX_COMP]; /* we trace up to MAX_OMX_COMP components */
-OMX_U32 kpi_omx_monitor_cnt = 0; /* no component yet */
+static kpi_omx_component *kpi_omx_registry[MAX_OMX_COMP];
+static OMX_U32 kpi_omx_next_id = 0;
+static pthread_once_t kpi_status_once = PTHREAD_ONCE_INIT;
 unsigned int kpi_status = 0;
+char kpi_latency_file[OMX_MAX_STRINGNAME_SIZE] = KPI_LATENCY_FILE_DEFAULT;
+static OMX_U32 kpi_latency_dumping = 0;
 
 
 /* ===========================================================================*/
@@ -114,7 +165,7 @@ OMX_U64 KPI_GetTime(void)
 /* ===========================================================================*/
 /**
  * @name KPI_OmxCompKpiUpdateStatus()
- * @brief Update dynamic activation of traces
+ * @brief Read activation of traces, done once per process
  * @param void
  * @return void
  * @sa TBD
@@ -141,6 +192,275 @@ void KPI_OmxCompKpiUpdateStatus(void)
                         kpi_status = val;
         }
 #endif
+
+        val = getenv("DEBUG_DOMX_KPI_LATENCY_FILE");
+        if (val)
+        {
+                strncpy(kpi_latency_file, val, sizeof(kpi_latency_file) - 1);
+        }
+#ifdef _Android
+        else
+        {
+                char value[PROPERTY_VALUE_MAX];
+
+                property_get("debug.domx.kpi_latency_file", value,
+                    KPI_LATENCY_FILE_DEFAULT);
+                strncpy(kpi_latency_file, value, sizeof(kpi_latency_file) - 1);
+        }
+#endif
+}
+
+/* ===========================================================================*/
+/**
+ * @name KPI_LatencyStart()
+ * @brief Remember when a buffer was sent to the remote component
+ * @param pTrace: latency trace of the direction the buffer goes
+ * @param nRemote: remote buffer header, identifies the buffer until done
+ * @return void
+ * @sa KPI_LatencyDone()
+ *
+ */
+/* ===========================================================================*/
+static void KPI_LatencyStart(kpi_latency_trace *pTrace, OMX_U32 nRemote)
+{
+	OMX_U32 nHash = (nRemote >> 2) & (KPI_LATENCY_PENDING - 1);
+	OMX_U32 i;
+	kpi_latency_pending *pSlot;
+
+	for (i = 0; i < KPI_LATENCY_PENDING; i++) {
+		pSlot = &pTrace->pending[(nHash + i) & (KPI_LATENCY_PENDING - 1)];
+		/* A resend without done (failed ETB/FTB) restarts the clock.
+		 * The event is traced before the RPC goes out, so the done
+		 * side cannot look at the slot before nStart is written */
+		if (pSlot->nRemote == nRemote ||
+		    __sync_bool_compare_and_swap(&pSlot->nRemote, 0, nRemote)) {
+			pSlot->nStart = KPI_GetTime();
+			return;
+		}
+	}
+	__sync_fetch_and_add(&pTrace->dropped, 1);
+}
+
+/* ===========================================================================*/
+/**
+ * @name KPI_LatencyDone()
+ * @brief Account the latency of a buffer coming back from the remote side
+ * @param pTrace: latency trace of the direction the buffer went
+ * @param nRemote: remote buffer header given to KPI_LatencyStart()
+ * @return OMX_TRUE when a dump of the traces is due
+ * @sa KPI_LatencyStart()
+ *
+ */
+/* ===========================================================================*/
+static OMX_BOOL KPI_LatencyDone(kpi_latency_trace *pTrace, OMX_U32 nRemote)
+{
+	OMX_U32 nHash = (nRemote >> 2) & (KPI_LATENCY_PENDING - 1);
+	OMX_U32 i, nLatency, nBucket, nIdx;
+	OMX_U64 nStart = 0;
+	kpi_latency_pending *pSlot;
+
+	for (i = 0; i < KPI_LATENCY_PENDING; i++) {
+		pSlot = &pTrace->pending[(nHash + i) & (KPI_LATENCY_PENDING - 1)];
+		if (pSlot->nRemote == nRemote) {
+			nStart = pSlot->nStart;
+			__sync_synchronize();
+			pSlot->nRemote = 0;
+			break;
+		}
+	}
+	/* Not started while tracing was on */
+	if (nStart == 0)
+		return OMX_FALSE;
+
+	nLatency = (OMX_U32)(KPI_GetTime() - nStart);
+	for (nBucket = 0; nBucket < KPI_LATENCY_BUCKETS - 1 &&
+	    (nLatency >> (nBucket + 1)) != 0; nBucket++);
+	__sync_fetch_and_add(&pTrace->histo[nBucket], 1);
+
+	nIdx = __sync_fetch_and_add(&pTrace->count, 1);
+	pTrace->samples[nIdx & (KPI_LATENCY_RING - 1)] = nLatency;
+
+	return ((nIdx + 1) % KPI_LATENCY_DUMP_PERIOD) == 0 ? OMX_TRUE : OMX_FALSE;
+}
+
+static int KPI_LatencyCompare(const void *a, const void *b)
+{
+	OMX_U32 x = *(const OMX_U32 *)a, y = *(const OMX_U32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* ===========================================================================*/
+/**
+ * @name KPI_LatencyPrint()
+ * @brief Print percentiles and histogram of one latency trace
+ * @param pFile: dump file, NULL to only trace through DOMX_PROF
+ * @param name: monitored component name
+ * @param dir: "ETB-EBD" or "FTB-FBD"
+ * @param pTrace: latency trace to print
+ * @return void
+ * @sa TBD
+ *
+ */
+/* ===========================================================================*/
+static void KPI_LatencyPrint(FILE *pFile, const char *name, const char *dir,
+    kpi_latency_trace *pTrace)
+{
+	OMX_U32 sorted[KPI_LATENCY_RING];
+	OMX_U32 nCount = pTrace->count, n, i;
+	char histo[KPI_LATENCY_BUCKETS * 11 + 1];
+	int len = 0;
+
+	if (nCount == 0)
+		return;
+
+	/* Snapshot of the ring, a sample may get overwritten while copying
+	 * which only shifts the window by one */
+	n = nCount < KPI_LATENCY_RING ? nCount : KPI_LATENCY_RING;
+	memcpy(sorted, pTrace->samples, n * sizeof(OMX_U32));
+	qsort(sorted, n, sizeof(OMX_U32), KPI_LatencyCompare);
+
+	for (i = 0; i < KPI_LATENCY_BUCKETS; i++)
+		len += snprintf(histo + len, sizeof(histo) - len, " %u",
+		    (unsigned int)pTrace->histo[i]);
+
+	DOMX_PROF("<KPI> %-6s %s n=%u p50=%u p95=%u p99=%u max=%u us dropped=%u",
+	    name, dir, (unsigned int)nCount, (unsigned int)sorted[(n - 1) * 50 / 100],
+	    (unsigned int)sorted[(n - 1) * 95 / 100], (unsigned int)sorted[(n - 1) * 99 / 100],
+	    (unsigned int)sorted[n - 1], (unsigned int)pTrace->dropped);
+
+	if (pFile) {
+		fprintf(pFile, "%-6s %s n=%u p50=%u p95=%u p99=%u max=%u us dropped=%u\n",
+		    name, dir, (unsigned int)nCount, (unsigned int)sorted[(n - 1) * 50 / 100],
+		    (unsigned int)sorted[(n - 1) * 95 / 100], (unsigned int)sorted[(n - 1) * 99 / 100],
+		    (unsigned int)sorted[n - 1], (unsigned int)pTrace->dropped);
+		fprintf(pFile, "%-6s %s log2(us) histogram:%s\n", name, dir, histo);
+	}
+}
+
+/* ===========================================================================*/
+/**
+ * @name KPI_RemoteBuffersPrint()
+ * @brief Print how many buffers of each port the remote component holds, a
+ *        count that does not go down points at a stuck buffer
+ * @param pFile: dump file, may be NULL
+ * @param pKpi: monitored component
+ * @return void
+ * @sa TBD
+ *
+ */
+/* ===========================================================================*/
+static void KPI_RemoteBuffersPrint(FILE *pFile, kpi_omx_component *pKpi)
+{
+	PROXY_COMPONENT_PRIVATE *pCompPrv = (PROXY_COMPONENT_PRIVATE *)
+	    ((OMX_COMPONENTTYPE *) pKpi->hComponent)->pComponentPrivate;
+	char held[PROXY_MAXNUMOFPORTS * 12 + 1];
+	OMX_U32 i, nTotal = 0;
+	int len = 0;
+
+	held[0] = '\0';
+	for (i = 0; i < PROXY_MAXNUMOFPORTS; i++) {
+		OMX_U32 n = pCompPrv->proxyPortBuffers[i].nRemoteBuffers;
+
+		nTotal += n;
+		if (n)
+			len += snprintf(held + len, sizeof(held) - len, " p%u=%u",
+			    (unsigned int)i, (unsigned int)n);
+	}
+
+	DOMX_PROF("<KPI> %-6s held by remote: %u%s", pKpi->name,
+	    (unsigned int)nTotal, held);
+	if (pFile)
+		fprintf(pFile, "%-6s held by remote: %u%s\n", pKpi->name,
+		    (unsigned int)nTotal, held);
+}
+
+/* ===========================================================================*/
+/**
+ * @name KPI_RpcPipesPrint()
+ * @brief Print the most replies each RPC mailbox of the component ever held,
+ *        a mailbox that reached its depth has blocked the listener
+ * @param pFile: dump file, may be NULL
+ * @param pKpi: monitored component
+ * @return void
+ * @sa TBD
+ *
+ */
+/* ===========================================================================*/
+static void KPI_RpcPipesPrint(FILE *pFile, kpi_omx_component *pKpi)
+{
+	PROXY_COMPONENT_PRIVATE *pCompPrv = (PROXY_COMPONENT_PRIVATE *)
+	    ((OMX_COMPONENTTYPE *) pKpi->hComponent)->pComponentPrivate;
+	RPC_OMX_CONTEXT *pRPCCtx = (RPC_OMX_CONTEXT *) pCompPrv->hRemoteComp;
+	char pipes[RPC_OMX_MAX_FUNCTION_LIST * 16 + 1];
+	OMX_U32 i;
+	int len = 0;
+
+	if (pRPCCtx == NULL)
+		return;
+
+	pipes[0] = '\0';
+	for (i = 0; i < RPC_OMX_MAX_FUNCTION_LIST; i++) {
+		OMX_U32 n = pRPCCtx->nPipeHighWater[i];
+
+		if (n)
+			len += snprintf(pipes + len, sizeof(pipes) - len,
+			    " f%u=%u/%u%s", (unsigned int)i, (unsigned int)n,
+			    (unsigned int)pRPCCtx->nPipeDepth[i],
+			    (n >= pRPCCtx->nPipeDepth[i]) ? "!" : "");
+	}
+
+	DOMX_PROF("<KPI> %-6s rpc pipes:%s", pKpi->name, pipes);
+	if (pFile)
+		fprintf(pFile, "%-6s rpc pipes:%s\n", pKpi->name, pipes);
+}
+
+/* ===========================================================================*/
+/**
+ * @name KPI_OmxCompLatencyDump()
+ * @brief Write latency percentiles of all monitored components
+ * @param void
+ * @return void
+ * @sa TBD
+ *
+ */
+/* ===========================================================================*/
+void KPI_OmxCompLatencyDump(void)
+{
+	FILE *pFile;
+	OMX_U32 omx_cnt;
+
+	if ( !(kpi_status & KPI_BUFFER_LATENCY) )
+		return;
+
+	/* One dump at a time, a concurrent one is simply skipped */
+	if (!__sync_bool_compare_and_swap(&kpi_latency_dumping, 0, 1))
+		return;
+
+	pFile = fopen(kpi_latency_file, "w");
+	if (pFile)
+		fprintf(pFile, "<KPI> DOMX buffer latency at %lld us, last %d samples\n",
+		    KPI_GetTime(), KPI_LATENCY_RING);
+
+	for (omx_cnt = 0; omx_cnt < MAX_OMX_COMP; omx_cnt++) {
+		kpi_omx_component *pKpi = kpi_omx_registry[omx_cnt];
+
+		if (pKpi == NULL)
+			continue;
+		if (pKpi->latency) {
+			KPI_LatencyPrint(pFile, pKpi->name, "ETB-EBD",
+			    &pKpi->latency[KPI_LATENCY_INPUT]);
+			KPI_LatencyPrint(pFile, pKpi->name, "FTB-FBD",
+			    &pKpi->latency[KPI_LATENCY_OUTPUT]);
+		}
+		KPI_RemoteBuffersPrint(pFile, pKpi);
+		KPI_RpcPipesPrint(pFile, pKpi);
+	}
+
+	if (pFile)
+		fclose(pFile);
+
+	__sync_lock_release(&kpi_latency_dumping);
 }
 
 /* ===========================================================================*/
@@ -160,42 +480,37 @@ void KPI_OmxCompInit(OMX_HANDLETYPE hComponent)
 	OMX_UUIDTYPE    compUUID;
 	char compName[OMX_MAX_STRINGNAME_SIZE];
 	char* p;
-	OMX_U32 omx_cnt;
-	struct timespec tp;
-
-	/* Check if some profiling events have been enabled/disabled */
-	KPI_OmxCompKpiUpdateStatus();
-
-	if ( !(kpi_status & KPI_BUFFER_EVENTS) )
+	OMX_U32 omx_cnt, id;
+	PROXY_COMPONENT_PRIVATE *pCompPrv =
+	    (PROXY_COMPONENT_PRIVATE *) ((OMX_COMPONENTTYPE *) hComponent)->pComponentPrivate;
+	kpi_omx_component *pKpi;
+
+	/* Profiling events are picked up once, the buffer path only tests
+	 * the cached kpi_status */
+	pthread_once(&kpi_status_once, KPI_OmxCompKpiUpdateStatus);
+
+	/* counting is always on, it costs one atomic add per buffer event */
+	pKpi = (kpi_omx_component *) memalign(KPI_CACHE_LINE, sizeof(kpi_omx_component));
+	if (pKpi == NULL)
 		return;
+	memset(pKpi, 0, sizeof(kpi_omx_component));
+	pKpi->hComponent = hComponent;
+	pKpi->slot = MAX_OMX_COMP;
 
-	/* First init: clear kpi_omx_monitor components */
-	if( kpi_omx_monitor_cnt == 0) {
-		for (omx_cnt = 0; omx_cnt < MAX_OMX_COMP; omx_cnt++) {
-			/*clear handler registry */
-			kpi_omx_monitor[omx_cnt].hComponent = 0;
-		}
+	if (kpi_status & KPI_BUFFER_LATENCY) {
+		pKpi->latency = (kpi_latency_trace *) calloc(KPI_LATENCY_DIRS,
+		    sizeof(kpi_latency_trace));
 	}
 
-	/* find an empty monitoring structure */
+	/* find an empty registry slot, without one the component is still
+	 * counted but left out of the latency dump */
 	for( omx_cnt = 0; omx_cnt < MAX_OMX_COMP;  omx_cnt++ ) {
-		if( kpi_omx_monitor[omx_cnt].hComponent == 0 ) break;
+		if (__sync_bool_compare_and_swap(&kpi_omx_registry[omx_cnt], NULL, pKpi)) {
+			pKpi->slot = omx_cnt;
+			break;
+		}
 	}
-
-	/* too omany components started, do not monitor */
-	if( omx_cnt >= MAX_OMX_COMP) return;
-
-	/* current comp num and update */
-	kpi_omx_monitor_cnt++;
-
-	/* register the component handle */
-	kpi_omx_monitor[omx_cnt].hComponent = hComponent;
-
-	/* reset event counts */
-	kpi_omx_monitor[omx_cnt].count_ftb = 0;
-	kpi_omx_monitor[omx_cnt].count_fbd = 0;
-	kpi_omx_monitor[omx_cnt].count_etb = 0;
-	kpi_omx_monitor[omx_cnt].count_ebd = 0;
+	id = __sync_fetch_and_add(&kpi_omx_next_id, 1);
 
 	/* register the component name */
 	((OMX_COMPONENTTYPE*) hComponent)->GetComponentVersion(hComponent, compName, &nVersionComp, &nVersionSpec, &compUUID);
@@ -203,12 +518,13 @@ void KPI_OmxCompInit(OMX_HANDLETYPE hComponent)
 	/* get the end of the string compName... */
 	p = compName + strlen( compName ) - 1;
 	while( (*p != '.' ) && (p != compName) ) p--;
-	strncpy(kpi_omx_monitor[omx_cnt].name, p + 1, 6);
-	*(kpi_omx_monitor[omx_cnt].name + 6) = '\0';                  // complete the chain of char
-	sprintf(kpi_omx_monitor[omx_cnt].name, "%s%u", kpi_omx_monitor[omx_cnt].name, (unsigned int)omx_cnt); // Add index to the name
+	snprintf(pKpi->name, sizeof(pKpi->name), "%.6s%u", p + 1, (unsigned int)id); // Add index to the name
+
+	pCompPrv->pKpiMonitor = pKpi;
 
 	/* trace component init */
-	DOMX_PROF("<KPI> OMX %-6s Init %-8lld", kpi_omx_monitor[omx_cnt].name, KPI_GetTime());
+	if (kpi_status & KPI_BUFFER_EVENTS)
+		DOMX_PROF("<KPI> OMX %-6s Init %-8lld", pKpi->name, KPI_GetTime());
 
 	return;
 }
@@ -225,25 +541,30 @@ void KPI_OmxCompInit(OMX_HANDLETYPE hComponent)
 /* ===========================================================================*/
 void KPI_OmxCompDeinit( OMX_HANDLETYPE hComponent)
 {
-	OMX_U32 omx_cnt;
+	PROXY_COMPONENT_PRIVATE *pCompPrv =
+	    (PROXY_COMPONENT_PRIVATE *) ((OMX_COMPONENTTYPE *) hComponent)->pComponentPrivate;
+	kpi_omx_component *pKpi = (kpi_omx_component *) pCompPrv->pKpiMonitor;
 
-	if ( !(kpi_status & KPI_BUFFER_EVENTS) )
-		return;
+	if (pKpi == NULL) return;
 
-	if( kpi_omx_monitor_cnt == 0) return;
+	/* keep the last figures of the component in the dump file */
+	KPI_OmxCompLatencyDump();
 
-	/* identify the component from the registry */
-	for( omx_cnt = 0; omx_cnt < MAX_OMX_COMP;  omx_cnt++ ) {
-		if( kpi_omx_monitor[omx_cnt].hComponent == hComponent ) break;
-	}
+	/* trace component deinit */
+	if (kpi_status & KPI_BUFFER_EVENTS)
+		DOMX_PROF( "<KPI> OMX %-6s Deinit %-8lld", pKpi->name, KPI_GetTime());
 
-	/* trace component init */
-	DOMX_PROF( "<KPI> OMX %-6s Deinit %-8lld", kpi_omx_monitor[omx_cnt].name, KPI_GetTime());
+	pCompPrv->pKpiMonitor = NULL;
 
-	/* unregister the component */
-	kpi_omx_monitor[omx_cnt].hComponent = 0;
+	/* unregister the component, then let a dump that may still be
+	 * walking the registry finish before the memory goes */
+	if (pKpi->slot < MAX_OMX_COMP)
+		__sync_bool_compare_and_swap(&kpi_omx_registry[pKpi->slot], pKpi, NULL);
+	while (kpi_latency_dumping)
+		sched_yield();
 
-	kpi_omx_monitor_cnt--;
+	free(pKpi->latency);
+	free(pKpi);
 
 	return;
 }
@@ -260,42 +581,59 @@ void KPI_OmxCompDeinit( OMX_HANDLETYPE hComponent)
 /* ===========================================================================*/
 void KPI_OmxCompBufferEvent(enum KPI_BUFFER_EVENT event, OMX_HANDLETYPE hComponent, PROXY_BUFFER_INFO* pBuffer)
 {
-        OMX_U32 omx_cnt;
+	kpi_omx_component *pKpi = (kpi_omx_component *)
+	    ((PROXY_COMPONENT_PRIVATE *) ((OMX_COMPONENTTYPE *) hComponent)->pComponentPrivate)->pKpiMonitor;
+	OMX_U32 count;
+	OMX_BOOL bDump = OMX_FALSE;
 
-	if ( !(kpi_status & KPI_BUFFER_EVENTS) )
-		return;
+	if (pKpi == NULL) return;
 
-        if (kpi_omx_monitor_cnt == 0) return;
+	count = __sync_add_and_fetch(&pKpi->counts[event - 1].count, 1);
 
-        /* identify the component from the registry */
-        for (omx_cnt = 0; omx_cnt < MAX_OMX_COMP;  omx_cnt++) {
-                if( kpi_omx_monitor[omx_cnt].hComponent == hComponent ) break;
-        }
+	if (pKpi->latency) {
+		kpi_latency_trace *latency = pKpi->latency;
 
-        /* Update counts and trace the event */
-        if( omx_cnt < MAX_OMX_COMP ) {
-                /* trace the event, we trace remote address to correlate to Ducati trace */
 		switch(event) {
 			case KPI_BUFFER_ETB:
-				DOMX_PROF("ETB %-6s %-4u %-8lld x%-8x", kpi_omx_monitor[omx_cnt].name, \
-					(unsigned int)++kpi_omx_monitor[omx_cnt].count_etb, KPI_GetTime(), (unsigned int)pBuffer->pBufHeaderRemote);
+				KPI_LatencyStart(&latency[KPI_LATENCY_INPUT], pBuffer->pBufHeaderRemote);
 			break;
 			case KPI_BUFFER_FTB:
-				DOMX_PROF("FTB %-6s %-4u %-8lld x%-8x", kpi_omx_monitor[omx_cnt].name, \
-					(unsigned int)++kpi_omx_monitor[omx_cnt].count_ftb, KPI_GetTime(), (unsigned int)pBuffer->pBufHeaderRemote);
+				KPI_LatencyStart(&latency[KPI_LATENCY_OUTPUT], pBuffer->pBufHeaderRemote);
 			break;
 			case KPI_BUFFER_EBD:
-				DOMX_PROF("EBD %-6s %-4u %-8lld x%-8x", kpi_omx_monitor[omx_cnt].name, \
-					(unsigned int)++kpi_omx_monitor[omx_cnt].count_ebd, KPI_GetTime(), (unsigned int)pBuffer->pBufHeaderRemote);
+				bDump = KPI_LatencyDone(&latency[KPI_LATENCY_INPUT], pBuffer->pBufHeaderRemote);
 			break;
-			/* we add timestamp metadata because this is a unique identifier of buffer among all SW layers */
 			case KPI_BUFFER_FBD:
-		                DOMX_PROF("FBD %-6s %-4u %-8lld x%-8x %lld", kpi_omx_monitor[omx_cnt].name, \
-					(unsigned int)++kpi_omx_monitor[omx_cnt].count_fbd, KPI_GetTime(), (unsigned int)pBuffer->pBufHeaderRemote, pBuffer->pBufHeader->nTimeStamp);
+				bDump = KPI_LatencyDone(&latency[KPI_LATENCY_OUTPUT], pBuffer->pBufHeaderRemote);
 			break;
-
 		}
-        }
+		if (bDump)
+			KPI_OmxCompLatencyDump();
+	}
+
+	if ( !(kpi_status & KPI_BUFFER_EVENTS) )
+		return;
+
+	/* trace the event, we trace remote address to correlate to Ducati trace */
+	switch(event) {
+		case KPI_BUFFER_ETB:
+			DOMX_PROF("ETB %-6s %-4u %-8lld x%-8x", pKpi->name, \
+				(unsigned int)count, KPI_GetTime(), (unsigned int)pBuffer->pBufHeaderRemote);
+		break;
+		case KPI_BUFFER_FTB:
+			DOMX_PROF("FTB %-6s %-4u %-8lld x%-8x", pKpi->name, \
+				(unsigned int)count, KPI_GetTime(), (unsigned int)pBuffer->pBufHeaderRemote);
+		break;
+		case KPI_BUFFER_EBD:
+			DOMX_PROF("EBD %-6s %-4u %-8lld x%-8x", pKpi->name, \
+				(unsigned int)count, KPI_GetTime(), (unsigned int)pBuffer->pBufHeaderRemote);
+		break;
+		/* we add timestamp metadata because this is a unique identifier of buffer among all SW layers */
+		case KPI_BUFFER_FBD:
+			DOMX_PROF("FBD %-6s %-4u %-8lld x%-8x %lld", pKpi->name, \
+				(unsigned int)count, KPI_GetTime(), (unsigned int)pBuffer->pBufHeaderRemote, pBuffer->pBufHeader->nTimeStamp);
+		break;
+	}
 
-        return;
+	return;
 }
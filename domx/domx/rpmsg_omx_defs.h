@@ -49,6 +49,9 @@
 #define OMXSERVER_STATUS_UNPROCESSED      ((uint16_t)6) // unprocessed message
 
 #define OMX_POOLID_JOBID_DEFAULT (0x00008000)
+/* Remote pools used for latency critical and background instances */
+#define OMX_POOLID_JOBID_HIGH    (0x00008001)
+#define OMX_POOLID_JOBID_LOW     (0x00008002)
 #define OMX_INVALIDFXNIDX ((uint32_t)(0xFFFFFFFF))
 
 #endif /* RPMSG_OMX_DEFS_H */
@@ -23,6 +23,7 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_CFLAGS += -DOMAP_2430 -DOMX_DEBUG -D_Android -D_POSIX_VERSION_1_
 LOCAL_CFLAGS += -DTIMM_OSAL_DEBUG_TRACE_DETAIL=1 # quiet
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 
 LOCAL_MODULE:= libmm_osal
 LOCAL_MODULE_TAGS:= optional
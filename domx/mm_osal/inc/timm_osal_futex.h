@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+*  @file timm_osal_futex.h
+*  Futex wait/wake helpers shared by the OSAL events and semaphores.
+*  Not part of the public API.
+*  @path
+*
+*/
+/* -------------------------------------------------------------------------- */
+
+#ifndef _TIMM_OSAL_FUTEX_H_
+#define _TIMM_OSAL_FUTEX_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif				/* __cplusplus */
+
+/*******************************************************************************
+* Includes
+*******************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "timm_osal_types.h"
+#include "timm_osal_time.h"
+
+#ifndef FUTEX_PRIVATE_FLAG
+#define FUTEX_PRIVATE_FLAG 128
+#endif
+
+/**
+ * Sleeps while *pWord still holds nVal, until woken or pDeadline (NULL for
+ * no limit, else on CLOCK_MONOTONIC, see TIMM_OSAL_Deadline) has passed.  Returns ETIMEDOUT once the deadline has passed and
+ * 0 otherwise, the caller re-checks its condition either way.
+ */
+	static inline int TIMM_OSAL_FutexWait(volatile int *pWord, int nVal,
+	    const struct timespec *pDeadline)
+	{
+		struct timespec tNow, tLeft, *pLeft = NULL;
+
+		if (pDeadline)
+		{
+			clock_gettime(CLOCK_MONOTONIC, &tNow);
+			tLeft.tv_sec = pDeadline->tv_sec - tNow.tv_sec;
+			tLeft.tv_nsec = pDeadline->tv_nsec - tNow.tv_nsec;
+			if (tLeft.tv_nsec < 0)
+			{
+				tLeft.tv_sec--;
+				tLeft.tv_nsec += 1000000000;
+			}
+			if (tLeft.tv_sec < 0)
+				return ETIMEDOUT;
+			pLeft = &tLeft;
+		}
+
+		/*FUTEX_WAIT takes a relative timeout measured on the monotonic clock */
+		if (syscall(__NR_futex, pWord, FUTEX_WAIT | FUTEX_PRIVATE_FLAG,
+			nVal, pLeft, NULL, 0) != 0 && errno == ETIMEDOUT)
+			return ETIMEDOUT;
+		return 0;
+	}
+
+/**
+ * Wakes up to nCount threads sleeping on pWord.
+ */
+	static inline void TIMM_OSAL_FutexWake(volatile int *pWord, int nCount)
+	{
+		syscall(__NR_futex, pWord, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, nCount,
+		    NULL, NULL, 0);
+	}
+
+#ifdef __cplusplus
+}
+#endif				/* __cplusplus */
+
+#endif				/* _TIMM_OSAL_FUTEX_H_ */
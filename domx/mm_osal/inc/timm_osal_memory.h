@@ -78,6 +78,15 @@ extern "C"
 
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeleteMemoryPool(void);
 
+	TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateArena(TIMM_OSAL_PTR * phArena,
+	    TIMM_OSAL_U32 nObjSize, TIMM_OSAL_U32 nAlign);
+
+	TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeleteArena(TIMM_OSAL_PTR hArena);
+
+	TIMM_OSAL_PTR TIMM_OSAL_ArenaAlloc(TIMM_OSAL_PTR hArena);
+
+	void TIMM_OSAL_ArenaFree(TIMM_OSAL_PTR hArena, TIMM_OSAL_PTR pData);
+
 	TIMM_OSAL_PTR TIMM_OSAL_Malloc(TIMM_OSAL_U32 size,
 	    TIMM_OSAL_BOOL bBlockContiguous, TIMM_OSAL_U32 unBlockAlignment,
 	    TIMMOSAL_MEM_SEGMENTID tMemSegId);
@@ -95,6 +104,8 @@ extern "C"
 
 	TIMM_OSAL_U32 TIMM_OSAL_GetMemCounter(void);
 
+	void TIMM_OSAL_DumpMemStats(void);
+
 #define TIMM_OSAL_MallocExtn(size, bBlockContiguous, unBlockAlignment, tMemSegId, hHeap) \
     TIMM_OSAL_Malloc(size, bBlockContiguous, unBlockAlignment, tMemSegId )
 
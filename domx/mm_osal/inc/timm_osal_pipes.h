@@ -54,6 +54,21 @@ extern "C"
 
 #include "timm_osal_types.h"
 
+/*
+* Backends a pipe can be created on
+*/
+	typedef enum TIMM_OSAL_PIPE_BACKEND
+	{
+		/* pipe() fd pair, any message size */
+		TIMM_OSAL_PIPE_BACKEND_KERNEL = 0,
+		/* userspace ring of fixed size messages, no syscall unless
+		 * a side has to sleep */
+		TIMM_OSAL_PIPE_BACKEND_MAILBOX,
+		/* userspace ring of fixed size messages under a lock, any
+		 * number of readers and writers, O(1) writes to the front */
+		TIMM_OSAL_PIPE_BACKEND_DEQUE
+	} TIMM_OSAL_PIPE_BACKEND;
+
 /*
 * Defined for Pipe timeout value
 */
@@ -61,6 +76,11 @@ extern "C"
 	    TIMM_OSAL_U32 pipeSize,
 	    TIMM_OSAL_U32 messageSize, TIMM_OSAL_U8 isFixedMessage);
 
+	TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreatePipeEx(TIMM_OSAL_PTR * pPipe,
+	    TIMM_OSAL_U32 pipeSize,
+	    TIMM_OSAL_U32 messageSize, TIMM_OSAL_U8 isFixedMessage,
+	    TIMM_OSAL_PIPE_BACKEND eBackend);
+
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeletePipe(TIMM_OSAL_PTR pPipe);
 
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToPipe(TIMM_OSAL_PTR pPipe,
@@ -74,6 +94,10 @@ extern "C"
 	    TIMM_OSAL_U32 size,
 	    TIMM_OSAL_U32 * actualSize, TIMM_OSAL_S32 timeout);
 
+	TIMM_OSAL_ERRORTYPE TIMM_OSAL_ReadManyFromPipe(TIMM_OSAL_PTR pPipe,
+	    void *pMessages, TIMM_OSAL_U32 msgSize, TIMM_OSAL_U32 maxMsgs,
+	    TIMM_OSAL_U32 * count, TIMM_OSAL_S32 timeout);
+
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_ClearPipe(TIMM_OSAL_PTR pPipe);
 
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_IsPipeReady(TIMM_OSAL_PTR pPipe);
@@ -71,6 +71,37 @@ extern "C"
 
 
 
+/**
+* Scheduling policy of a task.  TIMM_OSAL_SCHED_INHERIT leaves policy and
+* priority as inherited from the creating thread.
+*/
+	typedef enum TIMM_OSAL_SCHED_POLICY
+	{
+		TIMM_OSAL_SCHED_INHERIT = 0,
+		TIMM_OSAL_SCHED_OTHER,
+		TIMM_OSAL_SCHED_FIFO,
+		TIMM_OSAL_SCHED_RR
+	} TIMM_OSAL_SCHED_POLICY;
+
+/**
+* Scheduling of a task
+* ePolicy   : see TIMM_OSAL_SCHED_POLICY
+* nPriority : real time priority, 1 to 99, for SCHED_FIFO and SCHED_RR
+* nNice     : nice value, -20 to 19, for SCHED_OTHER
+* uCpuMask  : bit n allows CPU n, 0 allows all of them
+*/
+	typedef struct TIMM_OSAL_TASK_PARAMS
+	{
+		TIMM_OSAL_SCHED_POLICY ePolicy;
+		TIMM_OSAL_S32 nPriority;
+		TIMM_OSAL_S32 nNice;
+		TIMM_OSAL_U32 uCpuMask;
+	} TIMM_OSAL_TASK_PARAMS;
+
+/**
+* uPriority is not applied, the task inherits the scheduling of its creator.
+* Use TIMM_OSAL_CreateTaskEx() to choose it.  pName names the thread.
+*/
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateTask(TIMM_OSAL_PTR * pTask,
 	    TIMM_OSAL_TaskProc pFunc,
 	    TIMM_OSAL_U32 uArgc,
@@ -78,6 +109,24 @@ extern "C"
 	    TIMM_OSAL_U32 uStackSize,
 	    TIMM_OSAL_U32 uPriority, TIMM_OSAL_S8 * pName);
 
+/**
+* Like TIMM_OSAL_CreateTask() with the scheduling of pParams, NULL to
+* inherit it.  The task is named and placed before pFunc runs.
+*/
+	TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateTaskEx(TIMM_OSAL_PTR * pTask,
+	    TIMM_OSAL_TaskProc pFunc,
+	    TIMM_OSAL_U32 uArgc,
+	    TIMM_OSAL_PTR pArgv,
+	    TIMM_OSAL_U32 uStackSize,
+	    const TIMM_OSAL_TASK_PARAMS * pParams, const TIMM_OSAL_S8 * pName);
+
+/**
+* Applies pParams (may be NULL) and pName (may be NULL, 15 characters are
+* kept) to the calling thread.  For threads not created through the OSAL.
+*/
+	TIMM_OSAL_ERRORTYPE TIMM_OSAL_SetTaskParams(const TIMM_OSAL_TASK_PARAMS *
+	    pParams, const TIMM_OSAL_S8 * pName);
+
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeleteTask(TIMM_OSAL_PTR pTask);
 
 	TIMM_OSAL_ERRORTYPE TIMM_OSAL_SleepTask(TIMM_OSAL_U32 mSec);
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+*  @file timm_osal_time.h
+*  Deadline and condition variable helpers shared by the OSAL timed waits.
+*  Timeouts are counted on CLOCK_MONOTONIC so that setting the wall clock
+*  does not stretch or cut them. Not part of the public API.
+*  @path
+*
+*/
+/* -------------------------------------------------------------------------- */
+
+#ifndef _TIMM_OSAL_TIME_H_
+#define _TIMM_OSAL_TIME_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif				/* __cplusplus */
+
+/*******************************************************************************
+* Includes
+*******************************************************************************/
+
+#include <time.h>
+#include <pthread.h>
+
+#include "timm_osal_types.h"
+
+/**
+ * Absolute deadline uTimeOutMsec from now on clock nClock.
+ */
+	static inline void TIMM_OSAL_Deadline(struct timespec *pDeadline,
+	    clockid_t nClock, TIMM_OSAL_U32 uTimeOutMsec)
+	{
+		clock_gettime(nClock, pDeadline);
+		pDeadline->tv_sec += uTimeOutMsec / 1000;
+		pDeadline->tv_nsec += (uTimeOutMsec % 1000) * 1000000;
+		if (pDeadline->tv_nsec >= 1000000000)
+		{
+			pDeadline->tv_sec++;
+			pDeadline->tv_nsec -= 1000000000;
+		}
+	}
+
+/**
+ * Initialises pCond for timed waits against CLOCK_MONOTONIC deadlines.
+ */
+	static inline int TIMM_OSAL_CondInit(pthread_cond_t * pCond)
+	{
+		pthread_condattr_t tAttr;
+		int status = 0;
+
+		status = pthread_condattr_init(&tAttr);
+		if (status != 0)
+			return status;
+		status = pthread_condattr_setclock(&tAttr, CLOCK_MONOTONIC);
+		if (status == 0)
+			status = pthread_cond_init(pCond, &tAttr);
+		pthread_condattr_destroy(&tAttr);
+		return status;
+	}
+
+#ifdef __cplusplus
+}
+#endif				/* __cplusplus */
+
+#endif				/* _TIMM_OSAL_TIME_H_ */
@@ -102,6 +102,16 @@ extern "C"
 * are enabled.
 */
 
+/**
+* Traces above TIMM_OSAL_DEBUG_TRACE_LEVEL_MAX are compiled out, the call site
+* and its arguments are dropped by the compiler.  Release builds set it to 2,
+* so only errors and warnings remain there and the runtime level picks among
+* them.  The default keeps every level.
+*/
+#ifndef TIMM_OSAL_DEBUG_TRACE_LEVEL_MAX
+#define TIMM_OSAL_DEBUG_TRACE_LEVEL_MAX TIMM_OSAL_TRACE_LEVEL_ENTERING
+#endif
+
 /**
  * Information about the trace location/type, passed as a single pointer to
  * internal trace function.  Not part of the public API
@@ -116,6 +126,12 @@ extern "C"
 	} __TIMM_OSAL_TRACE_LOCATION;
 
 
+/**
+ * Runtime trace level, -1 until the first trace or
+ * TIMM_OSAL_UpdateTraceLevel() sets it.  Not part of public API.
+ */
+	extern int __TIMM_OSAL_TraceLevel;
+
 /**
  * Trace level update function.  Updates trace level if env variable
  * or Android property is set. Env variable has precedence over it
@@ -135,10 +151,14 @@ extern "C"
  */
 #define __TIMM_OSAL_Trace(level, tracegrp, fmt, ...)                          \
     do {                                                                      \
-        static const __TIMM_OSAL_TRACE_LOCATION loc = {                       \
-                __FILE__, __FUNCTION__, __LINE__, (level), (tracegrp)         \
-        };                                                                    \
-        __TIMM_OSAL_TraceFunction(&loc, fmt"\n", ##__VA_ARGS__);              \
+        if ((level) <= TIMM_OSAL_DEBUG_TRACE_LEVEL_MAX &&                     \
+            ((level) <= __TIMM_OSAL_TraceLevel ||                             \
+             __TIMM_OSAL_TraceLevel < 0)) {                                   \
+            static const __TIMM_OSAL_TRACE_LOCATION loc = {                   \
+                    __FILE__, __FUNCTION__, __LINE__, (level), (tracegrp)     \
+            };                                                                \
+            __TIMM_OSAL_TraceFunction(&loc, fmt"\n", ##__VA_ARGS__);          \
+        }                                                                     \
     } while(0)
 
 /**
@@ -210,6 +230,48 @@ extern "C"
 #define TIMM_OSAL_ExitingExt(tracegrp, fmt, ...)  __TIMM_OSAL_Trace(TIMM_OSAL_TRACE_LEVEL_EXITING, tracegrp, "EXIT: "fmt, ##__VA_ARGS__)
 
 
+/*******************************************************************************
+** Trace markers
+*******************************************************************************/
+
+/**
+ * Begin/end pairs written to the kernel trace_marker in the format systrace
+ * parses, so that A9 side activity lines up with SurfaceFlinger and the
+ * rpmsg driver in one capture. Off by default, enabled by the env variable
+ * TIMM_OSAL_TRACE_MARKER=1, the property debug.domx.trace_marker=1 or the
+ * atrace video tag. Disabled markers cost a load and a branch.
+ */
+	extern int __TIMM_OSAL_TraceMarkerFd;
+
+/**
+ * Trace marker update function.  Re-reads the enable flags, called on
+ * component creation. Env variable has precedence over the properties
+ */
+	void TIMM_OSAL_UpdateTraceMarker(void);
+
+/**
+ * Trace marker implementation functions.  Not part of public API.
+ */
+	void __TIMM_OSAL_TraceMarkerBegin(const char *name, unsigned int arg);
+	void __TIMM_OSAL_TraceMarkerEnd(void);
+
+/**
+* TIMM_OSAL_TraceMarkerBegin() -- open a slice named name, arg is appended
+*                                 in hex when non zero
+* TIMM_OSAL_TraceMarkerEnd()   -- close the last slice opened by the thread
+*/
+#define TIMM_OSAL_TraceMarkerBegin(name, arg)                                 \
+    do {                                                                      \
+        if (__TIMM_OSAL_TraceMarkerFd >= 0)                                   \
+            __TIMM_OSAL_TraceMarkerBegin((name), (unsigned int)(arg));        \
+    } while(0)
+#define TIMM_OSAL_TraceMarkerEnd()                                            \
+    do {                                                                      \
+        if (__TIMM_OSAL_TraceMarkerFd >= 0)                                   \
+            __TIMM_OSAL_TraceMarkerEnd();                                     \
+    } while(0)
+
+
 #ifdef __cplusplus
 }
 #endif				/* __cplusplus */
@@ -51,26 +51,69 @@
 * Includes
 ******************************************************************************/
 #include <stdio.h>
-#include <pthread.h>		/*for POSIX calls */
-#include <sys/time.h>
 #include <errno.h>
+#include <limits.h>
 
 #include "timm_osal_types.h"
 #include "timm_osal_trace.h"
 #include "timm_osal_error.h"
 #include "timm_osal_memory.h"
 #include "timm_osal_events.h"
+#include "timm_osal_futex.h"
 
 
+/*Set and Retrieve only take the futex path when a Retrieve has to sleep.
+  Waiters sleep on nSeq, which every Set bumps, and Set only wakes when
+  nWaiters says someone may be asleep*/
 typedef struct
 {
-	TIMM_OSAL_BOOL bSignaled;
-	TIMM_OSAL_U32 eFlags;
-	pthread_mutex_t mutex;
-	pthread_cond_t condition;
+	volatile TIMM_OSAL_U32 eFlags;
+	volatile int nSeq;
+	volatile int nWaiters;
 } TIMM_OSAL_THREAD_EVENT;
 
 
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_EventMatch function
+*
+* Checks eFlags against the request and consumes them if asked to, in one
+* atomic step.  On a match the flags as they were go to pRetrievedEvents.
+*/
+/* ========================================================================== */
+static TIMM_OSAL_BOOL TIMM_OSAL_EventMatch(TIMM_OSAL_THREAD_EVENT * plEvent,
+    TIMM_OSAL_U32 uRequestedEvents, TIMM_OSAL_EVENT_OPERATION eOperation,
+    TIMM_OSAL_U32 * pRetrievedEvents)
+{
+	TIMM_OSAL_U32 eFlags = 0;
+	TIMM_OSAL_U32 isolatedFlags = 0;
+	int and_operation = ((TIMM_OSAL_EVENT_AND == eOperation) ||
+	    (TIMM_OSAL_EVENT_AND_CONSUME == eOperation));
+	int consume = ((TIMM_OSAL_EVENT_AND_CONSUME == eOperation) ||
+	    (TIMM_OSAL_EVENT_OR_CONSUME == eOperation));
+
+	do
+	{
+		eFlags = plEvent->eFlags;
+
+		/* Isolate the flags. The & operation is suffice for an TIMM_OSAL_EVENT_OR eOperation */
+		isolatedFlags = eFlags & uRequestedEvents;
+
+		/*Check if it is the AND operation. If yes then, all the flags must match */
+		if (and_operation)
+		{
+			isolatedFlags = (isolatedFlags == uRequestedEvents);
+		}
+		if (!isolatedFlags)
+			return TIMM_OSAL_FALSE;
+	} while (consume &&
+	    !__sync_bool_compare_and_swap(&(plEvent->eFlags), eFlags, 0));
+
+	*pRetrievedEvents = eFlags;
+	return TIMM_OSAL_TRUE;
+}
+
+
 /* ========================================================================== */
 /**
 * @fn TIMM_OSAL_EventCreate function
@@ -92,32 +135,13 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_EventCreate(TIMM_OSAL_PTR * pEvents)
 		bReturnStatus = TIMM_OSAL_ERR_ALLOC;
 		goto EXIT;
 	}
-	plEvent->bSignaled = TIMM_OSAL_FALSE;
 	plEvent->eFlags = 0;
+	plEvent->nSeq = 0;
+	plEvent->nWaiters = 0;
 
-	if (SUCCESS != pthread_mutex_init(&(plEvent->mutex), NULL))
-	{
-		TIMM_OSAL_Error("Event Create:Mutex Init failed !");
-		goto EXIT;	/*bReturnStatus = TIMM_OSAL_ERR_UNKNOWN */
-	}
-
-	if (SUCCESS != pthread_cond_init(&(plEvent->condition), NULL))
-	{
-		TIMM_OSAL_Error
-		    ("Event Create:Conditional Variable  Init failed !");
-		pthread_mutex_destroy(&(plEvent->mutex));
-		/*TIMM_OSAL_Free(plEvent); */
-	} else
-	{
-		*pEvents = (TIMM_OSAL_PTR) plEvent;
-		bReturnStatus = TIMM_OSAL_ERR_NONE;
-	}
+	*pEvents = (TIMM_OSAL_PTR) plEvent;
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
       EXIT:
-	if ((TIMM_OSAL_ERR_NONE != bReturnStatus) &&
-	    (TIMM_OSAL_NULL != plEvent))
-	{
-		TIMM_OSAL_Free(plEvent);
-	}
 	return bReturnStatus;
 }
 
@@ -139,27 +163,9 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_EventDelete(TIMM_OSAL_PTR pEvents)
 		goto EXIT;
 	}
 
-	if (SUCCESS != pthread_mutex_lock(&(plEvent->mutex)))
+	if (plEvent->nWaiters != 0)
 	{
-		TIMM_OSAL_Error("Event Delete: Mutex Lock failed !");
-		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	}
-	if (SUCCESS != pthread_cond_destroy(&(plEvent->condition)))
-	{
-		TIMM_OSAL_Error
-		    ("Event Delete: Conditional Variable Destroy failed !");
-		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	}
-
-	if (SUCCESS != pthread_mutex_unlock(&(plEvent->mutex)))
-	{
-		TIMM_OSAL_Error("Event Delete: Mutex Unlock failed !");
-		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	}
-
-	if (SUCCESS != pthread_mutex_destroy(&(plEvent->mutex)))
-	{
-		TIMM_OSAL_Error("Event Delete: Mutex Destory failed !");
+		TIMM_OSAL_Error("Event Delete: threads still waiting !");
 		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	}
 
@@ -189,45 +195,29 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_EventSet(TIMM_OSAL_PTR pEvents,
 		goto EXIT;
 	}
 
-	if (SUCCESS != pthread_mutex_lock(&(plEvent->mutex)))
-	{
-		TIMM_OSAL_Error("Event Set: Mutex Lock failed !");
-		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-		goto EXIT;
-	}
-
 	switch (eOperation)
 	{
 	case TIMM_OSAL_EVENT_AND:
-		plEvent->eFlags = plEvent->eFlags & uEventFlags;
+		__sync_fetch_and_and(&(plEvent->eFlags), uEventFlags);
 		break;
 	case TIMM_OSAL_EVENT_OR:
-		plEvent->eFlags = plEvent->eFlags | uEventFlags;
+		__sync_fetch_and_or(&(plEvent->eFlags), uEventFlags);
 		break;
 	default:
 		TIMM_OSAL_Error("Event Set: Bad eOperation !");
 		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
-		pthread_mutex_unlock(&plEvent->mutex);
 		goto EXIT;
 	}
 
-	plEvent->bSignaled = TIMM_OSAL_TRUE;
-
-	if (SUCCESS != pthread_cond_signal(&plEvent->condition))
+	/*A waiter announces itself before it samples nSeq, so it either sees
+	  the new flags or a changed nSeq */
+	__sync_fetch_and_add(&(plEvent->nSeq), 1);
+	if (plEvent->nWaiters != 0)
 	{
-		TIMM_OSAL_Error
-		    ("Event Set: Condition Variable Signal failed !");
-		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-		pthread_mutex_unlock(&plEvent->mutex);
-		goto EXIT;
+		/*Waiters may be after different flags, let all of them look */
+		TIMM_OSAL_FutexWake(&(plEvent->nSeq), INT_MAX);
 	}
-
-	if (SUCCESS != pthread_mutex_unlock(&plEvent->mutex))
-	{
-		TIMM_OSAL_Error("Event Set: Mutex Unlock failed !");
-		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	} else
-		bReturnStatus = TIMM_OSAL_ERR_NONE;
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
 
       EXIT:
 	return bReturnStatus;
@@ -239,26 +229,10 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_EventSet(TIMM_OSAL_PTR pEvents,
 /**
 * @fn TIMM_OSAL_EventRetrieve function
 *
-*Spurious  wakeups  from  the  pthread_cond_timedwait() or pthread_cond_wait() functions  may  occur.
-*
-*A representative sequence for using condition variables is shown below
-*
-*Thread A (Retrieve Events)							|Thread B (Set Events)
-*------------------------------------------------------------------------------------------------------------
-*1) Do work up to the point where a certain condition 	|1)Do work
-*  must occur (such as "count" must reach a specified 	|2)Lock associated mutex
-*  value)											|3)Change the value of the global variable
-*2) Lock associated mutex and check value of a global 	|  that Thread-A is waiting upon.
-*  variable										|4)Check value of the global Thread-A wait
-*3) Call pthread_cond_wait() to perform a blocking wait 	|  variable. If it fulfills the desired
-*  for signal from Thread-B. Note that a call to 			|  condition, signal Thread-A.
-*  pthread_cond_wait() automatically and atomically 		|5)Unlock mutex.
-*  unlocks the associated mutex variable so that it can 	|6)Continue
-*  be used by Thread-B.							|
-*4) When signalled, wake up. Mutex is automatically and 	|
-*  atomically locked.								|
-*5) Explicitly unlock mutex							|
-*6) Continue										|
+* Returns at once when the requested combination of flags is already set.
+* Otherwise the caller sleeps on the futex until a TIMM_OSAL_EventSet()
+* brings the flags it asked for or uTimeOutMsec, counted on CLOCK_MONOTONIC,
+* runs out.  A timeout returns TIMM_OSAL_ERR_NONE with no events retrieved.
 *
 */
 /* ========================================================================== */
@@ -268,12 +242,8 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_EventRetrieve(TIMM_OSAL_PTR pEvents,
     TIMM_OSAL_U32 * pRetrievedEvents, TIMM_OSAL_U32 uTimeOutMsec)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	struct timespec timeout;
-	struct timeval now;
-	TIMM_OSAL_U32 timeout_us;
-	TIMM_OSAL_U32 isolatedFlags;
-	int status = -1;
-	int and_operation;
+	struct timespec deadline, *pDeadline = NULL;
+	int nSeq = 0;
 	TIMM_OSAL_THREAD_EVENT *plEvent = (TIMM_OSAL_THREAD_EVENT *) pEvents;
 
 	if (TIMM_OSAL_NULL == plEvent)
@@ -282,137 +252,45 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_EventRetrieve(TIMM_OSAL_PTR pEvents,
 		goto EXIT;
 	}
 
-	/* Lock the mutex for access to the eFlags global variable */
-	if (SUCCESS != pthread_mutex_lock(&(plEvent->mutex)))
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
+	if (TIMM_OSAL_EventMatch(plEvent, uRequestedEvents, eOperation,
+		pRetrievedEvents))
 	{
-		TIMM_OSAL_Error("Event Retrieve: Mutex Lock failed !");
-		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 		goto EXIT;
 	}
 
-	/*Check the eOperation and put it in a variable */
-	and_operation = ((TIMM_OSAL_EVENT_AND == eOperation) ||
-	    (TIMM_OSAL_EVENT_AND_CONSUME == eOperation));
-
-	/* Isolate the flags. The & operation is suffice for an TIMM_OSAL_EVENT_OR eOperation */
-	isolatedFlags = plEvent->eFlags & uRequestedEvents;
-
-	/*Check if it is the AND operation. If yes then, all the flags must match */
-	if (and_operation)
+	/*Required combination of bits is not yet available */
+	if (TIMM_OSAL_NO_SUSPEND == uTimeOutMsec)
 	{
-		isolatedFlags = (isolatedFlags == uRequestedEvents);
+		*pRetrievedEvents = 0;
+		goto EXIT;
 	}
 
-
-	if (isolatedFlags)
+	if (TIMM_OSAL_SUSPEND != uTimeOutMsec)
 	{
+		TIMM_OSAL_Deadline(&deadline, CLOCK_MONOTONIC, uTimeOutMsec);
+		pDeadline = &deadline;
+	}
 
-		/*We have got required combination of the eFlags bits and will return it back */
-		*pRetrievedEvents = plEvent->eFlags;
-		bReturnStatus = TIMM_OSAL_ERR_NONE;
-	} else
+	__sync_fetch_and_add(&(plEvent->nWaiters), 1);
+	for (;;)
 	{
+		nSeq = plEvent->nSeq;
+		if (TIMM_OSAL_EventMatch(plEvent, uRequestedEvents, eOperation,
+			pRetrievedEvents))
+			break;
 
-		/*Required combination of bits is not yet available */
-		if (TIMM_OSAL_NO_SUSPEND == uTimeOutMsec)
+		if (ETIMEDOUT == TIMM_OSAL_FutexWait(&(plEvent->nSeq), nSeq,
+			pDeadline))
 		{
-			*pRetrievedEvents = 0;
-			bReturnStatus = TIMM_OSAL_ERR_NONE;
+			/*One last look, a Set may have raced with the timeout */
+			if (!TIMM_OSAL_EventMatch(plEvent, uRequestedEvents,
+				eOperation, pRetrievedEvents))
+				*pRetrievedEvents = 0;
+			break;
 		}
-
-		else if (TIMM_OSAL_SUSPEND == uTimeOutMsec)
-		{
-
-			/*Wait till we get the required combination of bits. We we get the required
-			 *bits then we go out of the while loop
-			 */
-			while (!isolatedFlags)
-			{
-
-				/*Wait on the conditional variable for another thread to set the eFlags and signal */
-				pthread_cond_wait(&(plEvent->condition),
-				    &(plEvent->mutex));
-
-				/* eFlags set by some thread. Now, isolate the flags.
-				 * The & operation is suffice for an TIMM_OSAL_EVENT_OR eOperation
-				 */
-				isolatedFlags =
-				    plEvent->eFlags & uRequestedEvents;
-
-				/*Check if it is the AND operation. If yes then, all the flags must match */
-				if (and_operation)
-				{
-					isolatedFlags =
-					    (isolatedFlags ==
-					    uRequestedEvents);
-				}
-			}
-
-			/* Obtained the requested combination of bits on eFlags */
-			*pRetrievedEvents = plEvent->eFlags;
-			bReturnStatus = TIMM_OSAL_ERR_NONE;
-
-		} else
-		{
-
-			/* Calculate uTimeOutMsec in terms of the absolute time. uTimeOutMsec is in milliseconds */
-			gettimeofday(&now, NULL);
-			timeout_us = now.tv_usec + 1000 * uTimeOutMsec;
-			timeout.tv_sec = now.tv_sec + timeout_us / 1000000;
-			timeout.tv_nsec = (timeout_us % 1000000) * 1000;
-
-			while (!isolatedFlags)
-			{
-
-				/* Wait till uTimeOutMsec for a thread to signal on the conditional variable */
-				status =
-				    pthread_cond_timedwait(&(plEvent->
-					condition), &(plEvent->mutex),
-				    &timeout);
-
-				/*Timedout or error and returned without being signalled */
-				if (SUCCESS != status)
-				{
-					if (ETIMEDOUT == status)
-						bReturnStatus =
-						    TIMM_OSAL_ERR_NONE;
-					*pRetrievedEvents = 0;
-					break;
-				}
-
-				/* eFlags set by some thread. Now, isolate the flags.
-				 * The & operation is suffice for an TIMM_OSAL_EVENT_OR eOperation
-				 */
-				isolatedFlags =
-				    plEvent->eFlags & uRequestedEvents;
-
-				/*Check if it is the AND operation. If yes then, all the flags must match */
-				if (and_operation)
-				{
-					isolatedFlags =
-					    (isolatedFlags ==
-					    uRequestedEvents);
-				}
-
-			}
-		}
-	}
-
-	/*If we have got the required combination of bits, we will have to reset the eFlags if CONSUME is mentioned
-	 *in the eOperations
-	 */
-	if (isolatedFlags && ((eOperation == TIMM_OSAL_EVENT_AND_CONSUME) ||
-		(eOperation == TIMM_OSAL_EVENT_OR_CONSUME)))
-	{
-		plEvent->eFlags = 0;
-	}
-
-	/*Manually unlock the mutex */
-	if (SUCCESS != pthread_mutex_unlock(&(plEvent->mutex)))
-	{
-		TIMM_OSAL_Error("Event Retrieve: Mutex Unlock failed !");
-		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	}
+	__sync_fetch_and_sub(&(plEvent->nWaiters), 1);
 
       EXIT:
 	return bReturnStatus;
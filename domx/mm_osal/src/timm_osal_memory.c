@@ -51,8 +51,22 @@
 * Includes
 ******************************************************************************/
 
+/*dladdr() on glibc, bionic has it anyway*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <string.h>
 #include <malloc.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <dlfcn.h>
+
+#ifdef _Android
+#include <cutils/properties.h>
+#endif
 
 #ifdef __KERNEL__
 #include <linux/types.h>
@@ -70,6 +84,374 @@
 
 static TIMM_OSAL_U32 gMallocCounter = 0;
 
+/*Small allocations are served from size classes of 32, 64, 128 and 256
+  bytes carved out of one mapping, so that the callback threads of the
+  proxies do not meet in the heap lock for their mark data, buffer headers
+  and the like. A class that runs dry falls back to the heap*/
+#define TIMM_OSAL_SLAB_NUM_CLASSES 4
+#define TIMM_OSAL_SLAB_MIN_SHIFT 5
+#define TIMM_OSAL_SLAB_MAX_SIZE \
+    (1 << (TIMM_OSAL_SLAB_MIN_SHIFT + TIMM_OSAL_SLAB_NUM_CLASSES - 1))
+#define TIMM_OSAL_SLAB_NUM_OBJS 1024
+#define TIMM_OSAL_SLAB_EMPTY 0xFFFF
+
+/*nHead holds a change count in the upper 16 bits so that a head that was
+  popped and pushed back in between is not mistaken for an unchanged one*/
+#define TIMM_OSAL_SLAB_NEXT_HEAD(nHead, nIndex) \
+    ((((nHead) + 0x10000) & 0xFFFF0000) | (nIndex))
+
+typedef struct TIMM_OSAL_SLAB_CLASS
+{
+	volatile TIMM_OSAL_U32 nHead;
+	TIMM_OSAL_U32 nObjSize;
+	TIMM_OSAL_U8 *pObjs;
+	TIMM_OSAL_U16 nNext[TIMM_OSAL_SLAB_NUM_OBJS];
+} TIMM_OSAL_SLAB_CLASS;
+
+static TIMM_OSAL_SLAB_CLASS gSlabClass[TIMM_OSAL_SLAB_NUM_CLASSES];
+static TIMM_OSAL_U8 *gSlabBase = NULL;
+static TIMM_OSAL_U8 *gSlabEnd = NULL;
+static pthread_once_t gSlabOnce = PTHREAD_ONCE_INIT;
+
+/*Fixed size objects of one owner, see TIMM_OSAL_CreateArena*/
+#define TIMM_OSAL_ARENA_CHUNK_OBJS 16
+
+typedef struct TIMM_OSAL_ARENA
+{
+	pthread_mutex_t tLock;
+	TIMM_OSAL_U32 nObjSize;
+	TIMM_OSAL_U32 nAlign;
+	TIMM_OSAL_PTR pFree;	/*free objects, linked through their first word */
+	TIMM_OSAL_PTR pChunks;	/*chunks, linked through their first word */
+} TIMM_OSAL_ARENA;
+
+/*Arena objects start after the chunk link, at malloc alignment unless the
+  arena asks for more*/
+#define TIMM_OSAL_ARENA_ALIGN 8
+#define TIMM_OSAL_ARENA_ROUND(x, a) (((x) + (a) - 1) & ~((uintptr_t) (a) - 1))
+
+/*Allocation accounting, off unless TIMM_OSAL_MEM_ACCOUNTING=1 or
+  debug.domx.mem_accounting=1 is set when the first allocation is made.
+  Every block then carries a tag in front of the returned pointer naming
+  its size, segment and call site. Changing debug.domx.mem_dump dumps the
+  counters, so does TIMM_OSAL_DumpMemStats()*/
+#define TIMM_OSAL_MEM_TAG_MAGIC 0x4D454D54	/* "MEMT" */
+#define TIMM_OSAL_MEM_NUM_SEGMENTS (TIMMOSAL_MEM_SEGMENT_UNCACHED + 1)
+#define TIMM_OSAL_MEM_NUM_SITES 256
+#define TIMM_OSAL_MEM_SITE_NONE 0xFFFF
+/*debug.domx.mem_dump is looked at once per this many allocations*/
+#define TIMM_OSAL_MEM_DUMP_POLL 4096
+#define TIMM_OSAL_MEM_DEFAULT_FILE "/data/local/tmp/domx_mem.txt"
+
+typedef struct TIMM_OSAL_MEM_TAG
+{
+	TIMM_OSAL_U32 nMagic;
+	TIMM_OSAL_U32 nSize;
+	TIMM_OSAL_U32 nOffset;	/*from the start of the block */
+	TIMM_OSAL_U16 nSite;
+	TIMM_OSAL_U16 nSegment;
+} TIMM_OSAL_MEM_TAG;
+
+typedef struct TIMM_OSAL_MEM_STATS
+{
+	volatile TIMM_OSAL_U32 nLive;	/*bytes */
+	volatile TIMM_OSAL_U32 nPeak;	/*bytes */
+	volatile TIMM_OSAL_U32 nBlocks;	/*live blocks */
+	volatile TIMM_OSAL_U32 nAllocs;	/*since start */
+	TIMM_OSAL_U32 nAllocsDumped;	/*nAllocs at the last dump */
+} TIMM_OSAL_MEM_STATS;
+
+static TIMM_OSAL_BOOL gMemAccounting = TIMM_OSAL_FALSE;
+static TIMM_OSAL_MEM_STATS gSegmentStats[TIMM_OSAL_MEM_NUM_SEGMENTS];
+static TIMM_OSAL_MEM_STATS gSiteStats[TIMM_OSAL_MEM_NUM_SITES];
+static void *volatile gSiteAddr[TIMM_OSAL_MEM_NUM_SITES];
+static volatile TIMM_OSAL_U32 gMemDumpPoll = 0;
+static struct timespec gMemDumpTime;
+static pthread_mutex_t gMemDumpLock = PTHREAD_MUTEX_INITIALIZER;
+#ifdef _Android
+static char gMemDumpValue[PROPERTY_VALUE_MAX];
+#endif
+
+/******************************************************************************
+* Size class helpers
+******************************************************************************/
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_SlabInit function
+*
+* Maps the size classes and threads every object onto its class free list.
+* If the mapping fails all classes stay empty and TIMM_OSAL_Malloc() uses
+* the heap only.
+*/
+/* ========================================================================== */
+
+static void TIMM_OSAL_SlabInit(void)
+{
+	TIMM_OSAL_U32 nTotal = 0, i = 0, j = 0;
+	TIMM_OSAL_U8 *pBase = NULL;
+
+	for (i = 0; i < TIMM_OSAL_SLAB_NUM_CLASSES; i++)
+	{
+		gSlabClass[i].nHead = TIMM_OSAL_SLAB_EMPTY;
+		gSlabClass[i].nObjSize = 1 << (TIMM_OSAL_SLAB_MIN_SHIFT + i);
+		nTotal += gSlabClass[i].nObjSize * TIMM_OSAL_SLAB_NUM_OBJS;
+	}
+
+	/*Pages are only backed once an object on them is handed out */
+	pBase = mmap(NULL, nTotal, PROT_READ | PROT_WRITE,
+	    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pBase == MAP_FAILED)
+	{
+		TIMM_OSAL_Warning("Size classes not mapped, using the heap only");
+		return;
+	}
+
+	gSlabBase = pBase;
+	for (i = 0; i < TIMM_OSAL_SLAB_NUM_CLASSES; i++)
+	{
+		gSlabClass[i].pObjs = pBase;
+		for (j = 0; j < TIMM_OSAL_SLAB_NUM_OBJS - 1; j++)
+			gSlabClass[i].nNext[j] = j + 1;
+		gSlabClass[i].nNext[j] = TIMM_OSAL_SLAB_EMPTY;
+		gSlabClass[i].nHead = 0;
+		pBase += gSlabClass[i].nObjSize * TIMM_OSAL_SLAB_NUM_OBJS;
+	}
+	gSlabEnd = pBase;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_SlabAlloc function
+*
+* Pops an object of at least size bytes, NULL when the class ran dry.
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_PTR TIMM_OSAL_SlabAlloc(TIMM_OSAL_U32 size)
+{
+	TIMM_OSAL_SLAB_CLASS *pClass = gSlabClass;
+	TIMM_OSAL_U32 nHead = 0, nIndex = 0;
+
+	while (pClass->nObjSize < size)
+		pClass++;
+
+	do
+	{
+		nHead = pClass->nHead;
+		nIndex = nHead & 0xFFFF;
+		if (nIndex == TIMM_OSAL_SLAB_EMPTY)
+			return TIMM_OSAL_NULL;
+	} while (!__sync_bool_compare_and_swap(&(pClass->nHead), nHead,
+		TIMM_OSAL_SLAB_NEXT_HEAD(nHead, pClass->nNext[nIndex])));
+
+	return pClass->pObjs + nIndex * pClass->nObjSize;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_SlabFree function
+*
+* Pushes pData back on the free list of its class.  pData must lie within
+* gSlabBase and gSlabEnd.
+*/
+/* ========================================================================== */
+
+static void TIMM_OSAL_SlabFree(TIMM_OSAL_PTR pData)
+{
+	TIMM_OSAL_SLAB_CLASS *pClass = gSlabClass;
+	TIMM_OSAL_U32 nHead = 0, nIndex = 0;
+
+	while ((TIMM_OSAL_U8 *) pData >= pClass->pObjs +
+	    pClass->nObjSize * TIMM_OSAL_SLAB_NUM_OBJS)
+		pClass++;
+	nIndex = ((TIMM_OSAL_U8 *) pData - pClass->pObjs) / pClass->nObjSize;
+
+	do
+	{
+		nHead = pClass->nHead;
+		pClass->nNext[nIndex] = nHead & 0xFFFF;
+	} while (!__sync_bool_compare_and_swap(&(pClass->nHead), nHead,
+		TIMM_OSAL_SLAB_NEXT_HEAD(nHead, nIndex)));
+}
+
+
+
+/******************************************************************************
+* Accounting helpers
+******************************************************************************/
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MemAccountingInit function
+*
+* Reads whether accounting is on.  Must run before the first allocation,
+* blocks handed out untagged cannot be accounted for later.
+*/
+/* ========================================================================== */
+
+static void TIMM_OSAL_MemAccountingInit(void)
+{
+	char *val = getenv("TIMM_OSAL_MEM_ACCOUNTING");
+
+	if (val)
+	{
+		gMemAccounting = strtol(val, NULL, 0) ? TIMM_OSAL_TRUE :
+		    TIMM_OSAL_FALSE;
+	}
+#ifdef _Android
+	else
+	{
+		char value[PROPERTY_VALUE_MAX];
+
+		property_get("debug.domx.mem_accounting", value, "0");
+		gMemAccounting = atoi(value) ? TIMM_OSAL_TRUE : TIMM_OSAL_FALSE;
+	}
+	/*Only a change of the dump property triggers a dump */
+	property_get("debug.domx.mem_dump", gMemDumpValue, "");
+#endif
+	clock_gettime(CLOCK_MONOTONIC, &gMemDumpTime);
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MemInit function
+*
+* One time setup of the size classes and the accounting.
+*/
+/* ========================================================================== */
+
+static void TIMM_OSAL_MemInit(void)
+{
+	TIMM_OSAL_MemAccountingInit();
+	TIMM_OSAL_SlabInit();
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MemSite function
+*
+* Slot of call site pCaller in gSiteStats, TIMM_OSAL_MEM_SITE_NONE once the
+* table is full.
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_U16 TIMM_OSAL_MemSite(void *pCaller)
+{
+	TIMM_OSAL_U32 nSlot =
+	    ((TIMM_OSAL_U32) (uintptr_t) pCaller >> 2) * 2654435761U >> 24;
+	TIMM_OSAL_U32 i = 0;
+
+	for (i = 0; i < TIMM_OSAL_MEM_NUM_SITES; i++)
+	{
+		void *pSite = gSiteAddr[nSlot];
+
+		if (pSite == pCaller)
+			return nSlot;
+		if (pSite == NULL &&
+		    (__sync_bool_compare_and_swap(&gSiteAddr[nSlot], NULL,
+			pCaller) || gSiteAddr[nSlot] == pCaller))
+			return nSlot;
+		nSlot = (nSlot + 1) & (TIMM_OSAL_MEM_NUM_SITES - 1);
+	}
+	return TIMM_OSAL_MEM_SITE_NONE;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MemStatsAdd function
+*
+* Accounts nSize bytes allocated (bAlloc) or freed on pStats.
+*/
+/* ========================================================================== */
+
+static void TIMM_OSAL_MemStatsAdd(TIMM_OSAL_MEM_STATS * pStats,
+    TIMM_OSAL_U32 nSize, TIMM_OSAL_BOOL bAlloc)
+{
+	TIMM_OSAL_U32 nLive = 0, nPeak = 0;
+
+	if (!bAlloc)
+	{
+		__sync_fetch_and_sub(&pStats->nLive, nSize);
+		__sync_fetch_and_sub(&pStats->nBlocks, 1);
+		return;
+	}
+
+	__sync_fetch_and_add(&pStats->nAllocs, 1);
+	__sync_fetch_and_add(&pStats->nBlocks, 1);
+	nLive = __sync_add_and_fetch(&pStats->nLive, nSize);
+	do
+	{
+		nPeak = pStats->nPeak;
+		if (nLive <= nPeak)
+			break;
+	} while (!__sync_bool_compare_and_swap(&pStats->nPeak, nPeak, nLive));
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MemStatsPrint function
+*
+* Traces one line of counters and appends it to pFile when not NULL.  The
+* rate is over the nElapsedMs since the last dump.
+*/
+/* ========================================================================== */
+
+static void TIMM_OSAL_MemStatsPrint(FILE * pFile, const char *pName,
+    TIMM_OSAL_MEM_STATS * pStats, TIMM_OSAL_U32 nElapsedMs)
+{
+	TIMM_OSAL_U32 nAllocs = pStats->nAllocs;
+	TIMM_OSAL_U32 nRate =
+	    nElapsedMs ? (TIMM_OSAL_U32) ((unsigned long long)(nAllocs -
+		pStats->nAllocsDumped) * 1000 / nElapsedMs) : 0;
+
+	pStats->nAllocsDumped = nAllocs;
+	TIMM_OSAL_Profiling("<MEM> %-40s live=%u blocks=%u peak=%u allocs=%u rate=%u/s",
+	    pName, pStats->nLive, pStats->nBlocks, pStats->nPeak, nAllocs,
+	    nRate);
+	if (pFile)
+		fprintf(pFile, "%-40s live=%u blocks=%u peak=%u allocs=%u rate=%u/s\n",
+		    pName, pStats->nLive, pStats->nBlocks, pStats->nPeak, nAllocs,
+		    nRate);
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MemDumpPoll function
+*
+* Dumps the counters when debug.domx.mem_dump changed since the last look.
+*/
+/* ========================================================================== */
+
+static void TIMM_OSAL_MemDumpPoll(void)
+{
+#ifdef _Android
+	char value[PROPERTY_VALUE_MAX];
+
+	property_get("debug.domx.mem_dump", value, "");
+	if (strcmp(value, gMemDumpValue) == 0)
+		return;
+	strcpy(gMemDumpValue, value);
+	TIMM_OSAL_DumpMemStats();
+#endif
+}
+
+
+
 /******************************************************************************
 * Function Prototypes
 ******************************************************************************/
@@ -78,12 +460,17 @@ static TIMM_OSAL_U32 gMallocCounter = 0;
 /**
 * @fn TIMM_OSAL_createMemoryPool function
 *
-* @see
+* Sets up the size classes behind TIMM_OSAL_Malloc().  Optional, the first
+* TIMM_OSAL_Malloc() does it as well.
 */
 /* ========================================================================== */
 TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateMemoryPool(void)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+
+	pthread_once(&gSlabOnce, TIMM_OSAL_MemInit);
+	if (gSlabBase == NULL)
+		bReturnStatus = TIMM_OSAL_ERR_ALLOC;
 	return bReturnStatus;
 }
 
@@ -93,7 +480,8 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateMemoryPool(void)
 /**
 * @fn TIMM_OSAL_DeleteMemoryPool function
 *
-* @see
+* The size classes are shared by the whole process and live as long as it
+* does, objects freed after this call must still find their class.
 */
 /* ========================================================================== */
 
@@ -106,6 +494,157 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeleteMemoryPool(void)
 
 
 
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_CreateArena function
+*
+* Creates an arena of nObjSize byte objects.  Objects come from chunks that
+* grow on demand, go back to the arena on TIMM_OSAL_ArenaFree() and are all
+* released together by TIMM_OSAL_DeleteArena(), also the ones never freed.
+* With nAlign (a power of two) every object starts and ends on an nAlign
+* boundary, so objects sized to cache lines share none with their neighbours.
+*/
+/* ========================================================================== */
+
+TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateArena(TIMM_OSAL_PTR * phArena,
+    TIMM_OSAL_U32 nObjSize, TIMM_OSAL_U32 nAlign)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+	TIMM_OSAL_ARENA *pArena = TIMM_OSAL_NULL;
+
+	pArena =
+	    (TIMM_OSAL_ARENA *) TIMM_OSAL_Malloc(sizeof(TIMM_OSAL_ARENA), 0, 0,
+	    0);
+	if (TIMM_OSAL_NULL == pArena)
+	{
+		bReturnStatus = TIMM_OSAL_ERR_ALLOC;
+		goto EXIT;
+	}
+	TIMM_OSAL_Memset(pArena, 0x0, sizeof(TIMM_OSAL_ARENA));
+
+	if (SUCCESS != pthread_mutex_init(&pArena->tLock, NULL))
+	{
+		TIMM_OSAL_Error("Arena mutex init failed!!!");
+		TIMM_OSAL_Free(pArena);
+		goto EXIT;
+	}
+	/*The free list is linked through the objects themselves */
+	if (nObjSize < sizeof(TIMM_OSAL_PTR))
+		nObjSize = sizeof(TIMM_OSAL_PTR);
+	if (nAlign < TIMM_OSAL_ARENA_ALIGN)
+		nAlign = TIMM_OSAL_ARENA_ALIGN;
+	pArena->nAlign = nAlign;
+	pArena->nObjSize = TIMM_OSAL_ARENA_ROUND(nObjSize, nAlign);
+
+	*phArena = (TIMM_OSAL_PTR) pArena;
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
+
+      EXIT:
+	return bReturnStatus;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_DeleteArena function
+*
+* Releases the arena with every object it handed out.
+*/
+/* ========================================================================== */
+
+TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeleteArena(TIMM_OSAL_PTR hArena)
+{
+	TIMM_OSAL_ARENA *pArena = (TIMM_OSAL_ARENA *) hArena;
+	TIMM_OSAL_PTR pChunk = TIMM_OSAL_NULL;
+
+	if (TIMM_OSAL_NULL == pArena)
+		return TIMM_OSAL_ERR_PARAMETER;
+
+	while (pArena->pChunks)
+	{
+		pChunk = pArena->pChunks;
+		pArena->pChunks = *(TIMM_OSAL_PTR *) pChunk;
+		TIMM_OSAL_Free(pChunk);
+	}
+	pthread_mutex_destroy(&pArena->tLock);
+	TIMM_OSAL_Free(pArena);
+
+	return TIMM_OSAL_ERR_NONE;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_ArenaAlloc function
+*
+* Returns an object of the arena, adding a chunk if none is free.
+*/
+/* ========================================================================== */
+
+TIMM_OSAL_PTR TIMM_OSAL_ArenaAlloc(TIMM_OSAL_PTR hArena)
+{
+	TIMM_OSAL_ARENA *pArena = (TIMM_OSAL_ARENA *) hArena;
+	TIMM_OSAL_U8 *pChunk = TIMM_OSAL_NULL, *pObj = TIMM_OSAL_NULL;
+	TIMM_OSAL_PTR pData = TIMM_OSAL_NULL;
+	TIMM_OSAL_U32 i = 0;
+
+	pthread_mutex_lock(&pArena->tLock);
+	if (TIMM_OSAL_NULL == pArena->pFree)
+	{
+		pChunk =
+		    (TIMM_OSAL_U8 *) TIMM_OSAL_Malloc(pArena->nAlign +
+		    pArena->nObjSize * TIMM_OSAL_ARENA_CHUNK_OBJS, 0, 0, 0);
+		if (TIMM_OSAL_NULL == pChunk)
+			goto EXIT;
+		*(TIMM_OSAL_PTR *) pChunk = pArena->pChunks;
+		pArena->pChunks = pChunk;
+
+		/*malloc gives at least TIMM_OSAL_ARENA_ALIGN, so the first
+		  aligned address past the link is within nAlign bytes */
+		pObj = (TIMM_OSAL_U8 *) TIMM_OSAL_ARENA_ROUND((uintptr_t)
+		    pChunk + sizeof(TIMM_OSAL_PTR), pArena->nAlign);
+		for (i = 0; i < TIMM_OSAL_ARENA_CHUNK_OBJS; i++)
+		{
+			*(TIMM_OSAL_PTR *) pObj = pArena->pFree;
+			pArena->pFree = pObj;
+			pObj += pArena->nObjSize;
+		}
+	}
+	pData = pArena->pFree;
+	pArena->pFree = *(TIMM_OSAL_PTR *) pData;
+
+      EXIT:
+	pthread_mutex_unlock(&pArena->tLock);
+	return pData;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_ArenaFree function
+*
+* Gives an object obtained through TIMM_OSAL_ArenaAlloc() back to its arena.
+*/
+/* ========================================================================== */
+
+void TIMM_OSAL_ArenaFree(TIMM_OSAL_PTR hArena, TIMM_OSAL_PTR pData)
+{
+	TIMM_OSAL_ARENA *pArena = (TIMM_OSAL_ARENA *) hArena;
+
+	if (TIMM_OSAL_NULL == pData)
+		return;
+
+	pthread_mutex_lock(&pArena->tLock);
+	*(TIMM_OSAL_PTR *) pData = pArena->pFree;
+	pArena->pFree = pData;
+	pthread_mutex_unlock(&pArena->tLock);
+}
+
+
+
 /* ========================================================================== */
 /**
 * @fn TIMM_OSAL_Malloc function
@@ -119,14 +658,35 @@ TIMM_OSAL_PTR TIMM_OSAL_Malloc(TIMM_OSAL_U32 size,
 {
 
 	TIMM_OSAL_PTR pData = TIMM_OSAL_NULL;
+	TIMM_OSAL_U32 nBlockSize = size, nTagSize = 0;
+	TIMM_OSAL_MEM_TAG *pTag = TIMM_OSAL_NULL;
+
+	pthread_once(&gSlabOnce, TIMM_OSAL_MemInit);
+	if (gMemAccounting)
+	{
+		/*The tag keeps the alignment of what follows it */
+		nTagSize = sizeof(TIMM_OSAL_MEM_TAG);
+		if (nTagSize < unBlockAlignment)
+			nTagSize = unBlockAlignment;
+		nBlockSize += nTagSize;
+	}
+
+	/*Class objects are aligned to their size, 32 bytes at least */
+	if (size != 0 && nBlockSize <= TIMM_OSAL_SLAB_MAX_SIZE &&
+	    unBlockAlignment <= (1 << TIMM_OSAL_SLAB_MIN_SHIFT))
+	{
+		pData = TIMM_OSAL_SlabAlloc(nBlockSize);
+		if (TIMM_OSAL_NULL != pData)
+			goto EXIT;
+	}
 
 #ifdef HAVE_MEMALIGN
 	if (0 == unBlockAlignment)
 	{
-		pData = malloc((size_t) size);
+		pData = malloc((size_t) nBlockSize);
 	} else
 	{
-		pData = memalign((size_t) unBlockAlignment, (size_t) size);
+		pData = memalign((size_t) unBlockAlignment, (size_t) nBlockSize);
 	}
 #else
 	if (0 != unBlockAlignment)
@@ -135,15 +695,38 @@ TIMM_OSAL_PTR TIMM_OSAL_Malloc(TIMM_OSAL_U32 size,
 		    ("Memory Allocation:Not done for specified nBufferAlignment. Alignment of 0 will be used");
 
 	}
-	pData = malloc((size_t) size);	/*size_t is long long */
+	pData = malloc((size_t) nBlockSize);	/*size_t is long long */
 #endif
+
+      EXIT:
 	if (TIMM_OSAL_NULL == pData)
 	{
 		TIMM_OSAL_Error("Malloc failed!!!");
 	} else
 	{
 		/* Memory Allocation was successfull */
-		gMallocCounter++;
+		__sync_fetch_and_add(&gMallocCounter, 1);
+	}
+
+	if (TIMM_OSAL_NULL != pData && nTagSize)
+	{
+		pData = (TIMM_OSAL_U8 *) pData + nTagSize;
+		pTag = (TIMM_OSAL_MEM_TAG *) pData - 1;
+		pTag->nMagic = TIMM_OSAL_MEM_TAG_MAGIC;
+		pTag->nSize = size;
+		pTag->nOffset = nTagSize;
+		pTag->nSegment = (TIMM_OSAL_U32) tMemSegId <
+		    TIMM_OSAL_MEM_NUM_SEGMENTS ? tMemSegId : 0;
+		pTag->nSite = TIMM_OSAL_MemSite(__builtin_return_address(0));
+
+		TIMM_OSAL_MemStatsAdd(&gSegmentStats[pTag->nSegment], size,
+		    TIMM_OSAL_TRUE);
+		if (pTag->nSite != TIMM_OSAL_MEM_SITE_NONE)
+			TIMM_OSAL_MemStatsAdd(&gSiteStats[pTag->nSite], size,
+			    TIMM_OSAL_TRUE);
+		if ((__sync_add_and_fetch(&gMemDumpPoll, 1) %
+			TIMM_OSAL_MEM_DUMP_POLL) == 0)
+			TIMM_OSAL_MemDumpPoll();
 	}
 
 
@@ -166,9 +749,32 @@ void TIMM_OSAL_Free(TIMM_OSAL_PTR pData)
 		goto EXIT;
 	}
 
-	free(pData);
+	if (gMemAccounting)
+	{
+		TIMM_OSAL_MEM_TAG *pTag = (TIMM_OSAL_MEM_TAG *) pData - 1;
+
+		if (pTag->nMagic == TIMM_OSAL_MEM_TAG_MAGIC)
+		{
+			TIMM_OSAL_MemStatsAdd(&gSegmentStats[pTag->nSegment],
+			    pTag->nSize, TIMM_OSAL_FALSE);
+			if (pTag->nSite != TIMM_OSAL_MEM_SITE_NONE)
+				TIMM_OSAL_MemStatsAdd(&gSiteStats[pTag->nSite],
+				    pTag->nSize, TIMM_OSAL_FALSE);
+			pTag->nMagic = 0;
+			pData = (TIMM_OSAL_U8 *) pData - pTag->nOffset;
+		} else
+		{
+			TIMM_OSAL_Warning("Freeing untagged block %p", pData);
+		}
+	}
+
+	if ((TIMM_OSAL_U8 *) pData >= gSlabBase &&
+	    (TIMM_OSAL_U8 *) pData < gSlabEnd)
+		TIMM_OSAL_SlabFree(pData);
+	else
+		free(pData);
 	pData = NULL;
-	gMallocCounter--;
+	__sync_fetch_and_sub(&gMallocCounter, 1);
       EXIT:
 	return;
 }
@@ -248,3 +854,67 @@ TIMM_OSAL_U32 TIMM_OSAL_GetMemCounter(void)
 
 	return gMallocCounter;
 }
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_DumpMemStats function ....
+*
+* Traces the accounting counters per segment and per call site, and writes
+* them to debug.domx.mem_stats_file (default /data/local/tmp/domx_mem.txt).
+* Call sites are printed as symbol+offset when dladdr() can resolve them.
+* Does nothing unless accounting is on.
+*/
+/* ========================================================================== */
+
+void TIMM_OSAL_DumpMemStats(void)
+{
+	static const char *segmentName[TIMM_OSAL_MEM_NUM_SEGMENTS] = {
+		"segment EXT", "segment INT", "segment UNCACHED"
+	};
+	char name[64];
+	char file[256] = TIMM_OSAL_MEM_DEFAULT_FILE;
+	FILE *pFile = NULL;
+	struct timespec tNow;
+	TIMM_OSAL_U32 nElapsedMs = 0, i = 0;
+	Dl_info tInfo;
+
+	if (!gMemAccounting)
+		return;
+
+	pthread_mutex_lock(&gMemDumpLock);
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	nElapsedMs = (tNow.tv_sec - gMemDumpTime.tv_sec) * 1000 +
+	    (tNow.tv_nsec - gMemDumpTime.tv_nsec) / 1000000;
+	gMemDumpTime = tNow;
+
+#ifdef _Android
+	property_get("debug.domx.mem_stats_file", file,
+	    TIMM_OSAL_MEM_DEFAULT_FILE);
+#endif
+	pFile = fopen(file, "w");
+	if (pFile)
+		fprintf(pFile, "DOMX memory, %u blocks live, %u ms since the last dump\n",
+		    gMallocCounter, nElapsedMs);
+
+	for (i = 0; i < TIMM_OSAL_MEM_NUM_SEGMENTS; i++)
+		TIMM_OSAL_MemStatsPrint(pFile, segmentName[i], &gSegmentStats[i],
+		    nElapsedMs);
+
+	for (i = 0; i < TIMM_OSAL_MEM_NUM_SITES; i++)
+	{
+		void *pSite = gSiteAddr[i];
+
+		if (pSite == NULL)
+			continue;
+		if (dladdr(pSite, &tInfo) && tInfo.dli_sname)
+			snprintf(name, sizeof(name), "%s+0x%x", tInfo.dli_sname,
+			    (unsigned int)((char *)pSite - (char *)tInfo.dli_saddr));
+		else
+			snprintf(name, sizeof(name), "%p", pSite);
+		TIMM_OSAL_MemStatsPrint(pFile, name, &gSiteStats[i], nElapsedMs);
+	}
+
+	if (pFile)
+		fclose(pFile);
+	pthread_mutex_unlock(&gMemDumpLock);
+}
@@ -56,11 +56,11 @@
 #include "timm_osal_error.h"
 #include "timm_osal_memory.h"
 #include "timm_osal_semaphores.h"
+#include "timm_osal_time.h"
 
 #include <errno.h>
 
 #include <pthread.h>
-#include <sys/time.h>
 
 
 /* ========================================================================== */
@@ -156,9 +156,6 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_MutexObtain(TIMM_OSAL_PTR pMutex,
     TIMM_OSAL_U32 uTimeOut)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	struct timespec abs_timeout;
-	struct timeval ltime_now;
-	TIMM_OSAL_U32 ltimenow_us;
 	pthread_mutex_t *plMutex = (pthread_mutex_t *) pMutex;
 
 	if (plMutex == TIMM_OSAL_NULL)
@@ -183,16 +180,15 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_MutexObtain(TIMM_OSAL_PTR pMutex,
 		}
 	} else
 	{
-		gettimeofday(&ltime_now, NULL);
-		/*uTimeOut is assumed to be in milliseconds */
-		ltimenow_us = ltime_now.tv_usec + 1000 * uTimeOut;
-		abs_timeout.tv_sec = ltime_now.tv_sec + uTimeOut / 1000;
-		abs_timeout.tv_nsec = (ltimenow_us % 1000000) * 1000;
-
 #ifdef _POSIX_VERSION_1_
 		if (SUCCESS != pthread_mutex_lock(plMutex))
 		{		//Some Posix versions dont support timeout
 #else
+		/*uTimeOut is in milliseconds, pthread_mutex_timedlock only
+		  takes a wall clock deadline */
+		struct timespec abs_timeout;
+
+		TIMM_OSAL_Deadline(&abs_timeout, CLOCK_REALTIME, uTimeOut);
 		if (SUCCESS != pthread_mutex_timedlock(plMutex, &abs_timeout))
 		{
 #endif
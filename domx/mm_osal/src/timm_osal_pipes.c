@@ -55,11 +55,51 @@
 #include "timm_osal_error.h"
 #include "timm_osal_memory.h"
 #include "timm_osal_trace.h"
+#include "timm_osal_pipes.h"
+#include "timm_osal_time.h"
 
 #include <unistd.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <poll.h>
+
+/**
+* TIMM_OSAL_MAILBOX holds the state of a mailbox backed pipe. Messages
+* live in a power of two ring of fixed size slots. nWriteIdx is only ever
+* advanced by the writer and nReadIdx by the reader, so the fast path takes
+* no lock; the mutex and condition are only used to sleep on an empty or
+* full ring and are only signalled when nWaiters says someone is asleep.
+*/
+typedef struct TIMM_OSAL_MAILBOX
+{
+	TIMM_OSAL_U8 *pRing;
+	TIMM_OSAL_U32 nSlots;
+	volatile TIMM_OSAL_U32 nWriteIdx;
+	volatile TIMM_OSAL_U32 nReadIdx;
+	volatile TIMM_OSAL_U32 nWaiters;
+	pthread_mutex_t tLock;
+	pthread_cond_t tCond;
+} TIMM_OSAL_MAILBOX;
+
+/**
+* TIMM_OSAL_DEQUE holds the state of a deque backed pipe. Messages live in
+* a power of two ring of fixed size slots starting at slot nHead, both ends
+* can be written. Everything is done under tLock, tCond wakes up readers
+* waiting for a message and writers waiting for a free slot.
+*/
+typedef struct TIMM_OSAL_DEQUE
+{
+	TIMM_OSAL_U8 *pRing;
+	TIMM_OSAL_U32 nSlots;
+	TIMM_OSAL_U32 nHead;
+	volatile TIMM_OSAL_U32 nCount;
+	pthread_mutex_t tLock;
+	pthread_cond_t tCond;
+} TIMM_OSAL_DEQUE;
 
 /**
 * TIMM_OSAL_PIPE structure define the OSAL pipe
@@ -70,11 +110,489 @@ typedef struct TIMM_OSAL_PIPE
 	TIMM_OSAL_U32 pipeSize;
 	TIMM_OSAL_U32 messageSize;
 	TIMM_OSAL_U8 isFixedMessage;
-	int messageCount;
-	int totalBytesInPipe;
+	volatile int messageCount;
+	volatile int totalBytesInPipe;
+	TIMM_OSAL_PIPE_BACKEND eBackend;
+	TIMM_OSAL_MAILBOX tMailbox;
+	TIMM_OSAL_DEQUE tDeque;
 } TIMM_OSAL_PIPE;
 
 
+/******************************************************************************
+* Mailbox backend helpers
+******************************************************************************/
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MailboxWait function
+*
+* Sleep on the mailbox until bFull (TIMM_OSAL_TRUE: ring is full, FALSE:
+* ring is empty) no longer holds or the timeout (in ms) expires.
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_ERRORTYPE TIMM_OSAL_MailboxWait(TIMM_OSAL_MAILBOX * pMbx,
+    TIMM_OSAL_BOOL bFull, TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	struct timespec tAbsTime;
+	int status = 0;
+
+	if (timeout != (TIMM_OSAL_S32) TIMM_OSAL_SUSPEND)
+		TIMM_OSAL_Deadline(&tAbsTime, CLOCK_MONOTONIC, timeout);
+
+	pthread_mutex_lock(&pMbx->tLock);
+	__sync_fetch_and_add(&pMbx->nWaiters, 1);
+	/*Re-check after announcing ourselves, the other side checks nWaiters
+	  only after it has published its index */
+	while (status == 0 &&
+	    (bFull ? (pMbx->nWriteIdx - pMbx->nReadIdx == pMbx->nSlots) :
+		(pMbx->nWriteIdx == pMbx->nReadIdx)))
+	{
+		if (timeout == (TIMM_OSAL_S32) TIMM_OSAL_SUSPEND)
+		{
+			status = pthread_cond_wait(&pMbx->tCond, &pMbx->tLock);
+		} else
+		{
+			status =
+			    pthread_cond_timedwait(&pMbx->tCond, &pMbx->tLock,
+			    &tAbsTime);
+		}
+	}
+	__sync_fetch_and_sub(&pMbx->nWaiters, 1);
+	pthread_mutex_unlock(&pMbx->tLock);
+
+	if (status == ETIMEDOUT)
+	{
+		bReturnStatus = TIMM_OSAL_ERR_TIMEOUT;
+	} else if (status != 0)
+	{
+		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+	}
+	return bReturnStatus;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MailboxWake function
+*
+* Wake up the other side if it went to sleep on the mailbox.
+*/
+/* ========================================================================== */
+
+static void TIMM_OSAL_MailboxWake(TIMM_OSAL_MAILBOX * pMbx)
+{
+	__sync_synchronize();
+	if (pMbx->nWaiters != 0)
+	{
+		pthread_mutex_lock(&pMbx->tLock);
+		pthread_cond_broadcast(&pMbx->tCond);
+		pthread_mutex_unlock(&pMbx->tLock);
+	}
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MailboxWrite function
+*
+*
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_ERRORTYPE TIMM_OSAL_MailboxWrite(TIMM_OSAL_PIPE * pHandle,
+    void *pMessage, TIMM_OSAL_U32 size, TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_MAILBOX *pMbx = &pHandle->tMailbox;
+	TIMM_OSAL_U32 nWriteIdx = 0;
+
+	if (size != pHandle->messageSize)
+	{
+		TIMM_OSAL_Error("Mailbox write of %d bytes, slot is %d!!!",
+		    size, pHandle->messageSize);
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
+
+	nWriteIdx = pMbx->nWriteIdx;
+	while (nWriteIdx - pMbx->nReadIdx == pMbx->nSlots)
+	{
+		if (timeout == TIMM_OSAL_NO_SUSPEND)
+		{
+			bReturnStatus = TIMM_OSAL_ERR_PIPE_FULL;
+			goto EXIT;
+		}
+		bReturnStatus =
+		    TIMM_OSAL_MailboxWait(pMbx, TIMM_OSAL_TRUE, timeout);
+		if (bReturnStatus != TIMM_OSAL_ERR_NONE)
+			goto EXIT;
+	}
+
+	TIMM_OSAL_Memcpy(pMbx->pRing +
+	    (nWriteIdx & (pMbx->nSlots - 1)) * pHandle->messageSize,
+	    pMessage, size);
+	/*Slot contents must be visible before the new write index */
+	__sync_synchronize();
+	pMbx->nWriteIdx = nWriteIdx + 1;
+
+	TIMM_OSAL_MailboxWake(pMbx);
+
+      EXIT:
+	return bReturnStatus;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MailboxRead function
+*
+*
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_ERRORTYPE TIMM_OSAL_MailboxRead(TIMM_OSAL_PIPE * pHandle,
+    void *pMessage, TIMM_OSAL_U32 size, TIMM_OSAL_U32 * actualSize,
+    TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_MAILBOX *pMbx = &pHandle->tMailbox;
+	TIMM_OSAL_U32 nReadIdx = 0;
+
+	if (size < pHandle->messageSize)
+	{
+		TIMM_OSAL_Error("Mailbox read of %d bytes, slot is %d!!!",
+		    size, pHandle->messageSize);
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
+
+	nReadIdx = pMbx->nReadIdx;
+	while (pMbx->nWriteIdx == nReadIdx)
+	{
+		if (timeout == TIMM_OSAL_NO_SUSPEND)
+		{
+			bReturnStatus = TIMM_OSAL_ERR_PIPE_EMPTY;
+			goto EXIT;
+		}
+		bReturnStatus =
+		    TIMM_OSAL_MailboxWait(pMbx, TIMM_OSAL_FALSE, timeout);
+		if (bReturnStatus != TIMM_OSAL_ERR_NONE)
+			goto EXIT;
+	}
+
+	/*Pairs with the barrier in the writer */
+	__sync_synchronize();
+	TIMM_OSAL_Memcpy(pMessage,
+	    pMbx->pRing + (nReadIdx & (pMbx->nSlots - 1)) *
+	    pHandle->messageSize, pHandle->messageSize);
+	__sync_synchronize();
+	pMbx->nReadIdx = nReadIdx + 1;
+	*actualSize = pHandle->messageSize;
+
+	TIMM_OSAL_MailboxWake(pMbx);
+
+      EXIT:
+	return bReturnStatus;
+}
+
+
+
+/******************************************************************************
+* Deque backend helpers
+******************************************************************************/
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_DequeWrite function
+*
+* Adds a message at the back, or at the front when bFront is set. A full
+* ring is waited on until a slot frees up or the timeout (in ms) expires,
+* with TIMM_OSAL_NO_SUSPEND it fails at once with TIMM_OSAL_ERR_PIPE_FULL.
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_ERRORTYPE TIMM_OSAL_DequeWrite(TIMM_OSAL_PIPE * pHandle,
+    void *pMessage, TIMM_OSAL_U32 size, TIMM_OSAL_BOOL bFront,
+    TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_DEQUE *pDq = &pHandle->tDeque;
+	TIMM_OSAL_U32 nSlot = 0;
+	struct timespec tAbsTime;
+	int status = 0;
+
+	if (size != pHandle->messageSize)
+	{
+		TIMM_OSAL_Error("Deque write of %d bytes, slot is %d!!!",
+		    size, pHandle->messageSize);
+		return TIMM_OSAL_ERR_PARAMETER;
+	}
+
+	if (timeout != TIMM_OSAL_NO_SUSPEND &&
+	    timeout != (TIMM_OSAL_S32) TIMM_OSAL_SUSPEND)
+		TIMM_OSAL_Deadline(&tAbsTime, CLOCK_MONOTONIC, timeout);
+
+	pthread_mutex_lock(&pDq->tLock);
+	while (status == 0 && pDq->nCount == pDq->nSlots)
+	{
+		if (timeout == TIMM_OSAL_NO_SUSPEND)
+		{
+			bReturnStatus = TIMM_OSAL_ERR_PIPE_FULL;
+			goto EXIT;
+		} else if (timeout == (TIMM_OSAL_S32) TIMM_OSAL_SUSPEND)
+		{
+			status = pthread_cond_wait(&pDq->tCond, &pDq->tLock);
+		} else
+		{
+			status = pthread_cond_timedwait(&pDq->tCond,
+			    &pDq->tLock, &tAbsTime);
+		}
+	}
+	/*A slot may have freed up right as the wait timed out */
+	if (pDq->nCount == pDq->nSlots)
+	{
+		bReturnStatus = (status == ETIMEDOUT) ?
+		    TIMM_OSAL_ERR_TIMEOUT : TIMM_OSAL_ERR_UNKNOWN;
+		goto EXIT;
+	}
+
+	if (bFront)
+	{
+		pDq->nHead = (pDq->nHead - 1) & (pDq->nSlots - 1);
+		nSlot = pDq->nHead;
+	} else
+	{
+		nSlot = (pDq->nHead + pDq->nCount) & (pDq->nSlots - 1);
+	}
+	TIMM_OSAL_Memcpy(pDq->pRing + nSlot * pHandle->messageSize,
+	    pMessage, size);
+	pDq->nCount++;
+	/*tCond is shared with waiting writers, wake everyone */
+	pthread_cond_broadcast(&pDq->tCond);
+
+      EXIT:
+	pthread_mutex_unlock(&pDq->tLock);
+	return bReturnStatus;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_DequeRead function
+*
+*
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_ERRORTYPE TIMM_OSAL_DequeRead(TIMM_OSAL_PIPE * pHandle,
+    void *pMessage, TIMM_OSAL_U32 size, TIMM_OSAL_U32 * actualSize,
+    TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_DEQUE *pDq = &pHandle->tDeque;
+	struct timespec tAbsTime;
+	int status = 0;
+
+	if (size < pHandle->messageSize)
+	{
+		TIMM_OSAL_Error("Deque read of %d bytes, slot is %d!!!",
+		    size, pHandle->messageSize);
+		return TIMM_OSAL_ERR_PARAMETER;
+	}
+	if (timeout != TIMM_OSAL_NO_SUSPEND &&
+	    timeout != (TIMM_OSAL_S32) TIMM_OSAL_SUSPEND)
+		TIMM_OSAL_Deadline(&tAbsTime, CLOCK_MONOTONIC, timeout);
+
+	pthread_mutex_lock(&pDq->tLock);
+	while (status == 0 && pDq->nCount == 0)
+	{
+		if (timeout == TIMM_OSAL_NO_SUSPEND)
+		{
+			bReturnStatus = TIMM_OSAL_ERR_PIPE_EMPTY;
+			goto EXIT;
+		} else if (timeout == (TIMM_OSAL_S32) TIMM_OSAL_SUSPEND)
+		{
+			status = pthread_cond_wait(&pDq->tCond, &pDq->tLock);
+		} else
+		{
+			status = pthread_cond_timedwait(&pDq->tCond,
+			    &pDq->tLock, &tAbsTime);
+		}
+	}
+	/*A message may have come in right as the wait timed out */
+	if (pDq->nCount == 0)
+	{
+		bReturnStatus = (status == ETIMEDOUT) ?
+		    TIMM_OSAL_ERR_TIMEOUT : TIMM_OSAL_ERR_UNKNOWN;
+		goto EXIT;
+	}
+
+	TIMM_OSAL_Memcpy(pMessage,
+	    pDq->pRing + pDq->nHead * pHandle->messageSize,
+	    pHandle->messageSize);
+	pDq->nHead = (pDq->nHead + 1) & (pDq->nSlots - 1);
+	pDq->nCount--;
+	*actualSize = pHandle->messageSize;
+	pthread_cond_broadcast(&pDq->tCond);
+
+      EXIT:
+	pthread_mutex_unlock(&pDq->tLock);
+	return bReturnStatus;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_DequeReadMany function
+*
+*
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_ERRORTYPE TIMM_OSAL_DequeReadMany(TIMM_OSAL_PIPE * pHandle,
+    void *pMessages, TIMM_OSAL_U32 maxMsgs, TIMM_OSAL_U32 * count,
+    TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_DEQUE *pDq = &pHandle->tDeque;
+	TIMM_OSAL_U32 nActual = 0, nFirst = 0, n = 0;
+
+	if (maxMsgs == 0)
+		return TIMM_OSAL_ERR_PARAMETER;
+
+	/*The first message is waited for, the rest is taken under the lock */
+	bReturnStatus = TIMM_OSAL_DequeRead(pHandle, pMessages,
+	    pHandle->messageSize, &nActual, timeout);
+	if (bReturnStatus != TIMM_OSAL_ERR_NONE)
+		return bReturnStatus;
+
+	pthread_mutex_lock(&pDq->tLock);
+	n = pDq->nCount < maxMsgs - 1 ? pDq->nCount : maxMsgs - 1;
+	nFirst = pDq->nSlots - pDq->nHead;
+	if (nFirst > n)
+		nFirst = n;
+	TIMM_OSAL_Memcpy((TIMM_OSAL_U8 *) pMessages + pHandle->messageSize,
+	    pDq->pRing + pDq->nHead * pHandle->messageSize,
+	    nFirst * pHandle->messageSize);
+	TIMM_OSAL_Memcpy((TIMM_OSAL_U8 *) pMessages +
+	    (1 + nFirst) * pHandle->messageSize, pDq->pRing,
+	    (n - nFirst) * pHandle->messageSize);
+	pDq->nHead = (pDq->nHead + n) & (pDq->nSlots - 1);
+	pDq->nCount -= n;
+	if (n != 0)
+		pthread_cond_broadcast(&pDq->tCond);
+	pthread_mutex_unlock(&pDq->tLock);
+
+	*count = 1 + n;
+	return TIMM_OSAL_ERR_NONE;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_MailboxReadMany function
+*
+*
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_ERRORTYPE TIMM_OSAL_MailboxReadMany(TIMM_OSAL_PIPE *
+    pHandle, void *pMessages, TIMM_OSAL_U32 maxMsgs, TIMM_OSAL_U32 * count,
+    TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_MAILBOX *pMbx = &pHandle->tMailbox;
+	TIMM_OSAL_U32 nActual = 0, nReadIdx = 0, n = 0, i = 0;
+
+	if (maxMsgs == 0)
+		return TIMM_OSAL_ERR_PARAMETER;
+
+	bReturnStatus = TIMM_OSAL_MailboxRead(pHandle, pMessages,
+	    pHandle->messageSize, &nActual, timeout);
+	if (bReturnStatus != TIMM_OSAL_ERR_NONE)
+		return bReturnStatus;
+
+	/*Only this side moves nReadIdx, whatever the writer published by now
+	  goes in one copy and one index update */
+	nReadIdx = pMbx->nReadIdx;
+	n = pMbx->nWriteIdx - nReadIdx;
+	if (n > maxMsgs - 1)
+		n = maxMsgs - 1;
+	__sync_synchronize();
+	for (i = 0; i < n; i++)
+	{
+		TIMM_OSAL_Memcpy((TIMM_OSAL_U8 *) pMessages +
+		    (1 + i) * pHandle->messageSize,
+		    pMbx->pRing + ((nReadIdx + i) & (pMbx->nSlots - 1)) *
+		    pHandle->messageSize, pHandle->messageSize);
+	}
+	if (n > 0)
+	{
+		__sync_synchronize();
+		pMbx->nReadIdx = nReadIdx + n;
+		TIMM_OSAL_MailboxWake(pMbx);
+	}
+
+	*count = 1 + n;
+	return TIMM_OSAL_ERR_NONE;
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_KernelPipeWait function
+*
+* Waits up to timeout ms for a kernel pipe to become readable, the read
+* that follows then does not block. TIMM_OSAL_SUSPEND leaves the waiting
+* to the read itself.
+*/
+/* ========================================================================== */
+
+static TIMM_OSAL_ERRORTYPE TIMM_OSAL_KernelPipeWait(TIMM_OSAL_PIPE *
+    pHandle, TIMM_OSAL_S32 timeout)
+{
+	struct pollfd tPoll;
+	int status = 0;
+
+	if ((pHandle->messageCount == 0) && (timeout == TIMM_OSAL_NO_SUSPEND))
+	{
+		/*If timeout is 0 and pipe is empty, return error */
+		TIMM_OSAL_Error("Pipe is empty!!!");
+		return TIMM_OSAL_ERR_PIPE_EMPTY;
+	}
+	if ((timeout == TIMM_OSAL_NO_SUSPEND) ||
+	    (timeout == (TIMM_OSAL_S32)TIMM_OSAL_SUSPEND))
+		return TIMM_OSAL_ERR_NONE;
+
+	/*A signal restarts the full timeout */
+	tPoll.fd = pHandle->pfd[0];
+	tPoll.events = POLLIN;
+	do
+	{
+		status = poll(&tPoll, 1, timeout);
+	} while (status < 0 && errno == EINTR);
+	if (status == 0)
+		return TIMM_OSAL_ERR_TIMEOUT;
+	if (status < 0)
+	{
+		TIMM_OSAL_Error("Poll of pipe failed: %s!!!", strerror(errno));
+		return TIMM_OSAL_ERR_UNKNOWN;
+	}
+	return TIMM_OSAL_ERR_NONE;
+}
+
+
+
 /******************************************************************************
 * Function Prototypes
 ******************************************************************************/
@@ -83,16 +601,43 @@ typedef struct TIMM_OSAL_PIPE
 /**
 * @fn TIMM_OSAL_CreatePipe function
 *
-*
+* pipeSize is in bytes. Pipes of fixed size messages are created on the
+* deque backend, the others on a kernel pipe.
 */
 /* ========================================================================== */
 
 TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreatePipe(TIMM_OSAL_PTR * pPipe,
     TIMM_OSAL_U32 pipeSize,
     TIMM_OSAL_U32 messageSize, TIMM_OSAL_U8 isFixedMessage)
+{
+	if (isFixedMessage && messageSize != 0)
+		return TIMM_OSAL_CreatePipeEx(pPipe,
+		    (pipeSize + messageSize - 1) / messageSize, messageSize,
+		    isFixedMessage, TIMM_OSAL_PIPE_BACKEND_DEQUE);
+	return TIMM_OSAL_CreatePipeEx(pPipe, pipeSize, messageSize,
+	    isFixedMessage, TIMM_OSAL_PIPE_BACKEND_KERNEL);
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_CreatePipeEx function
+*
+* For TIMM_OSAL_PIPE_BACKEND_MAILBOX pipeSize is the number of messages the
+* pipe can hold (rounded up to a power of two) and every message must be
+* exactly messageSize bytes. The same goes for TIMM_OSAL_PIPE_BACKEND_DEQUE.
+*/
+/* ========================================================================== */
+
+TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreatePipeEx(TIMM_OSAL_PTR * pPipe,
+    TIMM_OSAL_U32 pipeSize,
+    TIMM_OSAL_U32 messageSize, TIMM_OSAL_U8 isFixedMessage,
+    TIMM_OSAL_PIPE_BACKEND eBackend)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	TIMM_OSAL_PIPE *pHandle = TIMM_OSAL_NULL;
+	TIMM_OSAL_U32 nSlots = 1;
 
 	pHandle =
 	    (TIMM_OSAL_PIPE *) TIMM_OSAL_Malloc(sizeof(TIMM_OSAL_PIPE), 0, 0,
@@ -107,7 +652,68 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreatePipe(TIMM_OSAL_PTR * pPipe,
 
 	pHandle->pfd[0] = -1;
 	pHandle->pfd[1] = -1;
-	if (SUCCESS != pipe(pHandle->pfd))
+	pHandle->eBackend = eBackend;
+
+	if (eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX ||
+	    eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE)
+	{
+		if (!isFixedMessage || messageSize == 0 || pipeSize == 0)
+		{
+			TIMM_OSAL_Error
+			    ("Mailbox pipe needs fixed size messages!!!");
+			bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+			goto EXIT;
+		}
+		while (nSlots < pipeSize)
+			nSlots <<= 1;
+	}
+
+	if (eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE)
+	{
+		pHandle->tDeque.pRing =
+		    (TIMM_OSAL_U8 *) TIMM_OSAL_Malloc(nSlots * messageSize, 0,
+		    0, 0);
+		if (TIMM_OSAL_NULL == pHandle->tDeque.pRing)
+		{
+			bReturnStatus = TIMM_OSAL_ERR_ALLOC;
+			goto EXIT;
+		}
+		pHandle->tDeque.nSlots = nSlots;
+		if (SUCCESS != pthread_mutex_init(&pHandle->tDeque.tLock, NULL))
+		{
+			TIMM_OSAL_Error("Deque mutex init failed!!!");
+			goto EXIT;
+		}
+		if (SUCCESS != TIMM_OSAL_CondInit(&pHandle->tDeque.tCond))
+		{
+			TIMM_OSAL_Error("Deque cond init failed!!!");
+			pthread_mutex_destroy(&pHandle->tDeque.tLock);
+			goto EXIT;
+		}
+	} else if (eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX)
+	{
+		pHandle->tMailbox.pRing =
+		    (TIMM_OSAL_U8 *) TIMM_OSAL_Malloc(nSlots * messageSize, 0,
+		    0, 0);
+		if (TIMM_OSAL_NULL == pHandle->tMailbox.pRing)
+		{
+			bReturnStatus = TIMM_OSAL_ERR_ALLOC;
+			goto EXIT;
+		}
+		pHandle->tMailbox.nSlots = nSlots;
+		if (SUCCESS != pthread_mutex_init(&pHandle->tMailbox.tLock,
+			NULL))
+		{
+			TIMM_OSAL_Error("Mailbox mutex init failed!!!");
+			goto EXIT;
+		}
+		if (SUCCESS != TIMM_OSAL_CondInit(&pHandle->tMailbox.tCond))
+		{
+			TIMM_OSAL_Error("Mailbox cond init failed!!!");
+			pthread_mutex_destroy(&pHandle->tMailbox.tLock);
+			goto EXIT;
+		}
+	} else if (SUCCESS != pipe(pHandle->pfd))
 	{
 		TIMM_OSAL_Error("Pipe failed: %s!!!", strerror(errno));
 		goto EXIT;
@@ -126,6 +732,11 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreatePipe(TIMM_OSAL_PTR * pPipe,
 
 	return bReturnStatus;
 EXIT:
+	if (pHandle)
+	{
+		TIMM_OSAL_Free(pHandle->tMailbox.pRing);
+		TIMM_OSAL_Free(pHandle->tDeque.pRing);
+	}
 	TIMM_OSAL_Free(pHandle);
 	return bReturnStatus;
 }
@@ -152,6 +763,23 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeletePipe(TIMM_OSAL_PTR pPipe)
 		goto EXIT;
 	}
 
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX)
+	{
+		pthread_cond_destroy(&pHandle->tMailbox.tCond);
+		pthread_mutex_destroy(&pHandle->tMailbox.tLock);
+		TIMM_OSAL_Free(pHandle->tMailbox.pRing);
+		TIMM_OSAL_Free(pHandle);
+		goto EXIT;
+	}
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE)
+	{
+		pthread_cond_destroy(&pHandle->tDeque.tCond);
+		pthread_mutex_destroy(&pHandle->tDeque.tLock);
+		TIMM_OSAL_Free(pHandle->tDeque.pRing);
+		TIMM_OSAL_Free(pHandle);
+		goto EXIT;
+	}
+
 	if (SUCCESS != close(pHandle->pfd[0]))
 	{
 		TIMM_OSAL_Error("Delete_Pipe Read fd failed!!!");
@@ -192,6 +820,18 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToPipe(TIMM_OSAL_PTR pPipe,
 		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
 		goto EXIT;
 	}
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX)
+	{
+		bReturnStatus =
+		    TIMM_OSAL_MailboxWrite(pHandle, pMessage, size, timeout);
+		goto EXIT;
+	}
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE)
+	{
+		bReturnStatus = TIMM_OSAL_DequeWrite(pHandle, pMessage, size,
+		    TIMM_OSAL_FALSE, timeout);
+		goto EXIT;
+	}
 	lSizeWritten = write(pHandle->pfd[1], pMessage, size);
 
 	if (lSizeWritten != size)
@@ -202,8 +842,8 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToPipe(TIMM_OSAL_PTR pPipe,
 	}
 
 	/*Update message count and size */
-	pHandle->messageCount++;
-	pHandle->totalBytesInPipe += size;
+	__sync_fetch_and_add(&pHandle->messageCount, 1);
+	__sync_fetch_and_add(&pHandle->totalBytesInPipe, size);
 
 	bReturnStatus = TIMM_OSAL_ERR_NONE;
 
@@ -238,6 +878,19 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToFrontOfPipe(TIMM_OSAL_PTR pPipe,
 		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
 		goto EXIT;
 	}
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX)
+	{
+		/*The mailbox is strictly FIFO between one writer and one reader */
+		TIMM_OSAL_Error("Write to front not supported on mailbox!!!");
+		bReturnStatus = TIMM_OSAL_ERR_NOT_SUPPORTED;
+		goto EXIT;
+	}
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE)
+	{
+		bReturnStatus = TIMM_OSAL_DequeWrite(pHandle, pMessage, size,
+		    TIMM_OSAL_TRUE, timeout);
+		goto EXIT;
+	}
 
 	lSizeWritten = write(pHandle->pfd[1], pMessage, size);
 
@@ -248,7 +901,7 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToFrontOfPipe(TIMM_OSAL_PTR pPipe,
 	}
 
 	/*Update number of messages */
-	pHandle->messageCount++;
+	__sync_fetch_and_add(&pHandle->messageCount, 1);
 
 
 	if (pHandle->messageCount > 1)
@@ -280,7 +933,7 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_WriteToFrontOfPipe(TIMM_OSAL_PTR pPipe,
 		}
 
 		/*Update Total bytes in pipe */
-		pHandle->totalBytesInPipe += size;
+		__sync_fetch_and_add(&pHandle->totalBytesInPipe, size);
 	}
 
 
@@ -315,19 +968,24 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_ReadFromPipe(TIMM_OSAL_PTR pPipe,
 		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
 		goto EXIT;
 	}
-	if ((pHandle->messageCount == 0) && (timeout == TIMM_OSAL_NO_SUSPEND))
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX)
 	{
-		/*If timeout is 0 and pipe is empty, return error */
-		TIMM_OSAL_Error("Pipe is empty!!!");
-		bReturnStatus = TIMM_OSAL_ERR_PIPE_EMPTY;
+		bReturnStatus =
+		    TIMM_OSAL_MailboxRead(pHandle, pMessage, size, actualSize,
+		    timeout);
 		goto EXIT;
 	}
-	if ((timeout !=TIMM_OSAL_NO_SUSPEND) &&
-	    (timeout != (TIMM_OSAL_S32)TIMM_OSAL_SUSPEND))
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE)
 	{
-		TIMM_OSAL_Warning("Only infinite or no timeouts \
-			supported. Going to read with infinite timeout now");
+		bReturnStatus =
+		    TIMM_OSAL_DequeRead(pHandle, pMessage, size, actualSize,
+		    timeout);
+		goto EXIT;
 	}
+	bReturnStatus = TIMM_OSAL_KernelPipeWait(pHandle, timeout);
+	if (bReturnStatus != TIMM_OSAL_ERR_NONE)
+		goto EXIT;
+	bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	/*read blocks infinitely until message is available */
 	*actualSize = lSizeRead = read(pHandle->pfd[0], pMessage, size);
 	if (0 == lSizeRead)
@@ -339,8 +997,8 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_ReadFromPipe(TIMM_OSAL_PTR pPipe,
 
 	bReturnStatus = TIMM_OSAL_ERR_NONE;
 
-	pHandle->messageCount--;
-	pHandle->totalBytesInPipe -= size;
+	__sync_fetch_and_sub(&pHandle->messageCount, 1);
+	__sync_fetch_and_sub(&pHandle->totalBytesInPipe, size);
 
       EXIT:
 	return bReturnStatus;
@@ -349,6 +1007,68 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_ReadFromPipe(TIMM_OSAL_PTR pPipe,
 
 
 
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_ReadManyFromPipe function
+*
+* Waits like TIMM_OSAL_ReadFromPipe for the first message, then returns up
+* to maxMsgs messages in one go without waiting for more. Only for pipes of
+* fixed size messages, msgSize must be the message size of the pipe.
+*/
+/* ========================================================================== */
+
+TIMM_OSAL_ERRORTYPE TIMM_OSAL_ReadManyFromPipe(TIMM_OSAL_PTR pPipe,
+    void *pMessages, TIMM_OSAL_U32 msgSize, TIMM_OSAL_U32 maxMsgs,
+    TIMM_OSAL_U32 * count, TIMM_OSAL_S32 timeout)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	TIMM_OSAL_PIPE *pHandle = (TIMM_OSAL_PIPE *) pPipe;
+	TIMM_OSAL_U8 *pDst = (TIMM_OSAL_U8 *) pMessages;
+	TIMM_OSAL_U32 nSize = 0;
+	ssize_t nRead = 0;
+
+	*count = 0;
+	if (maxMsgs == 0 || !pHandle->isFixedMessage ||
+	    msgSize != pHandle->messageSize)
+	{
+		TIMM_OSAL_Error("Batched read needs the fixed message size!!!");
+		return TIMM_OSAL_ERR_PARAMETER;
+	}
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX)
+		return TIMM_OSAL_MailboxReadMany(pHandle, pMessages, maxMsgs,
+		    count, timeout);
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE)
+		return TIMM_OSAL_DequeReadMany(pHandle, pMessages, maxMsgs,
+		    count, timeout);
+
+	bReturnStatus = TIMM_OSAL_KernelPipeWait(pHandle, timeout);
+	if (bReturnStatus != TIMM_OSAL_ERR_NONE)
+		return bReturnStatus;
+
+	/*Writes of up to PIPE_BUF bytes are atomic, so whatever one read
+	  returns is whole messages unless the caller's buffer cut one */
+	do
+	{
+		nRead = read(pHandle->pfd[0], pDst + nSize,
+		    maxMsgs * msgSize - nSize);
+		if (nRead <= 0 && errno != EINTR)
+		{
+			TIMM_OSAL_Error("EOF reached or no data in pipe!!!");
+			return TIMM_OSAL_ERR_PARAMETER;
+		}
+		if (nRead > 0)
+			nSize += nRead;
+	} while (nSize == 0 || nSize % msgSize != 0);
+
+	*count = nSize / msgSize;
+	__sync_fetch_and_sub(&pHandle->messageCount, *count);
+	__sync_fetch_and_sub(&pHandle->totalBytesInPipe, nSize);
+
+	return TIMM_OSAL_ERR_NONE;
+}
+
+
+
 /* ========================================================================== */
 /**
 * @fn TIMM_OSAL_ClearPipe function
@@ -381,7 +1101,11 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_IsPipeReady(TIMM_OSAL_PTR pPipe)
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR;
 	TIMM_OSAL_PIPE *pHandle = (TIMM_OSAL_PIPE *) pPipe;
 
-	if (pHandle->messageCount <= 0)
+	if ((pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX) ?
+	    (pHandle->tMailbox.nWriteIdx == pHandle->tMailbox.nReadIdx) :
+	    (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE) ?
+	    (pHandle->tDeque.nCount == 0) :
+	    (pHandle->messageCount <= 0))
 	{
 		bReturnStatus = TIMM_OSAL_ERR_NOT_READY;
 	} else
@@ -409,7 +1133,17 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_GetPipeReadyMessageCount(TIMM_OSAL_PTR pPipe,
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
 	TIMM_OSAL_PIPE *pHandle = (TIMM_OSAL_PIPE *) pPipe;
 
-	*count = pHandle->messageCount;
+	if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_MAILBOX)
+	{
+		*count = pHandle->tMailbox.nWriteIdx -
+		    pHandle->tMailbox.nReadIdx;
+	} else if (pHandle->eBackend == TIMM_OSAL_PIPE_BACKEND_DEQUE)
+	{
+		*count = pHandle->tDeque.nCount;
+	} else
+	{
+		*count = pHandle->messageCount;
+	}
 	return bReturnStatus;
 
 }
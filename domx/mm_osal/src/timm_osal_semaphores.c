@@ -51,25 +51,46 @@
 ******************************************************************************/
 
 #include <stdio.h>
-
-#include <semaphore.h>
-#include <sys/time.h>
+#include <errno.h>
 
 
 #include "timm_osal_types.h"
 #include "timm_osal_trace.h"
 #include "timm_osal_error.h"
 #include "timm_osal_memory.h"
+#include "timm_osal_futex.h"
 
 
-#define SEMNAME_MAX           7
-
-/*
-typedef struct TIMM_OSAL_SEMAPHORE {
-    sem_t  sem;
-    CHAR name[SEMNAME_MAX];
+/*Obtain and Release are a compare and swap on nCount as long as nobody has
+  to wait.  An Obtain that finds nCount at 0 sleeps on it, and Release only
+  makes the wake call when nWaiters says someone may be asleep*/
+typedef struct TIMM_OSAL_SEMAPHORE
+{
+	volatile int nCount;
+	volatile int nWaiters;
 } TIMM_OSAL_SEMAPHORE;
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_SemaphoreTryObtain function
+*
+* Takes one count if there is one, never sleeps.
 */
+/* ========================================================================== */
+static TIMM_OSAL_BOOL TIMM_OSAL_SemaphoreTryObtain(TIMM_OSAL_SEMAPHORE * psem)
+{
+	int nCount = 0;
+
+	do
+	{
+		nCount = psem->nCount;
+		if (nCount <= 0)
+			return TIMM_OSAL_FALSE;
+	} while (!__sync_bool_compare_and_swap(&(psem->nCount), nCount,
+		nCount - 1));
+
+	return TIMM_OSAL_TRUE;
+}
 
 /* ========================================================================== */
 /**
@@ -84,7 +105,9 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreCreate(TIMM_OSAL_PTR * pSemaphore,
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	*pSemaphore = TIMM_OSAL_NULL;
 
-	sem_t *psem = (sem_t *) TIMM_OSAL_Malloc(sizeof(sem_t), 0, 0, 0);
+	TIMM_OSAL_SEMAPHORE *psem =
+	    (TIMM_OSAL_SEMAPHORE *) TIMM_OSAL_Malloc(sizeof(TIMM_OSAL_SEMAPHORE),
+	    0, 0, 0);
 
 	if (TIMM_OSAL_NULL == psem)
 	{
@@ -92,21 +115,11 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreCreate(TIMM_OSAL_PTR * pSemaphore,
 		goto EXIT;
 	}
 
-	/*Unnamed semaphore */
-	if (SUCCESS != sem_init(psem, 0, uInitCount))
-	{
-		/*TIMM_OSAL_Error("Semaphore Create failed !"); */
-		/*goto EXIT; */
-	} else
-	{
-		*pSemaphore = (TIMM_OSAL_PTR) psem;
-		bReturnStatus = TIMM_OSAL_ERR_NONE;
-	}
+	psem->nCount = uInitCount;
+	psem->nWaiters = 0;
+	*pSemaphore = (TIMM_OSAL_PTR) psem;
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
       EXIT:
-	if ((TIMM_OSAL_ERR_NONE != bReturnStatus) && (TIMM_OSAL_NULL != psem))
-	{
-		TIMM_OSAL_Free(psem);
-	}
 	return bReturnStatus;
 }
 
@@ -120,15 +133,14 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreCreate(TIMM_OSAL_PTR * pSemaphore,
 TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreDelete(TIMM_OSAL_PTR pSemaphore)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
-	sem_t *psem = (sem_t *) pSemaphore;
+	TIMM_OSAL_SEMAPHORE *psem = (TIMM_OSAL_SEMAPHORE *) pSemaphore;
 
 	if (psem == TIMM_OSAL_NULL)
 	{
 		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
 		goto EXIT;
 	}
-	/* Release the semaphore.  */
-	if (SUCCESS != sem_destroy(psem))
+	if (psem->nWaiters != 0)
 	{
 		/*TIMM_OSAL_Error("Semaphore Delete failed !"); */
 		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
@@ -143,7 +155,7 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreDelete(TIMM_OSAL_PTR pSemaphore)
 /**
 * @fn TIMM_OSAL_SemaphoreObtain function
 *
-*
+* uTimeOut is in milliseconds and counted on CLOCK_MONOTONIC.
 */
 /* ========================================================================== */
 
@@ -151,9 +163,8 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreObtain(TIMM_OSAL_PTR pSemaphore,
     TIMM_OSAL_U32 uTimeOut)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	struct timeval ltime_now;
-	struct timespec abs_timeout;
-	sem_t *psem = (sem_t *) pSemaphore;
+	struct timespec deadline, *pDeadline = NULL;
+	TIMM_OSAL_SEMAPHORE *psem = (TIMM_OSAL_SEMAPHORE *) pSemaphore;
 
 	if (psem == TIMM_OSAL_NULL)
 	{
@@ -161,39 +172,44 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreObtain(TIMM_OSAL_PTR pSemaphore,
 		goto EXIT;
 	}
 
-	if (TIMM_OSAL_SUSPEND == uTimeOut)
+	if (TIMM_OSAL_SemaphoreTryObtain(psem))
 	{
-		if (SUCCESS != sem_wait(psem))
-		{
-			/*TIMM_OSAL_Error("Semaphore Wait failed !"); */
-			goto EXIT;
-		}
+		bReturnStatus = TIMM_OSAL_ERR_NONE;
+		goto EXIT;
+	}
+
+	if (TIMM_OSAL_NO_SUSPEND == uTimeOut)
+	{
+		/*TIMM_OSAL_Error("Semaphore blocked !"); */
+		goto EXIT;
+	}
+
+	if (TIMM_OSAL_SUSPEND != uTimeOut)
+	{
+		TIMM_OSAL_Deadline(&deadline, CLOCK_MONOTONIC, uTimeOut);
+		pDeadline = &deadline;
+	}
 
-	} else if (TIMM_OSAL_NO_SUSPEND == uTimeOut)
+	/*Announce the wait before sampling nCount, Release looks at nWaiters
+	  only after it changed nCount */
+	__sync_fetch_and_add(&(psem->nWaiters), 1);
+	for (;;)
 	{
-		if (SUCCESS != sem_trywait(psem))
+		if (TIMM_OSAL_SemaphoreTryObtain(psem))
 		{
-			/*TIMM_OSAL_Error("Semaphore blocked !"); */
-			goto EXIT;
+			bReturnStatus = TIMM_OSAL_ERR_NONE;
+			break;
 		}
-	} else
-	{
-		/*Some delay in calling gettimeofday and sem_timedwait - cant
-		   be avoided. Possibility of thread switch after gettimeofday
-		   in which case time out will be less than expected */
-		gettimeofday(&ltime_now, NULL);
-		/*uTimeOut is assumed to be in milliseconds */
-		abs_timeout.tv_sec = ltime_now.tv_sec + (uTimeOut / 1000);
-		abs_timeout.tv_nsec =
-		    1000 * (ltime_now.tv_usec + ((uTimeOut % 1000) * 1000));
-
-		if (SUCCESS != sem_timedwait(psem, &abs_timeout))
+		if (ETIMEDOUT == TIMM_OSAL_FutexWait(&(psem->nCount), 0,
+			pDeadline))
 		{
 			/*TIMM_OSAL_Error("Semaphore Timed Wait failed !"); */
-			goto EXIT;
+			if (TIMM_OSAL_SemaphoreTryObtain(psem))
+				bReturnStatus = TIMM_OSAL_ERR_NONE;
+			break;
 		}
 	}
-	bReturnStatus = TIMM_OSAL_ERR_NONE;
+	__sync_fetch_and_sub(&(psem->nWaiters), 1);
 
       EXIT:
 	return bReturnStatus;
@@ -209,7 +225,7 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreObtain(TIMM_OSAL_PTR pSemaphore,
 TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreRelease(TIMM_OSAL_PTR pSemaphore)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	sem_t *psem = (sem_t *) pSemaphore;
+	TIMM_OSAL_SEMAPHORE *psem = (TIMM_OSAL_SEMAPHORE *) pSemaphore;
 
 	if (TIMM_OSAL_NULL == psem)
 	{
@@ -217,13 +233,10 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreRelease(TIMM_OSAL_PTR pSemaphore)
 		goto EXIT;
 	}
 	/* Release the semaphore.  */
-	if (SUCCESS != sem_post(psem))
-	{
-		/*TIMM_OSAL_Error("Release failed !"); */
-	} else
-	{
-		bReturnStatus = TIMM_OSAL_ERR_NONE;
-	}
+	__sync_fetch_and_add(&(psem->nCount), 1);
+	if (psem->nWaiters != 0)
+		TIMM_OSAL_FutexWake(&(psem->nCount), 1);
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
 
       EXIT:
 	return bReturnStatus;
@@ -233,33 +246,29 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreRelease(TIMM_OSAL_PTR pSemaphore)
 /**
 * @fn TIMM_OSAL_SemaphoreReset function
 *
-*
+* Sets the count to uInitCount, waiters get to check the new count.
 */
 /* ========================================================================== */
 TIMM_OSAL_ERRORTYPE TIMM_OSAL_SemaphoreReset(TIMM_OSAL_PTR pSemaphore,
     TIMM_OSAL_U32 uInitCount)
 {
-	/*  TIMM_OSAL_SEMAPHORE *pHandle = (TIMM_OSAL_SEMAPHORE *)pSemaphore;
-	   STATUS  status;
-	   TIMM_OSAL_ERRORTYPE bReturnStatus; */
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+	TIMM_OSAL_SEMAPHORE *psem = (TIMM_OSAL_SEMAPHORE *) pSemaphore;
+
+	if (TIMM_OSAL_NULL == psem)
+	{
+		bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+		goto EXIT;
+	}
 
+	__sync_lock_test_and_set(&(psem->nCount), (int)uInitCount);
+	__sync_synchronize();
+	if (psem->nWaiters != 0)
+		TIMM_OSAL_FutexWake(&(psem->nCount), INT_MAX);
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
 
-	/* Release the semaphore.  */
-	/*status = NU_Reset_Semaphore(&(pHandle->sem),
-	   uInitCount);
-	 */
-	/*   switch(status)
-	   {
-	   case NU_SUCCESS:
-	   bReturnStatus = TIMM_OSAL_ERR_NONE;
-	   break;
-	   default:
-	   bReturnStatus = TIMM_OSAL_ERR_CREATE(TIMM_OSAL_ERR, TIMM_OSAL_COMP_SEMAPHORES, status);
-	   break;
-	   }
-	 */
-	/* return bReturnStatus; */
-	return TIMM_OSAL_ERR_UNKNOWN;
+      EXIT:
+	return bReturnStatus;
 }
 
 /* ========================================================================== */
@@ -273,8 +282,7 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_GetSemaphoreCount(TIMM_OSAL_PTR pSemaphore,
     TIMM_OSAL_U32 * count)
 {
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
-	int sval = -2;		/*value that is not possible */
-	sem_t *psem = (sem_t *) pSemaphore;
+	TIMM_OSAL_SEMAPHORE *psem = (TIMM_OSAL_SEMAPHORE *) pSemaphore;
 
 	if (TIMM_OSAL_NULL == psem)
 	{
@@ -282,15 +290,8 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_GetSemaphoreCount(TIMM_OSAL_PTR pSemaphore,
 		goto EXIT;
 	}
 
-	/* Release the semaphore.  */
-	if (SUCCESS != sem_getvalue(psem, &sval))
-	{
-		/*TIMM_OSAL_Error("Get Semaphore Count failed !"); */
-	} else
-	{
-		*count = sval;
-		bReturnStatus = TIMM_OSAL_ERR_NONE;
-	}
+	*count = psem->nCount;
+	bReturnStatus = TIMM_OSAL_ERR_NONE;
 
       EXIT:
 	return bReturnStatus;
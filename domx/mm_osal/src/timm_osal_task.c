@@ -51,10 +51,18 @@
 * Includes
 ******************************************************************************/
 
+/*cpu_set_t and sched_setaffinity() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
+#include <string.h>
 #include <pthread.h>		/*for POSIX calls */
 #include <sched.h>		/*for sched structure */
 #include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 
 
@@ -88,9 +96,33 @@ typedef struct TIMM_OSAL_TASK
 /*    TIMM_OSAL_S32 priority;*/
     /** flag to check if task got created */
 	TIMM_OSAL_BOOL isCreated;
+	/*applied by TIMM_OSAL_TaskEntry before pFunc runs */
+	TIMM_OSAL_TaskProc pFunc;
+	TIMM_OSAL_BOOL bHasParams;
+	TIMM_OSAL_TASK_PARAMS tParams;
+	TIMM_OSAL_S8 name[16];
 } TIMM_OSAL_TASK;
 
 
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_TaskEntry function
+*
+* Start routine of every OSAL task, names and places the thread and runs
+* the task function.
+*/
+/* ========================================================================== */
+
+static void *TIMM_OSAL_TaskEntry(void *arg)
+{
+	TIMM_OSAL_TASK *pHandle = (TIMM_OSAL_TASK *) arg;
+
+	TIMM_OSAL_SetTaskParams(pHandle->bHasParams ? &pHandle->tParams : NULL,
+	    pHandle->name[0] ? pHandle->name : NULL);
+	return pHandle->pFunc(pHandle->pArgv);
+}
+
+
 /******************************************************************************
 * Function Prototypes
 ******************************************************************************/
@@ -110,6 +142,31 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateTask(TIMM_OSAL_PTR * pTask,
     TIMM_OSAL_PTR pArgv,
     TIMM_OSAL_U32 uStackSize, TIMM_OSAL_U32 uPriority, TIMM_OSAL_S8 * pName)
 {
+	/*uPriority used to go into attributes that inherit the scheduling of
+	  the creator, where it never had an effect */
+	return TIMM_OSAL_CreateTaskEx(pTask, pFunc, uArgc, pArgv, uStackSize,
+	    NULL, pName);
+}
+
+
+
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_CreateTaskEx function
+*
+* Real time policies are set on the thread attributes, so the task never
+* runs at the wrong priority.  Nice value, CPU mask and name are applied by
+* the task itself before pFunc is called.
+*/
+/* ========================================================================== */
+
+TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateTaskEx(TIMM_OSAL_PTR * pTask,
+    TIMM_OSAL_TaskProc pFunc,
+    TIMM_OSAL_U32 uArgc,
+    TIMM_OSAL_PTR pArgv,
+    TIMM_OSAL_U32 uStackSize,
+    const TIMM_OSAL_TASK_PARAMS * pParams, const TIMM_OSAL_S8 * pName)
+{
 
 	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
 	TIMM_OSAL_TASK *pHandle = TIMM_OSAL_NULL;
@@ -134,6 +191,15 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateTask(TIMM_OSAL_PTR * pTask,
 	/*Arguments for task */
 	pHandle->uArgc = uArgc;
 	pHandle->pArgv = pArgv;
+	pHandle->pFunc = pFunc;
+	if (pParams)
+	{
+		pHandle->tParams = *pParams;
+		pHandle->bHasParams = TIMM_OSAL_TRUE;
+	}
+	if (pName)
+		strncpy((char *)pHandle->name, (const char *)pName,
+		    sizeof(pHandle->name) - 1);
 
 	pHandle->isCreated = TIMM_OSAL_FALSE;
 
@@ -145,19 +211,22 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateTask(TIMM_OSAL_PTR * pTask,
 	}
 	/* Updation of the priority and the stack size */
 
-	if (SUCCESS != pthread_attr_getschedparam(&pHandle->ThreadAttr,
-		&sched))
-	{
-		/*TIMM_OSAL_Error("Task Init Get Sched Params failed!"); */
-		goto EXIT;
-	}
-
-	sched.sched_priority = uPriority;	/* relative to the default priority */
-	if (SUCCESS != pthread_attr_setschedparam(&pHandle->ThreadAttr,
-		&sched))
+	if (pParams && (pParams->ePolicy == TIMM_OSAL_SCHED_FIFO ||
+		pParams->ePolicy == TIMM_OSAL_SCHED_RR))
 	{
-		/*TIMM_OSAL_Error("Task Init Set Sched Paramsfailed!"); */
-		goto EXIT;
+		sched.sched_priority = pParams->nPriority;
+		if (SUCCESS != pthread_attr_setinheritsched(&pHandle->ThreadAttr,
+			PTHREAD_EXPLICIT_SCHED) ||
+		    SUCCESS != pthread_attr_setschedpolicy(&pHandle->ThreadAttr,
+			pParams->ePolicy == TIMM_OSAL_SCHED_FIFO ? SCHED_FIFO :
+			SCHED_RR) ||
+		    SUCCESS != pthread_attr_setschedparam(&pHandle->ThreadAttr,
+			&sched))
+		{
+			TIMM_OSAL_Error("Task Init Set Sched Params failed!");
+			bReturnStatus = TIMM_OSAL_ERR_PARAMETER;
+			goto EXIT;
+		}
 	}
 
 	/*First get the default stack size */
@@ -183,7 +252,7 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_CreateTask(TIMM_OSAL_PTR * pTask,
 
 
 	if (SUCCESS != pthread_create(&pHandle->threadID,
-		&pHandle->ThreadAttr, pFunc, pArgv))
+		&pHandle->ThreadAttr, TIMM_OSAL_TaskEntry, pHandle))
 	{
 		/*TIMM_OSAL_Error ("Create_Task failed !"); */
 		goto EXIT;
@@ -246,6 +315,82 @@ TIMM_OSAL_ERRORTYPE TIMM_OSAL_DeleteTask(TIMM_OSAL_PTR pTask)
 }
 
 
+/* ========================================================================== */
+/**
+* @fn TIMM_OSAL_SetTaskParams
+*
+* Everything is tried even when one setting fails, the result tells whether
+* all of them took.  Real time policies and negative nice values need the
+* matching capability, without it the thread keeps running as it was.
+*/
+/* ========================================================================== */
+
+TIMM_OSAL_ERRORTYPE TIMM_OSAL_SetTaskParams(const TIMM_OSAL_TASK_PARAMS *
+    pParams, const TIMM_OSAL_S8 * pName)
+{
+	TIMM_OSAL_ERRORTYPE bReturnStatus = TIMM_OSAL_ERR_NONE;
+	struct sched_param sched;
+	pid_t tid = (pid_t) syscall(__NR_gettid);
+	cpu_set_t tCpus;
+	TIMM_OSAL_U32 i = 0;
+	int policy = SCHED_OTHER;
+
+	if (pName && prctl(PR_SET_NAME, (unsigned long)pName, 0, 0, 0) != 0)
+	{
+		TIMM_OSAL_Warning("Can't name thread %s", pName);
+		bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+	}
+
+	if (TIMM_OSAL_NULL == pParams)
+		goto EXIT;
+
+	if (pParams->ePolicy != TIMM_OSAL_SCHED_INHERIT)
+	{
+		sched.sched_priority = 0;
+		if (pParams->ePolicy == TIMM_OSAL_SCHED_FIFO ||
+		    pParams->ePolicy == TIMM_OSAL_SCHED_RR)
+		{
+			policy = pParams->ePolicy == TIMM_OSAL_SCHED_FIFO ?
+			    SCHED_FIFO : SCHED_RR;
+			sched.sched_priority = pParams->nPriority;
+		}
+		if (SUCCESS != pthread_setschedparam(pthread_self(), policy,
+			&sched))
+		{
+			TIMM_OSAL_Warning("Can't set policy %d priority %d",
+			    policy, sched.sched_priority);
+			bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+		}
+		/*Nice only counts for SCHED_OTHER, and is per thread on Linux */
+		if (policy == SCHED_OTHER &&
+		    setpriority(PRIO_PROCESS, tid, pParams->nNice) != 0)
+		{
+			TIMM_OSAL_Warning("Can't set nice %d", pParams->nNice);
+			bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+		}
+	}
+
+	if (pParams->uCpuMask != 0)
+	{
+		CPU_ZERO(&tCpus);
+		for (i = 0; i < 32; i++)
+		{
+			if (pParams->uCpuMask & (1U << i))
+				CPU_SET(i, &tCpus);
+		}
+		if (sched_setaffinity(tid, sizeof(tCpus), &tCpus) != 0)
+		{
+			TIMM_OSAL_Warning("Can't set CPU mask 0x%x",
+			    pParams->uCpuMask);
+			bReturnStatus = TIMM_OSAL_ERR_UNKNOWN;
+		}
+	}
+
+      EXIT:
+	return bReturnStatus;
+}
+
+
 TIMM_OSAL_ERRORTYPE TIMM_OSAL_SleepTask(TIMM_OSAL_U32 mSec)
 {
 	TIMM_OSAL_S32 nReturn = 0;
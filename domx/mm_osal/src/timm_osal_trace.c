@@ -54,6 +54,9 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "timm_osal_trace.h"
 
 #ifdef _Android
@@ -76,7 +79,19 @@
 
 #define DEFAULT_TRACE_LEVEL TIMM_OSAL_TRACE_LEVEL_ERROR
 
-static int trace_level = -1;
+/* checked inline by __TIMM_OSAL_Trace() before the call is made */
+int __TIMM_OSAL_TraceLevel = -1;
+
+#define TRACE_MARKER_PATH "/sys/kernel/debug/tracing/trace_marker"
+/* ATRACE_TAG_VIDEO of cutils/trace.h */
+#define TRACE_MARKER_ATRACE_TAG_VIDEO (1 << 9)
+#define TRACE_MARKER_MAX_LEN 80
+
+/* fd the markers go to, -1 while disabled. The file stays open once opened
+ * so that a thread still writing never sees it closed under its feet */
+int __TIMM_OSAL_TraceMarkerFd = -1;
+static int trace_marker_fd = -1;
+static int trace_marker_pid = 0;
 
 /* strip out leading ../ stuff that happens to __FILE__ for out-of-tree builds */
 static const char *simplify_path(const char *file)
@@ -97,7 +112,7 @@ void TIMM_OSAL_UpdateTraceLevel(void)
 
 	if (val)
 	{
-		trace_level = strtol(val, NULL, 0);
+		__TIMM_OSAL_TraceLevel = strtol(val, NULL, 0);
 	}
 	else
 	{
@@ -109,27 +124,82 @@ void TIMM_OSAL_UpdateTraceLevel(void)
 		val = atoi(value);
 		if ( (!val) || (val < 0) )
 		{
-			trace_level = DEFAULT_TRACE_LEVEL;
+			__TIMM_OSAL_TraceLevel = DEFAULT_TRACE_LEVEL;
 		}
 		else
-			trace_level = val;
+			__TIMM_OSAL_TraceLevel = val;
 #else
-		trace_level = DEFAULT_TRACE_LEVEL;
+		__TIMM_OSAL_TraceLevel = DEFAULT_TRACE_LEVEL;
 #endif
 	}
 }
 
+void TIMM_OSAL_UpdateTraceMarker(void)
+{
+	char *val = getenv("TIMM_OSAL_TRACE_MARKER");
+	int enable = 0;
+
+	if (val)
+	{
+		enable = strtol(val, NULL, 0);
+	}
+#ifdef _Android
+	else
+	{
+		char value[PROPERTY_VALUE_MAX];
+
+		property_get("debug.domx.trace_marker", value, "0");
+		enable = atoi(value);
+		if (!enable)
+		{
+			property_get("debug.atrace.tags.enableflags", value, "0");
+			enable = (strtoull(value, NULL, 0) &
+			    TRACE_MARKER_ATRACE_TAG_VIDEO) != 0;
+		}
+	}
+#endif
+
+	if (enable && trace_marker_fd < 0)
+	{
+		trace_marker_fd = open(TRACE_MARKER_PATH, O_WRONLY);
+		trace_marker_pid = getpid();
+	}
+	__TIMM_OSAL_TraceMarkerFd = enable ? trace_marker_fd : -1;
+}
+
+void __TIMM_OSAL_TraceMarkerBegin(const char *name, unsigned int arg)
+{
+	char buf[TRACE_MARKER_MAX_LEN];
+	int len;
+
+	if (arg)
+		len = snprintf(buf, sizeof(buf), "B|%d|%s %x",
+		    trace_marker_pid, name, arg);
+	else
+		len = snprintf(buf, sizeof(buf), "B|%d|%s",
+		    trace_marker_pid, name);
+	if (len > (int)sizeof(buf) - 1)
+		len = sizeof(buf) - 1;
+	/* a lost marker is not worth an error path */
+	(void)write(__TIMM_OSAL_TraceMarkerFd, buf, len);
+}
+
+void __TIMM_OSAL_TraceMarkerEnd(void)
+{
+	(void)write(__TIMM_OSAL_TraceMarkerFd, "E", 1);
+}
+
 void __TIMM_OSAL_TraceFunction(const __TIMM_OSAL_TRACE_LOCATION * loc,
     const char *fmt, ...)
 {
-	if (trace_level == -1)
+	if (__TIMM_OSAL_TraceLevel == -1)
 	{
 		char *val = getenv("TIMM_OSAL_DEBUG_TRACE_LEVEL");
-		trace_level =
+		__TIMM_OSAL_TraceLevel =
 		    val ? strtol(val, NULL, 0) : DEFAULT_TRACE_LEVEL;
 	}
 
-	if (trace_level >= loc->level)
+	if (__TIMM_OSAL_TraceLevel >= loc->level)
 	{
 		va_list ap;
 
@@ -16,6 +16,7 @@ LOCAL_SHARED_LIBRARIES := \
     libmm_osal
 
 LOCAL_CFLAGS += -DSTATIC_TABLE -D_Android -DCHECK_SECURE_STATE
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE:= libOMX_Core
 LOCAL_MODULE_TAGS:= optional
 include $(BUILD_SHARED_LIBRARY)
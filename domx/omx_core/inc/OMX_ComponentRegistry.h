@@ -41,12 +41,35 @@ typedef struct _ComponentTable {
     OMX_STRING pRoleArray[MAX_ROLES];
 }ComponentTable;
 
+#define MAX_CAPS_PROFILE_LEVELS 16
+#define MAX_CAPS_COLOR_FORMATS 8
+
+/* Capabilities of one role of a component. They are collected with the
+ * roles and kept in the component registry, so OMX_GetComponentCaps never
+ * has to load the component. */
+typedef struct _ComponentCaps {
+    OMX_U32 nProfileLevels;
+    struct {
+        OMX_U32 eProfile;
+        OMX_U32 eLevel;
+    } sProfileLevels[MAX_CAPS_PROFILE_LEVELS];
+    OMX_U32 nColorFormats;
+    OMX_U32 eColorFormats[MAX_CAPS_COLOR_FORMATS];
+    OMX_U32 nFrameWidth;    /* raw video port, 0 without one */
+    OMX_U32 nFrameHeight;
+}ComponentCaps;
+
 
 OMX_API OMX_ERRORTYPE OMX_GetRolesOfComponent (
     OMX_IN      OMX_STRING compName,
     OMX_INOUT   OMX_U32 *pNumRoles,
     OMX_OUT     OMX_U8 **roles);
 
+OMX_API OMX_ERRORTYPE OMX_GetComponentCaps (
+    OMX_IN      OMX_STRING compName,
+    OMX_IN      OMX_STRING role,
+    OMX_OUT     ComponentCaps *pCaps);
+
 OMX_ERRORTYPE OMX_PrintComponentTable();
 OMX_ERRORTYPE OMX_BuildComponentTable();
 OMX_ERRORTYPE ComponentTable_EventHandler(
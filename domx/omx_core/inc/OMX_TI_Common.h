@@ -330,6 +330,36 @@ typedef struct OMX_TI_COMPONENT_HANDLE {
     OMX_HANDLETYPE pHandle;
 } OMX_TI_COMPONENT_HANDLE;
 
+/*===============================================================*/
+/** OMX_TI_STATUSPAGE                 : Status the remote component publishes
+ *                                      in the page handed to it with
+ *                                      OMX_TI_IndexParamStatusPage. The page
+ *                                      is only written by the remote side.
+ *
+ *  @ param nMagic                    : OMX_TI_STATUSPAGE_MAGIC once the page
+ *                                      has been filled in.
+ *  @ param nSequence                 : Incremented before and after every
+ *                                      update, odd while the page is written.
+ *  @ param eState                    : Current component state.
+ *  @ param nPortEnabled              : Bit n set when port n is enabled.
+ *  @ param nBuffersHeld              : Buffers held by the component per port.
+ *  @ param eLastError                : Last error the component reported.
+ *  @ param nErrors                   : Number of errors reported so far.
+ */
+/*===============================================================*/
+#define OMX_TI_STATUSPAGE_MAGIC    0x53544154
+#define OMX_TI_STATUSPAGE_MAXPORTS 8
+
+typedef struct OMX_TI_STATUSPAGE {
+    OMX_U32 nMagic;
+    OMX_U32 nSequence;
+    OMX_STATETYPE eState;
+    OMX_U32 nPortEnabled;
+    OMX_U32 nBuffersHeld[OMX_TI_STATUSPAGE_MAXPORTS];
+    OMX_ERRORTYPE eLastError;
+    OMX_U32 nErrors;
+} OMX_TI_STATUSPAGE;
+
 /*******************************************************************
  * PRIVATE DECLARATIONS: defined here, used only here
  *******************************************************************/
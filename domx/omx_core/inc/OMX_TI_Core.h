@@ -95,7 +95,13 @@ typedef enum OMX_TI_EVENTTYPE
     /* Vendor specific area for storing indices */
     /*Reference count for the buffer has changed. In the callback, nData1 will
       pBufferHeader, nData2 will be present count*/
-    OMX_TI_EventBufferRefCount = (OMX_S32)((OMX_EVENTTYPE)OMX_EventVendorStartUnused + 1)
+    OMX_TI_EventBufferRefCount = (OMX_S32)((OMX_EVENTTYPE)OMX_EventVendorStartUnused + 1),
+    /*Part of an output frame is ready while the buffer still belongs to the
+      component, sent on ports set to a partial OMX_TI_IndexParamVideoDataSyncMode.
+      In the callback, nData1 will be the port, nData2 the valid bytes from
+      nOffset and pEventData the pBufferHeader. The buffer comes back through
+      FillBufferDone with OMX_BUFFERFLAG_ENDOFFRAME once the frame is complete*/
+    OMX_TI_EventPartialFrame
 }OMX_TI_EVENTTYPE;
 
 
@@ -2538,6 +2538,42 @@ typedef struct OMX_TI_CONFIG_SHAREDBUFFER {
 	OMX_U8* pSharedBuff;
 } OMX_TI_CONFIG_SHAREDBUFFER;
 
+/**
+ * Per-frame camera metadata, read from the extradata the component wrote
+ * into the metadata buffer of an output buffer. SetConfig enables the
+ * extradata on nPortIndex (bEnable); GetConfig with pBufferHeader of a buffer
+ * returned by FillBufferDone and not yet given back parses it locally, the
+ * component is not called.
+ *
+ * STRUCT MEMBERS:
+ * nSize              : Size of the structure in bytes
+ * nVersion           : OMX specification version information
+ * nPortIndex         : Port that this structure applies to
+ * bEnable            : SetConfig only, enable or disable the extradata
+ * pBufferHeader      : GetConfig only, buffer the metadata belongs to
+ * nTimeStamp         : Timestamp of that buffer
+ * bAncillaryValid    : tAncillary was present in the buffer
+ * tAncillary         : 3A status, exposure and gains of the frame
+ * bWhiteBalanceValid : tWhiteBalance was present in the buffer
+ * tWhiteBalance      : White balance gains of the frame
+ * bFacesValid        : tFaces was present in the buffer
+ * tFaces             : Faces detected in the frame
+ */
+typedef struct OMX_TI_CONFIG_CAMFRAMEMETADATA {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_BOOL bEnable;
+    OMX_PTR pBufferHeader;
+    OMX_TICKS nTimeStamp;
+    OMX_BOOL bAncillaryValid;
+    OMX_TI_ANCILLARYDATATYPE tAncillary;
+    OMX_BOOL bWhiteBalanceValid;
+    OMX_TI_WHITEBALANCERESULTTYPE tWhiteBalance;
+    OMX_BOOL bFacesValid;
+    OMX_FACEDETECTIONTYPE tFaces;
+} OMX_TI_CONFIG_CAMFRAMEMETADATA;
+
 /**
  * Structure used to configure current OMX_TI_CAPRESTYPE
  *
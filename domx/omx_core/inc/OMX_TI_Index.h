@@ -282,8 +282,24 @@ typedef enum OMX_TI_INDEXTYPE {
     OMX_TI_IndexConfigGammaTable,                       /**< 0x7F0000B5 reference: OMX_TI_CONFIG_SHAREDBUFFER */
     OMX_TI_IndexConfigDynamicCameraDescriptor,          /**< 0x7F0000B6 reference: OMX_TI_CONFIG_SHAREDBUFFER */
 
-    OMX_TI_IndexConfigStreamInterlaceFormats = ((OMX_INDEXTYPE)OMX_IndexVendorStartUnused + 0x100) /**< 0x7F000100 reference: OMX_STREAMINTERLACEFORMATTYPE */
-
+    OMX_TI_IndexConfigStreamInterlaceFormats = ((OMX_INDEXTYPE)OMX_IndexVendorStartUnused + 0x100), /**< 0x7F000100 reference: OMX_STREAMINTERLACEFORMATTYPE */
+
+    /* Indices defined on the AP side only, understood by the DOMX proxies and
+     * the remote handlers written for them. They live in their own block well
+     * above the range shared with the remote core firmware so that indices the
+     * firmware adds later can never collide with them. New AP-only indices go
+     * at the end of this block, the block is not to be used for anything else */
+    OMX_TI_IndexApOnlyStartUnused = ((OMX_INDEXTYPE)OMX_IndexVendorStartUnused + 0x10000), /**< 0x7F010000 start of the AP-only block, not an index */
+    OMX_TI_IndexParamStatusPage,                        /**< 0x7F010001 reference: OMX_TI_CONFIG_SHAREDBUFFER */
+    OMX_TI_IndexParamBufferMapOnce,                     /**< 0x7F010002 reference: OMX_CONFIG_BOOLEANTYPE */
+    OMX_TI_IndexParamStructScratch,                     /**< 0x7F010003 reference: OMX_TI_CONFIG_SHAREDBUFFER */
+    OMX_TI_IndexConfigWorkloadHint,                     /**< 0x7F010004 reference: OMX_PARAM_U32TYPE */
+    OMX_TI_IndexConfigVideoLateness,                    /**< 0x7F010005 reference: OMX_TIME_CONFIG_TIMESTAMPTYPE */
+    OMX_TI_IndexConfigVideoDecodeSkip,                  /**< 0x7F010006 reference: OMX_TI_VIDEO_CONFIG_DECODESKIP */
+    OMX_TI_IndexParamVideoLowLatency,                   /**< 0x7F010007 reference: OMX_TI_VIDEO_PARAM_LOWLATENCY */
+    OMX_TI_IndexConfigCamFrameMetadata,                 /**< 0x7F010008 reference: OMX_TI_CONFIG_CAMFRAMEMETADATA */
+    OMX_TI_IndexParamVideoThumbnailMode,                /**< 0x7F010009 reference: OMX_CONFIG_BOOLEANTYPE */
+    OMX_TI_IndexParamBulkFlushDone                      /**< 0x7F01000A reference: OMX_CONFIG_BOOLEANTYPE */
 } OMX_TI_INDEXTYPE;
 
 
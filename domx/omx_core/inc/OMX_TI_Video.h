@@ -2691,5 +2691,49 @@ typedef struct OMX_VC1BITSTREAMFORMATTYPE {
     OMX_VC1FORMATSTYPE eVC1Format;
 } OMX_VC1BITSTREAMFORMATTYPE;
 
+/**
+ * Decode effort for non-reference frames, lowered while playback is late
+ * (see OMX_TI_IndexConfigVideoLateness)
+ *
+ * STRUCT MEMBERS:
+ *  nSize                     : Size of the structure in bytes
+ *  nVersion                  : OMX specification version information
+ *  nPortIndex                : Input port of the decoder
+ *  bSkipNonRefFrames         : Non-reference frames are dropped undecoded
+ *  bDeblockOffNonRefFrames   : Non-reference frames are decoded without
+ *                              the loop/deblocking filter
+ */
+typedef struct OMX_TI_VIDEO_CONFIG_DECODESKIP {
+    OMX_U32         nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32         nPortIndex;
+    OMX_BOOL        bSkipNonRefFrames;
+    OMX_BOOL        bDeblockOffNonRefFrames;
+} OMX_TI_VIDEO_CONFIG_DECODESKIP;
+
+/**
+ * Low latency encoding for wireless display and video calls: no B frames,
+ * cyclic intra refresh instead of periodic IDR frames, CBR with a small
+ * VBV and slice based output. The proxy fills in fields left 0.
+ *
+ * STRUCT MEMBERS:
+ *  nSize                     : Size of the structure in bytes
+ *  nVersion                  : OMX specification version information
+ *  nPortIndex                : Output port of the encoder
+ *  bEnable                   : Low latency encoding on or off
+ *  nIntraRefreshRate         : Frames one full intra refresh takes
+ *  nVbvMs                    : VBV/HRD buffer size in ms of the bitrate
+ *  nSliceSize                : Bytes per slice
+ */
+typedef struct OMX_TI_VIDEO_PARAM_LOWLATENCY {
+    OMX_U32         nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32         nPortIndex;
+    OMX_BOOL        bEnable;
+    OMX_U32         nIntraRefreshRate;
+    OMX_U32         nVbvMs;
+    OMX_U32         nSliceSize;
+} OMX_TI_VIDEO_PARAM_LOWLATENCY;
+
 #endif /* OMX_TI_VIDEO_H */
 
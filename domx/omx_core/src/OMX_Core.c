@@ -35,6 +35,10 @@
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
 
 
 /* #include "OMX_RegLib.h" */
@@ -62,12 +66,32 @@
 /** Determine the number of elements in an array */
 #define COUNTOF(x) (sizeof(x) / sizeof(x[0]))
 
-/** Array to hold the DLL pointers for each allocated component */
+/** Array to hold the library (CoreLibrary) of each allocated component */
 static void   *pModules[MAXCOMP] = { 0 };
 
 /** Array to hold the component handles for each allocated component */
 static void   *pComponents[COUNTOF(pModules)] = { 0 };
 
+/** How long (ms) a component library stays loaded after its last handle is
+ *  freed, overridden by the OMX_CORE_LIB_IDLE_MS environment variable.
+ *  Components that are created and destroyed in a row (thumbnails, gallery
+ *  scrolling) then skip dlopen, relocation and library constructors. */
+#ifndef OMX_CORE_LIB_IDLE_MS
+#define OMX_CORE_LIB_IDLE_MS (10000)
+#endif
+
+/** A loaded component library, shared by all handles of the component */
+typedef struct CoreLibrary {
+    char              name[MAXNAMESIZE];
+    void             *pModule;
+    OMX_ERRORTYPE     (*pComponentInit)(OMX_HANDLETYPE *);
+    int               nRefs;
+    struct timespec   tIdleSince;
+} CoreLibrary;
+
+static CoreLibrary    sLibraries[MAXCOMP];
+static long           nLibIdleMs = OMX_CORE_LIB_IDLE_MS;
+
 /* count for call OMX_Init() */
 int                count = 0;
 pthread_mutex_t    mutex;
@@ -75,8 +99,74 @@ TIMM_OSAL_PTR      pCoreInitMutex = NULL;
 
 int               tableCount = 0;
 ComponentTable    componentTable[MAX_TABLE_SIZE];
+/** Set once the table is complete. OMX_GetHandle loads components by name
+ *  and never needs it, so it is only built by the first query, under
+ *  pCoreInitMutex, and dropped again by the last OMX_Deinit. */
+static int        bTableBuilt = 0;
 char             *sRoleArray[60][20];
 char              compName[60][200];
+/** Capabilities of every role of the table, NULL where they are unknown,
+ *  and the buffers behind them, allocated like sRoleArray */
+static ComponentCaps   *pTableCaps[MAX_TABLE_SIZE][MAX_ROLES];
+static ComponentCaps   *sCapsArray[MAX_TABLE_SIZE][MAX_ROLES];
+
+/** Hash indices over componentTable, rebuilt with the table, so name and
+ *  role queries don't have to strcmp their way through every entry.
+ *  Both are open addressed and kept at most half full. */
+#define CORE_NAME_BUCKETS (2 * MAX_TABLE_SIZE)
+#define CORE_ROLE_BUCKETS (2 * MAX_TABLE_SIZE * MAX_ROLES)
+
+typedef struct CoreRoleIndex {
+    OMX_STRING    role;         /* NULL while the bucket is free */
+    OMX_U32       nComps;
+    OMX_U32       nFirst;       /* first entry in sRoleComps */
+} CoreRoleIndex;
+
+/** table index + 1 of each name, 0 for a free bucket */
+static short            sNameIndex[CORE_NAME_BUCKETS];
+static CoreRoleIndex    sRoleIndex[CORE_ROLE_BUCKETS];
+/** table indices of the components of every role, grouped by role */
+static OMX_U8           sRoleComps[MAX_TABLE_SIZE * MAX_ROLES];
+/** sLibraries slot + 1 last used by each table entry, 0 if none */
+static short            sLibSlot[MAX_TABLE_SIZE];
+
+#ifndef STATIC_TABLE
+/** Directory scanned for libOMX.*.so when the table is built at run time */
+#ifndef OMX_COMPONENT_LIBDIR
+#define OMX_COMPONENT_LIBDIR "/system/lib"
+#endif
+
+/** Cache of the component roles and their capabilities, so OMX_Init does
+ *  not have to instantiate every component to learn them. An entry is used
+ *  as long as the mtime and size of its library match, the whole file as
+ *  long as its format and the remote core firmware are the same. */
+#ifndef OMX_COMPONENT_REGISTRY
+#define OMX_COMPONENT_REGISTRY "/data/misc/media/omx_registry.txt"
+#endif
+#define OMX_COMPONENT_REGISTRY_VERSION 2
+
+/** The remote core firmware the capabilities were collected from */
+#ifndef OMX_CORE_FIRMWARE
+#define OMX_CORE_FIRMWARE "/vendor/firmware/ducati-m3-core0.xem3"
+#endif
+
+typedef struct CoreRegistryEntry {
+    char    file[256];
+    long    mtime;
+    long    size;
+    char    name[MAXNAMESIZE];
+    int     nRoles;
+    char    roles[MAX_ROLES][MAXNAMESIZE];
+    ComponentCaps   caps[MAX_ROLES];
+} CoreRegistryEntry;
+#endif
+
+#define CORE_INIT_STRUCT(_s_) do {\
+        memset(&(_s_), 0, sizeof(_s_));\
+        (_s_).nSize = sizeof(_s_);\
+        (_s_).nVersion.s.nVersionMajor = 1;\
+        (_s_).nVersion.s.nVersionMinor = 1;\
+} while( 0 )
 
 
 char   *tComponentName[MAXCOMP][MAX_ROLES] =
@@ -133,12 +223,259 @@ extern OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent);
                     goto EXIT; }\
 } while( 0 )
 
+/*===============================================================*/
+/** @fn Core_Hash : FNV-1a hash of a component or role name.
+ */
+/*===============================================================*/
+static OMX_U32 Core_Hash(const char *s)
+{
+    OMX_U32    h = 2166136261u;
+
+    while( *s ) {
+        h = (h ^ (unsigned char) *s++) * 16777619u;
+    }
+    return (h);
+}
+
+/*===============================================================*/
+/** @fn Core_NameFind : Returns the componentTable index of cName, -1 if
+ *                     the component is not in the table.
+ */
+/*===============================================================*/
+static int Core_NameFind(const char *cName)
+{
+    OMX_U32    b = Core_Hash(cName) % CORE_NAME_BUCKETS;
+    int        n;
+
+    while( (n = sNameIndex[b]) != 0 ) {
+        if( n <= tableCount && !strcmp(componentTable[n - 1].name, cName)) {
+            return (n - 1);
+        }
+        b = (b + 1) % CORE_NAME_BUCKETS;
+    }
+    return (-1);
+}
+
+/*===============================================================*/
+/** @fn Core_RoleFind : Returns the bucket of role, or the free bucket it
+ *                     would be added to.
+ */
+/*===============================================================*/
+static CoreRoleIndex *Core_RoleFind(const char *role)
+{
+    OMX_U32    b = Core_Hash(role) % CORE_ROLE_BUCKETS;
+
+    while( sRoleIndex[b].role != NULL && strcmp(sRoleIndex[b].role, role)) {
+        b = (b + 1) % CORE_ROLE_BUCKETS;
+    }
+    return (&sRoleIndex[b]);
+}
+
+/*===============================================================*/
+/** @fn Core_IndexBuild : Rebuilds the name and role indices from the first
+ *                       tableCount entries of componentTable.
+ */
+/*===============================================================*/
+static void Core_IndexBuild(void)
+{
+    CoreRoleIndex   *r = NULL;
+    OMX_U32          nNext = 0;
+    OMX_U32          b;
+    int              i, j;
+
+    memset(sNameIndex, 0, sizeof(sNameIndex));
+    memset(sRoleIndex, 0, sizeof(sRoleIndex));
+    memset(sLibSlot, 0, sizeof(sLibSlot));
+
+    /* count the components of every role, keeping the first entry of a
+     * duplicated name like the linear lookup did */
+    for( i = 0; i < tableCount; i++ ) {
+        b = Core_Hash(componentTable[i].name) % CORE_NAME_BUCKETS;
+        while( sNameIndex[b] != 0 &&
+               strcmp(componentTable[sNameIndex[b] - 1].name,
+                      componentTable[i].name)) {
+            b = (b + 1) % CORE_NAME_BUCKETS;
+        }
+        if( sNameIndex[b] == 0 ) {
+            sNameIndex[b] = i + 1;
+        }
+
+        for( j = 0; j < componentTable[i].nRoles; j++ ) {
+            r = Core_RoleFind(componentTable[i].pRoleArray[j]);
+            r->role = componentTable[i].pRoleArray[j];
+            r->nComps++;
+        }
+    }
+
+    /* then lay the lists out back to back, in table order */
+    for( b = 0; b < CORE_ROLE_BUCKETS; b++ ) {
+        sRoleIndex[b].nFirst = nNext;
+        nNext += sRoleIndex[b].nComps;
+        sRoleIndex[b].nComps = 0;
+    }
+    for( i = 0; i < tableCount; i++ ) {
+        for( j = 0; j < componentTable[i].nRoles; j++ ) {
+            r = Core_RoleFind(componentTable[i].pRoleArray[j]);
+            sRoleComps[r->nFirst + r->nComps++] = (OMX_U8) i;
+        }
+    }
+}
+
+/*===============================================================*/
+/** @fn Core_LibraryRelease : Unloads libraries that have been idle for
+ *                           longer than nLibIdleMs, or all idle ones when
+ *                           bAll is set. Called with mutex held.
+ */
+/*===============================================================*/
+static void Core_LibraryRelease(int bAll)
+{
+    struct timespec    tNow;
+    long               nIdleMs;
+    int                i;
+
+    clock_gettime(CLOCK_MONOTONIC, &tNow);
+    for( i = 0; i < (int)COUNTOF(sLibraries); i++ ) {
+        if( sLibraries[i].pModule == NULL || sLibraries[i].nRefs > 0 ) {
+            continue;
+        }
+        nIdleMs = (tNow.tv_sec - sLibraries[i].tIdleSince.tv_sec) * 1000 +
+                  (tNow.tv_nsec - sLibraries[i].tIdleSince.tv_nsec) / 1000000;
+        if( bAll || nIdleMs >= nLibIdleMs ) {
+            dlclose(sLibraries[i].pModule);
+            sLibraries[i].pModule = NULL;
+            sLibraries[i].name[0] = '\0';
+        }
+    }
+}
+
+/*===============================================================*/
+/** @fn Core_LibraryGet : Returns the loaded library of cComponentName,
+ *                       loading it if it is not resident. Called with
+ *                       mutex held.
+ */
+/*===============================================================*/
+static CoreLibrary *Core_LibraryGet(OMX_STRING cComponentName,
+                                    const char *pFile, OMX_ERRORTYPE *pError)
+{
+    CoreLibrary   *pLib = NULL;
+    const char    *pErr = NULL;
+    int            i, nFree = -1;
+    int            nEntry = bTableBuilt ? Core_NameFind(cComponentName) : -1;
+
+    /* the slot this component used last time is the likely one */
+    if( nEntry >= 0 && sLibSlot[nEntry] > 0 ) {
+        pLib = &sLibraries[sLibSlot[nEntry] - 1];
+        if( pLib->pModule != NULL && !strcmp(pLib->name, cComponentName)) {
+            pLib->nRefs++;
+            return (pLib);
+        }
+        pLib = NULL;
+    }
+
+    for( i = 0; i < (int)COUNTOF(sLibraries); i++ ) {
+        if( sLibraries[i].pModule != NULL &&
+            !strcmp(sLibraries[i].name, cComponentName)) {
+            sLibraries[i].nRefs++;
+            return (&sLibraries[i]);
+        }
+        if( sLibraries[i].pModule == NULL && nFree < 0 ) {
+            nFree = i;
+        }
+    }
+
+    if( nFree < 0 ) {
+        /* make room by dropping every idle library */
+        Core_LibraryRelease(1);
+        for( i = 0; i < (int)COUNTOF(sLibraries); i++ ) {
+            if( sLibraries[i].pModule == NULL ) {
+                nFree = i;
+                break;
+            }
+        }
+    }
+    if( nFree < 0 ) {
+        *pError = OMX_ErrorInsufficientResources;
+        return (NULL);
+    }
+
+    pLib = &sLibraries[nFree];
+    pLib->pModule = dlopen(pFile, RTLD_LAZY | RTLD_GLOBAL);
+    if( pLib->pModule == NULL ) {
+        TIMM_OSAL_Error("Failed because %s", (char *)dlerror());
+        *pError = OMX_ErrorComponentNotFound;
+        return (NULL);
+    }
+
+    /* Get a function pointer to the "OMX_ComponentInit" function.  If
+     * there is an error, we can't go on */
+    dlerror();
+    pLib->pComponentInit = dlsym(pLib->pModule, "OMX_ComponentInit");
+    pErr = dlerror();
+    if( pErr != NULL || pLib->pComponentInit == NULL ) {
+        TIMM_OSAL_Error("No OMX_ComponentInit in %s", pFile);
+        dlclose(pLib->pModule);
+        pLib->pModule = NULL;
+        *pError = OMX_ErrorInvalidComponent;
+        return (NULL);
+    }
+
+    strcpy(pLib->name, cComponentName);
+    pLib->nRefs = 1;
+    if( nEntry >= 0 ) {
+        sLibSlot[nEntry] = nFree + 1;
+    }
+    return (pLib);
+}
+
+/*===============================================================*/
+/** @fn Core_LibraryPut : Drops one reference, the library stays loaded
+ *                       until it has been idle for nLibIdleMs.
+ */
+/*===============================================================*/
+static void Core_LibraryPut(CoreLibrary *pLib)
+{
+    if( --pLib->nRefs == 0 ) {
+        clock_gettime(CLOCK_MONOTONIC, &pLib->tIdleSince);
+        if( nLibIdleMs <= 0 ) {
+            Core_LibraryRelease(0);
+        }
+    }
+}
+
+/*===============================================================*/
+/** @fn Core_TableEnsure : Builds the component table on first use. Must
+ *                        not be called with mutex held, the build may
+ *                        load components through OMX_GetHandle.
+ */
+/*===============================================================*/
+static OMX_ERRORTYPE Core_TableEnsure(void)
+{
+    OMX_ERRORTYPE          eError = OMX_ErrorNone;
+    TIMM_OSAL_ERRORTYPE    eOsalError = TIMM_OSAL_ERR_NONE;
+
+    if( bTableBuilt ) {
+        return (OMX_ErrorNone);
+    }
+
+    eOsalError = TIMM_OSAL_MutexObtain(pCoreInitMutex, TIMM_OSAL_SUSPEND);
+    CORE_assert(eOsalError == TIMM_OSAL_ERR_NONE,
+                OMX_ErrorInsufficientResources, "Mutex lock failed");
+    if( !bTableBuilt ) {
+        eError = OMX_BuildComponentTable();
+        bTableBuilt = (eError == OMX_ErrorNone);
+    }
+    TIMM_OSAL_MutexRelease(pCoreInitMutex);
+EXIT:
+    return (eError);
+}
+
 /******************************Public*Routine******************************\
 * OMX_Init()
 *
 * Description:This method will initialize the OMX Core.  It is the
 * responsibility of the application to call OMX_Init to ensure the proper
-* set up of core resources.
+* set up of core resources. The component table is built by the first
+* query that needs it, not here.
 *
 * Returns:    OMX_NOERROR          Successful
 *
@@ -158,7 +495,9 @@ OMX_ERRORTYPE OMX_Init()
 
     if( count == 1 ) {
         pthread_mutex_init(&mutex, NULL);
-        eError = OMX_BuildComponentTable();
+        if( getenv("OMX_CORE_LIB_IDLE_MS") != NULL ) {
+            nLibIdleMs = strtol(getenv("OMX_CORE_LIB_IDLE_MS"), NULL, 0);
+        }
     }
 
     eOsalError = TIMM_OSAL_MutexRelease(pCoreInitMutex);
@@ -199,13 +538,11 @@ OMX_ERRORTYPE OMX_GetHandle(OMX_HANDLETYPE *pHandle,
     static const char    prefix[] = "lib";
     static const char    postfix[] = ".so";
 
-    OMX_ERRORTYPE        (*pComponentInit)(OMX_HANDLETYPE *);
     OMX_ERRORTYPE        eError = OMX_ErrorNone;
     OMX_COMPONENTTYPE   *componentType;
+    CoreLibrary         *pLib = NULL;
     int                  i;
     char                 buf[sizeof(prefix) + MAXNAMESIZE + sizeof(postfix)];
-    const char          *pErr = dlerror();
-    char                *dlError = NULL;
 #ifdef CHECK_SECURE_STATE
     int       secure_misc_drv_fd, ret;
     OMX_U8    mode, enable=1;
@@ -283,27 +620,23 @@ OMX_ERRORTYPE OMX_GetHandle(OMX_HANDLETYPE *pHandle,
 #endif //CHECK_SECURE_STATE
 
 
-    //#if 0
-    pModules[i] = dlopen(buf, RTLD_LAZY | RTLD_GLOBAL);
-    if( pModules[i] == NULL ) {
-        dlError = (char *)dlerror();
-        TIMM_OSAL_Error("Failed because %s", dlError);
-        eError = OMX_ErrorComponentNotFound;
+    /* unload what has been idle for too long, then take the library of
+     * this component, it may still be resident from an earlier handle */
+    Core_LibraryRelease(0);
+    pLib = Core_LibraryGet(cComponentName, buf, &eError);
+    if( pLib == NULL ) {
         goto EXIT;
     }
-
-    /* Get a function pointer to the "OMX_ComponentInit" function.  If
-     * there is an error, we can't go on, so set the error code and exit */
-    pComponentInit = dlsym(pModules[i], "OMX_ComponentInit");
-    pErr = dlerror();
-    CORE_assert(((pErr == NULL) && (pComponentInit != NULL)),
-                OMX_ErrorInvalidComponent, NULL);
-    //#endif
+    pModules[i] = pLib;
 
     /* We now can access the dll.  So, we need to call the "OMX_ComponentInit"
      * method to load up the "handle" (which is just a list of functions to
      * call) and we should be all set.*/
     *pHandle = malloc(sizeof(OMX_COMPONENTTYPE));
+    if( *pHandle == NULL ) {
+        Core_LibraryPut(pLib);
+        pModules[i] = NULL;
+    }
     CORE_assert((*pHandle != NULL), OMX_ErrorInsufficientResources,
                 "Malloc of pHandle* failed");
 
@@ -316,7 +649,7 @@ OMX_ERRORTYPE OMX_GetHandle(OMX_HANDLETYPE *pHandle,
     componentType->nVersion.s.nRevision = 0;
     componentType->nVersion.s.nStep = 0;
 
-    eError =    (*pComponentInit)(*pHandle);
+    eError =    (*pLib->pComponentInit)(*pHandle);
     //eError = OMX_ComponentInit(*pHandle);
     if( OMX_ErrorNone == eError ) {
         eError =
@@ -333,7 +666,8 @@ OMX_ERRORTYPE OMX_GetHandle(OMX_HANDLETYPE *pHandle,
            ignore the return code */
         *pHandle = NULL;
         pComponents[i] = NULL;
-        dlclose(pModules[i]);
+        Core_LibraryPut(pLib);
+        pModules[i] = NULL;
         goto EXIT;
     }
     eError = OMX_ErrorNone;
@@ -388,8 +722,8 @@ OMX_ERRORTYPE OMX_FreeHandle(OMX_HANDLETYPE hComponent)
         TIMM_OSAL_Error("Error From ComponentDeInit..");
     }
 
-    /* release the component and the component handle */
-    dlclose(pModules[i]);
+    /* release the component handle, the library is kept for a while */
+    Core_LibraryPut((CoreLibrary *) pModules[i]);
     pModules[i] = NULL;
     free(pComponents[i]);
 
@@ -437,6 +771,8 @@ OMX_ERRORTYPE OMX_Deinit()
     }
 
     if( count == 0 ) {
+        Core_LibraryRelease(1);
+        bTableBuilt = 0;
         if( pthread_mutex_unlock(&mutex) != 0 ) {
             TIMM_OSAL_Error("Core: Error in Mutex unlock");
         }
@@ -478,7 +814,7 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_SetupTunnel(OMX_IN OMX_HANDLETYPE
                                                    hOutput, OMX_IN OMX_U32 nPortOutput, OMX_IN OMX_HANDLETYPE hInput,
                                                    OMX_IN OMX_U32 nPortInput)
 {
-    OMX_ERRORTYPE          eError = OMX_ErrorNotImplemented;
+    OMX_ERRORTYPE          eError = OMX_ErrorNone;
     OMX_COMPONENTTYPE     *pCompIn, *pCompOut;
     OMX_TUNNELSETUPTYPE    oTunnelSetup;
 
@@ -536,6 +872,9 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_ComponentNameEnum(OMX_OUT OMX_STRING
     CORE_require(cComponentName != NULL, OMX_ErrorBadParameter, NULL);
     CORE_require(count > 0, OMX_ErrorUndefined,
                  "OMX_GetHandle called without calling OMX_Init first");
+    eError = Core_TableEnsure();
+    CORE_assert(eError == OMX_ErrorNone, eError,
+                "Could not build Component Table");
 
     if( nIndex >= (OMX_U32)tableCount ) {
         eError = OMX_ErrorNoMore;
@@ -567,9 +906,8 @@ OMX_API OMX_ERRORTYPE OMX_GetRolesOfComponent(OMX_IN OMX_STRING
 {
 
     OMX_ERRORTYPE    eError = OMX_ErrorNone;
-    OMX_U32          i = 0;
+    int              i = 0;
     OMX_U32          j = 0;
-    OMX_BOOL         bFound = OMX_FALSE;
 
     CORE_require(cComponentName != NULL, OMX_ErrorBadParameter, NULL);
     CORE_require(pNumRoles != NULL, OMX_ErrorBadParameter, NULL);
@@ -577,20 +915,18 @@ OMX_API OMX_ERRORTYPE OMX_GetRolesOfComponent(OMX_IN OMX_STRING
                  OMX_ErrorInvalidComponentName, NULL);
     CORE_require(count > 0, OMX_ErrorUndefined,
                  "OMX_GetHandle called without calling OMX_Init first");
+    eError = Core_TableEnsure();
+    CORE_assert(eError == OMX_ErrorNone, eError,
+                "Could not build Component Table");
 
-    while( !bFound && i < (OMX_U32)tableCount ) {
-        if( strcmp(cComponentName, componentTable[i].name) == 0 ) {
-            bFound = OMX_TRUE;
-        } else {
-            i++;
-        }
-    }
+    i = Core_NameFind(cComponentName);
+    CORE_assert(i >= 0, OMX_ErrorInvalidComponentName, cComponentName);
 
     if( roles == NULL ) {
         *pNumRoles = componentTable[i].nRoles;
         goto EXIT;
     } else {
-        if( bFound && (*pNumRoles == componentTable[i].nRoles)) {
+        if( *pNumRoles == componentTable[i].nRoles ) {
             for( j = 0; j < componentTable[i].nRoles; j++ ) {
                 strcpy((OMX_STRING) roles[j],
                        componentTable[i].pRoleArray[j]);
@@ -620,37 +956,87 @@ OMX_API OMX_ERRORTYPE OMX_GetComponentsOfRole(OMX_IN OMX_STRING role,
                                               OMX_INOUT OMX_U32 *pNumComps, OMX_INOUT OMX_U8 * *compNames)
 {
     OMX_ERRORTYPE    eError = OMX_ErrorNone;
-    OMX_U32          i = 0;
-    OMX_U32          j = 0;
+    CoreRoleIndex   *r = NULL;
     OMX_U32          k = 0;
 
     CORE_require(role != NULL, OMX_ErrorBadParameter, NULL);
     CORE_require(pNumComps != NULL, OMX_ErrorBadParameter, NULL);
     CORE_require(count > 0, OMX_ErrorUndefined,
                  "OMX_GetHandle called without calling OMX_Init first");
+    eError = Core_TableEnsure();
+    CORE_assert(eError == OMX_ErrorNone, eError,
+                "Could not build Component Table");
 
     /* This implies that the componentTable is not filled */
-    CORE_assert(componentTable[i].pRoleArray[j] != NULL,
+    CORE_assert(componentTable[0].pRoleArray[0] != NULL,
                 OMX_ErrorBadParameter, NULL);
 
-    for( i = 0; i < (OMX_U32)tableCount; i++ ) {
-        for( j = 0; j < componentTable[i].nRoles; j++ ) {
-            if( strcmp(componentTable[i].pRoleArray[j],
-                       role) == 0 ) {
-                /* the first call to this function should only count the number
-                   of roles so that for the second call compNames can be allocated
-                   with the proper size for that number of roles */
-                if( compNames != NULL ) {
-                    strncpy((OMX_STRING) (compNames[k]),
-                            (OMX_STRING) componentTable[i].
-                            name, MAXNAMESIZE);
-                }
-                k++;
-            }
+    r = Core_RoleFind(role);
+    /* the first call to this function should only count the number
+       of roles so that for the second call compNames can be allocated
+       with the proper size for that number of roles */
+    if( compNames != NULL ) {
+        for( k = 0; k < r->nComps; k++ ) {
+            strncpy((OMX_STRING) (compNames[k]),
+                    (OMX_STRING) componentTable[sRoleComps[r->nFirst + k]].
+                    name, MAXNAMESIZE);
+        }
+    }
+    *pNumComps = r->nComps;
+
+EXIT:
+    return (eError);
+}
+
+/*************************************************************************
+* OMX_GetComponentCaps()
+*
+* Description: Returns the capabilities of a role of a component from the
+* component registry, without loading the component
+*
+* Parameters:
+* @param[in] cComponentName     The name of the component to query
+* @param[in] role     The role to query for
+* @param[out] pCaps      The capabilities of the role
+*
+* Returns:    OMX_NOERROR          Successful
+*                 OMX_ErrorNotImplemented   No capabilities known for the
+*                                           component, it has to be queried
+*
+* Note
+*
+**************************************************************************/
+OMX_API OMX_ERRORTYPE OMX_GetComponentCaps(OMX_IN OMX_STRING cComponentName,
+                                           OMX_IN OMX_STRING role, OMX_OUT ComponentCaps *pCaps)
+{
+    OMX_ERRORTYPE    eError = OMX_ErrorNone;
+    int              i = 0, j = 0;
+
+    CORE_require(cComponentName != NULL, OMX_ErrorBadParameter, NULL);
+    CORE_require(role != NULL, OMX_ErrorBadParameter, NULL);
+    CORE_require(pCaps != NULL, OMX_ErrorBadParameter, NULL);
+    CORE_require(count > 0, OMX_ErrorUndefined,
+                 "OMX_GetHandle called without calling OMX_Init first");
+    eError = Core_TableEnsure();
+    CORE_assert(eError == OMX_ErrorNone, eError,
+                "Could not build Component Table");
+
+    i = Core_NameFind(cComponentName);
+    CORE_assert(i >= 0, OMX_ErrorInvalidComponentName, cComponentName);
+
+    for( j = 0; j < componentTable[i].nRoles; j++ ) {
+        if( !strcmp(componentTable[i].pRoleArray[j], role)) {
+            break;
         }
+    }
+    CORE_assert(j < componentTable[i].nRoles, OMX_ErrorBadParameter, role);
 
-        *pNumComps = k;
+    /* built in entries and STATIC_TABLE builds have no registry */
+    if( pTableCaps[i][j] == NULL ) {
+        eError = OMX_ErrorNotImplemented;
+        goto EXIT;
     }
+    memcpy(pCaps, pTableCaps[i][j], sizeof(ComponentCaps));
 
 EXIT:
     return (eError);
@@ -666,6 +1052,10 @@ OMX_API OMX_ERRORTYPE OMX_PrintComponentTable()
     int              i = 0;
     int              j = 0;
 
+    eError = Core_TableEnsure();
+    CORE_assert(eError == OMX_ErrorNone, eError,
+                "Could not build Component Table");
+
     TIMM_OSAL_Info
         ("--------Component Table:: %d Components found-------------",
         tableCount);
@@ -682,143 +1072,415 @@ OMX_API OMX_ERRORTYPE OMX_PrintComponentTable()
     TIMM_OSAL_Info
         ("-----------------End Component Table ------------------");
 
+EXIT:
     return (eError);
 
 }
 
-OMX_ERRORTYPE OMX_BuildComponentTable()
+#ifndef STATIC_TABLE
+/*===============================================================*/
+/** @fn Core_RoleSlot : Returns the role string buffer j of table entry t,
+ *                     allocating it the first time the table is built.
+ */
+/*===============================================================*/
+static OMX_STRING Core_RoleSlot(int t, int j)
+{
+    if( sRoleArray[t][j] == NULL ) {
+        sRoleArray[t][j] = (OMX_STRING) malloc(sizeof(OMX_U8) * MAXNAMESIZE);
+    }
+    return (sRoleArray[t][j]);
+}
+
+/*===============================================================*/
+/** @fn Core_CapsSlot : Returns the capabilities buffer j of table entry t,
+ *                     allocating it the first time it is needed.
+ */
+/*===============================================================*/
+static ComponentCaps *Core_CapsSlot(int t, int j)
+{
+    if( sCapsArray[t][j] == NULL ) {
+        sCapsArray[t][j] = (ComponentCaps *) malloc(sizeof(ComponentCaps));
+    }
+    return (sCapsArray[t][j]);
+}
+
+/*===============================================================*/
+/** @fn Core_RegistryKey : Version key of the registry, made of the remote
+ *                        core firmware the capabilities depend on.
+ */
+/*===============================================================*/
+static void Core_RegistryKey(long *pMtime, long *pSize)
+{
+    struct stat    sStat;
+
+    *pMtime = 0;
+    *pSize = 0;
+    if( stat(OMX_CORE_FIRMWARE, &sStat) == 0 ) {
+        *pMtime = (long) sStat.st_mtime;
+        *pSize = (long) sStat.st_size;
+    }
+}
+
+/*===============================================================*/
+/** @fn Core_RegistryLoadCaps : Reads the capabilities of one role.
+ *
+ *      <nProfileLevels> [<profile> <level> ...]
+ *      <nColorFormats> [<format> ...] <width> <height>
+ */
+/*===============================================================*/
+static int Core_RegistryLoadCaps(FILE *pFile, ComponentCaps *c)
+{
+    OMX_U32    k;
+
+    if( fscanf(pFile, "%lu", &c->nProfileLevels) != 1 ||
+        c->nProfileLevels > MAX_CAPS_PROFILE_LEVELS ) {
+        return (0);
+    }
+    for( k = 0; k < c->nProfileLevels; k++ ) {
+        if( fscanf(pFile, "%lu %lu", &c->sProfileLevels[k].eProfile,
+                   &c->sProfileLevels[k].eLevel) != 2 ) {
+            return (0);
+        }
+    }
+    if( fscanf(pFile, "%lu", &c->nColorFormats) != 1 ||
+        c->nColorFormats > MAX_CAPS_COLOR_FORMATS ) {
+        return (0);
+    }
+    for( k = 0; k < c->nColorFormats; k++ ) {
+        if( fscanf(pFile, "%lu", &c->eColorFormats[k]) != 1 ) {
+            return (0);
+        }
+    }
+    return (fscanf(pFile, "%lu %lu", &c->nFrameWidth, &c->nFrameHeight) == 2);
+}
+
+/*===============================================================*/
+/** @fn Core_RegistryLoad : Reads the component registry cache.
+ *
+ *  The first line is the format version and the version key:
+ *      omx-registry <version> <firmware mtime> <firmware size>
+ *  Every other line describes one library:
+ *      <file> <mtime> <size> <component> <nRoles> [<role> <caps> ...]
+ *  Returns the number of entries read, 0 if there is no usable cache.
+ */
+/*===============================================================*/
+static int Core_RegistryLoad(CoreRegistryEntry *pEntries, int nMax)
+{
+    FILE   *pFile = fopen(OMX_COMPONENT_REGISTRY, "r");
+    int     nEntries = 0, j = 0, nVersion = 0;
+    long    nKeyMtime = 0, nKeySize = 0, nMtime = 0, nSize = 0;
+    CoreRegistryEntry   *e = NULL;
+
+    if( pFile == NULL ) {
+        return (0);
+    }
+
+    Core_RegistryKey(&nKeyMtime, &nKeySize);
+    if( fscanf(pFile, "omx-registry %d %ld %ld", &nVersion, &nMtime,
+               &nSize) != 3 || nVersion != OMX_COMPONENT_REGISTRY_VERSION ||
+        nMtime != nKeyMtime || nSize != nKeySize ) {
+        fclose(pFile);
+        return (0);
+    }
+
+    while( nEntries < nMax ) {
+        e = &pEntries[nEntries];
+        if( fscanf(pFile, "%255s %ld %ld %127s %d", e->file, &e->mtime,
+                   &e->size, e->name, &e->nRoles) != 5 ) {
+            break;
+        }
+        if( e->nRoles < 0 || e->nRoles > MAX_ROLES ) {
+            break;
+        }
+        for( j = 0; j < e->nRoles; j++ ) {
+            if( fscanf(pFile, "%127s", e->roles[j]) != 1 ||
+                !Core_RegistryLoadCaps(pFile, &e->caps[j])) {
+                break;
+            }
+        }
+        if( j != e->nRoles ) {
+            break;
+        }
+        nEntries++;
+    }
+
+    fclose(pFile);
+    return (nEntries);
+}
+
+/*===============================================================*/
+/** @fn Core_RegistryStore : Writes the registry cache. The file is written
+ *                          next to the old one and renamed over it, so a
+ *                          reader never sees half a registry.
+ */
+/*===============================================================*/
+static void Core_RegistryStore(CoreRegistryEntry *pEntries, int nEntries)
+{
+    FILE   *pFile = NULL;
+    ComponentCaps   *c = NULL;
+    long    nKeyMtime = 0, nKeySize = 0;
+    int     i, j;
+    OMX_U32 k;
+
+    pFile = fopen(OMX_COMPONENT_REGISTRY ".tmp", "w");
+    if( pFile == NULL ) {
+        TIMM_OSAL_Warning("Can't write " OMX_COMPONENT_REGISTRY);
+        return;
+    }
+
+    Core_RegistryKey(&nKeyMtime, &nKeySize);
+    fprintf(pFile, "omx-registry %d %ld %ld\n",
+            OMX_COMPONENT_REGISTRY_VERSION, nKeyMtime, nKeySize);
+    for( i = 0; i < nEntries; i++ ) {
+        fprintf(pFile, "%s %ld %ld %s %d", pEntries[i].file,
+                pEntries[i].mtime, pEntries[i].size, pEntries[i].name,
+                pEntries[i].nRoles);
+        for( j = 0; j < pEntries[i].nRoles; j++ ) {
+            c = &pEntries[i].caps[j];
+            fprintf(pFile, " %s %lu", pEntries[i].roles[j],
+                    c->nProfileLevels);
+            for( k = 0; k < c->nProfileLevels; k++ ) {
+                fprintf(pFile, " %lu %lu", c->sProfileLevels[k].eProfile,
+                        c->sProfileLevels[k].eLevel);
+            }
+            fprintf(pFile, " %lu", c->nColorFormats);
+            for( k = 0; k < c->nColorFormats; k++ ) {
+                fprintf(pFile, " %lu", c->eColorFormats[k]);
+            }
+            fprintf(pFile, " %lu %lu", c->nFrameWidth, c->nFrameHeight);
+        }
+        fprintf(pFile, "\n");
+    }
+
+    if( fclose(pFile) != 0 ||
+        rename(OMX_COMPONENT_REGISTRY ".tmp", OMX_COMPONENT_REGISTRY) != 0 ) {
+        TIMM_OSAL_Warning("Can't update " OMX_COMPONENT_REGISTRY);
+        unlink(OMX_COMPONENT_REGISTRY ".tmp");
+    }
+}
+
+/*===============================================================*/
+/** @fn Core_RegistryQueryCaps : Collects the capabilities of the role the
+ *                              component is set to. Components without
+ *                              video ports just end up with none.
+ */
+/*===============================================================*/
+static void Core_RegistryQueryCaps(OMX_HANDLETYPE hComp, ComponentCaps *c)
+{
+    OMX_VIDEO_PARAM_PROFILELEVELTYPE    sProfileLevel;
+    OMX_VIDEO_PARAM_PORTFORMATTYPE      sFormat;
+    OMX_PARAM_PORTDEFINITIONTYPE        sPortDef;
+    OMX_U32                             nPort, k;
+
+    for( nPort = 0; nPort < 2; nPort++ ) {
+        for( k = 0; c->nProfileLevels < MAX_CAPS_PROFILE_LEVELS; k++ ) {
+            CORE_INIT_STRUCT(sProfileLevel);
+            sProfileLevel.nPortIndex = nPort;
+            sProfileLevel.nProfileIndex = k;
+            if( OMX_GetParameter(hComp,
+                                 OMX_IndexParamVideoProfileLevelQuerySupported,
+                                 &sProfileLevel) != OMX_ErrorNone ) {
+                break;
+            }
+            c->sProfileLevels[c->nProfileLevels].eProfile = sProfileLevel.eProfile;
+            c->sProfileLevels[c->nProfileLevels].eLevel = sProfileLevel.eLevel;
+            c->nProfileLevels++;
+        }
+
+        CORE_INIT_STRUCT(sPortDef);
+        sPortDef.nPortIndex = nPort;
+        if( OMX_GetParameter(hComp, OMX_IndexParamPortDefinition,
+                             &sPortDef) != OMX_ErrorNone ||
+            sPortDef.eDomain != OMX_PortDomainVideo ||
+            sPortDef.format.video.eCompressionFormat != OMX_VIDEO_CodingUnused ) {
+            continue;
+        }
+        c->nFrameWidth = sPortDef.format.video.nFrameWidth;
+        c->nFrameHeight = sPortDef.format.video.nFrameHeight;
+        for( k = 0; c->nColorFormats < MAX_CAPS_COLOR_FORMATS; k++ ) {
+            CORE_INIT_STRUCT(sFormat);
+            sFormat.nPortIndex = nPort;
+            sFormat.nIndex = k;
+            if( OMX_GetParameter(hComp, OMX_IndexParamVideoPortFormat,
+                                 &sFormat) != OMX_ErrorNone ) {
+                break;
+            }
+            c->eColorFormats[c->nColorFormats++] = sFormat.eColorFormat;
+        }
+    }
+}
+
+/*===============================================================*/
+/** @fn Core_RegistryQuery : Learns the roles of one component and their
+ *                          capabilities the slow way, by loading it and
+ *                          asking it.
+ */
+/*===============================================================*/
+static OMX_ERRORTYPE Core_RegistryQuery(CoreRegistryEntry *e)
 {
     OMX_ERRORTYPE       eError = OMX_ErrorNone;
     OMX_CALLBACKTYPE    sCallbacks;
+    OMX_HANDLETYPE      hComp = 0;
+    OMX_PARAM_COMPONENTROLETYPE sRole;
+    int                 j = 0;
+
+    memset(e->caps, 0, sizeof(e->caps));
+
+    /* set up dummy call backs */
+    sCallbacks.EventHandler = ComponentTable_EventHandler;
+    sCallbacks.EmptyBufferDone = ComponentTable_EmptyBufferDone;
+    sCallbacks.FillBufferDone = ComponentTable_FillBufferDone;
+
+    eError = OMX_GetHandle(&hComp, e->name, 0x0, &sCallbacks);
+    CORE_assert(eError == OMX_ErrorNone, eError, e->name);
+
+    for( j = 0; j < MAX_ROLES; j++ ) {
+        if(((OMX_COMPONENTTYPE *) hComp)->ComponentRoleEnum(hComp,
+                                   (OMX_U8 *) e->roles[j], j) != OMX_ErrorNone ) {
+            break;
+        }
+        e->roles[j][MAXNAMESIZE - 1] = '\0';
+    }
+    e->nRoles = j;
+
+    for( j = 0; j < e->nRoles; j++ ) {
+        CORE_INIT_STRUCT(sRole);
+        strncpy((char *) sRole.cRole, e->roles[j], OMX_MAX_STRINGNAME_SIZE - 1);
+        if( e->nRoles > 1 &&
+            OMX_SetParameter(hComp, OMX_IndexParamStandardComponentRole,
+                             &sRole) != OMX_ErrorNone ) {
+            continue;
+        }
+        Core_RegistryQueryCaps(hComp, &e->caps[j]);
+    }
+
+    eError = OMX_FreeHandle(hComp);
+
+EXIT:
+    return (eError);
+}
+#endif
+
+OMX_ERRORTYPE OMX_BuildComponentTable()
+{
+    OMX_ERRORTYPE       eError = OMX_ErrorNone;
 
 #ifndef STATIC_TABLE
-    OMX_HANDLETYPE       hComp = 0;
-    OMX_U8               cRole[MAXNAMESIZE];
-    OMX_STRING           tempName = NULL;
-    OMX_STRING           temp = NULL;
-    static OMX_STRING    namePrefix = "OMX";
     static OMX_STRING    filePrefix = "libOMX.";
     static OMX_STRING    suffix = ".so";
+    struct dirent      **namelist = NULL;
+    struct stat          sStat;
+    char                 path[PATH_MAX];
+    CoreRegistryEntry   *pCache = NULL, *pFound = NULL;
+    int                  nCached = 0, nFresh = 0, bDirty = 0;
+    size_t               nLen = 0;
 #endif
     int    j = 0;
     int    numFiles = 0;
     int    i, k;
     int    componentfound = 0;
 
-    /* set up dummy call backs */
-    sCallbacks.EventHandler = ComponentTable_EventHandler;
-    sCallbacks.EmptyBufferDone = ComponentTable_EmptyBufferDone;
-    sCallbacks.FillBufferDone = ComponentTable_FillBufferDone;
+    tableCount = 0;
+    memset(pTableCaps, 0, sizeof(pTableCaps));
 
 #ifndef STATIC_TABLE
-    /* allocate the name table */
-    /*
-       compName = (OMX_STRING *) malloc(MAX_TABLE_SIZE * sizeof(OMX_STRING));
-       sRoleArray = (OMX_STRING**) malloc(MAX_TABLE_SIZE * sizeof(OMX_STRING));
-     */
+    /* entries [0, MAX_TABLE_SIZE) are the cache as read, the ones after it
+     * the registry as it will be written back */
+    pCache = (CoreRegistryEntry *) calloc(2 * MAX_TABLE_SIZE,
+                                          sizeof(CoreRegistryEntry));
+    CORE_assert(pCache != NULL, OMX_ErrorInsufficientResources, NULL);
+    nCached = Core_RegistryLoad(pCache, MAX_TABLE_SIZE);
 
     /* scan the target/lib directory and create a list of files in the directory */
-    numFiles = scandir(libdir, &namelist, 0, 0);
-    tableCount = 0;
+    numFiles = scandir(OMX_COMPONENT_LIBDIR, &namelist, 0, 0);
 
-    while( numFiles-- ) {
+    while( numFiles-- > 0 ) {
+        nLen = strlen(namelist[numFiles]->d_name);
         /*  check if the file is an OMX component */
-        if( strncmp(namelist[numFiles]->d_name, filePrefix,
-                    strlen(filePrefix)) == 0 ) {
-
-            /* if the file is an OMX component, trim the prefix and suffix */
-            tempName = (OMX_STRING) malloc(sizeof(namelist[numFiles]->d_name) + 1); /* adding one ensures */
-            memset(tempName, 0x00, sizeof(namelist[numFiles]->d_name) + 1); /*  that a null terminator will */
-            /*  always be present */
-            /* copy only the name without the suffix */
-            strncpy(tempName, namelist[numFiles]->d_name,
-                    strlen(namelist[numFiles]->d_name) -
-                    strlen(suffix));
-            /* set a pointer to be after the lib prefix, i.e the beginning of the component name */
-            temp = strstr(tempName, namePrefix);
-
-            /* then copy the component name to the table */
-            /*
-               compName[tableCount]= (OMX_STRING) malloc(MAXNAMESIZE);
-             */
-            strncpy(compName[tableCount], temp, strlen(temp) + 1);
-            componentTable[tableCount].name =
-                compName[tableCount];
-
-            /* get the handle for the component and query for the roles of each component */
-            eError =
-                OMX_GetHandle(&hComp,
-                              componentTable[tableCount].name, 0x0,
-                              &sCallbacks);
-            if( eError == OMX_ErrorNone ) {
-                j = 0;
-
-                while( eError != OMX_ErrorNoMore ) {
-                    eError =
-                        ((OMX_COMPONENTTYPE *) hComp)->
-                        ComponentRoleEnum(hComp, cRole,
-                                          j++);
-                    if( eError == OMX_ErrorNotImplemented ) {
-                        j = 1;
-                        break;
-                    }
+        if( tableCount < MAX_TABLE_SIZE &&
+            strncmp(namelist[numFiles]->d_name, filePrefix,
+                    strlen(filePrefix)) == 0 &&
+            nLen > strlen(filePrefix) + strlen(suffix) &&
+            nLen - strlen("lib") - strlen(suffix) < MAXNAMESIZE &&
+            strcmp(namelist[numFiles]->d_name + nLen - strlen(suffix),
+                   suffix) == 0 ) {
+
+            snprintf(path, sizeof(path), "%s/%s", OMX_COMPONENT_LIBDIR,
+                     namelist[numFiles]->d_name);
+            if( stat(path, &sStat) != 0 ) {
+                free(namelist[numFiles]);
+                continue;
+            }
+
+            /* a cached entry is only trusted while the library is unchanged */
+            pFound = NULL;
+            for( k = 0; k < nCached; k++ ) {
+                if( !strcmp(pCache[k].file, namelist[numFiles]->d_name) &&
+                    pCache[k].mtime == (long) sStat.st_mtime &&
+                    pCache[k].size == (long) sStat.st_size ) {
+                    pFound = &pCache[k];
+                    break;
                 }
+            }
 
-                nRoles = j - 1;
-                componentTable[tableCount].nRoles = nRoles;
-                /* sRoleArray[tableCount] = (OMX_STRING *) malloc(nRoles * sizeof(OMX_STRING)); */
-                if( nRoles > 0 ) {
-                    /* sRoleArray[tableCount] = (OMX_STRING *) malloc(nRoles * sizeof(OMX_STRING)); */
-                    for( j = 0; j < nRoles; j++ ) {
-                        sRoleArray[tableCount][j] =
-                            (OMX_STRING)
-                            malloc(sizeof(OMX_U8) *
-                                   MAXNAMESIZE);
-                        ((OMX_COMPONENTTYPE *)
-                         hComp)->
-                        ComponentRoleEnum(hComp,
-                                          (OMX_U8 *)
-                                          sRoleArray[tableCount][j],
-                                          j);
-                        componentTable[tableCount].
-                        pRoleArray[j] =
-                            sRoleArray[tableCount][j];
-                    }
-                } else {
-                    /* sRoleArray[tableCount] = (OMX_STRING *) malloc(sizeof(OMX_STRING));    */
-                    sRoleArray[tableCount][j] =
-                        (OMX_STRING) malloc(sizeof(OMX_U8)
-                                            * MAXNAMESIZE);
-                    strcpy(sRoleArray[tableCount][j],
-                           EMPTY_STRING);
-                    componentTable[tableCount].
-                    pRoleArray[j] =
-                        sRoleArray[tableCount][j];
+            if( pFound == NULL ) {
+                /* component name is the file name without "lib" and ".so" */
+                pFound = &pCache[MAX_TABLE_SIZE + nFresh];
+                strncpy(pFound->file, namelist[numFiles]->d_name,
+                        sizeof(pFound->file) - 1);
+                pFound->mtime = (long) sStat.st_mtime;
+                pFound->size = (long) sStat.st_size;
+                memset(pFound->name, 0, sizeof(pFound->name));
+                strncpy(pFound->name, namelist[numFiles]->d_name + strlen("lib"),
+                        nLen - strlen("lib") - strlen(suffix));
+                if( Core_RegistryQuery(pFound) != OMX_ErrorNone ) {
+                    TIMM_OSAL_Error("Can't query roles of %s", pFound->name);
+                    free(namelist[numFiles]);
+                    continue;
                 }
+                nFresh++;
+                bDirty = 1;
+            } else {
+                pCache[MAX_TABLE_SIZE + nFresh] = *pFound;
+                pFound = &pCache[MAX_TABLE_SIZE + nFresh++];
             }
-            if( hComp ) {
-                /* free the component handle */
-                eError = OMX_FreeHandle(hComp);
-                if( eError != OMX_ErrorNone ) {
-                    goto EXIT;
+
+            /* then copy the component name and roles to the table */
+            strcpy(compName[tableCount], pFound->name);
+            componentTable[tableCount].name = compName[tableCount];
+            componentTable[tableCount].nRoles = pFound->nRoles;
+            for( j = 0; j < pFound->nRoles; j++ ) {
+                componentTable[tableCount].pRoleArray[j] =
+                    strcpy(Core_RoleSlot(tableCount, j), pFound->roles[j]);
+                pTableCaps[tableCount][j] = Core_CapsSlot(tableCount, j);
+                if( pTableCaps[tableCount][j] != NULL ) {
+                    *pTableCaps[tableCount][j] = pFound->caps[j];
                 }
             }
-            /* increment the table counter index only if above was successful */
-            tableCount++;
-            if( tempName != NULL ) {
-                free(tempName);
+            if( pFound->nRoles == 0 ) {
+                componentTable[tableCount].pRoleArray[0] =
+                    strcpy(Core_RoleSlot(tableCount, 0), EMPTY_STRING);
             }
-
+            tableCount++;
         }
+        free(namelist[numFiles]);
     }
+    free(namelist);
 
+    /* libraries that went away also make the cache stale */
+    if( bDirty || nFresh != nCached ) {
+        Core_RegistryStore(&pCache[MAX_TABLE_SIZE], nFresh);
+    }
+    free(pCache);
 #endif
 
-    for( i = 0, numFiles = 0; i < MAXCOMP; i++ ) {
+    /* add the built in components the scan did not find */
+    for( i = 0, numFiles = tableCount; i < MAXCOMP; i++ ) {
         if( tComponentName[i][0] == NULL ) {
             break;
         }
 
+        componentfound = 0;
         for( j = 0; j < numFiles; j++ ) {
             if( !strcmp(componentTable[j].name,
                         tComponentName[i][0])) {
@@ -831,7 +1493,7 @@ OMX_ERRORTYPE OMX_BuildComponentTable()
             continue;
         }
 
-        if( j == numFiles ) { /* new component */
+        if( j == numFiles && numFiles < MAX_TABLE_SIZE ) { /* new component */
             k = 1;
 
             while( tComponentName[i][k] != NULL ) {
@@ -848,6 +1510,7 @@ OMX_ERRORTYPE OMX_BuildComponentTable()
     }
 
     tableCount = numFiles;
+    Core_IndexBuild();
 
     CORE_assert(eError == OMX_ErrorNone, eError,
                 "Could not build Component Table");
@@ -26,10 +26,11 @@ LOCAL_SHARED_LIBRARIES := \
 LOCAL_CFLAGS += -DLINUX -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_USE_LOADER
 LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES -DUSE_ENHANCED_PORTRECONFIG
 LOCAL_CFLAGS += -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION -DENABLE_GRALLOC_BUFFERS
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE_TAGS:= optional
 
 LOCAL_SRC_FILES:= omx_video_dec/src/omx_proxy_videodec.c \
-                  omx_video_dec/src/omx_proxy_videodec_utils.c
+                  omx_video_dec/src/omx_proxy_videodec_utils.c.neon
 
 # Uncomment the below 2 lines to enable the run time
 # dump of NV12 buffers from Decoder/Camera
@@ -63,6 +64,7 @@ LOCAL_SHARED_LIBRARIES := \
 LOCAL_CFLAGS += -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_USE_LOADER
 LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES -DUSE_ENHANCED_PORTRECONFIG
 LOCAL_CFLAGS += -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE_TAGS:= optional
 
 LOCAL_SRC_FILES:= omx_sample/src/omx_proxy_sample.c
@@ -91,11 +93,13 @@ LOCAL_SHARED_LIBRARIES := \
 	libOMX_Core \
 	liblog \
 	libion_ti \
-	libdomx
+	libdomx \
+	libcutils
 
 LOCAL_CFLAGS += -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_USE_LOADER
 LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES -DUSE_ENHANCED_PORTRECONFIG
 LOCAL_CFLAGS += -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE_TAGS:= optional
 
 LOCAL_SRC_FILES:= omx_camera/src/omx_proxy_camera.c \
@@ -105,7 +109,7 @@ LOCAL_MODULE:= libOMX.TI.DUCATI1.VIDEO.CAMERA
 include $(BUILD_SHARED_LIBRARY)
 
 #
-# libOMX.TI.DUCATI1.VIDEO.H264E
+# libdomx_colorconvert
 #
 
 include $(CLEAR_VARS)
@@ -136,6 +140,47 @@ LOCAL_CFLAGS += -DLINUX -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_U
 LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES
 LOCAL_CFLAGS += -DUSE_ENHANCED_PORTRECONFIG -DENABLE_GRALLOC_BUFFER -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION
 LOCAL_CFLAGS += -DANDROID_CUSTOM_OPAQUECOLORFORMAT
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
+LOCAL_MODULE_TAGS:= optional
+
+LOCAL_SRC_FILES:= omx_video_enc/src/omx_proxy_colorconvert.c.neon
+LOCAL_MODULE:= libdomx_colorconvert
+include $(BUILD_SHARED_LIBRARY)
+
+#
+# libOMX.TI.DUCATI1.VIDEO.H264E
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../omx_core/inc \
+	$(LOCAL_PATH)/../mm_osal/inc \
+	$(LOCAL_PATH)/../domx \
+	$(LOCAL_PATH)/../domx/omx_rpc/inc \
+	system/core/include/cutils \
+	$(COMMON_FOLDER)/hwc \
+	$(COMMON_FOLDER)/camera/inc \
+	frameworks/native/include/media/stagefright \
+	frameworks/native/include/media/hardware \
+	$(LOCAL_PATH)/../domx/plugins/inc/ \
+    $(LOCAL_PATH)/omx_video_enc/inc
+
+LOCAL_SHARED_LIBRARIES := \
+	libmm_osal \
+	libc \
+	libOMX_Core \
+	liblog \
+	libdomx \
+	libhardware \
+	libcutils \
+	libdomx_colorconvert
+
+LOCAL_CFLAGS += -DLINUX -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_USE_LOADER
+LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES
+LOCAL_CFLAGS += -DUSE_ENHANCED_PORTRECONFIG -DENABLE_GRALLOC_BUFFER -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION
+LOCAL_CFLAGS += -DANDROID_CUSTOM_OPAQUECOLORFORMAT
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE_TAGS:= optional
 
 LOCAL_SRC_FILES:= omx_video_enc/src/omx_h264_enc/src/omx_proxy_h264enc.c
@@ -168,12 +213,14 @@ LOCAL_SHARED_LIBRARIES := \
 	liblog \
 	libdomx \
 	libhardware \
-	libcutils
+	libcutils \
+	libdomx_colorconvert
 
 LOCAL_CFLAGS += -DLINUX -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_USE_LOADER
 LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES
 LOCAL_CFLAGS += -DUSE_ENHANCED_PORTRECONFIG -DENABLE_GRALLOC_BUFFER -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION
 LOCAL_CFLAGS += -DANDROID_CUSTOM_OPAQUECOLORFORMAT
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE_TAGS:= optional
 
 LOCAL_SRC_FILES:= omx_video_enc/src/omx_vc1_enc/src/omx_proxy_vc1enc.c
@@ -206,12 +253,14 @@ LOCAL_SHARED_LIBRARIES := \
 	liblog \
 	libdomx \
 	libhardware \
-	libcutils
+	libcutils \
+	libdomx_colorconvert
 
 LOCAL_CFLAGS += -DLINUX -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_USE_LOADER
 LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES
 LOCAL_CFLAGS += -DUSE_ENHANCED_PORTRECONFIG -DENABLE_GRALLOC_BUFFER -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION
 LOCAL_CFLAGS += -DANDROID_CUSTOM_OPAQUECOLORFORMAT
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE_TAGS:= optional
 
 LOCAL_SRC_FILES:= omx_video_enc/src/omx_h264svc_enc/src/omx_proxy_h264svcenc.c
@@ -244,12 +293,14 @@ LOCAL_SHARED_LIBRARIES := \
 	liblog \
 	libdomx \
 	libhardware \
-	libcutils
+	libcutils \
+	libdomx_colorconvert
 
 LOCAL_CFLAGS += -DLINUX -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_USE_LOADER
 LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES
 LOCAL_CFLAGS += -DUSE_ENHANCED_PORTRECONFIG -DENABLE_GRALLOC_BUFFER -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION
 LOCAL_CFLAGS += -DANDROID_CUSTOM_OPAQUECOLORFORMAT
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE_TAGS:= optional
 
 LOCAL_SRC_FILES:= omx_video_enc/src/omx_mpeg4_enc/src/omx_proxy_mpeg4enc.c
@@ -278,11 +329,13 @@ LOCAL_SHARED_LIBRARIES := \
 	liblog \
 	libdomx \
 	libhardware \
+	libcutils \
 	libOMX.TI.DUCATI1.VIDEO.DECODER
 
 LOCAL_CFLAGS += -DLINUX -DTMS32060 -D_DB_TIOMAP -DSYSLINK_USE_SYSMGR -DSYSLINK_USE_LOADER
 LOCAL_CFLAGS += -D_Android -DSET_STRIDE_PADDING_FROM_PROXY -DANDROID_QUIRK_CHANGE_PORT_VALUES -DUSE_ENHANCED_PORTRECONFIG
 LOCAL_CFLAGS += -DANDROID_QUIRK_LOCK_BUFFER -DUSE_ION -DENABLE_GRALLOC_BUFFERS
+LOCAL_CFLAGS += $(DOMX_TRACE_CFLAGS)
 LOCAL_MODULE_TAGS:= optional
 
 LOCAL_SRC_FILES:= omx_video_dec/src/omx_proxy_videodec_secure.c
@@ -60,6 +60,40 @@
 
 #define LINUX_PAGE_SIZE (4 * 1024)
 
+/* All DCC profiles packed in one file with an index of the files they came
+   from. It is used as long as every profile still has the size and mtime it
+   had when the pack was written, otherwise it is written again. */
+#define DCC_PACK_FILE "/data/misc/camera/dcc.pack"
+#define DCC_PACK_MAGIC (0x50434344)	/* "DCCP" */
+#define DCC_PACK_VERSION (1)
+#define DCC_PACK_MAX_FILES (128)
+#define DCC_PACK_PATH_MAX (256)
+
+/* Set to 1 to keep the DCC buffer allocated for as long as the camera
+   library is loaded. Every new camera instance then gets the resident
+   buffer again, profiles are only read when they changed. */
+#define DCC_RESIDENT_PROPERTY "debug.camera.dcc_resident"
+
+/* Set to 0 to allocate the VTC slice buffers for every video session
+   instead of sharing a pool sized for MAX_VTC_*_WITH_VNF between them */
+#define VTC_POOL_PROPERTY "debug.camera.vtc_pool"
+
+typedef struct DCC_PACK_ENTRY
+{
+	char sPath[DCC_PACK_PATH_MAX];
+	OMX_S32 nSize;
+	OMX_S32 nMtime;
+} DCC_PACK_ENTRY;
+
+/* The index follows the header, the profile data follows the index */
+typedef struct DCC_PACK_HEADER
+{
+	OMX_U32 nMagic;
+	OMX_U32 nVersion;
+	OMX_U32 nFiles;
+	OMX_U32 nDataSize;
+} DCC_PACK_HEADER;
+
 #define _PROXY_OMX_INIT_PARAM(param,type) do {		\
 	TIMM_OSAL_Memset((param), 0, sizeof (type));	\
 	(param)->nSize = sizeof (type);			\
@@ -77,10 +111,42 @@
 #define MAX_VTC_HEIGHT_WITH_VNF (MAX_VTC_HEIGHT + BORDER_HEIGHT)
 #define PREVIEW_PORT 2
 
+/* Component buffers (OMX_TI_IndexParamComponentBufferAllocation) kept per
+   port after a port disable, so the next mode switch can hand them out
+   again instead of allocating new ones */
+#define COMPONENT_BUFFER_POOL_SIZE 4
+
+typedef struct PROXY_CAM_COMPONENT_BUFFER
+{
+	MEMPLUGIN_BUFFER_PROPERTIES sProp;	/* pBufferHandle is NULL when unused */
+	OMX_U32 nSize;
+} PROXY_CAM_COMPONENT_BUFFER;
+
+/* Client buffers of the OMX_TI_CONFIG_SHAREDBUFFER configs stay registered
+   with the remote core, one per config index, so that repeated queries into
+   the same buffer need neither a new registration nor a new mapping */
+#define CAM_SHARED_BUFFER_SLOTS 6
+
+typedef struct PROXY_CAM_SHARED_BUFFER
+{
+	OMX_INDEXTYPE nIndex;
+	OMX_PTR pRegistered;	/* NULL when the slot is unused */
+} PROXY_CAM_SHARED_BUFFER;
+
 typedef struct OMX_PROXY_CAM_PRIVATE
 {
 	MEMPLUGIN_BUFFER_ACCESSOR sInternalBuffers[MAX_NUM_INTERNAL_BUFFERS][2];
-	OMX_PTR  gComponentBufferAllocation[PROXY_MAXNUMOFPORTS][MAX_NUM_INTERNAL_BUFFERS];
+	PROXY_CAM_COMPONENT_BUFFER gComponentBufferAllocation[PROXY_MAXNUMOFPORTS][MAX_NUM_INTERNAL_BUFFERS];
+	PROXY_CAM_COMPONENT_BUFFER sComponentBufferPool[PROXY_MAXNUMOFPORTS][COMPONENT_BUFFER_POOL_SIZE];
+	PROXY_CAM_SHARED_BUFFER sSharedBuffers[CAM_SHARED_BUFFER_SLOTS];
+	OMX_BOOL bDccSent;
+	OMX_BOOL bVtcPooled;	/* sInternalBuffers come from the library VTC pool */
+	/* Frame size the own sInternalBuffers were allocated for, 0 if there are
+	   none, and the slice height they were last set with. They are kept over
+	   Loaded so the next Idle only has to send what changed */
+	OMX_U32 nVtcWidth;
+	OMX_U32 nVtcHeight;
+	OMX_U32 nVtcSliceHeight;
 }OMX_PROXY_CAM_PRIVATE;
 
 
@@ -101,6 +167,10 @@ OMX_ERRORTYPE PROXY_SendCommand(OMX_HANDLETYPE, OMX_COMMANDTYPE,
 								        OMX_U32,OMX_PTR);
 OMX_ERRORTYPE CameraMaptoTilerDuc(OMX_TI_CONFIG_SHAREDBUFFER *, OMX_PTR *);
 OMX_ERRORTYPE OMX_CameraVtcFreeMemory(OMX_IN OMX_HANDLETYPE hComponent);
+OMX_ERRORTYPE GLUE_CameraSetParam(OMX_IN OMX_HANDLETYPE, OMX_IN OMX_INDEXTYPE,
+								OMX_INOUT OMX_PTR);
+void GLUE_CameraReleaseComponentBuffers(OMX_HANDLETYPE hComponent, OMX_U32 nPort);
+void GLUE_CameraFreeComponentBuffers(OMX_HANDLETYPE hComponent);
 //COREID TARGET_CORE_ID = CORE_APPM3;
 
 extern RPC_OMX_ERRORTYPE RPC_RegisterBuffer(OMX_HANDLETYPE hRPCCtx, int fd1,
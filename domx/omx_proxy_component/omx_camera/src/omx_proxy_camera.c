@@ -57,6 +57,7 @@
 /******************************************************************
  *   INCLUDE FILES
  ******************************************************************/
+#include <pthread.h>
 #include "omx_proxy_camera.h"
 
 #ifdef USE_ION
@@ -67,6 +68,9 @@
 #include <sys/eventfd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/stat.h>
+#include <cutils/properties.h>
+#include "memplugin_ion.h"
 #endif
 
 /* Tiler heap resservation specific */
@@ -77,6 +81,9 @@
 static OMX_S16 numofInstance = 0;
 int dcc_flag = 0;
 TIMM_OSAL_PTR cam_mutex = NULL;
+/* Cam_Setup() runs with the first component, not at library load */
+static pthread_once_t sCamSetupOnce = PTHREAD_ONCE_INIT;
+static void Cam_Setup(void);
 
 /* To store DCC buffer size */
 OMX_S32 dccbuf_size = 0;
@@ -84,6 +91,40 @@ OMX_S32 dccbuf_size = 0;
 /* DCC buff accessors */
 MEMPLUGIN_BUFFER_ACCESSOR sDccBuffer;
 
+/* MemPlugin client of the library, for buffers that outlive the component
+   that allocated them */
+static OMX_PTR pCamMemPluginHandle = NULL;
+static OMX_U32 nCamClientDesc = 0;
+
+/* Resident DCC buffer, see DCC_RESIDENT_PROPERTY */
+static OMX_BOOL bDccResident = OMX_FALSE;
+static DCC_PACK_ENTRY *pDccEntries = NULL;
+static OMX_S32 nDccFiles = -1;
+
+/* VTC slice buffers shared by the camera instances, see VTC_POOL_PROPERTY.
+   hOwner is the instance they are registered with, protected by cam_mutex */
+typedef struct CAM_VTC_POOL
+{
+	OMX_BOOL bEnabled;
+	OMX_BOOL bAllocated;
+	OMX_HANDLETYPE hOwner;
+	MEMPLUGIN_BUFFER_ACCESSOR sBuffers[MAX_NUM_INTERNAL_BUFFERS][2];
+} CAM_VTC_POOL;
+static CAM_VTC_POOL sVtcPool;
+
+static OMX_ERRORTYPE Cam_OpenLibMemPlugin(void);
+static OMX_ERRORTYPE _OMX_CameraVtcPoolAcquire(OMX_HANDLETYPE hComponent,
+    OMX_TI_PARAM_VTCSLICE * pVtcConfig);
+static void _OMX_CameraVtcPoolFree(void);
+
+static void DCC_FreeBuffer(OMX_PTR pMemPluginHandle, OMX_U32 nClientDesc);
+static OMX_S32 DCC_ListFiles(OMX_STRING * dir_path, OMX_U16 numofURI,
+    DCC_PACK_ENTRY * pEntries, OMX_U32 nMax);
+static OMX_BOOL DCC_ReadPack(OMX_PTR buffer, DCC_PACK_ENTRY * pEntries,
+    OMX_S32 nFiles, OMX_S32 nDataSize);
+static void DCC_WritePack(OMX_PTR buffer, DCC_PACK_ENTRY * pEntries,
+    OMX_S32 nFiles, OMX_S32 nDataSize);
+
 /* ===========================================================================*/
 /**
  * @name _OMX_CameraVtcFreeMemory
@@ -109,6 +150,26 @@ OMX_ERRORTYPE OMX_CameraVtcFreeMemory(OMX_IN OMX_HANDLETYPE hComponent)
 
     MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
 
+    if (pCamPrv->bVtcPooled) {
+        /* Pool buffers are only unregistered, they stay for the next session */
+        for(i=0; i < MAX_NUM_INTERNAL_BUFFERS * 2; i++) {
+            MEMPLUGIN_BUFFER_ACCESSOR *pBuf = &pCamPrv->sInternalBuffers[i / 2][i % 2];
+            if (pBuf->pRegBufferHandle != NULL) {
+                eRPCError = RPC_UnRegisterBuffer(pCompPrv->hRemoteComp, pBuf->pRegBufferHandle, NULL , IONPointers);
+                if (eRPCError != RPC_OMX_ErrorNone) {
+                    DOMX_ERROR("%s: DOMX: Unexpected error occurred while Unregistering pool Buffer#%d: eRPCError = 0x%x", __func__, i, eRPCError);
+                }
+            }
+            pBuf->pRegBufferHandle = NULL;
+            pBuf->pBufferHandle = NULL;
+        }
+        pCamPrv->bVtcPooled = OMX_FALSE;
+        TIMM_OSAL_MutexObtain(cam_mutex, TIMM_OSAL_SUSPEND);
+        sVtcPool.hOwner = NULL;
+        TIMM_OSAL_MutexRelease(cam_mutex);
+        goto EXIT;
+    }
+
     for(i=0; i < MAX_NUM_INTERNAL_BUFFERS; i++) {
         if (pCamPrv->sInternalBuffers[i][0].pBufferHandle != NULL) {
             eRPCError = RPC_UnRegisterBuffer(pCompPrv->hRemoteComp, pCamPrv->sInternalBuffers[i][0].pRegBufferHandle, NULL , IONPointers);
@@ -133,12 +194,177 @@ OMX_ERRORTYPE OMX_CameraVtcFreeMemory(OMX_IN OMX_HANDLETYPE hComponent)
             DOMX_DEBUG("%s: DOMX: #%d UV Memory freed; eRPCError = 0x%x", __func__, i, eRPCError);
         }
     }
+    pCamPrv->nVtcWidth = 0;
+    pCamPrv->nVtcHeight = 0;
+    pCamPrv->nVtcSliceHeight = 0;
 
 EXIT:
    DOMX_EXIT("eError: %d", eError);
    return eError;
 }
 
+/* ===========================================================================*/
+/**
+ * @name CameraSharedBuffRegister()
+ * @brief Returns the registered handle of the client buffer fd for a shared
+ *        buffer config index. The slot of the index keeps one reference on
+ *        the registration, so the registration cache never evicts it and the
+ *        remote core sees the same handle on every query. A new buffer for
+ *        the index replaces the old registration.
+ * @param pCompPrv [IN] : Proxy component private.
+ * @param nIndex [IN] : Config index the buffer is passed with.
+ * @param fd [IN] : Client buffer fd.
+ * @return The registered handle, NULL if the fd has to be passed as it is
+ */
+/* ===========================================================================*/
+static OMX_PTR CameraSharedBuffRegister(PROXY_COMPONENT_PRIVATE *pCompPrv,
+    OMX_INDEXTYPE nIndex, OMX_S32 fd)
+{
+    OMX_PROXY_CAM_PRIVATE* pCamPrv;
+    PROXY_CAM_SHARED_BUFFER *pSlot = NULL;
+    RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+    OMX_PTR pRegistered = NULL;
+    OMX_U32 i = 0;
+
+    pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
+    if (pCamPrv == NULL || fd < 0)
+        return NULL;
+
+    for (i = 0; i < CAM_SHARED_BUFFER_SLOTS; i++) {
+        PROXY_CAM_SHARED_BUFFER *pBuf = &pCamPrv->sSharedBuffers[i];
+        if (pBuf->pRegistered != NULL && pBuf->nIndex == nIndex) {
+            pSlot = pBuf;
+            break;
+        }
+        if (pBuf->pRegistered == NULL && pSlot == NULL)
+            pSlot = pBuf;
+    }
+    if (pSlot == NULL)
+        return NULL;
+
+    /* Same buffer as last time is a registration cache hit, no ioctl */
+    eRPCError = RPC_RegisterBuffer(pCompPrv->hRemoteComp, fd, -1,
+                    &pRegistered, NULL, IONPointers);
+    if (eRPCError != RPC_OMX_ErrorNone || pRegistered == NULL) {
+        DOMX_ERROR("%s: DOMX: Registering shared buffer failed: eRPCError = 0x%x", __func__, eRPCError);
+        return NULL;
+    }
+
+    if (pSlot->pRegistered == pRegistered) {
+        /* The slot already holds its reference */
+        RPC_UnRegisterBuffer(pCompPrv->hRemoteComp, pRegistered, NULL, IONPointers);
+    } else {
+        if (pSlot->pRegistered != NULL)
+            RPC_UnRegisterBuffer(pCompPrv->hRemoteComp, pSlot->pRegistered, NULL, IONPointers);
+        pSlot->nIndex = nIndex;
+        pSlot->pRegistered = pRegistered;
+    }
+
+    return pRegistered;
+}
+
+/* ===========================================================================*/
+/**
+ * @name CameraSharedBuffRelease()
+ * @brief Drops the shared buffer registrations kept by CameraSharedBuffRegister
+ *
+ * @param pCompPrv [IN] : Proxy component private.
+ * @return none
+ */
+/* ===========================================================================*/
+static void CameraSharedBuffRelease(PROXY_COMPONENT_PRIVATE *pCompPrv)
+{
+    OMX_PROXY_CAM_PRIVATE* pCamPrv;
+    RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+    OMX_U32 i = 0;
+
+    pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
+    if (pCamPrv == NULL)
+        return;
+
+    for (i = 0; i < CAM_SHARED_BUFFER_SLOTS; i++) {
+        PROXY_CAM_SHARED_BUFFER *pBuf = &pCamPrv->sSharedBuffers[i];
+        if (pBuf->pRegistered != NULL) {
+            eRPCError = RPC_UnRegisterBuffer(pCompPrv->hRemoteComp, pBuf->pRegistered, NULL, IONPointers);
+            if (eRPCError != RPC_OMX_ErrorNone) {
+                DOMX_ERROR("%s: DOMX: Unexpected error occurred while Unregistering shared buffer#%d: eRPCError = 0x%x", __func__, i, eRPCError);
+            }
+            pBuf->pRegistered = NULL;
+        }
+    }
+}
+
+/* ===========================================================================*/
+/**
+ * @name _OMX_CameraVtcFrameDim
+ * @brief Frame size the VTC buffers have to hold, the largest VNF frame if
+ *        the component does not tell
+ */
+/* ===========================================================================*/
+static void _OMX_CameraVtcFrameDim(OMX_HANDLETYPE hComponent,
+    OMX_U32 *pWidth, OMX_U32 *pHeight)
+{
+    OMX_CONFIG_RECTTYPE tFrameDim;
+
+    _PROXY_OMX_INIT_PARAM(&tFrameDim, OMX_CONFIG_RECTTYPE);
+    tFrameDim.nPortIndex = PREVIEW_PORT; //Preview Port
+    if(OMX_GetParameter(hComponent, OMX_TI_IndexParam2DBufferAllocDimension, &tFrameDim) == OMX_ErrorNone){
+        DOMX_DEBUG("Acquired OMX_TI_IndexParam2DBufferAllocDimension data. nWidth = %d, nHeight = %d.\n\n", tFrameDim.nWidth, tFrameDim.nHeight);
+        *pWidth = tFrameDim.nWidth;
+        *pHeight = tFrameDim.nHeight;
+    }else {
+        DOMX_DEBUG("%s: No OMX_TI_IndexParam2DBufferAllocDimension data.\n\n", __func__);
+        *pWidth = MAX_VTC_WIDTH_WITH_VNF;
+        *pHeight = MAX_VTC_HEIGHT_WITH_VNF;
+    }
+}
+
+/* ===========================================================================*/
+/**
+ * @name _OMX_CameraVtcReuseMemory
+ * @brief Hands the VTC buffers kept from the last session to the component
+ *        again. They are still registered and the component keeps
+ *        OMX_TI_IndexParamVtcSlice over Loaded, so it is only sent when the
+ *        slice height has changed since.
+ *
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE _OMX_CameraVtcReuseMemory(OMX_HANDLETYPE hComponent,
+    OMX_TI_PARAM_VTCSLICE * pVtcConfig)
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    PROXY_COMPONENT_PRIVATE *pCompPrv;
+    OMX_PROXY_CAM_PRIVATE* pCamPrv;
+    OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+    OMX_U32 i;
+
+    pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+    pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
+
+    if (pVtcConfig->nSliceHeight == pCamPrv->nVtcSliceHeight) {
+        DOMX_DEBUG("%s: VTC buffers unchanged", __func__);
+        return OMX_ErrorNone;
+    }
+
+    for (i = 0; i < MAX_NUM_INTERNAL_BUFFERS; i++) {
+        pVtcConfig->nInternalBuffers = i;
+        pVtcConfig->IonBufhdl[0] = (OMX_PTR)pCamPrv->sInternalBuffers[i][0].pRegBufferHandle;
+        pVtcConfig->IonBufhdl[1] = (OMX_PTR)pCamPrv->sInternalBuffers[i][1].pRegBufferHandle;
+        eError = __PROXY_SetParameter(hComponent,
+                                      OMX_TI_IndexParamVtcSlice,
+                                      pVtcConfig,
+                                      pVtcConfig->IonBufhdl, 2);
+        if (eError != OMX_ErrorNone) {
+            DOMX_ERROR("DOMX: PROXY_SetParameter for OMX_TI_IndexParamVtcSlice completed with error 0x%x\n", eError);
+            OMX_CameraVtcFreeMemory(hComponent);
+            return eError;
+        }
+    }
+    pCamPrv->nVtcSliceHeight = pVtcConfig->nSliceHeight;
+    return eError;
+}
+
 /* ===========================================================================*/
 /**
  * @name _OMX_CameraVtcAllocateMemory
@@ -156,15 +382,14 @@ static OMX_ERRORTYPE _OMX_CameraVtcAllocateMemory(OMX_IN OMX_HANDLETYPE hCompone
     OMX_PROXY_CAM_PRIVATE* pCamPrv;
     OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
     OMX_U32 i = 0;
-    OMX_CONFIG_RECTTYPE tFrameDim;
-    OMX_U32 nFrmWidth, nFrmHeight;
+    OMX_U32 nFrmWidth = 0, nFrmHeight = 0;
     OMX_TI_PARAM_VTCSLICE tVtcConfig;
     RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+    OMX_BOOL bVtcNeeded = OMX_FALSE;
 
     pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
     pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
 
-    _PROXY_OMX_INIT_PARAM(&tFrameDim, OMX_CONFIG_RECTTYPE);
     _PROXY_OMX_INIT_PARAM(&tVtcConfig, OMX_TI_PARAM_VTCSLICE);
 
     /* Get the current state of the component */
@@ -184,17 +409,8 @@ static OMX_ERRORTYPE _OMX_CameraVtcAllocateMemory(OMX_IN OMX_HANDLETYPE hCompone
                     OMX_PARAM_VIDEONOISEFILTERTYPE tVnfParam;
                     OMX_TI_PARAM_VTCSLICE *pVtcConfig = &tVtcConfig;
 
-                    tFrameDim.nPortIndex = PREVIEW_PORT; //Preview Port
-                    if(OMX_GetParameter(hComponent, OMX_TI_IndexParam2DBufferAllocDimension, &tFrameDim) == OMX_ErrorNone){
-                        DOMX_DEBUG("Acquired OMX_TI_IndexParam2DBufferAllocDimension data. nWidth = %d, nHeight = %d.\n\n", tFrameDim.nWidth, tFrameDim.nHeight);
-                        nFrmWidth = tFrameDim.nWidth;
-                        nFrmHeight = tFrameDim.nHeight;
-                    }else {
-                        DOMX_DEBUG("%s: No OMX_TI_IndexParam2DBufferAllocDimension data.\n\n", __func__);
-                        nFrmWidth = MAX_VTC_WIDTH_WITH_VNF;
-                        nFrmHeight = MAX_VTC_HEIGHT_WITH_VNF;
-                    }
-
+                    /* VSTAB and VNF decide whether buffers are needed at all,
+                       so they are asked for before the frame dimensions */
                     _PROXY_OMX_INIT_PARAM(&tVnfParam, OMX_PARAM_VIDEONOISEFILTERTYPE);
                     _PROXY_OMX_INIT_PARAM(&tVstabParam, OMX_CONFIG_BOOLEANTYPE);
                     eError = OMX_GetParameter(hComponent, OMX_IndexParamFrameStabilisation, &tVstabParam);
@@ -202,46 +418,245 @@ static OMX_ERRORTYPE _OMX_CameraVtcAllocateMemory(OMX_IN OMX_HANDLETYPE hCompone
                         DOMX_ERROR("OMX_GetParameter for OMX_IndexParamFrameStabilisation returned error %x", eError);
                         goto EXIT;
                     }
+                    if (tVstabParam.bEnabled != OMX_FALSE) {
+                        DOMX_DEBUG("%s: VSTAB on, no VTC buffers", __func__);
+                        goto EXIT;
+                    }
                     tVnfParam.nPortIndex = PREVIEW_PORT;
                     eError = OMX_GetParameter(hComponent, OMX_IndexParamVideoNoiseFilter, &tVnfParam);
                     if(eError != OMX_ErrorNone) {
                         DOMX_ERROR("OMX_GetParameter for OMX_IndexParamVideoNoiseFilter returned error %x", eError);
                         goto EXIT;
                     }
-                    DOMX_DEBUG(" Acquired OMX_TI_IndexParamVtcSlice data. nSliceHeight = %d, bVstabOn = %d, Vnfmode = %d, nWidth = %d, nHeight = %d.\n\n", tVtcConfig.nSliceHeight, tVstabParam.bEnabled, tVnfParam.eMode, nFrmWidth, nFrmHeight);
-                    if (tVstabParam.bEnabled == OMX_FALSE && tVnfParam.eMode != OMX_VideoNoiseFilterModeOff) {
-                        eError = GLUE_CameraVtcAllocateMemory(hComponent,
-                                                              pVtcConfig,
-                                                              nFrmWidth,
-                                                              nFrmHeight);
-                        if(eError != OMX_ErrorNone) {
-                           DOMX_ERROR("Allocate Memory for vtc config returned error %x", eError);
-                           goto EXIT;
+                    if (tVnfParam.eMode == OMX_VideoNoiseFilterModeOff) {
+                        DOMX_DEBUG("%s: VNF off, no VTC buffers", __func__);
+                        goto EXIT;
+                    }
+
+                    bVtcNeeded = OMX_TRUE;
+
+                    /* Buffers kept from the last session, e.g. preview before
+                       a switch to video, do if the new frame fits in them */
+                    if (pCamPrv->sInternalBuffers[0][0].pBufferHandle != NULL) {
+                        _OMX_CameraVtcFrameDim(hComponent, &nFrmWidth, &nFrmHeight);
+                        if (nFrmWidth <= pCamPrv->nVtcWidth && nFrmHeight <= pCamPrv->nVtcHeight) {
+                            eError = _OMX_CameraVtcReuseMemory(hComponent, pVtcConfig);
+                            goto EXIT;
                         }
-                   }
+                        OMX_CameraVtcFreeMemory(hComponent);
+                    }
+
+                    /* The pool is sized for the largest VNF frame, the frame
+                       dimensions are only needed without it */
+                    if (_OMX_CameraVtcPoolAcquire(hComponent, pVtcConfig) == OMX_ErrorNone) {
+                        goto EXIT;
+                    }
+
+                    if (nFrmWidth == 0) {
+                        _OMX_CameraVtcFrameDim(hComponent, &nFrmWidth, &nFrmHeight);
+                    }
+
+                    DOMX_DEBUG(" Acquired OMX_TI_IndexParamVtcSlice data. nSliceHeight = %d, bVstabOn = %d, Vnfmode = %d, nWidth = %d, nHeight = %d.\n\n", tVtcConfig.nSliceHeight, tVstabParam.bEnabled, tVnfParam.eMode, nFrmWidth, nFrmHeight);
+                    eError = GLUE_CameraVtcAllocateMemory(hComponent,
+                                                          pVtcConfig,
+                                                          nFrmWidth,
+                                                          nFrmHeight);
+                    if(eError != OMX_ErrorNone) {
+                       DOMX_ERROR("Allocate Memory for vtc config returned error %x", eError);
+                       goto EXIT;
+                    }
                 }
             }
         }
     }
 EXIT:
+    /* Kept buffers the new configuration has no use for are given up */
+    if (!bVtcNeeded && tState == OMX_StateLoaded &&
+        pCamPrv->sInternalBuffers[0][0].pBufferHandle != NULL) {
+        OMX_CameraVtcFreeMemory(hComponent);
+    }
 
    DOMX_EXIT("eError: %d", eError);
    return eError;
 }
 
+/* ===========================================================================*/
+/**
+ * @name Cam_OpenLibMemPlugin
+ * @brief Opens the MemPlugin client of the library on first use
+ *
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE Cam_OpenLibMemPlugin(void)
+{
+    if (pCamMemPluginHandle != NULL) {
+        return OMX_ErrorNone;
+    }
+    if (MemPlugin_Init("MEMPLUGIN_ION", &pCamMemPluginHandle) != MEMPLUGIN_ERROR_NONE) {
+        pCamMemPluginHandle = NULL;
+        return OMX_ErrorUndefined;
+    }
+    if (MemPlugin_Open(pCamMemPluginHandle, &nCamClientDesc) != MEMPLUGIN_ERROR_NONE) {
+        MemPlugin_DeInit(pCamMemPluginHandle);
+        pCamMemPluginHandle = NULL;
+        return OMX_ErrorInsufficientResources;
+    }
+    return OMX_ErrorNone;
+}
+
+/* ===========================================================================*/
+/**
+ * @name _OMX_CameraVtcPoolFree
+ * @brief Frees the VTC pool buffers. Only called once no instance owns them.
+ */
+/* ===========================================================================*/
+static void _OMX_CameraVtcPoolFree(void)
+{
+    MEMPLUGIN_BUFFER_PARAMS delBuffer_params;
+    MEMPLUGIN_BUFFER_PROPERTIES delBuffer_prop;
+    OMX_U32 i;
+
+    MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
+    for (i = 0; i < MAX_NUM_INTERNAL_BUFFERS * 2; i++) {
+        MEMPLUGIN_BUFFER_ACCESSOR *pBuf = &sVtcPool.sBuffers[i / 2][i % 2];
+        if (pBuf->pBufferHandle != NULL) {
+            if (pBuf->bufferFd >= 0) {
+                close(pBuf->bufferFd);
+            }
+            delBuffer_prop.sBuffer_accessor.pBufferHandle = pBuf->pBufferHandle;
+            MemPlugin_Free(pCamMemPluginHandle, nCamClientDesc, &delBuffer_params, &delBuffer_prop);
+            pBuf->pBufferHandle = NULL;
+            pBuf->bufferFd = -1;
+        }
+    }
+    sVtcPool.bAllocated = OMX_FALSE;
+}
+
+/* ===========================================================================*/
+/**
+ * @name _OMX_CameraVtcPoolAcquire
+ * @brief Hands the VTC pool to hComponent: the buffers are allocated the
+ *        first time, then registered with this instance and passed to it
+ *        through OMX_TI_IndexParamVtcSlice like GLUE_CameraVtcAllocateMemory
+ *        does. Fails if the pool is disabled or used by another instance.
+ *
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE _OMX_CameraVtcPoolAcquire(OMX_HANDLETYPE hComponent,
+    OMX_TI_PARAM_VTCSLICE * pVtcConfig)
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    PROXY_COMPONENT_PRIVATE *pCompPrv;
+    OMX_PROXY_CAM_PRIVATE* pCamPrv;
+    OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+    MEMPLUGIN_BUFFER_PARAMS newBuffer_params;
+    MEMPLUGIN_BUFFER_PROPERTIES newBuffer_prop;
+    MEMPLUGIN_ION_PARAMS sIonParams;
+    MEMPLUGIN_OBJECT *pMemPluginHdl;
+    RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
+    OMX_U32 i, j;
+
+    pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+    pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
+
+    if (!sVtcPool.bEnabled) {
+        return OMX_ErrorNotImplemented;
+    }
+
+    TIMM_OSAL_MutexObtain(cam_mutex, TIMM_OSAL_SUSPEND);
+    if (sVtcPool.hOwner != NULL) {
+        TIMM_OSAL_MutexRelease(cam_mutex);
+        return OMX_ErrorInsufficientResources;
+    }
+
+    if (!sVtcPool.bAllocated) {
+        eError = Cam_OpenLibMemPlugin();
+        PROXY_assert(eError == OMX_ErrorNone, eError, "No MemPlugin for VTC pool");
+        pMemPluginHdl = (MEMPLUGIN_OBJECT *) pCamMemPluginHandle;
+        MEMPLUGIN_ION_PARAMS_INIT(&sIonParams);
+        //override alloc_flags for tiler 1d non secure
+        sIonParams.alloc_flags = OMAP_ION_HEAP_TILER_MASK;
+        pMemPluginHdl->pPluginExtendedInfo = &sIonParams;
+        for (i = 0; i < MAX_NUM_INTERNAL_BUFFERS * 2; i++) {
+            sVtcPool.sBuffers[i / 2][i % 2].bufferFd = -1;
+        }
+        for (i = 0; i < MAX_NUM_INTERNAL_BUFFERS && eError == OMX_ErrorNone; i++) {
+            for (j = 0; j < 2; j++) {
+                /* Y plane 8 bit full size, UV plane 16 bit half size */
+                MEMPLUGIN_BUFFER_PARAMS_INIT(newBuffer_params);
+                newBuffer_params.nWidth = MAX_VTC_WIDTH_WITH_VNF >> j;
+                newBuffer_params.nHeight = MAX_VTC_HEIGHT_WITH_VNF >> j;
+                newBuffer_params.eBuffer_type = TILER1D;
+                newBuffer_params.eTiler_format = j ? MEMPLUGIN_TILER_FORMAT_16BIT :
+                                                     MEMPLUGIN_TILER_FORMAT_8BIT;
+                if (MemPlugin_Alloc(pCamMemPluginHandle, nCamClientDesc, &newBuffer_params,
+                                    &newBuffer_prop) != MEMPLUGIN_ERROR_NONE) {
+                    DOMX_ERROR("%s: VTC pool allocation failed", __func__);
+                    eError = OMX_ErrorInsufficientResources;
+                    break;
+                }
+                sVtcPool.sBuffers[i][j].pBufferHandle = newBuffer_prop.sBuffer_accessor.pBufferHandle;
+                sVtcPool.sBuffers[i][j].bufferFd = newBuffer_prop.sBuffer_accessor.bufferFd;
+            }
+        }
+        pMemPluginHdl->pPluginExtendedInfo = NULL;
+        if (eError != OMX_ErrorNone) {
+            _OMX_CameraVtcPoolFree();
+            goto EXIT;
+        }
+        sVtcPool.bAllocated = OMX_TRUE;
+    }
+
+    sVtcPool.hOwner = hComponent;
+    pCamPrv->bVtcPooled = OMX_TRUE;
+    for (i = 0; i < MAX_NUM_INTERNAL_BUFFERS; i++) {
+        pVtcConfig->nInternalBuffers = i;
+        for (j = 0; j < 2; j++) {
+            eRPCError = RPC_RegisterBuffer(pCompPrv->hRemoteComp, sVtcPool.sBuffers[i][j].bufferFd, -1,
+                                           &pCamPrv->sInternalBuffers[i][j].pRegBufferHandle, NULL, IONPointers);
+            if (eRPCError != RPC_OMX_ErrorNone) {
+                DOMX_ERROR("%s: Registering VTC pool buffer failed 0x%x", __func__, eRPCError);
+                eError = OMX_ErrorHardware;
+                break;
+            }
+            pCamPrv->sInternalBuffers[i][j].pBufferHandle = sVtcPool.sBuffers[i][j].pBufferHandle;
+            pVtcConfig->IonBufhdl[j] = (OMX_PTR)pCamPrv->sInternalBuffers[i][j].pRegBufferHandle;
+        }
+        if (eError == OMX_ErrorNone) {
+            eError = __PROXY_SetParameter(hComponent,
+                                          OMX_TI_IndexParamVtcSlice,
+                                          pVtcConfig,
+                                          pVtcConfig->IonBufhdl, 2);
+        }
+        if (eError != OMX_ErrorNone) {
+            DOMX_ERROR("DOMX: VTC pool hand over completed with error 0x%x\n", eError);
+            break;
+        }
+    }
+    TIMM_OSAL_MutexRelease(cam_mutex);
+
+    /* unregisters what was registered and gives the pool back */
+    if (eError != OMX_ErrorNone) {
+        OMX_CameraVtcFreeMemory(hComponent);
+    }
+    return eError;
+
+EXIT:
+    TIMM_OSAL_MutexRelease(cam_mutex);
+    return eError;
+}
+
 static OMX_ERRORTYPE ComponentPrivateDeInit(OMX_IN OMX_HANDLETYPE hComponent)
 {
 	OMX_ERRORTYPE eError = OMX_ErrorNone, eCompReturn = OMX_ErrorNone;
 	TIMM_OSAL_ERRORTYPE eOsalError = TIMM_OSAL_ERR_NONE;
 	PROXY_COMPONENT_PRIVATE *pCompPrv;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
-	OMX_U32 i, j;
     OMX_PROXY_CAM_PRIVATE* pCamPrv;
-    MEMPLUGIN_BUFFER_PARAMS delBuffer_params;
-    MEMPLUGIN_BUFFER_PROPERTIES delBuffer_prop;
     RPC_OMX_ERRORTYPE eRPCError = RPC_OMX_ErrorNone;
 
-        MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
         if (dcc_flag)
         {
@@ -258,19 +673,12 @@ static OMX_ERRORTYPE ComponentPrivateDeInit(OMX_IN OMX_HANDLETYPE hComponent)
                 OMX_ErrorInsufficientResources, "Mutex release failed");
         }
         OMX_CameraVtcFreeMemory(hComponent);
+        CameraSharedBuffRelease(pCompPrv);
 
 
     if(pCompPrv->pCompProxyPrv != NULL) {
         pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
-        for (i = 0; i < PROXY_MAXNUMOFPORTS; i++) {
-            for (j = 0; j < MAX_NUM_INTERNAL_BUFFERS; j++) {
-                if (pCamPrv->gComponentBufferAllocation[i][j]) {
-                    delBuffer_prop.sBuffer_accessor.pBufferHandle = pCamPrv->gComponentBufferAllocation[i][j];
-                    MemPlugin_Free(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc,&delBuffer_params,&delBuffer_prop);
-                }
-                pCamPrv->gComponentBufferAllocation[i][j] = NULL;
-            }
-        }
+        GLUE_CameraFreeComponentBuffers(hComponent);
 
         TIMM_OSAL_Free(pCompPrv->pCompProxyPrv);
         pCompPrv->pCompProxyPrv = NULL;
@@ -294,13 +702,10 @@ static OMX_ERRORTYPE Camera_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
     OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
     PROXY_COMPONENT_PRIVATE *pCompPrv;
     OMX_PROXY_CAM_PRIVATE   *pCamPrv;
-    MEMPLUGIN_BUFFER_PARAMS delBuffer_params;
-    MEMPLUGIN_BUFFER_PROPERTIES delBuffer_prop;
     pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 
     pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
 
-    MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
     if ((eCmd == OMX_CommandStateSet) &&
         (nParam == (OMX_STATETYPE) OMX_StateIdle))
     {
@@ -310,7 +715,7 @@ static OMX_ERRORTYPE Camera_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
             DOMX_ERROR("DOMX: _OMX_CameraVtcAllocateMemory completed with error 0x%x\n", eError);
             goto EXIT;
         }
-        if (!dcc_loaded)
+        if (bDccResident ? !pCamPrv->bDccSent : !dcc_loaded)
         {
             dcc_eError = DCC_Init(hComponent);
             if (dcc_eError != OMX_ErrorNone)
@@ -326,30 +731,22 @@ static OMX_ERRORTYPE Camera_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
                 {
                     DOMX_ERROR(" Error in Sending DCC Buf ptr");
                 }
-                DCC_DeInit(hComponent);
+                if (!bDccResident)
+                    DCC_DeInit(hComponent);
             }
             dcc_loaded = OMX_TRUE;
+            pCamPrv->bDccSent = OMX_TRUE;
         }
     } else if (eCmd == OMX_CommandPortDisable) {
-        int i, j;
-        for (i = 0; i < PROXY_MAXNUMOFPORTS; i++) {
-            if ((i == nParam) || (nParam == OMX_ALL)) {
-                for (j = 0; j < MAX_NUM_INTERNAL_BUFFERS; j++) {
-                     if (pCamPrv->gComponentBufferAllocation[i][j]) {
-                     delBuffer_prop.sBuffer_accessor.pBufferHandle = pCamPrv->gComponentBufferAllocation[i][j];
-                        MemPlugin_Free(pCompPrv->pMemPluginHandle, pCompPrv->nMemmgrClientDesc,
-                                       &delBuffer_params,&delBuffer_prop);
-                        pCamPrv->gComponentBufferAllocation[i][j] = NULL;
-                    }
-                }
-            }
-        }
+        /* keep the buffers around for when the port comes back */
+        GLUE_CameraReleaseComponentBuffers(hComponent, nParam);
     }
 
     if ((eCmd == OMX_CommandStateSet) &&
-	(nParam == (OMX_STATETYPE) OMX_StateLoaded))
+	(nParam == (OMX_STATETYPE) OMX_StateLoaded) && pCamPrv->bVtcPooled)
     {
-        /* Clean up resources for Video VTC usecase. */
+        /* Give the VTC pool back for the other instances. Own VTC buffers
+           stay until the next Idle, see _OMX_CameraVtcAllocateMemory */
         OMX_CameraVtcFreeMemory(hComponent);
     }
 
@@ -362,6 +759,132 @@ EXIT:
    return eError;
 }
 
+/* Extradata behind OMX_TI_IndexConfigCamFrameMetadata */
+static const OMX_EXT_EXTRADATATYPE aFrameMetadataTypes[] = {
+	OMX_AncillaryData, OMX_WhiteBalance, OMX_FaceDetection
+};
+
+#define CAM_FRAME_METADATA_COPY(dst, pExtra, nData) \
+	TIMM_OSAL_Memcpy((dst), (pExtra)->data, \
+	    (nData) < sizeof(*(dst)) ? (nData) : sizeof(*(dst)))
+
+/* ===========================================================================*/
+/**
+ * @name CameraFrameMetadataEnable()
+ * @brief Turns the extradata of OMX_TI_CONFIG_CAMFRAMEMETADATA on or off for
+ *        a port. Types the sensor does not produce are refused by the
+ *        component and left out, it only fails if none was accepted. The
+ *        metadata buffers are set up in UseBuffer, so this has to come before
+ *        the buffers of the port are given to the component.
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE CameraFrameMetadataEnable(OMX_HANDLETYPE hComponent,
+    OMX_TI_CONFIG_CAMFRAMEMETADATA *pMetadata)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_CONFIG_EXTRADATATYPE tExtraData;
+	OMX_U32 i, nAccepted = 0;
+
+	for (i = 0; i < sizeof(aFrameMetadataTypes) /
+	    sizeof(aFrameMetadataTypes[0]); i++)
+	{
+		_PROXY_OMX_INIT_PARAM(&tExtraData, OMX_CONFIG_EXTRADATATYPE);
+		tExtraData.nPortIndex = pMetadata->nPortIndex;
+		tExtraData.eExtraDataType = aFrameMetadataTypes[i];
+		tExtraData.bEnable = pMetadata->bEnable;
+		eError = __PROXY_SetConfig(hComponent,
+		    (OMX_INDEXTYPE) OMX_IndexConfigOtherExtraDataControl,
+		    &tExtraData, NULL);
+		if (eError == OMX_ErrorNone)
+			nAccepted++;
+		else
+			DOMX_DEBUG("Extradata 0x%x refused on port %d: 0x%x",
+			    aFrameMetadataTypes[i], pMetadata->nPortIndex, eError);
+	}
+
+	return nAccepted > 0 ? OMX_ErrorNone : eError;
+}
+
+/* ===========================================================================*/
+/**
+ * @name CameraFrameMetadataGet()
+ * @brief Parses the extradata of a buffer returned by FillBufferDone. The
+ *        records are read from the mapped metadata buffer of the buffer, so
+ *        this costs no call to the component and always describes that
+ *        frame. The component writes the metadata buffer again once the
+ *        buffer is back with it, the buffer has to be with the client.
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE CameraFrameMetadataGet(PROXY_COMPONENT_PRIVATE *pCompPrv,
+    OMX_TI_CONFIG_CAMFRAMEMETADATA *pMetadata)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_BUFFERHEADERTYPE *pBufHdr =
+	    (OMX_BUFFERHEADERTYPE *) pMetadata->pBufferHeader;
+	OMX_TI_PLATFORMPRIVATE *pPlatformPrivate = NULL;
+	OMX_OTHER_EXTRADATATYPE *pExtra = NULL;
+	OMX_U8 *pData = NULL, *pEnd = NULL;
+	OMX_U32 nIndex, nData;
+
+	PROXY_require(pBufHdr != NULL, OMX_ErrorBadParameter,
+	    "Frame metadata needs a buffer header");
+	nIndex = PROXY_FindBufferByLocal(pCompPrv, pBufHdr);
+	PROXY_require(nIndex < pCompPrv->nTotalBuffers, OMX_ErrorBadParameter,
+	    "Frame metadata of an unknown buffer");
+	PROXY_require(PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).eOwner ==
+	    PROXY_BUFFER_OWNER_CLIENT, OMX_ErrorIncorrectStateOperation,
+	    "Frame metadata of a buffer that is not with the client");
+
+	pMetadata->nPortIndex = PROXY_BUFLIST_ENTRY(pCompPrv, nIndex).nPortIndex;
+	pMetadata->nTimeStamp = pBufHdr->nTimeStamp;
+	pMetadata->bAncillaryValid = OMX_FALSE;
+	pMetadata->bWhiteBalanceValid = OMX_FALSE;
+	pMetadata->bFacesValid = OMX_FALSE;
+
+	pPlatformPrivate = (OMX_TI_PLATFORMPRIVATE *) pBufHdr->pPlatformPrivate;
+	if (pPlatformPrivate == NULL || pPlatformPrivate->pMetaDataBuffer == NULL)
+		goto EXIT;
+
+	pData = (OMX_U8 *) pPlatformPrivate->pMetaDataBuffer;
+	pEnd = pData + pPlatformPrivate->nMetaDataSize;
+	while (pData + OMX_OTHER_EXTRADATATYPE_SIZE <= pEnd)
+	{
+		pExtra = (OMX_OTHER_EXTRADATATYPE *) pData;
+		if (pExtra->eType == OMX_ExtraDataNone ||
+		    pExtra->nSize < OMX_OTHER_EXTRADATATYPE_SIZE ||
+		    pExtra->nSize > (OMX_U32) (pEnd - pData))
+			break;
+
+		nData = pExtra->nSize - OMX_OTHER_EXTRADATATYPE_SIZE;
+		if (pExtra->nDataSize < nData)
+			nData = pExtra->nDataSize;
+
+		switch ((OMX_EXT_EXTRADATATYPE) pExtra->eType)
+		{
+		case OMX_AncillaryData:
+			CAM_FRAME_METADATA_COPY(&pMetadata->tAncillary, pExtra,
+			    nData);
+			pMetadata->bAncillaryValid = OMX_TRUE;
+			break;
+		case OMX_WhiteBalance:
+			CAM_FRAME_METADATA_COPY(&pMetadata->tWhiteBalance, pExtra,
+			    nData);
+			pMetadata->bWhiteBalanceValid = OMX_TRUE;
+			break;
+		case OMX_FaceDetection:
+			CAM_FRAME_METADATA_COPY(&pMetadata->tFaces, pExtra, nData);
+			pMetadata->bFacesValid = OMX_TRUE;
+			break;
+		default:
+			break;
+		}
+		pData += pExtra->nSize;
+	}
+
+      EXIT:
+	return eError;
+}
+
 /* ===========================================================================*/
 /**
  * @name CameraGetConfig()
@@ -379,10 +902,21 @@ static OMX_ERRORTYPE CameraGetConfig(OMX_IN OMX_HANDLETYPE
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	OMX_TI_CONFIG_SHAREDBUFFER *pConfigSharedBuffer = NULL;
 	OMX_PTR pTempSharedBuff = NULL;
+	OMX_PTR pRegistered = NULL;
 	OMX_U32 status = 0;
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 
 	switch (nParamIndex)
 	{
+	case OMX_TI_IndexConfigCamFrameMetadata:
+		PROXY_require(pComponentParameterStructure != NULL,
+		    OMX_ErrorBadParameter, NULL);
+		eError = CameraFrameMetadataGet(
+		    (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate,
+		    (OMX_TI_CONFIG_CAMFRAMEMETADATA *)
+		    pComponentParameterStructure);
+		goto EXIT;
+		break;
 	case OMX_TI_IndexConfigAAAskipBuffer:
 	case OMX_TI_IndexConfigCamCapabilities:
 	case OMX_TI_IndexConfigExifTags:
@@ -394,21 +928,27 @@ static OMX_ERRORTYPE CameraGetConfig(OMX_IN OMX_HANDLETYPE
 
 		pTempSharedBuff = pConfigSharedBuffer->pSharedBuff;
 
-		// TODO(XXX): Cache API is not yet available. Client needs to
-		// allocate tiler buffer directly and assign to pSharedBuff.
-		// Ptr allocated by MemMgr_Alloc in uncacheable so there
-		// would be no need to cache API
+		// The client allocates pSharedBuff from uncached ION memory,
+		// so no cache maintenance is needed around the remote access.
+		// The buffer stays registered for the index, the remote core
+		// gets the same handle on every query instead of a raw fd it
+		// has to map again.
+		pRegistered = CameraSharedBuffRegister(
+		    (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate,
+		    nParamIndex, (OMX_S32) pTempSharedBuff);
+		if (pRegistered != NULL)
+			pConfigSharedBuffer->pSharedBuff = pRegistered;
 
 		eError = __PROXY_GetConfig(hComponent,
 								nParamIndex,
 								pConfigSharedBuffer,
 								&(pConfigSharedBuffer->pSharedBuff));
 
+		pConfigSharedBuffer->pSharedBuff = pTempSharedBuff;
+
 		PROXY_assert((eError == OMX_ErrorNone), eError,
 		    "Error in GetConfig");
 
-		pConfigSharedBuffer->pSharedBuff = pTempSharedBuff;
-
 		goto EXIT;
 		break;
 	default:
@@ -446,6 +986,14 @@ static OMX_ERRORTYPE CameraSetConfig(OMX_IN OMX_HANDLETYPE
 
 	switch (nParamIndex)
 	{
+	case OMX_TI_IndexConfigCamFrameMetadata:
+		PROXY_require(pComponentParameterStructure != NULL,
+		    OMX_ErrorBadParameter, NULL);
+		eError = CameraFrameMetadataEnable(hComponent,
+		    (OMX_TI_CONFIG_CAMFRAMEMETADATA *)
+		    pComponentParameterStructure);
+		goto EXIT;
+		break;
 	case OMX_TI_IndexConfigAAAskipBuffer:
 	case OMX_TI_IndexConfigCamCapabilities:
 	case OMX_TI_IndexConfigExifTags:
@@ -525,13 +1073,13 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	OMX_ERRORTYPE dcc_eError = OMX_ErrorNone;
 	OMX_COMPONENTTYPE *pHandle = NULL;
 	PROXY_COMPONENT_PRIVATE *pComponentPrivate;
-    OMX_U32 i = 0, j = 0;
     OMX_PROXY_CAM_PRIVATE* pCamPrv;
 	MEMPLUGIN_ERRORTYPE eMemError = MEMPLUGIN_ERROR_NONE;
 	pHandle = (OMX_COMPONENTTYPE *) hComponent;
 	TIMM_OSAL_ERRORTYPE eOsalError = TIMM_OSAL_ERR_NONE;
 	DOMX_ENTER("_____________________INSIDE CAMERA PROXY"
 	    "WRAPPER__________________________\n");
+	pthread_once(&sCamSetupOnce, Cam_Setup);
 	pHandle->pComponentPrivate = (PROXY_COMPONENT_PRIVATE *)
 	    TIMM_OSAL_Malloc(sizeof(PROXY_COMPONENT_PRIVATE),
 	    TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT);
@@ -580,12 +1128,6 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 		goto EXIT;
 	}
 
-        for (i = 0; i < PROXY_MAXNUMOFPORTS; i++) {
-            for (j = 0; j < MAX_NUM_INTERNAL_BUFFERS; j++) {
-                pCamPrv->gComponentBufferAllocation[i][j] = NULL;
-            }
-        }
-
 	pHandle->ComponentDeInit = ComponentPrivateDeInit;
 	pHandle->GetConfig = CameraGetConfig;
 	pHandle->SetConfig = CameraSetConfig;
@@ -620,6 +1162,10 @@ OMX_ERRORTYPE DCC_Init(OMX_HANDLETYPE hComponent)
        OMX_S32 status = 0;
        OMX_STRING dcc_dir[200];
        OMX_U16 i;
+       DCC_PACK_ENTRY *pEntries = NULL;
+       OMX_S32 nFiles = -1, nDataSize = 0;
+       OMX_PTR pMemPluginHandle = NULL;
+       OMX_U32 nClientDesc = 0;
        _PROXY_OMX_INIT_PARAM(&param, OMX_TI_PARAM_DCCURIINFO);
 
        DOMX_ENTER("ENTER");
@@ -664,13 +1210,51 @@ OMX_ERRORTYPE DCC_Init(OMX_HANDLETYPE hComponent)
                eError = OMX_ErrorNone;
        }
 
-       dccbuf_size = read_DCCdir(NULL, dcc_dir, nIndex);
+       /* Only stat the profiles here, their contents come from the pack
+          when it is still up to date */
+       pEntries = TIMM_OSAL_Malloc(sizeof(DCC_PACK_ENTRY) * DCC_PACK_MAX_FILES,
+               TIMM_OSAL_TRUE, 0, TIMMOSAL_MEM_SEGMENT_INT);
+       if (pEntries != NULL)
+               nFiles = DCC_ListFiles(dcc_dir, nIndex, pEntries,
+                       DCC_PACK_MAX_FILES);
+       if (nFiles >= 0)
+       {
+               for (i = 0; i < nFiles; i++)
+                       nDataSize += pEntries[i].nSize;
+               dccbuf_size = nDataSize;
+       } else
+       {
+               dccbuf_size = read_DCCdir(NULL, dcc_dir, nIndex);
+       }
 
     if(dccbuf_size <= 0)
     {
            DOMX_DEBUG("No DCC files found, switching back to default DCC");
-        return OMX_ErrorInsufficientResources;
+        eError = OMX_ErrorInsufficientResources;
+        goto EXIT;
     }
+       pComponentPrivate->bMapBuffers = OMX_TRUE;
+       if (bDccResident)
+       {
+               /* The resident buffer is still good if the profiles are the
+                  ones it was filled from */
+               if (sDccBuffer.pBufferHandle && nFiles >= 0 &&
+                   nFiles == nDccFiles &&
+                   !memcmp(pEntries, pDccEntries, nFiles * sizeof(DCC_PACK_ENTRY)))
+               {
+                       DOMX_DEBUG("Reusing resident DCC buffer");
+                       dccbuf_size = nDataSize;
+                       goto EXIT;
+               }
+               DCC_FreeBuffer(pCamMemPluginHandle, nCamClientDesc);
+               nDccFiles = -1;
+               eError = Cam_OpenLibMemPlugin();
+               PROXY_assert(eError == OMX_ErrorNone, eError,
+                       "Mem manager client creation failed!!!");
+               pMemPluginHandle = pCamMemPluginHandle;
+               nClientDesc = nCamClientDesc;
+               goto ALLOC;
+       }
     if(pComponentPrivate->pMemPluginHandle == NULL)
     {
                 eMemError = MemPlugin_Init("MEMPLUGIN_ION",&(pComponentPrivate->pMemPluginHandle));
@@ -681,7 +1265,6 @@ OMX_ERRORTYPE DCC_Init(OMX_HANDLETYPE hComponent)
                      goto EXIT;
                 }
      }
-       pComponentPrivate->bMapBuffers = OMX_TRUE;
 
        eMemError = MemPlugin_Open(pComponentPrivate->pMemPluginHandle,&(pComponentPrivate->nMemmgrClientDesc));
        if(eMemError != MEMPLUGIN_ERROR_NONE)
@@ -690,23 +1273,47 @@ OMX_ERRORTYPE DCC_Init(OMX_HANDLETYPE hComponent)
                eError = OMX_ErrorInsufficientResources;
                goto EXIT;
        }
+       pMemPluginHandle = pComponentPrivate->pMemPluginHandle;
+       nClientDesc = pComponentPrivate->nMemmgrClientDesc;
+ALLOC:
        dccbuf_size = (dccbuf_size + LINUX_PAGE_SIZE -1) & ~(LINUX_PAGE_SIZE - 1);
        MEMPLUGIN_BUFFER_PARAMS_INIT(sDccBuff_params);
        sDccBuff_params.nWidth = dccbuf_size;
        sDccBuff_params.bMap = pComponentPrivate->bMapBuffers;
-       eMemError = MemPlugin_Alloc(pComponentPrivate->pMemPluginHandle,pComponentPrivate->nMemmgrClientDesc,&sDccBuff_params,&sDccBuff_prop);
+       eMemError = MemPlugin_Alloc(pMemPluginHandle,nClientDesc,&sDccBuff_params,&sDccBuff_prop);
+       PROXY_assert(eMemError == MEMPLUGIN_ERROR_NONE,
+               OMX_ErrorInsufficientResources, "DCC buffer allocation failed");
        sDccBuffer.pBufferHandle = sDccBuff_prop.sBuffer_accessor.pBufferHandle;
        sDccBuffer.pBufferMappedAddress = sDccBuff_prop.sBuffer_accessor.pBufferMappedAddress;
        sDccBuffer.bufferFd = sDccBuff_prop.sBuffer_accessor.bufferFd;
        ptempbuf = sDccBuffer.pBufferMappedAddress;
-       dccbuf_size = read_DCCdir(ptempbuf, dcc_dir, nIndex);
-       PROXY_assert(dccbuf_size > 0, OMX_ErrorInsufficientResources,
-               "ERROR in copy DCC files into buffer");
+       if (nFiles >= 0 && DCC_ReadPack(ptempbuf, pEntries, nFiles, nDataSize))
+       {
+               dccbuf_size = nDataSize;
+       } else
+       {
+               dccbuf_size = read_DCCdir(ptempbuf, dcc_dir, nIndex);
+               PROXY_assert(dccbuf_size > 0, OMX_ErrorInsufficientResources,
+                       "ERROR in copy DCC files into buffer");
+               if (nFiles >= 0 && dccbuf_size == nDataSize)
+                       DCC_WritePack(ptempbuf, pEntries, nFiles, nDataSize);
+       }
+       if (bDccResident && nFiles >= 0)
+       {
+               /* remember what the resident buffer was filled from */
+               if (pDccEntries != NULL)
+                       TIMM_OSAL_Free(pDccEntries);
+               pDccEntries = pEntries;
+               nDccFiles = nFiles;
+               pEntries = NULL;
+       }
 EXIT:
        for (i = 0; i < nIndex - 1; i++)
        {
                        TIMM_OSAL_Free(dcc_dir[i]);
        }
+       if (pEntries != NULL)
+               TIMM_OSAL_Free(pEntries);
 
        return eError;
 
@@ -846,6 +1453,143 @@ OMX_S32 read_DCCdir(OMX_PTR buffer, OMX_STRING * dir_path, OMX_U16 numofURI)
        return ret;
 }
 
+/* ===========================================================================*/
+/**
+ * @name DCC_ListFiles()
+ * @brief : Lists the dcc profiles with their size and mtime, in the order
+ *          read_DCCdir() copies them.
+ * @return number of profiles, -1 if they do not fit the index or can't be
+ *         looked at
+ */
+/* ===========================================================================*/
+static OMX_S32 DCC_ListFiles(OMX_STRING * dir_path, OMX_U16 numofURI,
+    DCC_PACK_ENTRY * pEntries, OMX_U32 nMax)
+{
+       DIR *d;
+       struct dirent *dir;
+       struct stat sStat;
+       OMX_S32 nFiles = 0;
+       OMX_U16 i = 0;
+
+       for (i = 0; i < numofURI - 1; i++)
+       {
+               d = opendir(dir_path[i]);
+               if (d == NULL)
+                       continue;
+               while ((dir = readdir(d)) != NULL)
+               {
+                       if (dir->d_name[0] == '.')
+                               continue;
+                       if (nFiles == (OMX_S32) nMax ||
+                           strlen(dir_path[i]) + strlen(dir->d_name) >=
+                           DCC_PACK_PATH_MAX)
+                       {
+                               nFiles = -1;
+                               break;
+                       }
+                       strcpy(pEntries[nFiles].sPath, dir_path[i]);
+                       strcat(pEntries[nFiles].sPath, dir->d_name);
+                       if (stat(pEntries[nFiles].sPath, &sStat) != 0)
+                       {
+                               nFiles = -1;
+                               break;
+                       }
+                       pEntries[nFiles].nSize = (OMX_S32) sStat.st_size;
+                       pEntries[nFiles].nMtime = (OMX_S32) sStat.st_mtime;
+                       nFiles++;
+               }
+               closedir(d);
+               if (nFiles < 0)
+                       break;
+       }
+       return nFiles;
+}
+
+/* ===========================================================================*/
+/**
+ * @name DCC_ReadPack()
+ * @brief : Copies the profile data of DCC_PACK_FILE into buffer with a
+ *          single read, if its index matches pEntries.
+ * @return OMX_TRUE if buffer holds all dcc profiles
+ */
+/* ===========================================================================*/
+static OMX_BOOL DCC_ReadPack(OMX_PTR buffer, DCC_PACK_ENTRY * pEntries,
+    OMX_S32 nFiles, OMX_S32 nDataSize)
+{
+       DCC_PACK_HEADER sHeader;
+       DCC_PACK_ENTRY sEntry;
+       OMX_BOOL bOk = OMX_FALSE;
+       OMX_S32 i = 0;
+       int fd = open(DCC_PACK_FILE, O_RDONLY);
+
+       if (fd < 0)
+               return OMX_FALSE;
+
+       if (read(fd, &sHeader, sizeof(sHeader)) != sizeof(sHeader) ||
+           sHeader.nMagic != DCC_PACK_MAGIC ||
+           sHeader.nVersion != DCC_PACK_VERSION ||
+           sHeader.nFiles != (OMX_U32) nFiles ||
+           sHeader.nDataSize != (OMX_U32) nDataSize)
+               goto EXIT;
+
+       for (i = 0; i < nFiles; i++)
+       {
+               if (read(fd, &sEntry, sizeof(sEntry)) != sizeof(sEntry) ||
+                   strncmp(sEntry.sPath, pEntries[i].sPath, DCC_PACK_PATH_MAX) ||
+                   sEntry.nSize != pEntries[i].nSize ||
+                   sEntry.nMtime != pEntries[i].nMtime)
+                       goto EXIT;
+       }
+
+       if (read(fd, buffer, nDataSize) == nDataSize)
+       {
+               DOMX_DEBUG("DCC profiles loaded from %s", DCC_PACK_FILE);
+               bOk = OMX_TRUE;
+       }
+EXIT:
+       close(fd);
+       return bOk;
+}
+
+/* ===========================================================================*/
+/**
+ * @name DCC_WritePack()
+ * @brief : Writes DCC_PACK_FILE from the profiles just copied into buffer.
+ *          Failing to write it only costs the next camera open the slow path.
+ */
+/* ===========================================================================*/
+static void DCC_WritePack(OMX_PTR buffer, DCC_PACK_ENTRY * pEntries,
+    OMX_S32 nFiles, OMX_S32 nDataSize)
+{
+       DCC_PACK_HEADER sHeader;
+       OMX_S32 nIndexSize = nFiles * sizeof(DCC_PACK_ENTRY);
+       OMX_BOOL bOk = OMX_FALSE;
+       int fd = open(DCC_PACK_FILE ".tmp", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+       if (fd < 0)
+       {
+               DOMX_DEBUG("Can't create %s, errno %d", DCC_PACK_FILE, errno);
+               return;
+       }
+
+       sHeader.nMagic = DCC_PACK_MAGIC;
+       sHeader.nVersion = DCC_PACK_VERSION;
+       sHeader.nFiles = nFiles;
+       sHeader.nDataSize = nDataSize;
+       bOk = (write(fd, &sHeader, sizeof(sHeader)) == sizeof(sHeader) &&
+           write(fd, pEntries, nIndexSize) == nIndexSize &&
+           write(fd, buffer, nDataSize) == nDataSize) ? OMX_TRUE : OMX_FALSE;
+       if (close(fd) != 0)
+               bOk = OMX_FALSE;
+
+       /* the pack only replaces the old one once it is complete */
+       if (bOk == OMX_FALSE || rename(DCC_PACK_FILE ".tmp", DCC_PACK_FILE) != 0)
+       {
+               DOMX_ERROR("Can't write %s", DCC_PACK_FILE);
+               unlink(DCC_PACK_FILE ".tmp");
+       }
+}
+
 /* ===========================================================================*/
 /**
  * @name DCC_Deinit()
@@ -858,15 +1602,30 @@ OMX_S32 read_DCCdir(OMX_PTR buffer, OMX_STRING * dir_path, OMX_U16 numofURI)
 /* ===========================================================================*/
 void DCC_DeInit(OMX_HANDLETYPE hComponent)
 {
-       OMX_S16 status;
-       MEMPLUGIN_BUFFER_PARAMS sDccBuff_params;
-       MEMPLUGIN_BUFFER_PROPERTIES sDccBuff_prop;
        PROXY_COMPONENT_PRIVATE *pComponentPrivate;
        OMX_COMPONENTTYPE *pHandle = NULL;
 
        DOMX_ENTER("ENTER");
        pHandle = (OMX_COMPONENTTYPE *) hComponent;
        pComponentPrivate = (PROXY_COMPONENT_PRIVATE *)pHandle->pComponentPrivate;
+       DCC_FreeBuffer(pComponentPrivate->pMemPluginHandle,
+               pComponentPrivate->nMemmgrClientDesc);
+
+       DOMX_EXIT("EXIT");
+}
+
+/* ===========================================================================*/
+/**
+ * @name DCC_FreeBuffer()
+ * @brief : Frees the DCC buffer, if any, through the MemPlugin client it
+ *          was allocated from.
+ */
+/* ===========================================================================*/
+static void DCC_FreeBuffer(OMX_PTR pMemPluginHandle, OMX_U32 nClientDesc)
+{
+       MEMPLUGIN_BUFFER_PARAMS sDccBuff_params;
+       MEMPLUGIN_BUFFER_PROPERTIES sDccBuff_prop;
+
        if (sDccBuffer.pBufferHandle)
        {
                MEMPLUGIN_BUFFER_PARAMS_INIT(sDccBuff_params);
@@ -874,31 +1633,38 @@ void DCC_DeInit(OMX_HANDLETYPE hComponent)
                sDccBuff_prop.sBuffer_accessor.pBufferMappedAddress = sDccBuffer.pBufferMappedAddress;
                sDccBuff_prop.sBuffer_accessor.pRegBufferHandle = sDccBuffer.pRegBufferHandle;
                sDccBuff_params.nWidth = dccbuf_size;
-               MemPlugin_Free(pComponentPrivate->pMemPluginHandle,pComponentPrivate->nMemmgrClientDesc,&sDccBuff_params,&sDccBuff_prop);
+               MemPlugin_Free(pMemPluginHandle,nClientDesc,&sDccBuff_params,&sDccBuff_prop);
                sDccBuffer.pBufferHandle = NULL;
                sDccBuffer.bufferFd = -1;
                sDccBuffer.pBufferMappedAddress = NULL;
        }
-
-       DOMX_EXIT("EXIT");
 }
 
 
 
 /*===============================================================*/
-/** @fn Cam_Setup : This function is called when the the OMX Camera library is
- *                  loaded. It creates a mutex, which is used during DCC_Init()
+/** @fn Cam_Setup : This function is called when the first camera component
+ *                  is created, so processes that only load the library
+ *                  don't pay for it. It creates a mutex, which is used
+ *                  during DCC_Init()
  */
 /*===============================================================*/
-void __attribute__ ((constructor)) Cam_Setup(void)
+static void Cam_Setup(void)
 {
 	TIMM_OSAL_ERRORTYPE eError = TIMM_OSAL_ERR_NONE;
 
+	char value[PROPERTY_VALUE_MAX];
+
 	eError = TIMM_OSAL_MutexCreate(&cam_mutex);
 	if (eError != TIMM_OSAL_ERR_NONE)
 	{
 		TIMM_OSAL_Error("Creation of default mutex failed");
 	}
+
+	property_get(DCC_RESIDENT_PROPERTY, value, "0");
+	bDccResident = atoi(value) ? OMX_TRUE : OMX_FALSE;
+	property_get(VTC_POOL_PROPERTY, value, "1");
+	sVtcPool.bEnabled = atoi(value) ? OMX_TRUE : OMX_FALSE;
 }
 
 
@@ -913,9 +1679,29 @@ void __attribute__ ((destructor)) Cam_Destroy(void)
 {
 	TIMM_OSAL_ERRORTYPE eError = TIMM_OSAL_ERR_NONE;
 
+	/* the resident DCC buffer and the VTC pool live as long as the library */
+	if (pCamMemPluginHandle != NULL)
+	{
+		DCC_FreeBuffer(pCamMemPluginHandle, nCamClientDesc);
+		_OMX_CameraVtcPoolFree();
+		MemPlugin_Close(pCamMemPluginHandle, nCamClientDesc);
+		MemPlugin_DeInit(pCamMemPluginHandle);
+		pCamMemPluginHandle = NULL;
+	}
+	if (pDccEntries != NULL)
+	{
+		TIMM_OSAL_Free(pDccEntries);
+		pDccEntries = NULL;
+	}
+
+	/* no component was ever created */
+	if (cam_mutex == NULL)
+		return;
+
 	eError = TIMM_OSAL_MutexDelete(cam_mutex);
 	if (eError != TIMM_OSAL_ERR_NONE)
 	{
 		TIMM_OSAL_Error("Destruction of default mutex failed");
 	}
+	cam_mutex = NULL;
 }
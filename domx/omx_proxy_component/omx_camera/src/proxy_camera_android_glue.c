@@ -54,14 +54,141 @@
 #include "memplugin_ion.h"
 
 #define MAX_NUM_INTERNAL_BUFFERS 4
+
+/* ===========================================================================*/
+/**
+ * @name GLUE_CameraPutComponentBuffer()
+ * @brief Gives a component buffer to the pool of its port. When the pool is
+ *        full the smallest of the pooled buffers and this one is freed.
+ */
+/* ===========================================================================*/
+static void GLUE_CameraPutComponentBuffer(PROXY_COMPONENT_PRIVATE *pCompPrv,
+    OMX_U32 port, PROXY_CAM_COMPONENT_BUFFER *pBuf)
+{
+    OMX_PROXY_CAM_PRIVATE *pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
+    PROXY_CAM_COMPONENT_BUFFER *pPool = pCamPrv->sComponentBufferPool[port];
+    PROXY_CAM_COMPONENT_BUFFER sVictim = *pBuf;
+    MEMPLUGIN_BUFFER_PARAMS delBuffer_params;
+    OMX_U32 i, nSmallest = 0;
+
+    for (i = 0; i < COMPONENT_BUFFER_POOL_SIZE; i++) {
+        if (pPool[i].sProp.sBuffer_accessor.pBufferHandle == NULL) {
+            pPool[i] = *pBuf;
+            return;
+        }
+        if (pPool[i].nSize < pPool[nSmallest].nSize)
+            nSmallest = i;
+    }
+    if (pPool[nSmallest].nSize < pBuf->nSize) {
+        sVictim = pPool[nSmallest];
+        pPool[nSmallest] = *pBuf;
+    }
+
+    MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
+    MemPlugin_Free(pCompPrv->pMemPluginHandle, pCompPrv->nMemmgrClientDesc,
+                   &delBuffer_params, &sVictim.sProp);
+}
+
+/* ===========================================================================*/
+/**
+ * @name GLUE_CameraGetComponentBuffer()
+ * @brief Takes the smallest pooled buffer of the port holding nSize bytes.
+ * @return OMX_TRUE if one was found
+ */
+/* ===========================================================================*/
+static OMX_BOOL GLUE_CameraGetComponentBuffer(OMX_PROXY_CAM_PRIVATE *pCamPrv,
+    OMX_U32 port, OMX_U32 nSize, PROXY_CAM_COMPONENT_BUFFER *pBuf)
+{
+    PROXY_CAM_COMPONENT_BUFFER *pPool = pCamPrv->sComponentBufferPool[port];
+    PROXY_CAM_COMPONENT_BUFFER *pBest = NULL;
+    OMX_U32 i;
+
+    for (i = 0; i < COMPONENT_BUFFER_POOL_SIZE; i++) {
+        if (pPool[i].sProp.sBuffer_accessor.pBufferHandle != NULL &&
+            pPool[i].nSize >= nSize &&
+            (pBest == NULL || pPool[i].nSize < pBest->nSize))
+            pBest = &pPool[i];
+    }
+    if (pBest == NULL)
+        return OMX_FALSE;
+
+    *pBuf = *pBest;
+    TIMM_OSAL_Memset(pBest, 0, sizeof(*pBest));
+    return OMX_TRUE;
+}
+
+/* ===========================================================================*/
+/**
+ * @name GLUE_CameraReleaseComponentBuffers()
+ * @brief Moves the component buffers of nPort (or of every port for OMX_ALL)
+ *        to the pool of the port when the port is disabled.
+ */
+/* ===========================================================================*/
+void GLUE_CameraReleaseComponentBuffers(OMX_HANDLETYPE hComponent, OMX_U32 nPort)
+{
+    PROXY_COMPONENT_PRIVATE *pCompPrv;
+    OMX_PROXY_CAM_PRIVATE* pCamPrv;
+    OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *)hComponent;
+    PROXY_CAM_COMPONENT_BUFFER *pBuf;
+    OMX_U32 i, j;
+
+    pCompPrv = (PROXY_COMPONENT_PRIVATE *)hComp->pComponentPrivate;
+    pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
+
+    for (i = 0; i < PROXY_MAXNUMOFPORTS; i++) {
+        if ((i != nPort) && (nPort != OMX_ALL))
+            continue;
+        for (j = 0; j < MAX_NUM_INTERNAL_BUFFERS; j++) {
+            pBuf = &pCamPrv->gComponentBufferAllocation[i][j];
+            if (pBuf->sProp.sBuffer_accessor.pBufferHandle) {
+                GLUE_CameraPutComponentBuffer(pCompPrv, i, pBuf);
+                TIMM_OSAL_Memset(pBuf, 0, sizeof(*pBuf));
+            }
+        }
+    }
+}
+
+/* ===========================================================================*/
+/**
+ * @name GLUE_CameraFreeComponentBuffers()
+ * @brief Frees every component buffer, in use or pooled.
+ */
+/* ===========================================================================*/
+void GLUE_CameraFreeComponentBuffers(OMX_HANDLETYPE hComponent)
+{
+    PROXY_COMPONENT_PRIVATE *pCompPrv;
+    OMX_PROXY_CAM_PRIVATE* pCamPrv;
+    OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *)hComponent;
+    MEMPLUGIN_BUFFER_PARAMS delBuffer_params;
+    PROXY_CAM_COMPONENT_BUFFER *pBuf;
+    OMX_U32 i, j;
+
+    pCompPrv = (PROXY_COMPONENT_PRIVATE *)hComp->pComponentPrivate;
+    pCamPrv = (OMX_PROXY_CAM_PRIVATE*)pCompPrv->pCompProxyPrv;
+    MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
+
+    for (i = 0; i < PROXY_MAXNUMOFPORTS; i++) {
+        for (j = 0; j < MAX_NUM_INTERNAL_BUFFERS + COMPONENT_BUFFER_POOL_SIZE; j++) {
+            pBuf = j < MAX_NUM_INTERNAL_BUFFERS ?
+                   &pCamPrv->gComponentBufferAllocation[i][j] :
+                   &pCamPrv->sComponentBufferPool[i][j - MAX_NUM_INTERNAL_BUFFERS];
+            if (pBuf->sProp.sBuffer_accessor.pBufferHandle) {
+                MemPlugin_Free(pCompPrv->pMemPluginHandle, pCompPrv->nMemmgrClientDesc,
+                               &delBuffer_params, &pBuf->sProp);
+            }
+            TIMM_OSAL_Memset(pBuf, 0, sizeof(*pBuf));
+        }
+    }
+}
+
 OMX_ERRORTYPE GLUE_CameraSetParam(OMX_IN OMX_HANDLETYPE
     hComponent, OMX_IN OMX_INDEXTYPE nParamIndex,
     OMX_INOUT OMX_PTR pComponentParameterStructure)
     {
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	MEMPLUGIN_ERRORTYPE eMemError = MEMPLUGIN_ERROR_NONE;
-    MEMPLUGIN_BUFFER_PARAMS newBuffer_params,delBuffer_params;
-    MEMPLUGIN_BUFFER_PROPERTIES newBuffer_prop,delBuffer_prop;
+    MEMPLUGIN_BUFFER_PARAMS newBuffer_params;
+    PROXY_CAM_COMPONENT_BUFFER newBuffer, *pCurBuffer;
     OMX_S32 ret = 0;
     PROXY_COMPONENT_PRIVATE *pCompPrv;
     OMX_PROXY_CAM_PRIVATE* pCamPrv;
@@ -78,58 +205,73 @@ OMX_ERRORTYPE GLUE_CameraSetParam(OMX_IN OMX_HANDLETYPE
     pMemPluginHdl = ((MEMPLUGIN_OBJECT *)pCompPrv->pMemPluginHandle);
     pIonParams = ((MEMPLUGIN_ION_PARAMS *)pMemPluginHdl->pPluginExtendedInfo);
     MEMPLUGIN_BUFFER_PARAMS_INIT(newBuffer_params);
-    MEMPLUGIN_BUFFER_PARAMS_INIT(delBuffer_params);
     switch (nParamIndex)
     {
 	case OMX_TI_IndexParamComponentBufferAllocation: {
                 OMX_U32 port = 0, index = 0;
-		int fd;
 		bufferalloc = (OMX_TI_PARAM_COMPONENTBUFALLOCTYPE *)
 			pComponentParameterStructure;
 
                 port = bufferalloc->nPortIndex;
                 index = bufferalloc->nIndex;
+		PROXY_require(port < PROXY_MAXNUMOFPORTS && index < MAX_NUM_INTERNAL_BUFFERS,
+		    OMX_ErrorBadParameter, "Component buffer port/index out of range");
+		pCurBuffer = &pCamPrv->gComponentBufferAllocation[port][index];
 
 		newBuffer_params.nWidth = bufferalloc->nAllocWidth * bufferalloc->nAllocLines;
 		newBuffer_params.eBuffer_type = TILER1D;
 		newBuffer_params.eTiler_format = MEMPLUGIN_TILER_FORMAT_PAGE;
-		if(pIonParams == NULL)
+
+		/* the buffer already set for this slot, or one that an earlier mode
+		   gave back, is as good as a new one if it is big enough */
+		if (pCurBuffer->sProp.sBuffer_accessor.pBufferHandle != NULL &&
+		    pCurBuffer->nSize >= newBuffer_params.nWidth) {
+			bufferalloc->pBuf[0] = (OMX_PTR)pCurBuffer->sProp.sBuffer_accessor.bufferFd;
+			eError = __PROXY_SetParameter(hComponent,
+						      OMX_TI_IndexParamComponentBufferAllocation,
+						      bufferalloc, &bufferalloc->pBuf[0], 1);
+			goto EXIT;
+		}
+		if (!GLUE_CameraGetComponentBuffer(pCamPrv, port, newBuffer_params.nWidth, &newBuffer))
 		{
-			pIonParams = TIMM_OSAL_MallocExtn(sizeof(MEMPLUGIN_ION_PARAMS), TIMM_OSAL_TRUE,
-                                      0, TIMMOSAL_MEM_SEGMENT_EXT, NULL);
 			if(pIonParams == NULL)
 			{
-				DOMX_ERROR("%s:Error allocating pPluginExtendedInfo",__FUNCTION__);
-				goto EXIT;
+				pIonParams = TIMM_OSAL_MallocExtn(sizeof(MEMPLUGIN_ION_PARAMS), TIMM_OSAL_TRUE,
+	                                      0, TIMMOSAL_MEM_SEGMENT_EXT, NULL);
+				if(pIonParams == NULL)
+				{
+					DOMX_ERROR("%s:Error allocating pPluginExtendedInfo",__FUNCTION__);
+					goto EXIT;
+				}
+				pMemPluginHdl->pPluginExtendedInfo = pIonParams;
 			}
-                        pMemPluginHdl->pPluginExtendedInfo = pIonParams;
-		}
-		MEMPLUGIN_ION_PARAMS_INIT(pIonParams);
-                //override alloc_flags for tiler 1d non secure
-		pIonParams->alloc_flags = OMAP_ION_HEAP_TILER_MASK;
+			MEMPLUGIN_ION_PARAMS_INIT(pIonParams);
+			//override alloc_flags for tiler 1d non secure
+			pIonParams->alloc_flags = OMAP_ION_HEAP_TILER_MASK;
 
-		eMemError = MemPlugin_Alloc(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc,&newBuffer_params,&newBuffer_prop);
-		if(eMemError != MEMPLUGIN_ERROR_NONE)
-		{
-			DOMX_ERROR("%s:allocation failed size: %d",newBuffer_params.nWidth*newBuffer_params.nHeight);
-			eError = OMX_ErrorInsufficientResources;
-			goto EXIT;
+			eMemError = MemPlugin_Alloc(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc,&newBuffer_params,&newBuffer.sProp);
+			if(eMemError != MEMPLUGIN_ERROR_NONE)
+			{
+				DOMX_ERROR("%s:allocation failed size: %d",newBuffer_params.nWidth*newBuffer_params.nHeight);
+				eError = OMX_ErrorInsufficientResources;
+				goto EXIT;
+			}
+			newBuffer.nSize = newBuffer_params.nWidth;
 		}
-		bufferalloc->pBuf[0] = (OMX_PTR)newBuffer_prop.sBuffer_accessor.bufferFd;
+		/* the fd stays open for as long as the buffer is kept, it is what
+		   gets sent again when the buffer is reused */
+		bufferalloc->pBuf[0] = (OMX_PTR)newBuffer.sProp.sBuffer_accessor.bufferFd;
 		eError = __PROXY_SetParameter(hComponent,
 					      OMX_TI_IndexParamComponentBufferAllocation,
 					      bufferalloc, &bufferalloc->pBuf[0], 1);
                 if (eError != OMX_ErrorNone) {
-                   MemPlugin_Free(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc, &newBuffer_params,&newBuffer_prop);
+                   GLUE_CameraPutComponentBuffer(pCompPrv, port, &newBuffer);
                 } else {
-                   if (pCamPrv->gComponentBufferAllocation[port][index]) {
-					   delBuffer_prop.sBuffer_accessor.pBufferHandle = pCamPrv->gComponentBufferAllocation[port][index];
-                       MemPlugin_Free(pCompPrv->pMemPluginHandle,pCompPrv->nMemmgrClientDesc,&delBuffer_params,&delBuffer_prop);
+                   if (pCurBuffer->sProp.sBuffer_accessor.pBufferHandle) {
+                       GLUE_CameraPutComponentBuffer(pCompPrv, port, pCurBuffer);
                    }
-                   pCamPrv->gComponentBufferAllocation[port][index] = newBuffer_prop.sBuffer_accessor.pBufferHandle;
+                   *pCurBuffer = newBuffer;
                 }
-		close (newBuffer_prop.sBuffer_accessor.bufferFd);
-		newBuffer_prop.sBuffer_accessor.bufferFd = -1;
         }
 		goto EXIT;
 		break;
@@ -245,6 +387,9 @@ OMX_ERRORTYPE GLUE_CameraVtcAllocateMemory(OMX_IN OMX_HANDLETYPE hComponent, OMX
             goto EXIT;
         }
 	}
+	pCamPrv->nVtcWidth = nFrmWidth;
+	pCamPrv->nVtcHeight = nFrmHeight;
+	pCamPrv->nVtcSliceHeight = pVtcConfig->nSliceHeight;
 EXIT:
 	pMemPluginHdl->pPluginExtendedInfo = NULL;
 	if (eError != OMX_ErrorNone) {
@@ -72,11 +72,9 @@
 #define COMPONENT_NAME "OMX.TI.DUCATI1.VIDEO.DECODER"
 /* needs to be specific for every configuration wrapper */
 
-#ifdef USE_ENHANCED_PORTRECONFIG
 //Define port indices in video decoder proxy
 #define OMX_VIDEODECODER_INPUT_PORT 0
 #define OMX_VIDEODECODER_OUTPUT_PORT 1
-#endif
 
 #ifdef SET_STRIDE_PADDING_FROM_PROXY
 
@@ -104,10 +102,13 @@ OMX_ERRORTYPE PROXY_VIDDEC_GetExtensionIndex(OMX_IN OMX_HANDLETYPE hComponent,
 OMX_ERRORTYPE PROXY_VIDDEC_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
     OMX_IN OMX_INDEXTYPE nParamIndex, OMX_INOUT OMX_PTR pParamStruct);
 
+#endif
+
 OMX_ERRORTYPE PROXY_VIDDEC_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
     OMX_IN OMX_INDEXTYPE nParamIndex, OMX_INOUT OMX_PTR pParamStruct);
 
-#endif
+OMX_ERRORTYPE PROXY_VIDDEC_SetConfig(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_INDEXTYPE nConfigIndex, OMX_IN OMX_PTR pConfigStruct);
 
 #ifdef ANDROID_QUIRK_LOCK_BUFFER
 #include <hardware/gralloc.h>
@@ -123,9 +124,15 @@ OMX_ERRORTYPE PROXY_VIDDEC_FillBufferDone(OMX_HANDLETYPE hComponent,
 #endif
 extern OMX_ERRORTYPE PrearrageEmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	OMX_BUFFERHEADERTYPE * pBufferHdr);
+extern void PROXY_VIDDEC_ResetCodecConfig(OMX_HANDLETYPE hComponent);
+extern OMX_ERRORTYPE PROXY_VIDDEC_SetLateness(OMX_HANDLETYPE hComponent,
+	OMX_TICKS nLateness);
+extern OMX_ERRORTYPE PROXY_VIDDEC_SetThumbnailMode(OMX_HANDLETYPE hComponent,
+	OMX_BOOL bEnable);
 
 #ifdef ENABLE_RAW_BUFFERS_DUMP_UTILITY
 extern void DumpVideoFrame(DebugFrame_Dump *frameInfo);
+extern void DumpVideoFrameDeinit(DebugFrame_Dump *frameInfo);
 #endif
 
 OMX_ERRORTYPE OMX_ProxyViddecInit(OMX_HANDLETYPE hComponent);
@@ -224,8 +231,9 @@ OMX_ERRORTYPE OMX_ProxyViddecInit(OMX_HANDLETYPE hComponent)
 
 	eError = OMX_ProxyCommonInit(hComponent);	// Calling Proxy Common Init()
 	PROXY_assert(eError == OMX_ErrorNone, eError, "Proxy common init returned error");
-#ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
 	pHandle->SetParameter = PROXY_VIDDEC_SetParameter;
+	pHandle->SetConfig = PROXY_VIDDEC_SetConfig;
+#ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
         pHandle->GetParameter = PROXY_VIDDEC_GetParameter;
 #endif
 	pHandle->GetExtensionIndex = PROXY_VIDDEC_GetExtensionIndex;
@@ -263,7 +271,10 @@ OMX_ERRORTYPE OMX_ProxyViddecInit(OMX_HANDLETYPE hComponent)
 	tParamStruct.nVersion.s.nRevision = 0x0;
 	tParamStruct.nVersion.s.nStep = 0x0;
 	tParamStruct.nPortIndex = OMX_VIDEODECODER_OUTPUT_PORT;
-        tParamStruct.bUsePortReconfigForCrop = OMX_TRUE;
+	/* Crop changes fit the buffers already in use, let the decoder report
+	   them as an OMX_IndexConfigCommonOutputCrop event and keep running
+	   instead of asking the client for a full port reconfiguration */
+        tParamStruct.bUsePortReconfigForCrop = OMX_FALSE;
         tParamStruct.bUsePortReconfigForPadding = OMX_TRUE;
 
 	eError = PROXY_SetParameter(hComponent,(OMX_INDEXTYPE)OMX_TI_IndexParamUseEnhancedPortReconfig,
@@ -301,6 +312,19 @@ OMX_ERRORTYPE PROXY_VIDDEC_GetExtensionIndex(OMX_IN OMX_HANDLETYPE hComponent,
 
 	DOMX_ENTER("hComponent = %p, cParameterName = %p", hComponent, cParameterName);
 
+	/* Handled by the proxy, see PROXY_VIDDEC_SetConfig */
+	if (strcmp(cParameterName, "OMX.TI.index.config.video.lateness") == 0)
+	{
+		*pIndexType = (OMX_INDEXTYPE) OMX_TI_IndexConfigVideoLateness;
+		goto EXIT;
+	}
+	/* Handled by the proxy, see PROXY_VIDDEC_SetParameter */
+	if (strcmp(cParameterName, "OMX.TI.index.param.video.thumbnailmode") == 0)
+	{
+		*pIndexType = (OMX_INDEXTYPE) OMX_TI_IndexParamVideoThumbnailMode;
+		goto EXIT;
+	}
+
 #ifdef ENABLE_GRALLOC_BUFFERS
 	// Ensure that String length is not greater than Max allowed length
 	PROXY_require(strlen(cParameterName) <= 127, OMX_ErrorBadParameter, NULL);
@@ -414,6 +438,8 @@ OMX_ERRORTYPE PROXY_VIDDEC_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	return eError;
 }
 
+#endif
+
 /* ===========================================================================*/
 /**
  * @name PROXY_SetParameter()
@@ -430,8 +456,12 @@ OMX_ERRORTYPE PROXY_VIDDEC_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+#ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
 	OMX_PARAM_PORTDEFINITIONTYPE* pPortDef = (OMX_PARAM_PORTDEFINITIONTYPE *)pParamStruct;
 	OMX_VIDEO_PARAM_PORTFORMATTYPE* pPortParams = (OMX_VIDEO_PARAM_PORTFORMATTYPE *)pParamStruct;
+#endif
+	OMX_VIDEO_PARAM_DATASYNCMODETYPE *pDataSync = NULL;
+	OMX_CONFIG_BOOLEANTYPE *pThumbnail = NULL;
 
 	PROXY_require((pParamStruct != NULL), OMX_ErrorBadParameter, NULL);
 	PROXY_require((hComp->pComponentPrivate != NULL),
@@ -441,6 +471,24 @@ OMX_ERRORTYPE PROXY_VIDDEC_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	DOMX_ENTER
 	    ("hComponent = %p, pCompPrv = %p, nParamIndex = %d, pParamStruct = %p",
 	    hComponent, pCompPrv, nParamIndex, pParamStruct);
+
+	/* Thumbnail mode stays in the proxy, set it before the output buffers
+	   are allocated to get the minimum count */
+	if(nParamIndex == (OMX_INDEXTYPE)OMX_TI_IndexParamVideoThumbnailMode)
+	{
+		PROXY_CHK_VERSION(pParamStruct, OMX_CONFIG_BOOLEANTYPE);
+		pThumbnail = (OMX_CONFIG_BOOLEANTYPE *)pParamStruct;
+		eError = PROXY_VIDDEC_SetThumbnailMode(hComponent,
+		    pThumbnail->bEnabled);
+		goto EXIT;
+	}
+
+	/* The role decides how codec config buffers are rearranged */
+	if(nParamIndex == OMX_IndexParamStandardComponentRole)
+	{
+		PROXY_VIDDEC_ResetCodecConfig(hComponent);
+	}
+#ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
 	if(nParamIndex == OMX_IndexParamPortDefinition)
 	{
 		if(pPortDef->format.video.eColorFormat == OMX_TI_COLOR_FormatYUV420PackedSemiPlanar
@@ -457,17 +505,64 @@ OMX_ERRORTYPE PROXY_VIDDEC_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 			pPortParams->eColorFormat = OMX_COLOR_FormatYUV420PackedSemiPlanar;
 		}
 	}
+#endif
 
 	eError = PROXY_SetParameter(hComponent, nParamIndex, pParamStruct);
 	PROXY_assert(eError == OMX_ErrorNone,
 		    eError," Error in Proxy SetParameter");
 
+	/* Row or slice sync on the output port makes the decoder hand out each
+	   frame in bands, passed on as OMX_TI_EventPartialFrame */
+	if(nParamIndex == (OMX_INDEXTYPE)OMX_TI_IndexParamVideoDataSyncMode)
+	{
+		pDataSync = (OMX_VIDEO_PARAM_DATASYNCMODETYPE *)pParamStruct;
+		if(pDataSync->nPortIndex == OMX_VIDEODECODER_OUTPUT_PORT)
+		{
+			pCompPrv->proxyPortBuffers[OMX_VIDEODECODER_OUTPUT_PORT].bPartialFrames =
+				(pDataSync->eDataMode == OMX_Video_EntireFrame) ? OMX_FALSE : OMX_TRUE;
+		}
+	}
+
 	EXIT:
 	DOMX_EXIT("eError: %d", eError);
 	return eError;
 }
 
-#endif
+/* ===========================================================================*/
+/**
+ * @name PROXY_VIDDEC_SetConfig()
+ * @brief OMX_TI_IndexConfigVideoLateness takes the current A/V sync lateness
+ *        in nTimestamp (us, negative when early) and stays in the proxy,
+ *        everything else goes to the remote component.
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+OMX_ERRORTYPE PROXY_VIDDEC_SetConfig(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_INDEXTYPE nConfigIndex, OMX_IN OMX_PTR pConfigStruct)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	OMX_TIME_CONFIG_TIMESTAMPTYPE *pLateness = NULL;
+
+	PROXY_require((pConfigStruct != NULL), OMX_ErrorBadParameter, NULL);
+	PROXY_require((hComp->pComponentPrivate != NULL),
+	    OMX_ErrorBadParameter, NULL);
+
+	if(nConfigIndex != (OMX_INDEXTYPE)OMX_TI_IndexConfigVideoLateness)
+	{
+		eError = PROXY_SetConfig(hComponent, nConfigIndex, pConfigStruct);
+		goto EXIT;
+	}
+
+	pLateness = (OMX_TIME_CONFIG_TIMESTAMPTYPE *)pConfigStruct;
+	eError = PROXY_VIDDEC_SetLateness(hComponent, pLateness->nTimestamp);
+	PROXY_assert(eError == OMX_ErrorNone,
+	    eError," Error in decode skip update");
+
+	EXIT:
+	DOMX_EXIT("eError: %d", eError);
+	return eError;
+}
 
 #ifdef SET_STRIDE_PADDING_FROM_PROXY
 /* ===========================================================================*/
@@ -580,6 +675,7 @@ OMX_ERRORTYPE RPC_UTIL_SetStrideAndPadding(OMX_COMPONENTTYPE * hComponent,PROXY_
 	OMX_PARAM_PORTDEFINITIONTYPE sPortDef;
 	OMX_CONFIG_RECTTYPE tParamStruct;
 	OMX_U32 nPortIndex = 0;
+	OMX_U32 nStride = 0;
 
 	for(nPortIndex=0; nPortIndex < TOTAL_DEC_PORTS ;nPortIndex++ )
 	{
@@ -591,8 +687,9 @@ OMX_ERRORTYPE RPC_UTIL_SetStrideAndPadding(OMX_COMPONENTTYPE * hComponent,PROXY_
 		sPortDef.nVersion.s.nStep = 0x0;
 		sPortDef.nPortIndex = nPortIndex;
 
-		eError = PROXY_GetParameter(hComponent,OMX_IndexParamPortDefinition,
-			   &sPortDef);
+		/* Ports that were not touched since the last read are answered
+		   locally, the SetParameter below drops the cache again */
+		eError = PROXY_GetCachedPortDefinition(hComponent, &sPortDef);
 		PROXY_assert(eError == OMX_ErrorNone,
 			    eError," Error in Proxy GetParameter for Port Def");
 
@@ -600,7 +697,7 @@ OMX_ERRORTYPE RPC_UTIL_SetStrideAndPadding(OMX_COMPONENTTYPE * hComponent,PROXY_
 		{
 			if(pCompPrv->proxyPortBuffers[nPortIndex].IsBuffer2D == OMX_TRUE)
 			{
-				sPortDef.format.video.nStride = LINUX_PAGE_SIZE;
+				nStride = LINUX_PAGE_SIZE;
 			}
 			else
 			{
@@ -616,8 +713,14 @@ OMX_ERRORTYPE RPC_UTIL_SetStrideAndPadding(OMX_COMPONENTTYPE * hComponent,PROXY_
 				PROXY_assert(eError == OMX_ErrorNone,
 					    eError," Error in Proxy GetParameter for 2D index");
 
-				sPortDef.format.video.nStride = tParamStruct.nWidth;
+				nStride = tParamStruct.nWidth;
 			}
+			/* Re-enabling a port usually finds the stride already in place */
+			if(sPortDef.format.video.nStride == (OMX_S32)nStride)
+			{
+				continue;
+			}
+			sPortDef.format.video.nStride = nStride;
 			eError = PROXY_SetParameter(hComponent,OMX_IndexParamPortDefinition,
 				   &sPortDef);
 			PROXY_assert(eError == OMX_ErrorNone,
@@ -669,8 +772,9 @@ OMX_ERRORTYPE PROXY_VIDDEC_FillThisBuffer(OMX_HANDLETYPE hComponent, OMX_BUFFERH
 		sPortDef.nVersion.s.nRevision = 0x0;
 		sPortDef.nVersion.s.nStep = 0x0;
 		sPortDef.nPortIndex = OMX_VIDEODECODER_INPUT_PORT;
-		eError = PROXY_GetParameter(hComponent,OMX_IndexParamPortDefinition,
-				&sPortDef);
+		/* Only the frame geometry is needed, the cached copy is dropped by
+		   PROXY_EventHandler on port settings changes */
+		eError = PROXY_GetCachedPortDefinition(hComponent, &sPortDef);
 		PROXY_assert(eError == OMX_ErrorNone,
 				eError," Error in Proxy GetParameter for Port Def");
 
@@ -736,26 +840,23 @@ OMX_ERRORTYPE PROXY_VIDDEC_FillBufferDone(OMX_HANDLETYPE hComponent,
 	/* Extract the Gralloc handle from the Header and then call lock on that */
 	/* Note# There is no error check for the pBufferHdr here*/
 
+	/* A band of a frame still being decoded, the decoder keeps writing to
+	   the buffer so it stays locked */
 	if(pCompPrv->proxyPortBuffers[OMX_VIDEODECODER_OUTPUT_PORT].proxyBufferType
-			== GrallocPointers) {
-		for (count = 0; count < pCompPrv->nTotalBuffers; ++count)
-		{
-			if (pCompPrv->tBufList[count].pBufHeaderRemote == remoteBufHdr)
-			{
-				grallocHandle = (IMG_native_handle_t*)(pCompPrv->tBufList[count].pBufHeader)->pBuffer;
-				break;
-			}
-		}
-
+			== GrallocPointers && !PROXY_IS_PARTIAL_FBD(
+			&pCompPrv->proxyPortBuffers[OMX_VIDEODECODER_OUTPUT_PORT],
+			nFlags, nfilledLen)) {
+		count = PROXY_FindBufferByRemote(pCompPrv, remoteBufHdr);
 		PROXY_assert((count != pCompPrv->nTotalBuffers),
 				OMX_ErrorBadParameter,
 				"Received invalid-buffer header from OMX component");
+		grallocHandle = (IMG_native_handle_t*)(PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader)->pBuffer;
 		pCompPrv->grallocModule->unlock((gralloc_module_t const *) pCompPrv->grallocModule, (buffer_handle_t)grallocHandle);
 
 #ifdef ENABLE_RAW_BUFFERS_DUMP_UTILITY
 		DOMX_DEBUG("frm[%u] to[%u] run[%u]", pCompPrv->debugframeInfo.fromFrame, pCompPrv->debugframeInfo.toFrame, pCompPrv->debugframeInfo.runningFrame);
 		/* Fill buffer Done successed, hence start dumping if requested	*/
-		OMX_BUFFERHEADERTYPE *pBufHdr = pCompPrv->tBufList[count].pBufHeader;
+		OMX_BUFFERHEADERTYPE *pBufHdr = PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader;
 		if ((pCompPrv->debugframeInfo.fromFrame == 0) && (pCompPrv->debugframeInfo.runningFrame <= pCompPrv->debugframeInfo.toFrame))
 		{
 			/* Lock the buffer for SW read usage and then access it */
@@ -798,6 +899,7 @@ OMX_ERRORTYPE PROXY_VIDDEC_ComponentDeInit(OMX_HANDLETYPE hComponent)
 {
         OMX_ERRORTYPE eError = OMX_ErrorNone;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 
         DOMX_ENTER("PROXY_VIDDEC_ComponentDeinit called with hComp %x",hComponent);
 	PROXY_require((hComp->pComponentPrivate != NULL),
@@ -805,6 +907,12 @@ OMX_ERRORTYPE PROXY_VIDDEC_ComponentDeInit(OMX_HANDLETYPE hComponent)
 			"This is fatal error, processing cant proceed - please debug");
 
         //decoder specific config will be included here in following patches
+	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+#ifdef ENABLE_RAW_BUFFERS_DUMP_UTILITY
+	DumpVideoFrameDeinit(&pCompPrv->debugframeInfo);
+#endif
+	TIMM_OSAL_Free(pCompPrv->pCompProxyPrv);
+	pCompPrv->pCompProxyPrv = NULL;
 
         eError = PROXY_ComponentDeInit(hComponent);
 EXIT:
@@ -7,6 +7,13 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#ifdef _Android
+#include <cutils/properties.h>
+#endif
 
 #define COMPONENT_NAME "OMX.TI.DUCATI1.VIDEO.DECODER.secure"
 
@@ -16,14 +23,188 @@ extern OMX_U32 SECURE_COMPONENTS_RUNNING;
 extern OMX_ERRORTYPE OMX_ProxyViddecInit(OMX_HANDLETYPE hComponent);
 OMX_ERRORTYPE PROXY_VIDDEC_Secure_ComponentDeInit(OMX_HANDLETYPE hComponent);
 
+/* How long secure mode is kept after the last secure decoder goes away */
+#define SECURE_MODE_LINGER_MS_DEFAULT 0
+
+/* Secure mode of the remote core is shared by all secure decoders in the
+ * process: it is switched on by the first instance and off once the last
+ * one is gone (optionally after a grace period, so that a seek or a new
+ * session that recreates the decoder does not pay for another switch) */
+static struct {
+	pthread_mutex_t tLock;
+	pthread_cond_t tCond;
+	int fd;
+	OMX_U32 nUsers;
+	OMX_BOOL bLingering;
+	OMX_U32 nLingerEpoch;
+} gSecureMode = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	-1, 0, OMX_FALSE, 0 };
+
+static OMX_U32 SECURE_LingerMs(void)
+{
+	const char *pValue = getenv("DEBUG_DOMX_SECURE_LINGER_MS");
+#ifdef _Android
+	char cValue[PROPERTY_VALUE_MAX];
+
+	if (pValue == NULL && property_get("debug.domx.secure_linger_ms",
+	    cValue, NULL) > 0)
+	{
+		pValue = cValue;
+	}
+#endif
+	return (pValue != NULL) ? (OMX_U32) strtoul(pValue, NULL, 0) :
+	    SECURE_MODE_LINGER_MS_DEFAULT;
+}
+
+/* Called with gSecureMode.tLock held */
+static void SECURE_Disable(void)
+{
+	const OMX_U8 disable = 0;
+
+	if (write(gSecureMode.fd, &disable, sizeof(disable)) < 0)
+	{
+		DOMX_ERROR("Setting unsecure mode failed");
+	}
+	if (close(gSecureMode.fd) < 0)
+	{
+		DOMX_ERROR("Can't close the driver");
+	}
+	gSecureMode.fd = -1;
+}
+
+static void *SECURE_LingerThread(void *pArg)
+{
+	struct timespec tDeadline;
+	OMX_U32 nLingerMs = (OMX_U32) pArg;
+	OMX_U32 nEpoch;
+
+	pthread_mutex_lock(&gSecureMode.tLock);
+	nEpoch = gSecureMode.nLingerEpoch;
+	clock_gettime(CLOCK_REALTIME, &tDeadline);
+	tDeadline.tv_sec += nLingerMs / 1000;
+	tDeadline.tv_nsec += (nLingerMs % 1000) * 1000000L;
+	if (tDeadline.tv_nsec >= 1000000000L)
+	{
+		tDeadline.tv_sec++;
+		tDeadline.tv_nsec -= 1000000000L;
+	}
+	while (gSecureMode.nUsers == 0 && nEpoch == gSecureMode.nLingerEpoch)
+	{
+		if (pthread_cond_timedwait(&gSecureMode.tCond, &gSecureMode.tLock,
+		    &tDeadline) != 0)
+		{
+			break;
+		}
+	}
+	/* A newer release restarts the grace period in its own thread */
+	if (nEpoch == gSecureMode.nLingerEpoch)
+	{
+		if (gSecureMode.nUsers == 0 && gSecureMode.fd >= 0)
+		{
+			DOMX_DEBUG("Leaving secure mode after %d ms grace period",
+			    nLingerMs);
+			SECURE_Disable();
+		}
+		gSecureMode.bLingering = OMX_FALSE;
+	}
+	pthread_mutex_unlock(&gSecureMode.tLock);
+
+	return NULL;
+}
+
+static OMX_ERRORTYPE SECURE_Acquire(int *pFd)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	const OMX_U8 enable = 1;
+	OMX_U8 mode = 0;
+	int ret;
+
+	pthread_mutex_lock(&gSecureMode.tLock);
+	if (gSecureMode.fd >= 0)
+	{
+		/* Already secure, either in use or within the grace period */
+		DOMX_DEBUG("Reusing secure mode, %d users", gSecureMode.nUsers);
+		goto DONE;
+	}
+
+	gSecureMode.fd = open("/dev/rproc_user", O_SYNC | O_RDWR);
+	if (gSecureMode.fd < 0)
+	{
+		DOMX_ERROR("Can't open rproc_user device 0x%x\n", errno);
+		eError = OMX_ErrorInsufficientResources;
+		goto LEAVE;
+	}
+
+	ret = write(gSecureMode.fd, &enable, sizeof(enable));
+	if (ret != 1)
+	{
+		DOMX_ERROR("errno from setting secure mode = %x", errno);
+		SECURE_Disable();
+		eError = OMX_ErrorInsufficientResources;
+		goto LEAVE;
+	}
+
+	ret = read(gSecureMode.fd, &mode, sizeof(mode));
+	if (ret != 1 || mode != enable)
+	{
+		DOMX_ERROR("ERROR: We are not in secure mode");
+		SECURE_Disable();
+		eError = OMX_ErrorUndefined;
+		goto LEAVE;
+	}
+	DOMX_DEBUG("secure mode recieved from Misc driver for secure playback = 0x%x\n", mode);
+
+      DONE:
+	gSecureMode.nUsers++;
+	/* Stops a pending grace period from switching secure mode off */
+	gSecureMode.nLingerEpoch++;
+	gSecureMode.bLingering = OMX_FALSE;
+	pthread_cond_broadcast(&gSecureMode.tCond);
+	*pFd = gSecureMode.fd;
+      LEAVE:
+	pthread_mutex_unlock(&gSecureMode.tLock);
+	return eError;
+}
+
+static void SECURE_Release(void)
+{
+	OMX_U32 nLingerMs = SECURE_LingerMs();
+	pthread_attr_t tAttr;
+	pthread_t tThread;
+
+	pthread_mutex_lock(&gSecureMode.tLock);
+	if (gSecureMode.nUsers == 0 || --gSecureMode.nUsers != 0)
+	{
+		goto LEAVE;
+	}
+
+	if (nLingerMs != 0)
+	{
+		gSecureMode.nLingerEpoch++;
+		pthread_cond_broadcast(&gSecureMode.tCond);
+		pthread_attr_init(&tAttr);
+		pthread_attr_setdetachstate(&tAttr, PTHREAD_CREATE_DETACHED);
+		if (pthread_create(&tThread, &tAttr, SECURE_LingerThread,
+		    (void *) nLingerMs) == 0)
+		{
+			gSecureMode.bLingering = OMX_TRUE;
+		}
+		pthread_attr_destroy(&tAttr);
+	}
+	if (gSecureMode.bLingering == OMX_FALSE)
+	{
+		SECURE_Disable();
+	}
+      LEAVE:
+	pthread_mutex_unlock(&gSecureMode.tLock);
+}
+
 OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 {
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	OMX_COMPONENTTYPE *pHandle = NULL;
 	PROXY_COMPONENT_PRIVATE *pComponentPrivate = NULL;
-	const OMX_U8 enable = 1, disable = 0;
-        OMX_U8 mode;
-	int ret;
+	OMX_BOOL bSecure = OMX_FALSE;
 
 	pHandle = (OMX_COMPONENTTYPE *) hComponent;
 
@@ -61,36 +242,10 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	TIMM_OSAL_Memcpy(pComponentPrivate->cCompName, COMPONENT_NAME,
 	    strlen(COMPONENT_NAME) + 1);
 
-	pComponentPrivate->secure_misc_drv_fd = open("/dev/rproc_user", O_SYNC | O_RDWR);
-	if (pComponentPrivate->secure_misc_drv_fd < 0)
-	{
-		DOMX_ERROR("Can't open rproc_user device 0x%x\n", errno);
-		eError = OMX_ErrorInsufficientResources;
-                goto EXIT;
-	}
-
-        ret = write(pComponentPrivate->secure_misc_drv_fd, &enable, sizeof(enable));
-        if(ret != 1)
-        {
-            DOMX_ERROR("errno from setting secure mode = %x",errno);
-	    ret = write(pComponentPrivate->secure_misc_drv_fd, &disable, sizeof(disable));
-	    if (ret < 0)
-	    {
-	        DOMX_ERROR("Setting unsecure mode failed");
-            }
-
-	    ret = close(pComponentPrivate->secure_misc_drv_fd);
-	    if (ret < 0)
-	    {
-		DOMX_ERROR("Can't close the driver");
-	    }
-            eError = OMX_ErrorInsufficientResources;
-            goto EXIT;
-        }
-
-	ret = read(pComponentPrivate->secure_misc_drv_fd, &mode, sizeof(mode));
-	PROXY_assert(mode == enable, OMX_ErrorUndefined,"ERROR: We are not in secure mode");
-	DOMX_DEBUG("secure mode recieved from Misc driver for secure playback = 0x%x\n", mode);
+	eError = SECURE_Acquire(&pComponentPrivate->secure_misc_drv_fd);
+	PROXY_assert(eError == OMX_ErrorNone, eError,
+	    "Could not switch to secure mode");
+	bSecure = OMX_TRUE;
 
 	eError = OMX_ProxyViddecInit(hComponent);
 	pHandle->ComponentDeInit = PROXY_VIDDEC_Secure_ComponentDeInit;
@@ -99,6 +254,10 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	    if (eError != OMX_ErrorNone)
 	    {
 		DOMX_DEBUG("Error in Initializing Proxy");
+		if (bSecure)
+		{
+			SECURE_Release();
+		}
 		if (pComponentPrivate->cCompName != NULL)
 		{
 			TIMM_OSAL_Free(pComponentPrivate->cCompName);
@@ -118,16 +277,15 @@ OMX_ERRORTYPE PROXY_VIDDEC_Secure_ComponentDeInit(OMX_HANDLETYPE hComponent)
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	OMX_COMPONENTTYPE *pHandle = NULL;
 	PROXY_COMPONENT_PRIVATE *pComponentPrivate = NULL;
-	int ret;
-	const OMX_U8 disable = 0;
-        int secure_misc_drv_fd;
 
 	pHandle = (OMX_COMPONENTTYPE *) hComponent;
 
 	pComponentPrivate =
 	    (PROXY_COMPONENT_PRIVATE *) pHandle->pComponentPrivate;
 
-        secure_misc_drv_fd = pComponentPrivate->secure_misc_drv_fd;
+	/* Codec config state kept by the decoder proxy */
+	TIMM_OSAL_Free(pComponentPrivate->pCompProxyPrv);
+	pComponentPrivate->pCompProxyPrv = NULL;
 
         eError = PROXY_ComponentDeInit(hComponent);
         if(eError != OMX_ErrorNone)
@@ -136,17 +294,7 @@ OMX_ERRORTYPE PROXY_VIDDEC_Secure_ComponentDeInit(OMX_HANDLETYPE hComponent)
         }
         pComponentPrivate = NULL;
 
-        ret = write(secure_misc_drv_fd, &disable, sizeof(disable));
-	if (ret < 0)
-	{
-	        DOMX_ERROR("Setting unsecure mode failed");
-        }
-
-	ret = close(secure_misc_drv_fd);
-	if (ret < 0)
-	{
-		DOMX_ERROR("Can't close the driver");
-	}
+	SECURE_Release();
 
 	return eError;
 }
@@ -53,6 +53,11 @@
 #include <cutils/properties.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
 #endif
 
 #define COMPONENT_NAME "OMX.TI.DUCATI1.VIDEO.DECODER"
@@ -79,6 +84,8 @@
 
 #define CSD_POSITION    51 /*Codec Specific Data position on the "stream propierties object"(ASF spec)*/
 
+#define OMX_VIDEODECODER_OUTPUT_PORT 1
+
 typedef struct VIDDEC_WMV_RCV_struct {
     OMX_U32 nNumFrames : 24;
     OMX_U32 nFrameType : 8;
@@ -101,6 +108,252 @@ typedef struct VIDDEC_WMV_VC1_struct {
     OMX_U32 nSequenceHdr : 32;   //STRUCT_B
 } VIDDEC_WMV_VC1_struct;
 
+/* Lateness (us) at which non-reference frames are decoded without
+   deblocking, at which they are skipped, and below which both stop again */
+#define VIDDEC_LATE_DEBLOCK_OFF_US  40000
+#define VIDDEC_LATE_SKIP_US         80000
+#define VIDDEC_LATE_RECOVERED_US    10000
+
+typedef enum VIDDEC_SKIP_MODE {
+    VIDDEC_SkipNone = 0,
+    VIDDEC_SkipDeblockOff,
+    VIDDEC_SkipDecode
+} VIDDEC_SKIP_MODE;
+
+/* Decoder proxy state hung off pCompProxyPrv. The component role is fetched
+   from the remote side on the first codec config buffer and kept until the
+   client sets a new role */
+typedef struct OMX_PROXY_VIDDEC_PRIVATE {
+    OMX_BOOL bRoleValid;
+    OMX_BOOL bRoleWMV;
+    VIDDEC_SKIP_MODE eSkipMode;
+    OMX_BOOL bSkipRefused;
+    OMX_BOOL bThumbnail;
+    OMX_BOOL bSyncSeen;
+} OMX_PROXY_VIDDEC_PRIVATE;
+
+static OMX_PROXY_VIDDEC_PRIVATE *PROXY_VIDDEC_GetPrivate(
+    PROXY_COMPONENT_PRIVATE *pCompPrv)
+{
+    if (pCompPrv->pCompProxyPrv == NULL) {
+        pCompPrv->pCompProxyPrv =
+            TIMM_OSAL_Malloc(sizeof(OMX_PROXY_VIDDEC_PRIVATE), TIMM_OSAL_TRUE,
+            0, TIMMOSAL_MEM_SEGMENT_INT);
+        if (pCompPrv->pCompProxyPrv != NULL) {
+            TIMM_OSAL_Memset(pCompPrv->pCompProxyPrv, 0,
+                sizeof(OMX_PROXY_VIDDEC_PRIVATE));
+        }
+    }
+    return (OMX_PROXY_VIDDEC_PRIVATE *) pCompPrv->pCompProxyPrv;
+}
+
+void PROXY_VIDDEC_ResetCodecConfig(OMX_HANDLETYPE hComponent)
+{
+    OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+    PROXY_COMPONENT_PRIVATE *pCompPrv =
+        (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+    OMX_PROXY_VIDDEC_PRIVATE *pViddecPrv = NULL;
+
+    if (pCompPrv != NULL && pCompPrv->pCompProxyPrv != NULL) {
+        pViddecPrv = (OMX_PROXY_VIDDEC_PRIVATE *) pCompPrv->pCompProxyPrv;
+        pViddecPrv->bRoleValid = OMX_FALSE;
+    }
+}
+
+static OMX_BOOL PROXY_VIDDEC_IsRoleWMV(OMX_COMPONENTTYPE *hComp,
+    PROXY_COMPONENT_PRIVATE *pCompPrv)
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    OMX_PROXY_VIDDEC_PRIVATE *pViddecPrv = NULL;
+    OMX_PARAM_COMPONENTROLETYPE compRole;
+    OMX_BOOL bWMV = OMX_FALSE;
+
+    pViddecPrv = PROXY_VIDDEC_GetPrivate(pCompPrv);
+    if (pViddecPrv != NULL && pViddecPrv->bRoleValid) {
+        return pViddecPrv->bRoleWMV;
+    }
+
+    /* Get component role */
+    compRole.nSize = sizeof(OMX_PARAM_COMPONENTROLETYPE);
+    compRole.nVersion.s.nVersionMajor = 1;
+    compRole.nVersion.s.nVersionMinor = 1; //Ducati OMX version
+    compRole.nVersion.s.nRevision = 0;
+    compRole.nVersion.s.nStep = 0;
+
+    eError = PROXY_GetParameter(hComp, OMX_IndexParamStandardComponentRole, &compRole);
+    if(eError != OMX_ErrorNone){
+        DOMX_ERROR("Error getting OMX_IndexParamStandardComponentRole");
+        return OMX_FALSE;
+    }
+
+    compRole.cRole[OMX_MAX_STRINGNAME_SIZE - 1] = '\0';
+    bWMV = !strcmp((char *)(compRole.cRole), "video_decoder.wmv") ?
+        OMX_TRUE : OMX_FALSE;
+    if (pViddecPrv != NULL) {
+        pViddecPrv->bRoleWMV = bWMV;
+        pViddecPrv->bRoleValid = OMX_TRUE;
+    }
+    return bWMV;
+}
+
+/* Sends the decode effort for non-reference frames to the remote decoder.
+   A decoder that does not take OMX_TI_IndexConfigVideoDecodeSkip is not
+   asked again and just decodes everything */
+static void PROXY_VIDDEC_SetDecodeSkip(OMX_HANDLETYPE hComponent,
+    OMX_PROXY_VIDDEC_PRIVATE *pViddecPrv, VIDDEC_SKIP_MODE eMode)
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    OMX_TI_VIDEO_CONFIG_DECODESKIP tSkip;
+
+    if (pViddecPrv->bSkipRefused || eMode == pViddecPrv->eSkipMode) {
+        return;
+    }
+
+    tSkip.nSize = sizeof(OMX_TI_VIDEO_CONFIG_DECODESKIP);
+    tSkip.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+    tSkip.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+    tSkip.nVersion.s.nRevision = 0x0;
+    tSkip.nVersion.s.nStep = 0x0;
+    tSkip.nPortIndex = 0;
+    tSkip.bSkipNonRefFrames =
+        (eMode == VIDDEC_SkipDecode) ? OMX_TRUE : OMX_FALSE;
+    tSkip.bDeblockOffNonRefFrames =
+        (eMode != VIDDEC_SkipNone) ? OMX_TRUE : OMX_FALSE;
+
+    eError = PROXY_SetConfig(hComponent,
+        (OMX_INDEXTYPE) OMX_TI_IndexConfigVideoDecodeSkip, &tSkip);
+    if (eError != OMX_ErrorNone) {
+        DOMX_WARN("Decode skipping not available (0x%x)", eError);
+        pViddecPrv->bSkipRefused = OMX_TRUE;
+        return;
+    }
+    DOMX_DEBUG("Decode skip mode %d", eMode);
+    pViddecPrv->eSkipMode = eMode;
+}
+
+/* Turns the A/V sync lateness the client reports into how much work the
+   decoder spends on non-reference frames, nobody will see them on time
+   anyway. Deblocking goes off first, then the frames are skipped, and
+   full decoding comes back only once playback has caught up */
+OMX_ERRORTYPE PROXY_VIDDEC_SetLateness(OMX_HANDLETYPE hComponent,
+    OMX_TICKS nLateness)
+{
+    OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+    PROXY_COMPONENT_PRIVATE *pCompPrv =
+        (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+    OMX_PROXY_VIDDEC_PRIVATE *pViddecPrv = NULL;
+    VIDDEC_SKIP_MODE eMode;
+
+    pViddecPrv = PROXY_VIDDEC_GetPrivate(pCompPrv);
+    if (pViddecPrv == NULL) {
+        return OMX_ErrorInsufficientResources;
+    }
+    /* thumbnail mode skips all it can already */
+    if (pViddecPrv->bThumbnail) {
+        return OMX_ErrorNone;
+    }
+
+    eMode = pViddecPrv->eSkipMode;
+    if (nLateness >= VIDDEC_LATE_SKIP_US) {
+        eMode = VIDDEC_SkipDecode;
+    } else if (nLateness >= VIDDEC_LATE_DEBLOCK_OFF_US) {
+        if (eMode < VIDDEC_SkipDeblockOff) {
+            eMode = VIDDEC_SkipDeblockOff;
+        }
+    } else if (nLateness < VIDDEC_LATE_RECOVERED_US) {
+        eMode = VIDDEC_SkipNone;
+    }
+    if (eMode != pViddecPrv->eSkipMode) {
+        DOMX_DEBUG("Lateness %lld us", nLateness);
+        PROXY_VIDDEC_SetDecodeSkip(hComponent, pViddecPrv, eMode);
+    }
+    return OMX_ErrorNone;
+}
+
+/* Thumbnail extraction and seeking only need the first frame that can be
+   shown. The output port is trimmed to its minimum buffer count, which
+   only takes while the port is not populated yet, the remote decoder
+   skips non-reference frames and only sync frames are sent to it, see
+   PROXY_VIDDEC_DropForThumbnail(). Turning the mode off restores full
+   decoding but not the buffer count, the client sets that itself */
+OMX_ERRORTYPE PROXY_VIDDEC_SetThumbnailMode(OMX_HANDLETYPE hComponent,
+    OMX_BOOL bEnable)
+{
+    OMX_ERRORTYPE eError = OMX_ErrorNone;
+    OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+    PROXY_COMPONENT_PRIVATE *pCompPrv =
+        (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+    OMX_PROXY_VIDDEC_PRIVATE *pViddecPrv = NULL;
+    OMX_PARAM_PORTDEFINITIONTYPE tPortDef;
+
+    pViddecPrv = PROXY_VIDDEC_GetPrivate(pCompPrv);
+    if (pViddecPrv == NULL) {
+        return OMX_ErrorInsufficientResources;
+    }
+    pViddecPrv->bThumbnail = bEnable;
+    pViddecPrv->bSyncSeen = OMX_FALSE;
+    PROXY_VIDDEC_SetDecodeSkip(hComponent, pViddecPrv,
+        bEnable ? VIDDEC_SkipDecode : VIDDEC_SkipNone);
+    if (!bEnable) {
+        return OMX_ErrorNone;
+    }
+
+    TIMM_OSAL_Memset(&tPortDef, 0, sizeof(tPortDef));
+    tPortDef.nSize = sizeof(OMX_PARAM_PORTDEFINITIONTYPE);
+    tPortDef.nVersion.s.nVersionMajor = OMX_VER_MAJOR;
+    tPortDef.nVersion.s.nVersionMinor = OMX_VER_MINOR;
+    tPortDef.nPortIndex = OMX_VIDEODECODER_OUTPUT_PORT;
+    eError = PROXY_GetParameter(hComponent, OMX_IndexParamPortDefinition,
+        &tPortDef);
+    if (eError == OMX_ErrorNone &&
+        tPortDef.nBufferCountActual > tPortDef.nBufferCountMin) {
+        tPortDef.nBufferCountActual = tPortDef.nBufferCountMin;
+        eError = PROXY_SetParameter(hComponent, OMX_IndexParamPortDefinition,
+            &tPortDef);
+    }
+    if (eError != OMX_ErrorNone) {
+        DOMX_WARN("Output buffer count kept (0x%x)", eError);
+    }
+    return OMX_ErrorNone;
+}
+
+/* In thumbnail mode, input buffers that don't start at a sync frame are
+   handed back to the client undecoded. Nothing is dropped until the
+   client has flagged a sync frame, those that never flag any get every
+   frame decoded. Returns OMX_TRUE when pBufferHdr was given back */
+static OMX_BOOL PROXY_VIDDEC_DropForThumbnail(OMX_COMPONENTTYPE *hComp,
+    OMX_BUFFERHEADERTYPE *pBufferHdr)
+{
+    PROXY_COMPONENT_PRIVATE *pCompPrv =
+        (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+    OMX_PROXY_VIDDEC_PRIVATE *pViddecPrv = NULL;
+
+    if (pCompPrv != NULL) {
+        pViddecPrv = (OMX_PROXY_VIDDEC_PRIVATE *) pCompPrv->pCompProxyPrv;
+    }
+    if (pViddecPrv == NULL || !pViddecPrv->bThumbnail ||
+        (pBufferHdr->nFlags & OMX_BUFFERFLAG_CODECCONFIG)) {
+        return OMX_FALSE;
+    }
+    if (pBufferHdr->nFlags & OMX_BUFFERFLAG_SYNCFRAME) {
+        pViddecPrv->bSyncSeen = OMX_TRUE;
+        return OMX_FALSE;
+    }
+    if (!pViddecPrv->bSyncSeen) {
+        return OMX_FALSE;
+    }
+    if (pBufferHdr->nFlags & OMX_BUFFERFLAG_EOS) {
+        /* the EOS still has to get through, without the frame */
+        pBufferHdr->nFilledLen = 0;
+        return OMX_FALSE;
+    }
+
+    pBufferHdr->nFilledLen = 0;
+    pCompPrv->tCBFunc.EmptyBufferDone(hComp, pCompPrv->pILAppData,
+        pBufferHdr);
+    return OMX_TRUE;
+}
+
 
 OMX_ERRORTYPE PrearrageEmptyThisBuffer(OMX_HANDLETYPE hComponent,
     OMX_BUFFERHEADERTYPE * pBufferHdr)
@@ -120,24 +373,16 @@ OMX_ERRORTYPE PrearrageEmptyThisBuffer(OMX_HANDLETYPE hComponent,
 
     PROXY_assert(pBufferHdr != NULL, OMX_ErrorBadParameter, NULL);
 
+    if (PROXY_VIDDEC_DropForThumbnail(hComp, pBufferHdr)) {
+        return OMX_ErrorNone;
+    }
+
     if (pBufferHdr->nFlags & OMX_BUFFERFLAG_CODECCONFIG){
         PROXY_assert(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter, NULL);
 
         pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
-        /* Get component role */
-        OMX_PARAM_COMPONENTROLETYPE compRole;
-        compRole.nSize = sizeof(OMX_PARAM_COMPONENTROLETYPE);
-        compRole.nVersion.s.nVersionMajor = 1;
-        compRole.nVersion.s.nVersionMinor = 1; //Ducati OMX version
-        compRole.nVersion.s.nRevision = 0;
-        compRole.nVersion.s.nStep = 0;
-
-        eError = PROXY_GetParameter(hComp, OMX_IndexParamStandardComponentRole, &compRole);
-        if(eError != OMX_ErrorNone){
-            DOMX_ERROR("Error getting OMX_IndexParamStandardComponentRole");
-        }
 
-        if(!strcmp((char *)(compRole.cRole), "video_decoder.wmv")){
+        if(PROXY_VIDDEC_IsRoleWMV(hComp, pCompPrv)){
             pBuffer = pBufferHdr->pBuffer;
 
             VIDDEC_WMV_RCV_struct sStructRCV;
@@ -227,6 +472,54 @@ OMX_ERRORTYPE PrearrageEmptyThisBuffer(OMX_HANDLETYPE hComponent,
 * (5) Analyse on PC tools.
 */
 
+/* Frames waiting for the writer thread, each one is a full YUV420p copy */
+#define DUMP_QUEUE_DEPTH 4
+/* Jobs the writer takes per read, a full queue drains in one go */
+#define DUMP_READ_BATCH DUMP_QUEUE_DEPTH
+
+typedef struct DumpFrame_Job
+{
+	OMX_U8 *pData;		/* NULL asks the writer to exit */
+	OMX_U32 nSize;
+	OMX_S32 nFrame;
+} DumpFrame_Job;
+
+typedef struct DumpFrame_Writer
+{
+	TIMM_OSAL_PTR hQueue;
+	pthread_t tThread;
+	OMX_U32 nDropped;
+} DumpFrame_Writer;
+
+/*
+* Splits one interleaved UV row into its U and V rows
+*/
+static void deinterleaveUVRow(const uint8_t *pUV, uint8_t *pU, uint8_t *pV,
+                              int nPairs)
+{
+	int j = 0;
+
+#ifdef __ARM_NEON__
+	for(; j + 16 <= nPairs; j += 16)
+	{
+		uint8x16x2_t tUV = vld2q_u8(pUV + 2 * j);
+		vst1q_u8(pU + j, tUV.val[0]);
+		vst1q_u8(pV + j, tUV.val[1]);
+	}
+	for(; j + 8 <= nPairs; j += 8)
+	{
+		uint8x8x2_t tUV = vld2_u8(pUV + 2 * j);
+		vst1_u8(pU + j, tUV.val[0]);
+		vst1_u8(pV + j, tUV.val[1]);
+	}
+#endif
+	for(; j < nPairs; j++)
+	{
+		pU[j] = pUV[2 * j];
+		pV[j] = pUV[2 * j + 1];
+	}
+}
+
 /*
 * Method to convert NV12 to YUV420p for PC analysis
 */
@@ -236,7 +529,7 @@ static void convertNV12ToYuv420(DebugFrame_Dump *frameInfo, void *dst)
 	uint32_t ybuf_offset = frameInfo->frame_yoffset * stride + frameInfo->frame_xoffset;
 	uint8_t* p1y = (uint8_t*)frameInfo->y_uv[0] + ybuf_offset;
 	uint8_t* p2y = (uint8_t*) dst;
-	int i, j, j1;
+	int i;
 	int width = frameInfo->frame_width;
 	int height = frameInfo->frame_height;
 
@@ -266,54 +559,141 @@ static void convertNV12ToYuv420(DebugFrame_Dump *frameInfo, void *dst)
 	uint8_t* p2v = ((uint8_t*) p2u + ((width/2) * (height/2)));
 	for(i=0;(i < height/2);i++)
 	{
-		for(j=0,j1=0;(j< width/2);j++,j1+=2)
-		{
-			p2u[j] = p1uv[j1];
-			p2v[j] = p1uv[j1+1];
-		}
+		deinterleaveUVRow(p1uv, p2u, p2v, width/2);
 		p1uv+=stride;
 		p2u+=width/2;
 		p2v+=width/2;
 	}
 }
 
-void DumpVideoFrame(DebugFrame_Dump *frameInfo)
+static void writeVideoFrame(DumpFrame_Job *pJob)
 {
-	/* First convert the frame to 420p and then write to SD Card */
-	OMX_U32 framesize = (frameInfo->frame_width *
-                             frameInfo->frame_height * 3) / 2;
-	OMX_U8* localbuffer = malloc(framesize);
-	if (localbuffer == NULL)
-	{
-		DOMX_ERROR("NO HEAP");
-		goto EXIT;
-	}
-	convertNV12ToYuv420(frameInfo, localbuffer);
 	int filedes = -1;
 	char framenumber[100];
-	sprintf(framenumber, "/data/frame_%ld.txt", frameInfo->runningFrame);
+
+	sprintf(framenumber, "/data/frame_%ld.txt", pJob->nFrame);
 	DOMX_ERROR("file path %s",framenumber);
-	filedes = open(framenumber, O_CREAT | O_WRONLY | O_SYNC | O_TRUNC, 0777);
+	filedes = open(framenumber, O_CREAT | O_WRONLY | O_TRUNC, 0777);
 	if(filedes < 0)
 	{
 		DOMX_ERROR("\n!!!!!!!!!Error in file open!!!!!!!! [%d][%s]\n", filedes, strerror(errno));
-		goto EXIT;
+		return;
 	}
-	int ret = write (filedes, (void*)localbuffer, framesize);
-	if (ret < (int)framesize)
+	int ret = write (filedes, (void*)pJob->pData, pJob->nSize);
+	if (ret < (int)pJob->nSize)
 	{
 		DOMX_ERROR("File Write Failed");
 	}
-EXIT:
-	if (localbuffer)
+	close(filedes);
+}
+
+/*
+* Writes queued frames out, the file I/O stays off the FillBufferDone path
+*/
+static void *DumpFrameWriterThread(void *pArg)
+{
+	DumpFrame_Writer *pWriter = (DumpFrame_Writer *) pArg;
+	DumpFrame_Job aJobs[DUMP_READ_BATCH];
+	TIMM_OSAL_U32 nJobs = 0, i = 0;
+
+	/* A burst of frames is taken off the queue in one read */
+	while (TIMM_OSAL_ReadManyFromPipe(pWriter->hQueue, aJobs,
+	    sizeof(DumpFrame_Job), DUMP_READ_BATCH, &nJobs,
+	    TIMM_OSAL_SUSPEND) == TIMM_OSAL_ERR_NONE)
+	{
+		for (i = 0; i < nJobs; i++)
+		{
+			if (aJobs[i].pData == NULL)
+				return NULL;
+			writeVideoFrame(&aJobs[i]);
+			free(aJobs[i].pData);
+		}
+	}
+	return NULL;
+}
+
+static DumpFrame_Writer *getDumpFrameWriter(DebugFrame_Dump *frameInfo)
+{
+	DumpFrame_Writer *pWriter = (DumpFrame_Writer *) frameInfo->hWriter;
+
+	if (pWriter != NULL)
+		return pWriter;
+
+	pWriter = calloc(1, sizeof(DumpFrame_Writer));
+	if (pWriter == NULL)
+		return NULL;
+	if (TIMM_OSAL_CreatePipeEx(&pWriter->hQueue, DUMP_QUEUE_DEPTH,
+	    sizeof(DumpFrame_Job), OMX_TRUE,
+	    TIMM_OSAL_PIPE_BACKEND_MAILBOX) != TIMM_OSAL_ERR_NONE)
+	{
+		free(pWriter);
+		return NULL;
+	}
+	if (pthread_create(&pWriter->tThread, NULL, DumpFrameWriterThread,
+	    pWriter) != 0)
+	{
+		TIMM_OSAL_DeletePipe(pWriter->hQueue);
+		free(pWriter);
+		return NULL;
+	}
+	frameInfo->hWriter = pWriter;
+	return pWriter;
+}
+
+void DumpVideoFrame(DebugFrame_Dump *frameInfo)
+{
+	/* Convert the frame to 420p while the buffer is locked, the writer
+	 * thread puts it on the SD Card */
+	DumpFrame_Writer *pWriter = getDumpFrameWriter(frameInfo);
+	DumpFrame_Job tJob;
+
+	if (pWriter == NULL)
 	{
-		free(localbuffer);
-		localbuffer = NULL;
+		DOMX_ERROR("Frame dump writer not available");
+		return;
 	}
-	if (filedes > 0)
+	tJob.nSize = (frameInfo->frame_width *
+                      frameInfo->frame_height * 3) / 2;
+	tJob.nFrame = frameInfo->runningFrame;
+	tJob.pData = malloc(tJob.nSize);
+	if (tJob.pData == NULL)
 	{
-		close(filedes);
+		DOMX_ERROR("NO HEAP");
+		return;
 	}
+	convertNV12ToYuv420(frameInfo, tJob.pData);
+
+	/* Rather lose a frame than change the decode timing being debugged */
+	if (TIMM_OSAL_WriteToPipe(pWriter->hQueue, &tJob, sizeof(tJob),
+	    TIMM_OSAL_NO_SUSPEND) != TIMM_OSAL_ERR_NONE)
+	{
+		pWriter->nDropped++;
+		DOMX_ERROR("Dump queue full, frame %ld dropped (%u so far)",
+		           tJob.nFrame, pWriter->nDropped);
+		free(tJob.pData);
+	}
+}
+
+/*
+* Flushes the frames still queued and stops the writer thread
+*/
+void DumpVideoFrameDeinit(DebugFrame_Dump *frameInfo)
+{
+	DumpFrame_Writer *pWriter = (DumpFrame_Writer *) frameInfo->hWriter;
+	DumpFrame_Job tJob;
+
+	if (pWriter == NULL)
+		return;
+
+	tJob.pData = NULL;
+	tJob.nSize = 0;
+	tJob.nFrame = 0;
+	TIMM_OSAL_WriteToPipe(pWriter->hQueue, &tJob, sizeof(tJob),
+	    TIMM_OSAL_SUSPEND);
+	pthread_join(pWriter->tThread, NULL);
+	TIMM_OSAL_DeletePipe(pWriter->hQueue);
+	free(pWriter);
+	frameInfo->hWriter = NULL;
 }
 
 #endif
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ *  @file  omx_proxy_colorconvert.h
+ *         Colour conversion engine shared by the encoder proxies for opaque
+ *         (RGB) gralloc input. It owns the gralloc client, a process wide
+ *         pool of NV12 scratch buffers and the Blit2/NEON conversion of
+ *         opaque frames into them.
+ *
+ *  @path WTSD_DucatiMMSW\omx\omx_il_1_x\omx_proxy_component\omx_video_enc\inc
+ *
+ *  @rev 1.0
+ */
+
+#ifndef OMX_PROXY_COLORCONVERT_H
+#define OMX_PROXY_COLORCONVERT_H
+
+#include <hal_public.h>
+#include "omx_proxy_common.h"
+
+#define COLORCONVERT_MAX_SUB_BUFFERS (3)
+
+#define COLORCONVERT_BUFTYPE_VIRTUAL (0x0)
+#define COLORCONVERT_BUFTYPE_ION     (0x1)
+#define COLORCONVERT_BUFTYPE_GRALLOCOPAQUE (0x2)
+
+/* NV12 scratch buffers shared by all encoders of the process */
+#define COLORCONVERT_POOL_SIZE (16)
+
+/* Property selecting the opaque to NV12 backend: "gpu" (gralloc Blit2,
+ * default) or "neon" */
+#define COLORCONVERT_BACKEND_PROPERTY "debug.domx.colorconvert"
+
+/* Number of bands a frame is split into, one thread per band */
+#define COLORCONVERT_NEON_THREADS (2)
+
+/* Mask of the CPUs the band threads may run on, 0 (default) allows all */
+#define COLORCONVERT_NEON_CPUS_PROPERTY "debug.domx.colorconvert_cpus"
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_open()
+ * @brief Registers an encoder proxy with the engine. The first client opens
+ *        the gralloc module and allocator. The proxy EmptyBufferDone is
+ *        hooked so the NV12 buffer of a frame goes back to the pool when the
+ *        encoder is done with it. Does nothing if *hCC is already open.
+ * @param hCC      : [out] engine handle of the proxy
+ *        pCompPrv : proxy private of the encoder
+ * @return 0 on success
+ */
+/* ===========================================================================*/
+int COLORCONVERT_open(void **hCC, PROXY_COMPONENT_PRIVATE *pCompPrv);
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_PlatformOpaqueToNV12()
+ * @brief Converts an opaque gralloc buffer into NV12, with the backend chosen
+ *        by COLORCONVERT_BACKEND_PROPERTY.
+ * @return 0 on success
+ */
+/* ===========================================================================*/
+int COLORCONVERT_PlatformOpaqueToNV12(void *hCC,
+				      void *pSrc[COLORCONVERT_MAX_SUB_BUFFERS],
+				      void *pDst[COLORCONVERT_MAX_SUB_BUFFERS],
+				      int nWidth, int nHeight, int nStride,
+				      int nSrcBufType, int nDstBufType);
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_AcquireBuffer()
+ * @brief Takes an NV12 buffer from the pool for the frame carried by
+ *        pBufferHdr, allocating one if no idle buffer of the input port 2D
+ *        allocation dimension is left. The buffer stays with pBufferHdr until
+ *        its EmptyBufferDone or COLORCONVERT_ReleaseBuffer().
+ * @param hCC        : engine handle of the proxy
+ *        hComponent : encoder proxy handle
+ *        pBufferHdr : input buffer header the frame is queued with
+ *        ppNV12     : [out] NV12 gralloc buffer to convert into
+ * @return OMX_ErrorNone on success
+ */
+/* ===========================================================================*/
+OMX_ERRORTYPE COLORCONVERT_AcquireBuffer(void *hCC, OMX_HANDLETYPE hComponent,
+					 OMX_BUFFERHEADERTYPE *pBufferHdr,
+					 IMG_native_handle_t **ppNV12);
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_ReleaseBuffer()
+ * @brief Returns the NV12 buffer held for pBufferHdr to the pool, if any.
+ */
+/* ===========================================================================*/
+void COLORCONVERT_ReleaseBuffer(void *hCC, OMX_BUFFERHEADERTYPE *pBufferHdr);
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_close()
+ * @brief Unregisters the proxy. Idle buffers no other client can use are
+ *        freed, the last client also closes the gralloc allocator.
+ * @return 0 on success
+ */
+/* ===========================================================================*/
+int COLORCONVERT_close(void *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv);
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_NEON_IsSelected()
+ * @brief Tells whether the CPU backend was selected. The property is read
+ *        once per process.
+ * @return 1 if selected, 0 otherwise
+ */
+/* ===========================================================================*/
+int COLORCONVERT_NEON_IsSelected(void);
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_NEON_OpaqueToNV12()
+ * @brief Converts an RGBA/RGBX/BGRA gralloc buffer into a TI NV12 gralloc
+ *        buffer on the CPU (BT.601, limited range).
+ * @param module  : gralloc module used to lock both buffers
+ *        pSrc    : source buffer, 32 bit RGB format
+ *        pDst    : destination buffer, HAL_PIXEL_FORMAT_TI_NV12
+ *        nWidth  : width of the frame in pixels
+ *        nHeight : height of the frame in lines
+ *        nStride : line stride of the destination Y and UV planes in bytes
+ * @return 0 on success, -1 if the source format is not handled or a buffer
+ *         could not be locked - the caller should fall back to Blit2
+ */
+/* ===========================================================================*/
+int COLORCONVERT_NEON_OpaqueToNV12(IMG_gralloc_module_public_t const *module,
+				   IMG_native_handle_t *pSrc,
+				   IMG_native_handle_t *pDst,
+				   int nWidth, int nHeight, int nStride);
+
+#endif
@@ -73,25 +73,19 @@
 #include <VideoMetadata.h>
 #endif
 
-#define OMX_ENC_NUM_INTERNAL_BUF (8)
 /**
  * struct OMX_PROXY_ENCODER_PRIVATE: this struct contains all data elements specific
  *                                   to PROXY ENCODER components.
  *
- * @param hBufPipe: handle to local buffer pipe
  * @param bAndroidOpaqueFormat: boolean that indicates if AndroidOpaqueFormat is set
- * @param hCC: context handle
- * @param gralloc_handle: handles of local gralloc buffers allocated
- * @param nCurBufIndex: current buffer index
- * @param mAllocDev: Local gralloc client
+ * @param hCC: colour conversion engine client, NV12 buffers come from its pool
+ * @param tLowLatency: low latency profile the client asked for, applied on
+ *                     the next Loaded to Idle transition
  *
  *  */
 typedef struct OMX_PROXY_ENCODER_PRIVATE
 {
-	OMX_PTR  hBufPipe;
 	OMX_BOOL bAndroidOpaqueFormat;
 	OMX_PTR  hCC;
-	IMG_native_handle_t* gralloc_handle[OMX_ENC_NUM_INTERNAL_BUF];
-	OMX_S32  nCurBufIndex;
-	alloc_device_t* mAllocDev;
+	OMX_TI_VIDEO_PARAM_LOWLATENCY tLowLatency;
 }OMX_PROXY_ENCODER_PRIVATE;
@@ -75,6 +75,9 @@
 #include <hal_public.h>
 #include <VideoMetadata.h>
 #endif
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+#include "omx_proxy_colorconvert.h"
+#endif
 
 #include <stdlib.h>
 #include <cutils/properties.h>
@@ -83,8 +86,14 @@
 /* needs to be specific for every configuration wrapper */
 
 #define OMX_H264E_INPUT_PORT 0
+#define OMX_H264E_OUTPUT_PORT 1
 #define LINUX_PAGE_SIZE 4096
 
+/* Low latency profile defaults: a full intra refresh per second of video,
+   a VBV of 200 ms and slices that fit an ethernet MTU */
+#define H264E_LOWLATENCY_VBV_MS 200
+#define H264E_LOWLATENCY_SLICE_BYTES 1400
+
 #ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
 
 OMX_ERRORTYPE LOCAL_PROXY_H264E_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
@@ -93,6 +102,9 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 OMX_ERRORTYPE LOCAL_PROXY_H264E_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
     OMX_IN OMX_INDEXTYPE nParamIndex, OMX_INOUT OMX_PTR pParamStruct);
 
+static OMX_ERRORTYPE LOCAL_PROXY_H264E_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_COMMANDTYPE eCmd, OMX_IN OMX_U32 nParam, OMX_IN OMX_PTR pCmdData);
+
 #endif
 
 
@@ -120,22 +132,8 @@ OMX_U16 nBFrames = 0; /* Number of B Frames in H264 Encoder */
  * ENABLE_GRALLOC_BUFFER
  * ANDROID_QUIRCK_CHANGE_PORT_VALUES
  */
-#define OMX_H264VE_NUM_INTERNAL_BUF (8)
 #define HAL_PIXEL_FORMAT_TI_NV12 (0x100)
 
-#define COLORCONVERT_MAX_SUB_BUFFERS (3)
-
-#define COLORCONVERT_BUFTYPE_VIRTUAL (0x0)
-#define COLORCONVERT_BUFTYPE_ION     (0x1)
-#define COLORCONVERT_BUFTYPE_GRALLOCOPAQUE (0x2)
-
-int COLORCONVERT_open(void **hCC, PROXY_COMPONENT_PRIVATE *pCompPrv);
-int COLORCONVERT_PlatformOpaqueToNV12(void *hCC, void *pSrc[],
-				      void *pDst[], int nWidth,
-				      int nHeight, int nStride,
-				      int nSrcBufType, int nDstBufType);
-int COLORCONVERT_close(void *hCC,PROXY_COMPONENT_PRIVATE *pCompPrv);
-static int COLORCONVERT_AllocateBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nStride);
 static OMX_ERRORTYPE LOCAL_PROXY_H264E_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
     OMX_INOUT OMX_BUFFERHEADERTYPE ** ppBufferHdr, OMX_IN OMX_U32 nPortIndex,
     OMX_IN OMX_PTR pAppPrivate, OMX_IN OMX_U32 nSizeBytes);
@@ -143,8 +141,6 @@ static OMX_ERRORTYPE LOCAL_PROXY_H264E_AllocateBuffer(OMX_IN OMX_HANDLETYPE hCom
 static OMX_ERRORTYPE LOCAL_PROXY_H264E_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
     OMX_IN OMX_U32 nPortIndex, OMX_IN OMX_BUFFERHEADERTYPE * pBufferHdr);
 
-static OMX_ERRORTYPE LOCAL_PROXY_H264E_ComponentDeInit(OMX_HANDLETYPE hComponent);
-
 extern RPC_OMX_ERRORTYPE RPC_RegisterBuffer(OMX_HANDLETYPE hRPCCtx, int fd1, int fd2,
 				     OMX_PTR *handle1, OMX_PTR *handle2,
 				     PROXY_BUFFER_TYPE proxyBufferType);
@@ -152,6 +148,8 @@ extern RPC_OMX_ERRORTYPE RPC_UnRegisterBuffer(OMX_HANDLETYPE hRPCCtx, OMX_PTR ha
 										OMX_PTR handle2, PROXY_BUFFER_TYPE proxyBufferType);
 #endif
 
+static OMX_ERRORTYPE LOCAL_PROXY_H264E_ComponentDeInit(OMX_HANDLETYPE hComponent);
+
 
 OMX_ERRORTYPE LOCAL_PROXY_H264E_GetExtensionIndex(OMX_IN OMX_HANDLETYPE hComponent,
     OMX_IN OMX_STRING cParameterName, OMX_OUT OMX_INDEXTYPE * pIndexType);
@@ -292,10 +290,7 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	PROXY_COMPONENT_PRIVATE *pComponentPrivate = NULL;
 	pHandle = (OMX_COMPONENTTYPE *) hComponent;
         OMX_TI_PARAM_ENHANCEDPORTRECONFIG tParamStruct;
-#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-#endif
 	char value[OMX_MAX_STRINGNAME_SIZE];
 	OMX_U32 mEnableVFR = 1; /* Flag used to enable/disable VFR for Encoder */
 	property_get("debug.vfr.enable", value, "1");
@@ -328,7 +323,6 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	    OMX_ErrorInsufficientResources,
 	    " Error in Allocating space for proxy component table");
 
-#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
 	pComponentPrivate->pCompProxyPrv =
 	    (OMX_PROXY_ENCODER_PRIVATE *)
 	    TIMM_OSAL_Malloc(sizeof(OMX_PROXY_ENCODER_PRIVATE), TIMM_OSAL_TRUE,
@@ -343,14 +337,6 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 
 	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pComponentPrivate->pCompProxyPrv;
 
-	/* Create Pipe of for encoder input buffers */
-	eOSALStatus = TIMM_OSAL_CreatePipe(&pProxy->hBufPipe, sizeof(OMX_U32),
-					   OMX_H264VE_NUM_INTERNAL_BUF, 1);
-	PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE,
-			OMX_ErrorInsufficientResources,
-			"Pipe creation failed");
-#endif
-
 	// Copying component Name - this will be picked up in the proxy common
 	PROXY_assert(strlen(COMPONENT_NAME) + 1 < MAX_COMPONENT_NAME_LENGTH,
 	    OMX_ErrorInvalidComponentName,
@@ -359,16 +345,22 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	    strlen(COMPONENT_NAME) + 1);
 
 	eError = OMX_ProxyCommonInit(hComponent);	// Calling Proxy Common Init()
+	/* Rate control retuning goes out with the next frame */
+	if( eError == OMX_ErrorNone &&
+		PROXY_EnableConfigQueue(hComponent) != OMX_ErrorNone ) {
+		DOMX_WARN("No config queue, SetConfig stays synchronous");
+	}
 #ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
 	pHandle->SetParameter = LOCAL_PROXY_H264E_SetParameter;
     pHandle->GetParameter = LOCAL_PROXY_H264E_GetParameter;
+	pHandle->SendCommand = LOCAL_PROXY_H264E_SendCommand;
 #endif
 	pComponentPrivate->IsLoadedState = OMX_TRUE;
 	pHandle->EmptyThisBuffer = LOCAL_PROXY_H264E_EmptyThisBuffer;
 	pHandle->GetExtensionIndex = LOCAL_PROXY_H264E_GetExtensionIndex;
+	pHandle->ComponentDeInit = LOCAL_PROXY_H264E_ComponentDeInit;
 
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-	pHandle->ComponentDeInit = LOCAL_PROXY_H264E_ComponentDeInit;
 	pHandle->FreeBuffer = LOCAL_PROXY_H264E_FreeBuffer;
 	pHandle->AllocateBuffer = LOCAL_PROXY_H264E_AllocateBuffer;
 #endif
@@ -381,20 +373,12 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	{
 		DOMX_DEBUG("Error in Initializing Proxy");
 
-#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-		if(pProxy->hBufPipe != NULL)
-		{
-			TIMM_OSAL_DeletePipe(pProxy->hBufPipe);
-			pProxy->hBufPipe = NULL;
-		}
-
 		if(pComponentPrivate->pCompProxyPrv != NULL)
 		{
 			TIMM_OSAL_Free(pComponentPrivate->pCompProxyPrv);
 			pComponentPrivate->pCompProxyPrv = NULL;
 			pProxy = NULL;
 		}
-#endif
 		if (pComponentPrivate->cCompName != NULL)
 		{
 			TIMM_OSAL_Free(pComponentPrivate->cCompName);
@@ -446,6 +430,17 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_GetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	    ("hComponent = %p, pCompPrv = %p, nParamIndex = %d, pParamStruct = %p",
 	    hComponent, pCompPrv, nParamIndex, pParamStruct);
 
+	/* Kept by the proxy until the component goes to Idle */
+	if(nParamIndex == (OMX_INDEXTYPE) OMX_TI_IndexParamVideoLowLatency)
+	{
+		TIMM_OSAL_Memcpy(pParamStruct,
+		    &((OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv)->tLowLatency,
+		    sizeof(OMX_TI_VIDEO_PARAM_LOWLATENCY));
+		((OMX_TI_VIDEO_PARAM_LOWLATENCY *) pParamStruct)->nPortIndex =
+		    OMX_H264E_OUTPUT_PORT;
+		goto EXIT;
+	}
+
 	eError = PROXY_GetParameter(hComponent,nParamIndex, pParamStruct);
 
 	if(nParamIndex == OMX_IndexParamPortDefinition)
@@ -536,6 +531,7 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	OMX_VIDEO_STOREMETADATAINBUFFERSPARAMS* pStoreMetaData = NULL;
 	OMX_TI_PARAM_BUFFERPREANNOUNCE tParamSetNPA;
 	OMX_PARAM_PORTDEFINITIONTYPE sPortDef;
+	OMX_VIDEO_PARAM_DATASYNCMODETYPE *pDataSync = NULL;
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
 #endif
@@ -595,6 +591,16 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 		}
 #endif
 	}
+	else if(nParamIndex == (OMX_INDEXTYPE) OMX_TI_IndexParamVideoLowLatency)
+	{
+		PROXY_require(pCompPrv->eState == OMX_StateLoaded,
+		    OMX_ErrorIncorrectStateOperation,
+		    "Low latency profile can only be set in Loaded");
+		TIMM_OSAL_Memcpy(
+		    &((OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv)->tLowLatency,
+		    pParamStruct, sizeof(OMX_TI_VIDEO_PARAM_LOWLATENCY));
+		goto EXIT;
+	}
 	else if(nParamIndex == (OMX_INDEXTYPE) OMX_TI_IndexEncoderStoreMetadatInBuffers)
 	{
 		pStoreMetaData = (OMX_VIDEO_STOREMETADATAINBUFFERSPARAMS *) pParamStruct;
@@ -638,6 +644,172 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_SetParameter(OMX_IN OMX_HANDLETYPE hComponent,
 	PROXY_assert(eError == OMX_ErrorNone,
 		    eError," Error in Proxy SetParameter");
 
+	/* In slice mode the encoder fills the output buffer a slice at a
+	   time, each one is passed on as OMX_TI_EventPartialFrame so it can
+	   go out before the frame is complete */
+	if(nParamIndex == (OMX_INDEXTYPE) OMX_TI_IndexParamVideoDataSyncMode)
+	{
+		pDataSync = (OMX_VIDEO_PARAM_DATASYNCMODETYPE *) pParamStruct;
+		if(pDataSync->nPortIndex == OMX_H264E_OUTPUT_PORT)
+		{
+			pCompPrv->proxyPortBuffers[OMX_H264E_OUTPUT_PORT].bPartialFrames =
+				(pDataSync->eDataMode == OMX_Video_EntireFrame) ? OMX_FALSE : OMX_TRUE;
+		}
+	}
+
+	EXIT:
+	DOMX_EXIT("eError: %d", eError);
+	return eError;
+}
+
+/* ===========================================================================*/
+/**
+ * @name LOCAL_PROXY_H264E_SetLowLatency()
+ * @brief Applies the low latency profile. Encoders that know
+ *        OMX_TI_IndexParamVideoLowLatency take it in a single exchange,
+ *        others get the same settings one parameter at a time.
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE LOCAL_PROXY_H264E_SetLowLatency(OMX_HANDLETYPE hComponent,
+    PROXY_COMPONENT_PRIVATE *pCompPrv, OMX_TI_VIDEO_PARAM_LOWLATENCY *pLowLatency)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_PARAM_PORTDEFINITIONTYPE tPortDef;
+	OMX_VIDEO_PARAM_BITRATETYPE tBitrate;
+	OMX_VIDEO_PARAM_AVCTYPE tAvc;
+	OMX_VIDEO_CONFIG_AVCINTRAPERIOD tIntraPeriod;
+	OMX_TI_VIDEO_PARAM_INTRAREFRESHTYPE tIntraRefresh;
+	OMX_TI_VIDEO_PARAM_AVCHRDBUFFERSETTING tHrd;
+	OMX_VIDEO_CONFIG_SLICECODINGTYPE tSlice;
+	OMX_VIDEO_PARAM_DATASYNCMODETYPE tDataSync;
+	OMX_U32 nVbvBits = 0;
+
+	OMX_INIT_STRUCT(tPortDef, OMX_PARAM_PORTDEFINITIONTYPE);
+	tPortDef.nPortIndex = OMX_H264E_OUTPUT_PORT;
+	eError = PROXY_GetParameter(hComponent, OMX_IndexParamPortDefinition, &tPortDef);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy GetParameter for Port Def");
+
+	OMX_INIT_STRUCT(tBitrate, OMX_VIDEO_PARAM_BITRATETYPE);
+	tBitrate.nPortIndex = OMX_H264E_OUTPUT_PORT;
+	eError = PROXY_GetParameter(hComponent, OMX_IndexParamVideoBitrate, &tBitrate);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy GetParameter for Bitrate");
+
+	pLowLatency->nSize = sizeof(OMX_TI_VIDEO_PARAM_LOWLATENCY);
+	pLowLatency->nPortIndex = OMX_H264E_OUTPUT_PORT;
+	if(pLowLatency->nIntraRefreshRate == 0)
+	{
+		pLowLatency->nIntraRefreshRate = tPortDef.format.video.xFramerate >> 16;
+		if(pLowLatency->nIntraRefreshRate == 0)
+			pLowLatency->nIntraRefreshRate = 30;
+	}
+	if(pLowLatency->nVbvMs == 0)
+		pLowLatency->nVbvMs = H264E_LOWLATENCY_VBV_MS;
+	if(pLowLatency->nSliceSize == 0)
+		pLowLatency->nSliceSize = H264E_LOWLATENCY_SLICE_BYTES;
+
+	/* One exchange with an encoder that knows the whole profile */
+	if(PROXY_SetParameter(hComponent, (OMX_INDEXTYPE) OMX_TI_IndexParamVideoLowLatency,
+	    pLowLatency) == OMX_ErrorNone)
+		goto SLICES;
+	DOMX_DEBUG("Low latency profile not known remotely, setting it up one by one");
+
+	OMX_INIT_STRUCT(tAvc, OMX_VIDEO_PARAM_AVCTYPE);
+	tAvc.nPortIndex = OMX_H264E_OUTPUT_PORT;
+	eError = PROXY_GetParameter(hComponent, OMX_IndexParamVideoAvc, &tAvc);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy GetParameter for AVC");
+	tAvc.nBFrames = 0;
+	tAvc.nAllowedPictureTypes &= ~OMX_VIDEO_PictureTypeB;
+	eError = PROXY_SetParameter(hComponent, OMX_IndexParamVideoAvc, &tAvc);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy SetParameter for AVC");
+	nBFrames = 0;
+
+	/* IDR period 0: only the first frame is an IDR, the refresh below
+	   takes over from there */
+	OMX_INIT_STRUCT(tIntraPeriod, OMX_VIDEO_CONFIG_AVCINTRAPERIOD);
+	tIntraPeriod.nPortIndex = OMX_H264E_OUTPUT_PORT;
+	tIntraPeriod.nIDRPeriod = 0;
+	tIntraPeriod.nPFrames = tAvc.nPFrames;
+	eError = PROXY_SetConfig(hComponent, OMX_IndexConfigVideoAVCIntraPeriod, &tIntraPeriod);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy SetConfig for Intra Period");
+
+	OMX_INIT_STRUCT(tIntraRefresh, OMX_TI_VIDEO_PARAM_INTRAREFRESHTYPE);
+	tIntraRefresh.nPortIndex = OMX_H264E_OUTPUT_PORT;
+	tIntraRefresh.eRefreshMode = OMX_TI_VIDEO_IntraRefreshCyclicRows;
+	tIntraRefresh.nIntraRefreshRate = pLowLatency->nIntraRefreshRate;
+	eError = PROXY_SetParameter(hComponent,
+	    (OMX_INDEXTYPE) OMX_TI_IndexParamVideoIntraRefresh, &tIntraRefresh);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy SetParameter for Intra Refresh");
+
+	tBitrate.eControlRate = OMX_Video_ControlRateConstant;
+	eError = PROXY_SetParameter(hComponent, OMX_IndexParamVideoBitrate, &tBitrate);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy SetParameter for Bitrate");
+
+	nVbvBits = (OMX_U32) ((OMX_U64) tBitrate.nTargetBitrate * pLowLatency->nVbvMs / 1000);
+	OMX_INIT_STRUCT(tHrd, OMX_TI_VIDEO_PARAM_AVCHRDBUFFERSETTING);
+	tHrd.nPortIndex = OMX_H264E_OUTPUT_PORT;
+	tHrd.nInitialBufferLevel = nVbvBits;
+	tHrd.nHRDBufferSize = nVbvBits;
+	tHrd.nTargetBitrate = tBitrate.nTargetBitrate;
+	eError = PROXY_SetParameter(hComponent,
+	    (OMX_INDEXTYPE) OMX_TI_IndexParamAVCHRDBufferSizeSetting, &tHrd);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy SetParameter for HRD buffer");
+
+	OMX_INIT_STRUCT(tSlice, OMX_VIDEO_CONFIG_SLICECODINGTYPE);
+	tSlice.nPortIndex = OMX_H264E_OUTPUT_PORT;
+	tSlice.eSliceMode = OMX_VIDEO_SLICEMODE_AVCByteSlice;
+	tSlice.nSlicesize = pLowLatency->nSliceSize;
+	eError = PROXY_SetConfig(hComponent, (OMX_INDEXTYPE) OMX_TI_IndexConfigSliceSettings, &tSlice);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy SetConfig for Slice Settings");
+
+	OMX_INIT_STRUCT(tDataSync, OMX_VIDEO_PARAM_DATASYNCMODETYPE);
+	tDataSync.nPortIndex = OMX_H264E_OUTPUT_PORT;
+	tDataSync.eDataMode = OMX_Video_SliceMode;
+	tDataSync.nNumDataUnits = 1;
+	eError = PROXY_SetParameter(hComponent,
+	    (OMX_INDEXTYPE) OMX_TI_IndexParamVideoDataSyncMode, &tDataSync);
+	PROXY_assert(eError == OMX_ErrorNone, eError, "Error in Proxy SetParameter for Data Sync Mode");
+
+SLICES:
+	/* Each slice is passed on as OMX_TI_EventPartialFrame */
+	pCompPrv->proxyPortBuffers[OMX_H264E_OUTPUT_PORT].bPartialFrames = OMX_TRUE;
+
+	EXIT:
+	return eError;
+}
+
+/* ===========================================================================*/
+/**
+ * @name LOCAL_PROXY_H264E_SendCommand()
+ * @brief Sets up the low latency profile, if the client asked for it, right
+ *        before the component leaves Loaded.
+ * @return OMX_ErrorNone = Successful
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE LOCAL_PROXY_H264E_SendCommand(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_COMMANDTYPE eCmd, OMX_IN OMX_U32 nParam, OMX_IN OMX_PTR pCmdData)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
+
+	PROXY_require((hComp->pComponentPrivate != NULL),
+	    OMX_ErrorBadParameter, NULL);
+	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
+
+	if(eCmd == OMX_CommandStateSet && (OMX_STATETYPE) nParam == OMX_StateIdle &&
+	    pCompPrv->eState == OMX_StateLoaded && pProxy->tLowLatency.bEnable)
+	{
+		eError = LOCAL_PROXY_H264E_SetLowLatency(hComponent, pCompPrv,
+		    &pProxy->tLowLatency);
+		PROXY_assert(eError == OMX_ErrorNone, eError,
+		    "Low latency profile could not be set up");
+	}
+
+	eError = PROXY_SendCommand(hComponent, eCmd, nParam, pCmdData);
+
 	EXIT:
 	DOMX_EXIT("eError: %d", eError);
 	return eError;
@@ -686,6 +858,11 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_GetExtensionIndex(OMX_IN OMX_HANDLETYPE hCompone
 		*pIndexType = (OMX_INDEXTYPE) OMX_TI_IndexEncoderStoreMetadatInBuffers;
 		goto EXIT;
 	}
+	if(strcmp(cParameterName, "OMX.TI.index.param.video.lowlatency") == 0)
+	{
+		*pIndexType = (OMX_INDEXTYPE) OMX_TI_IndexParamVideoLowLatency;
+		goto EXIT;
+	}
 
         eError = PROXY_GetExtensionIndex(hComponent, cParameterName, pIndexType);
 
@@ -717,8 +894,8 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	OMX_U32 nFilledLen, nAllocLen;
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
-	OMX_U32 nBufIndex = 0, nSize=0, nRet=0;
+	IMG_native_handle_t *pNV12Handle = NULL;
+	OMX_U32 nRet=0;
 #endif
 #ifdef ENABLE_GRALLOC_BUFFER
 	OMX_PTR pAuxBuf0 = NULL, pAuxBuf1 = NULL;
@@ -744,7 +921,7 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	tParamStruct.nVersion.s.nStep = 0x0;
 	tParamStruct.nPortIndex = OMX_H264E_INPUT_PORT;
 
-	eError = PROXY_GetParameter(hComponent, OMX_IndexParamPortDefinition, &tParamStruct);
+	eError = PROXY_GetCachedPortDefinition(hComponent, &tParamStruct);
 	PROXY_require(eError == OMX_ErrorNone, OMX_ErrorBadParameter, "Error is Get Parameter for port def");
 	nFilledLen = pBufferHdr->nFilledLen;
 	nAllocLen = pBufferHdr->nAllocLen;
@@ -779,16 +956,6 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 			pVideoMetadataBuffer = (video_metadata_t*) ((OMX_U32 *)(pBufferHdr->pBuffer));
 			pGrallocHandle = (IMG_native_handle_t*) (pVideoMetadataBuffer->handle);
 			DOMX_DEBUG("Grallloc buffer recieved in metadata buffer 0x%x",pGrallocHandle );
-                        if( pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12 && pProxy->gralloc_handle[0] == NULL ) {
-                            DOMX_DEBUG("Allocating NV12 buffers internally within DOMX actual count: %d", pCompPrv->nAllocatedBuffers);
-                            pProxy->nCurBufIndex = 0;
-
-                            while( (unsigned) pProxy->nCurBufIndex < pCompPrv->nAllocatedBuffers ) {
-                                   eError = COLORCONVERT_AllocateBuffer(hComponent, nStride);
-                                   PROXY_require(eError == OMX_ErrorNone, eError, "Error allocating buffers for color conversion");
-                                   pProxy->nCurBufIndex++;
-                            }
-                        }
 			pBufferHdr->pBuffer = (OMX_U8 *)(pGrallocHandle->fd[0]);
 			((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->
 			pAuxBuf1 = (OMX_PTR) pGrallocHandle->fd[1];
@@ -808,16 +975,6 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 			tBufHandle =  *((buffer_handle_t *)pTempBuffer);
 			pGrallocHandle = (IMG_native_handle_t*) tBufHandle;
 			DOMX_DEBUG("Grallloc buffer recieved in metadata buffer 0x%x",pGrallocHandle );
-                        if( pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12 && pProxy->gralloc_handle[0] == NULL ) {
-                            DOMX_DEBUG("Allocating NV12 buffers internally within DOMX actual count: %d", pCompPrv->nAllocatedBuffers);
-                            pProxy->nCurBufIndex = 0;
-
-                            while( (unsigned) pProxy->nCurBufIndex < pCompPrv->nAllocatedBuffers ) {
-                                   eError = COLORCONVERT_AllocateBuffer(hComponent, nStride);
-                                   PROXY_require(eError == OMX_ErrorNone, eError, "Error allocating buffers for color conversion");
-                                   pProxy->nCurBufIndex++;
-                            }
-                        }
 
 			pBufferHdr->pBuffer = (OMX_U8 *)(pGrallocHandle->fd[0]);
 			((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->
@@ -827,16 +984,14 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
 			if (pProxy->bAndroidOpaqueFormat && pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12)
 			{
-				/* Dequeue NV12 buffer for encoder */
-				eOSALStatus = TIMM_OSAL_ReadFromPipe(pProxy->hBufPipe, &nBufIndex,
-						                     sizeof(OMX_PTR), (TIMM_OSAL_U32 *)(&nSize),
-						                     TIMM_OSAL_SUSPEND);
-				PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, NULL);
+				/* Take an NV12 buffer from the shared pool, it goes back on EmptyBufferDone */
+				eError = COLORCONVERT_AcquireBuffer(pProxy->hCC, hComponent, pBufferHdr, &pNV12Handle);
+				PROXY_assert(eError == OMX_ErrorNone, eError, "No NV12 buffer for color conversion");
 
 				if(nFilledLen != 0)
 				{
 				    /* Get NV12 data after colorconv*/
-				    nRet = COLORCONVERT_PlatformOpaqueToNV12(pProxy->hCC, (void **) &pGrallocHandle, (void **) &pProxy->gralloc_handle[nBufIndex],
+				    nRet = COLORCONVERT_PlatformOpaqueToNV12(pProxy->hCC, (void **) &pGrallocHandle, (void **) &pNV12Handle,
 									 pGrallocHandle->iWidth,
 									 pGrallocHandle->iHeight,
 									 4096, COLORCONVERT_BUFTYPE_GRALLOCOPAQUE,
@@ -844,15 +999,13 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 
 				    if(nRet != 0)
 				    {
-					    eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &nBufIndex,
-						                     sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
 					    PROXY_assert(0, OMX_ErrorBadParameter, "Color conversion routine failed");
 				    }
 				}
 
 				/* Update pBufferHdr with NV12 buffers for OMX component */
-				pBufferHdr->pBuffer= (OMX_U8 *)(pProxy->gralloc_handle[nBufIndex]->fd[0]);
-				((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1 = (OMX_PTR)(pProxy->gralloc_handle[nBufIndex]->fd[1]);
+				pBufferHdr->pBuffer= (OMX_U8 *)(pNV12Handle->fd[0]);
+				((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1 = (OMX_PTR)(pNV12Handle->fd[1]);
 			}
 #endif
 #endif
@@ -876,21 +1029,15 @@ OMX_ERRORTYPE LOCAL_PROXY_H264E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	}
 
 	eError = PROXY_EmptyThisBuffer(hComponent, pBufferHdr);
+
+EXIT:
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-	if (pProxy->bAndroidOpaqueFormat
-#ifdef ENABLE_GRALLOC_BUFFER
-&& pGrallocHandle != NULL && pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12
-#endif
-)
+	/* The NV12 buffer is only kept if the frame made it to the encoder */
+	if (eError != OMX_ErrorNone && pNV12Handle != NULL)
 	{
-		/*Write buffer to end of pipe for re-circulation for future ETB()*/
-		eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &nBufIndex,
-					    sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-		PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, "Pipe write failed");
+		COLORCONVERT_ReleaseBuffer(pProxy->hCC, pBufferHdr);
 	}
 #endif
-
-EXIT:
 	if( pBufferHdr!=NULL && pCompPrv!=NULL)
 	{
 		if(pCompPrv->proxyPortBuffers[pBufferHdr->nInputPortIndex].proxyBufferType == EncoderMetadataPointers)
@@ -936,7 +1083,6 @@ static OMX_ERRORTYPE LOCAL_PROXY_H264E_FreeBuffer(OMX_IN OMX_HANDLETYPE hCompone
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
-	OMX_U32 nBufIndex, nSize, nCount=0;
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
 
 	PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
@@ -945,25 +1091,10 @@ static OMX_ERRORTYPE LOCAL_PROXY_H264E_FreeBuffer(OMX_IN OMX_HANDLETYPE hCompone
 	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
 
 	if((nPortIndex == OMX_H264E_INPUT_PORT) &&
-	   (pProxy->bAndroidOpaqueFormat) && (pProxy->gralloc_handle[0] != NULL))
+	   (pProxy->bAndroidOpaqueFormat))
 	{
-		pProxy->nCurBufIndex--;
-		PROXY_require(pProxy->nCurBufIndex >=0,
-			      OMX_ErrorBadParameter, "Buffer index underflow");
-
-		if(pProxy->gralloc_handle[pProxy->nCurBufIndex])
-		{
-			pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[pProxy->nCurBufIndex]));
-			pProxy->gralloc_handle[pProxy->nCurBufIndex] = NULL;
-		}
-
-		/*Clear the Bufindex pipe by dummy reads*/
-		TIMM_OSAL_GetPipeReadyMessageCount(pProxy->hBufPipe, (TIMM_OSAL_U32 *)&nCount);
-		if(nCount)
-		{
-			TIMM_OSAL_ReadFromPipe(pProxy->hBufPipe, &nBufIndex,
-					       sizeof(OMX_PTR), (TIMM_OSAL_U32 *)&nSize, TIMM_OSAL_NO_SUSPEND);
-		}
+		/* Drop the pool buffer of a frame that never came back */
+		COLORCONVERT_ReleaseBuffer(pProxy->hCC, pBufferHdr);
 	}
 
 	eError = PROXY_FreeBuffer(hComponent, nPortIndex, pBufferHdr);
@@ -971,143 +1102,32 @@ static OMX_ERRORTYPE LOCAL_PROXY_H264E_FreeBuffer(OMX_IN OMX_HANDLETYPE hCompone
 EXIT:
 	return eError;
 }
+#endif
 
-int COLORCONVERT_AllocateBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nStride)
-{
-        OMX_CONFIG_RECTTYPE tParam;
-        TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
-        OMX_U32 err;
-        OMX_ERRORTYPE eError = OMX_ErrorNone;
-        PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
-        OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-        OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
-
-        pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
-        pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-
-        tParam.nSize = sizeof(OMX_CONFIG_RECTTYPE);
-        tParam.nVersion.s.nVersionMajor = 1;
-        tParam.nVersion.s.nVersionMinor = 1;
-        tParam.nVersion.s.nRevision = 0;
-        tParam.nVersion.s.nStep = 0;
-        tParam.nPortIndex = OMX_H264E_INPUT_PORT;
-        eError = PROXY_GetParameter(hComponent, (OMX_INDEXTYPE)OMX_TI_IndexParam2DBufferAllocDimension, &tParam);
-        PROXY_assert(eError == OMX_ErrorNone, eError, " Error in Proxy GetParameter");
-        err = pProxy->mAllocDev->alloc(pProxy->mAllocDev, (int) tParam.nWidth, (int) tParam.nHeight, (int) HAL_PIXEL_FORMAT_TI_NV12, (int) GRALLOC_USAGE_HW_RENDER, (const struct native_handle_t * *)(&(pProxy->gralloc_handle[pProxy->nCurBufIndex])), (int *) &nStride);
-        PROXY_assert(!err, err, " Error in allocating Gralloc buffers");
-        eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &pProxy->nCurBufIndex, sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-        PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, "Pipe write failed");
-
-EXIT:
-        return eError;
-}
 OMX_ERRORTYPE LOCAL_PROXY_H264E_ComponentDeInit(OMX_HANDLETYPE hComponent)
 {
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	PROXY_COMPONENT_PRIVATE *pCompPrv;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
-	OMX_U32 i;
 
 	PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
 	    NULL);
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
 
-	if(pProxy->hBufPipe != NULL)
-	{
-		eOSALStatus = TIMM_OSAL_DeletePipe(pProxy->hBufPipe);
-		pProxy->hBufPipe = NULL;
-
-		if(eOSALStatus != TIMM_OSAL_ERR_NONE)
-		{
-			DOMX_ERROR("Pipe deletion failed");
-		}
-	}
-
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
 	if(pProxy->bAndroidOpaqueFormat == OMX_TRUE)
 	{
-		/* Cleanup internal buffers in pipe if not freed on FreeBuffer */
-		for(i=0; i<OMX_H264VE_NUM_INTERNAL_BUF; i++)
-		{
-			if(pProxy->gralloc_handle[i])
-			{
-				pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[i]));
-				pProxy->gralloc_handle[i] = NULL;
-			}
-		}
-
-
 		COLORCONVERT_close(pProxy->hCC,pCompPrv);
 		pProxy->bAndroidOpaqueFormat = OMX_FALSE;
-
-		if(pCompPrv->pCompProxyPrv != NULL)
-		{
-			TIMM_OSAL_Free(pCompPrv->pCompProxyPrv);
-			pCompPrv->pCompProxyPrv = NULL;
-		}
 	}
+#endif
+	TIMM_OSAL_Free(pCompPrv->pCompProxyPrv);
+	pCompPrv->pCompProxyPrv = NULL;
 
 	eError = PROXY_ComponentDeInit(hComponent);
 EXIT:
 	DOMX_EXIT("eError: %d", eError);
 	return eError;
 }
-
-int COLORCONVERT_open(void **hCC, PROXY_COMPONENT_PRIVATE *pCompPrv)
-{
-	int nErr = -1;
-	hw_module_t const* module = NULL;
-	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-
-	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-	nErr = hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module);
-
-	if (nErr == 0)
-	{
-		*hCC = (void *) ((IMG_gralloc_module_public_t const *)module);
-	}
-	else
-	{
-		 DOMX_ERROR("FATAL: gralloc api hw_get_module() returned error: Can't find \
-			    %s module err = %x", GRALLOC_HARDWARE_MODULE_ID, nErr);
-	}
-
-	gralloc_open(module, &(pProxy->mAllocDev));
-
-	return nErr;
-}
-
-int COLORCONVERT_PlatformOpaqueToNV12(void *hCC,
-				      void *pSrc[COLORCONVERT_MAX_SUB_BUFFERS],
-				      void *pDst[COLORCONVERT_MAX_SUB_BUFFERS],
-				      int nWidth, int nHeight, int nStride,
-				      int nSrcBufType,int nDstBufType)
-{
-	IMG_gralloc_module_public_t const* module = hCC;
-	int nErr = -1;
-
-	if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_VIRTUAL))
-	{
-		nErr = module->Blit(module, pSrc[0], pDst, HAL_PIXEL_FORMAT_TI_NV12);
-	}
-	else if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE ))
-	{
-		nErr = module->Blit2(module, pSrc[0], pDst[0], nWidth, nHeight, 0, 0);
-	}
-
-	return nErr;
-}
-
-int COLORCONVERT_close(void *hCC,PROXY_COMPONENT_PRIVATE *pCompPrv)
-{
-	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-	if(pProxy && pProxy->mAllocDev)
-	{
-		gralloc_close(pProxy->mAllocDev);
-	}
-	return 0;
-}
-#endif
@@ -73,6 +73,9 @@
 #include <hal_public.h>
 #include <VideoMetadata.h>
 #endif
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+#include "omx_proxy_colorconvert.h"
+#endif
 
 #include <stdlib.h>
 #include <cutils/properties.h>
@@ -112,28 +115,40 @@ OMX_TICKS    nVideoTime = 0; /* Video duration since last framerate calculation
 OMX_TICKS    nLastFrameRateUpdateTime = 0; /*Time stamp at last frame rate update */
 OMX_U16      nBFrames = 0; /* Number of B Frames in H264SVC Encoder */
 
+/* Layer configuration answered locally. A client driving SVC asks for the
+ * details of every layer each frame, which would double the RPCs per frame
+ * compared to the single layer encoder. Entries are tied to nPortDefEpoch,
+ * any SetParameter, command completion or port settings change on the
+ * remote side drops them, and so does any SetConfig.
+ */
+typedef struct OMX_PROXY_H264SVCE_PRIVATE {
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+    OMX_PROXY_ENCODER_PRIVATE             tEncoder; /* first, pCompProxyPrv is also read as this */
+#endif
+    TIMM_OSAL_PTR                         hLock;
+    OMX_U32                               nConfigEpoch;
+    OMX_U32                               nLayerDetailsValid; /* one bit per nLayerIndex */
+    OMX_TI_VIDEO_CONFIG_SVCLAYERDETAILS   tLayerDetails[H264SVC_MAX_NUM_LAYER];
+    OMX_BOOL                              bTargetLayerValid;
+    OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER    tTargetLayer;
+} OMX_PROXY_H264SVCE_PRIVATE;
+
+static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_GetConfig(OMX_HANDLETYPE hComponent,
+                                                    OMX_INDEXTYPE nConfigIndex, OMX_PTR pConfigStruct);
+
+static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_SetConfig(OMX_IN OMX_HANDLETYPE hComponent,
+                                                    OMX_IN OMX_INDEXTYPE nConfigIndex, OMX_IN OMX_PTR pConfigStruct);
+
+static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_ComponentDeInit(OMX_HANDLETYPE hComponent);
+
 
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
 /* Opaque color format requires below quirks to be enabled
  * ENABLE_GRALLOC_BUFFER
  * ANDROID_QUIRCK_CHANGE_PORT_VALUES
  */
-#define OMX_H264SVCVE_NUM_INTERNAL_BUF (8)
 #define HAL_PIXEL_FORMAT_TI_NV12 (0x100)
 
-#define COLORCONVERT_MAX_SUB_BUFFERS (3)
-
-#define COLORCONVERT_BUFTYPE_VIRTUAL (0x0)
-#define COLORCONVERT_BUFTYPE_ION     (0x1)
-#define COLORCONVERT_BUFTYPE_GRALLOCOPAQUE (0x2)
-
-int COLORCONVERT_open(void * *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv);
-int COLORCONVERT_PlatformOpaqueToNV12(void *hCC, void *pSrc[],
-                                      void *pDst[], int nWidth,
-                                      int nHeight, int nStride,
-                                      int nSrcBufType, int nDstBufType);
-int COLORCONVERT_close(void *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv);
-static int COLORCONVERT_AllocateBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nStride);
 static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
                                                          OMX_INOUT OMX_BUFFERHEADERTYPE * *ppBufferHdr, OMX_IN OMX_U32 nPortIndex,
                                                          OMX_IN OMX_PTR pAppPrivate, OMX_IN OMX_U32 nSizeBytes);
@@ -141,8 +156,6 @@ static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_AllocateBuffer(OMX_IN OMX_HANDLETYPE h
 static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponent,
                                                      OMX_IN OMX_U32 nPortIndex, OMX_IN OMX_BUFFERHEADERTYPE *pBufferHdr);
 
-static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_ComponentDeInit(OMX_HANDLETYPE hComponent);
-
 extern RPC_OMX_ERRORTYPE RPC_RegisterBuffer(OMX_HANDLETYPE hRPCCtx, int fd1, int fd2,
                                             OMX_PTR *handle1, OMX_PTR *handle2,
                                             PROXY_BUFFER_TYPE proxyBufferType);
@@ -293,11 +306,12 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
     OMX_ERRORTYPE              eError = OMX_ErrorNone;
     OMX_COMPONENTTYPE         *pHandle = NULL;
     PROXY_COMPONENT_PRIVATE   *pComponentPrivate = NULL;
+    OMX_PROXY_H264SVCE_PRIVATE   *pSvcPrv = NULL;
+    TIMM_OSAL_ERRORTYPE          eOSALStatus = TIMM_OSAL_ERR_NONE;
 
     pHandle = (OMX_COMPONENTTYPE *) hComponent;
     OMX_TI_PARAM_ENHANCEDPORTRECONFIG    tParamStruct;
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-    TIMM_OSAL_ERRORTYPE           eOSALStatus = TIMM_OSAL_ERR_NONE;
     OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
 #endif
     char       value[OMX_MAX_STRINGNAME_SIZE];
@@ -332,10 +346,9 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
                  OMX_ErrorInsufficientResources,
                  " Error in Allocating space for proxy component table");
 
-#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
     pComponentPrivate->pCompProxyPrv =
-        (OMX_PROXY_ENCODER_PRIVATE *)
-        TIMM_OSAL_Malloc(sizeof(OMX_PROXY_ENCODER_PRIVATE), TIMM_OSAL_TRUE,
+        (OMX_PROXY_H264SVCE_PRIVATE *)
+        TIMM_OSAL_Malloc(sizeof(OMX_PROXY_H264SVCE_PRIVATE), TIMM_OSAL_TRUE,
                          0, TIMMOSAL_MEM_SEGMENT_INT);
 
     PROXY_assert(pComponentPrivate->pCompProxyPrv != NULL,
@@ -343,16 +356,16 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
                  " Could not allocate proxy component private");
 
     TIMM_OSAL_Memset(pComponentPrivate->pCompProxyPrv, 0,
-                     sizeof(OMX_PROXY_ENCODER_PRIVATE));
+                     sizeof(OMX_PROXY_H264SVCE_PRIVATE));
 
-    pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pComponentPrivate->pCompProxyPrv;
-
-    /* Create Pipe of for encoder input buffers */
-    eOSALStatus = TIMM_OSAL_CreatePipe(&pProxy->hBufPipe, sizeof(OMX_U32),
-                                       OMX_H264SVCVE_NUM_INTERNAL_BUF, 1);
+    pSvcPrv = (OMX_PROXY_H264SVCE_PRIVATE *) pComponentPrivate->pCompProxyPrv;
+    eOSALStatus = TIMM_OSAL_MutexCreate(&pSvcPrv->hLock);
     PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE,
                  OMX_ErrorInsufficientResources,
-                 "Pipe creation failed");
+                 " Could not create layer config lock");
+
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+    pProxy = &pSvcPrv->tEncoder;
 #endif
 
     // Copying component Name - this will be picked up in the proxy common
@@ -363,6 +376,11 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
                      strlen(COMPONENT_NAME) + 1);
 
     eError = OMX_ProxyCommonInit(hComponent);   // Calling Proxy Common Init()
+    /* Rate control retuning goes out with the next frame */
+    if( eError == OMX_ErrorNone &&
+        PROXY_EnableConfigQueue(hComponent) != OMX_ErrorNone ) {
+        DOMX_WARN("No config queue, SetConfig stays synchronous");
+    }
 #ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
     pHandle->SetParameter = LOCAL_PROXY_H264SVCE_SetParameter;
     pHandle->GetParameter = LOCAL_PROXY_H264SVCE_GetParameter;
@@ -370,9 +388,11 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
     pComponentPrivate->IsLoadedState = OMX_TRUE;
     pHandle->EmptyThisBuffer = LOCAL_PROXY_H264SVCE_EmptyThisBuffer;
     pHandle->GetExtensionIndex = LOCAL_PROXY_H264SVCE_GetExtensionIndex;
+    pHandle->GetConfig = LOCAL_PROXY_H264SVCE_GetConfig;
+    pHandle->SetConfig = LOCAL_PROXY_H264SVCE_SetConfig;
+    pHandle->ComponentDeInit = LOCAL_PROXY_H264SVCE_ComponentDeInit;
 
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-    pHandle->ComponentDeInit = LOCAL_PROXY_H264SVCE_ComponentDeInit;
     pHandle->FreeBuffer = LOCAL_PROXY_H264SVCE_FreeBuffer;
     pHandle->AllocateBuffer = LOCAL_PROXY_H264SVCE_AllocateBuffer;
 #endif
@@ -385,18 +405,14 @@ EXIT:
     if( eError != OMX_ErrorNone ) {
         DOMX_DEBUG("Error in Initializing Proxy");
 
-#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-        if( pProxy->hBufPipe != NULL ) {
-            TIMM_OSAL_DeletePipe(pProxy->hBufPipe);
-            pProxy->hBufPipe = NULL;
-        }
-
-        if( pComponentPrivate->pCompProxyPrv != NULL ) {
-            TIMM_OSAL_Free(pComponentPrivate->pCompProxyPrv);
+        if( pSvcPrv != NULL ) {
+            if( pSvcPrv->hLock != NULL ) {
+                TIMM_OSAL_MutexDelete(pSvcPrv->hLock);
+            }
+            TIMM_OSAL_Free(pSvcPrv);
             pComponentPrivate->pCompProxyPrv = NULL;
-            pProxy = NULL;
+            pSvcPrv = NULL;
         }
-#endif
         if( pComponentPrivate->cCompName != NULL ) {
             TIMM_OSAL_Free(pComponentPrivate->cCompName);
             pComponentPrivate->cCompName = NULL;
@@ -695,8 +711,8 @@ OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
     OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
-    TIMM_OSAL_ERRORTYPE           eOSALStatus = TIMM_OSAL_ERR_NONE;
-    OMX_U32                       nBufIndex = 0, nSize=0, nRet=0;
+    IMG_native_handle_t           *pNV12Handle = NULL;
+    OMX_U32                       nRet=0;
 #endif
 #ifdef ENABLE_GRALLOC_BUFFER
     OMX_PTR                pAuxBuf0 = NULL, pAuxBuf1 = NULL;
@@ -722,7 +738,7 @@ OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
     tParamStruct.nVersion.s.nStep = 0x0;
     tParamStruct.nPortIndex = OMX_H264SVCE_INPUT_PORT;
 
-    eError = PROXY_GetParameter(hComponent, OMX_IndexParamPortDefinition, &tParamStruct);
+    eError = PROXY_GetCachedPortDefinition(hComponent, &tParamStruct);
     PROXY_require(eError == OMX_ErrorNone, OMX_ErrorBadParameter, "Error is Get Parameter for port def");
     nFilledLen = pBufferHdr->nFilledLen;
     nAllocLen = pBufferHdr->nAllocLen;
@@ -754,16 +770,6 @@ OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
             pVideoMetadataBuffer = (video_metadata_t *) ((OMX_U32 *)(pBufferHdr->pBuffer));
             pGrallocHandle = (IMG_native_handle_t *) (pVideoMetadataBuffer->handle);
             DOMX_DEBUG("Grallloc buffer recieved in metadata buffer 0x%x", pGrallocHandle);
-            if( pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12 && pProxy->gralloc_handle[0] == NULL ) {
-                DOMX_DEBUG("Allocating NV12 buffers internally within DOMX actual count: %d", pCompPrv->nAllocatedBuffers);
-                pProxy->nCurBufIndex = 0;
-
-                while((unsigned) pProxy->nCurBufIndex < pCompPrv->nAllocatedBuffers ) {
-                    eError = COLORCONVERT_AllocateBuffer(hComponent, nStride);
-                    PROXY_require(eError == OMX_ErrorNone, eError, "Error allocating buffers for color conversion");
-                    pProxy->nCurBufIndex++;
-                }
-            }
             pBufferHdr->pBuffer = (OMX_U8 *)(pGrallocHandle->fd[0]);
             ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->
             pAuxBuf1 = (OMX_PTR) pGrallocHandle->fd[1];
@@ -781,16 +787,6 @@ OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
             tBufHandle =  *((buffer_handle_t *)pTempBuffer);
             pGrallocHandle = (IMG_native_handle_t *) tBufHandle;
             DOMX_DEBUG("Grallloc buffer recieved in metadata buffer 0x%x", pGrallocHandle);
-            if( pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12 && pProxy->gralloc_handle[0] == NULL ) {
-                DOMX_DEBUG("Allocating NV12 buffers internally within DOMX actual count: %d", pCompPrv->nAllocatedBuffers);
-                pProxy->nCurBufIndex = 0;
-
-                while((unsigned) pProxy->nCurBufIndex < pCompPrv->nAllocatedBuffers ) {
-                    eError = COLORCONVERT_AllocateBuffer(hComponent, nStride);
-                    PROXY_require(eError == OMX_ErrorNone, eError, "Error allocating buffers for color conversion");
-                    pProxy->nCurBufIndex++;
-                }
-            }
 
             pBufferHdr->pBuffer = (OMX_U8 *)(pGrallocHandle->fd[0]);
             ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->
@@ -799,30 +795,26 @@ OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
                        pGrallocHandle->fd[0], pGrallocHandle->fd[1]);
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
             if( pProxy->bAndroidOpaqueFormat && pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12 ) {
-                /* Dequeue NV12 buffer for encoder */
-                eOSALStatus = TIMM_OSAL_ReadFromPipe(pProxy->hBufPipe, &nBufIndex,
-                                                     sizeof(OMX_PTR), (TIMM_OSAL_U32 *)(&nSize),
-                                                     TIMM_OSAL_SUSPEND);
-                PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, NULL);
+                /* Take an NV12 buffer from the shared pool, it goes back on EmptyBufferDone */
+                eError = COLORCONVERT_AcquireBuffer(pProxy->hCC, hComponent, pBufferHdr, &pNV12Handle);
+                PROXY_assert(eError == OMX_ErrorNone, eError, "No NV12 buffer for color conversion");
 
                 if( nFilledLen != 0 ) {
                     /* Get NV12 data after colorconv*/
-                    nRet = COLORCONVERT_PlatformOpaqueToNV12(pProxy->hCC, (void * *) &pGrallocHandle, (void * *) &pProxy->gralloc_handle[nBufIndex],
+                    nRet = COLORCONVERT_PlatformOpaqueToNV12(pProxy->hCC, (void * *) &pGrallocHandle, (void * *) &pNV12Handle,
                                                              pGrallocHandle->iWidth,
                                                              pGrallocHandle->iHeight,
                                                              4096, COLORCONVERT_BUFTYPE_GRALLOCOPAQUE,
                                                              COLORCONVERT_BUFTYPE_GRALLOCOPAQUE);
 
                     if( nRet != 0 ) {
-                        eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &nBufIndex,
-                                                            sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
                         PROXY_assert(0, OMX_ErrorBadParameter, "Color conversion routine failed");
                     }
                 }
 
                 /* Update pBufferHdr with NV12 buffers for OMX component */
-                pBufferHdr->pBuffer= (OMX_U8 *)(pProxy->gralloc_handle[nBufIndex]->fd[0]);
-                ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1 = (OMX_PTR)(pProxy->gralloc_handle[nBufIndex]->fd[1]);
+                pBufferHdr->pBuffer= (OMX_U8 *)(pNV12Handle->fd[0]);
+                ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1 = (OMX_PTR)(pNV12Handle->fd[1]);
             }
 #endif
 #endif
@@ -846,20 +838,14 @@ OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
     }
 
     eError = PROXY_EmptyThisBuffer(hComponent, pBufferHdr);
+
+EXIT:
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-    if( pProxy->bAndroidOpaqueFormat
-#ifdef ENABLE_GRALLOC_BUFFER
-        && pGrallocHandle != NULL && pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12
-#endif
-        ) {
-        /*Write buffer to end of pipe for re-circulation for future ETB()*/
-        eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &nBufIndex,
-                                            sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-        PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, "Pipe write failed");
+    /* The NV12 buffer is only kept if the frame made it to the encoder */
+    if( eError != OMX_ErrorNone && pNV12Handle != NULL ) {
+        COLORCONVERT_ReleaseBuffer(pProxy->hCC, pBufferHdr);
     }
 #endif
-
-EXIT:
     if( pBufferHdr != NULL && pCompPrv != NULL ) {
         if( pCompPrv->proxyPortBuffers[pBufferHdr->nInputPortIndex].proxyBufferType == EncoderMetadataPointers ) {
             pBufferHdr->pBuffer = pBufferOrig;
@@ -903,7 +889,6 @@ static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_FreeBuffer(OMX_IN OMX_HANDLETYPE hComp
     OMX_ERRORTYPE                 eError = OMX_ErrorNone;
     OMX_COMPONENTTYPE            *hComp = (OMX_COMPONENTTYPE *) hComponent;
     PROXY_COMPONENT_PRIVATE      *pCompPrv = NULL;
-    OMX_U32                       nBufIndex, nSize, nCount=0;
     OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
 
     PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
@@ -912,22 +897,9 @@ static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_FreeBuffer(OMX_IN OMX_HANDLETYPE hComp
     pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
 
     if((nPortIndex == OMX_H264SVCE_INPUT_PORT) &&
-       (pProxy->bAndroidOpaqueFormat) && (pProxy->gralloc_handle[0] != NULL)) {
-        pProxy->nCurBufIndex--;
-        PROXY_require(pProxy->nCurBufIndex >= 0,
-                      OMX_ErrorBadParameter, "Buffer index underflow");
-
-        if( pProxy->gralloc_handle[pProxy->nCurBufIndex] ) {
-            pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[pProxy->nCurBufIndex]));
-            pProxy->gralloc_handle[pProxy->nCurBufIndex] = NULL;
-        }
-
-        /*Clear the Bufindex pipe by dummy reads*/
-        TIMM_OSAL_GetPipeReadyMessageCount(pProxy->hBufPipe, (TIMM_OSAL_U32 *)&nCount);
-        if( nCount ) {
-            TIMM_OSAL_ReadFromPipe(pProxy->hBufPipe, &nBufIndex,
-                                   sizeof(OMX_PTR), (TIMM_OSAL_U32 *)&nSize, TIMM_OSAL_NO_SUSPEND);
-        }
+       (pProxy->bAndroidOpaqueFormat)) {
+        /* Drop the pool buffer of a frame that never came back */
+        COLORCONVERT_ReleaseBuffer(pProxy->hCC, pBufferHdr);
     }
 
     eError = PROXY_FreeBuffer(hComponent, nPortIndex, pBufferHdr);
@@ -936,132 +908,173 @@ EXIT:
     return (eError);
 }
 
-int COLORCONVERT_AllocateBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nStride)
-{
-    OMX_CONFIG_RECTTYPE           tParam;
-    TIMM_OSAL_ERRORTYPE           eOSALStatus = TIMM_OSAL_ERR_NONE;
-    OMX_U32                       err;
-    OMX_ERRORTYPE                 eError = OMX_ErrorNone;
-    PROXY_COMPONENT_PRIVATE      *pCompPrv = NULL;
-    OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
-    OMX_COMPONENTTYPE            *hComp = (OMX_COMPONENTTYPE *) hComponent;
-
-    pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
-    pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-
-    tParam.nSize = sizeof(OMX_CONFIG_RECTTYPE);
-    tParam.nVersion.s.nVersionMajor = 1;
-    tParam.nVersion.s.nVersionMinor = 1;
-    tParam.nVersion.s.nRevision = 0;
-    tParam.nVersion.s.nStep = 0;
-    tParam.nPortIndex = OMX_H264SVCE_INPUT_PORT;
-    eError = PROXY_GetParameter(hComponent, (OMX_INDEXTYPE)OMX_TI_IndexParam2DBufferAllocDimension, &tParam);
-    PROXY_assert(eError == OMX_ErrorNone, eError, " Error in Proxy GetParameter");
-    err = pProxy->mAllocDev->alloc(pProxy->mAllocDev, (int) tParam.nWidth, (int) tParam.nHeight, (int) HAL_PIXEL_FORMAT_TI_NV12, (int) GRALLOC_USAGE_HW_RENDER, (const struct native_handle_t * *)(&(pProxy->gralloc_handle[pProxy->nCurBufIndex])), (int *) &nStride);
-    PROXY_assert(!err, err, " Error in allocating Gralloc buffers");
-    eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &pProxy->nCurBufIndex, sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-    PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, "Pipe write failed");
-
-EXIT:
-    return (eError);
-}
+#endif
 
-OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_ComponentDeInit(OMX_HANDLETYPE hComponent)
+/* ===========================================================================*/
+/**
+ * @name LOCAL_PROXY_H264SVCE_GetConfig()
+ * @brief Serves layer details and the target layer from the proxy side
+ *        once the remote encoder answered them for the current settings.
+ * @return OMX_ErrorNone = Successful
+ *
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_GetConfig(OMX_HANDLETYPE hComponent,
+                                                    OMX_INDEXTYPE nConfigIndex, OMX_PTR pConfigStruct)
 {
-    OMX_ERRORTYPE                 eError = OMX_ErrorNone;
-    PROXY_COMPONENT_PRIVATE      *pCompPrv;
-    OMX_COMPONENTTYPE            *hComp = (OMX_COMPONENTTYPE *) hComponent;
-    OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
-    TIMM_OSAL_ERRORTYPE           eOSALStatus = TIMM_OSAL_ERR_NONE;
-    OMX_U32                       i;
+    OMX_ERRORTYPE                           eError = OMX_ErrorNone;
+    PROXY_COMPONENT_PRIVATE                *pCompPrv = NULL;
+    OMX_COMPONENTTYPE                      *hComp = (OMX_COMPONENTTYPE *) hComponent;
+    OMX_PROXY_H264SVCE_PRIVATE             *pSvcPrv = NULL;
+    OMX_TI_VIDEO_CONFIG_SVCLAYERDETAILS    *pLayer = NULL;
+    OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER     *pTarget = NULL;
+    OMX_U32                                 nEpoch = 0, nConfigEpoch = 0;
+    OMX_BOOL                                bCached = OMX_FALSE;
+
+    PROXY_require((pConfigStruct != NULL), OMX_ErrorBadParameter, NULL);
+    PROXY_require((hComp->pComponentPrivate != NULL),
+                  OMX_ErrorBadParameter, NULL);
 
-    PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
-                  NULL);
     pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
-    pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-
-    if( pProxy->hBufPipe != NULL ) {
-        eOSALStatus = TIMM_OSAL_DeletePipe(pProxy->hBufPipe);
-        pProxy->hBufPipe = NULL;
+    pSvcPrv = (OMX_PROXY_H264SVCE_PRIVATE *) pCompPrv->pCompProxyPrv;
 
-        if( eOSALStatus != TIMM_OSAL_ERR_NONE ) {
-            DOMX_ERROR("Pipe deletion failed");
+    if( nConfigIndex == (OMX_INDEXTYPE) OMX_TI_IndexConfigVideoSvcLayerDetails ) {
+        pLayer = (OMX_TI_VIDEO_CONFIG_SVCLAYERDETAILS *) pConfigStruct;
+        if( pLayer->nSize != sizeof(OMX_TI_VIDEO_CONFIG_SVCLAYERDETAILS) ||
+            pLayer->nLayerIndex >= H264SVC_MAX_NUM_LAYER ) {
+            pLayer = NULL;
+        }
+    } else if( nConfigIndex == (OMX_INDEXTYPE) OMX_TI_IndexConfigVideoSvcTargetLayer ) {
+        pTarget = (OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER *) pConfigStruct;
+        if( pTarget->nSize != sizeof(OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER)) {
+            pTarget = NULL;
         }
     }
 
-    if( pProxy->bAndroidOpaqueFormat == OMX_TRUE ) {
-        /* Cleanup internal buffers in pipe if not freed on FreeBuffer */
-        for( i=0; i < OMX_H264SVCVE_NUM_INTERNAL_BUF; i++ ) {
-            if( pProxy->gralloc_handle[i] ) {
-                pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[i]));
-                pProxy->gralloc_handle[i] = NULL;
-            }
-        }
+    if( pLayer == NULL && pTarget == NULL ) {
+        eError = PROXY_GetConfig(hComponent, nConfigIndex, pConfigStruct);
+        goto EXIT;
+    }
+
+    TIMM_OSAL_MutexObtain(pSvcPrv->hLock, TIMM_OSAL_SUSPEND);
+    nEpoch = pCompPrv->nPortDefEpoch;
+    nConfigEpoch = pSvcPrv->nConfigEpoch;
+    if( pLayer != NULL &&
+        (pSvcPrv->nLayerDetailsValid & (1 << pLayer->nLayerIndex)) &&
+        pSvcPrv->tLayerDetails[pLayer->nLayerIndex].nPortIndex == pLayer->nPortIndex ) {
+        TIMM_OSAL_Memcpy(pLayer, &pSvcPrv->tLayerDetails[pLayer->nLayerIndex],
+                         sizeof(OMX_TI_VIDEO_CONFIG_SVCLAYERDETAILS));
+        bCached = OMX_TRUE;
+    } else if( pTarget != NULL && pSvcPrv->bTargetLayerValid &&
+               pSvcPrv->tTargetLayer.nPortIndex == pTarget->nPortIndex ) {
+        TIMM_OSAL_Memcpy(pTarget, &pSvcPrv->tTargetLayer,
+                         sizeof(OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER));
+        bCached = OMX_TRUE;
+    }
+    TIMM_OSAL_MutexRelease(pSvcPrv->hLock);
+    if( bCached ) {
+        goto EXIT;
+    }
 
-        COLORCONVERT_close(pProxy->hCC, pCompPrv);
-        pProxy->bAndroidOpaqueFormat = OMX_FALSE;
+    eError = PROXY_GetConfig(hComponent, nConfigIndex, pConfigStruct);
+    if( eError != OMX_ErrorNone ) {
+        goto EXIT;
+    }
 
-        if( pCompPrv->pCompProxyPrv != NULL ) {
-            TIMM_OSAL_Free(pCompPrv->pCompProxyPrv);
-            pCompPrv->pCompProxyPrv = NULL;
+    /* Only kept if nothing changed the settings while the query was out */
+    TIMM_OSAL_MutexObtain(pSvcPrv->hLock, TIMM_OSAL_SUSPEND);
+    if( nEpoch == pCompPrv->nPortDefEpoch && nConfigEpoch == pSvcPrv->nConfigEpoch ) {
+        if( pLayer != NULL ) {
+            TIMM_OSAL_Memcpy(&pSvcPrv->tLayerDetails[pLayer->nLayerIndex], pLayer,
+                             sizeof(OMX_TI_VIDEO_CONFIG_SVCLAYERDETAILS));
+            pSvcPrv->nLayerDetailsValid |= (1 << pLayer->nLayerIndex);
+        } else {
+            TIMM_OSAL_Memcpy(&pSvcPrv->tTargetLayer, pTarget,
+                             sizeof(OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER));
+            pSvcPrv->bTargetLayerValid = OMX_TRUE;
         }
     }
+    TIMM_OSAL_MutexRelease(pSvcPrv->hLock);
 
-    eError = PROXY_ComponentDeInit(hComponent);
 EXIT:
-    DOMX_EXIT("eError: %d", eError);
     return (eError);
 }
 
-int COLORCONVERT_open(void * *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv)
+/* ===========================================================================*/
+/**
+ * @name LOCAL_PROXY_H264SVCE_SetConfig()
+ * @brief Drops the layer answers the new setting may change. A target
+ *        layer the remote encoder accepted is kept for GetConfig.
+ * @return OMX_ErrorNone = Successful
+ *
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_SetConfig(OMX_IN OMX_HANDLETYPE hComponent,
+                                                    OMX_IN OMX_INDEXTYPE nConfigIndex, OMX_IN OMX_PTR pConfigStruct)
 {
-    int                           nErr = -1;
-    hw_module_t const            *module = NULL;
-    OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
+    OMX_ERRORTYPE                  eError = OMX_ErrorNone;
+    PROXY_COMPONENT_PRIVATE       *pCompPrv = NULL;
+    OMX_COMPONENTTYPE             *hComp = (OMX_COMPONENTTYPE *) hComponent;
+    OMX_PROXY_H264SVCE_PRIVATE    *pSvcPrv = NULL;
+    OMX_U32                        nConfigEpoch = 0;
 
-    pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-    nErr = hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module);
+    PROXY_require((pConfigStruct != NULL), OMX_ErrorBadParameter, NULL);
+    PROXY_require((hComp->pComponentPrivate != NULL),
+                  OMX_ErrorBadParameter, NULL);
 
-    if( nErr == 0 ) {
-        *hCC = (void *) ((IMG_gralloc_module_public_t const *)module);
-    } else {
-        DOMX_ERROR("FATAL: gralloc api hw_get_module() returned error: Can't find \
-                %s module err = %x", GRALLOC_HARDWARE_MODULE_ID, nErr);
+    pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+    pSvcPrv = (OMX_PROXY_H264SVCE_PRIVATE *) pCompPrv->pCompProxyPrv;
+
+    TIMM_OSAL_MutexObtain(pSvcPrv->hLock, TIMM_OSAL_SUSPEND);
+    nConfigEpoch = ++pSvcPrv->nConfigEpoch;
+    pSvcPrv->nLayerDetailsValid = 0;
+    pSvcPrv->bTargetLayerValid = OMX_FALSE;
+    TIMM_OSAL_MutexRelease(pSvcPrv->hLock);
+
+    eError = PROXY_SetConfig(hComponent, nConfigIndex, pConfigStruct);
+    if( eError != OMX_ErrorNone ||
+        nConfigIndex != (OMX_INDEXTYPE) OMX_TI_IndexConfigVideoSvcTargetLayer ||
+        ((OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER *) pConfigStruct)->nSize !=
+        sizeof(OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER)) {
+        goto EXIT;
     }
 
-    gralloc_open(module, &(pProxy->mAllocDev));
-
-    return (nErr);
-}
-
-int COLORCONVERT_PlatformOpaqueToNV12(void *hCC,
-                                      void *pSrc[COLORCONVERT_MAX_SUB_BUFFERS],
-                                      void *pDst[COLORCONVERT_MAX_SUB_BUFFERS],
-                                      int nWidth, int nHeight, int nStride,
-                                      int nSrcBufType, int nDstBufType)
-{
-    IMG_gralloc_module_public_t const   *module = hCC;
-    int                                  nErr = -1;
-
-    if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_VIRTUAL)) {
-        nErr = module->Blit(module, pSrc[0], pDst, HAL_PIXEL_FORMAT_TI_NV12);
-    } else if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE)) {
-        nErr = module->Blit2(module, pSrc[0], pDst[0], nWidth, nHeight, 0, 0);
+    TIMM_OSAL_MutexObtain(pSvcPrv->hLock, TIMM_OSAL_SUSPEND);
+    if( nConfigEpoch == pSvcPrv->nConfigEpoch ) {
+        TIMM_OSAL_Memcpy(&pSvcPrv->tTargetLayer, pConfigStruct,
+                         sizeof(OMX_TI_VIDEO_CONFIG_SVCTARGETLAYER));
+        pSvcPrv->bTargetLayerValid = OMX_TRUE;
     }
+    TIMM_OSAL_MutexRelease(pSvcPrv->hLock);
 
-    return (nErr);
+EXIT:
+    return (eError);
 }
 
-int COLORCONVERT_close(void *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv)
+OMX_ERRORTYPE LOCAL_PROXY_H264SVCE_ComponentDeInit(OMX_HANDLETYPE hComponent)
 {
-    OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
+    OMX_ERRORTYPE                 eError = OMX_ErrorNone;
+    PROXY_COMPONENT_PRIVATE      *pCompPrv;
+    OMX_COMPONENTTYPE            *hComp = (OMX_COMPONENTTYPE *) hComponent;
+    OMX_PROXY_H264SVCE_PRIVATE   *pSvcPrv = NULL;
 
-    pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-    if( pProxy && pProxy->mAllocDev ) {
-        gralloc_close(pProxy->mAllocDev);
-    }
-    return (0);
-}
+    PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
+                  NULL);
+    pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+    pSvcPrv = (OMX_PROXY_H264SVCE_PRIVATE *) pCompPrv->pCompProxyPrv;
 
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+    if( pSvcPrv->tEncoder.bAndroidOpaqueFormat == OMX_TRUE ) {
+        COLORCONVERT_close(pSvcPrv->tEncoder.hCC, pCompPrv);
+        pSvcPrv->tEncoder.bAndroidOpaqueFormat = OMX_FALSE;
+    }
 #endif
+    TIMM_OSAL_MutexDelete(pSvcPrv->hLock);
+    TIMM_OSAL_Free(pSvcPrv);
+    pCompPrv->pCompProxyPrv = NULL;
 
+    eError = PROXY_ComponentDeInit(hComponent);
+EXIT:
+    DOMX_EXIT("eError: %d", eError);
+    return (eError);
+}
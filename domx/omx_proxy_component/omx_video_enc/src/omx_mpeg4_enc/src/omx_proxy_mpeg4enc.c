@@ -75,6 +75,9 @@
 #include <hal_public.h>
 #include <VideoMetadata.h>
 #endif
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+#include "omx_proxy_colorconvert.h"
+#endif
 
 #include <stdlib.h>
 #include <cutils/properties.h>
@@ -119,22 +122,8 @@ OMX_U16 nBFrames = 0; /* Number of B Frames in H264 Encoder */
 
 
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-#define OMX_MPEG4E_NUM_INTERNAL_BUF (8)
 #define HAL_PIXEL_FORMAT_TI_NV12 (0x100)
 
-#define COLORCONVERT_MAX_SUB_BUFFERS (3)
-
-#define COLORCONVERT_BUFTYPE_VIRTUAL (0x0)
-#define COLORCONVERT_BUFTYPE_ION     (0x1)
-#define COLORCONVERT_BUFTYPE_GRALLOCOPAQUE (0x2)
-
-int COLORCONVERT_open(void **hCC, PROXY_COMPONENT_PRIVATE *pCompPrv);
-int COLORCONVERT_PlatformOpaqueToNV12(void *hCC, void *pSrc[],
-				      void *pDst[], int nWidth,
-				      int nHeight, int nStride,
-				      int nSrcBufType, int nDstBufType);
-int COLORCONVERT_close(void *hCC,PROXY_COMPONENT_PRIVATE *pCompPrv);
-
 static OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
     OMX_INOUT OMX_BUFFERHEADERTYPE ** ppBufferHdr, OMX_IN OMX_U32 nPortIndex,
     OMX_IN OMX_PTR pAppPrivate, OMX_IN OMX_U32 nSizeBytes);
@@ -290,7 +279,6 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	pHandle = (OMX_COMPONENTTYPE *) hComponent;
         OMX_TI_PARAM_ENHANCEDPORTRECONFIG tParamStruct;
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
 #endif
 	char value[OMX_MAX_STRINGNAME_SIZE];
@@ -339,14 +327,6 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 		sizeof(OMX_PROXY_ENCODER_PRIVATE));
 
 	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pComponentPrivate->pCompProxyPrv;
-
-	/* Create Pipe of for encoder input buffers */
-	eOSALStatus = TIMM_OSAL_CreatePipe(&pProxy->hBufPipe, sizeof(OMX_U32),
-					   OMX_MPEG4E_NUM_INTERNAL_BUF, 1);
-	PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE,
-			OMX_ErrorInsufficientResources,
-			"Pipe creation failed");
-
 #endif
 
 	// Copying component Name - this will be picked up in the proxy common
@@ -357,6 +337,11 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 	    strlen(COMPONENT_NAME) + 1);
 
 	eError = OMX_ProxyCommonInit(hComponent);	// Calling Proxy Common Init()
+	/* Rate control retuning goes out with the next frame */
+	if( eError == OMX_ErrorNone &&
+		PROXY_EnableConfigQueue(hComponent) != OMX_ErrorNone ) {
+		DOMX_WARN("No config queue, SetConfig stays synchronous");
+	}
 #ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
 	pHandle->SetParameter = LOCAL_PROXY_MPEG4E_SetParameter;
     pHandle->GetParameter = LOCAL_PROXY_MPEG4E_GetParameter;
@@ -378,12 +363,6 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
 		DOMX_DEBUG("Error in Initializing Proxy");
 
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-		if(pProxy->hBufPipe != NULL)
-		{
-			TIMM_OSAL_DeletePipe(pProxy->hBufPipe);
-			pProxy->hBufPipe = NULL;
-		}
-
 		if(pComponentPrivate->pCompProxyPrv != NULL)
 		{
 			TIMM_OSAL_Free(pComponentPrivate->pCompProxyPrv);
@@ -699,8 +678,8 @@ OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	OMX_U32 nFilledLen, nAllocLen;
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
-	OMX_U32 nBufIndex = 0, nSize=0, nRet=0;
+	IMG_native_handle_t *pNV12Handle = NULL;
+	OMX_U32 nRet=0;
 #endif
 #ifdef ENABLE_GRALLOC_BUFFER
 	OMX_PTR pAuxBuf0 = NULL, pAuxBuf1 = NULL;
@@ -725,7 +704,7 @@ OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	tParamStruct.nVersion.s.nStep = 0x0;
 	tParamStruct.nPortIndex = OMX_MPEG4E_INPUT_PORT;
 
-	eError = PROXY_GetParameter(hComponent, OMX_IndexParamPortDefinition, &tParamStruct);
+	eError = PROXY_GetCachedPortDefinition(hComponent, &tParamStruct);
 	PROXY_require(eError == OMX_ErrorNone, OMX_ErrorBadParameter, "Error is Get Parameter for port def");
 	nFilledLen = pBufferHdr->nFilledLen;
 	nAllocLen = pBufferHdr->nAllocLen;
@@ -740,8 +719,7 @@ OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	    __FUNCTION__,hComponent, pCompPrv, pBufferHdr->nFilledLen,
 	    pBufferHdr->nOffset, pBufferHdr->nFlags);
 
-	if( pCompPrv->proxyPortBuffers[OMX_MPEG4E_INPUT_PORT].proxyBufferType == EncoderMetadataPointers
-                && nFilledLen != 0)
+	if( pCompPrv->proxyPortBuffers[OMX_MPEG4E_INPUT_PORT].proxyBufferType == EncoderMetadataPointers )
 	{
 		OMX_U32 *pTempBuffer;
 		OMX_U32 nMetadataBufferType;
@@ -790,39 +768,40 @@ OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 			DOMX_DEBUG("%s Gralloc=0x%x, Y-fd=%d, UV-fd=%d", __FUNCTION__, pGrallocHandle,
 			            pGrallocHandle->fd[0], pGrallocHandle->fd[1]);
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-			if (pProxy->bAndroidOpaqueFormat)
+			/* NV12 gralloc buffers go to the encoder as they are */
+			if (pProxy->bAndroidOpaqueFormat && pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12)
 			{
-                                DOMX_DEBUG(" ++TIMM_OSAL_ReadFromPipe() ");
-				/* Dequeue NV12 buffer for encoder */
-				eOSALStatus = TIMM_OSAL_ReadFromPipe(pProxy->hBufPipe, &nBufIndex,
-						                     sizeof(OMX_PTR), (TIMM_OSAL_U32 *)(&nSize),
-						                     TIMM_OSAL_SUSPEND);
-				PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, NULL);
-
-				/* Get NV12 data after colorconv*/
-				nRet = COLORCONVERT_PlatformOpaqueToNV12(pProxy->hCC, (void **) &pGrallocHandle, (void **) &pProxy->gralloc_handle[nBufIndex],
+				/* Take an NV12 buffer from the shared pool, it goes back on EmptyBufferDone */
+				eError = COLORCONVERT_AcquireBuffer(pProxy->hCC, hComponent, pBufferHdr, &pNV12Handle);
+				PROXY_assert(eError == OMX_ErrorNone, eError, "No NV12 buffer for color conversion");
+
+				if(nFilledLen != 0)
+				{
+				    /* Get NV12 data after colorconv*/
+				    nRet = COLORCONVERT_PlatformOpaqueToNV12(pProxy->hCC, (void **) &pGrallocHandle, (void **) &pNV12Handle,
 									 pGrallocHandle->iWidth,
 									 pGrallocHandle->iHeight,
 									 4096, COLORCONVERT_BUFTYPE_GRALLOCOPAQUE,
 									 COLORCONVERT_BUFTYPE_GRALLOCOPAQUE );
-				if(nRet != 0)
-				{
-					eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &nBufIndex,
-						                     sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-					PROXY_assert(0, OMX_ErrorBadParameter, "Color conversion routine failed");
+				    if(nRet != 0)
+				    {
+					    PROXY_assert(0, OMX_ErrorBadParameter, "Color conversion routine failed");
+				    }
+                                    DOMX_DEBUG(" --COLORCONVERT_PlatformOpaqueToNV12() ");
 				}
-                                DOMX_DEBUG(" --COLORCONVERT_PlatformOpaqueToNV12() ");
 
 				/* Update pBufferHdr with NV12 buffers for OMX component */
-				pBufferHdr->pBuffer= (OMX_U8 *)(pProxy->gralloc_handle[nBufIndex]->fd[0]);
-				((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1 = (OMX_PTR)(pProxy->gralloc_handle[nBufIndex]->fd[1]);
+				pBufferHdr->pBuffer= (OMX_U8 *)(pNV12Handle->fd[0]);
+				((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1 = (OMX_PTR)(pNV12Handle->fd[1]);
 			}
 #endif
 #endif
 		}
 		else
 		{
-			return OMX_ErrorBadParameter;
+			DOMX_ERROR("MetadataBufferType is unknow. Returning 'OMX_ErrorBadParameter'");
+			eError = OMX_ErrorBadParameter;
+			goto EXIT; //need to restore lenght fields in pBufferHdr
 		}
 #ifdef ENABLE_GRALLOC_BUFFER
 		eRPCError = RPC_RegisterBuffer(pCompPrv->hRemoteComp, pBufferHdr->pBuffer,-1,
@@ -837,17 +816,13 @@ OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 	}
 
 	eError = PROXY_EmptyThisBuffer(hComponent, pBufferHdr);
-#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-	if (pProxy->bAndroidOpaqueFormat)
-	{
-		/*Write buffer to end of pipe for re-circulation for future ETB()*/
-		eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &nBufIndex,
-					    sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-		PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, "Pipe write failed");
-	}
-#endif
 
 EXIT:
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+	/* The NV12 buffer is only kept if the frame made it to the encoder */
+	if (eError != OMX_ErrorNone && pNV12Handle != NULL)
+		COLORCONVERT_ReleaseBuffer(pProxy->hCC, pBufferHdr);
+#endif
 		if( pBufferHdr!=NULL && pCompPrv!=NULL)
 	    {
 		    if(pCompPrv->proxyPortBuffers[pBufferHdr->nInputPortIndex].proxyBufferType == EncoderMetadataPointers)
@@ -869,56 +844,15 @@ static OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_AllocateBuffer(OMX_HANDLETYPE hComponent
 		     OMX_PTR pAppPrivate, OMX_U32 nSizeBytes)
 {
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
-	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
-	OMX_CONFIG_RECTTYPE tParamRect;
-	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
-        DOMX_DEBUG(" ++LOCAL_PROXY_MPEG4E_AllocateBuffer");
-	int err, nStride;
 
 	PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
 	    NULL);
-	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
-	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-
-	if((nPortIndex == OMX_MPEG4E_INPUT_PORT) &&
-	   (pProxy->bAndroidOpaqueFormat))
-	{
-		tParamRect.nSize = sizeof(OMX_CONFIG_RECTTYPE);
-		tParamRect.nVersion.s.nVersionMajor = 1;
-		tParamRect.nVersion.s.nVersionMinor = 1;
-		tParamRect.nVersion.s.nRevision = 0;
-		tParamRect.nVersion.s.nStep = 0;
-		tParamRect.nPortIndex = nPortIndex;
-
-		eError = PROXY_GetParameter(hComponent, (OMX_INDEXTYPE)OMX_TI_IndexParam2DBufferAllocDimension, &tParamRect);
-		PROXY_assert(eError == OMX_ErrorNone, eError," Error in Proxy GetParameter from 2d index in allocate buffer");
-
-		err = pProxy->mAllocDev->alloc(pProxy->mAllocDev,(int) tParamRect.nWidth,(int) tParamRect.nHeight,
-			(int) HAL_PIXEL_FORMAT_TI_NV12,(int) GRALLOC_USAGE_HW_RENDER,
-			(const struct native_handle_t **)(&(pProxy->gralloc_handle[pProxy->nCurBufIndex])), &nStride);
-	}
 
+	/* NV12 buffers for opaque input come from the shared pool on ETB */
 	eError = PROXY_AllocateBuffer(hComponent, ppBufferHdr, nPortIndex,
 				      pAppPrivate, nSizeBytes);
 EXIT:
-	if((nPortIndex == OMX_MPEG4E_INPUT_PORT) &&
-	   (pProxy->bAndroidOpaqueFormat))
-	{
-		if(eError != OMX_ErrorNone)
-		{
-			err = pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[pProxy->nCurBufIndex]));
-		}
-		else
-		{
-			/*Populate buffer to pipe*/
-			eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &pProxy->nCurBufIndex,
-						    sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-			pProxy->nCurBufIndex++;
-		}
-	}
-        DOMX_DEBUG(" --LOCAL_PROXY_MPEG4E_AllocateBuffer");
 	return eError;
 }
 
@@ -928,7 +862,6 @@ static OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_FreeBuffer(OMX_IN OMX_HANDLETYPE hCompon
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	PROXY_COMPONENT_PRIVATE *pCompPrv = NULL;
-	OMX_U32 nBufIndex, nSize, nCount=0;
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
 
 	PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
@@ -939,23 +872,8 @@ static OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_FreeBuffer(OMX_IN OMX_HANDLETYPE hCompon
 	if((nPortIndex == OMX_MPEG4E_INPUT_PORT) &&
 	   (pProxy->bAndroidOpaqueFormat))
 	{
-		pProxy->nCurBufIndex--;
-		PROXY_require(pProxy->nCurBufIndex >=0,
-			      OMX_ErrorBadParameter, "Buffer index underflow");
-
-		if(pProxy->gralloc_handle[pProxy->nCurBufIndex])
-		{
-			pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[pProxy->nCurBufIndex]));
-			pProxy->gralloc_handle[pProxy->nCurBufIndex] = NULL;
-		}
-
-		/*Clear the Bufindex pipe by dummy reads*/
-		TIMM_OSAL_GetPipeReadyMessageCount(pProxy->hBufPipe, (TIMM_OSAL_U32 *)&nCount);
-		if(nCount)
-		{
-			TIMM_OSAL_ReadFromPipe(pProxy->hBufPipe, &nBufIndex,
-					       sizeof(OMX_PTR), (TIMM_OSAL_U32 *)&nSize, TIMM_OSAL_NO_SUSPEND);
-		}
+		/* Drop the pool buffer of a frame that never came back */
+		COLORCONVERT_ReleaseBuffer(pProxy->hCC, pBufferHdr);
 	}
 
 	eError = PROXY_FreeBuffer(hComponent, nPortIndex, pBufferHdr);
@@ -970,37 +888,14 @@ OMX_ERRORTYPE LOCAL_PROXY_MPEG4E_ComponentDeInit(OMX_HANDLETYPE hComponent)
 	PROXY_COMPONENT_PRIVATE *pCompPrv;
 	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
 	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-	TIMM_OSAL_ERRORTYPE eOSALStatus = TIMM_OSAL_ERR_NONE;
-	OMX_U32 i;
 
 	PROXY_require(hComp->pComponentPrivate != NULL, OMX_ErrorBadParameter,
 	    NULL);
 	pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
 	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
 
-	if(pProxy->hBufPipe != NULL)
-	{
-		eOSALStatus = TIMM_OSAL_DeletePipe(pProxy->hBufPipe);
-		pProxy->hBufPipe = NULL;
-
-		if(eOSALStatus != TIMM_OSAL_ERR_NONE)
-		{
-			DOMX_ERROR("Pipe deletion failed");
-		}
-	}
-
 	if(pProxy->bAndroidOpaqueFormat == OMX_TRUE)
 	{
-		/* Cleanup internal buffers in pipe if not freed on FreeBuffer */
-		for(i=0; i<OMX_MPEG4E_NUM_INTERNAL_BUF; i++)
-		{
-			if(pProxy->gralloc_handle[i])
-			{
-				pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[i]));
-				pProxy->gralloc_handle[i] = NULL;
-			}
-		}
-
 		COLORCONVERT_close(pProxy->hCC,pCompPrv);
 		pProxy->bAndroidOpaqueFormat = OMX_FALSE;
 
@@ -1016,61 +911,4 @@ EXIT:
 	DOMX_EXIT("eError: %d", eError);
 	return eError;
 }
-
-int COLORCONVERT_open(void **hCC, PROXY_COMPONENT_PRIVATE *pCompPrv)
-{
-	int nErr = -1;
-	hw_module_t const* module = NULL;
-	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-
-	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-	nErr = hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module);
-
-	if (nErr == 0)
-	{
-		*hCC = (void *) ((IMG_gralloc_module_public_t const *)module);
-	}
-	else
-	{
-		 DOMX_ERROR("FATAL: gralloc api hw_get_module() returned error: Can't find \
-			    %s module err = %x", GRALLOC_HARDWARE_MODULE_ID, nErr);
-	}
-
-	gralloc_open(module, &(pProxy->mAllocDev));
-
-	return nErr;
-}
-
-int COLORCONVERT_PlatformOpaqueToNV12(void *hCC,
-				      void *pSrc[COLORCONVERT_MAX_SUB_BUFFERS],
-				      void *pDst[COLORCONVERT_MAX_SUB_BUFFERS],
-				      int nWidth, int nHeight, int nStride,
-				      int nSrcBufType,int nDstBufType)
-{
-	IMG_gralloc_module_public_t const* module = hCC;
-	int nErr = -1;
-
-	if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_VIRTUAL))
-	{
-		nErr = module->Blit(module, pSrc[0], pDst, HAL_PIXEL_FORMAT_TI_NV12);
-
-	}
-	else if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE ))
-	{
-		nErr = module->Blit2(module, pSrc[0], pDst[0], nWidth, nHeight, 0, 0);
-	}
-
-	return nErr;
-}
-
-int COLORCONVERT_close(void *hCC,PROXY_COMPONENT_PRIVATE *pCompPrv)
-{
-	OMX_PROXY_ENCODER_PRIVATE *pProxy = NULL;
-	pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-	if(pProxy && pProxy->mAllocDev)
-	{
-		gralloc_close(pProxy->mAllocDev);
-	}
-	return 0;
-}
 #endif
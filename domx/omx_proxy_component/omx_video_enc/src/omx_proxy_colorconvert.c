@@ -0,0 +1,708 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ *  @file  omx_proxy_colorconvert.c
+ *         Colour conversion engine of the encoder proxies for clients that
+ *         feed gralloc RGB buffers (ANDROID_CUSTOM_OPAQUECOLORFORMAT).
+ *         Built as its own library so that every encoder of the process
+ *         shares one gralloc client and one pool of NV12 scratch buffers.
+ *         A buffer is taken from the pool on EmptyThisBuffer and goes back
+ *         on EmptyBufferDone, so encoders only pin what is in flight.
+ *
+ *         The CPU backend cuts the frame into bands of line pairs, one band
+ *         per thread, and converts every line pair 16 pixels at a time with
+ *         NEON.
+ *
+ *  @path WTSD_DucatiMMSW\omx\omx_il_1_x\omx_proxy_component\omx_video_enc\src
+ *
+ *  @rev 1.0
+ */
+
+/******************************************************************
+ *   INCLUDE FILES
+ ******************************************************************/
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <cutils/properties.h>
+#include <hardware/gralloc.h>
+#include <hal_public.h>
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#include "omx_proxy_common.h"
+#include <timm_osal_interfaces.h>
+#include "OMX_TI_IVCommon.h"
+#include "OMX_TI_Video.h"
+#include "OMX_TI_Index.h"
+#include "omx_proxy_colorconvert.h"
+
+#ifndef HW_ALIGN
+#define HW_ALIGN 32
+#endif
+
+#define COLORCONVERT_ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+/*One band of line pairs to convert */
+typedef struct COLORCONVERT_NEON_JOB
+{
+	const uint8_t *pSrc;
+	int nSrcStride;
+	uint8_t *pY;
+	uint8_t *pUV;
+	int nDstStride;
+	int nWidth;
+	int nHeight;
+	int nFirstLine;
+	int nLastLine;
+	int bBGR;
+} COLORCONVERT_NEON_JOB;
+
+/*One NV12 scratch buffer of the pool. pOwner/pBufferHdr are set while the
+  buffer holds a frame queued to an encoder */
+typedef struct COLORCONVERT_POOL_ENTRY
+{
+	IMG_native_handle_t *pHandle;
+	int nWidth;
+	int nHeight;
+	struct COLORCONVERT_CLIENT *pOwner;
+	OMX_BUFFERHEADERTYPE *pBufferHdr;
+} COLORCONVERT_POOL_ENTRY;
+
+/*One encoder proxy using the engine */
+typedef struct COLORCONVERT_CLIENT
+{
+	PROXY_COMPONENT_PRIVATE *pCompPrv;
+	PROXY_EMPTYBUFFER_DONE proxyEmptyBufferDone;
+	int nWidth;
+	int nHeight;
+	OMX_U32 nPortDefEpoch;
+	struct COLORCONVERT_CLIENT *pNext;
+} COLORCONVERT_CLIENT;
+
+/*Engine state, protected by tEngineLock */
+static pthread_mutex_t tEngineLock = PTHREAD_MUTEX_INITIALIZER;
+static IMG_gralloc_module_public_t const *pGrallocModule = NULL;
+static alloc_device_t *pAllocDev = NULL;
+static COLORCONVERT_CLIENT *pClients = NULL;
+static COLORCONVERT_POOL_ENTRY tPool[COLORCONVERT_POOL_SIZE];
+
+static pthread_once_t tBackendOnce = PTHREAD_ONCE_INIT;
+static int bNeonSelected = 0;
+static TIMM_OSAL_U32 uBandCpuMask = 0;
+
+static void COLORCONVERT_NEON_ReadBackend(void)
+{
+	char value[PROPERTY_VALUE_MAX];
+
+	property_get(COLORCONVERT_BACKEND_PROPERTY, value, "gpu");
+	bNeonSelected = (strcmp(value, "neon") == 0);
+	property_get(COLORCONVERT_NEON_CPUS_PROPERTY, value, "0");
+	uBandCpuMask = strtoul(value, NULL, 0);
+}
+
+int COLORCONVERT_NEON_IsSelected(void)
+{
+	pthread_once(&tBackendOnce, COLORCONVERT_NEON_ReadBackend);
+	return bNeonSelected;
+}
+
+static inline uint8_t COLORCONVERT_Clip(int nValue)
+{
+	return (uint8_t) (nValue < 0 ? 0 : (nValue > 255 ? 255 : nValue));
+}
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_NEON_LinePair()
+ * @brief Converts two source lines into two Y lines and one UV line.
+ *        pSrc1/pY1 may alias pSrc0/pY0 for the last line of an odd height.
+ */
+/* ===========================================================================*/
+static void COLORCONVERT_NEON_LinePair(const uint8_t *pSrc0,
+				       const uint8_t *pSrc1, uint8_t *pY0,
+				       uint8_t *pY1, uint8_t *pUV, int nWidth,
+				       int bBGR)
+{
+	int nR = bBGR ? 2 : 0, nB = bBGR ? 0 : 2;
+	int x = 0, i = 0, j = 0;
+
+#ifdef __ARM_NEON__
+	const uint8x8_t vYR = vdup_n_u8(66), vYG = vdup_n_u8(129),
+	    vYB = vdup_n_u8(25), vYOff = vdup_n_u8(16);
+	const int16x8_t vUVOff = vdupq_n_s16(128);
+
+	for (x = 0; x + 16 <= nWidth; x += 16)
+	{
+		uint8x16x4_t tPix0 = vld4q_u8(pSrc0 + 4 * x);
+		uint8x16x4_t tPix1 = vld4q_u8(pSrc1 + 4 * x);
+		uint8x16_t r0 = bBGR ? tPix0.val[2] : tPix0.val[0];
+		uint8x16_t b0 = bBGR ? tPix0.val[0] : tPix0.val[2];
+		uint8x16_t r1 = bBGR ? tPix1.val[2] : tPix1.val[0];
+		uint8x16_t b1 = bBGR ? tPix1.val[0] : tPix1.val[2];
+		uint8x16_t g0 = tPix0.val[1], g1 = tPix1.val[1];
+		uint16x8_t lo, hi;
+		int16x8_t r, g, b, u, v;
+		uint8x8x2_t tUV;
+
+		/*Y = ((66R + 129G + 25B + 128) >> 8) + 16, fits in 16 bits */
+		lo = vmull_u8(vget_low_u8(r0), vYR);
+		lo = vmlal_u8(lo, vget_low_u8(g0), vYG);
+		lo = vmlal_u8(lo, vget_low_u8(b0), vYB);
+		hi = vmull_u8(vget_high_u8(r0), vYR);
+		hi = vmlal_u8(hi, vget_high_u8(g0), vYG);
+		hi = vmlal_u8(hi, vget_high_u8(b0), vYB);
+		vst1q_u8(pY0 + x, vcombine_u8(vadd_u8(vrshrn_n_u16(lo, 8), vYOff),
+			vadd_u8(vrshrn_n_u16(hi, 8), vYOff)));
+
+		lo = vmull_u8(vget_low_u8(r1), vYR);
+		lo = vmlal_u8(lo, vget_low_u8(g1), vYG);
+		lo = vmlal_u8(lo, vget_low_u8(b1), vYB);
+		hi = vmull_u8(vget_high_u8(r1), vYR);
+		hi = vmlal_u8(hi, vget_high_u8(g1), vYG);
+		hi = vmlal_u8(hi, vget_high_u8(b1), vYB);
+		vst1q_u8(pY1 + x, vcombine_u8(vadd_u8(vrshrn_n_u16(lo, 8), vYOff),
+			vadd_u8(vrshrn_n_u16(hi, 8), vYOff)));
+
+		/*Chroma from the average of each 2x2 block */
+		r = vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(r0),
+			    vpaddlq_u8(r1)), 2));
+		g = vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(g0),
+			    vpaddlq_u8(g1)), 2));
+		b = vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(b0),
+			    vpaddlq_u8(b1)), 2));
+
+		u = vmulq_n_s16(b, 112);
+		u = vmlsq_n_s16(u, r, 38);
+		u = vmlsq_n_s16(u, g, 74);
+		v = vmulq_n_s16(r, 112);
+		v = vmlsq_n_s16(v, g, 94);
+		v = vmlsq_n_s16(v, b, 18);
+
+		tUV.val[0] = vqmovun_s16(vaddq_s16(vrshrq_n_s16(u, 8), vUVOff));
+		tUV.val[1] = vqmovun_s16(vaddq_s16(vrshrq_n_s16(v, 8), vUVOff));
+		vst2_u8(pUV + x, tUV);
+	}
+#endif
+
+	for (; x < nWidth; x += 2)
+	{
+		int nSumR = 0, nSumG = 0, nSumB = 0;
+		int nCols = (x + 1 < nWidth) ? 2 : 1;
+
+		for (i = 0; i < 2; i++)
+		{
+			const uint8_t *pLine = i ? pSrc1 : pSrc0;
+			uint8_t *pYLine = i ? pY1 : pY0;
+
+			for (j = 0; j < 2; j++)
+			{
+				const uint8_t *p =
+				    pLine + 4 * (x + (j < nCols ? j : 0));
+				if (j < nCols)
+				{
+					pYLine[x + j] = (uint8_t) (((66 * p[nR] +
+						    129 * p[1] + 25 * p[nB] +
+						    128) >> 8) + 16);
+				}
+				nSumR += p[nR];
+				nSumG += p[1];
+				nSumB += p[nB];
+			}
+		}
+		nSumR = (nSumR + 2) >> 2;
+		nSumG = (nSumG + 2) >> 2;
+		nSumB = (nSumB + 2) >> 2;
+		pUV[x] = COLORCONVERT_Clip(((112 * nSumB - 38 * nSumR -
+			    74 * nSumG + 128) >> 8) + 128);
+		pUV[x + 1] = COLORCONVERT_Clip(((112 * nSumR - 94 * nSumG -
+			    18 * nSumB + 128) >> 8) + 128);
+	}
+}
+
+static void *COLORCONVERT_NEON_Band(void *pArg)
+{
+	COLORCONVERT_NEON_JOB *pJob = (COLORCONVERT_NEON_JOB *) pArg;
+	int nLine = 0, nNext = 0;
+
+	for (nLine = pJob->nFirstLine; nLine < pJob->nLastLine; nLine += 2)
+	{
+		nNext = (nLine + 1 < pJob->nHeight) ? nLine + 1 : nLine;
+		COLORCONVERT_NEON_LinePair(pJob->pSrc + nLine * pJob->nSrcStride,
+		    pJob->pSrc + nNext * pJob->nSrcStride,
+		    pJob->pY + nLine * pJob->nDstStride,
+		    pJob->pY + nNext * pJob->nDstStride,
+		    pJob->pUV + (nLine / 2) * pJob->nDstStride,
+		    pJob->nWidth, pJob->bBGR);
+	}
+	return NULL;
+}
+
+/*Entry of the band threads, band 0 stays on the caller and is not renamed */
+static void *COLORCONVERT_NEON_BandThread(void *pArg)
+{
+	TIMM_OSAL_TASK_PARAMS tParams = { TIMM_OSAL_SCHED_INHERIT, 0, 0, 0 };
+
+	tParams.uCpuMask = uBandCpuMask;
+	TIMM_OSAL_SetTaskParams(&tParams, (const TIMM_OSAL_S8 *)"domx-cc-band");
+	return COLORCONVERT_NEON_Band(pArg);
+}
+
+int COLORCONVERT_NEON_OpaqueToNV12(IMG_gralloc_module_public_t const *module,
+				   IMG_native_handle_t *pSrc,
+				   IMG_native_handle_t *pDst,
+				   int nWidth, int nHeight, int nStride)
+{
+	COLORCONVERT_NEON_JOB tJobs[COLORCONVERT_NEON_THREADS];
+	pthread_t tThreads[COLORCONVERT_NEON_THREADS];
+	int bStarted[COLORCONVERT_NEON_THREADS];
+	void *pSrcAddr = NULL;
+	void *pDstAddr[2] = { NULL, NULL };
+	int bBGR = 0, bSrcLocked = 0, bDstLocked = 0;
+	int nBandLines = 0, i = 0, nErr = -1;
+
+	if (module == NULL || pSrc == NULL || pDst == NULL || nWidth <= 0 ||
+	    nHeight <= 0)
+		goto EXIT;
+
+	switch (pSrc->iFormat)
+	{
+	case HAL_PIXEL_FORMAT_RGBA_8888:
+	case HAL_PIXEL_FORMAT_RGBX_8888:
+		bBGR = 0;
+		break;
+	case HAL_PIXEL_FORMAT_BGRA_8888:
+		bBGR = 1;
+		break;
+	default:
+		DOMX_DEBUG("No CPU conversion for format 0x%x", pSrc->iFormat);
+		goto EXIT;
+	}
+
+	if (module->base.lock(&module->base, (buffer_handle_t) pSrc,
+		GRALLOC_USAGE_SW_READ_OFTEN, 0, 0, nWidth, nHeight,
+		&pSrcAddr) != 0 || pSrcAddr == NULL)
+	{
+		DOMX_ERROR("Locking the opaque source buffer failed");
+		goto EXIT;
+	}
+	bSrcLocked = 1;
+	/*TI NV12 buffers hand back the Y and the UV plane */
+	if (module->base.lock(&module->base, (buffer_handle_t) pDst,
+		GRALLOC_USAGE_SW_WRITE_OFTEN, 0, 0, nWidth, nHeight,
+		pDstAddr) != 0 || pDstAddr[0] == NULL || pDstAddr[1] == NULL)
+	{
+		DOMX_ERROR("Locking the NV12 destination buffer failed");
+		goto EXIT;
+	}
+	bDstLocked = 1;
+
+	nBandLines = ((nHeight + 1) / 2 + COLORCONVERT_NEON_THREADS - 1) /
+	    COLORCONVERT_NEON_THREADS * 2;
+	for (i = 0; i < COLORCONVERT_NEON_THREADS; i++)
+	{
+		tJobs[i].pSrc = (const uint8_t *) pSrcAddr;
+		tJobs[i].nSrcStride =
+		    COLORCONVERT_ALIGN(pSrc->iWidth, HW_ALIGN) * 4;
+		tJobs[i].pY = (uint8_t *) pDstAddr[0];
+		tJobs[i].pUV = (uint8_t *) pDstAddr[1];
+		tJobs[i].nDstStride = nStride;
+		tJobs[i].nWidth = nWidth;
+		tJobs[i].nHeight = nHeight;
+		tJobs[i].bBGR = bBGR;
+		tJobs[i].nFirstLine = i * nBandLines;
+		tJobs[i].nLastLine = (i + 1) * nBandLines;
+		if (tJobs[i].nFirstLine > nHeight)
+			tJobs[i].nFirstLine = nHeight;
+		if (tJobs[i].nLastLine > nHeight)
+			tJobs[i].nLastLine = nHeight;
+		bStarted[i] = 0;
+	}
+
+	/*Band 0 runs here, the others on their own threads. A band that
+	  cannot get a thread is done inline afterwards */
+	for (i = 1; i < COLORCONVERT_NEON_THREADS; i++)
+	{
+		if (tJobs[i].nFirstLine < tJobs[i].nLastLine)
+			bStarted[i] = (pthread_create(&tThreads[i], NULL,
+				COLORCONVERT_NEON_BandThread, &tJobs[i]) == 0);
+	}
+	COLORCONVERT_NEON_Band(&tJobs[0]);
+	for (i = 1; i < COLORCONVERT_NEON_THREADS; i++)
+	{
+		if (bStarted[i])
+			pthread_join(tThreads[i], NULL);
+		else
+			COLORCONVERT_NEON_Band(&tJobs[i]);
+	}
+	nErr = 0;
+
+      EXIT:
+	if (bDstLocked)
+		module->base.unlock(&module->base, (buffer_handle_t) pDst);
+	if (bSrcLocked)
+		module->base.unlock(&module->base, (buffer_handle_t) pSrc);
+	return nErr;
+}
+
+/******************************************************************
+ *   NV12 POOL
+ ******************************************************************/
+
+static void COLORCONVERT_FreeEntry(COLORCONVERT_POOL_ENTRY *pEntry)
+{
+	if (pEntry->pHandle != NULL)
+	{
+		pAllocDev->free(pAllocDev, (buffer_handle_t) pEntry->pHandle);
+	}
+	TIMM_OSAL_Memset(pEntry, 0, sizeof(COLORCONVERT_POOL_ENTRY));
+}
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_Trim()
+ * @brief Frees the idle buffers no registered client can use any more.
+ *        Called with tEngineLock held.
+ */
+/* ===========================================================================*/
+static void COLORCONVERT_Trim(void)
+{
+	COLORCONVERT_CLIENT *pClient = NULL;
+	int i = 0, bWanted = 0;
+
+	for (i = 0; i < COLORCONVERT_POOL_SIZE; i++)
+	{
+		if (tPool[i].pHandle == NULL || tPool[i].pOwner != NULL)
+			continue;
+		bWanted = 0;
+		for (pClient = pClients; pClient != NULL;
+		    pClient = pClient->pNext)
+		{
+			if (pClient->nWidth == tPool[i].nWidth &&
+			    pClient->nHeight == tPool[i].nHeight)
+				bWanted = 1;
+		}
+		if (!bWanted)
+			COLORCONVERT_FreeEntry(&tPool[i]);
+	}
+}
+
+static COLORCONVERT_CLIENT *COLORCONVERT_FindClient(PROXY_COMPONENT_PRIVATE *
+    pCompPrv)
+{
+	COLORCONVERT_CLIENT *pClient = pClients;
+
+	while (pClient != NULL && pClient->pCompPrv != pCompPrv)
+		pClient = pClient->pNext;
+	return pClient;
+}
+
+static void COLORCONVERT_ReleaseLocked(COLORCONVERT_CLIENT *pClient,
+    OMX_BUFFERHEADERTYPE *pBufferHdr)
+{
+	int i = 0;
+
+	for (i = 0; i < COLORCONVERT_POOL_SIZE; i++)
+	{
+		if (tPool[i].pOwner == pClient &&
+		    (pBufferHdr == NULL || tPool[i].pBufferHdr == pBufferHdr))
+		{
+			tPool[i].pOwner = NULL;
+			tPool[i].pBufferHdr = NULL;
+		}
+	}
+}
+
+/* ===========================================================================*/
+/**
+ * @name COLORCONVERT_EmptyBufferDone()
+ * @brief Installed as proxyEmptyBufferDone of every client. Puts the NV12
+ *        buffer of the returned frame back into the pool before handing the
+ *        callback to the proxy.
+ */
+/* ===========================================================================*/
+static OMX_ERRORTYPE COLORCONVERT_EmptyBufferDone(OMX_HANDLETYPE hComponent,
+    OMX_U32 remoteBufHdr, OMX_U32 nfilledLen, OMX_U32 nOffset, OMX_U32 nFlags)
+{
+	OMX_COMPONENTTYPE *hComp = (OMX_COMPONENTTYPE *) hComponent;
+	PROXY_COMPONENT_PRIVATE *pCompPrv =
+	    (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
+	COLORCONVERT_CLIENT *pClient = NULL;
+	PROXY_EMPTYBUFFER_DONE proxyEmptyBufferDone = NULL;
+	OMX_U32 count = 0;
+
+	pthread_mutex_lock(&tEngineLock);
+	pClient = COLORCONVERT_FindClient(pCompPrv);
+	if (pClient != NULL)
+	{
+		proxyEmptyBufferDone = pClient->proxyEmptyBufferDone;
+		count = PROXY_FindBufferByRemote(pCompPrv, remoteBufHdr);
+		if (count < pCompPrv->nTotalBuffers)
+			COLORCONVERT_ReleaseLocked(pClient,
+			    PROXY_BUFLIST_ENTRY(pCompPrv, count).pBufHeader);
+	}
+	pthread_mutex_unlock(&tEngineLock);
+
+	if (proxyEmptyBufferDone == NULL)
+	{
+		DOMX_ERROR("EmptyBufferDone for a proxy not using the engine");
+		return OMX_ErrorBadParameter;
+	}
+	return proxyEmptyBufferDone(hComponent, remoteBufHdr, nfilledLen,
+	    nOffset, nFlags);
+}
+
+int COLORCONVERT_open(void **hCC, PROXY_COMPONENT_PRIVATE *pCompPrv)
+{
+	hw_module_t const *module = NULL;
+	COLORCONVERT_CLIENT *pClient = NULL;
+	int nErr = 0;
+
+	if (*hCC != NULL)
+		return 0;
+
+	pClient = (COLORCONVERT_CLIENT *)
+	    TIMM_OSAL_Malloc(sizeof(COLORCONVERT_CLIENT), TIMM_OSAL_TRUE, 0,
+	    TIMMOSAL_MEM_SEGMENT_INT);
+	if (pClient == NULL)
+		return -1;
+	TIMM_OSAL_Memset(pClient, 0, sizeof(COLORCONVERT_CLIENT));
+
+	pthread_mutex_lock(&tEngineLock);
+	if (pGrallocModule == NULL)
+	{
+		nErr = hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module);
+		if (nErr != 0)
+		{
+			DOMX_ERROR("FATAL: gralloc api hw_get_module() returned error: Can't find \
+			    %s module err = %x", GRALLOC_HARDWARE_MODULE_ID, nErr);
+			goto EXIT;
+		}
+		nErr = gralloc_open(module, &pAllocDev);
+		if (nErr != 0)
+		{
+			DOMX_ERROR("gralloc_open() failed err = %x", nErr);
+			pAllocDev = NULL;
+			goto EXIT;
+		}
+		pGrallocModule = (IMG_gralloc_module_public_t const *)module;
+	}
+
+	pClient->pCompPrv = pCompPrv;
+	pClient->proxyEmptyBufferDone = pCompPrv->proxyEmptyBufferDone;
+	pCompPrv->proxyEmptyBufferDone = COLORCONVERT_EmptyBufferDone;
+	pClient->pNext = pClients;
+	pClients = pClient;
+	*hCC = pClient;
+
+      EXIT:
+	pthread_mutex_unlock(&tEngineLock);
+	if (nErr != 0)
+		TIMM_OSAL_Free(pClient);
+	return nErr;
+}
+
+int COLORCONVERT_PlatformOpaqueToNV12(void *hCC,
+				      void *pSrc[COLORCONVERT_MAX_SUB_BUFFERS],
+				      void *pDst[COLORCONVERT_MAX_SUB_BUFFERS],
+				      int nWidth, int nHeight, int nStride,
+				      int nSrcBufType, int nDstBufType)
+{
+	IMG_gralloc_module_public_t const *module = pGrallocModule;
+	int nErr = -1;
+
+	if (hCC == NULL || module == NULL)
+		return nErr;
+
+	if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_VIRTUAL))
+	{
+		nErr = module->Blit(module, pSrc[0], pDst, HAL_PIXEL_FORMAT_TI_NV12);
+	}
+	else if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE ))
+	{
+		if (COLORCONVERT_NEON_IsSelected())
+			nErr = COLORCONVERT_NEON_OpaqueToNV12(module, pSrc[0],
+			    pDst[0], nWidth, nHeight, nStride);
+		/*Blit2 stays the default and covers what the CPU path cannot */
+		if (nErr != 0)
+			nErr = module->Blit2(module, pSrc[0], pDst[0], nWidth, nHeight, 0, 0);
+	}
+
+	return nErr;
+}
+
+OMX_ERRORTYPE COLORCONVERT_AcquireBuffer(void *hCC, OMX_HANDLETYPE hComponent,
+					 OMX_BUFFERHEADERTYPE *pBufferHdr,
+					 IMG_native_handle_t **ppNV12)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	COLORCONVERT_CLIENT *pClient = (COLORCONVERT_CLIENT *) hCC;
+	COLORCONVERT_POOL_ENTRY *pEntry = NULL;
+	OMX_CONFIG_RECTTYPE tParam;
+	OMX_U32 nEpoch = 0;
+	int i = 0, nStride = 0, err = 0, bLocked = 0;
+
+	PROXY_require(pClient != NULL && pBufferHdr != NULL && ppNV12 != NULL,
+	    OMX_ErrorBadParameter, NULL);
+
+	/*The allocation dimension only moves with the port definition */
+	nEpoch = pClient->pCompPrv->nPortDefEpoch;
+	if (pClient->nWidth == 0 || pClient->nPortDefEpoch != nEpoch)
+	{
+		tParam.nSize = sizeof(OMX_CONFIG_RECTTYPE);
+		tParam.nVersion.s.nVersionMajor = 1;
+		tParam.nVersion.s.nVersionMinor = 1;
+		tParam.nVersion.s.nRevision = 0;
+		tParam.nVersion.s.nStep = 0;
+		tParam.nPortIndex = pBufferHdr->nInputPortIndex;
+		eError = PROXY_GetParameter(hComponent,
+		    (OMX_INDEXTYPE) OMX_TI_IndexParam2DBufferAllocDimension,
+		    &tParam);
+		PROXY_assert(eError == OMX_ErrorNone, eError,
+		    " Error in Proxy GetParameter");
+		pthread_mutex_lock(&tEngineLock);
+		pClient->nWidth = (int) tParam.nWidth;
+		pClient->nHeight = (int) tParam.nHeight;
+		pClient->nPortDefEpoch = nEpoch;
+		COLORCONVERT_Trim();
+		pthread_mutex_unlock(&tEngineLock);
+	}
+
+	pthread_mutex_lock(&tEngineLock);
+	bLocked = 1;
+
+	/*A header queued again without its EmptyBufferDone gives back the
+	  buffer it still holds first */
+	COLORCONVERT_ReleaseLocked(pClient, pBufferHdr);
+
+	for (i = 0; i < COLORCONVERT_POOL_SIZE && pEntry == NULL; i++)
+	{
+		if (tPool[i].pHandle != NULL && tPool[i].pOwner == NULL &&
+		    tPool[i].nWidth == pClient->nWidth &&
+		    tPool[i].nHeight == pClient->nHeight)
+			pEntry = &tPool[i];
+	}
+	for (i = 0; i < COLORCONVERT_POOL_SIZE && pEntry == NULL; i++)
+	{
+		if (tPool[i].pHandle == NULL)
+			pEntry = &tPool[i];
+	}
+	/*Pool full: recycle an idle buffer of another size */
+	for (i = 0; i < COLORCONVERT_POOL_SIZE && pEntry == NULL; i++)
+	{
+		if (tPool[i].pOwner == NULL)
+		{
+			COLORCONVERT_FreeEntry(&tPool[i]);
+			pEntry = &tPool[i];
+		}
+	}
+	PROXY_assert(pEntry != NULL, OMX_ErrorInsufficientResources,
+	    "All NV12 buffers of the pool are in use");
+
+	if (pEntry->pHandle == NULL)
+	{
+		DOMX_DEBUG("Allocating a %dx%d NV12 buffer for the pool",
+		    pClient->nWidth, pClient->nHeight);
+		err = pAllocDev->alloc(pAllocDev, pClient->nWidth,
+		    pClient->nHeight, (int) HAL_PIXEL_FORMAT_TI_NV12,
+		    (int) GRALLOC_USAGE_HW_RENDER,
+		    (const struct native_handle_t **)(&pEntry->pHandle),
+		    &nStride);
+		if (err != 0)
+			pEntry->pHandle = NULL;
+		PROXY_assert(pEntry->pHandle != NULL,
+		    OMX_ErrorInsufficientResources,
+		    " Error in allocating Gralloc buffers");
+		pEntry->nWidth = pClient->nWidth;
+		pEntry->nHeight = pClient->nHeight;
+	}
+	pEntry->pOwner = pClient;
+	pEntry->pBufferHdr = pBufferHdr;
+	*ppNV12 = pEntry->pHandle;
+
+      EXIT:
+	if (bLocked)
+		pthread_mutex_unlock(&tEngineLock);
+	return eError;
+}
+
+void COLORCONVERT_ReleaseBuffer(void *hCC, OMX_BUFFERHEADERTYPE *pBufferHdr)
+{
+	if (hCC == NULL || pBufferHdr == NULL)
+		return;
+
+	pthread_mutex_lock(&tEngineLock);
+	COLORCONVERT_ReleaseLocked((COLORCONVERT_CLIENT *) hCC, pBufferHdr);
+	pthread_mutex_unlock(&tEngineLock);
+}
+
+int COLORCONVERT_close(void *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv)
+{
+	COLORCONVERT_CLIENT *pClient = (COLORCONVERT_CLIENT *) hCC;
+	COLORCONVERT_CLIENT **ppLink = NULL;
+	int i = 0;
+
+	if (pClient == NULL)
+		return 0;
+
+	pthread_mutex_lock(&tEngineLock);
+	if (pCompPrv != NULL &&
+	    pCompPrv->proxyEmptyBufferDone == COLORCONVERT_EmptyBufferDone)
+		pCompPrv->proxyEmptyBufferDone = pClient->proxyEmptyBufferDone;
+
+	COLORCONVERT_ReleaseLocked(pClient, NULL);
+	for (ppLink = &pClients; *ppLink != NULL; ppLink = &(*ppLink)->pNext)
+	{
+		if (*ppLink == pClient)
+		{
+			*ppLink = pClient->pNext;
+			break;
+		}
+	}
+	COLORCONVERT_Trim();
+
+	if (pClients == NULL && pAllocDev != NULL)
+	{
+		gralloc_close(pAllocDev);
+		pAllocDev = NULL;
+		pGrallocModule = NULL;
+	}
+	pthread_mutex_unlock(&tEngineLock);
+
+	TIMM_OSAL_Free(pClient);
+	return 0;
+}
+
+#endif /* ANDROID_CUSTOM_OPAQUECOLORFORMAT */
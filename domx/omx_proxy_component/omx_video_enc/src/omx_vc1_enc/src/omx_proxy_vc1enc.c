@@ -73,6 +73,9 @@
 #include <hal_public.h>
 #include <VideoMetadata.h>
 #endif
+#ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
+#include "omx_proxy_colorconvert.h"
+#endif
 
 #include <stdlib.h>
 #include <cutils/properties.h>
@@ -117,22 +120,8 @@ OMX_TICKS    nLastFrameRateUpdateTime = 0; /*Time stamp at last frame rate updat
  * ENABLE_GRALLOC_BUFFER
  * ANDROID_QUIRCK_CHANGE_PORT_VALUES
  */
-#define OMX_VC1VE_NUM_INTERNAL_BUF (8)
 #define HAL_PIXEL_FORMAT_TI_NV12 (0x100)
 
-#define COLORCONVERT_MAX_SUB_BUFFERS (3)
-
-#define COLORCONVERT_BUFTYPE_VIRTUAL (0x0)
-#define COLORCONVERT_BUFTYPE_ION     (0x1)
-#define COLORCONVERT_BUFTYPE_GRALLOCOPAQUE (0x2)
-
-int COLORCONVERT_open(void * *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv);
-int COLORCONVERT_PlatformOpaqueToNV12(void *hCC, void *pSrc[],
-                                      void *pDst[], int nWidth,
-                                      int nHeight, int nStride,
-                                      int nSrcBufType, int nDstBufType);
-int COLORCONVERT_close(void *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv);
-static int COLORCONVERT_AllocateBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nStride);
 static OMX_ERRORTYPE LOCAL_PROXY_VC1E_AllocateBuffer(OMX_IN OMX_HANDLETYPE hComponent,
                                                      OMX_INOUT OMX_BUFFERHEADERTYPE * *ppBufferHdr, OMX_IN OMX_U32 nPortIndex,
                                                      OMX_IN OMX_PTR pAppPrivate, OMX_IN OMX_U32 nSizeBytes);
@@ -323,7 +312,6 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
     pHandle = (OMX_COMPONENTTYPE *) hComponent;
     OMX_TI_PARAM_ENHANCEDPORTRECONFIG    tParamStruct;
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-    TIMM_OSAL_ERRORTYPE       eOSALStatus = TIMM_OSAL_ERR_NONE;
     OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
 #endif
     char       value[OMX_MAX_STRINGNAME_SIZE];
@@ -372,13 +360,6 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
                      sizeof(OMX_PROXY_ENCODER_PRIVATE));
 
     pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pComponentPrivate->pCompProxyPrv;
-
-    /* Create Pipe of for encoder input buffers */
-    eOSALStatus = TIMM_OSAL_CreatePipe(&pProxy->hBufPipe, sizeof(OMX_U32),
-                                       OMX_VC1VE_NUM_INTERNAL_BUF, 1);
-    PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE,
-                 OMX_ErrorInsufficientResources,
-                 "Pipe creation failed");
 #endif
 
     // Copying component Name - this will be picked up in the proxy common
@@ -389,6 +370,11 @@ OMX_ERRORTYPE OMX_ComponentInit(OMX_HANDLETYPE hComponent)
                      strlen(COMPONENT_NAME) + 1);
 
     eError = OMX_ProxyCommonInit(hComponent);   // Calling Proxy Common Init()
+    /* Rate control retuning goes out with the next frame */
+    if( eError == OMX_ErrorNone &&
+        PROXY_EnableConfigQueue(hComponent) != OMX_ErrorNone ) {
+        DOMX_WARN("No config queue, SetConfig stays synchronous");
+    }
 #ifdef ANDROID_QUIRK_CHANGE_PORT_VALUES
     pHandle->SetParameter = LOCAL_PROXY_VC1E_SetParameter;
     pHandle->GetParameter = LOCAL_PROXY_VC1E_GetParameter;
@@ -412,11 +398,6 @@ EXIT:
         DOMX_DEBUG("Error in Initializing Proxy");
 
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-        if( pProxy->hBufPipe != NULL ) {
-            TIMM_OSAL_DeletePipe(pProxy->hBufPipe);
-            pProxy->hBufPipe = NULL;
-        }
-
         if( pComponentPrivate->pCompProxyPrv != NULL ) {
             TIMM_OSAL_Free(pComponentPrivate->pCompProxyPrv);
             pComponentPrivate->pCompProxyPrv = NULL;
@@ -722,8 +703,8 @@ OMX_ERRORTYPE LOCAL_PROXY_VC1E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
 
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
     OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
-    TIMM_OSAL_ERRORTYPE       eOSALStatus = TIMM_OSAL_ERR_NONE;
-    OMX_U32                   nBufIndex = 0, nSize=0, nRet=0;
+    IMG_native_handle_t      *pNV12Handle = NULL;
+    OMX_U32                   nRet=0;
 #endif
 #ifdef ENABLE_GRALLOC_BUFFER
     OMX_PTR                pAuxBuf0 = NULL, pAuxBuf1 = NULL;
@@ -747,7 +728,7 @@ OMX_ERRORTYPE LOCAL_PROXY_VC1E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
     OMX_INIT_STRUCT(tParamStruct, OMX_PARAM_PORTDEFINITIONTYPE);
     tParamStruct.nPortIndex = OMX_VC1E_INPUT_PORT;
 
-    eError = PROXY_GetParameter(hComponent, OMX_IndexParamPortDefinition, &tParamStruct);
+    eError = PROXY_GetCachedPortDefinition(hComponent, &tParamStruct);
     PROXY_require(eError == OMX_ErrorNone, OMX_ErrorBadParameter, "Error is Get Parameter for port def");
     nFilledLen = pBufferHdr->nFilledLen;
     nAllocLen = pBufferHdr->nAllocLen;
@@ -779,16 +760,6 @@ OMX_ERRORTYPE LOCAL_PROXY_VC1E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
             pVideoMetadataBuffer = (video_metadata_t *) ((OMX_U32 *)(pBufferHdr->pBuffer));
             pGrallocHandle = (IMG_native_handle_t *) (pVideoMetadataBuffer->handle);
             DOMX_DEBUG("Grallloc buffer recieved in metadata buffer 0x%x", pGrallocHandle);
-            if( pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12 && pProxy->gralloc_handle[0] == NULL ) {
-                DOMX_DEBUG("Allocating NV12 buffers internally within DOMX actual count: %d", pCompPrv->nAllocatedBuffers);
-                pProxy->nCurBufIndex = 0;
-
-                while((unsigned) pProxy->nCurBufIndex < pCompPrv->nAllocatedBuffers ) {
-                    eError = COLORCONVERT_AllocateBuffer(hComponent, nStride);
-                    PROXY_require(eError == OMX_ErrorNone, eError, "Error allocating buffers for color conversion");
-                    pProxy->nCurBufIndex++;
-                }
-            }
             pBufferHdr->pBuffer = (OMX_U8 *)(pGrallocHandle->fd[0]);
             ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->
             pAuxBuf1 = (OMX_PTR) pGrallocHandle->fd[1];
@@ -806,16 +777,6 @@ OMX_ERRORTYPE LOCAL_PROXY_VC1E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
             tBufHandle =  *((buffer_handle_t *)pTempBuffer);
             pGrallocHandle = (IMG_native_handle_t *) tBufHandle;
             DOMX_DEBUG("Grallloc buffer recieved in metadata buffer 0x%x", pGrallocHandle);
-            if( pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12 && pProxy->gralloc_handle[0] == NULL ) {
-                DOMX_DEBUG("Allocating NV12 buffers internally within DOMX actual count: %d", pCompPrv->nAllocatedBuffers);
-                pProxy->nCurBufIndex = 0;
-
-                while((unsigned) pProxy->nCurBufIndex < pCompPrv->nAllocatedBuffers ) {
-                    eError = COLORCONVERT_AllocateBuffer(hComponent, nStride);
-                    PROXY_require(eError == OMX_ErrorNone, eError, "Error allocating buffers for color conversion");
-                    pProxy->nCurBufIndex++;
-                }
-            }
 
             pBufferHdr->pBuffer = (OMX_U8 *)(pGrallocHandle->fd[0]);
             ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->
@@ -824,30 +785,26 @@ OMX_ERRORTYPE LOCAL_PROXY_VC1E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
                        pGrallocHandle->fd[0], pGrallocHandle->fd[1]);
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
             if( pProxy->bAndroidOpaqueFormat && pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12 ) {
-                /* Dequeue NV12 buffer for encoder */
-                eOSALStatus = TIMM_OSAL_ReadFromPipe(pProxy->hBufPipe, &nBufIndex,
-                                                     sizeof(OMX_PTR), (TIMM_OSAL_U32 *)(&nSize),
-                                                     TIMM_OSAL_SUSPEND);
-                PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, NULL);
+                /* Take an NV12 buffer from the shared pool, it goes back on EmptyBufferDone */
+                eError = COLORCONVERT_AcquireBuffer(pProxy->hCC, hComponent, pBufferHdr, &pNV12Handle);
+                PROXY_assert(eError == OMX_ErrorNone, eError, "No NV12 buffer for color conversion");
 
                 if( nFilledLen != 0 ) {
                     /* Get NV12 data after colorconv*/
-                    nRet = COLORCONVERT_PlatformOpaqueToNV12(pProxy->hCC, (void * *) &pGrallocHandle, (void * *) &pProxy->gralloc_handle[nBufIndex],
+                    nRet = COLORCONVERT_PlatformOpaqueToNV12(pProxy->hCC, (void * *) &pGrallocHandle, (void * *) &pNV12Handle,
                                                              pGrallocHandle->iWidth,
                                                              pGrallocHandle->iHeight,
                                                              4096, COLORCONVERT_BUFTYPE_GRALLOCOPAQUE,
                                                              COLORCONVERT_BUFTYPE_GRALLOCOPAQUE);
 
                     if( nRet != 0 ) {
-                        eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &nBufIndex,
-                                                            sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
                         PROXY_assert(0, OMX_ErrorBadParameter, "Color conversion routine failed");
                     }
                 }
 
                 /* Update pBufferHdr with NV12 buffers for OMX component */
-                pBufferHdr->pBuffer= (OMX_U8 *)(pProxy->gralloc_handle[nBufIndex]->fd[0]);
-                ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1 = (OMX_PTR)(pProxy->gralloc_handle[nBufIndex]->fd[1]);
+                pBufferHdr->pBuffer= (OMX_U8 *)(pNV12Handle->fd[0]);
+                ((OMX_TI_PLATFORMPRIVATE *) pBufferHdr->pPlatformPrivate)->pAuxBuf1 = (OMX_PTR)(pNV12Handle->fd[1]);
             }
 #endif
 #endif
@@ -871,20 +828,14 @@ OMX_ERRORTYPE LOCAL_PROXY_VC1E_EmptyThisBuffer(OMX_HANDLETYPE hComponent,
     }
 
     eError = PROXY_EmptyThisBuffer(hComponent, pBufferHdr);
+
+EXIT:
 #ifdef ANDROID_CUSTOM_OPAQUECOLORFORMAT
-    if( pProxy->bAndroidOpaqueFormat
-#ifdef ENABLE_GRALLOC_BUFFER
-        && pGrallocHandle != NULL && pGrallocHandle->iFormat != HAL_PIXEL_FORMAT_TI_NV12
-#endif
-        ) {
-        /*Write buffer to end of pipe for re-circulation for future ETB()*/
-        eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &nBufIndex,
-                                            sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-        PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, "Pipe write failed");
+    /* The NV12 buffer is only kept if the frame made it to the encoder */
+    if( eError != OMX_ErrorNone && pNV12Handle != NULL ) {
+        COLORCONVERT_ReleaseBuffer(pProxy->hCC, pBufferHdr);
     }
 #endif
-
-EXIT:
     if( pBufferHdr != NULL && pCompPrv->proxyPortBuffers[pBufferHdr->nInputPortIndex].proxyBufferType == EncoderMetadataPointers ) {
         pBufferHdr->pBuffer = pBufferOrig;
         pBufferHdr->nFilledLen = nFilledLen;
@@ -955,7 +906,6 @@ static OMX_ERRORTYPE LOCAL_PROXY_VC1E_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponen
     OMX_ERRORTYPE              eError = OMX_ErrorNone;
     OMX_COMPONENTTYPE         *hComp = (OMX_COMPONENTTYPE *) hComponent;
     PROXY_COMPONENT_PRIVATE   *pCompPrv = NULL;
-    OMX_U32                    nBufIndex, nSize, nCount=0;
     OMX_PROXY_ENCODER_PRIVATE    *pProxy = NULL;
 
     DOMX_ENTER("%s hComponent = %p, nPortIndex = %d, pBufferHdr = %p",
@@ -967,22 +917,9 @@ static OMX_ERRORTYPE LOCAL_PROXY_VC1E_FreeBuffer(OMX_IN OMX_HANDLETYPE hComponen
     pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
 
     if((nPortIndex == OMX_VC1E_INPUT_PORT) &&
-       (pProxy->bAndroidOpaqueFormat) && (pProxy->gralloc_handle[0] != NULL)) {
-        pProxy->nCurBufIndex--;
-        PROXY_require(pProxy->nCurBufIndex >= 0,
-                      OMX_ErrorBadParameter, "Buffer index underflow");
-
-        if( pProxy->gralloc_handle[pProxy->nCurBufIndex] ) {
-            pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[pProxy->nCurBufIndex]));
-            pProxy->gralloc_handle[pProxy->nCurBufIndex] = NULL;
-        }
-
-        /*Clear the Bufindex pipe by dummy reads*/
-        TIMM_OSAL_GetPipeReadyMessageCount(pProxy->hBufPipe, (TIMM_OSAL_U32 *)&nCount);
-        if( nCount ) {
-            TIMM_OSAL_ReadFromPipe(pProxy->hBufPipe, &nBufIndex,
-                                   sizeof(OMX_PTR), (TIMM_OSAL_U32 *)&nSize, TIMM_OSAL_NO_SUSPEND);
-        }
+       (pProxy->bAndroidOpaqueFormat)) {
+        /* Drop the pool buffer of a frame that never came back */
+        COLORCONVERT_ReleaseBuffer(pProxy->hCC, pBufferHdr);
     }
 
     eError = PROXY_FreeBuffer(hComponent, nPortIndex, pBufferHdr);
@@ -992,44 +929,6 @@ EXIT:
     return (eError);
 }
 
-/* ===========================================================================*/
-/**
- * @name COLORCONVERT_AllocateBuffer()
- * @brief Allocating gralloc buffers for color conversion
- * @param hComponent  : pointer to the OMX Component.
- * @param nStride     : Stride of the frame.
- * @return OMX_ErrorNone = Successful
- *
- */
-/* ===========================================================================*/
-int COLORCONVERT_AllocateBuffer(OMX_HANDLETYPE hComponent, OMX_U32 nStride)
-{
-    OMX_CONFIG_RECTTYPE        tParam;
-    TIMM_OSAL_ERRORTYPE        eOSALStatus = TIMM_OSAL_ERR_NONE;
-    OMX_U32                    err;
-    OMX_ERRORTYPE              eError = OMX_ErrorNone;
-    PROXY_COMPONENT_PRIVATE   *pCompPrv = NULL;
-    OMX_PROXY_ENCODER_PRIVATE    *pProxy = NULL;
-    OMX_COMPONENTTYPE         *hComp = (OMX_COMPONENTTYPE *) hComponent;
-
-    pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
-    pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-
-    OMX_INIT_STRUCT(tParam, OMX_CONFIG_RECTTYPE);
-    tParam.nPortIndex = OMX_VC1E_INPUT_PORT;
-    eError = PROXY_GetParameter(hComponent, (OMX_INDEXTYPE)OMX_TI_IndexParam2DBufferAllocDimension, &tParam);
-    PROXY_assert(eError == OMX_ErrorNone, eError, " Error in Proxy GetParameter");
-    err = pProxy->mAllocDev->alloc(pProxy->mAllocDev, (int) tParam.nWidth, (int) tParam.nHeight,
-                                   (int) HAL_PIXEL_FORMAT_TI_NV12, (int) GRALLOC_USAGE_HW_RENDER,
-                                   (const struct native_handle_t * *)(&(pProxy->gralloc_handle[pProxy->nCurBufIndex])), (int *) &nStride);
-    PROXY_assert(!err, err, " Error in allocating Gralloc buffers");
-    eOSALStatus = TIMM_OSAL_WriteToPipe(pProxy->hBufPipe, (void *) &pProxy->nCurBufIndex, sizeof(OMX_U32), TIMM_OSAL_SUSPEND);
-    PROXY_assert(eOSALStatus == TIMM_OSAL_ERR_NONE, OMX_ErrorBadParameter, "Pipe write failed");
-
-EXIT:
-    return (eError);
-}
-
 /* ===========================================================================*/
 /**
  * @name PROXY_VC1E_ComponentDeInit()
@@ -1046,8 +945,6 @@ OMX_ERRORTYPE LOCAL_PROXY_VC1E_ComponentDeInit(OMX_HANDLETYPE hComponent)
     PROXY_COMPONENT_PRIVATE   *pCompPrv;
     OMX_COMPONENTTYPE         *hComp = (OMX_COMPONENTTYPE *) hComponent;
     OMX_PROXY_ENCODER_PRIVATE    *pProxy = NULL;
-    TIMM_OSAL_ERRORTYPE        eOSALStatus = TIMM_OSAL_ERR_NONE;
-    OMX_U32                    i;
 
     DOMX_ENTER("%s hComponent = %p", __FUNCTION__, hComponent);
 
@@ -1056,24 +953,7 @@ OMX_ERRORTYPE LOCAL_PROXY_VC1E_ComponentDeInit(OMX_HANDLETYPE hComponent)
     pCompPrv = (PROXY_COMPONENT_PRIVATE *) hComp->pComponentPrivate;
     pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
 
-    if( pProxy->hBufPipe != NULL ) {
-        eOSALStatus = TIMM_OSAL_DeletePipe(pProxy->hBufPipe);
-        pProxy->hBufPipe = NULL;
-
-        if( eOSALStatus != TIMM_OSAL_ERR_NONE ) {
-            DOMX_ERROR("Pipe deletion failed");
-        }
-    }
-
     if( pProxy->bAndroidOpaqueFormat == OMX_TRUE ) {
-        /* Cleanup internal buffers in pipe if not freed on FreeBuffer */
-        for( i=0; i < OMX_VC1VE_NUM_INTERNAL_BUF; i++ ) {
-            if( pProxy->gralloc_handle[i] ) {
-                pProxy->mAllocDev->free(pProxy->mAllocDev, (buffer_handle_t)(pProxy->gralloc_handle[i]));
-                pProxy->gralloc_handle[i] = NULL;
-            }
-        }
-
         COLORCONVERT_close(pProxy->hCC, pCompPrv);
         pProxy->bAndroidOpaqueFormat = OMX_FALSE;
 
@@ -1089,84 +969,4 @@ EXIT:
     return (eError);
 }
 
-/* ===========================================================================*/
-/**
- * @name COLORCONVERT_open()
- * @brief This function opens the color conversion module.
- * @param void
- * @return OMX_ErrorNone = Successful
- * @sa TBD
- *
- */
-/* ===========================================================================*/
-int COLORCONVERT_open(void * *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv)
-{
-    int                       nErr = -1;
-    hw_module_t const        *module = NULL;
-    OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
-
-    pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-    nErr = hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module);
-
-    if( nErr == 0 ) {
-        *hCC = (void *) ((IMG_gralloc_module_public_t const *)module);
-    } else {
-        DOMX_ERROR("FATAL: gralloc api hw_get_module() returned error: Can't find \
-                %s module err = %x", GRALLOC_HARDWARE_MODULE_ID, nErr);
-    }
-
-    gralloc_open(module, &(pProxy->mAllocDev));
-
-    return (nErr);
-}
-
-/* ===========================================================================*/
-/**
- * @name COLORCONVERT_PlatformOpaqueToNV12()
- * @brief  This function is used to get NV12 data after color conversion
- * @param void
- * @return OMX_ErrorNone = Successful
- * @sa TBD
- *
- */
-/* ===========================================================================*/
-int COLORCONVERT_PlatformOpaqueToNV12(void *hCC,
-                                      void *pSrc[COLORCONVERT_MAX_SUB_BUFFERS],
-                                      void *pDst[COLORCONVERT_MAX_SUB_BUFFERS],
-                                      int nWidth, int nHeight, int nStride,
-                                      int nSrcBufType, int nDstBufType)
-{
-    IMG_gralloc_module_public_t const   *module = hCC;
-    int                                  nErr = -1;
-
-    if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_VIRTUAL)) {
-        nErr = module->Blit(module, pSrc[0], pDst, HAL_PIXEL_FORMAT_TI_NV12);
-    } else if((nSrcBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE) && (nDstBufType == COLORCONVERT_BUFTYPE_GRALLOCOPAQUE)) {
-        nErr = module->Blit2(module, pSrc[0], pDst[0], nWidth, nHeight, 0, 0);
-    }
-
-    return (nErr);
-}
-
-/* ===========================================================================*/
-/**
- * @name COLORCONVERT_open()
- * @brief This function closes the color conversion module.
- * @param void
- * @return OMX_ErrorNone = Successful
- * @sa TBD
- *
- */
-/* ===========================================================================*/
-int COLORCONVERT_close(void *hCC, PROXY_COMPONENT_PRIVATE *pCompPrv)
-{
-    OMX_PROXY_ENCODER_PRIVATE   *pProxy = NULL;
-
-    pProxy = (OMX_PROXY_ENCODER_PRIVATE *) pCompPrv->pCompProxyPrv;
-    if( pProxy && pProxy->mAllocDev ) {
-        gralloc_close(pProxy->mAllocDev);
-    }
-    return (0);
-}
-
 #endif
@@ -0,0 +1,26 @@
+LOCAL_PATH:= $(call my-dir)
+
+#
+# domx_benchmark: RPC, buffer and ION cost of the DOMX stack
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= domx_benchmark.c
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../omx_core/inc \
+    $(LOCAL_PATH)/../../mm_osal/inc \
+    $(LOCAL_PATH)/../../domx/plugins/inc
+
+LOCAL_SHARED_LIBRARIES := \
+    libOMX_Core \
+    libdomx \
+    libmm_osal \
+    libc
+
+LOCAL_CFLAGS += -D_Android
+LOCAL_MODULE:= domx_benchmark
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,683 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Throughput and latency benchmark of the DOMX stack, driven through the
+ * OMX.TI.DUCATI1.MISC.SAMPLE component:
+ *
+ *   domx_benchmark [-n iterations] [-b buffers per port] [-s buffer size]
+ *
+ * Every measurement is printed on stdout as one JSON object per line, times
+ * in microseconds, so runs can be stored and compared by scripts. Progress
+ * and errors go to stderr.
+ */
+
+#define COMPONENT_NAME "OMX.TI.DUCATI1.MISC.SAMPLE"
+
+/****************************************************************
+*  INCLUDE FILES
+****************************************************************/
+/* ----- system and platform files ----------------------------*/
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/*-------program files ----------------------------------------*/
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+#include "timm_osal_interfaces.h"
+#include "memplugin.h"
+
+
+#define BENCH_INPUT_PORT 0
+#define BENCH_OUTPUT_PORT 1
+
+#define BENCH_DEFAULT_ITERATIONS 1000
+#define BENCH_DEFAULT_BUFFERS 4
+#define BENCH_MAX_BUFFERS 32
+
+#define BENCH_INIT_STRUCT(_s_, _name_)	\
+    memset(&(_s_), 0x0, sizeof(_name_));	\
+    (_s_).nSize = sizeof(_name_);		\
+    (_s_).nVersion.s.nVersionMajor = 0x1;	\
+    (_s_).nVersion.s.nVersionMinor = 0x1;	\
+    (_s_).nVersion.s.nRevision = 0x0;		\
+    (_s_).nVersion.s.nStep = 0x0
+
+#define BENCH_BAIL_IF_ERROR(_eError, _desc)	\
+    if(OMX_ErrorNone != (eError = _eError)){	\
+        fprintf(stderr, "%s failed: 0x%x\n", _desc, eError);	\
+        goto BENCH_BAIL;		\
+    }
+
+typedef struct BenchCtxt
+{
+	OMX_HANDLETYPE hComp;
+	OMX_STATETYPE eState;
+	TIMM_OSAL_PTR hStateSetEvent;
+	/* Headers handed back in EmptyBufferDone / FillBufferDone */
+	TIMM_OSAL_PTR hEmptyDonePipe;
+	TIMM_OSAL_PTR hFillDonePipe;
+	OMX_BUFFERHEADERTYPE *pInBufs[BENCH_MAX_BUFFERS];
+	OMX_BUFFERHEADERTYPE *pOutBufs[BENCH_MAX_BUFFERS];
+	OMX_U32 nInBufs;
+	OMX_U32 nOutBufs;
+	OMX_U32 nIterations;
+	OMX_U32 nBufCount;
+	OMX_U32 nBufSize;
+	OMX_U64 *pSamples;
+} BenchCtxt;
+
+
+/*========================================================*/
+/* @ fn Bench_Now :: Monotonic time in nanoseconds         */
+/*========================================================*/
+static OMX_U64 Bench_Now(void)
+{
+	struct timespec tNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return (OMX_U64) tNow.tv_sec * 1000000000ULL + tNow.tv_nsec;
+}
+
+/*========================================================*/
+/* @ fn Bench_CpuTime :: User + system time of the process */
+/*                       in nanoseconds, the RPC listener  */
+/*                       threads are included              */
+/*========================================================*/
+static OMX_U64 Bench_CpuTime(void)
+{
+	struct rusage tUsage;
+
+	getrusage(RUSAGE_SELF, &tUsage);
+	return ((OMX_U64) tUsage.ru_utime.tv_sec + tUsage.ru_stime.tv_sec) *
+	    1000000000ULL + ((OMX_U64) tUsage.ru_utime.tv_usec +
+	    tUsage.ru_stime.tv_usec) * 1000ULL;
+}
+
+static int Bench_CompareSamples(const void *pA, const void *pB)
+{
+	OMX_U64 nA = *(const OMX_U64 *) pA, nB = *(const OMX_U64 *) pB;
+
+	return (nA > nB) - (nA < nB);
+}
+
+/*========================================================*/
+/* @ fn Bench_ReportLatency :: One JSON line with the      */
+/*                             distribution of nCount      */
+/*                             samples (ns, sorted here)   */
+/*========================================================*/
+static void Bench_ReportLatency(const char *pTest, BenchCtxt * pContext,
+    OMX_U32 nCount, OMX_ERRORTYPE eStatus)
+{
+	OMX_U64 *pS = pContext->pSamples;
+	OMX_U64 nSum = 0;
+	OMX_U32 i = 0;
+
+	if (nCount == 0)
+	{
+		printf("{\"test\":\"%s\",\"count\":0,\"status\":\"0x%x\"}\n",
+		    pTest, eStatus);
+		return;
+	}
+	qsort(pS, nCount, sizeof(OMX_U64), Bench_CompareSamples);
+	for (i = 0; i < nCount; i++)
+		nSum += pS[i];
+
+	printf("{\"test\":\"%s\",\"count\":%lu,\"min_us\":%.1f,"
+	    "\"avg_us\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,"
+	    "\"p99_us\":%.1f,\"max_us\":%.1f,\"status\":\"0x%x\"}\n",
+	    pTest, nCount, pS[0] / 1000.0, (nSum / nCount) / 1000.0,
+	    pS[nCount / 2] / 1000.0, pS[(nCount * 90) / 100] / 1000.0,
+	    pS[(nCount * 99) / 100] / 1000.0, pS[nCount - 1] / 1000.0,
+	    eStatus);
+	fflush(stdout);
+}
+
+/* Application callback Functions */
+/*========================================================*/
+/* @ fn Bench_EventHandler :: Application callback         */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_EventHandler(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_PTR pAppData,
+    OMX_IN OMX_EVENTTYPE eEvent,
+    OMX_IN OMX_U32 nData1, OMX_IN OMX_U32 nData2, OMX_IN OMX_PTR pEventData)
+{
+	BenchCtxt *pContext = (BenchCtxt *) pAppData;
+
+	if (pContext == NULL)
+		return OMX_ErrorNone;
+
+	if (eEvent == OMX_EventCmdComplete && nData1 == OMX_CommandStateSet)
+	{
+		pContext->eState = (OMX_STATETYPE) nData2;
+		TIMM_OSAL_SemaphoreRelease(pContext->hStateSetEvent);
+	} else if (eEvent == OMX_EventError)
+	{
+		fprintf(stderr, "OMX_EventError 0x%lx 0x%lx\n", nData1, nData2);
+		if (nData1 == (OMX_U32) OMX_ErrorInvalidState)
+		{
+			pContext->eState = OMX_StateInvalid;
+			TIMM_OSAL_SemaphoreRelease(pContext->hStateSetEvent);
+		}
+	}
+	return OMX_ErrorNone;
+}
+
+/*========================================================*/
+/* @ fn Bench_EmptyBufferDone :: Application callback      */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_EmptyBufferDone(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_PTR pAppData, OMX_IN OMX_BUFFERHEADERTYPE * pBuffer)
+{
+	BenchCtxt *pContext = (BenchCtxt *) pAppData;
+
+	TIMM_OSAL_WriteToPipe(pContext->hEmptyDonePipe, &pBuffer,
+	    sizeof(pBuffer), TIMM_OSAL_SUSPEND);
+	return OMX_ErrorNone;
+}
+
+/*========================================================*/
+/* @ fn Bench_FillBufferDone :: Application callback       */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_FillBufferDone(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_PTR pAppData, OMX_IN OMX_BUFFERHEADERTYPE * pBuffer)
+{
+	BenchCtxt *pContext = (BenchCtxt *) pAppData;
+
+	TIMM_OSAL_WriteToPipe(pContext->hFillDonePipe, &pBuffer,
+	    sizeof(pBuffer), TIMM_OSAL_SUSPEND);
+	return OMX_ErrorNone;
+}
+
+static OMX_BUFFERHEADERTYPE *Bench_WaitDone(TIMM_OSAL_PTR hPipe)
+{
+	OMX_BUFFERHEADERTYPE *pBuffer = NULL;
+	TIMM_OSAL_U32 nActual = 0;
+
+	if (TIMM_OSAL_ReadFromPipe(hPipe, &pBuffer, sizeof(pBuffer),
+	    &nActual, TIMM_OSAL_SUSPEND) != TIMM_OSAL_ERR_NONE)
+		return NULL;
+	return pBuffer;
+}
+
+/*========================================================*/
+/* @ fn Bench_ConfigurePort :: Applies the requested       */
+/*                             buffer count and returns    */
+/*                             the buffer size to use      */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_ConfigurePort(BenchCtxt * pContext,
+    OMX_U32 nPortIndex, OMX_U32 * pBufSize)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_PARAM_PORTDEFINITIONTYPE tPortDef;
+
+	BENCH_INIT_STRUCT(tPortDef, OMX_PARAM_PORTDEFINITIONTYPE);
+	tPortDef.nPortIndex = nPortIndex;
+	eError = OMX_GetParameter(pContext->hComp,
+	    OMX_IndexParamPortDefinition, &tPortDef);
+	BENCH_BAIL_IF_ERROR(eError, "GetParameter(PortDefinition)");
+
+	tPortDef.nBufferCountActual = pContext->nBufCount;
+	if (tPortDef.nBufferCountActual < tPortDef.nBufferCountMin)
+		tPortDef.nBufferCountActual = tPortDef.nBufferCountMin;
+	if (tPortDef.nBufferCountActual > BENCH_MAX_BUFFERS)
+		tPortDef.nBufferCountActual = BENCH_MAX_BUFFERS;
+	eError = OMX_SetParameter(pContext->hComp,
+	    OMX_IndexParamPortDefinition, &tPortDef);
+	BENCH_BAIL_IF_ERROR(eError, "SetParameter(PortDefinition)");
+
+	if (nPortIndex == BENCH_INPUT_PORT)
+		pContext->nInBufs = tPortDef.nBufferCountActual;
+	else
+		pContext->nOutBufs = tPortDef.nBufferCountActual;
+	*pBufSize = pContext->nBufSize > tPortDef.nBufferSize ?
+	    pContext->nBufSize : tPortDef.nBufferSize;
+
+      BENCH_BAIL:
+	return eError;
+}
+
+/*========================================================*/
+/* @ fn Bench_TransitionWait :: Moves the component, buffers */
+/*                              are allocated on Loaded->Idle */
+/*                              and freed on Idle->Loaded     */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_TransitionWait(OMX_STATETYPE eToState,
+    BenchCtxt * pContext)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_U32 nInSize = 0, nOutSize = 0, i = 0;
+
+	if (eToState == OMX_StateIdle && pContext->eState == OMX_StateLoaded)
+	{
+		eError = Bench_ConfigurePort(pContext, BENCH_INPUT_PORT,
+		    &nInSize);
+		BENCH_BAIL_IF_ERROR(eError, "Input port setup");
+		eError = Bench_ConfigurePort(pContext, BENCH_OUTPUT_PORT,
+		    &nOutSize);
+		BENCH_BAIL_IF_ERROR(eError, "Output port setup");
+	}
+
+	eError = OMX_SendCommand(pContext->hComp, OMX_CommandStateSet,
+	    eToState, NULL);
+	BENCH_BAIL_IF_ERROR(eError, "SendCommand(StateSet)");
+
+	if (eToState == OMX_StateIdle && pContext->eState == OMX_StateLoaded)
+	{
+		for (i = 0; i < pContext->nInBufs; i++)
+		{
+			eError = OMX_AllocateBuffer(pContext->hComp,
+			    &pContext->pInBufs[i], BENCH_INPUT_PORT, pContext,
+			    nInSize);
+			BENCH_BAIL_IF_ERROR(eError, "AllocateBuffer(input)");
+		}
+		for (i = 0; i < pContext->nOutBufs; i++)
+		{
+			eError = OMX_AllocateBuffer(pContext->hComp,
+			    &pContext->pOutBufs[i], BENCH_OUTPUT_PORT, pContext,
+			    nOutSize);
+			BENCH_BAIL_IF_ERROR(eError, "AllocateBuffer(output)");
+		}
+	} else if (eToState == OMX_StateLoaded &&
+	    pContext->eState == OMX_StateIdle)
+	{
+		for (i = 0; i < pContext->nInBufs; i++)
+			OMX_FreeBuffer(pContext->hComp, BENCH_INPUT_PORT,
+			    pContext->pInBufs[i]);
+		for (i = 0; i < pContext->nOutBufs; i++)
+			OMX_FreeBuffer(pContext->hComp, BENCH_OUTPUT_PORT,
+			    pContext->pOutBufs[i]);
+		pContext->nInBufs = 0;
+		pContext->nOutBufs = 0;
+	}
+
+	TIMM_OSAL_SemaphoreObtain(pContext->hStateSetEvent, TIMM_OSAL_SUSPEND);
+	if (pContext->eState != eToState)
+	{
+		fprintf(stderr, "Transition to %d not completed\n", eToState);
+		eError = OMX_ErrorUndefined;
+	}
+
+      BENCH_BAIL:
+	return eError;
+}
+
+/*========================================================*/
+/* @ fn Bench_ParamLatency :: GetParameter and SetConfig    */
+/*                            round trips in Loaded state   */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_ParamLatency(BenchCtxt * pContext)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_PARAM_PORTDEFINITIONTYPE tPortDef;
+	OMX_CONFIG_ROTATIONTYPE tRotation;
+	OMX_U64 nStart = 0;
+	OMX_U32 i = 0;
+
+	for (i = 0; i < pContext->nIterations; i++)
+	{
+		BENCH_INIT_STRUCT(tPortDef, OMX_PARAM_PORTDEFINITIONTYPE);
+		tPortDef.nPortIndex = BENCH_INPUT_PORT;
+		nStart = Bench_Now();
+		eError = OMX_GetParameter(pContext->hComp,
+		    OMX_IndexParamPortDefinition, &tPortDef);
+		pContext->pSamples[i] = Bench_Now() - nStart;
+		if (eError != OMX_ErrorNone)
+			break;
+	}
+	Bench_ReportLatency("get_parameter", pContext, i, eError);
+
+	/* The sample component need not support the index, an error reply is
+	   still a full round trip */
+	for (i = 0; i < pContext->nIterations; i++)
+	{
+		BENCH_INIT_STRUCT(tRotation, OMX_CONFIG_ROTATIONTYPE);
+		tRotation.nPortIndex = BENCH_OUTPUT_PORT;
+		nStart = Bench_Now();
+		eError = OMX_SetConfig(pContext->hComp,
+		    OMX_IndexConfigCommonRotate, &tRotation);
+		pContext->pSamples[i] = Bench_Now() - nStart;
+	}
+	Bench_ReportLatency("set_config", pContext, i, eError);
+
+	return OMX_ErrorNone;
+}
+
+/*========================================================*/
+/* @ fn Bench_BufferLatency :: One buffer in flight per     */
+/*                             port, times the ETB/FTB      */
+/*                             calls and the done callbacks */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_BufferLatency(BenchCtxt * pContext)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_BUFFERHEADERTYPE *pIn = pContext->pInBufs[0];
+	OMX_BUFFERHEADERTYPE *pOut = pContext->pOutBufs[0];
+	OMX_U64 *pEtbCall = NULL, *pFtbCall = NULL, *pEtbDone = NULL,
+	    *pFtbDone = NULL;
+	OMX_U64 nFtb = 0, nEtb = 0;
+	OMX_U32 n = pContext->nIterations, i = 0;
+
+	pEtbCall = calloc(4 * n, sizeof(OMX_U64));
+	if (pEtbCall == NULL)
+		return OMX_ErrorInsufficientResources;
+	pFtbCall = pEtbCall + n;
+	pEtbDone = pFtbCall + n;
+	pFtbDone = pEtbDone + n;
+
+	for (i = 0; i < n; i++)
+	{
+		nFtb = Bench_Now();
+		eError = OMX_FillThisBuffer(pContext->hComp, pOut);
+		pFtbCall[i] = Bench_Now() - nFtb;
+		BENCH_BAIL_IF_ERROR(eError, "FillThisBuffer");
+
+		pIn->nFilledLen = pIn->nAllocLen;
+		pIn->nOffset = 0;
+		pIn->nFlags = 0;
+		nEtb = Bench_Now();
+		eError = OMX_EmptyThisBuffer(pContext->hComp, pIn);
+		pEtbCall[i] = Bench_Now() - nEtb;
+		BENCH_BAIL_IF_ERROR(eError, "EmptyThisBuffer");
+
+		pIn = Bench_WaitDone(pContext->hEmptyDonePipe);
+		pEtbDone[i] = Bench_Now() - nEtb;
+		pOut = Bench_WaitDone(pContext->hFillDonePipe);
+		pFtbDone[i] = Bench_Now() - nFtb;
+		if (pIn == NULL || pOut == NULL)
+		{
+			eError = OMX_ErrorUndefined;
+			goto BENCH_BAIL;
+		}
+	}
+
+      BENCH_BAIL:
+	memcpy(pContext->pSamples, pEtbCall, i * sizeof(OMX_U64));
+	Bench_ReportLatency("etb_call", pContext, i, eError);
+	memcpy(pContext->pSamples, pFtbCall, i * sizeof(OMX_U64));
+	Bench_ReportLatency("ftb_call", pContext, i, eError);
+	memcpy(pContext->pSamples, pEtbDone, i * sizeof(OMX_U64));
+	Bench_ReportLatency("etb_to_ebd", pContext, i, eError);
+	memcpy(pContext->pSamples, pFtbDone, i * sizeof(OMX_U64));
+	Bench_ReportLatency("ftb_to_fbd", pContext, i, eError);
+	free(pEtbCall);
+	return eError;
+}
+
+/*========================================================*/
+/* @ fn Bench_Throughput :: Keeps every buffer of both      */
+/*                          ports queued until nIterations  */
+/*                          output buffers came back        */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_Throughput(BenchCtxt * pContext)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_BUFFERHEADERTYPE *pBuffer = NULL;
+	OMX_U64 nStart = 0, nElapsed = 0, nCpuStart = 0, nCpu = 0;
+	OMX_U64 nBytes = 0;
+	OMX_U32 nDone = 0, i = 0;
+
+	nStart = Bench_Now();
+	nCpuStart = Bench_CpuTime();
+
+	for (i = 0; i < pContext->nOutBufs; i++)
+	{
+		eError = OMX_FillThisBuffer(pContext->hComp,
+		    pContext->pOutBufs[i]);
+		BENCH_BAIL_IF_ERROR(eError, "FillThisBuffer");
+	}
+	for (i = 0; i < pContext->nInBufs; i++)
+	{
+		pContext->pInBufs[i]->nFilledLen =
+		    pContext->pInBufs[i]->nAllocLen;
+		pContext->pInBufs[i]->nOffset = 0;
+		pContext->pInBufs[i]->nFlags = 0;
+		eError = OMX_EmptyThisBuffer(pContext->hComp,
+		    pContext->pInBufs[i]);
+		BENCH_BAIL_IF_ERROR(eError, "EmptyThisBuffer");
+	}
+
+	while (nDone < pContext->nIterations)
+	{
+		pBuffer = Bench_WaitDone(pContext->hEmptyDonePipe);
+		if (pBuffer == NULL)
+		{
+			eError = OMX_ErrorUndefined;
+			goto BENCH_BAIL;
+		}
+		nBytes += pBuffer->nAllocLen;
+		pBuffer->nFilledLen = pBuffer->nAllocLen;
+		pBuffer->nOffset = 0;
+		eError = OMX_EmptyThisBuffer(pContext->hComp, pBuffer);
+		BENCH_BAIL_IF_ERROR(eError, "EmptyThisBuffer");
+
+		pBuffer = Bench_WaitDone(pContext->hFillDonePipe);
+		if (pBuffer == NULL)
+		{
+			eError = OMX_ErrorUndefined;
+			goto BENCH_BAIL;
+		}
+		nDone++;
+		eError = OMX_FillThisBuffer(pContext->hComp, pBuffer);
+		BENCH_BAIL_IF_ERROR(eError, "FillThisBuffer");
+	}
+
+      BENCH_BAIL:
+	nElapsed = Bench_Now() - nStart;
+	nCpu = Bench_CpuTime() - nCpuStart;
+	if (nElapsed == 0)
+		nElapsed = 1;
+	printf("{\"test\":\"throughput\",\"buffers_in\":%lu,\"buffers_out\":%lu,"
+	    "\"buffer_size\":%lu,\"count\":%lu,\"buffers_per_s\":%.1f,"
+	    "\"mbytes_per_s\":%.2f,\"cpu_us_per_buffer\":%.1f,"
+	    "\"status\":\"0x%x\"}\n", pContext->nInBufs, pContext->nOutBufs,
+	    pContext->nInBufs ? pContext->pInBufs[0]->nAllocLen : 0, nDone,
+	    nDone * 1e9 / nElapsed, nBytes * 1e3 / nElapsed,
+	    nDone ? nCpu / 1000.0 / nDone : 0.0, eError);
+	fflush(stdout);
+	return eError;
+}
+
+/*========================================================*/
+/* @ fn Bench_IonAllocation :: Cost of ION buffers through   */
+/*                             the memplugin, mapped as the  */
+/*                             proxy does on AllocateBuffer  */
+/*========================================================*/
+static OMX_ERRORTYPE Bench_IonAllocation(BenchCtxt * pContext,
+    OMX_U32 nSize)
+{
+	MEMPLUGIN_ERRORTYPE eMemError = MEMPLUGIN_ERROR_NONE;
+	MEMPLUGIN_BUFFER_PARAMS tParams;
+	MEMPLUGIN_BUFFER_PROPERTIES tProps;
+	OMX_PTR pPlugin = NULL;
+	OMX_U32 nClient = 0, i = 0;
+	OMX_U64 *pFree = NULL, nStart = 0;
+
+	eMemError = MemPlugin_Init("MEMPLUGIN_ION", &pPlugin);
+	if (eMemError != MEMPLUGIN_ERROR_NONE)
+		goto EXIT;
+	eMemError = MemPlugin_Open(pPlugin, &nClient);
+	if (eMemError != MEMPLUGIN_ERROR_NONE)
+		goto EXIT;
+
+	pFree = calloc(pContext->nIterations, sizeof(OMX_U64));
+	if (pFree == NULL)
+		goto EXIT;
+
+	for (i = 0; i < pContext->nIterations; i++)
+	{
+		memset(&tParams, 0, sizeof(tParams));
+		memset(&tProps, 0, sizeof(tProps));
+		tParams.eBuffer_type = DEFAULT;
+		tParams.nHeight = 1;
+		tParams.nWidth = nSize;
+		tParams.bMap = OMX_TRUE;
+		tParams.eTiler_format = MEMPLUGIN_TILER_FORMAT_PAGE;
+
+		nStart = Bench_Now();
+		eMemError = MemPlugin_Alloc(pPlugin, nClient, &tParams, &tProps);
+		pContext->pSamples[i] = Bench_Now() - nStart;
+		if (eMemError != MEMPLUGIN_ERROR_NONE)
+			break;
+
+		nStart = Bench_Now();
+		MemPlugin_Free(pPlugin, nClient, &tParams, &tProps);
+		pFree[i] = Bench_Now() - nStart;
+	}
+
+      EXIT:
+	Bench_ReportLatency("ion_alloc", pContext, i, (OMX_ERRORTYPE) eMemError);
+	if (pFree != NULL)
+	{
+		memcpy(pContext->pSamples, pFree, i * sizeof(OMX_U64));
+		Bench_ReportLatency("ion_free", pContext, i, OMX_ErrorNone);
+		free(pFree);
+	}
+	if (pPlugin != NULL)
+	{
+		MemPlugin_Close(pPlugin, nClient);
+		MemPlugin_DeInit(pPlugin);
+	}
+	return eMemError == MEMPLUGIN_ERROR_NONE ? OMX_ErrorNone :
+	    OMX_ErrorInsufficientResources;
+}
+
+int main(int argc, char *argv[])
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_CALLBACKTYPE oCallbacks;
+	BenchCtxt oContext;
+	BenchCtxt *pContext = &oContext;
+	OMX_BOOL bInit = OMX_FALSE;
+	int opt = 0;
+
+	memset(pContext, 0x0, sizeof(BenchCtxt));
+	pContext->nIterations = BENCH_DEFAULT_ITERATIONS;
+	pContext->nBufCount = BENCH_DEFAULT_BUFFERS;
+
+	while ((opt = getopt(argc, argv, "n:b:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			pContext->nIterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			pContext->nBufCount = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			pContext->nBufSize = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n iterations] "
+			    "[-b buffers per port] [-s buffer size]\n",
+			    argv[0]);
+			return 1;
+		}
+	}
+	if (pContext->nIterations == 0 || pContext->nBufCount == 0)
+	{
+		fprintf(stderr, "iterations and buffers must be non zero\n");
+		return 1;
+	}
+
+	pContext->pSamples = calloc(pContext->nIterations, sizeof(OMX_U64));
+	if (pContext->pSamples == NULL)
+		return 1;
+
+	oCallbacks.EventHandler = Bench_EventHandler;
+	oCallbacks.EmptyBufferDone = Bench_EmptyBufferDone;
+	oCallbacks.FillBufferDone = Bench_FillBufferDone;
+
+	TIMM_OSAL_SemaphoreCreate(&pContext->hStateSetEvent, 0);
+	TIMM_OSAL_CreatePipe(&pContext->hEmptyDonePipe,
+	    BENCH_MAX_BUFFERS * sizeof(OMX_BUFFERHEADERTYPE *),
+	    sizeof(OMX_BUFFERHEADERTYPE *), OMX_TRUE);
+	TIMM_OSAL_CreatePipe(&pContext->hFillDonePipe,
+	    BENCH_MAX_BUFFERS * sizeof(OMX_BUFFERHEADERTYPE *),
+	    sizeof(OMX_BUFFERHEADERTYPE *), OMX_TRUE);
+
+	eError = OMX_Init();
+	BENCH_BAIL_IF_ERROR(eError, "OMX_Init");
+	bInit = OMX_TRUE;
+
+	eError = OMX_GetHandle(&pContext->hComp, (OMX_STRING) COMPONENT_NAME,
+	    pContext, &oCallbacks);
+	BENCH_BAIL_IF_ERROR(eError, "OMX_GetHandle");
+	pContext->eState = OMX_StateLoaded;
+
+	fprintf(stderr, "Parameter round trips\n");
+	Bench_ParamLatency(pContext);
+
+	fprintf(stderr, "Loaded -> Idle -> Executing\n");
+	eError = Bench_TransitionWait(OMX_StateIdle, pContext);
+	BENCH_BAIL_IF_ERROR(eError, "Loaded to Idle");
+	eError = Bench_TransitionWait(OMX_StateExecuting, pContext);
+	BENCH_BAIL_IF_ERROR(eError, "Idle to Executing");
+
+	fprintf(stderr, "Buffer round trips\n");
+	eError = Bench_BufferLatency(pContext);
+	BENCH_BAIL_IF_ERROR(eError, "Buffer latency");
+
+	fprintf(stderr, "Sustained throughput\n");
+	eError = Bench_Throughput(pContext);
+	BENCH_BAIL_IF_ERROR(eError, "Throughput");
+
+	fprintf(stderr, "Executing -> Idle -> Loaded\n");
+	eError = Bench_TransitionWait(OMX_StateIdle, pContext);
+	BENCH_BAIL_IF_ERROR(eError, "Executing to Idle");
+	eError = Bench_TransitionWait(OMX_StateLoaded, pContext);
+	BENCH_BAIL_IF_ERROR(eError, "Idle to Loaded");
+
+	fprintf(stderr, "ION allocations\n");
+	Bench_IonAllocation(pContext, pContext->nBufSize ?
+	    pContext->nBufSize : 4096);
+
+      BENCH_BAIL:
+	if (pContext->hComp != NULL)
+		OMX_FreeHandle(pContext->hComp);
+	if (bInit)
+		OMX_Deinit();
+
+	TIMM_OSAL_DeletePipe(pContext->hEmptyDonePipe);
+	TIMM_OSAL_DeletePipe(pContext->hFillDonePipe);
+	TIMM_OSAL_SemaphoreDelete(pContext->hStateSetEvent);
+	free(pContext->pSamples);
+
+	return eError == OMX_ErrorNone ? 0 : 1;
+}
@@ -0,0 +1,29 @@
+LOCAL_PATH:= $(call my-dir)
+
+#
+# colorconvert_check: RGBA/BGRA to NV12 conversion of the encoder proxies
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= colorconvert_check.c
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../omx_core/inc \
+    $(LOCAL_PATH)/../../mm_osal/inc \
+    $(LOCAL_PATH)/../../domx \
+    $(LOCAL_PATH)/../../domx/omx_rpc/inc \
+    $(LOCAL_PATH)/../../domx/plugins/inc \
+    $(LOCAL_PATH)/../../omx_proxy_component/omx_video_enc/inc \
+    $(COMMON_FOLDER)/hwc
+
+LOCAL_SHARED_LIBRARIES := \
+    libdomx_colorconvert \
+    libhardware \
+    libc
+
+LOCAL_CFLAGS += -D_Android -DUSE_ION
+LOCAL_MODULE:= colorconvert_check
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Checks the CPU opaque to NV12 conversion of the encoder proxies against a
+ * plain C reference, once for an RGBA and once for a BGRA source holding the
+ * same picture:
+ *
+ *   colorconvert_check
+ *
+ * The buffers live in this process, a stand-in gralloc module hands them to
+ * COLORCONVERT_NEON_OpaqueToNV12. The width covers two full NEON blocks
+ * plus an odd tail and the height is odd, so the edge handling of the line
+ * pairs is checked as well. Exits with 0 if both frames match.
+ */
+
+/****************************************************************
+*  INCLUDE FILES
+****************************************************************/
+/* ----- system and platform files ----------------------------*/
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+/*-------program files ----------------------------------------*/
+#include <hal_public.h>
+#include "omx_proxy_colorconvert.h"
+
+
+#define CHECK_WIDTH 35
+#define CHECK_HEIGHT 7
+/*Source lines are padded like the gralloc buffers, see HW_ALIGN */
+#define CHECK_SRC_STRIDE (64 * 4)
+#define CHECK_DST_STRIDE 64
+
+static uint8_t aSrc[CHECK_HEIGHT * CHECK_SRC_STRIDE];
+static uint8_t aY[CHECK_HEIGHT * CHECK_DST_STRIDE];
+static uint8_t aUV[((CHECK_HEIGHT + 1) / 2) * CHECK_DST_STRIDE];
+
+/*Lock of the stand-in gralloc module, NV12 buffers hand back two planes */
+static int Check_Lock(gralloc_module_t const *module, buffer_handle_t handle,
+    int usage, int l, int t, int w, int h, void **vaddr)
+{
+	IMG_native_handle_t *pHandle = (IMG_native_handle_t *) handle;
+
+	if (pHandle->iFormat == HAL_PIXEL_FORMAT_TI_NV12)
+	{
+		vaddr[0] = aY;
+		vaddr[1] = aUV;
+	} else
+	{
+		vaddr[0] = aSrc;
+	}
+	return 0;
+}
+
+static int Check_Unlock(gralloc_module_t const *module,
+    buffer_handle_t handle)
+{
+	return 0;
+}
+
+/*Red, green and blue of the test picture at x, y */
+static void Check_Pixel(int x, int y, uint8_t aRGB[3])
+{
+	aRGB[0] = (uint8_t) (x * 7 + y * 31);
+	aRGB[1] = (uint8_t) (x * 13 + 90);
+	aRGB[2] = (uint8_t) (255 - x * 5 - y * 17);
+}
+
+static uint8_t Check_Clip(int nValue)
+{
+	return (uint8_t) (nValue < 0 ? 0 : (nValue > 255 ? 255 : nValue));
+}
+
+/*Compares aY/aUV with the BT.601 conversion of the test picture. Returns
+  the number of wrong samples */
+static int Check_Compare(const char *pName)
+{
+	uint8_t aRGB[3];
+	int x = 0, y = 0, i = 0, j = 0, nErrors = 0;
+	int nSumR, nSumG, nSumB, nY, nU, nV;
+
+	for (y = 0; y < CHECK_HEIGHT; y++)
+	{
+		for (x = 0; x < CHECK_WIDTH; x++)
+		{
+			Check_Pixel(x, y, aRGB);
+			nY = ((66 * aRGB[0] + 129 * aRGB[1] + 25 * aRGB[2] +
+				128) >> 8) + 16;
+			if (aY[y * CHECK_DST_STRIDE + x] != nY)
+			{
+				if (nErrors++ == 0)
+					fprintf(stderr, "%s: Y(%d,%d) is %d, "
+					    "expected %d\n", pName, x, y,
+					    aY[y * CHECK_DST_STRIDE + x], nY);
+			}
+		}
+	}
+	/*Chroma of each 2x2 block, the last column/line repeats */
+	for (y = 0; y < CHECK_HEIGHT; y += 2)
+	{
+		for (x = 0; x < CHECK_WIDTH; x += 2)
+		{
+			nSumR = nSumG = nSumB = 0;
+			for (i = 0; i < 2; i++)
+			{
+				for (j = 0; j < 2; j++)
+				{
+					Check_Pixel(x + j < CHECK_WIDTH ?
+					    x + j : x, y + i < CHECK_HEIGHT ?
+					    y + i : y, aRGB);
+					nSumR += aRGB[0];
+					nSumG += aRGB[1];
+					nSumB += aRGB[2];
+				}
+			}
+			nSumR = (nSumR + 2) >> 2;
+			nSumG = (nSumG + 2) >> 2;
+			nSumB = (nSumB + 2) >> 2;
+			nU = Check_Clip(((112 * nSumB - 38 * nSumR -
+				    74 * nSumG + 128) >> 8) + 128);
+			nV = Check_Clip(((112 * nSumR - 94 * nSumG -
+				    18 * nSumB + 128) >> 8) + 128);
+			if (aUV[(y / 2) * CHECK_DST_STRIDE + x] != nU ||
+			    aUV[(y / 2) * CHECK_DST_STRIDE + x + 1] != nV)
+			{
+				if (nErrors++ == 0)
+					fprintf(stderr, "%s: UV(%d,%d) is "
+					    "%d,%d, expected %d,%d\n", pName,
+					    x, y, aUV[(y / 2) *
+						CHECK_DST_STRIDE + x],
+					    aUV[(y / 2) * CHECK_DST_STRIDE +
+						x + 1], nU, nV);
+			}
+		}
+	}
+	return nErrors;
+}
+
+/*Converts the test picture stored as iFormat, returns 0 if it came out
+  right */
+static int Check_Format(IMG_gralloc_module_public_t const *module,
+    int iFormat, const char *pName)
+{
+	IMG_native_handle_t tSrc, tDst;
+	uint8_t aRGB[3];
+	uint8_t *p = NULL;
+	int bBGR = (iFormat == HAL_PIXEL_FORMAT_BGRA_8888);
+	int x = 0, y = 0, nErrors = 0;
+
+	memset(&tSrc, 0x0, sizeof(tSrc));
+	memset(&tDst, 0x0, sizeof(tDst));
+	tSrc.iFormat = iFormat;
+	tSrc.iWidth = CHECK_WIDTH;
+	tSrc.iHeight = CHECK_HEIGHT;
+	tDst.iFormat = HAL_PIXEL_FORMAT_TI_NV12;
+	tDst.iWidth = CHECK_WIDTH;
+	tDst.iHeight = CHECK_HEIGHT;
+
+	for (y = 0; y < CHECK_HEIGHT; y++)
+	{
+		for (x = 0; x < CHECK_WIDTH; x++)
+		{
+			Check_Pixel(x, y, aRGB);
+			p = aSrc + y * CHECK_SRC_STRIDE + 4 * x;
+			p[0] = bBGR ? aRGB[2] : aRGB[0];
+			p[1] = aRGB[1];
+			p[2] = bBGR ? aRGB[0] : aRGB[2];
+			p[3] = 0xFF;
+		}
+	}
+	memset(aY, 0x0, sizeof(aY));
+	memset(aUV, 0x0, sizeof(aUV));
+
+	if (COLORCONVERT_NEON_OpaqueToNV12(module, &tSrc, &tDst, CHECK_WIDTH,
+		CHECK_HEIGHT, CHECK_DST_STRIDE) != 0)
+	{
+		fprintf(stderr, "%s: conversion failed\n", pName);
+		return 1;
+	}
+	nErrors = Check_Compare(pName);
+	printf("%s: %s\n", pName, nErrors ? "FAILED" : "ok");
+	return nErrors ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static IMG_gralloc_module_public_t tModule;
+	int nFailed = 0;
+
+	tModule.base.lock = Check_Lock;
+	tModule.base.unlock = Check_Unlock;
+
+	nFailed += Check_Format(&tModule, HAL_PIXEL_FORMAT_RGBA_8888, "RGBA");
+	nFailed += Check_Format(&tModule, HAL_PIXEL_FORMAT_BGRA_8888, "BGRA");
+
+	return nFailed ? 1 : 0;
+}
@@ -0,0 +1,24 @@
+LOCAL_PATH:= $(call my-dir)
+
+#
+# rpc_replay: offline analysis and replay of DOMX RPC traces
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= rpc_replay.c
+
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/../../omx_core/inc \
+    $(LOCAL_PATH)/../../mm_osal/inc \
+    $(LOCAL_PATH)/../../domx \
+    $(LOCAL_PATH)/../../domx/omx_rpc/inc
+
+LOCAL_SHARED_LIBRARIES := \
+    libc
+
+LOCAL_CFLAGS += -D_Android
+LOCAL_MODULE:= rpc_replay
+LOCAL_MODULE_TAGS:= optional
+
+include $(BUILD_EXECUTABLE)
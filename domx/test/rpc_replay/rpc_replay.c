@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2010, Texas Instruments Incorporated
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * *  Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * *  Neither the name of Texas Instruments Incorporated nor the names of
+ *    its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Offline analysis and replay of the RPC traces written by the DOMX
+ * recorder (set DEBUG_DOMX_RPC_RECORD or debug.domx.rpc_record to a file
+ * name before starting the client, see omx_rpc_record.h):
+ *
+ *   rpc_replay [-d] [-r] [-f] <trace>
+ *
+ *   -d  print every record of the trace
+ *   -r  replay the recorded calls on the remote core
+ *   -f  with -r, send as fast as possible instead of keeping the recorded
+ *       gaps between calls
+ *
+ * One JSON object per function index is printed on stdout with the call
+ * count and the reply latency seen in the trace and, with -r, during the
+ * replay. Times are in microseconds.
+ *
+ * Only calls without buffers are replayed: buffer headers and ION handles in
+ * a trace belong to the recording process and mean nothing to a new one, so
+ * Use/Allocate/FreeBuffer, ETB/FTB, tunnel requests and calls that ask the
+ * kernel to map a buffer are counted as skipped. The remote handle learnt
+ * from the replayed GetHandle is patched into every later call of that
+ * instance. State transitions that need buffers therefore do not complete
+ * during a replay; FreeHandle is still sent so the remote side cleans up.
+ */
+
+/****************************************************************
+*  INCLUDE FILES
+****************************************************************/
+/* ----- system and platform files ----------------------------*/
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <linux/rpmsg_omx.h>
+
+/*-------program files ----------------------------------------*/
+#include <OMX_Types.h>
+#include "omx_rpc_internal.h"
+#include "omx_rpc_record.h"
+#include "rpmsg_omx_defs.h"
+
+
+#define REPLAY_DEVICE "/dev/rpmsg-omx1"
+#define REPLAY_MAX_CONTEXTS 64
+/* Outstanding calls tracked per function index of one context */
+#define REPLAY_MAX_PENDING 16
+#define REPLAY_REPLY_TIMEOUT_MS 5000
+
+/* Packet data layout shared by all stubs: map info, map offset, handle */
+#define REPLAY_DATA_MAP_INFO 0
+#define REPLAY_DATA_HANDLE 2
+
+typedef struct ReplayRecord
+{
+	RPC_RECORD_ENTRY tEntry;
+	OMX_U8 *pData;
+} ReplayRecord;
+
+typedef struct ReplayStats
+{
+	OMX_U32 nCount;
+	OMX_U64 nSum;
+	OMX_U64 nMax;
+} ReplayStats;
+
+typedef struct ReplayPending
+{
+	OMX_U64 aTime[REPLAY_MAX_PENDING];
+	OMX_U32 nHead;
+	OMX_U32 nCount;
+} ReplayPending;
+
+typedef struct ReplayContext
+{
+	OMX_U32 nId;
+	char cName[OMX_MAX_STRINGNAME_SIZE];
+	OMX_S32 fd;
+	OMX_U32 hRemote;
+	ReplayPending tPending[RPC_OMX_MAX_FUNCTION_LIST];
+} ReplayContext;
+
+typedef struct ReplayCtxt
+{
+	ReplayRecord *pRecords;
+	OMX_U32 nRecords;
+	OMX_U32 nPacketSize;
+	ReplayContext tContexts[REPLAY_MAX_CONTEXTS];
+	OMX_U32 nContexts;
+	/* Reply latency per function index */
+	ReplayStats tRecorded[RPC_OMX_MAX_FUNCTION_LIST];
+	ReplayStats tReplayed[RPC_OMX_MAX_FUNCTION_LIST];
+	/* Messages coming from the remote core without a matching call */
+	OMX_U32 nRecordedCallbacks[RPC_OMX_MAX_FUNCTION_LIST];
+	OMX_U32 nReplayedCallbacks[RPC_OMX_MAX_FUNCTION_LIST];
+	OMX_U32 nSkipped[RPC_OMX_MAX_FUNCTION_LIST];
+	OMX_U32 nFailed[RPC_OMX_MAX_FUNCTION_LIST];
+} ReplayCtxt;
+
+static const char *pFxnNames[RPC_OMX_MAX_FUNCTION_LIST] = {
+	"get_handle", "set_parameter", "get_parameter", "use_buffer",
+	"free_handle", "set_config", "get_config", "get_state", "send_command",
+	"get_version", "get_extension_index", "fill_this_buffer",
+	"fill_buffer_done", "free_buffer", "empty_this_buffer",
+	"empty_buffer_done", "event_handler", "allocate_buffer",
+	"tunnel_request", "unused_19", "unused_20", "unused_21", "flush_done"
+};
+
+
+/*========================================================*/
+/* @ fn Replay_Now :: Monotonic time in nanoseconds        */
+/*========================================================*/
+static OMX_U64 Replay_Now(void)
+{
+	struct timespec tNow;
+
+	clock_gettime(CLOCK_MONOTONIC, &tNow);
+	return (OMX_U64) tNow.tv_sec * 1000000000ULL + tNow.tv_nsec;
+}
+
+static void Replay_AddSample(ReplayStats * pStats, OMX_U64 nSample)
+{
+	pStats->nCount++;
+	pStats->nSum += nSample;
+	if (nSample > pStats->nMax)
+		pStats->nMax = nSample;
+}
+
+static void Replay_PushPending(ReplayPending * pPending, OMX_U64 nTime)
+{
+	if (pPending->nCount == REPLAY_MAX_PENDING)
+	{
+		/* Lost the reply of the oldest call, forget about it */
+		pPending->nHead = (pPending->nHead + 1) % REPLAY_MAX_PENDING;
+		pPending->nCount--;
+	}
+	pPending->aTime[(pPending->nHead + pPending->nCount) %
+	    REPLAY_MAX_PENDING] = nTime;
+	pPending->nCount++;
+}
+
+static OMX_BOOL Replay_PopPending(ReplayPending * pPending, OMX_U64 * pTime)
+{
+	if (pPending->nCount == 0)
+		return OMX_FALSE;
+	*pTime = pPending->aTime[pPending->nHead];
+	pPending->nHead = (pPending->nHead + 1) % REPLAY_MAX_PENDING;
+	pPending->nCount--;
+	return OMX_TRUE;
+}
+
+/*========================================================*/
+/* @ fn Replay_FindContext :: Context of a trace id,       */
+/*                            created on first use         */
+/*========================================================*/
+static ReplayContext *Replay_FindContext(ReplayCtxt * pCtxt, OMX_U32 nId)
+{
+	ReplayContext *pContext = NULL;
+	OMX_U32 i = 0;
+
+	for (i = 0; i < pCtxt->nContexts; i++)
+	{
+		if (pCtxt->tContexts[i].nId == nId)
+			return &pCtxt->tContexts[i];
+	}
+	if (pCtxt->nContexts == REPLAY_MAX_CONTEXTS)
+		return NULL;
+
+	pContext = &pCtxt->tContexts[pCtxt->nContexts++];
+	memset(pContext, 0, sizeof(ReplayContext));
+	pContext->nId = nId;
+	pContext->fd = -1;
+	return pContext;
+}
+
+static void Replay_ResetContexts(ReplayCtxt * pCtxt)
+{
+	pCtxt->nContexts = 0;
+}
+
+/*========================================================*/
+/* @ fn Replay_Load :: Reads a whole trace in memory       */
+/*========================================================*/
+static int Replay_Load(ReplayCtxt * pCtxt, const char *pPath)
+{
+	RPC_RECORD_FILE_HEADER tHeader;
+	RPC_RECORD_ENTRY tEntry;
+	ReplayRecord *pRecords = NULL;
+	OMX_U32 nAlloc = 0;
+	FILE *pFile = fopen(pPath, "rb");
+
+	if (pFile == NULL)
+	{
+		fprintf(stderr, "Can't open %s: %s\n", pPath, strerror(errno));
+		return -1;
+	}
+	if (fread(&tHeader, sizeof(tHeader), 1, pFile) != 1 ||
+	    tHeader.nMagic != RPC_RECORD_MAGIC ||
+	    tHeader.nVersion != RPC_RECORD_VERSION)
+	{
+		fprintf(stderr, "%s is not a version %d RPC trace\n", pPath,
+		    RPC_RECORD_VERSION);
+		fclose(pFile);
+		return -1;
+	}
+	pCtxt->nPacketSize = tHeader.nPacketSize;
+
+	while (fread(&tEntry, sizeof(tEntry), 1, pFile) == 1)
+	{
+		if (pCtxt->nRecords == nAlloc)
+		{
+			nAlloc = nAlloc ? nAlloc * 2 : 1024;
+			pRecords = realloc(pCtxt->pRecords,
+			    nAlloc * sizeof(ReplayRecord));
+			if (pRecords == NULL)
+				break;
+			pCtxt->pRecords = pRecords;
+		}
+		pRecords = &pCtxt->pRecords[pCtxt->nRecords];
+		pRecords->tEntry = tEntry;
+		pRecords->pData = NULL;
+		if (tEntry.nSize > 0)
+		{
+			pRecords->pData = malloc(tEntry.nSize);
+			if (pRecords->pData == NULL ||
+			    fread(pRecords->pData, tEntry.nSize, 1, pFile) != 1)
+			{
+				/* A truncated last record, the client probably
+				   crashed before its final flush */
+				free(pRecords->pData);
+				break;
+			}
+		}
+		pCtxt->nRecords++;
+	}
+	fclose(pFile);
+
+	fprintf(stderr, "%lu records from pid %lu\n", pCtxt->nRecords,
+	    tHeader.nPid);
+	return 0;
+}
+
+/*========================================================*/
+/* @ fn Replay_Analyze :: Reply latency of the recorded    */
+/*                        calls, optionally dumping them   */
+/*========================================================*/
+static void Replay_Analyze(ReplayCtxt * pCtxt, OMX_BOOL bDump)
+{
+	ReplayRecord *pRecord = NULL;
+	ReplayContext *pContext = NULL;
+	struct omx_packet *pPacket = NULL;
+	OMX_U64 nStart = 0, nSent = 0;
+	OMX_U32 i = 0, nFxnIdx = 0;
+
+	if (pCtxt->nRecords > 0)
+		nStart = pCtxt->pRecords[0].tEntry.nTimeNs;
+
+	for (i = 0; i < pCtxt->nRecords; i++)
+	{
+		pRecord = &pCtxt->pRecords[i];
+		nFxnIdx = pRecord->tEntry.nFxnIdx;
+		pPacket = (struct omx_packet *) pRecord->pData;
+		pContext = Replay_FindContext(pCtxt, pRecord->tEntry.nContext);
+		if (pContext == NULL)
+			continue;
+
+		switch (pRecord->tEntry.nType)
+		{
+		case RPC_RECORD_OPEN:
+			strncpy(pContext->cName, (char *) pRecord->pData,
+			    sizeof(pContext->cName) - 1);
+			if (bDump)
+				printf("%12.1f ctx %lu open %s\n",
+				    (pRecord->tEntry.nTimeNs - nStart) / 1000.0,
+				    pContext->nId, pContext->cName);
+			break;
+		case RPC_RECORD_CLOSE:
+			if (bDump)
+				printf("%12.1f ctx %lu close\n",
+				    (pRecord->tEntry.nTimeNs - nStart) / 1000.0,
+				    pContext->nId);
+			break;
+		case RPC_RECORD_SEND:
+		case RPC_RECORD_RECV:
+			if (nFxnIdx >= RPC_OMX_MAX_FUNCTION_LIST ||
+			    pRecord->tEntry.nSize < sizeof(struct omx_packet))
+				break;
+			if (bDump)
+				printf("%12.1f ctx %lu %s %s size %lu result 0x%x\n",
+				    (pRecord->tEntry.nTimeNs - nStart) / 1000.0,
+				    pContext->nId,
+				    pRecord->tEntry.nType == RPC_RECORD_SEND ?
+				    "->" : "<-", pFxnNames[nFxnIdx],
+				    pRecord->tEntry.nSize, pPacket->result);
+			if (pRecord->tEntry.nType == RPC_RECORD_SEND)
+				Replay_PushPending(&pContext->tPending[nFxnIdx],
+				    pRecord->tEntry.nTimeNs);
+			else if (Replay_PopPending(&pContext->tPending[nFxnIdx],
+				&nSent))
+				Replay_AddSample(&pCtxt->tRecorded[nFxnIdx],
+				    pRecord->tEntry.nTimeNs - nSent);
+			else
+				pCtxt->nRecordedCallbacks[nFxnIdx]++;
+			break;
+		default:
+			break;
+		}
+	}
+	Replay_ResetContexts(pCtxt);
+}
+
+/*========================================================*/
+/* @ fn Replay_CanSend :: Whether a recorded call still    */
+/*                        makes sense in a new process     */
+/*========================================================*/
+static OMX_BOOL Replay_CanSend(ReplayContext * pContext,
+    ReplayRecord * pRecord)
+{
+	struct omx_packet *pPacket = (struct omx_packet *) pRecord->pData;
+	OMX_U32 nFxnIdx = pRecord->tEntry.nFxnIdx;
+
+	switch (nFxnIdx)
+	{
+	case RPC_OMX_FXN_IDX_USE_BUFFER:
+	case RPC_OMX_FXN_IDX_ALLOCATE_BUFFER:
+	case RPC_OMX_FXN_IDX_FREE_BUFFER:
+	case RPC_OMX_FXN_IDX_EMPTYTHISBUFFER:
+	case RPC_OMX_FXN_IDX_FILLTHISBUFFER:
+	case RPC_OMX_FXN_IDX_COMP_TUNNEL_REQUEST:
+		return OMX_FALSE;
+	default:
+		break;
+	}
+	if (pContext->fd < 0 || pRecord->tEntry.nSize <
+	    sizeof(struct omx_packet) + (REPLAY_DATA_HANDLE + 1) * 4)
+		return OMX_FALSE;
+	if (pPacket->data[REPLAY_DATA_MAP_INFO] != RPC_OMX_MAP_INFO_NONE)
+		return OMX_FALSE;
+	if (nFxnIdx != RPC_OMX_FXN_IDX_GET_HANDLE && pContext->hRemote == 0)
+		return OMX_FALSE;
+	return OMX_TRUE;
+}
+
+/*========================================================*/
+/* @ fn Replay_WaitReply :: Reads until the reply of       */
+/*                          nFxnIdx, counting callbacks    */
+/*========================================================*/
+static struct omx_packet *Replay_WaitReply(ReplayCtxt * pCtxt,
+    ReplayContext * pContext, OMX_U32 nFxnIdx, OMX_U8 * pBuffer)
+{
+	struct omx_packet *pPacket = (struct omx_packet *) pBuffer;
+	struct pollfd tPoll;
+	OMX_U32 nReplyIdx = 0;
+	ssize_t status = 0;
+
+	tPoll.fd = pContext->fd;
+	tPoll.events = POLLIN;
+	while (poll(&tPoll, 1, REPLAY_REPLY_TIMEOUT_MS) > 0)
+	{
+		status = read(pContext->fd, pBuffer, pCtxt->nPacketSize);
+		if (status < (ssize_t) sizeof(struct omx_packet))
+			break;
+		nReplyIdx = pPacket->fxn_idx & 0x0FFFFFFF;
+		if (nReplyIdx == nFxnIdx)
+			return pPacket;
+		if (nReplyIdx < RPC_OMX_MAX_FUNCTION_LIST)
+			pCtxt->nReplayedCallbacks[nReplyIdx]++;
+	}
+	return NULL;
+}
+
+/*========================================================*/
+/* @ fn Replay_Run :: Sends the replayable calls of the    */
+/*                    trace to the remote core             */
+/*========================================================*/
+static void Replay_Run(ReplayCtxt * pCtxt, OMX_BOOL bFast)
+{
+	struct omx_conn_req sReq = { .name = "OMX" };
+	ReplayRecord *pRecord = NULL;
+	ReplayContext *pContext = NULL;
+	struct omx_packet *pPacket = NULL, *pReply = NULL;
+	OMX_U8 *pSend = malloc(pCtxt->nPacketSize);
+	OMX_U8 *pRecv = malloc(pCtxt->nPacketSize);
+	OMX_U64 nTraceStart = 0, nStart = Replay_Now(), nDue = 0, nSent = 0;
+	OMX_U32 i = 0, nFxnIdx = 0;
+	struct timespec tSleep;
+
+	if (pSend == NULL || pRecv == NULL)
+		goto EXIT;
+	if (pCtxt->nRecords > 0)
+		nTraceStart = pCtxt->pRecords[0].tEntry.nTimeNs;
+
+	for (i = 0; i < pCtxt->nRecords; i++)
+	{
+		pRecord = &pCtxt->pRecords[i];
+		nFxnIdx = pRecord->tEntry.nFxnIdx;
+		pContext = Replay_FindContext(pCtxt, pRecord->tEntry.nContext);
+		if (pContext == NULL)
+			continue;
+
+		if (pRecord->tEntry.nType == RPC_RECORD_OPEN)
+		{
+			pContext->fd = open(REPLAY_DEVICE, O_RDWR);
+			if (pContext->fd >= 0 &&
+			    ioctl(pContext->fd, OMX_IOCCONNECT, &sReq) < 0)
+			{
+				close(pContext->fd);
+				pContext->fd = -1;
+			}
+			if (pContext->fd < 0)
+				fprintf(stderr, "ctx %lu: can't connect to %s\n",
+				    pContext->nId, REPLAY_DEVICE);
+			continue;
+		}
+		if (pRecord->tEntry.nType == RPC_RECORD_CLOSE)
+		{
+			if (pContext->fd >= 0)
+				close(pContext->fd);
+			pContext->fd = -1;
+			pContext->hRemote = 0;
+			continue;
+		}
+		if (pRecord->tEntry.nType != RPC_RECORD_SEND ||
+		    nFxnIdx >= RPC_OMX_MAX_FUNCTION_LIST)
+			continue;
+		if (!Replay_CanSend(pContext, pRecord))
+		{
+			pCtxt->nSkipped[nFxnIdx]++;
+			continue;
+		}
+
+		if (!bFast)
+		{
+			/* Keep the gaps the client left between its calls */
+			nDue = nStart + (pRecord->tEntry.nTimeNs - nTraceStart);
+			nSent = Replay_Now();
+			if (nDue > nSent)
+			{
+				tSleep.tv_sec = (nDue - nSent) / 1000000000ULL;
+				tSleep.tv_nsec = (nDue - nSent) % 1000000000ULL;
+				nanosleep(&tSleep, NULL);
+			}
+		}
+
+		memcpy(pSend, pRecord->pData, pRecord->tEntry.nSize);
+		pPacket = (struct omx_packet *) pSend;
+		if (nFxnIdx != RPC_OMX_FXN_IDX_GET_HANDLE)
+			pPacket->data[REPLAY_DATA_HANDLE] = pContext->hRemote;
+
+		nSent = Replay_Now();
+		if (write(pContext->fd, pSend, pRecord->tEntry.nSize) !=
+		    (ssize_t) pRecord->tEntry.nSize)
+		{
+			pCtxt->nFailed[nFxnIdx]++;
+			continue;
+		}
+		/* Non-blocking commands get no reply */
+		if (((pPacket->desc & OMX_DESC_TYPE_MASK) >>
+			OMX_DESC_TYPE_SHIFT) != OMX_DESC_MSG)
+			continue;
+
+		pReply = Replay_WaitReply(pCtxt, pContext, nFxnIdx, pRecv);
+		if (pReply == NULL)
+		{
+			fprintf(stderr, "ctx %lu: no reply to %s\n",
+			    pContext->nId, pFxnNames[nFxnIdx]);
+			pCtxt->nFailed[nFxnIdx]++;
+			continue;
+		}
+		Replay_AddSample(&pCtxt->tReplayed[nFxnIdx],
+		    Replay_Now() - nSent);
+		if (pReply->result != OMX_ErrorNone)
+			pCtxt->nFailed[nFxnIdx]++;
+		else if (nFxnIdx == RPC_OMX_FXN_IDX_GET_HANDLE)
+			pContext->hRemote = pReply->data[0];
+	}
+
+	for (i = 0; i < pCtxt->nContexts; i++)
+	{
+		if (pCtxt->tContexts[i].fd >= 0)
+			close(pCtxt->tContexts[i].fd);
+	}
+	Replay_ResetContexts(pCtxt);
+
+      EXIT:
+	free(pSend);
+	free(pRecv);
+}
+
+static double Replay_Avg(ReplayStats * pStats)
+{
+	return pStats->nCount ? (pStats->nSum / pStats->nCount) / 1000.0 : 0;
+}
+
+static void Replay_Report(ReplayCtxt * pCtxt, OMX_BOOL bReplayed)
+{
+	ReplayStats *pRec = NULL, *pRep = NULL;
+	OMX_U32 i = 0;
+
+	for (i = 0; i < RPC_OMX_MAX_FUNCTION_LIST; i++)
+	{
+		pRec = &pCtxt->tRecorded[i];
+		pRep = &pCtxt->tReplayed[i];
+		if (pRec->nCount == 0 && pCtxt->nRecordedCallbacks[i] == 0)
+			continue;
+
+		printf("{\"fxn\":\"%s\",\"recorded_calls\":%lu,"
+		    "\"recorded_avg_us\":%.1f,\"recorded_max_us\":%.1f,"
+		    "\"recorded_callbacks\":%lu", pFxnNames[i], pRec->nCount,
+		    Replay_Avg(pRec), pRec->nMax / 1000.0,
+		    pCtxt->nRecordedCallbacks[i]);
+		if (bReplayed)
+			printf(",\"replayed_calls\":%lu,\"replayed_avg_us\":%.1f,"
+			    "\"replayed_max_us\":%.1f,\"replayed_callbacks\":%lu,"
+			    "\"skipped\":%lu,\"failed\":%lu", pRep->nCount,
+			    Replay_Avg(pRep), pRep->nMax / 1000.0,
+			    pCtxt->nReplayedCallbacks[i], pCtxt->nSkipped[i],
+			    pCtxt->nFailed[i]);
+		printf("}\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	ReplayCtxt *pCtxt = NULL;
+	OMX_BOOL bDump = OMX_FALSE, bReplay = OMX_FALSE, bFast = OMX_FALSE;
+	int nOpt = 0, nRet = 1;
+	OMX_U32 i = 0;
+
+	while ((nOpt = getopt(argc, argv, "drf")) != -1)
+	{
+		switch (nOpt)
+		{
+		case 'd':
+			bDump = OMX_TRUE;
+			break;
+		case 'r':
+			bReplay = OMX_TRUE;
+			break;
+		case 'f':
+			bFast = OMX_TRUE;
+			break;
+		default:
+			goto USAGE;
+		}
+	}
+	if (optind != argc - 1)
+		goto USAGE;
+
+	pCtxt = calloc(1, sizeof(ReplayCtxt));
+	if (pCtxt == NULL || Replay_Load(pCtxt, argv[optind]) != 0)
+		goto EXIT;
+
+	Replay_Analyze(pCtxt, bDump);
+	if (bReplay)
+		Replay_Run(pCtxt, bFast);
+	Replay_Report(pCtxt, bReplay);
+	nRet = 0;
+
+      EXIT:
+	if (pCtxt)
+	{
+		for (i = 0; i < pCtxt->nRecords; i++)
+			free(pCtxt->pRecords[i].pData);
+		free(pCtxt->pRecords);
+		free(pCtxt);
+	}
+	return nRet;
+
+      USAGE:
+	fprintf(stderr, "usage: %s [-d] [-r] [-f] <trace>\n", argv[0]);
+	return 1;
+}
@@ -41,6 +41,9 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
 
 
 /*-------program files ----------------------------------------*/
@@ -980,11 +983,471 @@ OMX_ERRORTYPE SampleTest_TransitionWait(OMX_STATETYPE eToState,
 }
 
 
+/****************************************************************
+*  Multi-instance stress mode
+****************************************************************/
+/* sampletest -n <instances> [-c <buffers per port>] [-s <buffer size>]
+ *            [-i <iterations>]
+ * runs 1, 2, .. n instances of the sample component at the same time, each
+ * one driven from its own thread, and reports the calls per second of every
+ * run, the round trip latency (ETB to EBD, FTB to FBD) of every instance and
+ * the instance count after which the throughput stops growing. Without
+ * arguments the single instance file test below is run. */
+
+#define STRESS_MAX_INSTANCES 16
+#define STRESS_MAX_BUFFERS 32
+#define STRESS_DEFAULT_ITERATIONS 200
+#define STRESS_TIMEOUT_MS 5000
+/* One more instance has to add this much throughput to count as scaling */
+#define STRESS_SCALING_MIN_GAIN 1.10
+
+typedef struct StressBuffer
+{
+	OMX_BUFFERHEADERTYPE *pBufHdr;
+	OMX_U64 nSentNs;
+} StressBuffer;
+
+typedef struct StressCtxt
+{
+	OMX_U32 nId;
+	OMX_HANDLETYPE hComp;
+	OMX_STATETYPE eState;
+	OMX_HANDLETYPE hStateSetEvent;
+	OMX_HANDLETYPE hBufDoneEvent;
+	OMX_U32 nBuffers;
+	OMX_U32 nBufferSize;
+	OMX_U32 nIterations;
+	OMX_U32 nPortBuffers[2];
+	StressBuffer sBuffers[2][STRESS_MAX_BUFFERS];
+	/* written by the callback thread of the instance only */
+	OMX_U64 *pLatencyNs;
+	OMX_U32 nLatencies;
+	OMX_U32 nMaxLatencies;
+	OMX_U32 nCalls;
+	OMX_U64 nStartNs;
+	OMX_U64 nEndNs;
+	volatile OMX_BOOL bError;
+	OMX_ERRORTYPE eError;
+	pthread_t tThread;
+} StressCtxt;
+
+static OMX_U64 StressTest_Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (OMX_U64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int StressTest_CompareU64(const void *a, const void *b)
+{
+	OMX_U64 x = *(const OMX_U64 *) a, y = *(const OMX_U64 *) b;
+
+	return (x > y) - (x < y);
+}
+
+OMX_ERRORTYPE StressTest_EventHandler(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_PTR pAppData,
+    OMX_IN OMX_EVENTTYPE eEvent,
+    OMX_IN OMX_U32 nData1, OMX_IN OMX_U32 nData2, OMX_IN OMX_PTR pEventData)
+{
+	StressCtxt *pCtxt = (StressCtxt *) pAppData;
+
+	if (pCtxt == NULL)
+		return OMX_ErrorNone;
+
+	if (eEvent == OMX_EventCmdComplete && nData1 == OMX_CommandStateSet)
+	{
+		pCtxt->eState = (OMX_STATETYPE) nData2;
+		TIMM_OSAL_SemaphoreRelease(pCtxt->hStateSetEvent);
+	} else if (eEvent == OMX_EventError)
+	{
+		printf("instance %d: error event %s\n", pCtxt->nId,
+		    OMX_TEST_ErrorToString((OMX_ERRORTYPE) nData1));
+		pCtxt->eError = (OMX_ERRORTYPE) nData1;
+		pCtxt->bError = OMX_TRUE;
+		/* nothing else may come, don't leave the thread waiting */
+		TIMM_OSAL_SemaphoreRelease(pCtxt->hStateSetEvent);
+		TIMM_OSAL_SemaphoreRelease(pCtxt->hBufDoneEvent);
+	}
+	return OMX_ErrorNone;
+}
+
+static void StressTest_BufferDone(StressCtxt * pCtxt,
+    OMX_BUFFERHEADERTYPE * pBuffer)
+{
+	StressBuffer *pBuf = (StressBuffer *) pBuffer->pAppPrivate;
+
+	if (pBuf != NULL && pCtxt->nLatencies < pCtxt->nMaxLatencies)
+		pCtxt->pLatencyNs[pCtxt->nLatencies++] =
+		    StressTest_Now() - pBuf->nSentNs;
+	TIMM_OSAL_SemaphoreRelease(pCtxt->hBufDoneEvent);
+}
+
+OMX_ERRORTYPE StressTest_EmptyBufferDone(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_PTR pAppData, OMX_IN OMX_BUFFERHEADERTYPE * pBuffer)
+{
+	if (pAppData != NULL)
+		StressTest_BufferDone((StressCtxt *) pAppData, pBuffer);
+	return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE StressTest_FillBufferDone(OMX_IN OMX_HANDLETYPE hComponent,
+    OMX_IN OMX_PTR pAppData, OMX_IN OMX_BUFFERHEADERTYPE * pBuffer)
+{
+	if (pAppData != NULL)
+		StressTest_BufferDone((StressCtxt *) pAppData, pBuffer);
+	return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE oStressCallbacks = {
+	StressTest_EventHandler,
+	StressTest_EmptyBufferDone,
+	StressTest_FillBufferDone
+};
+
+static OMX_ERRORTYPE StressTest_WaitState(StressCtxt * pCtxt,
+    OMX_STATETYPE eToState)
+{
+	if (TIMM_OSAL_SemaphoreObtain(pCtxt->hStateSetEvent,
+		STRESS_TIMEOUT_MS) != TIMM_OSAL_ERR_NONE)
+		return OMX_ErrorTimeout;
+	if (pCtxt->bError || pCtxt->eState != eToState)
+		return OMX_ErrorUndefined;
+	return OMX_ErrorNone;
+}
+
+/*========================================================*/
+/* @ fn StressTest_SetupPorts :: Applies the buffer count and size of the
+ *  run to both ports and reads back what the component took */
+/*========================================================*/
+static OMX_ERRORTYPE StressTest_SetupPorts(StressCtxt * pCtxt)
+{
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_PARAM_PORTDEFINITIONTYPE tPortDef;
+	OMX_U32 nPort;
+
+	for (nPort = OMX_SAMPLE_INPUT_PORT; nPort <= OMX_SAMPLE_OUTPUT_PORT;
+	    nPort++)
+	{
+		OMX_TEST_INIT_STRUCT(tPortDef, OMX_PARAM_PORTDEFINITIONTYPE);
+		tPortDef.nPortIndex = nPort;
+		eError = OMX_GetParameter(pCtxt->hComp,
+		    OMX_IndexParamPortDefinition, (OMX_PTR) & tPortDef);
+		OMX_TEST_BAIL_IF_ERROR(eError);
+
+		if (pCtxt->nBuffers > tPortDef.nBufferCountMin)
+			tPortDef.nBufferCountActual = pCtxt->nBuffers;
+		if (pCtxt->nBufferSize > tPortDef.nBufferSize)
+			tPortDef.nBufferSize = pCtxt->nBufferSize;
+		eError = OMX_SetParameter(pCtxt->hComp,
+		    OMX_IndexParamPortDefinition, (OMX_PTR) & tPortDef);
+		OMX_TEST_BAIL_IF_ERROR(eError);
+
+		eError = OMX_GetParameter(pCtxt->hComp,
+		    OMX_IndexParamPortDefinition, (OMX_PTR) & tPortDef);
+		OMX_TEST_BAIL_IF_ERROR(eError);
+		if (tPortDef.nBufferCountActual > STRESS_MAX_BUFFERS)
+			OMX_TEST_SET_ERROR_BAIL(OMX_ErrorBadParameter,
+			    "too many buffers on a port\n");
+		pCtxt->nPortBuffers[nPort] = tPortDef.nBufferCountActual;
+		pCtxt->nBufferSize = tPortDef.nBufferSize;
+	}
+
+      OMX_TEST_BAIL:
+	return eError;
+}
+
+static void StressTest_FreeBuffers(StressCtxt * pCtxt)
+{
+	OMX_U32 nPort, i;
+
+	for (nPort = OMX_SAMPLE_INPUT_PORT; nPort <= OMX_SAMPLE_OUTPUT_PORT;
+	    nPort++)
+	{
+		for (i = 0; i < STRESS_MAX_BUFFERS; i++)
+		{
+			if (pCtxt->sBuffers[nPort][i].pBufHdr == NULL)
+				continue;
+			OMX_FreeBuffer(pCtxt->hComp, nPort,
+			    pCtxt->sBuffers[nPort][i].pBufHdr);
+			pCtxt->sBuffers[nPort][i].pBufHdr = NULL;
+		}
+	}
+}
+
+/*========================================================*/
+/* @ fn StressTest_Instance :: Thread of one instance, Loaded to Executing,
+ *  nIterations rounds of all buffers through the component and back */
+/*========================================================*/
+static void *StressTest_Instance(void *pData)
+{
+	StressCtxt *pCtxt = (StressCtxt *) pData;
+	OMX_ERRORTYPE eError = OMX_ErrorNone;
+	OMX_BUFFERHEADERTYPE *pBufHdr;
+	OMX_U32 nPort, nIter, i, nPending;
+
+	eError = OMX_GetHandle(&pCtxt->hComp, (OMX_STRING) COMPONENT_NAME,
+	    pCtxt, &oStressCallbacks);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+
+	eError = StressTest_SetupPorts(pCtxt);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+
+	eError = OMX_SendCommand(pCtxt->hComp, OMX_CommandStateSet,
+	    OMX_StateIdle, NULL);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+	for (nPort = OMX_SAMPLE_INPUT_PORT; nPort <= OMX_SAMPLE_OUTPUT_PORT;
+	    nPort++)
+	{
+		for (i = 0; i < pCtxt->nPortBuffers[nPort]; i++)
+		{
+			eError = OMX_AllocateBuffer(pCtxt->hComp,
+			    &pCtxt->sBuffers[nPort][i].pBufHdr, nPort,
+			    &pCtxt->sBuffers[nPort][i], pCtxt->nBufferSize);
+			OMX_TEST_BAIL_IF_ERROR(eError);
+		}
+	}
+	eError = StressTest_WaitState(pCtxt, OMX_StateIdle);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+
+	eError = OMX_SendCommand(pCtxt->hComp, OMX_CommandStateSet,
+	    OMX_StateExecuting, NULL);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+	eError = StressTest_WaitState(pCtxt, OMX_StateExecuting);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+
+	pCtxt->nStartNs = StressTest_Now();
+	for (nIter = 0; nIter < pCtxt->nIterations; nIter++)
+	{
+		nPending = 0;
+		for (i = 0; i < pCtxt->nPortBuffers[OMX_SAMPLE_OUTPUT_PORT]; i++)
+		{
+			pBufHdr = pCtxt->sBuffers[OMX_SAMPLE_OUTPUT_PORT][i].pBufHdr;
+			pCtxt->sBuffers[OMX_SAMPLE_OUTPUT_PORT][i].nSentNs =
+			    StressTest_Now();
+			eError = OMX_FillThisBuffer(pCtxt->hComp, pBufHdr);
+			OMX_TEST_BAIL_IF_ERROR(eError);
+			nPending++;
+		}
+		for (i = 0; i < pCtxt->nPortBuffers[OMX_SAMPLE_INPUT_PORT]; i++)
+		{
+			pBufHdr = pCtxt->sBuffers[OMX_SAMPLE_INPUT_PORT][i].pBufHdr;
+			pBufHdr->nFilledLen = pBufHdr->nAllocLen;
+			pBufHdr->nOffset = 0;
+			pBufHdr->nFlags = 0;
+			pCtxt->sBuffers[OMX_SAMPLE_INPUT_PORT][i].nSentNs =
+			    StressTest_Now();
+			eError = OMX_EmptyThisBuffer(pCtxt->hComp, pBufHdr);
+			OMX_TEST_BAIL_IF_ERROR(eError);
+			nPending++;
+		}
+		while (nPending--)
+		{
+			if (TIMM_OSAL_SemaphoreObtain(pCtxt->hBufDoneEvent,
+				STRESS_TIMEOUT_MS) != TIMM_OSAL_ERR_NONE)
+				OMX_TEST_SET_ERROR_BAIL(OMX_ErrorTimeout,
+				    "buffer not returned\n");
+			if (pCtxt->bError)
+				OMX_TEST_SET_ERROR_BAIL(pCtxt->eError,
+				    "error during processing\n");
+			pCtxt->nCalls++;
+		}
+	}
+	pCtxt->nEndNs = StressTest_Now();
+
+	eError = OMX_SendCommand(pCtxt->hComp, OMX_CommandStateSet,
+	    OMX_StateIdle, NULL);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+	eError = StressTest_WaitState(pCtxt, OMX_StateIdle);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+
+	eError = OMX_SendCommand(pCtxt->hComp, OMX_CommandStateSet,
+	    OMX_StateLoaded, NULL);
+	OMX_TEST_BAIL_IF_ERROR(eError);
+	StressTest_FreeBuffers(pCtxt);
+	eError = StressTest_WaitState(pCtxt, OMX_StateLoaded);
+
+      OMX_TEST_BAIL:
+	if (pCtxt->nEndNs == 0)
+		pCtxt->nEndNs = StressTest_Now();
+	if (eError != OMX_ErrorNone)
+	{
+		printf("instance %d failed: %s\n", pCtxt->nId,
+		    OMX_TEST_ErrorToString(eError));
+		StressTest_FreeBuffers(pCtxt);
+	}
+	if (pCtxt->hComp != NULL)
+		OMX_FreeHandle(pCtxt->hComp);
+	pCtxt->eError = eError;
+	return NULL;
+}
+
+/*========================================================*/
+/* @ fn StressTest_Run :: nInstances instances at the same time
+ *  @return Calls per second of all instances, 0 if one failed */
+/*========================================================*/
+static double StressTest_Run(OMX_U32 nInstances, OMX_U32 nBuffers,
+    OMX_U32 nBufferSize, OMX_U32 nIterations)
+{
+	StressCtxt *pCtxts;
+	OMX_U64 nStartNs = 0, nEndNs = 0, nCalls = 0;
+	OMX_U32 i, nStarted = 0;
+	OMX_BOOL bFailed = OMX_FALSE;
+	double fRate = 0;
+
+	pCtxts = calloc(nInstances, sizeof(StressCtxt));
+	if (pCtxts == NULL)
+		return 0;
+
+	for (i = 0; i < nInstances; i++)
+	{
+		StressCtxt *pCtxt = &pCtxts[i];
+
+		pCtxt->nId = i;
+		pCtxt->nBuffers = nBuffers;
+		pCtxt->nBufferSize = nBufferSize;
+		pCtxt->nIterations = nIterations;
+		pCtxt->nMaxLatencies = nIterations * 2 * STRESS_MAX_BUFFERS;
+		pCtxt->pLatencyNs = malloc(pCtxt->nMaxLatencies * sizeof(OMX_U64));
+		TIMM_OSAL_SemaphoreCreate(&pCtxt->hStateSetEvent, 0);
+		TIMM_OSAL_SemaphoreCreate(&pCtxt->hBufDoneEvent, 0);
+		if (pCtxt->pLatencyNs == NULL ||
+		    pthread_create(&pCtxt->tThread, NULL, StressTest_Instance,
+			pCtxt) != 0)
+		{
+			bFailed = OMX_TRUE;
+			break;
+		}
+		nStarted++;
+	}
+
+	for (i = 0; i < nStarted; i++)
+		pthread_join(pCtxts[i].tThread, NULL);
+
+	printf("%d instance(s), %d buffer(s) per port of %d bytes:\n",
+	    nInstances, pCtxts[0].nPortBuffers[OMX_SAMPLE_INPUT_PORT],
+	    pCtxts[0].nBufferSize);
+	for (i = 0; i < nStarted; i++)
+	{
+		StressCtxt *pCtxt = &pCtxts[i];
+		OMX_U64 nDuration = pCtxt->nEndNs - pCtxt->nStartNs;
+
+		if (pCtxt->eError != OMX_ErrorNone || pCtxt->nLatencies == 0)
+		{
+			bFailed = OMX_TRUE;
+			continue;
+		}
+		qsort(pCtxt->pLatencyNs, pCtxt->nLatencies, sizeof(OMX_U64),
+		    StressTest_CompareU64);
+		printf("  instance %d: %.0f calls/s, round trip p50 %llu us"
+		    " p99 %llu us\n", i,
+		    nDuration ? pCtxt->nCalls * 1e9 / nDuration : 0.0,
+		    pCtxt->pLatencyNs[(pCtxt->nLatencies - 1) / 2] / 1000,
+		    pCtxt->pLatencyNs[(pCtxt->nLatencies - 1) * 99 / 100] / 1000);
+
+		if (nStartNs == 0 || pCtxt->nStartNs < nStartNs)
+			nStartNs = pCtxt->nStartNs;
+		if (pCtxt->nEndNs > nEndNs)
+			nEndNs = pCtxt->nEndNs;
+		nCalls += pCtxt->nCalls;
+	}
+	if (!bFailed && nEndNs > nStartNs)
+	{
+		fRate = nCalls * 1e9 / (nEndNs - nStartNs);
+		printf("  total: %llu calls in %llu ms, %.0f calls/s\n", nCalls,
+		    (nEndNs - nStartNs) / 1000000, fRate);
+	} else
+	{
+		printf("  run failed\n");
+	}
+
+	for (i = 0; i < nInstances; i++)
+	{
+		if (pCtxts[i].hStateSetEvent)
+			TIMM_OSAL_SemaphoreDelete(pCtxts[i].hStateSetEvent);
+		if (pCtxts[i].hBufDoneEvent)
+			TIMM_OSAL_SemaphoreDelete(pCtxts[i].hBufDoneEvent);
+		free(pCtxts[i].pLatencyNs);
+	}
+	free(pCtxts);
+	return fRate;
+}
+
+static int StressTest_Main(int argc, char *argv[])
+{
+	OMX_U32 nInstances = 1, nBuffers = 0, nBufferSize = 0;
+	OMX_U32 nIterations = STRESS_DEFAULT_ITERATIONS, n, nScaled = 0;
+	double fRate, fLastRate = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:c:s:i:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n':
+			nInstances = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			nBuffers = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			nBufferSize = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			nIterations = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			printf("usage: %s -n instances [-c buffers per port]"
+			    " [-s buffer size] [-i iterations]\n", argv[0]);
+			return -1;
+		}
+	}
+	if (nInstances == 0 || nInstances > STRESS_MAX_INSTANCES ||
+	    nBuffers > STRESS_MAX_BUFFERS || nIterations == 0)
+	{
+		printf("1 to %d instances, up to %d buffers per port\n",
+		    STRESS_MAX_INSTANCES, STRESS_MAX_BUFFERS);
+		return -1;
+	}
+
+	if (OMX_Init() != OMX_ErrorNone)
+	{
+		printf("OMX_Init failed\n");
+		return -1;
+	}
+	for (n = 1; n <= nInstances; n++)
+	{
+		fRate = StressTest_Run(n, nBuffers, nBufferSize, nIterations);
+		if (fRate == 0)
+			break;
+		if (nScaled == 0 && n > 1 &&
+		    fRate < fLastRate * STRESS_SCALING_MIN_GAIN)
+			nScaled = n - 1;
+		fLastRate = fRate;
+	}
+	OMX_Deinit();
+
+	if (n <= nInstances)
+	{
+		printf("stress test failed with %d instance(s)\n", n);
+		return -1;
+	}
+	if (nScaled != 0)
+		printf("throughput stops scaling after %d instance(s)\n",
+		    nScaled);
+	else
+		printf("throughput still scaling at %d instance(s)\n",
+		    nInstances);
+	return 0;
+}
+
+
 /*========================================================*/
 /* @ fn OMX_Sample_UT0001 ::  Initializes, move to Idle and then to executing, process
 *    buffers and then destroy the component by moving back to idle, loaded, invalid */
 /*========================================================*/
-void main(void)
+int main(int argc, char *argv[])
 {
 	OMX_ERRORTYPE eError = OMX_ErrorNone;
 	OMX_HANDLETYPE hComp = NULL;
@@ -997,6 +1460,9 @@ void main(void)
 	int while_pass = 0, loc_diff = 0;
 
 
+	if (argc > 1)
+		return StressTest_Main(argc, argv);
+
 	pContext = &oAppData;
 	printf(" Entering : %s \n", __FUNCTION__);
 	memset(pContext, 0x0, sizeof(SampleCompTestCtxt));
@@ -1218,5 +1684,6 @@ if(hComp)
 	{
 		printf("\nTest case has failed.(OMX Error)\n");
 	}
+	return (eError == OMX_ErrorNone) ? 0 : -1;
 }
 
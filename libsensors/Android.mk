@@ -32,11 +32,11 @@ LOCAL_C_INCLUDES += device/amazon/bowser-common/libsensors_iio
 LOCAL_SRC_FILES := \
     sensors.cpp \
     IioSensorBase.cpp \
-    InputEventReader.cpp \
     LightSensor.cpp \
-    SensorBase.cpp
+    SensorStats.cpp
 
-LOCAL_SHARED_LIBRARIES := libinvensense_hal liblog libutils libdl
+LOCAL_SHARED_LIBRARIES := libinvensense_hal liblog libutils libdl libhardware_legacy
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(call first-makefiles-under,$(LOCAL_PATH))
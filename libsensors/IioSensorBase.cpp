@@ -18,6 +18,9 @@
 
 #include <fcntl.h>
 #include <errno.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <cutils/log.h>
 #include <pthread.h>
 
@@ -28,7 +31,7 @@ char *IioSensorBase::makeSysfsName(const char *input_name,
     char *name;
     int ret;
 
-    ret = asprintf(&name, "/sys/bus/iio/devices/%s/%s", input_name, file_name);
+    ret = asprintf(&name, IIO_SYSFS_DIR "/%s/%s", input_name, file_name);
     if (ret < 0)
         return NULL;
 
@@ -38,6 +41,212 @@ char *IioSensorBase::makeSysfsName(const char *input_name,
 void IioSensorBase::handleData(int value) {
 }
 
+bool IioSensorBase::shouldReport(const sensors_event_t &event) {
+    return true;
+}
+
+static bool readSysfsLine(const char *path, char *buf, size_t len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n <= 0)
+        return false;
+    buf[n] = '\0';
+    if (buf[n - 1] == '\n')
+        buf[n - 1] = '\0';
+    return true;
+}
+
+static bool writeSysfsString(const char *path, const char *value) {
+    int fd = open(path, O_WRONLY);
+    if (fd < 0)
+        return false;
+    ssize_t n = write(fd, value, strlen(value));
+    close(fd);
+    return n == (ssize_t)strlen(value);
+}
+
+/*
+ * Writes len bytes of value to a sysfs attribute whose fd is kept in *fd for
+ * the lifetime of the sensor, opening it on first use.
+ */
+ssize_t IioSensorBase::writeSysfsFd(int *fd, const char *path,
+                                   const char *value, size_t len) {
+    if (*fd < 0) {
+        if (path == NULL)
+            return -1;
+        *fd = open(path, O_RDWR);
+        if (*fd < 0)
+            return -1;
+    }
+    return pwrite(*fd, value, len, 0);
+}
+
+/* pull one channel out of a scan, following its scan_elements type */
+static int64_t decodeScanChan(const unsigned char *scan,
+                              const struct iio_scan_chan &chan) {
+    const unsigned char *p = scan + chan.offset;
+    uint64_t raw = 0;
+
+    for (int i = 0; i < chan.bytes; i++)
+        raw = (raw << 8) | p[chan.big_endian ? i : chan.bytes - 1 - i];
+    raw >>= chan.shift;
+    if (chan.bits < 64) {
+        uint64_t mask = (1ULL << chan.bits) - 1;
+        raw &= mask;
+        if (chan.is_signed && (raw >> (chan.bits - 1)))
+            raw |= ~mask;
+    }
+    return int64_t(raw);
+}
+
+/* Reads <elem>_index and <elem>_type, e.g. "le:u16/16>>0", from scan_elements */
+bool IioSensorBase::readScanChan(const char *elem, struct iio_scan_chan *chan) {
+    char name[PATH_MAX];
+    char buf[32];
+    char *path;
+    char endian, sign;
+    unsigned int bits, storage, shift;
+    bool ok;
+
+    snprintf(name, sizeof(name), "scan_elements/%s_index", elem);
+    path = makeSysfsName(mInputName, name);
+    ok = path && readSysfsLine(path, buf, sizeof(buf));
+    free(path);
+    if (!ok)
+        return false;
+    chan->index = atoi(buf);
+
+    snprintf(name, sizeof(name), "scan_elements/%s_type", elem);
+    path = makeSysfsName(mInputName, name);
+    ok = path && readSysfsLine(path, buf, sizeof(buf));
+    free(path);
+    if (!ok || sscanf(buf, "%ce:%c%u/%u>>%u", &endian, &sign, &bits,
+                      &storage, &shift) != 5)
+        return false;
+    if (!bits || bits > storage || storage % 8 || storage > 64)
+        return false;
+
+    chan->big_endian = (endian == 'b');
+    chan->is_signed = (sign == 's');
+    chan->bits = bits;
+    chan->bytes = storage / 8;
+    chan->shift = shift;
+    return true;
+}
+
+/*
+ * Switches the sensor to the IIO buffer: only chan_name and the timestamp
+ * are enabled in scan_elements and samples are read as binary scans from
+ * /dev/iio:deviceN. Returns false, leaving the sysfs channel file in use,
+ * when the driver has no buffer or trigger for it.
+ */
+bool IioSensorBase::setupBuffer(const char *chan_name) {
+    char elem[NAME_MAX];
+    char en_name[NAME_MAX];
+    char buf[NAME_MAX];
+    char path[PATH_MAX];
+    char *sysfs;
+    char *suffix;
+    DIR *dp;
+    const struct dirent *ent;
+    int dev_num;
+    bool ok;
+
+    /* in_illuminance0_input -> in_illuminance0 */
+    snprintf(elem, sizeof(elem), "%s", chan_name);
+    suffix = strrchr(elem, '_');
+    if (!suffix || (strcmp(suffix, "_input") && strcmp(suffix, "_raw")))
+        return false;
+    *suffix = '\0';
+    if (sscanf(mInputName, "iio:device%d", &dev_num) != 1)
+        return false;
+
+    mIioSysfsBufferEnable = makeSysfsName(mInputName, "buffer/enable");
+    if (!mIioSysfsBufferEnable ||
+            writeSysfsFd(&mBufferEnableFd, mIioSysfsBufferEnable, "0", 1) != 1)
+        return false;
+
+    /* use the trigger already bound, else the device's own */
+    sysfs = makeSysfsName(mInputName, "trigger/current_trigger");
+    ok = sysfs && readSysfsLine(sysfs, buf, sizeof(buf)) && buf[0];
+    if (sysfs && !ok) {
+        snprintf(buf, sizeof(buf), "%s-dev%d", mDataName, dev_num);
+        ok = writeSysfsString(sysfs, buf);
+    }
+    free(sysfs);
+    if (!ok)
+        return false;
+
+    snprintf(path, sizeof(path), IIO_SYSFS_DIR "/%s/scan_elements",
+             mInputName);
+    dp = opendir(path);
+    if (dp == NULL)
+        return false;
+    snprintf(en_name, sizeof(en_name), "%s_en", elem);
+    while ((ent = readdir(dp)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len < 3 || strcmp(ent->d_name + len - 3, "_en"))
+            continue;
+        snprintf(path, sizeof(path), "scan_elements/%s", ent->d_name);
+        sysfs = makeSysfsName(mInputName, path);
+        if (sysfs) {
+            writeSysfsString(sysfs, (!strcmp(ent->d_name, en_name) ||
+                                     !strcmp(ent->d_name, "in_timestamp_en")) ?
+                             "1" : "0");
+            free(sysfs);
+        }
+    }
+    closedir(dp);
+
+    if (!readScanChan(elem, &mScanValue))
+        return false;
+    mHasScanTimestamp = readScanChan("in_timestamp", &mScanTimestamp);
+
+    /* channels are packed by index, each aligned to its own size */
+    struct iio_scan_chan *first = &mScanValue, *second = NULL;
+    if (mHasScanTimestamp) {
+        second = &mScanTimestamp;
+        if (mScanTimestamp.index < mScanValue.index) {
+            first = &mScanTimestamp;
+            second = &mScanValue;
+        }
+    }
+    first->offset = 0;
+    mScanBytes = first->bytes;
+    if (second) {
+        second->offset = (mScanBytes + second->bytes - 1) / second->bytes *
+                         second->bytes;
+        mScanBytes = second->offset + second->bytes;
+    }
+    /* a scan is padded to a multiple of its largest channel */
+    int align = (second && second->bytes > first->bytes) ?
+                second->bytes : first->bytes;
+    mScanBytes = (mScanBytes + align - 1) / align * align;
+    if (mScanBytes > IIO_MAX_SCAN_BYTES)
+        return false;
+
+    snprintf(path, sizeof(path), IIO_DEV_DIR "/%s", mInputName);
+    mIioBufferFd = open(path, O_RDONLY | O_NONBLOCK);
+    if (mIioBufferFd < 0) {
+        ALOGE("%s: couldn't open %s (%s)", __func__, path, strerror(errno));
+        return false;
+    }
+
+    /* samples come from the buffer now, the threshold events are unused */
+    writeSysfsString(mInputSysfsEnable, "0");
+    ALOGI("%s: %s reads %d byte scans from %s", __func__, mDataName,
+          mScanBytes, path);
+    return true;
+}
+
+int IioSensorBase::enableBuffer(int en) {
+    return writeSysfsFd(&mBufferEnableFd, mIioSysfsBufferEnable,
+                        en ? "1" : "0", 1) == 1 ? 0 : -1;
+}
+
 IioSensorBase::IioSensorBase(const char *dev_name,
                                      const char *data_name,
                                      const char *enable_name,
@@ -48,7 +257,15 @@ IioSensorBase::IioSensorBase(const char *dev_name,
       mHasPendingEvent(false),
       mInputReader(MAX_BUFFER_FOR_EVENT),
       mIioChanType(iio_chan_type),
-      mIioSysfsChanFp(NULL)
+      mIioSysfsChanFp(NULL),
+      mIioBufferFd(-1),
+      mIioSysfsBufferEnable(NULL),
+      mScanBytes(0),
+      mHasScanTimestamp(false),
+      mEnableFd(-1),
+      mSamplingFrequencyFd(-1),
+      mBufferEnableFd(-1),
+      mSamplingFrequency(-1)
 {
     pthread_mutex_init(&mLock, NULL);
     ALOGV("%s(): dev_name=%s", __func__, dev_name);
@@ -77,10 +294,14 @@ IioSensorBase::IioSensorBase(const char *dev_name,
         return;
     }
 
-    mIioSysfsChanFp = fopen(mIioSysfsChan, "r");
-    if (mIioSysfsChanFp == NULL) {
-        ALOGE("%s: unable to open %s", __func__, mIioSysfsChan);
-        return;
+    if (!setupBuffer(chan_name)) {
+        ALOGI("%s: no IIO buffer for %s, reading %s", __func__, data_name,
+              mIioSysfsChan);
+        mIioSysfsChanFp = fopen(mIioSysfsChan, "r");
+        if (mIioSysfsChanFp == NULL) {
+            ALOGE("%s: unable to open %s", __func__, mIioSysfsChan);
+            return;
+        }
     }
 
     int flags = fcntl(mDataFd, F_GETFL, 0);
@@ -96,6 +317,19 @@ IioSensorBase::~IioSensorBase() {
     if (mIioSysfsChanFp != NULL) {
         fclose(mIioSysfsChanFp);
     }
+    if (mIioBufferFd >= 0) {
+        close(mIioBufferFd);
+    }
+    if (mEnableFd >= 0) {
+        close(mEnableFd);
+    }
+    if (mSamplingFrequencyFd >= 0) {
+        close(mSamplingFrequencyFd);
+    }
+    if (mBufferEnableFd >= 0) {
+        close(mBufferEnableFd);
+    }
+    free(mIioSysfsBufferEnable);
     free(mInputSysfsEnable);
     free(mInputSysfsSamplingFrequency);
     free(mIioSysfsChan);
@@ -123,45 +357,44 @@ int IioSensorBase::enable(int32_t handle, int en)
     ALOGI("%s: %s %d", __func__,  mDevName, en);
 
     pthread_mutex_lock(&mLock);
-    if (en != mEnabled) {
-        int fd;
-        fd = open(mInputSysfsEnable, O_RDWR);
-        if (fd >= 0) {
-            err = write(fd, en ? "1" : "0", 2);
-            close(fd);
-            if (err < 0) {
-                goto cleanup;
-            }
+    if (en != mEnabled && mIioBufferFd >= 0) {
+        err = enableBuffer(en);
+        if (!err)
+            mEnabled = en;
+    } else if (en != mEnabled) {
+        err = writeSysfsFd(&mEnableFd, mInputSysfsEnable, en ? "1" : "0", 2);
+        if (err >= 0) {
             mEnabled = en;
             err = 0;
         } else {
             err = -1;
         }
     }
-cleanup:
     pthread_mutex_unlock(&mLock);
     return err;
 }
 
 int IioSensorBase::setDelay(int32_t handle, int64_t ns)
 {
-    int fd;
     int result = 0;
+    int64_t freq;
     char buf[21]; /* 21 = log10(max long long int) + 1 for sign + '\0' */
     pthread_mutex_lock(&mLock);
     if (!ns) {
         result = -1;
         goto done;
     }
-    fd = open(mInputSysfsSamplingFrequency, O_RDWR);
-    if (fd < 0) {
+    /* round up ((NSEC_PER_SEC - 1) + ns) / ns */
+    freq = ((1000000000 - 1) + ns) / ns;
+    if (freq == mSamplingFrequency)
+        goto done;
+    sprintf(buf, "%lld", freq);
+    if (writeSysfsFd(&mSamplingFrequencyFd, mInputSysfsSamplingFrequency,
+                     buf, strlen(buf)+1) < 0) {
         result = -1;
         goto done;
     }
-    /* round up ((NSEC_PER_SEC - 1) + ns) / ns */
-    sprintf(buf, "%lld", ((1000000000 - 1) + ns) / ns);
-    write(fd, buf, strlen(buf)+1);
-    close(fd);
+    mSamplingFrequency = freq;
 done:
     pthread_mutex_unlock(&mLock);
     return result;
@@ -185,23 +418,75 @@ int IioSensorBase::readEvents(sensors_event_t* data, int count)
         goto done;
     }
 
+    if (mIioBufferFd >= 0) {
+        if (mEnabled)
+            numEventReceived = readBufferedEvents(data, count);
+        goto done;
+    }
+
     iio_event_data const* event;
+    ssize_t n;
 
-    while (count && mInputReader.readEvent(mDataFd, &event)) {
-        int value;
-        if (IIO_EVENT_CODE_EXTRACT_CHAN_TYPE(event->id) == mIioChanType) {
+    while (count && (n = mInputReader.readEvents(mDataFd, &event)) > 0) {
+        ssize_t i;
+        for (i = 0; i < n && count; i++, event++) {
+            int value;
+            if (IIO_EVENT_CODE_EXTRACT_CHAN_TYPE(event->id) != mIioChanType)
+                continue;
             if (mEnabled && readValue(&value)) {
                 handleData(value);
                 mPendingEvent.timestamp = event->timestamp;
+                if (shouldReport(mPendingEvent)) {
+                    *data++ = mPendingEvent;
+                    count--;
+                    numEventReceived++;
+                }
+            }
+        }
+        mInputReader.next(i);
+    }
+
+done:
+    pthread_mutex_unlock(&mLock);
+    return numEventReceived;
+}
+
+int IioSensorBase::getFd() const
+{
+    if (mIioBufferFd >= 0)
+        return mIioBufferFd;
+    return SensorBase::getFd();
+}
+
+/* Called with mLock held. Reads as many whole scans as fit in count. */
+int IioSensorBase::readBufferedEvents(sensors_event_t* data, int count)
+{
+    unsigned char buf[MAX_BUFFER_FOR_EVENT * IIO_MAX_SCAN_BYTES];
+    int numEventReceived = 0;
+
+    while (count) {
+        int want = count < MAX_BUFFER_FOR_EVENT ? count : MAX_BUFFER_FOR_EVENT;
+        ssize_t nread = read(mIioBufferFd, buf, want * mScanBytes);
+        if (nread <= 0) {
+            ALOGE_IF(nread < 0 && errno != EAGAIN, "%s: read failed (%s)",
+                     __func__, strerror(errno));
+            break;
+        }
+        int scans = nread / mScanBytes;
+        for (int i = 0; i < scans && count; i++) {
+            const unsigned char *scan = buf + i * mScanBytes;
+            handleData(int(decodeScanChan(scan, mScanValue)));
+            mPendingEvent.timestamp = mHasScanTimestamp ?
+                    decodeScanChan(scan, mScanTimestamp) : getTimestamp();
+            if (shouldReport(mPendingEvent)) {
                 *data++ = mPendingEvent;
                 count--;
                 numEventReceived++;
             }
         }
-        mInputReader.next();
+        if (scans < want)
+            break;
     }
 
-done:
-    pthread_mutex_unlock(&mLock);
     return numEventReceived;
 }
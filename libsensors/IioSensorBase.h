@@ -28,12 +28,25 @@
 
 /*****************************************************************************/
 #define MAX_BUFFER_FOR_EVENT 4
+/* largest scan read from the IIO buffer: one channel plus the timestamp */
+#define IIO_MAX_SCAN_BYTES 32
+
+/* where one channel sits in a buffered scan, from scan_elements */
+struct iio_scan_chan {
+    int index;
+    int offset;
+    int bytes;
+    int bits;
+    int shift;
+    bool is_signed;
+    bool big_endian;
+};
 
 class IioSensorBase:public SensorBase {
 protected:
     bool mEnabled;
     bool mHasPendingEvent;
-    InputEventCircularReader mInputReader;
+    IioEventCircularReader mInputReader;
     sensors_event_t mPendingEvent;
     char *mInputSysfsEnable;
     char *mInputSysfsSamplingFrequency;
@@ -42,11 +55,33 @@ protected:
     FILE *mIioSysfsChanFp;
     pthread_mutex_t mLock;
 
+    /* buffered scan mode, samples come from /dev/iio:deviceN when set up */
+    int mIioBufferFd;
+    char *mIioSysfsBufferEnable;
+    int mScanBytes;
+    struct iio_scan_chan mScanValue;
+    struct iio_scan_chan mScanTimestamp;
+    bool mHasScanTimestamp;
+
+    /* sysfs attributes stay open once used, see writeSysfsFd() */
+    int mEnableFd;
+    int mSamplingFrequencyFd;
+    int mBufferEnableFd;
+    int64_t mSamplingFrequency;
+
     char *makeSysfsName(const char *input_name,
                         const char *input_file);
+    static ssize_t writeSysfsFd(int *fd, const char *path, const char *value,
+                                size_t len);
+    bool setupBuffer(const char *chan_name);
+    bool readScanChan(const char *elem, struct iio_scan_chan *chan);
+    int enableBuffer(int en);
+    int readBufferedEvents(sensors_event_t *data, int count);
 
     virtual bool readValue(int *value);
     virtual void handleData(int value);
+    /* called once mPendingEvent holds a new sample, false drops it */
+    virtual bool shouldReport(const sensors_event_t &event);
 
 public:
     IioSensorBase(const char* dev_name,
@@ -59,5 +94,6 @@ public:
     virtual int enable(int32_t handle, int en);
     virtual int setDelay(int32_t handle, int64_t ns);
     virtual int readEvents(sensors_event_t *data, int count);
+    virtual int getFd() const;
 };
 #endif /* SAMSUNG_SENSORBASE_H */
@@ -14,18 +14,101 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <cutils/log.h>
 #include <pthread.h>
+#include <math.h>
 
 #include "LightSensor.h"
 
 LightSensor::LightSensor()
     : IioSensorBase(NULL, "MAX44007",
                         "events/in_illuminance0_thresh_either_en",
-                        "in_illuminance0_input", IIO_LIGHT)
+                        "in_illuminance0_input", IIO_LIGHT),
+      mReported(false),
+      mLastLux(0),
+      mLastTimestamp(0),
+      mThreshRising(NULL),
+      mThreshFalling(NULL),
+      mThreshRisingFd(-1),
+      mThreshFallingFd(-1),
+      mThreshLow(-1),
+      mThreshHigh(-1)
 {
     mPendingEvent.sensor = ID_L;
     mPendingEvent.type = SENSOR_TYPE_LIGHT;
+
+    /* buffered samples don't go through the threshold events */
+    if (mDataFd < 0 || mIioBufferFd >= 0)
+        return;
+    mThreshRising = makeSysfsName(mInputName,
+                        "events/in_illuminance0_thresh_rising_value");
+    mThreshFalling = makeSysfsName(mInputName,
+                        "events/in_illuminance0_thresh_falling_value");
+}
+
+LightSensor::~LightSensor() {
+    if (mThreshRisingFd >= 0)
+        close(mThreshRisingFd);
+    if (mThreshFallingFd >= 0)
+        close(mThreshFallingFd);
+    free(mThreshRising);
+    free(mThreshFalling);
+}
+
+static const struct light_thresh_band threshBands[] = {
+    { 10,       50 },
+    { 100,      30 },
+    { 1000,     20 },
+    { INT_MAX,  LIGHT_HYSTERESIS_PERCENT },
+};
+
+/*
+ * Called with mLock held. An attribute that can't be written is given up
+ * on, the driver's own threshold then stays in place.
+ */
+void LightSensor::writeThreshold(int *fd, char **path, int value) {
+    char buf[12];
+    int len = snprintf(buf, sizeof(buf), "%d", value);
+
+    if (*path == NULL)
+        return;
+    if (writeSysfsFd(fd, *path, buf, len) != len && *fd < 0) {
+        ALOGW("LightSensor: can't write %s", *path);
+        free(*path);
+        *path = NULL;
+    }
+}
+
+/* Called with mLock held */
+void LightSensor::setThresholds(int value) {
+    const struct light_thresh_band *band = threshBands;
+    int delta, low, high;
+
+    while (band->below != INT_MAX && value >= band->below)
+        band++;
+    delta = value * band->percent / 100;
+    if (delta < LIGHT_HYSTERESIS_MIN_LUX)
+        delta = LIGHT_HYSTERESIS_MIN_LUX;
+    low = value > delta ? value - delta : 0;
+    high = value < INT_MAX - delta ? value + delta : INT_MAX;
+    if (low == mThreshLow && high == mThreshHigh)
+        return;
+
+    /* the window moves one edge at a time, keep falling below rising */
+    if (low >= mThreshHigh) {
+        writeThreshold(&mThreshRisingFd, &mThreshRising, high);
+        writeThreshold(&mThreshFallingFd, &mThreshFalling, low);
+    } else {
+        writeThreshold(&mThreshFallingFd, &mThreshFalling, low);
+        writeThreshold(&mThreshRisingFd, &mThreshRising, high);
+    }
+    ALOGV("LightSensor: thresholds %d..%d lux", low, high);
+    mThreshLow = low;
+    mThreshHigh = high;
 }
 
 void LightSensor::handleData(int value) {
@@ -33,4 +116,41 @@ void LightSensor::handleData(int value) {
 
     /* Measured raw values are 8.9 times lower than actual values*/
     mPendingEvent.light = value; // * 8.9;
+
+    if (mThreshRising || mThreshFalling)
+        setThresholds(value);
+}
+
+int LightSensor::enable(int32_t handle, int en) {
+    int err = IioSensorBase::enable(handle, en);
+
+    /* the first sample after enabling is always reported */
+    pthread_mutex_lock(&mLock);
+    if (!err) {
+        mReported = false;
+        mThreshLow = mThreshHigh = -1;
+    }
+    pthread_mutex_unlock(&mLock);
+    return err;
+}
+
+/* Called from readEvents() with mLock held */
+bool LightSensor::shouldReport(const sensors_event_t &event) {
+    if (mReported) {
+        float delta = fabsf(event.light - mLastLux);
+        float hysteresis = mLastLux * LIGHT_HYSTERESIS_PERCENT / 100;
+
+        if (hysteresis < LIGHT_HYSTERESIS_MIN_LUX)
+            hysteresis = LIGHT_HYSTERESIS_MIN_LUX;
+        if (delta < hysteresis)
+            return false;
+        if (event.timestamp - mLastTimestamp < LIGHT_MIN_INTERVAL_NS)
+            return false;
+    }
+
+    ALOGV("LightSensor: report %f lux", event.light);
+    mReported = true;
+    mLastLux = event.light;
+    mLastTimestamp = event.timestamp;
+    return true;
 }
@@ -28,13 +28,58 @@
 
 /*****************************************************************************/
 
+/*
+ * Lux changes smaller than LIGHT_HYSTERESIS_PERCENT of the last reported
+ * value (and at least LIGHT_HYSTERESIS_MIN_LUX) are not reported, and reports
+ * are at least LIGHT_MIN_INTERVAL_NS apart. Both can be overridden from the
+ * board makefile through LOCAL_CFLAGS.
+ */
+#ifndef LIGHT_HYSTERESIS_PERCENT
+#define LIGHT_HYSTERESIS_PERCENT 10
+#endif
+#ifndef LIGHT_HYSTERESIS_MIN_LUX
+#define LIGHT_HYSTERESIS_MIN_LUX 2
+#endif
+#ifndef LIGHT_MIN_INTERVAL_NS
+#define LIGHT_MIN_INTERVAL_NS 200000000LL
+#endif
+
+/*
+ * The MAX44007 only interrupts when the lux leaves the window between its
+ * falling and rising thresholds, which is re-centered on every sample. The
+ * window is a percentage of the reading that narrows as the light gets
+ * brighter and is never tighter than the hysteresis above, so each wakeup
+ * is a change that gets reported.
+ */
+struct light_thresh_band {
+    int below;      /* readings under this many lux... */
+    int percent;    /* ...get a window of +/- percent */
+};
+
 struct iio_event_data;
 
 class LightSensor:public IioSensorBase {
+    bool mReported;
+    float mLastLux;
+    int64_t mLastTimestamp;
+
+    char *mThreshRising;
+    char *mThreshFalling;
+    int mThreshRisingFd;
+    int mThreshFallingFd;
+    int mThreshLow;
+    int mThreshHigh;
+
+    void writeThreshold(int *fd, char **path, int value);
+    void setThresholds(int value);
+
     virtual void handleData(int value);
+    virtual bool shouldReport(const sensors_event_t &event);
 
 public:
     LightSensor();
+    virtual ~LightSensor();
+    virtual int enable(int32_t handle, int en);
 };
 
 /*****************************************************************************/
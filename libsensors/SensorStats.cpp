@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2012 The Android Open-Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Sensors"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "SensorStats.h"
+
+/*****************************************************************************/
+
+static const int64_t latencyLimitsMs[SensorStats::numLatencyBuckets - 1] = {
+    1, 2, 5, 10, 20, 50, 100, 200
+};
+
+SensorStats::SensorStats()
+    : mEnabled(false),
+      mNextCheck(0)
+{
+    memset(&mLastRead, 0, sizeof(mLastRead));
+    reset(NULL, 0);
+}
+
+int64_t SensorStats::now()
+{
+    struct timespec t;
+    t.tv_sec = t.tv_nsec = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec)*1000000000LL + t.tv_nsec;
+}
+
+void SensorStats::reset(MPLSensor *mpl, int64_t now)
+{
+    mStart = now;
+    mPolls = 0;
+    memset(mBatch, 0, sizeof(mBatch));
+    memset(mHandles, 0, sizeof(mHandles));
+    if (mpl)
+        mpl->getReadStats(&mLastRead);
+}
+
+void SensorStats::countPoll(const sensors_event_t *data, int count)
+{
+    const int64_t t = now();
+    int b = 0;
+    while (b < numBatchBuckets - 1 && count >= (1 << b))
+        b++;
+    mBatch[b]++;
+    mPolls++;
+
+    for (int i = 0; i < count; i++) {
+        const sensors_event_t& ev(data[i]);
+        if (ev.sensor < 0 || ev.sensor >= maxHandles)
+            continue;
+        handleStats& h(mHandles[ev.sensor]);
+        int64_t latency = t - ev.timestamp;
+        if (latency < 0)
+            latency = 0;
+        int l = 0;
+        while (l < numLatencyBuckets - 1 &&
+               latency >= latencyLimitsMs[l] * 1000000LL)
+            l++;
+        h.latency[l]++;
+        h.events++;
+        h.totalLatency += latency;
+        if (latency > h.maxLatency)
+            h.maxLatency = latency;
+    }
+}
+
+void SensorStats::update(MPLSensor *mpl)
+{
+    const int64_t t = now();
+    if (t < mNextCheck)
+        return;
+    mNextCheck = t + STATS_DUMP_INTERVAL_NS;
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get(STATS_PROPERTY, value, "0");
+    bool enable = (atoi(value) != 0);
+
+    if (enable && mEnabled)
+        dump(mpl, t);
+    if (enable != mEnabled)
+        ALOGI("sensor stats %s", enable ? "on" : "off");
+    mEnabled = enable;
+    reset(mpl, t);
+}
+
+void SensorStats::dump(MPLSensor *mpl, int64_t now)
+{
+    char line[160];
+    int len;
+
+    ALOGI("stats: %lld ms, %u polls, events per poll "
+          "0:%u 1:%u 2-3:%u 4-7:%u 8-15:%u 16-31:%u 32+:%u",
+          (now - mStart) / 1000000LL, mPolls, mBatch[0], mBatch[1], mBatch[2],
+          mBatch[3], mBatch[4], mBatch[5], mBatch[6]);
+
+    for (int i = 0; i < maxHandles; i++) {
+        const handleStats& h(mHandles[i]);
+        if (!h.events)
+            continue;
+        len = snprintf(line, sizeof(line), "stats: handle %d, %u events, "
+                       "latency avg %lld us max %lld us, ms", i, h.events,
+                       h.totalLatency / h.events / 1000, h.maxLatency / 1000);
+        for (int l = 0; l < numLatencyBuckets && len < (int)sizeof(line); l++) {
+            if (l < numLatencyBuckets - 1)
+                len += snprintf(line + len, sizeof(line) - len, " <%lld:%u",
+                                latencyLimitsMs[l], h.latency[l]);
+            else
+                len += snprintf(line + len, sizeof(line) - len, " more:%u",
+                                h.latency[l]);
+        }
+        ALOGI("%s", line);
+    }
+
+    if (mpl) {
+        MPLSensor::iio_read_stats r;
+        mpl->getReadStats(&r);
+        int32_t reads = r.reads - mLastRead.reads;
+        int32_t scans = r.scans - mLastRead.scans;
+        ALOGI("stats: iio %d reads, %d scans (%d.%02d per read), "
+              "%d short reads, %d dropped",
+              reads, scans,
+              reads ? scans / reads : 0, reads ? (scans * 100 / reads) % 100 : 0,
+              r.shortReads - mLastRead.shortReads, r.dropped - mLastRead.dropped);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2012 The Android Open-Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SENSOR_STATS_H
+#define ANDROID_SENSOR_STATS_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+#include "sensors.h"
+#include "MPLSensor.h"
+
+/*****************************************************************************/
+
+/*
+ * Delivery counters for the poll loop. Off unless the debug.sensors.stats
+ * property is set to 1; while on, a summary is logged every
+ * STATS_DUMP_INTERVAL_NS and the counters start over. Latency is the time
+ * from an event's timestamp to the pollEvents() return that delivers it.
+ */
+#ifndef STATS_DUMP_INTERVAL_NS
+#define STATS_DUMP_INTERVAL_NS 10000000000LL
+#endif
+#define STATS_PROPERTY "debug.sensors.stats"
+
+class SensorStats {
+public:
+    enum {
+        maxHandles = 16,
+        numLatencyBuckets = 9,  // <1, <2, <5, <10, <20, <50, <100, <200, more ms
+        numBatchBuckets = 7,    // 0, 1, 2-3, 4-7, 8-15, 16-31, more events
+    };
+
+    SensorStats();
+
+    bool enabled() const { return mEnabled; }
+    // record what one pollEvents() call returned, only while enabled()
+    void countPoll(const sensors_event_t *data, int count);
+    // re-read the property, log and restart the counters when due
+    void update(MPLSensor *mpl);
+
+private:
+    struct handleStats {
+        uint32_t events;
+        uint32_t latency[numLatencyBuckets];
+        int64_t maxLatency;
+        int64_t totalLatency;
+    };
+
+    bool mEnabled;
+    int64_t mStart;
+    int64_t mNextCheck;
+    uint32_t mPolls;
+    uint32_t mBatch[numBatchBuckets];
+    handleStats mHandles[maxHandles];
+    MPLSensor::iio_read_stats mLastRead;
+
+    static int64_t now();
+    void reset(MPLSensor *mpl, int64_t now);
+    void dump(MPLSensor *mpl, int64_t now);
+};
+
+/*****************************************************************************/
+
+#endif  /* ANDROID_SENSOR_STATS_H */
@@ -0,0 +1,65 @@
+LOCAL_PATH := $(call my-dir)
+
+#
+# sensors_bench: CPU, system call and latency cost of the sensor HAL, run
+# over a fake IIO device tree instead of the hardware
+#
+
+include $(CLEAR_VARS)
+
+HAL_IIO_DIR := ../../libsensors_iio
+MLLITE_DIR := $(HAL_IIO_DIR)/software/core/mllite
+
+# where the bench lays out its fake devices; the sysfs attribute paths built
+# under it have to fit in MAX_SYSFS_NAME_LEN
+BENCH_ROOT := /data/local/tmp/sbench
+
+# calls counted in syscalls_per_sample
+BENCH_WRAPPED := read write pread pwrite open close ioctl poll epoll_wait \
+                 lseek fopen fclose
+
+LOCAL_MODULE := sensors_bench
+LOCAL_MODULE_TAGS := optional
+
+# the HAL is built in, with its paths moved under BENCH_ROOT
+LOCAL_SRC_FILES := \
+    sensors_bench.cpp \
+    ../sensors.cpp \
+    ../IioSensorBase.cpp \
+    ../LightSensor.cpp \
+    ../SensorStats.cpp \
+    $(HAL_IIO_DIR)/SensorBase.cpp \
+    $(HAL_IIO_DIR)/MPLSensor.cpp \
+    $(HAL_IIO_DIR)/MPLSupport.cpp \
+    $(HAL_IIO_DIR)/InputEventReader.cpp \
+    $(HAL_IIO_DIR)/IIOSampleRing.cpp \
+    $(HAL_IIO_DIR)/CompassSensor.IIO.9150.cpp \
+    $(MLLITE_DIR)/linux/ml_sysfs_helper.c \
+    $(MLLITE_DIR)/linux/ml_stored_data.c
+
+LOCAL_CFLAGS := -DLOG_TAG=\"Sensors\"
+LOCAL_CFLAGS += -DANDROID_JELLYBEAN
+LOCAL_CFLAGS += -DINVENSENSE_COMPASS_CAL
+LOCAL_CFLAGS += -DSENSORS_BENCH_ROOT=\"$(BENCH_ROOT)\"
+LOCAL_CFLAGS += -DIIO_SYSFS_DIR=\"$(BENCH_ROOT)/sys/bus/iio/devices\"
+LOCAL_CFLAGS += -DIIO_DEV_DIR=\"$(BENCH_ROOT)/dev\"
+LOCAL_CFLAGS += -DPROC_INPUT_DEVICES=\"$(BENCH_ROOT)/proc_input_devices\"
+LOCAL_CFLAGS += -DTOPOLOGY_FILE=\"$(BENCH_ROOT)/inv_hal_topology.bin\"
+LOCAL_CFLAGS += -DMLCAL_FILE=\"$(BENCH_ROOT)/inv_cal_data.bin\"
+LOCAL_CPPFLAGS += -DLINUX=1
+
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(HAL_IIO_DIR)
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(MLLITE_DIR)
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(MLLITE_DIR)/linux
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(HAL_IIO_DIR)/software/core/mpl
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(HAL_IIO_DIR)/software/core/driver/include
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(HAL_IIO_DIR)/software/core/driver/include/linux
+
+LOCAL_LDFLAGS += $(foreach f,$(BENCH_WRAPPED),-Wl,--wrap=$(f))
+
+# the MPL itself only ships as the prebuilt ARM libraries, so the bench
+# runs on the target
+LOCAL_SHARED_LIBRARIES := liblog libcutils libutils libdl libmllite libmplmpu
+
+include $(BUILD_EXECUTABLE)
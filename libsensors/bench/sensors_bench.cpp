@@ -0,0 +1,828 @@
+/*
+ * Copyright (C) 2012 The Android Open-Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Micro-benchmark of the sensor HAL over a fake IIO device tree:
+ *
+ *   sensors_bench [-r mpu Hz] [-l light Hz] [-b scans per write]
+ *                 [-d seconds] [-w warmup seconds] [-m mix[,mix...]]
+ *
+ * The HAL sources are built into this binary with their sysfs, /dev and
+ * /proc paths moved under SENSORS_BENCH_ROOT (see Android.mk). The bench
+ * lays out an MPU6050 and a MAX44007 there, regular files for the
+ * attributes and a FIFO for each device node, opens the HAL through its
+ * module entry point and polls it from a thread of its own the way the
+ * framework does. A backend thread writes synthetic scans into the FIFOs at
+ * the configured rates, in the layout the HAL enabled in the fake sysfs.
+ *
+ * Every sensor mix prints one JSON object per line on stdout:
+ *   samples, dropped      scans written by the backend in the window, and
+ *                         scans lost because the FIFO was full
+ *   events                events returned by poll()
+ *   cpu_us_per_sample     process CPU time, minus the backend's, per scan
+ *   syscalls_per_sample   system calls made by the HAL threads per scan;
+ *                         only the direct calls of the code linked in here
+ *                         are counted (see BENCH_WRAPPED in Android.mk), not
+ *                         the ones inside stdio or the prebuilt MPL
+ *   lat_*_us              scan timestamp to the poll() return delivering it
+ *
+ * Progress and errors go to stderr. Scans carry CLOCK_MONOTONIC timestamps,
+ * like the driver's.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <hardware/sensors.h>
+
+#include "sensors.h"
+#include "SensorBase.h"
+
+#ifndef SENSORS_BENCH_ROOT
+#error "sensors_bench needs SENSORS_BENCH_ROOT and the HAL paths under it, see Android.mk"
+#endif
+
+extern struct sensors_module_t HAL_MODULE_INFO_SYM;
+
+/*****************************************************************************/
+
+#define BENCH_DEFAULT_MPU_RATE      200
+#define BENCH_DEFAULT_LIGHT_RATE    10
+#define BENCH_DEFAULT_SECONDS       5
+#define BENCH_DEFAULT_WARMUP        1
+/* a write of up to PIPE_BUF bytes reaches the FIFO whole or not at all */
+#define BENCH_MAX_BATCH             64
+#define BENCH_MAX_SCAN_BYTES        48
+#define BENCH_POLL_EVENTS           16
+#define BENCH_MAX_LATENCIES         (1 << 18)
+#define BENCH_MAX_HANDLES           9
+
+#define MPU_DEVICE      "iio:device0"
+#define LIGHT_DEVICE    "iio:device1"
+
+/*****************************************************************************/
+
+/* one attribute of the fake tree, relative to IIO_SYSFS_DIR */
+struct benchAttr {
+    const char *path;
+    const char *value;
+};
+
+static const benchAttr sAttrs[] = {
+    { MPU_DEVICE "/name",                               "mpu6050" },
+    { MPU_DEVICE "/key",                "00000000000000000000000000000000" },
+    { MPU_DEVICE "/buffer/enable",                      "0" },
+    { MPU_DEVICE "/buffer/length",                      "0" },
+    { MPU_DEVICE "/power_state",                        "0" },
+    { MPU_DEVICE "/trigger/current_trigger",            "" },
+    { MPU_DEVICE "/dmp_firmware",                       "" },
+    /* the DMP counts as loaded, so no image is written */
+    { MPU_DEVICE "/firmware_loaded",                    "1" },
+    { MPU_DEVICE "/dmp_on",                             "0" },
+    { MPU_DEVICE "/dmp_int_on",                         "0" },
+    { MPU_DEVICE "/dmp_event_int_on",                   "0" },
+    { MPU_DEVICE "/dmp_output_rate",                    "0" },
+    { MPU_DEVICE "/tap_on",                             "0" },
+    { MPU_DEVICE "/self_test",                          "0" },
+    { MPU_DEVICE "/temperature",                        "0 0" },
+    { MPU_DEVICE "/gyro_enable",                        "0" },
+    { MPU_DEVICE "/gyro_matrix",                        "1,0,0,0,1,0,0,0,1" },
+    { MPU_DEVICE "/accl_enable",                        "0" },
+    { MPU_DEVICE "/accl_matrix",                        "1,0,0,0,1,0,0,0,1" },
+    { MPU_DEVICE "/accl_bias",                          "0,0,0" },
+    { MPU_DEVICE "/in_accel_scale",                     "2" },
+    { MPU_DEVICE "/sampling_frequency",                 "0" },
+    { MPU_DEVICE "/quaternion_on",                      "0" },
+    { MPU_DEVICE "/display_orientation_on",             "0" },
+    { MPU_DEVICE "/event_display_orientation",          "0" },
+    { MPU_DEVICE "/compass_enable",                     "0" },
+    { MPU_DEVICE "/compass_matrix",                     "1,0,0,0,1,0,0,0,1" },
+    { MPU_DEVICE "/in_magn_scale",                      "1" },
+    { MPU_DEVICE "/scan_elements/in_timestamp_en",      "0" },
+    { MPU_DEVICE "/scan_elements/in_anglvel_x_en",      "0" },
+    { MPU_DEVICE "/scan_elements/in_anglvel_y_en",      "0" },
+    { MPU_DEVICE "/scan_elements/in_anglvel_z_en",      "0" },
+    { MPU_DEVICE "/scan_elements/in_accel_x_en",        "0" },
+    { MPU_DEVICE "/scan_elements/in_accel_y_en",        "0" },
+    { MPU_DEVICE "/scan_elements/in_accel_z_en",        "0" },
+    { MPU_DEVICE "/scan_elements/in_magn_x_en",         "0" },
+    { MPU_DEVICE "/scan_elements/in_magn_y_en",         "0" },
+    { MPU_DEVICE "/scan_elements/in_magn_z_en",         "0" },
+    { MPU_DEVICE "/scan_elements/in_quaternion_r_en",   "0" },
+    { MPU_DEVICE "/scan_elements/in_quaternion_x_en",   "0" },
+    { MPU_DEVICE "/scan_elements/in_quaternion_y_en",   "0" },
+    { MPU_DEVICE "/scan_elements/in_quaternion_z_en",   "0" },
+    { "trigger0/name",                                  "mpu6050-dev0" },
+
+    { LIGHT_DEVICE "/name",                             "MAX44007" },
+    { LIGHT_DEVICE "/events/in_illuminance0_thresh_either_en", "0" },
+    { LIGHT_DEVICE "/in_illuminance0_input",            "0" },
+    { LIGHT_DEVICE "/sampling_frequency",               "0" },
+    { LIGHT_DEVICE "/buffer/enable",                    "0" },
+    { LIGHT_DEVICE "/trigger/current_trigger",          "" },
+    { LIGHT_DEVICE "/scan_elements/in_illuminance0_en", "0" },
+    { LIGHT_DEVICE "/scan_elements/in_illuminance0_index", "0" },
+    { LIGHT_DEVICE "/scan_elements/in_illuminance0_type", "le:u16/16>>0" },
+    { LIGHT_DEVICE "/scan_elements/in_timestamp_en",    "0" },
+    { LIGHT_DEVICE "/scan_elements/in_timestamp_index", "1" },
+    { LIGHT_DEVICE "/scan_elements/in_timestamp_type",  "le:s64/64>>0" },
+};
+
+struct benchMix {
+    const char *name;
+    int handles[BENCH_MAX_HANDLES];     // -1 terminated
+};
+
+static const benchMix sMixes[] = {
+    { "accel",      { ID_A, -1 } },
+    { "gyro",       { ID_GY, -1 } },
+    { "accel_gyro", { ID_A, ID_GY, -1 } },
+    { "magnetic",   { ID_M, -1 } },
+    { "rotation",   { ID_RV, -1 } },
+    { "fusion",     { ID_RV, ID_LA, ID_GR, ID_O, -1 } },
+    { "light",      { ID_L, -1 } },
+    { "all",        { ID_GY, ID_A, ID_M, ID_O, ID_RV, ID_LA, ID_GR, ID_L, -1 } },
+};
+
+/* the attributes the backend follows to know what to scan */
+enum {
+    MPU_BUFFER_ENABLE = 0,
+    MPU_QUATERNION_ON,
+    MPU_GYRO_ENABLE,
+    MPU_ACCEL_ENABLE,
+    MPU_COMPASS_ENABLE,
+    LIGHT_BUFFER_ENABLE,
+    NUM_FLAGS
+};
+
+static const char *sFlagPaths[NUM_FLAGS] = {
+    MPU_DEVICE "/buffer/enable",
+    MPU_DEVICE "/quaternion_on",
+    MPU_DEVICE "/gyro_enable",
+    MPU_DEVICE "/accl_enable",
+    MPU_DEVICE "/compass_enable",
+    LIGHT_DEVICE "/buffer/enable",
+};
+
+/* a FIFO standing in for /dev/iio:deviceN */
+struct benchDevice {
+    const char *name;
+    int fd;             // read/write end kept by the backend
+    int enableFlag;
+    bool enabled;
+    int64_t period;
+    int64_t next;
+    uint32_t seq;
+};
+
+enum {
+    SC_READ = 0,
+    SC_WRITE,
+    SC_OPEN,
+    SC_CLOSE,
+    SC_IOCTL,
+    SC_WAIT,
+    SC_SEEK,
+    NUM_SC
+};
+
+/*****************************************************************************/
+
+static sensors_poll_device_t *sDevice;
+static volatile int sStop;
+static int sBatch = 1;
+static int sFlagFds[NUM_FLAGS];
+static benchDevice sMpu = { MPU_DEVICE, -1, MPU_BUFFER_ENABLE, false, 0, 0, 0 };
+static benchDevice sLight = { LIGHT_DEVICE, -1, LIGHT_BUFFER_ENABLE, false, 0, 0, 0 };
+
+static pthread_t sBackendThread;
+static volatile int sBackendStarted;
+static volatile uint32_t sSyscalls[NUM_SC];
+
+/* measurement window, shared by the poll and backend threads */
+static pthread_mutex_t sWindowLock = PTHREAD_MUTEX_INITIALIZER;
+static bool sMeasuring;
+static uint32_t sSamples;
+static uint32_t sDropped;
+static uint32_t sEvents;
+static uint32_t sNumLatencies;
+static int64_t sLatencies[BENCH_MAX_LATENCIES];
+
+static int64_t benchNow(int clock)
+{
+    struct timespec t;
+
+    clock_gettime(clock, &t);
+    return int64_t(t.tv_sec) * 1000000000LL + t.tv_nsec;
+}
+
+static void benchSleep(int64_t ns)
+{
+    struct timespec t;
+
+    if (ns <= 0)
+        return;
+    t.tv_sec = ns / 1000000000LL;
+    t.tv_nsec = ns % 1000000000LL;
+    while (nanosleep(&t, &t) < 0 && errno == EINTR)
+        ;
+}
+
+/*****************************************************************************/
+
+/*
+ * System call counting. Android.mk links with -Wl,--wrap for each of these,
+ * so every call from the HAL objects built into the bench lands here first.
+ * The backend stands in for the kernel and is left out.
+ */
+
+static void countSyscall(int which)
+{
+    if (sBackendStarted && pthread_equal(pthread_self(), sBackendThread))
+        return;
+    __sync_fetch_and_add(&sSyscalls[which], 1);
+}
+
+extern "C" {
+
+ssize_t __real_read(int fd, void *buf, size_t count);
+ssize_t __real_write(int fd, const void *buf, size_t count);
+ssize_t __real_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t __real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+int __real_open(const char *path, int flags, ...);
+int __real_close(int fd);
+int __real_ioctl(int fd, int request, ...);
+int __real_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+int __real_epoll_wait(int epfd, struct epoll_event *events, int max,
+                      int timeout);
+off_t __real_lseek(int fd, off_t offset, int whence);
+FILE *__real_fopen(const char *path, const char *mode);
+int __real_fclose(FILE *fp);
+
+ssize_t __wrap_read(int fd, void *buf, size_t count)
+{
+    countSyscall(SC_READ);
+    return __real_read(fd, buf, count);
+}
+
+ssize_t __wrap_write(int fd, const void *buf, size_t count)
+{
+    countSyscall(SC_WRITE);
+    return __real_write(fd, buf, count);
+}
+
+ssize_t __wrap_pread(int fd, void *buf, size_t count, off_t offset)
+{
+    countSyscall(SC_READ);
+    return __real_pread(fd, buf, count, offset);
+}
+
+ssize_t __wrap_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+    countSyscall(SC_WRITE);
+    return __real_pwrite(fd, buf, count, offset);
+}
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode;
+
+    va_start(ap, flags);
+    mode = (flags & O_CREAT) ? va_arg(ap, int) : 0;
+    va_end(ap);
+    countSyscall(SC_OPEN);
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_close(int fd)
+{
+    countSyscall(SC_CLOSE);
+    return __real_close(fd);
+}
+
+int __wrap_ioctl(int fd, int request, ...)
+{
+    va_list ap;
+    void *arg;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+    countSyscall(SC_IOCTL);
+    return __real_ioctl(fd, request, arg);
+}
+
+int __wrap_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    countSyscall(SC_WAIT);
+    return __real_poll(fds, nfds, timeout);
+}
+
+int __wrap_epoll_wait(int epfd, struct epoll_event *events, int max,
+                      int timeout)
+{
+    countSyscall(SC_WAIT);
+    return __real_epoll_wait(epfd, events, max, timeout);
+}
+
+off_t __wrap_lseek(int fd, off_t offset, int whence)
+{
+    countSyscall(SC_SEEK);
+    return __real_lseek(fd, offset, whence);
+}
+
+FILE *__wrap_fopen(const char *path, const char *mode)
+{
+    countSyscall(SC_OPEN);
+    return __real_fopen(path, mode);
+}
+
+int __wrap_fclose(FILE *fp)
+{
+    countSyscall(SC_CLOSE);
+    return __real_fclose(fp);
+}
+
+}  // extern "C"
+
+/*****************************************************************************/
+
+/* mkdir -p for the directories leading to path */
+static int makeParents(const char *path)
+{
+    char dir[PATH_MAX];
+    char *p;
+
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (p = dir + 1; (p = strchr(p, '/')) != NULL; p++) {
+        *p = '\0';
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+            fprintf(stderr, "mkdir %s: %s\n", dir, strerror(errno));
+            return -1;
+        }
+        *p = '/';
+    }
+    return 0;
+}
+
+static int writeFile(const char *path, const char *value)
+{
+    FILE *fp;
+
+    if (makeParents(path) < 0)
+        return -1;
+    fp = fopen(path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fputs(value, fp);
+    fputc('\n', fp);
+    return fclose(fp);
+}
+
+static int openNode(benchDevice *dev)
+{
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/%s", IIO_DEV_DIR, dev->name);
+    if (makeParents(path) < 0 || mkfifo(path, 0644) < 0) {
+        fprintf(stderr, "mkfifo %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    /* held open for writing, so the HAL's O_RDONLY open doesn't block */
+    dev->fd = open(path, O_RDWR | O_NONBLOCK);
+    if (dev->fd < 0) {
+        fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* Lays the fake devices out under SENSORS_BENCH_ROOT, wiping any old run */
+static int createTree(void)
+{
+    char path[PATH_MAX];
+    size_t i;
+
+    if (system("rm -rf " SENSORS_BENCH_ROOT) != 0) {
+        fprintf(stderr, "couldn't clear %s\n", SENSORS_BENCH_ROOT);
+        return -1;
+    }
+    for (i = 0; i < ARRAY_SIZE(sAttrs); i++) {
+        snprintf(path, sizeof(path), "%s/%s", IIO_SYSFS_DIR, sAttrs[i].path);
+        if (writeFile(path, sAttrs[i].value) < 0)
+            return -1;
+    }
+    /* no input devices, the MPU is found by its IIO name */
+    if (writeFile(PROC_INPUT_DEVICES, "") < 0)
+        return -1;
+    if (openNode(&sMpu) < 0 || openNode(&sLight) < 0)
+        return -1;
+
+    for (i = 0; i < NUM_FLAGS; i++) {
+        snprintf(path, sizeof(path), "%s/%s", IIO_SYSFS_DIR, sFlagPaths[i]);
+        sFlagFds[i] = open(path, O_RDONLY);
+        if (sFlagFds[i] < 0) {
+            fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static bool readFlag(int which)
+{
+    char c = '0';
+
+    return pread(sFlagFds[which], &c, 1, 0) == 1 && c == '1';
+}
+
+/*****************************************************************************/
+
+static void countWritten(int scans, bool dropped)
+{
+    pthread_mutex_lock(&sWindowLock);
+    if (sMeasuring) {
+        if (dropped)
+            sDropped += scans;
+        else
+            sSamples += scans;
+    }
+    pthread_mutex_unlock(&sWindowLock);
+}
+
+/* the driver clears its ring when the buffer is enabled */
+static bool followEnable(benchDevice *dev)
+{
+    bool en = readFlag(dev->enableFlag);
+
+    if (en && !dev->enabled) {
+        char buf[512];
+        while (read(dev->fd, buf, sizeof(buf)) > 0)
+            ;
+    }
+    dev->enabled = en;
+    return en;
+}
+
+static void writeBatch(benchDevice *dev, const char *buf, int scans,
+                       int nbyte)
+{
+    ssize_t n = write(dev->fd, buf, scans * nbyte);
+
+    countWritten(scans, n != scans * nbyte);
+}
+
+/*
+ * MPU scans as MPLSensor parses them: an optional quaternion (4 longs),
+ * then gyro, accel and compass as 3 shorts padded to 8 bytes each, then
+ * the 64 bit timestamp. Only what the HAL turned on is present.
+ */
+static void emitMpu(int64_t now)
+{
+    char buf[BENCH_MAX_BATCH * BENCH_MAX_SCAN_BYTES];
+    bool quat, gyro, accel, compass;
+    int sensors, nbyte, i;
+
+    if (!followEnable(&sMpu))
+        return;
+    quat = readFlag(MPU_QUATERNION_ON);
+    gyro = readFlag(MPU_GYRO_ENABLE);
+    accel = readFlag(MPU_ACCEL_ENABLE);
+    compass = readFlag(MPU_COMPASS_ENABLE);
+    sensors = gyro + accel + compass;
+    if (!sensors && !quat)
+        return;
+    nbyte = 8 * sensors + 8 + (quat ? 4 * sizeof(long) : 0);
+
+    memset(buf, 0, sBatch * nbyte);
+    for (i = 0; i < sBatch; i++) {
+        char *p = buf + i * nbyte;
+        short wobble = short(sMpu.seq++ & 0x1f) - 16;
+
+        if (quat) {
+            long q[4] = { 1L << 30, 0, 0, 0 };
+            memcpy(p, q, sizeof(q));
+            p += sizeof(q);
+        }
+        if (gyro) {
+            short g[3] = { wobble, short(-wobble), 3 };
+            memcpy(p, g, sizeof(g));
+            p += 8;
+        }
+        if (accel) {
+            short a[3] = { wobble, 40, 16384 };
+            memcpy(p, a, sizeof(a));
+            p += 8;
+        }
+        if (compass) {
+            short m[3] = { 200, short(-150 + wobble), -400 };
+            memcpy(p, m, sizeof(m));
+            p += 8;
+        }
+        /* a batch reads like a FIFO drained on one interrupt */
+        int64_t ts = now - int64_t(sBatch - 1 - i) * sMpu.period;
+        memcpy(p, &ts, sizeof(ts));
+    }
+    writeBatch(&sMpu, buf, sBatch, nbyte);
+}
+
+/* light scans: le:u16 lux at index 0, le:s64 timestamp at index 1 */
+static void emitLight(int64_t now)
+{
+    char buf[BENCH_MAX_BATCH * 16];
+    int i;
+
+    if (!followEnable(&sLight))
+        return;
+
+    memset(buf, 0, sBatch * 16);
+    for (i = 0; i < sBatch; i++) {
+        /* alternate far enough to clear LightSensor's hysteresis */
+        uint16_t lux = (sLight.seq++ & 1) ? 400 : 100;
+        int64_t ts = now - int64_t(sBatch - 1 - i) * sLight.period;
+        memcpy(buf + i * 16, &lux, sizeof(lux));
+        memcpy(buf + i * 16 + 8, &ts, sizeof(ts));
+    }
+    writeBatch(&sLight, buf, sBatch, 16);
+}
+
+static void *backendThread(void *arg)
+{
+    int64_t now, next;
+
+    sBackendThread = pthread_self();
+    sBackendStarted = 1;
+
+    now = benchNow(CLOCK_MONOTONIC);
+    sMpu.next = now + sMpu.period * sBatch;
+    sLight.next = now + sLight.period * sBatch;
+    while (!sStop) {
+        now = benchNow(CLOCK_MONOTONIC);
+        if (now >= sMpu.next) {
+            emitMpu(now);
+            sMpu.next += sMpu.period * sBatch;
+            /* fell behind, a real FIFO wouldn't catch up either */
+            if (sMpu.next < now)
+                sMpu.next = now + sMpu.period * sBatch;
+        }
+        if (now >= sLight.next) {
+            emitLight(now);
+            sLight.next += sLight.period * sBatch;
+            if (sLight.next < now)
+                sLight.next = now + sLight.period * sBatch;
+        }
+        next = sMpu.next < sLight.next ? sMpu.next : sLight.next;
+        benchSleep(next - benchNow(CLOCK_MONOTONIC));
+    }
+    return NULL;
+}
+
+/* the framework's SensorService loop, with latency bookkeeping */
+static void *pollThread(void *arg)
+{
+    sensors_event_t data[BENCH_POLL_EVENTS];
+
+    while (!sStop) {
+        int n = sDevice->poll(sDevice, data, BENCH_POLL_EVENTS);
+        if (n <= 0)
+            continue;
+        int64_t now = benchNow(CLOCK_MONOTONIC);
+        pthread_mutex_lock(&sWindowLock);
+        if (sMeasuring) {
+            for (int i = 0; i < n; i++) {
+                if (sNumLatencies < BENCH_MAX_LATENCIES)
+                    sLatencies[sNumLatencies++] = now - data[i].timestamp;
+            }
+            sEvents += n;
+        }
+        pthread_mutex_unlock(&sWindowLock);
+    }
+    return NULL;
+}
+
+/*****************************************************************************/
+
+static int compareLatency(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static double percentileUs(double p)
+{
+    uint32_t i = uint32_t(p * (sNumLatencies - 1));
+
+    return sLatencies[i] / 1000.0;
+}
+
+static int activateMix(const benchMix *mix, int en)
+{
+    int err = 0;
+
+    for (int i = 0; mix->handles[i] >= 0; i++) {
+        int handle = mix->handles[i];
+        int64_t period = (handle == ID_L) ? sLight.period : sMpu.period;
+
+        if (en && sDevice->setDelay(sDevice, handle, period) < 0)
+            err = -1;
+        if (sDevice->activate(sDevice, handle, en) < 0)
+            err = -1;
+    }
+    return err;
+}
+
+static void runMix(const benchMix *mix, int64_t warmup, int64_t duration)
+{
+    uint32_t sc0[NUM_SC], sc1[NUM_SC], total = 0, reads, waits;
+    int64_t cpu0, cpu1, backend0, backend1, hal;
+    clockid_t backendClock;
+    int err, i;
+
+    fprintf(stderr, "%s\n", mix->name);
+    err = activateMix(mix, 1);
+    benchSleep(warmup);
+
+    pthread_getcpuclockid(sBackendThread, &backendClock);
+    pthread_mutex_lock(&sWindowLock);
+    sSamples = sDropped = sEvents = sNumLatencies = 0;
+    sMeasuring = true;
+    memcpy(sc0, (const void *) sSyscalls, sizeof(sc0));
+    cpu0 = benchNow(CLOCK_PROCESS_CPUTIME_ID);
+    backend0 = benchNow(backendClock);
+    pthread_mutex_unlock(&sWindowLock);
+
+    benchSleep(duration);
+
+    pthread_mutex_lock(&sWindowLock);
+    sMeasuring = false;
+    memcpy(sc1, (const void *) sSyscalls, sizeof(sc1));
+    cpu1 = benchNow(CLOCK_PROCESS_CPUTIME_ID);
+    backend1 = benchNow(backendClock);
+    pthread_mutex_unlock(&sWindowLock);
+
+    activateMix(mix, 0);
+
+    for (i = 0; i < NUM_SC; i++)
+        total += sc1[i] - sc0[i];
+    reads = sc1[SC_READ] - sc0[SC_READ];
+    waits = sc1[SC_WAIT] - sc0[SC_WAIT];
+    hal = (cpu1 - cpu0) - (backend1 - backend0);
+
+    if (!sSamples) {
+        printf("{\"mix\":\"%s\",\"samples\":0,\"events\":%u,\"status\":%d}\n",
+               mix->name, sEvents, err);
+        return;
+    }
+    printf("{\"mix\":\"%s\",\"mpu_hz\":%lld,\"light_hz\":%lld,\"batch\":%d,"
+           "\"seconds\":%.1f,\"samples\":%u,\"dropped\":%u,\"events\":%u,"
+           "\"cpu_us_per_sample\":%.2f,\"syscalls_per_sample\":%.2f,"
+           "\"reads_per_sample\":%.2f,\"waits_per_sample\":%.2f",
+           mix->name, 1000000000LL / sMpu.period,
+           1000000000LL / sLight.period, sBatch, duration / 1e9,
+           sSamples, sDropped, sEvents, hal / 1000.0 / sSamples,
+           double(total) / sSamples, double(reads) / sSamples,
+           double(waits) / sSamples);
+    if (sNumLatencies) {
+        double sum = 0;
+        qsort(sLatencies, sNumLatencies, sizeof(sLatencies[0]),
+              compareLatency);
+        for (uint32_t j = 0; j < sNumLatencies; j++)
+            sum += sLatencies[j];
+        printf(",\"lat_min_us\":%.1f,\"lat_avg_us\":%.1f,\"lat_p50_us\":%.1f,"
+               "\"lat_p90_us\":%.1f,\"lat_p99_us\":%.1f,\"lat_max_us\":%.1f",
+               percentileUs(0), sum / sNumLatencies / 1000.0,
+               percentileUs(0.5), percentileUs(0.9), percentileUs(0.99),
+               percentileUs(1));
+    }
+    printf(",\"status\":%d}\n", err);
+    fflush(stdout);
+}
+
+static const benchMix *findMix(const char *name, size_t len)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(sMixes); i++) {
+        if (strlen(sMixes[i].name) == len && !strncmp(sMixes[i].name, name, len))
+            return &sMixes[i];
+    }
+    return NULL;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-r mpu Hz] [-l light Hz] [-b scans per write] "
+            "[-d seconds] [-w warmup seconds] [-m mix[,mix...]]\nmixes:",
+            prog);
+    for (size_t i = 0; i < ARRAY_SIZE(sMixes); i++)
+        fprintf(stderr, " %s", sMixes[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+    const benchMix *run[ARRAY_SIZE(sMixes)];
+    const char *mixes = NULL;
+    int mpuRate = BENCH_DEFAULT_MPU_RATE, lightRate = BENCH_DEFAULT_LIGHT_RATE;
+    double seconds = BENCH_DEFAULT_SECONDS, warmup = BENCH_DEFAULT_WARMUP;
+    hw_device_t *device;
+    pthread_t poller, backend;
+    size_t numRun = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:l:b:d:w:m:")) != -1) {
+        switch (opt) {
+        case 'r': mpuRate = atoi(optarg); break;
+        case 'l': lightRate = atoi(optarg); break;
+        case 'b': sBatch = atoi(optarg); break;
+        case 'd': seconds = atof(optarg); break;
+        case 'w': warmup = atof(optarg); break;
+        case 'm': mixes = optarg; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (mpuRate <= 0 || lightRate <= 0 || seconds <= 0 || warmup < 0 ||
+            sBatch < 1 || sBatch > BENCH_MAX_BATCH) {
+        fprintf(stderr, "rates and duration must be positive, "
+                "batch between 1 and %d\n", BENCH_MAX_BATCH);
+        return 1;
+    }
+    sMpu.period = 1000000000LL / mpuRate;
+    sLight.period = 1000000000LL / lightRate;
+
+    if (mixes == NULL) {
+        for (numRun = 0; numRun < ARRAY_SIZE(sMixes); numRun++)
+            run[numRun] = &sMixes[numRun];
+    } else {
+        const char *p = mixes;
+        while (*p && numRun < ARRAY_SIZE(run)) {
+            size_t len = strcspn(p, ",");
+            if ((run[numRun++] = findMix(p, len)) == NULL) {
+                fprintf(stderr, "unknown mix %.*s\n", int(len), p);
+                usage(argv[0]);
+                return 1;
+            }
+            p += len;
+            if (*p == ',')
+                p++;
+        }
+    }
+
+    if (createTree() < 0)
+        return 1;
+
+    fprintf(stderr, "Opening the HAL over %s\n", SENSORS_BENCH_ROOT);
+    if (HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+            SENSORS_HARDWARE_POLL, &device) != 0) {
+        fprintf(stderr, "couldn't open the sensors HAL\n");
+        return 1;
+    }
+    sDevice = (sensors_poll_device_t *) device;
+
+    pthread_create(&backend, NULL, backendThread, NULL);
+    pthread_create(&poller, NULL, pollThread, NULL);
+    while (!sBackendStarted)
+        benchSleep(1000000);
+
+    for (size_t i = 0; i < numRun; i++)
+        runMix(run[i], int64_t(warmup * 1e9), int64_t(seconds * 1e9));
+
+    /* an activate that changes nothing still wakes poll() up */
+    sStop = 1;
+    sDevice->activate(sDevice, ID_L, 0);
+    pthread_join(poller, NULL);
+    pthread_join(backend, NULL);
+    sDevice->common.close(&sDevice->common);
+    return 0;
+}
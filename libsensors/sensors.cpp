@@ -24,16 +24,21 @@
 #include <dirent.h>
 #include <math.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 
 #include <utils/Atomic.h>
 #include <utils/Log.h>
+#include <cutils/properties.h>
+#include <hardware_legacy/power.h>
 
 #include "sensors.h"
 
 #include "MPLSensor.h"
 #include "LightSensor.h"
+#include "SensorStats.h"
 
 
 /*****************************************************************************/
@@ -55,11 +60,27 @@
 #define AKM_DEBUG 0
 #define AKM_DATA 0
 
+// held from the wakeup by a wake-up sensor until the framework comes back
+// for more events, i.e. until its events have been delivered
+#define WAKE_LOCK_ID "SensorsWakeup"
+
+// With ro.sensors.reader_prio set to a SCHED_FIFO priority (1-99), the
+// drivers are read and fused on a HAL thread at that priority instead of
+// the framework's poll thread, and pollEvents only dequeues the results.
+// ro.sensors.reader_cpus is an optional hex mask of CPUs to pin it to.
+#define READER_PRIO_PROPERTY "ro.sensors.reader_prio"
+#define READER_CPUS_PROPERTY "ro.sensors.reader_cpus"
+#define READER_BATCH 64
+#define EVENT_QUEUE_SIZE 256
+// held while the queue has wake-up events the framework hasn't taken yet
+#define QUEUE_WAKE_LOCK_ID "SensorsQueue"
+
 /*****************************************************************************/
 
 /* The SENSORS Module */
 #define LOCAL_SENSORS 1
-static struct sensor_t sSensorList[LOCAL_SENSORS + MPLSensor::numSensors] = {
+static struct sensor_t sSensorList[LOCAL_SENSORS + MPLSensor::numSensors +
+                                    MPLSensor::numEventSensors] = {
       { "MAX44007 Light sensor",
           "Maxim",
           1, SENSORS_LIGHT_HANDLE,
@@ -122,6 +143,12 @@ private:
         compass,
 #ifdef ENABLE_DMP_DISPL_ORIENT_FEAT
         dmpOrient,
+#endif
+#ifdef ENABLE_DMP_PEDOMETER_FEAT
+        dmpPedometer,
+#endif
+#ifdef ENABLE_SIGNIFICANT_MOTION_FEAT
+        sigMotion,
 #endif
         light,
         numSensorDrivers,       // wake pipe goes here
@@ -130,9 +157,66 @@ private:
 
     static const size_t wake = numFds - 1;
     static const char WAKE_MESSAGE = 'W';
-    struct pollfd mPollFds[numFds];
+
+    // How a driver is read once epoll reported its fd
+    enum drainMode {
+        DRAIN_ONCE,     // one read per wakeup, the fd stays level triggered
+        DRAIN_PARTIAL,  // level triggered, ready until a read comes up short
+        DRAIN_EMPTY,    // edge triggered, ready until a read returns nothing
+    };
+
+    struct pollSource {
+        int fd;
+        uint32_t events;
+        drainMode drain;
+        // the driver can have data without its fd being readable
+        bool checkPending;
+        // its events must reach the framework even while suspended, the
+        // others stay in their FIFO until something else wakes the AP
+        bool wakeUp;
+        int (sensors_poll_context_t::*read)(int index, sensors_event_t* data,
+                                            int count);
+    };
+
+    int mEpollFd;
+    int mWakeReadFd;
     int mWritePipeFd;
+    uint32_t mReady;    // bit per driver whose fd was reported readable
+    uint32_t mWakeUp;   // bit per driver flagged as a wake-up source
+    bool mWakeLockHeld;
+    pollSource mSources[numSensorDrivers];
     SensorBase* mSensors[numSensorDrivers];
+    SensorStats mStats;
+
+    void addSource(int index, int fd, uint32_t events, drainMode drain,
+                   bool checkPending, bool wakeUp,
+                   int (sensors_poll_context_t::*read)(int, sensors_event_t*, int));
+    void updateWakeLock();
+    int readEvents(sensors_event_t* data, int count);
+
+    // optional reader thread, see READER_PRIO_PROPERTY
+    bool mReaderRunning;
+    bool mReaderStop;
+    int mReaderError;
+    pthread_t mReaderThread;
+    pthread_mutex_t mQueueLock;
+    pthread_cond_t mQueueData;
+    pthread_cond_t mQueueSpace;
+    sensors_event_t mQueue[EVENT_QUEUE_SIZE];
+    int mQueueHead;
+    int mQueueCount;
+    bool mQueueWakeLock;
+
+    void startReader();
+    void stopReader();
+    static void *readerThread(void *arg);
+    void readerLoop();
+    void queueEvents(const sensors_event_t* data, int count);
+    int dequeueEvents(sensors_event_t* data, int count);
+    int readMpl(int index, sensors_event_t* data, int count);
+    int readCompass(int index, sensors_event_t* data, int count);
+    int readDmp(int index, sensors_event_t* data, int count);
+    int readDriver(int index, sensors_event_t* data, int count);
 
     int handleToDriver(int handle) const {
         switch (handle) {
@@ -144,10 +228,25 @@ private:
             case ID_A:
             case ID_M:
             case ID_O:
+#ifdef ENABLE_GAME_RV_FEAT
+            case ID_GRV:
+#endif
+#ifdef ENABLE_SHAKE_FEAT
+            case ID_SK:
+#endif
                 return mpl;
 #ifdef ENABLE_DMP_DISPL_ORIENT_FEAT
             case ID_SO:
                 return dmpOrient;
+#endif
+#ifdef ENABLE_DMP_PEDOMETER_FEAT
+            case ID_SD:
+            case ID_SC:
+                return dmpPedometer;
+#endif
+#ifdef ENABLE_SIGNIFICANT_MOTION_FEAT
+            case ID_SM:
+                return sigMotion;
 #endif
             case ID_L:
                 return light;
@@ -164,8 +263,24 @@ sensors_poll_context_t::sensors_poll_context_t()
     CompassSensor *p_compasssensor = new CompassSensor();
     MPLSensor *p_mplsen = new MPLSensor(p_compasssensor);
     mInitialized = false;
+    mReady = 0;
+    mWakeUp = 0;
+    mWakeLockHeld = false;
+    mReaderRunning = false;
+    mReaderStop = false;
+    mReaderError = 0;
+    mQueueHead = 0;
+    mQueueCount = 0;
+    mQueueWakeLock = false;
+    pthread_mutex_init(&mQueueLock, NULL);
+    pthread_cond_init(&mQueueData, NULL);
+    pthread_cond_init(&mQueueSpace, NULL);
     // Must clean this up early or else the destructor will make a mess.
     memset(mSensors, 0, sizeof(mSensors));
+    memset(mSources, 0, sizeof(mSources));
+
+    mEpollFd = epoll_create(numFds);
+    ALOGE_IF(mEpollFd<0, "error creating epoll fd (%s)", strerror(errno));
 
     setCallbackObject(p_mplsen); //setup the callback object for handing mpl callbacks
     numSensors =
@@ -174,49 +289,165 @@ sensors_poll_context_t::sensors_poll_context_t()
                                      sizeof(sSensorList[0]) * (ARRAY_SIZE(sSensorList) - LOCAL_SENSORS));
 
     mSensors[mpl] = p_mplsen;
-    mPollFds[mpl].fd = mSensors[mpl]->getFd();
-    mPollFds[mpl].events = POLLIN;
-    mPollFds[mpl].revents = 0;
+    addSource(mpl, mSensors[mpl]->getFd(), EPOLLIN, DRAIN_ONCE, true,
+              false, &sensors_poll_context_t::readMpl);
 
     mSensors[compass] = p_mplsen;
-    mPollFds[compass].fd =  ((MPLSensor*)mSensors[mpl])->getCompassFd();
-    mPollFds[compass].events = POLLIN;
-    mPollFds[compass].revents = 0;
+    addSource(compass, ((MPLSensor*)mSensors[mpl])->getCompassFd(), EPOLLIN,
+              DRAIN_PARTIAL, false, false,
+              &sensors_poll_context_t::readCompass);
 
+    // the DMP event nodes keep their own epoll entries, for the wake-up
+    // flags, but whichever comes first in a pass reads all that are ready
 #ifdef ENABLE_DMP_DISPL_ORIENT_FEAT
-    mPollFds[dmpOrient].fd = ((MPLSensor*)mSensors[mpl])->getDmpOrientFd();
-    mPollFds[dmpOrient].events = POLLPRI;
-    mPollFds[dmpOrient].revents = 0;
+    mSensors[dmpOrient] = p_mplsen;
+    addSource(dmpOrient, p_mplsen->getDmpOrientFd(), EPOLLPRI, DRAIN_ONCE,
+              false, true, &sensors_poll_context_t::readDmp);
+#endif
+#ifdef ENABLE_DMP_PEDOMETER_FEAT
+    // steps wake us through their own sysfs event node, not the IIO ring
+    mSensors[dmpPedometer] = p_mplsen;
+    addSource(dmpPedometer, p_mplsen->getDmpPedometerFd(), EPOLLPRI,
+              DRAIN_ONCE, false, false, &sensors_poll_context_t::readDmp);
 #endif
+#ifdef ENABLE_SIGNIFICANT_MOTION_FEAT
+    mSensors[sigMotion] = p_mplsen;
+    addSource(sigMotion, p_mplsen->getSigMotionFd(), EPOLLPRI, DRAIN_ONCE,
+              false, true, &sensors_poll_context_t::readDmp);
+#endif
+    // IIO event fds are non blocking and drained by readEvents
     mSensors[light] = new LightSensor();
-    mPollFds[light].fd = mSensors[light]->getFd();
-    mPollFds[light].events = POLLIN;
-    mPollFds[light].revents = 0;
+    addSource(light, mSensors[light]->getFd(), EPOLLIN | EPOLLET, DRAIN_EMPTY,
+              false, false, &sensors_poll_context_t::readDriver);
 
     int wakeFds[2];
     int result = pipe(wakeFds);
     ALOGE_IF(result<0, "error creating wake pipe (%s)", strerror(errno));
     fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
     fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+    mWakeReadFd = wakeFds[0];
     mWritePipeFd = wakeFds[1];
 
-    mPollFds[wake].fd = wakeFds[0];
-    mPollFds[wake].events = POLLIN;
-    mPollFds[wake].revents = 0;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = wake;
+    result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeReadFd, &ev);
+    ALOGE_IF(result<0, "error adding wake pipe to epoll (%s)", strerror(errno));
     mInitialized = true;
+    startReader();
 }
 
 sensors_poll_context_t::~sensors_poll_context_t()
 {
     FUNC_LOG;
+    stopReader();
     for (int i=0 ; i<numSensorDrivers ; i++) {
+        // compass and the event sensors share the MPL driver
+        if (mSensors[i] == mSensors[mpl] && i != mpl)
+            continue;
         delete mSensors[i];
     }
-    close(mPollFds[wake].fd);
+    if (mWakeLockHeld)
+        release_wake_lock(WAKE_LOCK_ID);
+    if (mQueueWakeLock)
+        release_wake_lock(QUEUE_WAKE_LOCK_ID);
+    pthread_mutex_destroy(&mQueueLock);
+    pthread_cond_destroy(&mQueueData);
+    pthread_cond_destroy(&mQueueSpace);
+    close(mEpollFd);
+    close(mWakeReadFd);
     close(mWritePipeFd);
     mInitialized = false;
 }
 
+void sensors_poll_context_t::addSource(int index, int fd, uint32_t events,
+        drainMode drain, bool checkPending, bool wakeUp,
+        int (sensors_poll_context_t::*read)(int, sensors_event_t*, int))
+{
+    mSources[index].fd = fd;
+    mSources[index].events = events;
+    mSources[index].drain = drain;
+    mSources[index].checkPending = checkPending;
+    mSources[index].wakeUp = wakeUp;
+    mSources[index].read = read;
+
+    // poll() used to skip missing devices the same way
+    if (fd < 0)
+        return;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+#ifdef EPOLLWAKEUP
+    // keeps the kernel awake until we got to take our own wakelock
+    if (wakeUp)
+        ev.events |= EPOLLWAKEUP;
+#endif
+    ev.data.u32 = index;
+    int result = epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev);
+    ALOGE_IF(result<0, "error adding driver %d to epoll (%s)", index,
+             strerror(errno));
+    if (!result && wakeUp)
+        mWakeUp |= 1U << index;
+}
+
+void sensors_poll_context_t::updateWakeLock()
+{
+    // only wake-up drivers hold the AP up, the FIFO ones wait for them
+    bool wanted = (mReady & mWakeUp) != 0;
+    if (wanted == mWakeLockHeld)
+        return;
+    if (wanted)
+        acquire_wake_lock(PARTIAL_WAKE_LOCK, WAKE_LOCK_ID);
+    else
+        release_wake_lock(WAKE_LOCK_ID);
+    mWakeLockHeld = wanted;
+}
+
+int sensors_poll_context_t::readMpl(int index, sensors_event_t* data, int count)
+{
+    // drains the IIO ring, every scan goes through the MPL in order
+    return ((MPLSensor*) mSensors[index])->readBatchedEvents(data, count);
+}
+
+int sensors_poll_context_t::readCompass(int index, sensors_event_t* data, int count)
+{
+    // while the MPU scans run the sample is merged into the next scan's
+    // fusion pass instead of running one of its own
+    if (((MPLSensor*) mSensors[index])->readCompassEvents(NULL, count) <= 0)
+        return 0;
+    return ((MPLSensor*) mSensors[mpl])->executeOnData(data, count);
+}
+
+int sensors_poll_context_t::readDmp(int index, sensors_event_t* data, int count)
+{
+    // one read of every DMP node this wakeup reported, the others find
+    // their ready bit gone when the pass gets to them
+    int nodes = 0;
+#ifdef ENABLE_DMP_DISPL_ORIENT_FEAT
+    if (mReady & (1U << dmpOrient))
+        nodes |= MPLSensor::DMP_EVENT_ORIENT;
+    mReady &= ~(1U << dmpOrient);
+#endif
+#ifdef ENABLE_DMP_PEDOMETER_FEAT
+    if (mReady & (1U << dmpPedometer))
+        nodes |= MPLSensor::DMP_EVENT_PEDOMETER;
+    mReady &= ~(1U << dmpPedometer);
+#endif
+#ifdef ENABLE_SIGNIFICANT_MOTION_FEAT
+    if (mReady & (1U << sigMotion))
+        nodes |= MPLSensor::DMP_EVENT_MOTION;
+    mReady &= ~(1U << sigMotion);
+#endif
+    return ((MPLSensor*) mSensors[mpl])->readDmpEvents(nodes, data, count);
+}
+
+int sensors_poll_context_t::readDriver(int index, sensors_event_t* data, int count)
+{
+    return mSensors[index]->readEvents(data, count);
+}
+
 int sensors_poll_context_t::activate(int handle, int enabled)
 {
     FUNC_LOG;
@@ -243,63 +474,89 @@ int sensors_poll_context_t::setDelay(int handle, int64_t ns)
 int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
 {
     //FUNC_LOG;
+    int nbEvents;
+
+    if (mReaderRunning) {
+        nbEvents = dequeueEvents(data, count);
+    } else {
+        // being called again means the wake-up events we returned last
+        // time have been delivered
+        updateWakeLock();
+        nbEvents = readEvents(data, count);
+    }
+    if (nbEvents < 0)
+        return nbEvents;
+
+    if (mStats.enabled())
+        mStats.countPoll(data, nbEvents);
+    mStats.update((MPLSensor*) mSensors[mpl]);
+
+    return nbEvents;
+}
+
+/* one pass over the drivers, on the poll thread or the reader thread */
+int sensors_poll_context_t::readEvents(sensors_event_t* data, int count)
+{
+    struct epoll_event events[numFds];
     int nbEvents = 0;
     int n = 0;
     int polltime = -1;
     do {
+        // restart the FIFO once enable/setDelay changes have settled
+        ((MPLSensor*) mSensors[mpl])->commitReconfig(false);
+        polltime = ((MPLSensor*) mSensors[mpl])->getPollTime();
         for (int i=0 ; count && i<numSensorDrivers ; i++) {
-            SensorBase* const sensor(mSensors[i]);
-            // See if we have some pending events from the last poll()
-            if ((mPollFds[i].revents & (POLLIN | POLLPRI)) || (sensor->hasPendingEvents())) {
-                int nb;
-                if (i == compass) {
-                    /* result is hardcoded to 0 */
-                    ((MPLSensor*) sensor)->readCompassEvents(NULL, count);
-                    nb = ((MPLSensor*) mSensors[mpl])->executeOnData(data, count);
-                }
-                else if (i == mpl) {
-                    /* result is hardcoded to 0 */
-                    sensor->readEvents(NULL, count);
-                    nb = ((MPLSensor*) mSensors[mpl])->executeOnData(data, count);
-                    mPollFds[i].revents = 0;
-                }
-#ifdef ENABLE_DMP_DISPL_ORIENT_FEAT
-                else if (i == dmpOrient) {
-                    nb = ((MPLSensor*) mSensors[mpl])->readDmpOrientEvents(data, count);
-                    mPollFds[dmpOrient].revents= 0;
-                    if (!isDmpScreenAutoRotationEnabled()) {
-                            /* ignore the data */
-                            nb = 0;
-                    }
-                }
-#endif
-                else {
-                    nb = sensor->readEvents(data, count);
-                }
-                if (nb < count) {
-                    // no more data for this sensor
-                    mPollFds[i].revents = 0;
-                }
-                count -= nb;
-                nbEvents += nb;
-                data += nb;
+            const pollSource& source(mSources[i]);
+            const uint32_t bit = 1U << i;
+            // Only drivers epoll woke up, or that hold data of their own
+            if (!(mReady & bit) &&
+                !(source.checkPending && mSensors[i]->hasPendingEvents()))
+                continue;
+            int nb = (this->*source.read)(i, data, count);
+            if (source.drain == DRAIN_ONCE ||
+                (source.drain == DRAIN_PARTIAL && nb < count) ||
+                (source.drain == DRAIN_EMPTY && nb <= 0)) {
+                // no more data for this sensor until epoll reports it again
+                mReady &= ~bit;
             }
+            if (nb < 0)
+                nb = 0;
+            count -= nb;
+            nbEvents += nb;
+            data += nb;
         }
         if (count) {
             do {
-                n = poll(mPollFds, numFds, nbEvents ? 0 : polltime);
+                n = epoll_wait(mEpollFd, events, numFds, nbEvents ? 0 : polltime);
             } while (n < 0 && errno == EINTR);
             if (n < 0) {
-                ALOGE("poll() failed (%s)", strerror(errno));
+                ALOGE("epoll_wait() failed (%s)", strerror(errno));
                 return -errno;
             }
-            if (mPollFds[wake].revents & (POLLIN | POLLPRI)) {
-                char msg;
-                int result = read(mPollFds[wake].fd, &msg, 1);
-                ALOGE_IF(result<0, "error reading from wake pipe (%s)", strerror(errno));
-                ALOGE_IF(msg != WAKE_MESSAGE, "unknown message on wake queue (0x%02x)", int(msg));
-                mPollFds[wake].revents = 0;
+            for (int i=0 ; i<n ; i++) {
+                const uint32_t index = events[i].data.u32;
+                if (index == wake) {
+                    char msg[8];
+                    int result;
+                    // activate() may have sent several, one wakeup is enough
+                    while ((result = read(mWakeReadFd, msg, sizeof(msg))) > 0) {
+                        for (int j=0 ; j<result ; j++)
+                            ALOGE_IF(msg[j] != WAKE_MESSAGE,
+                                     "unknown message on wake queue (0x%02x)",
+                                     int(msg[j]));
+                    }
+                    ALOGE_IF(result<0 && errno != EAGAIN,
+                             "error reading from wake pipe (%s)", strerror(errno));
+                } else {
+                    mReady |= 1U << index;
+                }
             }
+            // hold on until this wakeup's events have been handed over
+            if ((mReady & mWakeUp) && !mWakeLockHeld)
+                updateWakeLock();
+            // stopReader() wants the reader thread back
+            if (mReaderStop)
+                break;
         }
         // if we have events and space, go read them
     } while (n && count);
@@ -307,6 +564,141 @@ int sensors_poll_context_t::pollEvents(sensors_event_t* data, int count)
     return nbEvents;
 }
 
+void sensors_poll_context_t::startReader()
+{
+    char value[PROPERTY_VALUE_MAX];
+    property_get(READER_PRIO_PROPERTY, value, "0");
+    if (atoi(value) <= 0)
+        return;
+
+    if (pthread_create(&mReaderThread, NULL, readerThread, this) != 0) {
+        ALOGE("can't start the sensor reader thread, polling directly");
+        return;
+    }
+    mReaderRunning = true;
+}
+
+void sensors_poll_context_t::stopReader()
+{
+    if (!mReaderRunning)
+        return;
+
+    pthread_mutex_lock(&mQueueLock);
+    mReaderStop = true;
+    pthread_cond_broadcast(&mQueueSpace);
+    pthread_cond_broadcast(&mQueueData);
+    pthread_mutex_unlock(&mQueueLock);
+
+    // break the reader out of epoll_wait
+    const char wakeMessage(WAKE_MESSAGE);
+    write(mWritePipeFd, &wakeMessage, 1);
+    pthread_join(mReaderThread, NULL);
+    mReaderRunning = false;
+}
+
+void *sensors_poll_context_t::readerThread(void *arg)
+{
+    ((sensors_poll_context_t *) arg)->readerLoop();
+    return NULL;
+}
+
+void sensors_poll_context_t::readerLoop()
+{
+    char value[PROPERTY_VALUE_MAX];
+    sensors_event_t buffer[READER_BATCH];
+
+    property_get(READER_PRIO_PROPERTY, value, "0");
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = atoi(value);
+    if (sched_setscheduler(0, SCHED_FIFO, &param) < 0)
+        ALOGE("can't run the sensor reader at SCHED_FIFO %d (%s)",
+              param.sched_priority, strerror(errno));
+
+    property_get(READER_CPUS_PROPERTY, value, "0");
+    unsigned long cpus = strtoul(value, NULL, 16);
+    if (cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned i = 0; i < sizeof(cpus) * 8 && i < CPU_SETSIZE; i++) {
+            if (cpus & (1UL << i))
+                CPU_SET(i, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) < 0)
+            ALOGE("can't pin the sensor reader to cpus 0x%lx (%s)", cpus,
+                  strerror(errno));
+    }
+    ALOGI("sensor reader running at SCHED_FIFO %d, cpus 0x%lx",
+          param.sched_priority, cpus);
+
+    for (;;) {
+        // queued means handed over, the queue holds its own wakelock
+        updateWakeLock();
+        int nb = readEvents(buffer, READER_BATCH);
+
+        pthread_mutex_lock(&mQueueLock);
+        if (mReaderStop) {
+            pthread_mutex_unlock(&mQueueLock);
+            break;
+        }
+        if (nb < 0) {
+            // readEvents already logged it, pollEvents returns it
+            mReaderError = nb;
+            pthread_cond_broadcast(&mQueueData);
+            pthread_mutex_unlock(&mQueueLock);
+            break;
+        }
+        queueEvents(buffer, nb);
+        pthread_mutex_unlock(&mQueueLock);
+    }
+}
+
+/* called with mQueueLock held, waits for room rather than dropping events;
+   the drivers keep buffering in their FIFOs meanwhile */
+void sensors_poll_context_t::queueEvents(const sensors_event_t* data, int count)
+{
+    while (count && !mReaderStop) {
+        while (mQueueCount == EVENT_QUEUE_SIZE && !mReaderStop)
+            pthread_cond_wait(&mQueueSpace, &mQueueLock);
+        while (count && mQueueCount < EVENT_QUEUE_SIZE) {
+            mQueue[(mQueueHead + mQueueCount) % EVENT_QUEUE_SIZE] = *data++;
+            mQueueCount++;
+            count--;
+        }
+        if (mWakeLockHeld && !mQueueWakeLock) {
+            acquire_wake_lock(PARTIAL_WAKE_LOCK, QUEUE_WAKE_LOCK_ID);
+            mQueueWakeLock = true;
+        }
+        pthread_cond_signal(&mQueueData);
+    }
+}
+
+int sensors_poll_context_t::dequeueEvents(sensors_event_t* data, int count)
+{
+    int nb = 0;
+
+    pthread_mutex_lock(&mQueueLock);
+    // the framework is back for more, what it took last time was delivered
+    if (mQueueWakeLock && !mQueueCount) {
+        release_wake_lock(QUEUE_WAKE_LOCK_ID);
+        mQueueWakeLock = false;
+    }
+    while (!mQueueCount && !mReaderError && !mReaderStop)
+        pthread_cond_wait(&mQueueData, &mQueueLock);
+    if (!mQueueCount && mReaderError) {
+        nb = mReaderError;
+    } else {
+        while (nb < count && mQueueCount) {
+            data[nb++] = mQueue[mQueueHead];
+            mQueueHead = (mQueueHead + 1) % EVENT_QUEUE_SIZE;
+            mQueueCount--;
+        }
+        pthread_cond_signal(&mQueueSpace);
+    }
+    pthread_mutex_unlock(&mQueueLock);
+    return nb;
+}
+
 /*****************************************************************************/
 
 static int poll__close(struct hw_device_t *dev)
@@ -49,10 +49,17 @@ else # release builds, default
 LOCAL_CFLAGS += -DINVENSENSE_COMPASS_CAL
 endif
 
+# Debug flavor: LOGV compiled in, enabled through debug.sensors.inv_log.
+# Release builds compile every LOGV out, arguments included.
+ifeq ($(INV_HAL_DEBUG_LOG),1)
+LOCAL_CFLAGS += -DINV_HAL_DEBUG_LOG
+endif
+
 LOCAL_SRC_FILES := SensorBase.cpp
 LOCAL_SRC_FILES += MPLSensor.cpp
 LOCAL_SRC_FILES += MPLSupport.cpp
 LOCAL_SRC_FILES += InputEventReader.cpp
+LOCAL_SRC_FILES += IIOSampleRing.cpp
 LOCAL_SRC_FILES += CompassSensor.IIO.9150.cpp
 
 LOCAL_C_INCLUDES += $(LOCAL_PATH)
@@ -23,7 +23,6 @@
 #include <dirent.h>
 #include <sys/select.h>
 #include <cutils/log.h>
-#include <linux/input.h>
 #include <string.h>
 
 #include "CompassSensor.IIO.9150.h"
@@ -40,7 +39,7 @@
 #   define USE_MPL_COMPASS_HAL          (1)
 #   define COMPASS_NAME                 "INV_YAS530"
 #elif defined COMPASS_AK8975
-#   warning "Invensense compass cal with AK8975 on primary bus"
+#   warning "Invensense compass cal with AK8975 on MPU9150 secondary bus"
 #   define USE_MPL_COMPASS_HAL          (1)
 #   define COMPASS_NAME                 "INV_AK8975"
 #elif defined INVENSENSE_COMPASS_CAL
@@ -57,11 +56,14 @@
 
 /*****************************************************************************/
 
+/* The 9150's AK8975 hangs off the MPU's auxiliary I2C master, so the MPU
+   samples it into the same IIO scans as gyro and accel and MPLSensor picks
+   it up in parseScan() with the scan's timestamp. There is no input device
+   to read and no fd of our own to wake on. */
 CompassSensor::CompassSensor() 
                   : SensorBase(NULL, NULL),
-                    compass_fd(-1),
-                    mCompassTimestamp(0),
-                    mCompassInputReader(8)
+                    mI2CBus(COMPASS_BUS_SECONDARY),
+                    mSensitivity(0)
 {
     VFUNC_LOG;
 
@@ -70,25 +72,22 @@ CompassSensor::CompassSensor()
         return;
     }
 
-    if (!strcmp(COMPASS_NAME, "INV_COMPASS")) {
-        mI2CBus = COMPASS_BUS_SECONDARY;
-    } else {
-        mI2CBus = COMPASS_BUS_PRIMARY;
-    }
-
-    memset(mCachedCompassData, 0, sizeof(mCachedCompassData));
+    readConstants();
+}
 
-    LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:cat %s (%lld)", 
-            compassSysFs.compass_orient, getTimestamp());
-    FILE *fptr;
-    fptr = fopen(compassSysFs.compass_orient, "r");
-    if (fptr != NULL) {
-        int om[9];
-        fscanf(fptr, "%d,%d,%d,%d,%d,%d,%d,%d,%d", 
-               &om[0], &om[1], &om[2], &om[3], &om[4], &om[5],
-               &om[6], &om[7], &om[8]);
-        fclose(fptr);
+/**
+    @brief      Read the mounting matrix and the sensitivity, fixed for the
+                device, so they are not read from sysfs again every time
+                the MPL asks. Call again to refresh them after the compass
+                was reset.
+ */
+void CompassSensor::readConstants()
+{
+    VFUNC_LOG;
 
+    int om[9];
+    if (inv_read_topology_orientation(INV_TOPOLOGY_COMPASS_ORIENT,
+                                      compassSysFs.compass_orient, om) == 0) {
         LOGV_IF(EXTRA_VERBOSE,
                 "HAL:compass mounting matrix: "
                 "%+d %+d %+d %+d %+d %+d %+d %+d %+d",
@@ -107,9 +106,10 @@ CompassSensor::CompassSensor()
         LOGE("HAL:Couldn't read compass mounting matrix");
     }
 
-    if (!isIntegrated()) {
-        enable(ID_M, 0);
-    }
+    LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:cat %s (%lld)",
+            compassSysFs.compass_scale, getTimestamp());
+    if (inv_read_data(compassSysFs.compass_scale, &mSensitivity) < 0)
+        LOGE("HAL:Couldn't read compass sensitivity");
 }
 
 CompassSensor::~CompassSensor()
@@ -117,14 +117,13 @@ CompassSensor::~CompassSensor()
     VFUNC_LOG;
 
     free(pathP);
-    if( compass_fd > 0)
-        close(compass_fd);
 }
 
+/* the samples arrive on the MPU's iio fd */
 int CompassSensor::getFd() const
 {
     VHANDLER_LOG;
-    return compass_fd;
+    return -1;
 }
 
 /**
@@ -185,31 +184,6 @@ int CompassSensor::getEnable(int32_t handle)
     return mEnable;
 }
 
-/* use for Invensense compass calibration */
-#define COMPASS_EVENT_DEBUG (0)
-void CompassSensor::processCompassEvent(const input_event *event)
-{
-    VHANDLER_LOG;
-
-    switch (event->code) {
-    case EVENT_TYPE_ICOMPASS_X:
-        LOGV_IF(COMPASS_EVENT_DEBUG, "EVENT_TYPE_ICOMPASS_X\n");
-        mCachedCompassData[0] = event->value;
-        break;
-    case EVENT_TYPE_ICOMPASS_Y:
-        LOGV_IF(COMPASS_EVENT_DEBUG, "EVENT_TYPE_ICOMPASS_Y\n");
-        mCachedCompassData[1] = event->value;
-        break;
-    case EVENT_TYPE_ICOMPASS_Z:
-        LOGV_IF(COMPASS_EVENT_DEBUG, "EVENT_TYPE_ICOMPASS_Z\n");
-        mCachedCompassData[2] = event->value;
-        break;
-    }
-    
-    mCompassTimestamp = 
-        (int64_t)event->time.tv_sec * 1000000000L + event->time.tv_usec * 1000L;
-}
-
 void CompassSensor::getOrientationMatrix(signed char *orient)
 {
     VFUNC_LOG;
@@ -219,52 +193,18 @@ void CompassSensor::getOrientationMatrix(signed char *orient)
 long CompassSensor::getSensitivity()
 {
     VFUNC_LOG;
-
-    long sensitivity;
-    LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:cat %s (%lld)", 
-            compassSysFs.compass_scale, getTimestamp());
-    inv_read_data(compassSysFs.compass_scale, &sensitivity);
-    return sensitivity;
+    return mSensitivity;
 }
 
 /**
-    @brief         This function is called by sensors_mpl.cpp
-                   to read sensor data from the driver.
-    @param[out]    data      sensor data is stored in this variable. Scaled such that
-                             1 uT = 2^16
-    @para[in]      timestamp data's timestamp
-    @return        1, if 1   sample read, 0, if not, negative if error
+    @brief         Nothing to read here, the compass comes with the MPU
+                   scans.
+    @return        0, never a sample of its own
  */
 int CompassSensor::readSample(long *data, int64_t *timestamp)
 {
     VHANDLER_LOG;
-
-    int numEventReceived = 0, done = 0;
-
-    ssize_t n = mCompassInputReader.fill(compass_fd);
-    if (n < 0) {
-        LOGE("HAL:no compass events read");
-        return n;
-    }
-
-    input_event const* event;
-
-    while (done == 0 && mCompassInputReader.readEvent(&event)) {
-        int type = event->type;
-        if (type == EV_REL) {
-            processCompassEvent(event);
-        } else if (type == EV_SYN) {
-            *timestamp = mCompassTimestamp;
-            memcpy(data, mCachedCompassData, sizeof(mCachedCompassData));
-            done = 1;
-        } else {
-            LOGE("HAL:Compass Sensor: unknown event (type=%d, code=%d)",
-                 type, event->code);
-        }
-        mCompassInputReader.next();
-    }
-
-    return done;
+    return 0;
 }
 
 /**
@@ -332,10 +272,9 @@ int CompassSensor::inv_init_sysfs_attributes(void)
     VFUNC_LOG;
 
     unsigned char i = 0;
-    char sysfs_path[MAX_SYSFS_NAME_LEN], iio_trigger_path[MAX_SYSFS_NAME_LEN], tbuf[2];
+    char sysfs_path[MAX_SYSFS_NAME_LEN], iio_trigger_path[MAX_SYSFS_NAME_LEN];
     char *sptr;
     char **dptr;
-    int num;
 
     pathP = (char*)malloc(
                     sizeof(char[COMPASS_MAX_SYSFS_ATTRB][MAX_SYSFS_NAME_LEN]));
@@ -351,25 +290,14 @@ int CompassSensor::inv_init_sysfs_attributes(void)
 
     // get proper (in absolute/relative) IIO path & build MPU's sysfs paths
     // inv_get_sysfs_abs_path(sysfs_path);
-    if(INV_SUCCESS != inv_get_sysfs_path(sysfs_path)) {
+    const struct inv_topology *topo = inv_get_topology();
+    if (topo == NULL) {
         ALOGE("CompassSensor failed get sysfs path");
         return -1;
     }
+    strcpy(sysfs_path, topo->sysfs_path);
+    strcpy(iio_trigger_path, topo->trigger_path);
 
-    inv_get_iio_trigger_path(iio_trigger_path);
-
-#if defined COMPASS_AK8975
-    inv_get_input_number(COMPASS_NAME, &num);
-    tbuf[0] = num + 0x30;
-    tbuf[1] = 0;
-    sprintf(sysfs_path, "%s%s", "sys/class/input/input", tbuf);
-    strcat(sysfs_path, "/ak8975");
-
-    sprintf(compassSysFs.compass_enable, "%s%s", sysfs_path, "/enable");
-    sprintf(compassSysFs.compass_rate, "%s%s", sysfs_path, "/rate");
-    sprintf(compassSysFs.compass_scale, "%s%s", sysfs_path, "/scale");
-    sprintf(compassSysFs.compass_orient, "%s%s", sysfs_path, "/compass_matrix");
-#else
     sprintf(compassSysFs.compass_enable, "%s%s", sysfs_path, "/compass_enable");
     sprintf(compassSysFs.compass_x_fifo_enable, "%s%s", sysfs_path, "/scan_elements/in_magn_x_en");
     sprintf(compassSysFs.compass_y_fifo_enable, "%s%s", sysfs_path, "/scan_elements/in_magn_y_en");
@@ -377,7 +305,6 @@ int CompassSensor::inv_init_sysfs_attributes(void)
     sprintf(compassSysFs.compass_rate, "%s%s", sysfs_path, "/sampling_frequency");
     sprintf(compassSysFs.compass_scale, "%s%s", sysfs_path, "/in_magn_scale");
     sprintf(compassSysFs.compass_orient, "%s%s", sysfs_path, "/compass_matrix");
-#endif
 
 #if SYSFS_VERBOSE
     // test print sysfs paths
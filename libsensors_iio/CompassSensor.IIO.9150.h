@@ -22,18 +22,8 @@
 #include <sys/cdefs.h>
 #include <sys/types.h>
 
-// TODO fixme, need input_event
-#include <stdint.h>
-#include <errno.h>
-#include <sys/cdefs.h>
-#include <sys/types.h>
-#include <poll.h>
-#include <utils/Vector.h>
-#include <utils/KeyedVector.h>
-
 #include "sensors.h"
 #include "SensorBase.h"
-#include "InputEventReader.h"
 
 class CompassSensor : public SensorBase {
 
@@ -54,6 +44,7 @@ public:
     int providesCalibration() { return 0; }
     void getOrientationMatrix(signed char *orient);
     long getSensitivity();
+    void readConstants();
     int getAccuracy() { return 0; }
     void fillList(struct sensor_t *list);
     int isIntegrated() { return (mI2CBus == COMPASS_BUS_SECONDARY); }
@@ -76,15 +67,11 @@ private:
 
     // implementation specific
     signed char mCompassOrientation[9];
-    long mCachedCompassData[3];
-    int compass_fd;
-    int64_t mCompassTimestamp;
-    InputEventCircularReader mCompassInputReader;
+    long mSensitivity;
     int64_t mDelay;
     int mEnable;
     char *pathP;
 
-    void processCompassEvent(const input_event *event);
     int inv_init_sysfs_attributes(void);
 };
 
@@ -66,14 +66,13 @@
 
 CompassSensor::CompassSensor()
                   : SensorBase(COMPASS_NAME, NULL),
+                    mSensitivity(0),
                     mCompassTimestamp(0),
                     mCompassInputReader(8)
 #ifdef COMPASS_YAS53x
                     , mCoilsResetFd(0)
 #endif
 {
-    FILE *fptr;
-
     VFUNC_LOG;
 
     /*
@@ -85,13 +84,13 @@ CompassSensor::CompassSensor()
 #ifdef COMPASS_YAS53x
     /* for YAS53x compasses, dev_name is just a prefix,
        we need to find the actual name */
-    if (fill_dev_full_name_by_prefix(dev_name,
+    if (fill_dev_full_name_by_prefix(mDevName,
             dev_full_name, sizeof(dev_full_name) / sizeof(dev_full_name[0]))) {
         LOGE("Cannot find Yamaha device with prefix name '%s' - "
-             "magnetometer will likely not work.", dev_name);
+             "magnetometer will likely not work.", mDevName);
     }
 #else
-    strncpy(dev_full_name, dev_name,
+    strncpy(dev_full_name, mDevName,
             sizeof(dev_full_name) / sizeof(dev_full_name[0]));
 #endif
 
@@ -115,6 +114,28 @@ CompassSensor::CompassSensor()
     LOGV_IF(SYSFS_VERBOSE, "HAL:compass name: %s", dev_full_name);
     enable_iio_sysfs();
 
+    readConstants();
+
+#ifdef COMPASS_YAS53x
+    mCoilsResetFd = fopen(compassSysFs.compass_attr_1, "r+");
+    if (mCoilsResetFd == NULL) {
+        LOGE("HAL:Couldn't read compass overunderflow");
+    }
+#endif
+}
+
+/**
+    @brief      Read the mounting matrix and the sensitivity, fixed for the
+                device, so they are not read from sysfs again every time
+                the MPL asks. Call again to refresh them after the compass
+                was reset.
+ */
+void CompassSensor::readConstants()
+{
+    VFUNC_LOG;
+
+    FILE *fptr;
+
     LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:cat %s (%lld)",
             compassSysFs.compass_orient, getTimestamp());
     fptr = fopen(compassSysFs.compass_orient, "r");
@@ -143,12 +164,10 @@ CompassSensor::CompassSensor()
         LOGE("HAL:Couldn't read compass mounting matrix");
     }
 
-#ifdef COMPASS_YAS53x
-    mCoilsResetFd = fopen(compassSysFs.compass_attr_1, "r+");
-    if (fptr == NULL) {
-        LOGE("HAL:Couldn't read compass overunderflow");
-    }
-#endif
+    LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:cat %s (%lld)",
+            compassSysFs.compass_scale, getTimestamp());
+    if (inv_read_data(compassSysFs.compass_scale, &mSensitivity) < 0)
+        LOGE("HAL:Couldn't read compass sensitivity");
 }
 
 void CompassSensor::enable_iio_sysfs()
@@ -424,16 +443,11 @@ void CompassSensor::getOrientationMatrix(signed char *orient)
 long CompassSensor::getSensitivity()
 {
     VFUNC_LOG;
-
-    long sensitivity;
-    LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:cat %s (%lld)",
-            compassSysFs.compass_scale, getTimestamp());
-    inv_read_data(compassSysFs.compass_scale, &sensitivity);
-    return sensitivity;
+    return mSensitivity;
 }
 
 /**
-    @brief         This function is called by sensors_mpl.cpp
+    @brief         This function is called by sensors.cpp
                    to read sensor data from the driver.
     @param[out]    data      sensor data is stored in this variable. Scaled such that
                              1 uT = 2^16
@@ -446,12 +460,15 @@ int CompassSensor::readSample(long *data, int64_t *timestamp) {
     int i;
     char *rdata = mIIOBuffer;
 
-    size_t rsize = read(compass_fd, rdata, (8 * mEnable + 8) * 1);
+    size_t rsize;
 
     if (!mEnable) {
+        // nobody wants the samples, empty the ring with a single read
         rsize = read(compass_fd, rdata, (8 + 8) * IIO_BUFFER_LENGTH);
         // LOGI("clear buffer with size: %d", rsize);
+        return 0;
     }
+    rsize = read(compass_fd, rdata, (8 * mEnable + 8) * 1);
 /*
     LOGI("get one sample of AMI IIO data with size: %d", rsize);
     LOGI_IF(mEnable, "compass x/y/z: %d/%d/%d", *((short *) (rdata + 0)),
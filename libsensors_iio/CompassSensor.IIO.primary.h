@@ -56,6 +56,7 @@ public:
     int providesCalibration() { return 0; }
     void getOrientationMatrix(signed char *orient);
     long getSensitivity();
+    void readConstants();
     int getAccuracy() { return 0; }
     void fillList(struct sensor_t *list);
     int isIntegrated() { return (mI2CBus == COMPASS_BUS_SECONDARY); }
@@ -92,6 +93,7 @@ private:
 
     // implementation specific
     signed char mCompassOrientation[9];
+    long mSensitivity;
     long mCachedCompassData[3];
     int64_t mCompassTimestamp;
     InputEventCircularReader mCompassInputReader;
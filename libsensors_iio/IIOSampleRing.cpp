@@ -0,0 +1,89 @@
+/*
+* Copyright (C) 2012 Invensense, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <cutils/atomic.h>
+
+#include "IIOSampleRing.h"
+
+/*****************************************************************************/
+
+static int32_t roundUpPow2(size_t n)
+{
+    int32_t size = 1;
+    while ((size_t) size < n)
+        size <<= 1;
+    return size;
+}
+
+IIOSampleRing::IIOSampleRing(size_t numSamples)
+    : mBuffer(new iio_sample[roundUpPow2(numSamples)]),
+      mMask(roundUpPow2(numSamples) - 1),
+      mHead(0),
+      mTail(0),
+      mDropped(0)
+{
+}
+
+IIOSampleRing::~IIOSampleRing()
+{
+    delete [] mBuffer;
+}
+
+/* producer side, a full ring drops the new sample */
+bool IIOSampleRing::push(const struct iio_sample& sample)
+{
+    int32_t head = mHead;
+
+    if (head - android_atomic_acquire_load(&mTail) > mMask) {
+        android_atomic_inc(&mDropped);
+        return false;
+    }
+    mBuffer[head & mMask] = sample;
+    android_atomic_release_store(head + 1, &mHead);
+    return true;
+}
+
+/* consumer side */
+bool IIOSampleRing::pop(struct iio_sample* sample)
+{
+    int32_t tail = mTail;
+
+    if (tail == android_atomic_acquire_load(&mHead))
+        return false;
+    *sample = mBuffer[tail & mMask];
+    android_atomic_release_store(tail + 1, &mTail);
+    return true;
+}
+
+/* consumer side, the oldest sample stays in the ring, NULL if empty */
+const struct iio_sample* IIOSampleRing::front() const
+{
+    int32_t tail = mTail;
+
+    if (tail == android_atomic_acquire_load(&mHead))
+        return NULL;
+    return &mBuffer[tail & mMask];
+}
+
+bool IIOSampleRing::empty() const
+{
+    return android_atomic_acquire_load(&mTail) ==
+            android_atomic_acquire_load(&mHead);
+}
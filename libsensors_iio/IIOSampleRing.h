@@ -0,0 +1,61 @@
+/*
+* Copyright (C) 2012 Invensense, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+
+#ifndef ANDROID_IIO_SAMPLE_RING_H
+#define ANDROID_IIO_SAMPLE_RING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/*****************************************************************************/
+
+/* one IIO scan, already split into its sensor fields */
+struct iio_sample {
+    long quat[4];
+    short gyro[3];
+    long accel[3];
+    long compass[3];
+    int64_t timestamp;
+    long present;       // INV_THREE_AXIS_* sensors carried in the scan
+    int quatOn;         // the scan starts with the LP quaternion
+    long long temperature[2]; // raw gyro temperature and its timestamp
+    int tempOn;         // temperature was read along with this scan
+};
+
+/* Single-producer/single-consumer ring. Only the producer moves mHead and
+   only the consumer moves mTail, so neither side needs a lock. */
+class IIOSampleRing
+{
+    struct iio_sample* const mBuffer;
+    const int32_t mMask;
+    volatile int32_t mHead;
+    volatile int32_t mTail;
+    volatile int32_t mDropped;
+
+public:
+    IIOSampleRing(size_t numSamples);
+    ~IIOSampleRing();
+    bool push(const struct iio_sample& sample);
+    bool pop(struct iio_sample* sample);
+    const struct iio_sample* front() const;
+    bool empty() const;
+    int32_t dropped() const { return mDropped; }
+};
+
+/*****************************************************************************/
+
+#endif  // ANDROID_IIO_SAMPLE_RING_H
@@ -23,6 +23,7 @@
 
 #include <sys/cdefs.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <linux/input.h>
 
@@ -33,54 +34,72 @@
 
 /*****************************************************************************/
 
-struct input_event;
+template <typename T>
+static inline T min(T a, T b) {
+    return a<b ? a : b;
+}
 
-InputEventCircularReader::InputEventCircularReader(size_t numEvents)
-    : mBuffer(new input_event[numEvents * 2]),
+template <typename T>
+EventCircularReader<T>::EventCircularReader(size_t numEvents)
+    : mBuffer(new T[numEvents]),
       mBufferEnd(mBuffer + numEvents),
       mHead(mBuffer),
       mCurr(mBuffer),
-      mFreeSpace(numEvents)
+      mMaxEvents(numEvents),
+      mFreeEvents(numEvents)
 {
 }
 
-InputEventCircularReader::~InputEventCircularReader()
+template <typename T>
+EventCircularReader<T>::~EventCircularReader()
 {
     delete [] mBuffer;
 }
 
 #define INPUT_EVENT_DEBUG (0)
-ssize_t InputEventCircularReader::fill(int fd)
+template <typename T>
+ssize_t EventCircularReader<T>::fill(int fd)
 {
     size_t numEventsRead = 0;
     LOGV_IF(INPUT_EVENT_DEBUG, 
             "DEBUG:%s enter, fd=%d\n", __PRETTY_FUNCTION__, fd);
-    if (mFreeSpace) {
-        const ssize_t nread = read(fd, mHead, mFreeSpace * sizeof(input_event));
-        if (nread < 0 || nread % sizeof(input_event)) {
-            //LOGE("Partial event received nread=%d, required=%d", 
-            //     nread, sizeof(input_event));
-            //LOGE("FD trying to read is: %d");
+    if (mFreeEvents) {
+        /* read straight into both halves of the ring when the free space
+           wraps, rather than overflowing the end and copying back */
+        struct iovec iov[2];
+
+        const size_t numFirst = min(mFreeEvents, (size_t)(mBufferEnd - mHead));
+        const size_t numSecond = mFreeEvents - numFirst;
+
+        int iovcnt = 1;
+        iov[0].iov_base = mHead;
+        iov[0].iov_len = numFirst * sizeof(T);
+
+        if (numSecond > 0) {
+            iovcnt++;
+            iov[1].iov_base = mBuffer;
+            iov[1].iov_len = numSecond * sizeof(T);
+        }
+
+        const ssize_t nread = readv(fd, iov, iovcnt);
+        if (nread < 0 || nread % sizeof(T)) {
             // we got a partial event!!
             if (INPUT_EVENT_DEBUG) {
                 LOGV_IF(nread < 0, "DEBUG:%s exit nread < 0\n", 
                         __PRETTY_FUNCTION__);
-                LOGV_IF(nread % sizeof(input_event), 
-                        "DEBUG:%s exit nread %% sizeof(input_event)\n", 
+                LOGV_IF(nread % sizeof(T), 
+                        "DEBUG:%s exit nread %% sizeof(event)\n", 
                         __PRETTY_FUNCTION__);
             }
             return (nread < 0 ? -errno : -EINVAL);
         }
 
-        numEventsRead = nread / sizeof(input_event);
+        numEventsRead = nread / sizeof(T);
         if (numEventsRead) {
             mHead += numEventsRead;
-            mFreeSpace -= numEventsRead;
-            if (mHead > mBufferEnd) {
-                size_t s = mHead - mBufferEnd;
-                memcpy(mBuffer, mBufferEnd, s * sizeof(input_event));
-                mHead = mBuffer + s;
-            }
+            mFreeEvents -= numEventsRead;
+            if (mHead >= mBufferEnd)
+                mHead -= mMaxEvents;
         }
     }
 
@@ -88,18 +107,64 @@ ssize_t InputEventCircularReader::fill(int fd)
     return numEventsRead;
 }
 
-ssize_t InputEventCircularReader::readEvent(input_event const** events)
+template <typename T>
+ssize_t EventCircularReader<T>::readEvent(T const** events)
 {
     *events = mCurr;
-    ssize_t available = (mBufferEnd - mBuffer) - mFreeSpace;
+    ssize_t available = mMaxEvents - mFreeEvents;
     return available ? 1 : 0;
 }
 
-void InputEventCircularReader::next()
+/* Return how many buffered events can be read contiguously from *events,
+   i.e. up to the end of the ring. Consume them with next(count); any
+   remainder past the wrap is returned by the following call. */
+template <typename T>
+ssize_t EventCircularReader<T>::readEvents(T const** events)
+{
+    *events = mCurr;
+    size_t available = mMaxEvents - mFreeEvents;
+    return min(available, (size_t)(mBufferEnd - mCurr));
+}
+
+/* same as above, refilling the ring from fd first once it is empty */
+template <typename T>
+bool EventCircularReader<T>::readEvent(int fd, T const** events)
 {
-    mCurr++;
-    mFreeSpace++;
+    if (mFreeEvents >= mMaxEvents) {
+        ssize_t eventCount = fill(fd);
+        if (eventCount <= 0)
+            return false;
+    }
+    return readEvent(events) > 0;
+}
+
+template <typename T>
+ssize_t EventCircularReader<T>::readEvents(int fd, T const** events)
+{
+    if (mFreeEvents >= mMaxEvents) {
+        ssize_t eventCount = fill(fd);
+        if (eventCount <= 0)
+            return eventCount;
+    }
+    return readEvents(events);
+}
+
+template <typename T>
+void EventCircularReader<T>::next()
+{
+    next(1);
+}
+
+template <typename T>
+void EventCircularReader<T>::next(size_t count)
+{
+    count = min(count, mMaxEvents - mFreeEvents);
+    mCurr += count;
     if (mCurr >= mBufferEnd) {
-        mCurr = mBuffer;
+        mCurr -= mMaxEvents;
     }
+    mFreeEvents += count;
 }
+
+template class EventCircularReader<input_event>;
+template class EventCircularReader<iio_event_data>;
@@ -22,28 +22,41 @@
 #include <sys/cdefs.h>
 #include <sys/types.h>
 
+#include <linux/input.h>
+
 #include "SensorBase.h"
+#include "iio/events.h"
 
 /*****************************************************************************/
 
-struct input_event;
-
-class InputEventCircularReader
+/* Ring of fixed size events read straight from an event fd. The same code
+   serves the input devices (input_event) and the IIO event fds
+   (iio_event_data); both instantiations live in libinvensense_hal. */
+template <typename T>
+class EventCircularReader
 {
-    struct input_event* const mBuffer;
-    struct input_event* const mBufferEnd;
-    struct input_event* mHead;
-    struct input_event* mCurr;
-    ssize_t mFreeSpace;
+    T* const mBuffer;
+    T* const mBufferEnd;
+    T* mHead;
+    T* mCurr;
+    size_t mMaxEvents;
+    size_t mFreeEvents;
 
 public:
-    InputEventCircularReader(size_t numEvents);
-    ~InputEventCircularReader();
+    EventCircularReader(size_t numEvents);
+    ~EventCircularReader();
     ssize_t fill(int fd);
-    ssize_t readEvent(input_event const** events);
+    ssize_t readEvent(T const** events);
+    ssize_t readEvents(T const** events);
+    bool readEvent(int fd, T const** events);
+    ssize_t readEvents(int fd, T const** events);
     void next();
+    void next(size_t count);
 };
 
+typedef EventCircularReader<input_event> InputEventCircularReader;
+typedef EventCircularReader<iio_event_data> IioEventCircularReader;
+
 /*****************************************************************************/
 
 #endif  // ANDROID_INPUT_EVENT_READER_H
@@ -35,6 +35,8 @@
 #include <string.h>
 #include <linux/input.h>
 #include <utils/Atomic.h>
+#include <utils/threads.h>
+#include <cutils/properties.h>
 
 #include "MPLSensor.h"
 #include "MPLSupport.h"
@@ -85,6 +87,89 @@ static int hertz_request = 200;
 #define RATE_15HZ                       66667000LL
 #define RATE_5HZ                        200000000LL
 
+/* how long enable/setDelay changes are gathered before the FIFO restarts */
+#define RECONFIG_WINDOW_NS              10000000LL
+
+/* adaptive compass rate: fusion-only compass slowed to this rate once its
+   calibration has been settled (full accuracy, no disturbance) that long */
+#define COMPASS_SETTLED_RATE            RATE_15HZ
+#define COMPASS_SETTLE_NS               2000000000LL
+
+/* compass warm start: the states saved before a compass reset come back
+   once this many samples in a row see the field they were fitted to, at
+   the same strength within this fraction */
+#define COMPASS_WARM_SAMPLES            5
+#define COMPASS_WARM_TOLERANCE          0.1f
+
+/* gyro parking: fusion-only gyro powered down after this long without
+   motion, back once the accel moves this far from where it was parked
+   (g, 1.0 = 2^16). The rv step between the two fusions fades out over
+   RV_BLEND_NS */
+#define GYRO_PARK_NS                    5000000000LL
+#define GYRO_WAKE_ACCEL_DELTA           (65536L / 20)
+#define RV_BLEND_NS                     500000000LL
+
+/* fusion gating: once the device has been still with the 9-axis quaternion
+   at full accuracy for FUSION_STEADY_NS, the MPL runs on one scan in
+   FUSION_GATE_DIVISOR. An accel move of FUSION_WAKE_ACCEL_DELTA from the
+   last run brings the full rate back at once */
+#define FUSION_STEADY_NS                1000000000LL
+#define FUSION_GATE_DIVISOR             4
+#define FUSION_WAKE_ACCEL_DELTA         (65536L / 50)
+
+/* measured ODR: the gyro/accel scan interval is smoothed over
+   1 << ODR_SMOOTHING_SHIFT scans and, once ODR_MIN_SAMPLES have been seen,
+   given to the MPL in place of the nominal rate whenever the two differ by
+   more than ODR_TOLERANCE_PERCENT. Intervals off nominal by more than 2x
+   (gaps, parking, reconfig) are not counted */
+#define ODR_SMOOTHING_SHIFT             4
+#define ODR_MIN_SAMPLES                 64
+#define ODR_TOLERANCE_PERCENT           2
+
+/* DMP flick thresholds, as used by the gesture test */
+#define DMP_FLICK_UPPER_THRES           3147790
+#define DMP_FLICK_LOWER_THRES           -3147790
+#define DMP_FLICK_COUNTER               50
+
+/* significant motion: accel change that wakes the AP, in mg over ms, and
+   the low power accel wakeup rate while armed (1 = 5Hz) */
+#define SIG_MOTION_THRESHOLD            200
+#define SIG_MOTION_DURATION             50
+#define SIG_MOTION_LPA_FREQ             1
+
+/* FIFO temperature: one gyro scan in TEMP_FIFO_DECIMATION has its
+   temperature sent to gyro_tc, ro.sensors.temp_decimation overrides it */
+#define TEMP_FIFO_DECIMATION            20
+
+/* shake detection: a peak is the accel magnitude going further than
+   SHAKE_PEAK_G from 1g, the next one counts once it came back within
+   SHAKE_REARM_G. Peaks less than SHAKE_GAP_NS apart make one swing, each
+   back and forth of it is a shake. The accel is run at SHAKE_DELAY_NS
+   whatever rate the shake sensor is asked for */
+#define SHAKE_DELAY_NS                  20000000LL
+#define SHAKE_PEAK_G                    1.0f
+#define SHAKE_REARM_G                   0.5f
+#define SHAKE_GAP_NS                    400000000LL
+
+/* MPL inputs (inv_execute_on_data() mode bits) each output depends on,
+   the handler of a sensor only runs when one of them has new data */
+static const int sSensorInputs[MPLSensor::numSensors] = {
+    INV_GYRO_NEW,                                               // Gyro
+    INV_GYRO_NEW,                                               // RawGyro
+    INV_ACCEL_NEW,                                              // Accelerometer
+    INV_MAG_NEW,                                                // MagneticField
+    INV_GYRO_NEW | INV_ACCEL_NEW | INV_MAG_NEW | INV_QUAT_NEW,  // Orientation
+    INV_GYRO_NEW | INV_ACCEL_NEW | INV_MAG_NEW | INV_QUAT_NEW,  // RotationVector
+    INV_GYRO_NEW | INV_ACCEL_NEW | INV_MAG_NEW | INV_QUAT_NEW,  // LinearAccel
+    INV_GYRO_NEW | INV_ACCEL_NEW | INV_QUAT_NEW,                // Gravity
+#ifdef ENABLE_GAME_RV_FEAT
+    INV_GYRO_NEW | INV_ACCEL_NEW | INV_QUAT_NEW,                // GameRotationVector
+#endif
+#ifdef ENABLE_SHAKE_FEAT
+    INV_ACCEL_NEW,                                              // Shake
+#endif
+};
+
 static struct sensor_t sSensorList[] =
 {
     {"MPL Gyroscope", "Invensense", 1,
@@ -111,12 +196,38 @@ static struct sensor_t sSensorList[] =
     {"MPL Gravity", "Invensense", 1,
      SENSORS_GRAVITY_HANDLE,
      SENSOR_TYPE_GRAVITY, 10240.0f, 1.0f, 0.5f, 10000, {}},
+#ifdef ENABLE_GAME_RV_FEAT
+    {"MPL Game Rotation Vector", "Invensense", 1,
+     SENSORS_GAME_ROTATION_VECTOR_HANDLE,
+     SENSOR_TYPE_GAME_ROTATION_VECTOR, 1.0f, 1.0f, 0.5f, 10000, {}},
+#endif
+#ifdef ENABLE_SHAKE_FEAT
+    {"MPL Shake", "Invensense", 1,
+     SENSORS_SHAKE_HANDLE,
+     SENSOR_TYPE_SHAKE, 100.0f, 1.0f, 0.5f, 0, {}},
+#endif
 
 #ifdef ENABLE_DMP_SCREEN_AUTO_ROTATION
     {"MPL Screen Orientation", "Invensense ", 1,
      SENSORS_SCREEN_ORIENTATION_HANDLE,
      SENSOR_TYPE_SCREEN_ORIENTATION, 100.0f, 1.0f, 1.1f, 0, {}},
 #endif
+
+    /* event sensors last, populateSensorList() drops those the driver
+       has no event node for */
+#ifdef ENABLE_DMP_PEDOMETER_FEAT
+    {"MPL Step Detector", "Invensense", 1,
+     SENSORS_STEP_DETECTOR_HANDLE,
+     SENSOR_TYPE_STEP_DETECTOR, 1.0f, 1.0f, 0.5f, 0, {}},
+    {"MPL Step Counter", "Invensense", 1,
+     SENSORS_STEP_COUNTER_HANDLE,
+     SENSOR_TYPE_STEP_COUNTER, 4294967295.0f, 1.0f, 0.5f, 0, {}},
+#endif
+#ifdef ENABLE_SIGNIFICANT_MOTION_FEAT
+    {"MPL Significant Motion", "Invensense", 1,
+     SENSORS_SIGNIFICANT_MOTION_HANDLE,
+     SENSOR_TYPE_SIGNIFICANT_MOTION, 1.0f, 1.0f, 0.1f, -1, {}},
+#endif
 };
 
 MPLSensor *MPLSensor::gMPLSensor = NULL;
@@ -146,6 +257,17 @@ static FILE *logfile = NULL;
 
 pthread_mutex_t GlobalHalMutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* The sysfs paths and the sensor list only depend on the MPU the topology
+   resolved to, so the first MPLSensor in the process builds them and every
+   later HAL open reuses them. An MPU that doesn't match the cached one
+   builds its own copy as before. */
+static pthread_mutex_t sHalCacheLock = PTHREAD_MUTEX_INITIALIZER;
+static char *sSysfsNames = NULL;
+static char sSysfsNamesKey[INV_TOPOLOGY_NAME_LEN];
+static struct sensor_t sCachedList[sizeof(sSensorList) / sizeof(sensor_t)];
+static char sCachedListChip[MAX_CHIP_ID_LEN];
+static int sCachedListCount = 0;
+
 /*******************************************************************************
  * MPLSensor class implementation
  ******************************************************************************/
@@ -155,29 +277,64 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
                          mNewData(0),
                          mMasterSensorMask(INV_ALL_SENSORS),
                          mLocalSensorMask(0),
-                         mPollTime(-1),
+                         mDmpQuatOnly(0),
+                         mMplModules(0),
+                         mDmpQuatTimestamp(0),
+                         mCompassSlow(0),
+                         mCompassFastDelay(0),
+                         mCompassSettledTs(0),
+                         mCompassCal(NULL),
+                         mCompassCalSize(0),
+                         mCompassCalField(0),
+                         mCompassWarmMatches(0),
+                         mGyroParked(false),
+                         mNoMotionSince(0),
+                         mRvSwitched(false),
+                         mRvLastTs(0),
+                         mRvBlendStart(0),
+                         mFusionSteadySince(0),
+                         mFusionSkipped(0),
+                         mShakes(0),
+                         mShakePeaks(0),
+                         mShakeArmed(true),
+                         mShakeLastPeakTs(0),
                          mHaveGoodMpuCal(0),
                          mGyroAccuracy(0),
                          mAccelAccuracy(0),
                          mCompassAccuracy(0),
                          mSampleCount(0),
                          dmp_orient_fd(-1),
+                         dmp_pedometer_fd(-1),
+                         motion_fd(-1),
                          mDmpOrientationEnabled(0),
+                         mDmpStepEnabled(0),
+                         mStepCount(0),
+                         mStepsHw(0),
                          mEnabled(0),
                          mOldEnabledMask(0),
                          mAccelInputReader(4),
                          mGyroInputReader(32),
+                         mSampleRing(IIO_BUFFER_LENGTH),
+                         mCompassQueue(COMPASS_QUEUE_LENGTH),
                          mTempScale(0),
                          mTempOffset(0),
                          mTempCurrentTime(0),
+                         mIngestTempTime(0),
+                         mTempFifo(false),
+                         mTempDecimation(TEMP_FIFO_DECIMATION),
+                         mTempScans(0),
                          mAccelScale(2),
                          mPendingMask(0),
+                         mNewDataMode(0),
                          mSensorMask(0),
                          mFeatureActiveMask(0) {
+    inv_load_log_mask();
     VFUNC_LOG;
 
     inv_error_t rv;
     int i, fd;
+
+    memset(&mReadStats, 0, sizeof(mReadStats));
     char *port = NULL;
     char *ver_str;
     unsigned long mSensorMask;
@@ -191,6 +348,11 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
 
     pthread_mutex_init(&mMplMutex, NULL);
     pthread_mutex_init(&mHALMutex, NULL);
+    mReconfigOpen = false;
+    mReconfigDeadline = 0;
+    mMasterWanted = -1;
+    mPowerWanted = -1;
+    mIngestRunning = false;
     memset(mGyroOrientation, 0, sizeof(mGyroOrientation));
     memset(mAccelOrientation, 0, sizeof(mAccelOrientation));
 
@@ -205,9 +367,13 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     inv_init_sysfs_attributes();
 
     /* get chip name */
-    if (inv_get_chip_name(chip_ID) != INV_SUCCESS) {
+    chip_ID[0] = '\0';
+    const struct inv_topology *topo = inv_get_topology();
+    if (topo == NULL || topo->chip_name[0] == '\0') {
         LOGE("HAL:ERR- Failed to get chip ID\n");
     } else {
+        strncpy(chip_ID, topo->chip_name, sizeof(chip_ID) - 1);
+        chip_ID[sizeof(chip_ID) - 1] = '\0';
         LOGV_IF(PROCESS_VERBOSE, "HAL:Chip ID= %s\n", chip_ID);
     }
 
@@ -219,11 +385,31 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     /* reset driver master enable */
     masterEnable(0);
 
-    if (isLowPowerQuatEnabled() || isDmpDisplayOrientationOn()) {
+    if (isLowPowerQuatEnabled() || isDmpDisplayOrientationOn() ||
+            isDmpPedometerOn()) {
         /* Load DMP image if capable, ie. MPU6xxx/9xxx */
         loadDMP();
     }
 
+    /* the poll loop watches the event nodes from the start */
+    openDmpPedometerFd();
+    openSigMotionFd();
+
+#ifdef ENABLE_FIFO_TEMP_FEAT
+    /* the temperature comes with the gyro scans when the driver has the
+       channel, the sysfs node is only the fallback */
+    mTempFifo = (access(mpu.temp_fifo_enable, F_OK) == 0);
+    if (mTempFifo) {
+        char value[PROPERTY_VALUE_MAX];
+
+        property_get("ro.sensors.temp_decimation", value, "");
+        if (atoi(value) > 0)
+            mTempDecimation = atoi(value);
+        LOGV_IF(EXTRA_VERBOSE, "HAL:FIFO temperature, 1 in %d gyro scans",
+                mTempDecimation);
+    }
+#endif
+
     /* open temperature fd for temp comp */
     LOGV_IF(EXTRA_VERBOSE, "HAL:gyro temperature path: %s", mpu.temperature);
     gyro_temperature_fd = open(mpu.temperature, O_RDONLY);
@@ -307,9 +493,30 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
     mHandlers[MagneticField] = &MPLSensor::compassHandler;
     mHandlers[Orientation] = &MPLSensor::orienHandler;
 
+#ifdef ENABLE_GAME_RV_FEAT
+    mPendingEvents[GameRotationVector].version = sizeof(sensors_event_t);
+    mPendingEvents[GameRotationVector].sensor = ID_GRV;
+    mPendingEvents[GameRotationVector].type = SENSOR_TYPE_GAME_ROTATION_VECTOR;
+    mHandlers[GameRotationVector] = &MPLSensor::grvHandler;
+#endif
+
+#ifdef ENABLE_SHAKE_FEAT
+    mPendingEvents[Shake].version = sizeof(sensors_event_t);
+    mPendingEvents[Shake].sensor = ID_SK;
+    mPendingEvents[Shake].type = SENSOR_TYPE_SHAKE;
+    mHandlers[Shake] = &MPLSensor::shakeHandler;
+#endif
+
     for (int i = 0; i < numSensors; i++) {
         mDelays[i] = 0;
+        mNextEventTs[i] = 0;
     }
+#ifdef ENABLE_SHAKE_FEAT
+    mDelays[Shake] = SHAKE_DELAY_NS;
+#endif
+    mHwDelay = 0;
+    mLastScanTs = 0;
+    resetOdr(0);
 
     (void)inv_get_version(&ver_str);
     LOGV_IF(PROCESS_VERBOSE, "%s\n", ver_str);
@@ -364,13 +571,15 @@ MPLSensor::MPLSensor(CompassSensor *compass, int (*m_pt2AccelCalLoadFunc)(long *
         enableDmpOrientation(!isDmpScreenAutoRotationEnabled());
     }
 
+    startIngest();
 }
 
 void MPLSensor::enable_iio_sysfs()
 {
     VFUNC_LOG;
 
-    char iio_trigger_name[MAX_CHIP_ID_LEN], iio_device_node[MAX_CHIP_ID_LEN];
+    char iio_trigger_name[MAX_CHIP_ID_LEN];
+    char iio_device_node[INV_TOPOLOGY_NAME_LEN];
     FILE *tempFp = NULL;
 
     /* ignore failures */
@@ -402,8 +611,14 @@ void MPLSensor::enable_iio_sysfs()
 
     write_sysfs_int(mpu.buffer_length, IIO_BUFFER_LENGTH);
 
-    if (inv_get_iio_device_node(iio_device_node) < 0) {
+    const struct inv_topology *topo = inv_get_topology();
+    if (topo == NULL) {
         LOGE("HAL:could retrive the iio device node");
+        iio_device_node[0] = '\0';
+    } else {
+        strncpy(iio_device_node, topo->device_node,
+                sizeof(iio_device_node) - 1);
+        iio_device_node[sizeof(iio_device_node) - 1] = '\0';
     }
     iio_fd = open(iio_device_node, O_RDONLY);
     if (iio_fd < 0) {
@@ -413,6 +628,40 @@ void MPLSensor::enable_iio_sysfs()
     }
 }
 
+/* MPL modules that only have to do work while one of the sensors in need
+   is fed to the MPL, MPL_MODULE_FUSION standing for the fused sensors.
+   feature is the mFeatureActiveMask bit the module was enabled with, if
+   any. The quaternion supervisor, the HAL outputs, the compass bias from
+   gyro, the magnetic disturbance and the no-gyro fusion can't be stopped
+   once started and keep running. */
+#define MPL_MODULE_FUSION   (INV_ALL_SENSORS + 1)
+
+static const struct {
+    const char *name;
+    long need;
+    int feature;
+    inv_error_t (*start)(void);
+    inv_error_t (*stop)(void);
+} mplModules[] = {
+    { "accel auto cal", INV_THREE_AXIS_ACCEL, 0,
+      inv_start_in_use_auto_calibration, inv_stop_in_use_auto_calibration },
+    { "fast no motion", INV_THREE_AXIS_GYRO, 0,
+      inv_start_fast_nomot, inv_stop_fast_nomot },
+    { "gyro tc", INV_THREE_AXIS_GYRO, 0,
+      inv_start_gyro_tc, inv_stop_gyro_tc },
+    { "vector compass cal", INV_THREE_AXIS_COMPASS, INV_COMPASS_CAL,
+      inv_start_vector_compass_cal, inv_stop_vector_compass_cal },
+    { "heading from gyro", INV_THREE_AXIS_COMPASS, INV_COMPASS_CAL,
+      inv_start_heading_from_gyro, inv_stop_heading_from_gyro },
+    /* compass fit comes with it and calibrates the raw compass too */
+    { "9x fusion", MPL_MODULE_FUSION | INV_THREE_AXIS_COMPASS, INV_COMPASS_FIT,
+      inv_start_9x_sensor_fusion, inv_stop_9x_sensor_fusion },
+    { "accuracy monitor", MPL_MODULE_FUSION, 0,
+      inv_start_quat_accuracy_monitor, inv_stop_quat_accuracy_monitor },
+};
+
+#define MPL_MODULES_ALL     ((1 << (sizeof(mplModules) / sizeof(mplModules[0]))) - 1)
+
 int MPLSensor::inv_constructor_init()
 {
     VFUNC_LOG;
@@ -429,6 +678,9 @@ int MPLSensor::inv_constructor_init()
         LOG_RESULT_LOCATION(result);
         return result;
     }
+    /* everything enabled is running now, nothing is enabled yet to need it */
+    mMplModules = MPL_MODULES_ALL;
+    updateMplModules(mLocalSensorMask);
 
     return result;
 }
@@ -585,6 +837,9 @@ void MPLSensor::loadDMP()
         LOGE("HAL:could open %s for write. %s", mpu.dmp_firmware, strerror(errno));
         return;
     }
+    /* unbuffered, so the image reaches the driver in one write() instead
+       of being chopped into stdio-sized pieces */
+    setvbuf(fptr, NULL, _IONBF, 0);
     res = inv_load_dmp(fptr);
     if(res < 0) {
         LOGE("HAL:load DMP failed");
@@ -592,25 +847,19 @@ void MPLSensor::loadDMP()
         LOGV_IF(PROCESS_VERBOSE, "HAL:DMP loaded");
     }
     fclose(fptr);
+    /* the driver resets the DMP attributes on a firmware load */
+    inv_sysfs_cache_invalidate();
 
     // onDMP(1);                //Can't enable here. See note onDMP()
 }
 
 void MPLSensor::inv_get_sensors_orientation()
 {
-    FILE *fptr;
+    int om[9];
 
     // get gyro orientation
-    LOGV_IF(SYSFS_VERBOSE,
-            "HAL:sysfs:cat %s (%lld)", mpu.gyro_orient, getTimestamp());
-    fptr = fopen(mpu.gyro_orient, "r");
-    if (fptr != NULL) {
-        int om[9];
-        fscanf(fptr, "%d,%d,%d,%d,%d,%d,%d,%d,%d",
-               &om[0], &om[1], &om[2], &om[3], &om[4], &om[5],
-               &om[6], &om[7], &om[8]);
-        fclose(fptr);
-
+    if (inv_read_topology_orientation(INV_TOPOLOGY_GYRO_ORIENT,
+                                      mpu.gyro_orient, om) == 0) {
         LOGV_IF(EXTRA_VERBOSE,
                 "HAL:gyro mounting matrix: "
                 "%+d %+d %+d %+d %+d %+d %+d %+d %+d",
@@ -630,16 +879,8 @@ void MPLSensor::inv_get_sensors_orientation()
     }
 
     // get accel orientation
-    LOGV_IF(SYSFS_VERBOSE,
-            "HAL:sysfs:cat %s (%lld)", mpu.accel_orient, getTimestamp());
-    fptr = fopen(mpu.accel_orient, "r");
-    if (fptr != NULL) {
-        int om[9];
-        fscanf(fptr, "%d,%d,%d,%d,%d,%d,%d,%d,%d",
-               &om[0], &om[1], &om[2], &om[3], &om[4], &om[5],
-               &om[6], &om[7], &om[8]);
-        fclose(fptr);
-
+    if (inv_read_topology_orientation(INV_TOPOLOGY_ACCEL_ORIENT,
+                                      mpu.accel_orient, om) == 0) {
         LOGV_IF(EXTRA_VERBOSE,
                 "HAL:accel mounting matrix: "
                 "%+d %+d %+d %+d %+d %+d %+d %+d %+d",
@@ -665,6 +906,8 @@ MPLSensor::~MPLSensor()
 
     mCompassSensor = NULL;
 
+    stopIngest();
+
     /* Close open fds */
     if (iio_fd > 0)
         close(iio_fd);
@@ -672,12 +915,18 @@ MPLSensor::~MPLSensor()
         close(accel_fd );
     if (gyro_temperature_fd > 0)
         close(gyro_temperature_fd);
+    inv_sysfs_cache_release();
     if (sysfs_names_ptr)
         free(sysfs_names_ptr);
+    dropCompassCal();
 
     if (isDmpDisplayOrientationOn()) {
         closeDmpOrientFd();
     }
+    if (dmp_pedometer_fd >= 0)
+        close(dmp_pedometer_fd);
+    if (motion_fd >= 0)
+        close(motion_fd);
 
     /* Turn off Gyro master enable          */
     /* A workaround until driver handles it */
@@ -699,6 +948,16 @@ MPLSensor::~MPLSensor()
 #define LA_ENABLED ((1 << ID_LA) & enabled_sensors)
 #define GR_ENABLED ((1 << ID_GR) & enabled_sensors)
 #define RV_ENABLED ((1 << ID_RV) & enabled_sensors)
+#ifdef ENABLE_GAME_RV_FEAT
+#define GRV_ENABLED ((1 << GameRotationVector) & enabled_sensors)
+#else
+#define GRV_ENABLED 0
+#endif
+#ifdef ENABLE_SHAKE_FEAT
+#define SK_ENABLED ((1 << Shake) & enabled_sensors)
+#else
+#define SK_ENABLED 0
+#endif
 
 /* TODO: this step is optional, remove?  */
 int MPLSensor::setGyroInitialState()
@@ -759,6 +1018,15 @@ int MPLSensor::onPower(int en)
 
     int count, curr_power_state;
 
+    if (mReconfigOpen) {
+        mPowerWanted = en;
+        if (!en) {
+            /* powered down at commit time, the master enable stays off */
+            mMasterWanted = -1;
+            return 0;
+        }
+    }
+
     LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:echo %d > %s (%lld)",
             en, mpu.power_state, getTimestamp());
     res = read_sysfs_int(mpu.power_state, &curr_power_state);
@@ -877,33 +1145,269 @@ int MPLSensor::enableQuaternionData(int en)
     return res;
 }
 
+int MPLSensor::writeTap(int en)
+{
+    VFUNC_LOG;
+
+    return write_sysfs_int(mpu.tap_on, en);
+}
+
+int MPLSensor::writeFlick(int en)
+{
+    VFUNC_LOG;
+
+    int res = write_sysfs_int(mpu.flick_int_on, en);
+
+    if (res >= 0)
+        res = write_sysfs_int(mpu.flick_upper, en ? DMP_FLICK_UPPER_THRES : 0);
+    if (res >= 0)
+        res = write_sysfs_int(mpu.flick_lower, en ? DMP_FLICK_LOWER_THRES : 0);
+    if (res >= 0)
+        res = write_sysfs_int(mpu.flick_counter, en ? DMP_FLICK_COUNTER : 0);
+    return res;
+}
+
+int MPLSensor::writePedometer(int en)
+{
+    VFUNC_LOG;
+
+    int res = write_sysfs_int(mpu.pedometer_on, en);
+
+    if (res >= 0)
+        res = write_sysfs_int(mpu.pedometer_int_on, en);
+    return res;
+}
+
+int MPLSensor::writeSigMotion(int en)
+{
+    VFUNC_LOG;
+
+    int res = 0;
+
+    if (en) {
+        res = write_sysfs_int(mpu.motion_lpa_threshold, SIG_MOTION_THRESHOLD);
+        if (res >= 0)
+            res = write_sysfs_int(mpu.motion_lpa_duration, SIG_MOTION_DURATION);
+        if (res >= 0)
+            res = write_sysfs_int(mpu.motion_lpa_freq, SIG_MOTION_LPA_FREQ);
+        if (res < 0)
+            return res;
+    }
+    return write_sysfs_int(mpu.motion_lpa_on, en);
+}
+
 int MPLSensor::enableTap(int en)
 {
     VFUNC_LOG;
 
-    return 0;
+    return enableEventFeature(INV_DMP_TAP, en, &MPLSensor::writeTap);
 }
 
 int MPLSensor::enableFlick(int en)
 {
     VFUNC_LOG;
 
-    return 0;
+    return enableEventFeature(INV_DMP_FLICK, en, &MPLSensor::writeFlick);
+}
+
+/* A DMP interrupt can raise several event nodes at once. The ones epoll
+   reported in the same wakeup are read here in one pass, so the cached
+   orientation, step and motion state move together and their events
+   carry the same time */
+int MPLSensor::readDmpEvents(int nodes, sensors_event_t* data, int count)
+{
+    VFUNC_LOG;
+
+    int64_t now = getTimestamp();
+    int nb, numEventReceived = 0;
+
+    if ((nodes & DMP_EVENT_ORIENT) && dmp_orient_fd >= 0) {
+        nb = readDmpOrientEvents(data, count, now);
+        if (!isDmpScreenAutoRotationEnabled()) {
+            /* ignore the data */
+            nb = 0;
+        }
+        data += nb;
+        count -= nb;
+        numEventReceived += nb;
+    }
+    if ((nodes & DMP_EVENT_PEDOMETER) && dmp_pedometer_fd >= 0) {
+        nb = readDmpPedometerEvents(data, count, now);
+        data += nb;
+        count -= nb;
+        numEventReceived += nb;
+    }
+    if ((nodes & DMP_EVENT_MOTION) && motion_fd >= 0) {
+        nb = readSigMotionEvents(data, count, now);
+        numEventReceived += nb;
+    }
+    LOGV_IF(PROCESS_VERBOSE, "HAL:DMP nodes %x, %d events",
+            nodes, numEventReceived);
+    return numEventReceived;
 }
 
 int MPLSensor::enablePedometer(int en)
 {
     VFUNC_LOG;
 
-    return 0;
+    if (dmp_pedometer_fd < 0)
+        return -EINVAL;
+    if (en) {
+        // steps the DMP counted before are not ours
+        if (read_sysfs_int(mpu.pedometer_steps, &mStepsHw) < 0)
+            mStepsHw = 0;
+    }
+    return enableEventFeature(INV_DMP_PEDOMETER, en, &MPLSensor::writePedometer);
+}
+
+int MPLSensor::enableSignificantMotion(int en)
+{
+    VFUNC_LOG;
+
+    if (motion_fd < 0)
+        return -EINVAL;
+    return enableEventFeature(INV_MOTION_WAKE, en, &MPLSensor::writeSigMotion);
+}
+
+/* DMP gestures and the pedometer only need the DMP and the accel it runs
+   on. While one of them is on and no sensor uses the FIFO, the DMP
+   interrupts on its events only and the AP can sleep in between. */
+int MPLSensor::dmpEventsWanted()
+{
+    return (isDmpDisplayOrientationOn() && mDmpOrientationEnabled) ||
+           (mFeatureActiveMask & (INV_DMP_PEDOMETER | INV_DMP_TAP | INV_DMP_FLICK));
+}
+
+/* the motion interrupt works on the accel alone, without the DMP */
+int MPLSensor::accelEventsWanted()
+{
+    return dmpEventsWanted() || (mFeatureActiveMask & INV_MOTION_WAKE);
+}
+
+int MPLSensor::enableEventFeature(int feature, int en, int (MPLSensor::*writer)(int))
+{
+    VFUNC_LOG;
+
+    int res = 0;
+    int enabled_sensors = mEnabled;
+    bool fifo_idle;
+
+    if (isMpu3050()) {
+        //DMP and motion interrupt only on MPU6xxx/9xxx
+        return -EINVAL;
+    }
+
+    pthread_mutex_lock(&GlobalHalMutex);
+    openReconfig();
+
+    // on power if not already On
+    onPower(1);
+    // reset master enable
+    res = masterEnable(0);
+    if (res < 0) {
+        goto unlock_res;
+    }
+
+    res = (this->*writer)(en);
+    if (res < 0) {
+        LOGE("HAL:ERR can't %s event feature 0x%x", en ? "enable" : "disable",
+             feature);
+        en = 0;
+    }
+    if (en) {
+        mFeatureActiveMask |= feature;
+    } else {
+        mFeatureActiveMask &= ~feature;
+    }
+
+    fifo_idle = !(mSensorMask &
+            (INV_THREE_AXIS_GYRO
+                | INV_THREE_AXIS_ACCEL
+                | (INV_THREE_AXIS_COMPASS * mCompassSensor->isIntegrated())));
+
+    if (dmpEventsWanted()) {
+        onDMP(1);
+        // with the FIFO idle only DMP events interrupt the AP
+        if (write_sysfs_int(mpu.dmp_event_int_on, fifo_idle) < 0) {
+            LOGE("HAL:ERR can't set DMP event interrupt");
+        }
+    } else if (!checkLPQuaternion()) {
+        onDMP(0);
+    }
+
+    if (accelEventsWanted()) {
+        if (enableAccel(1) < 0 || (!A_ENABLED && turnOffAccelFifo() < 0)) {
+            LOGE("HAL:ERR can't run the accel for the event features");
+        }
+    } else if (!A_ENABLED) {
+        enableAccel(0);
+    }
+
+    if (fifo_idle && !accelEventsWanted() && !checkLPQuaternion()) {
+        res = onPower(0);
+    } else if (masterEnable(1) < 0) {
+        res = -1;
+    }
+
+unlock_res:
+    pthread_mutex_unlock(&GlobalHalMutex);
+    return res;
 }
 
 int MPLSensor::masterEnable(int en)
 {
     VFUNC_LOG;
+
+    if (mReconfigOpen) {
+        mMasterWanted = en;
+        if (en) {
+            /* restarted once, when the reconfiguration is committed */
+            return 0;
+        }
+    }
     return write_sysfs_int(mpu.chip_enable, en);
 }
 
+/* Called with GlobalHalMutex held by every path that bounces the master
+   enable. The first one stops the FIFO, the ones that follow within
+   RECONFIG_WINDOW_NS only rewrite what they change. */
+void MPLSensor::openReconfig()
+{
+    VFUNC_LOG;
+
+    if (!mReconfigOpen) {
+        mReconfigOpen = true;
+        mReconfigDeadline = getTimestamp() + RECONFIG_WINDOW_NS;
+        mMasterWanted = -1;
+        mPowerWanted = -1;
+    }
+}
+
+/* Apply the master enable and power state left by the changes gathered
+   since openReconfig(). Without force this waits for the window to end. */
+int MPLSensor::commitReconfig(bool force)
+{
+    VFUNC_LOG;
+
+    int res = 0;
+
+    pthread_mutex_lock(&GlobalHalMutex);
+    if (mReconfigOpen && (force || getTimestamp() >= mReconfigDeadline)) {
+        int master = mMasterWanted, power = mPowerWanted;
+
+        mReconfigOpen = false;
+        if (power == 0) {
+            res = onPower(0);
+        } else if (master == 1) {
+            res = masterEnable(1);
+        }
+        LOGV_IF(PROCESS_VERBOSE, "HAL:reconfig committed master=%d power=%d",
+                master, power);
+    }
+    pthread_mutex_unlock(&GlobalHalMutex);
+    return res;
+}
+
 int MPLSensor::enableGyro(int en)
 {
     VFUNC_LOG;
@@ -922,6 +1426,11 @@ int MPLSensor::enableGyro(int en)
         write_sysfs_int(mpu.gyro_y_fifo_enable, en);
         res = write_sysfs_int(mpu.gyro_z_fifo_enable, en);
     }
+    // the temperature follows the gyro in and out of the scans
+    if (mTempFifo) {
+        write_sysfs_int(mpu.temp_fifo_enable, en);
+        mTempScans = 0;
+    }
 
     return res;
 }
@@ -960,25 +1469,62 @@ int MPLSensor::enableCompass(int en)
     return res;
 }
 
+/* start the modules the sensors in needed feed and stop the others, so an
+   accel alone doesn't pay for fusion and compass calibration */
+void MPLSensor::updateMplModules(long needed)
+{
+    VFUNC_LOG;
+
+    for (unsigned i = 0; i < sizeof(mplModules) / sizeof(mplModules[0]); i++) {
+        int bit = 1 << i;
+        bool run = needed & mplModules[i].need;
+        inv_error_t result;
+
+        // never enabled on this device
+        if (mplModules[i].feature &&
+                !(mFeatureActiveMask & mplModules[i].feature))
+            continue;
+        if (run == !!(mMplModules & bit))
+            continue;
+        result = run ? mplModules[i].start() : mplModules[i].stop();
+        if (result) {
+            LOGE("HAL:Cannot %s MPL %s", run ? "start" : "stop",
+                 mplModules[i].name);
+            LOG_RESULT_LOCATION(result);
+            continue;
+        }
+        LOGV_IF(PROCESS_VERBOSE, "HAL:MPL %s %s", mplModules[i].name,
+                run ? "started" : "stopped");
+        if (run)
+            mMplModules |= bit;
+        else
+            mMplModules &= ~bit;
+    }
+}
+
 void MPLSensor::computeLocalSensorMask(int enabled_sensors)
 {
     VFUNC_LOG;
 
+    mDmpQuatOnly = isDmpQuatOnly(enabled_sensors);
     do {
         if (LA_ENABLED || GR_ENABLED || RV_ENABLED || O_ENABLED) {
-            LOGV_IF(ENG_VERBOSE, "FUSION ENABLED");
+            LOGV_IF(ENG_VERBOSE, "FUSION ENABLED%s",
+                    mDmpQuatOnly ? " (DMP quaternion only)" : "");
             mLocalSensorMask = ALL_MPL_SENSORS_NP;
             break;
         }
 
-        if(!A_ENABLED && !M_ENABLED && !GY_ENABLED) {
+        if(!A_ENABLED && !M_ENABLED && !GY_ENABLED && !SK_ENABLED &&
+                !GRV_ENABLED) {
             /* Invensense compass cal */
             LOGV_IF(ENG_VERBOSE, "ALL DISABLED");
             mLocalSensorMask = 0;
             break;
         }
 
-        if (GY_ENABLED) {
+        // the game rotation vector fuses gyro and accel, never the compass
+        if (GY_ENABLED || GRV_ENABLED) {
             LOGV_IF(ENG_VERBOSE, "G ENABLED");
             mLocalSensorMask |= INV_THREE_AXIS_GYRO;
         } else {
@@ -986,7 +1532,8 @@ void MPLSensor::computeLocalSensorMask(int enabled_sensors)
             mLocalSensorMask &= ~INV_THREE_AXIS_GYRO;
         }
 
-        if (A_ENABLED) {
+        // the shake detector runs on the accel
+        if (A_ENABLED || SK_ENABLED || GRV_ENABLED) {
             LOGV_IF(ENG_VERBOSE, "A ENABLED");
             mLocalSensorMask |= INV_THREE_AXIS_ACCEL;
         } else {
@@ -1003,6 +1550,10 @@ void MPLSensor::computeLocalSensorMask(int enabled_sensors)
             mLocalSensorMask &= ~INV_THREE_AXIS_COMPASS;
         }
     } while (0);
+
+    updateMplModules(mLocalSensorMask |
+            ((LA_ENABLED || GR_ENABLED || RV_ENABLED || O_ENABLED ||
+              GRV_ENABLED) && !mDmpQuatOnly ? MPL_MODULE_FUSION : 0));
 }
 
 int MPLSensor::enableOneSensor(int en, const char *name, int (MPLSensor::*enabler)(int)) {
@@ -1024,6 +1575,7 @@ int MPLSensor::enableSensors(unsigned long sensors, int en, uint32_t changed) {
     // 4. set master enable (=1)
 
     pthread_mutex_lock(&GlobalHalMutex);
+    openReconfig();
 
     uint32_t all_changeables = (1 << Gyro) | (1 << RawGyro) | (1 << Accelerometer)
             | (1 << MagneticField);
@@ -1070,9 +1622,13 @@ int MPLSensor::enableSensors(unsigned long sensors, int en, uint32_t changed) {
     }
 
     if ( isLowPowerQuatEnabled() ) {
-        // Enable LP Quat
+        // Enable LP Quat, the DMP quaternion needs the gyro
         if ((mEnabled & ((1 << Orientation) | (1 << RotationVector) |
-                (1 << LinearAccel) | (1 << Gravity)))) {
+                (1 << LinearAccel) | (1 << Gravity))
+#ifdef ENABLE_GAME_RV_FEAT
+                || (mEnabled & (1 << GameRotationVector))
+#endif
+                ) && !mGyroParked) {
             if (!(changed & all_integrated_changeables)) {
                 /* ensure power state is on */
                 onPower(1);
@@ -1092,13 +1648,26 @@ int MPLSensor::enableSensors(unsigned long sensors, int en, uint32_t changed) {
         }
     }
 
+    if (mDmpQuatOnly && (changed & all_changeables)) {
+        // the DMP still runs on gyro and accel, only the quaternion is
+        // pushed to the FIFO
+        LOGV_IF(PROCESS_VERBOSE, "HAL:enableSensors - DMP quaternion only");
+        res = turnOffGyroFifo();
+        if (res >= 0)
+            res = turnOffAccelFifo();
+        if (res >= 0)
+            res = enableCompass(0);
+        if(res < 0) {
+            goto unlock_res;
+        }
+    }
+
     if (changed & all_integrated_changeables) {
         if (sensors &
             (INV_THREE_AXIS_GYRO
                 | INV_THREE_AXIS_ACCEL
                 | (INV_THREE_AXIS_COMPASS * mCompassSensor->isIntegrated()))) {
-            if ( isLowPowerQuatEnabled() ||
-                    (isDmpDisplayOrientationOn() && mDmpOrientationEnabled) ) {
+            if (isLowPowerQuatEnabled() || dmpEventsWanted()) {
                 // disable DMP event interrupt only (w/ data interrupt)
                 if (write_sysfs_int(mpu.dmp_event_int_on, 0) < 0) {
                     res = -1;
@@ -1107,9 +1676,10 @@ int MPLSensor::enableSensors(unsigned long sensors, int en, uint32_t changed) {
                 }
             }
 
-            if (isDmpDisplayOrientationOn() && mDmpOrientationEnabled) {
+            if (accelEventsWanted()) {
                 // enable DMP
-                onDMP(1);
+                if (dmpEventsWanted())
+                    onDMP(1);
 
                 res = enableAccel(1);
                 if(res < 0) {
@@ -1129,13 +1699,15 @@ int MPLSensor::enableSensors(unsigned long sensors, int en, uint32_t changed) {
                 goto unlock_res;
             }
         } else { // all sensors idle -> reduce power
-            if (isDmpDisplayOrientationOn() && mDmpOrientationEnabled) {
-                // enable DMP
-                onDMP(1);
-                // enable DMP event interrupt only (no data interrupt)
-                if (write_sysfs_int(mpu.dmp_event_int_on, 1) < 0) {
-                    res = -1;
-                    LOGE("HAL:ERR can't enable DMP event interrupt");
+            if (accelEventsWanted()) {
+                if (dmpEventsWanted()) {
+                    // enable DMP
+                    onDMP(1);
+                    // enable DMP event interrupt only (no data interrupt)
+                    if (write_sysfs_int(mpu.dmp_event_int_on, 1) < 0) {
+                        res = -1;
+                        LOGE("HAL:ERR can't enable DMP event interrupt");
+                    }
                 }
                 res = enableAccel(1);
                 if(res < 0) {
@@ -1250,7 +1822,20 @@ int MPLSensor::rvHandler(sensors_event_t* s)
     VHANDLER_LOG;
     int8_t status;
     int update;
+    if (mDmpQuatOnly) {
+        // six axis, no magnetic heading: keep w positive like the MPL
+        float sign = (mDmpQuat[0] < 0) ? -1.f : 1.f;
+        s->data[0] = sign * mDmpQuat[1];
+        s->data[1] = sign * mDmpQuat[2];
+        s->data[2] = sign * mDmpQuat[3];
+        s->data[3] = sign * mDmpQuat[0];
+        s->data[4] = -1.f;  // heading accuracy unknown
+        s->timestamp = mDmpQuatTimestamp;
+        return 1;
+    }
     update = inv_get_sensor_type_rotation_vector(s->data, &status, &s->timestamp);
+    if (update)
+        smoothRvSwitch(s);
     LOGV_IF(HANDLER_DATA, "HAL:rv data: %+f %+f %+f %+f - %+lld - %d",
             s->data[0], s->data[1], s->data[2], s->data[3], s->timestamp, update);
     return update;
@@ -1273,12 +1858,61 @@ int MPLSensor::gravHandler(sensors_event_t* s)
     VHANDLER_LOG;
     int8_t status;
     int update;
+    if (mDmpQuatOnly) {
+        // world z axis in body frame, same as inv_get_gravity()
+        const float *q = mDmpQuat;
+        s->gyro.v[0] = 2.f * (q[1] * q[3] - q[0] * q[2]) * GRAVITY_EARTH;
+        s->gyro.v[1] = 2.f * (q[2] * q[3] + q[0] * q[1]) * GRAVITY_EARTH;
+        s->gyro.v[2] = (q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3])
+                * GRAVITY_EARTH;
+        s->timestamp = mDmpQuatTimestamp;
+        return 1;
+    }
     update = inv_get_sensor_type_gravity(s->gyro.v, &status, &s->timestamp);
     LOGV_IF(HANDLER_DATA, "HAL:gr data: %+f %+f %+f - %lld - %d",
             s->gyro.v[0], s->gyro.v[1], s->gyro.v[2], s->timestamp, update);
     return update;
 }
 
+int MPLSensor::grvHandler(sensors_event_t* s)
+{
+    VHANDLER_LOG;
+    int update;
+    if (mDmpQuatOnly) {
+        // the DMP quaternion is six axis already
+        float sign = (mDmpQuat[0] < 0) ? -1.f : 1.f;
+        s->data[0] = sign * mDmpQuat[1];
+        s->data[1] = sign * mDmpQuat[2];
+        s->data[2] = sign * mDmpQuat[3];
+        s->data[3] = sign * mDmpQuat[0];
+        s->timestamp = mDmpQuatTimestamp;
+        return 1;
+    }
+    // the MPL keeps the gyro/accel quaternion next to the 9 axis one, made
+    // into a rotation vector here the same way as the DMP one
+    long quat[4];
+    float q[4], norm = 0;
+    update = (inv_get_6axis_quaternion(quat) == INV_SUCCESS);
+    for (int i = 0; update && i < 4; i++) {
+        q[i] = quat[i] * INV_TWO_POWER_NEG_30;
+        norm += q[i] * q[i];
+    }
+    norm = sqrtf(norm);
+    if (norm <= FLT_EPSILON)
+        update = 0;
+    if (update) {
+        float sign = (q[0] < 0) ? -norm : norm;
+        s->data[0] = q[1] / sign;
+        s->data[1] = q[2] / sign;
+        s->data[2] = q[3] / sign;
+        s->data[3] = q[0] / sign;
+        s->timestamp = mSensorTimestamp;
+    }
+    LOGV_IF(HANDLER_DATA, "HAL:grv data: %+f %+f %+f %+f - %+lld - %d",
+            s->data[0], s->data[1], s->data[2], s->data[3], s->timestamp, update);
+    return update;
+}
+
 int MPLSensor::orienHandler(sensors_event_t* s)
 {
     VHANDLER_LOG;
@@ -1290,6 +1924,63 @@ int MPLSensor::orienHandler(sensors_event_t* s)
     return update;
 }
 
+/* reported only when a swing ended on this accel sample, with the number
+   of shakes in it */
+int MPLSensor::shakeHandler(sensors_event_t* s)
+{
+    VHANDLER_LOG;
+    float accel[3];
+    int8_t status;
+    inv_time_t ts;
+
+    if (inv_get_sensor_type_accelerometer(accel, &status, &ts))
+        detectShake(accel, mSensorTimestamp);
+    if (!mShakes)
+        return 0;
+    s->data[0] = mShakes;
+    s->timestamp = mSensorTimestamp;
+    LOGV_IF(HANDLER_DATA, "HAL:shake data: %d - %lld", mShakes, s->timestamp);
+    mShakes = 0;
+    return 1;
+}
+
+/* every enable starts from a still device */
+int MPLSensor::enableShake(int en)
+{
+    VFUNC_LOG;
+
+    mShakes = 0;
+    mShakePeaks = 0;
+    mShakeArmed = true;
+    mShakeLastPeakTs = 0;
+    return 0;
+}
+
+/* accel in m/s^2 */
+void MPLSensor::detectShake(const float *accel, int64_t ts)
+{
+    float g = sqrtf(accel[0] * accel[0] + accel[1] * accel[1] +
+                    accel[2] * accel[2]) / GRAVITY_EARTH;
+    float dev = fabsf(g - 1.0f);
+
+    if (mShakePeaks && ts - mShakeLastPeakTs > SHAKE_GAP_NS) {
+        // the swing is over
+        if (mShakePeaks >= 2) {
+            mShakes = mShakePeaks / 2;
+            LOGV_IF(PROCESS_VERBOSE, "HAL:shake x%d", mShakes);
+        }
+        mShakePeaks = 0;
+        mShakeArmed = true;
+    }
+    if (dev < SHAKE_REARM_G) {
+        mShakeArmed = true;
+    } else if (mShakeArmed && dev > SHAKE_PEAK_G) {
+        mShakeArmed = false;
+        mShakePeaks++;
+        mShakeLastPeakTs = ts;
+    }
+}
+
 int MPLSensor::enable(int32_t handle, int en)
 {
     VFUNC_LOG;
@@ -1311,6 +2002,34 @@ int MPLSensor::enable(int32_t handle, int en)
          */
         mDmpOrientationEnabled = en;
         return 0;
+#ifdef ENABLE_DMP_PEDOMETER_FEAT
+    case ID_SD:
+    case ID_SC: {
+        int bit = 1 << (handle == ID_SD ? StepDetector : StepCounter);
+        int wanted = en ? (mDmpStepEnabled | bit) : (mDmpStepEnabled & ~bit);
+
+        LOGV_IF(PROCESS_VERBOSE, "HAL:enable - sensor %s (handle %d) %s -> %s",
+                handle == ID_SD ? "StepDetector" : "StepCounter", handle,
+                (mDmpStepEnabled & bit ? "en" : "dis"), (en ? "en" : "dis"));
+        // both step sensors share the DMP pedometer
+        if (!wanted != !mDmpStepEnabled) {
+            err = enablePedometer(wanted != 0);
+            if (err < 0)
+                return err;
+        }
+        mDmpStepEnabled = wanted;
+        return 0;
+    }
+#endif
+#ifdef ENABLE_SIGNIFICANT_MOTION_FEAT
+    case ID_SM:
+        LOGV_IF(PROCESS_VERBOSE, "HAL:enable - sensor SignificantMotion (handle %d) %s -> %s",
+                handle, (mFeatureActiveMask & INV_MOTION_WAKE ? "en" : "dis"),
+                (en ? "en" : "dis"));
+        if (!en == !(mFeatureActiveMask & INV_MOTION_WAKE))
+            return 0;
+        return enableSignificantMotion(en);
+#endif
     case ID_A:
         what = Accelerometer;
         sname = "Accelerometer";
@@ -1343,6 +2062,18 @@ int MPLSensor::enable(int32_t handle, int en)
         what = LinearAccel;
         sname = "LinearAccel";
         break;
+#ifdef ENABLE_GAME_RV_FEAT
+    case ID_GRV:
+        what = GameRotationVector;
+        sname = "GameRotationVector";
+        break;
+#endif
+#ifdef ENABLE_SHAKE_FEAT
+    case ID_SK:
+        what = Shake;
+        sname = "Shake";
+        break;
+#endif
     default: //this takes care of all the gestures
         what = handle;
         sname = "Others";
@@ -1368,9 +2099,17 @@ int MPLSensor::enable(int32_t handle, int en)
         uint32_t sensor_type;
         short flags = newState;
         uint32_t lastEnabled = mEnabled, changed = 0;
+        int lastQuatOnly = mDmpQuatOnly;
 
         mEnabled &= ~(1 << what);
         mEnabled |= (uint32_t(flags) << what);
+        mNextEventTs[what] = 0;
+
+        // any change brings a parked gyro back, adaptGyroPower() decides
+        // again with the new set of sensors
+        bool unparked = mGyroParked;
+        setGyroParked(false);
+        mFusionSteadySince = 0;
 
         LOGV_IF(PROCESS_VERBOSE, "HAL:handle = %d", handle);
         LOGV_IF(PROCESS_VERBOSE, "HAL:flags = %d", flags);
@@ -1407,6 +2146,35 @@ int MPLSensor::enable(int32_t handle, int en)
                     }
                 }
                 break;
+#ifdef ENABLE_GAME_RV_FEAT
+            case GameRotationVector:
+                // gyro and accel only, the compass is left as it is.
+                // Nothing changes while 9-axis fusion has them on
+                if (!(mEnabled & ((1 << Orientation) | (1 << RotationVector) |
+                        (1 << LinearAccel) | (1 << Gravity)))) {
+                    changed |= (1 << Gyro) | (1 << Accelerometer);
+                }
+                break;
+#endif
+#ifdef ENABLE_SHAKE_FEAT
+            case Shake:
+                enableShake(en);
+                // unless the accel is on already for itself or fusion
+                if (!(mEnabled & ((1 << Accelerometer) | (1 << Orientation) |
+                        (1 << RotationVector) | (1 << LinearAccel) |
+                        (1 << Gravity)))) {
+                    changed |= (1 << Accelerometer);
+                }
+                break;
+#endif
+        }
+        // entering or leaving DMP quaternion only mode switches the raw
+        // sensor FIFOs and the compass, even with fusion on both sides
+        if (lastQuatOnly != mDmpQuatOnly) {
+            changed |= (1 << Gyro) | (1 << Accelerometer) | (1 << MagneticField);
+        }
+        if (unparked) {
+            changed |= (1 << Gyro);
         }
         LOGV_IF(PROCESS_VERBOSE, "HAL:changed = %d", changed);
         enableSensors(sen_mask, flags, changed);
@@ -1470,6 +2238,18 @@ int MPLSensor::setDelay(int32_t handle, int64_t ns)
             what = LinearAccel;
             sname = "LinearAccel";
             break;
+#ifdef ENABLE_GAME_RV_FEAT
+        case ID_GRV:
+            what = GameRotationVector;
+            sname = "GameRotationVector";
+            break;
+#endif
+#ifdef ENABLE_SHAKE_FEAT
+        case ID_SK:
+            what = Shake;
+            sname = "Shake";
+            break;
+#endif
         default: // this takes care of all the gestures
             what = handle;
             sname = "Others";
@@ -1508,9 +2288,16 @@ int MPLSensor::setDelay(int32_t handle, int64_t ns)
     if (ns < 5000000LL) {
         ns = 5000000LL;
     }
+#ifdef ENABLE_SHAKE_FEAT
+    // a faster accel would only cost power to the shake detector
+    if (what == Shake) {
+        ns = SHAKE_DELAY_NS;
+    }
+#endif
 
     /* store request rate to mDelays arrary for each sensor */
     mDelays[what] = ns;
+    mNextEventTs[what] = 0;
 
     switch (what) {
         case Gyro:
@@ -1539,6 +2326,9 @@ int MPLSensor::setDelay(int32_t handle, int64_t ns)
         case RotationVector:
         case LinearAccel:
         case Gravity:
+#ifdef ENABLE_GAME_RV_FEAT
+        case GameRotationVector:
+#endif
             if (isLowPowerQuatEnabled()) {
                 LOGV_IF(PROCESS_VERBOSE, "HAL:need to update delay due to LPQ");
                 break;
@@ -1568,8 +2358,17 @@ int MPLSensor::update_delay() {
     pthread_mutex_lock(&GlobalHalMutex);
     if (mEnabled) {
         int64_t wanted = 1000000000;
+
+        openReconfig();
         int64_t wanted_3rd_party_sensor = 1000000000;
 
+        // any new request starts back from the full compass rate
+        if (mCompassSlow) {
+            mCompassSensor->setDelay(ID_M, mCompassFastDelay);
+            mCompassSlow = 0;
+        }
+        mCompassSettledTs = 0;
+
         // Sequence to change sensor's FIFO rate
         // 1. enable Power state
         // 2. reset master enable
@@ -1592,6 +2391,9 @@ int MPLSensor::update_delay() {
 
         // same delay for 3rd party Accel or Compass
         wanted_3rd_party_sensor = wanted;
+        // slower sensors are decimated down from this rate
+        mHwDelay = wanted;
+        resetOdr(wanted);
 
         /* mpl rate in us in future maybe different for
            gyro vs compass vs accel */
@@ -1618,7 +2420,8 @@ int MPLSensor::update_delay() {
 
         int enabled_sensors = mEnabled;
         int tempFd = -1;
-        if (LA_ENABLED || GR_ENABLED || RV_ENABLED || O_ENABLED) {
+        if (LA_ENABLED || GR_ENABLED || RV_ENABLED || O_ENABLED ||
+                GRV_ENABLED) {
             if (isLowPowerQuatEnabled() ||
                     (isDmpDisplayOrientationOn() && mDmpOrientationEnabled)) {
                 bool setDMPrate= 0;
@@ -1659,7 +2462,9 @@ int MPLSensor::update_delay() {
                 LOGE_IF(res < 0, "HAL:ACCEL update delay error");
             }
 
-            if (!mCompassSensor->isIntegrated()) {
+            // the game rotation vector alone leaves the compass alone
+            if (!mCompassSensor->isIntegrated() &&
+                    (mLocalSensorMask & INV_THREE_AXIS_COMPASS)) {
                 LOGV_IF(PROCESS_VERBOSE, "HAL:Ext compass rate %.2f Hz", 1000000000.f / wanted_3rd_party_sensor);
                 mCompassSensor->setDelay(ID_M, wanted_3rd_party_sensor);
                 got = mCompassSensor->getDelay(ID_M);
@@ -1684,15 +2489,21 @@ int MPLSensor::update_delay() {
                 LOGE_IF(res < 0, "HAL:GYRO update delay error");
             }
 
-            if (A_ENABLED) { /* else if because there is only 1 fifo rate for MPUxxxx */
-                if (GY_ENABLED && mDelays[Gyro] < mDelays[Accelerometer]) {
+            if (A_ENABLED || SK_ENABLED) { /* else if because there is only 1 fifo rate for MPUxxxx */
+                int64_t accelDelay = mDelays[Accelerometer];
+#ifdef ENABLE_SHAKE_FEAT
+                if (SK_ENABLED && (!A_ENABLED || mDelays[Shake] < accelDelay)) {
+                    accelDelay = mDelays[Shake];
+                }
+#endif
+                if (GY_ENABLED && mDelays[Gyro] < accelDelay) {
                     wanted = mDelays[Gyro];
                 }
-                else if (GY_ENABLED && mDelays[RawGyro] < mDelays[Accelerometer]) {
+                else if (GY_ENABLED && mDelays[RawGyro] < accelDelay) {
                     wanted = mDelays[RawGyro];
 
                 } else {
-                    wanted = mDelays[Accelerometer];
+                    wanted = accelDelay;
                 }
 
                 if (isDmpDisplayOrientationOn() && mDmpOrientationEnabled) {
@@ -1792,6 +2603,7 @@ int MPLSensor::readAccelEvents(sensors_event_t* data, int count)
             done = 1;
             if (mLocalSensorMask & INV_THREE_AXIS_ACCEL) {
                 inv_build_accel(mCachedAccelData, 0, getTimestamp());
+                mNewDataMode |= INV_ACCEL_NEW;
             }
         } else {
             LOGE("HAL:AccelSensor: unknown event (type=%d, code=%d)",
@@ -1815,7 +2627,29 @@ int MPLSensor::executeOnData(sensors_event_t* data, int count)
 {
     VFUNC_LOG;
 
-    inv_execute_on_data();
+    // inputs built since the last call, what inv_execute_on_data() runs on
+    int mode = mNewDataMode;
+    mNewDataMode = 0;
+
+    if (mDmpQuatOnly) {
+        // only the DMP quaternion came in, rvHandler and gravHandler use it
+        // as is
+        mode &= INV_QUAT_NEW;
+    } else if (skipFusion()) {
+        // still and accurate, the last results stand, nothing to send
+        mode = 0;
+    } else {
+        inv_execute_on_data();
+        if (mode & INV_MAG_NEW) {
+#ifdef COMPASS_YAS53x
+            checkCompassWarmStart();
+#endif
+            adaptCompassRate();
+        }
+        if (mode & INV_ACCEL_NEW)
+            adaptGyroPower();
+        updateFusionGate();
+    }
 
     int numEventReceived = 0;
 
@@ -1836,25 +2670,277 @@ int MPLSensor::executeOnData(sensors_event_t* data, int count)
         }
     }
 
-    // load up virtual sensors
+    // load up the sensors fed by the inputs that changed, straight into
+    // the caller's buffer; mPendingEvents holds the event headers and takes
+    // the output once the buffer is full
     for (int i = 0; i < numSensors; i++) {
         int update;
-        if (mEnabled & (1 << i)) {
-            update = CALL_MEMBER_FN(this, mHandlers[i])(mPendingEvents + i);
-            mPendingMask |= (1 << i);
-
-            if (update && (count > 0)) {
-                *data++ = mPendingEvents[i];
-                count--;
-                numEventReceived++;
-            }
+        sensors_event_t *s;
+        if (!(mEnabled & (1 << i)) || !(mode & sSensorInputs[i]))
+            continue;
+
+        s = mPendingEvents + i;
+        if (count > 0) {
+            s = data;
+            s->version = mPendingEvents[i].version;
+            s->sensor = mPendingEvents[i].sensor;
+            s->type = mPendingEvents[i].type;
+            s->reserved0 = 0;
+        }
+        update = CALL_MEMBER_FN(this, mHandlers[i])(s);
+        mPendingMask |= (1 << i);
+        if (update && decimate(i, s->timestamp))
+            update = 0;
+
+        if (update && (count > 0)) {
+            data++;
+            count--;
+            numEventReceived++;
         }
     }
 
     return numEventReceived;
 }
 
-// collect data for MPL (but NOT sensor service currently), from driver layer
+/* with only fusion using the compass, run it at COMPASS_SETTLED_RATE while
+   its calibration is at full accuracy and the field undisturbed, back at
+   the requested rate as soon as either changes */
+void MPLSensor::adaptCompassRate()
+{
+#ifdef ENABLE_ADAPTIVE_COMPASS_RATE
+    int enabled_sensors = mEnabled;
+    int settled;
+
+    if (M_ENABLED || !(LA_ENABLED || GR_ENABLED || RV_ENABLED || O_ENABLED))
+        return;
+
+    settled = inv_get_mag_accuracy() >= 3 && !inv_get_compass_disturbance();
+    if (!settled) {
+        mCompassSettledTs = 0;
+    } else if (!mCompassSettledTs) {
+        mCompassSettledTs = mCompassTimestamp;
+        settled = 0;
+    } else if (mCompassTimestamp - mCompassSettledTs < COMPASS_SETTLE_NS) {
+        settled = 0;
+    }
+    if (settled == mCompassSlow)
+        return;
+
+    pthread_mutex_lock(&GlobalHalMutex);
+    if (settled) {
+        mCompassFastDelay = mCompassSensor->getDelay(ID_M);
+        if (mCompassFastDelay < COMPASS_SETTLED_RATE)
+            mCompassSensor->setDelay(ID_M, COMPASS_SETTLED_RATE);
+    } else {
+        mCompassSensor->setDelay(ID_M, mCompassFastDelay);
+    }
+    inv_set_compass_sample_rate(mCompassSensor->getDelay(ID_M) / 1000);
+    mCompassSlow = settled;
+    pthread_mutex_unlock(&GlobalHalMutex);
+    LOGV_IF(PROCESS_VERBOSE, "HAL:compass %s, rate %.2f Hz",
+            settled ? "settled" : "disturbed",
+            1000000000.f / mCompassSensor->getDelay(ID_M));
+#endif
+}
+
+/* with the gyro only feeding fusion, power it down once fast no motion has
+   reported the device still for GYRO_PARK_NS. The MPL goes on with accel
+   and compass (no gyro fusion). Its no motion result is not trusted to
+   come back without the gyro, so the accel, which is in the FIFO for the
+   fusion anyway, brings the gyro back as soon as it moves off the
+   parked attitude */
+void MPLSensor::adaptGyroPower()
+{
+#ifdef ENABLE_GYRO_PARKING
+    int enabled_sensors = mEnabled;
+    unsigned int cntr;
+    long accel[3];
+    int8_t accuracy;
+    inv_time_t ts;
+    bool park;
+
+    // enable() brings the gyro back when any of these change, the game
+    // rotation vector has nothing but the gyro for its heading
+    if (GY_ENABLED || GRV_ENABLED || mDmpQuatOnly ||
+            !(LA_ENABLED || GR_ENABLED || RV_ENABLED || O_ENABLED))
+        return;
+
+    inv_get_accel_set(accel, &accuracy, &ts);
+    if (mGyroParked) {
+        park = true;
+        for (int i = 0; i < 3; i++) {
+            if (labs(accel[i] - mParkAccel[i]) > GYRO_WAKE_ACCEL_DELTA)
+                park = false;
+        }
+    } else if (inv_get_motion_state(&cntr) != INV_NO_MOTION) {
+        mNoMotionSince = 0;
+        park = false;
+    } else {
+        if (!mNoMotionSince)
+            mNoMotionSince = mSensorTimestamp;
+        park = mSensorTimestamp - mNoMotionSince >= GYRO_PARK_NS;
+    }
+    if (park == mGyroParked)
+        return;
+
+    if (park)
+        memcpy(mParkAccel, accel, sizeof(mParkAccel));
+    setGyroParked(park);
+    mSensorMask = mLocalSensorMask & mMasterSensorMask;
+    enableSensors(mSensorMask, !park, 1 << Gyro);
+    LOGV_IF(PROCESS_VERBOSE, "HAL:gyro %s", park ? "parked, device still" : "back on motion");
+#endif
+}
+
+/* true for the scans the MPL is not run on: while the fusion is steady
+   only one scan in FUSION_GATE_DIVISOR goes through inv_execute_on_data().
+   The accel is checked on every scan, it is in the data builder already */
+bool MPLSensor::skipFusion()
+{
+#ifdef ENABLE_FUSION_GATING
+    long accel[3];
+    int8_t accuracy;
+    inv_time_t ts;
+
+    if (!mFusionSteadySince ||
+            mSensorTimestamp - mFusionSteadySince < FUSION_STEADY_NS) {
+        mFusionSkipped = 0;
+        return false;
+    }
+
+    inv_get_accel_set(accel, &accuracy, &ts);
+    for (int i = 0; i < 3; i++) {
+        if (labs(accel[i] - mSteadyAccel[i]) > FUSION_WAKE_ACCEL_DELTA) {
+            LOGV_IF(PROCESS_VERBOSE, "HAL:fusion back to full rate, moved");
+            mFusionSteadySince = 0;
+            mFusionSkipped = 0;
+            return false;
+        }
+    }
+
+    if (++mFusionSkipped < FUSION_GATE_DIVISOR)
+        return true;
+    mFusionSkipped = 0;
+#endif
+    return false;
+}
+
+/* after each fusion run: steady while only fused sensors are enabled, no
+   motion is reported and the accuracy monitor has the 9-axis quaternion
+   at full accuracy. Any of these dropping brings the full rate back */
+void MPLSensor::updateFusionGate()
+{
+#ifdef ENABLE_FUSION_GATING
+    int enabled_sensors = mEnabled;
+    unsigned int cntr;
+    int8_t accuracy;
+    inv_time_t ts;
+    bool steady;
+
+    steady = !(A_ENABLED || GY_ENABLED || M_ENABLED || SK_ENABLED) &&
+            (LA_ENABLED || GR_ENABLED || RV_ENABLED || O_ENABLED) &&
+            inv_get_motion_state(&cntr) == INV_NO_MOTION &&
+            get_accuracy_accuracy(TYPE_NAV_QUAT) >= 3;
+    if (!steady) {
+        if (mFusionSteadySince)
+            LOGV_IF(PROCESS_VERBOSE, "HAL:fusion back to full rate");
+        mFusionSteadySince = 0;
+        return;
+    }
+
+    if (!mFusionSteadySince)
+        mFusionSteadySince = mSensorTimestamp;
+    inv_get_accel_set(mSteadyAccel, &accuracy, &ts);
+#endif
+}
+
+/* the gyro bit of mMasterSensorMask is the parked state, the rv gets
+   smoothed over the fusion switch */
+void MPLSensor::setGyroParked(bool parked)
+{
+    mNoMotionSince = 0;
+    if (parked == mGyroParked)
+        return;
+    mGyroParked = parked;
+    if (parked)
+        mMasterSensorMask &= ~INV_THREE_AXIS_GYRO;
+    else
+        mMasterSensorMask |= INV_THREE_AXIS_GYRO;
+    mRvSwitched = true;
+}
+
+/* take the step between the fusion before and after a gyro switch out of
+   the rotation vector and fade it over RV_BLEND_NS, so the rv does not
+   jump when the gyro goes off or comes back */
+void MPLSensor::smoothRvSwitch(sensors_event_t *s)
+{
+    float q[4] = { s->data[3], s->data[0], s->data[1], s->data[2] };
+    float inv[4], off[4], out[4];
+
+    if (mRvSwitched) {
+        mRvSwitched = false;
+        if (mRvLastTs && s->timestamp - mRvLastTs < RV_BLEND_NS) {
+            inv_q_invertf(q, inv);
+            inv_q_multf(mRvLast, inv, mRvOffset);
+            if (mRvOffset[0] < 0) {
+                for (int i = 0; i < 4; i++)
+                    mRvOffset[i] = -mRvOffset[i];
+            }
+            mRvBlendStart = s->timestamp;
+        }
+    }
+    if (mRvBlendStart) {
+        int64_t dt = s->timestamp - mRvBlendStart;
+        if (dt < 0 || dt >= RV_BLEND_NS) {
+            mRvBlendStart = 0;
+        } else {
+            // nlerp from the full step down to identity
+            float a = 1.f - (float)dt / RV_BLEND_NS;
+            off[0] = 1.f - a + a * mRvOffset[0];
+            off[1] = a * mRvOffset[1];
+            off[2] = a * mRvOffset[2];
+            off[3] = a * mRvOffset[3];
+            inv_q_normalizef(off);
+            inv_q_multf(off, q, out);
+            memcpy(q, out, sizeof(q));
+        }
+    }
+    memcpy(mRvLast, q, sizeof(mRvLast));
+    mRvLastTs = s->timestamp;
+
+    // w stays positive like the MPL output
+    float sign = (q[0] < 0) ? -1.f : 1.f;
+    s->data[0] = sign * q[1];
+    s->data[1] = sign * q[2];
+    s->data[2] = sign * q[3];
+    s->data[3] = sign * q[0];
+}
+
+/* the MPU runs at the fastest rate requested by any enabled sensor, every
+   sensor asking for less only reports on its own period. The periods are
+   kept on a grid from the first event so a sensor does not drift against
+   the sample timestamps, half a hardware period of jitter is allowed.
+   Returns true when the event at ts has to be dropped */
+bool MPLSensor::decimate(int i, int64_t ts)
+{
+#ifdef ENABLE_SHAKE_FEAT
+    // only sent on detection, nothing to thin out
+    if (i == Shake)
+        return false;
+#endif
+    if (mDelays[i] <= mHwDelay)
+        return false;
+    if (ts < mNextEventTs[i] - mHwDelay / 2)
+        return true;
+    mNextEventTs[i] += mDelays[i];
+    if (mNextEventTs[i] <= ts) {
+        // first event since enable or a gap in the data, restart the grid
+        mNextEventTs[i] = ts + mDelays[i];
+    }
+    return false;
+}
+
+// collect data for MPL (but NOT sensor service currently), from driver layer
 /* TODO: FIX! data and count are not used, results is hardcoded to 0 */
 /* TODO: This should probably be called "void cacheEvents(void)"
  * And executeOnData() should be int readEvents(data,count)
@@ -1863,11 +2949,20 @@ int MPLSensor::readEvents(sensors_event_t *data, int count) {
 
 
     int lp_quaternion_on = 0, nbyte;
+    long localMask = fifoSensorMask();
     int i, nb, mask = 0, numEventReceived = 0,
-        sensors = ((mLocalSensorMask & INV_THREE_AXIS_GYRO)? 1 : 0) +
-            ((mLocalSensorMask & INV_THREE_AXIS_ACCEL)? 1 : 0) +
-            (((mLocalSensorMask & INV_THREE_AXIS_COMPASS) && mCompassSensor->isIntegrated())? 1 : 0);
+        sensors = ((localMask & INV_THREE_AXIS_GYRO)? 1 : 0) +
+            ((localMask & INV_THREE_AXIS_ACCEL)? 1 : 0) +
+            (((localMask & INV_THREE_AXIS_COMPASS) && mCompassSensor->isIntegrated())? 1 : 0);
     char *rdata = mIIOBuffer;
+    struct iio_sample sample;
+
+    if (mIngestRunning) {
+        // the ingest thread owns iio_fd, take the oldest scan it parsed
+        if (mSampleRing.pop(&sample))
+            buildSample(&sample);
+        return numEventReceived;
+    }
 
     nbyte= (8 * sensors + 8) * 1;
 
@@ -1881,11 +2976,11 @@ int MPLSensor::readEvents(sensors_event_t *data, int count) {
     // pthread_mutex_lock(&mMplMutex);
     // pthread_mutex_lock(&mHALMutex);
 
-    ssize_t rsize = read(iio_fd, rdata, nbyte);
-    if (sensors == 0) {
-        // read(iio_fd, rdata, nbyte);
-        rsize = read(iio_fd, rdata, sizeof(mIIOBuffer));
-    }
+    // with nothing scanned the whole ring is emptied in the same read
+    int scanned = sensors || lp_quaternion_on;
+    ssize_t rsize = read(iio_fd, rdata, scanned ? nbyte : sizeof(mIIOBuffer));
+    if (scanned)
+        countRead(rsize, nbyte);
 
 #ifdef TESTING
     LOGI("get one sample of IIO data with size: %d", rsize);
@@ -1915,51 +3010,114 @@ int MPLSensor::readEvents(sensors_event_t *data, int count) {
         return -1;
     }
 
-    if (isLowPowerQuatEnabled() && lp_quaternion_on) {
+    parseScan(rdata, sensors, lp_quaternion_on, localMask, &sample);
+    buildSample(&sample);
 
+    // pthread_mutex_unlock(&mMplMutex);
+    // pthread_mutex_unlock(&mHALMutex);
+
+    return numEventReceived;
+}
+
+/* split one IIO scan (optional quaternion, gyro, accel, compass, timestamp)
+   into its fields, localMask is the sensor mask the scan was captured with */
+void MPLSensor::parseScan(const char *rdata, int sensors, int lp_quaternion_on,
+                          long localMask, struct iio_sample *s)
+{
+    int i;
+
+    s->quatOn = isLowPowerQuatEnabled() && lp_quaternion_on;
+    if (s->quatOn) {
         for (i=0; i< 4; i++) {
-            mCachedQuaternionData[i]= *(long*)rdata;
+            s->quat[i]= *(long*)rdata;
             rdata += sizeof(long);
         }
     }
 
+    s->present = localMask & (INV_THREE_AXIS_GYRO | INV_THREE_AXIS_ACCEL);
+    if (mCompassSensor->isIntegrated())
+        s->present |= localMask & INV_THREE_AXIS_COMPASS;
+
     for (i = 0; i < 3; i++) {
-        if (mLocalSensorMask & INV_THREE_AXIS_GYRO) {
-            mCachedGyroData[i] = *((short *) (rdata + i * 2));
+        if (s->present & INV_THREE_AXIS_GYRO) {
+            s->gyro[i] = *((short *) (rdata + i * 2));
         }
-        if (mLocalSensorMask & INV_THREE_AXIS_ACCEL) {
-            mCachedAccelData[i] = *((short *) (rdata + i * 2 +
-                ((mLocalSensorMask & INV_THREE_AXIS_GYRO)? 6: 0)));
+        if (s->present & INV_THREE_AXIS_ACCEL) {
+            s->accel[i] = *((short *) (rdata + i * 2 +
+                ((s->present & INV_THREE_AXIS_GYRO)? 6: 0)));
         }
-        if ((mLocalSensorMask & INV_THREE_AXIS_COMPASS) && mCompassSensor->isIntegrated()) {
-            mCachedCompassData[i] = *((short *) (rdata + i * 2 + 6 * (sensors - 1)));
+        if (s->present & INV_THREE_AXIS_COMPASS) {
+            s->compass[i] = *((short *) (rdata + i * 2 + 6 * (sensors - 1)));
         }
     }
 
-    mask |= (((mLocalSensorMask & INV_THREE_AXIS_GYRO)? 1 << Gyro: 0) +
-        ((mLocalSensorMask & INV_THREE_AXIS_ACCEL)? 1 << Accelerometer: 0));
-    if ((mLocalSensorMask & INV_THREE_AXIS_COMPASS) && mCompassSensor->isIntegrated() &&
+    s->timestamp = *((long long *) (rdata + 8 * sensors));
+    s->tempOn = 0;
+
+    // the temperature is the last channel before the timestamp, it takes
+    // what was padding, so the scan size is unchanged
+    if (mTempFifo && (s->present & INV_THREE_AXIS_GYRO) &&
+            ++mTempScans >= mTempDecimation) {
+        mTempScans = 0;
+        s->temperature[0] = *((short *) (rdata + 6 * sensors));
+        s->temperature[1] = s->timestamp;
+        s->tempOn = 1;
+    }
+}
+
+/* hand one parsed scan to the MPL builders */
+void MPLSensor::buildSample(const struct iio_sample *s)
+{
+    int i, mask = 0;
+
+    if (s->quatOn) {
+        for (i=0; i< 4; i++)
+            mCachedQuaternionData[i] = s->quat[i];
+    }
+
+    for (i = 0; i < 3; i++) {
+        if (s->present & INV_THREE_AXIS_GYRO)
+            mCachedGyroData[i] = s->gyro[i];
+        if (s->present & INV_THREE_AXIS_ACCEL)
+            mCachedAccelData[i] = s->accel[i];
+        if (s->present & INV_THREE_AXIS_COMPASS)
+            mCachedCompassData[i] = s->compass[i];
+    }
+
+    mask |= (((s->present & INV_THREE_AXIS_GYRO)? 1 << Gyro: 0) +
+        ((s->present & INV_THREE_AXIS_ACCEL)? 1 << Accelerometer: 0));
+    if ((s->present & INV_THREE_AXIS_COMPASS) &&
             (mCachedCompassData[0] != 0 || mCachedCompassData[1] != 0 || mCachedCompassData[0] != 0)) {
         mask |= 1 << MagneticField;
     }
 
-    mSensorTimestamp = *((long long *) (rdata + 8 * sensors));
+    mSensorTimestamp = s->timestamp;
     if (mCompassSensor->isIntegrated()) {
         mCompassTimestamp = mSensorTimestamp;
     }
+    if (mask & ((1 << Gyro) | (1 << Accelerometer)))
+        trackOdr(mSensorTimestamp);
 
     if (mask & (1 << Gyro)) {
         // send down temperature every 0.5 seconds
         // with timestamp measured in "driver" layer
-        if(mSensorTimestamp - mTempCurrentTime >= 500000000LL) {
+        long long temperature[2];
+        int tempOn = 0;
+        if (s->tempOn) {
+            temperature[0] = s->temperature[0];
+            temperature[1] = s->temperature[1];
+            tempOn = 1;
+        } else if (!mIngestRunning && !mTempFifo &&
+                   mSensorTimestamp - mTempCurrentTime >= 500000000LL) {
             mTempCurrentTime = mSensorTimestamp;
-            long long temperature[2];
-            if(inv_read_temperature(temperature) == 0) {
-                LOGV_IF(INPUT_DATA,
-                        "HAL:inv_read_temperature = %lld, timestamp= %lld",
-                        temperature[0], temperature[1]);
-                inv_build_temp(temperature[0], temperature[1]);
-            }
+            tempOn = (inv_read_temperature(temperature) == 0);
+        }
+        if (tempOn) {
+            LOGV_IF(INPUT_DATA,
+                    "HAL:inv_read_temperature = %lld, timestamp= %lld",
+                    temperature[0], temperature[1]);
+            inv_build_temp(temperature[0], temperature[1]);
+            mNewDataMode |= INV_TEMP_NEW;
 #ifdef TESTING
             long bias[3], temp, temp_slope[3];
             inv_get_gyro_bias(bias, &temp);
@@ -1982,8 +3140,9 @@ int MPLSensor::readEvents(sensors_event_t *data, int count) {
         mPendingMask |= 1 << Gyro;
         mPendingMask |= 1 << RawGyro;
 
-        if (mLocalSensorMask & INV_THREE_AXIS_GYRO) {
+        if (s->present & INV_THREE_AXIS_GYRO) {
             inv_build_gyro(mCachedGyroData, mSensorTimestamp);
+            mNewDataMode |= INV_GYRO_NEW;
             LOGV_IF(INPUT_DATA,
                     "HAL:inv_build_gyro: %+8d %+8d %+8d - %lld",
                     mCachedGyroData[0], mCachedGyroData[1],
@@ -1993,8 +3152,9 @@ int MPLSensor::readEvents(sensors_event_t *data, int count) {
 
     if (mask & (1 << Accelerometer)) {
         mPendingMask |= 1 << Accelerometer;
-        if (mLocalSensorMask & INV_THREE_AXIS_ACCEL) {
+        if (s->present & INV_THREE_AXIS_ACCEL) {
             inv_build_accel(mCachedAccelData, 0, mSensorTimestamp);
+            mNewDataMode |= INV_ACCEL_NEW;
              LOGV_IF(INPUT_DATA,
                     "HAL:inv_build_accel: %+8ld %+8ld %+8ld - %lld",
                     mCachedAccelData[0], mCachedAccelData[1],
@@ -2008,30 +3168,389 @@ int MPLSensor::readEvents(sensors_event_t *data, int count) {
             status = mCompassSensor->getAccuracy();
             status |= INV_CALIBRATED;
         }
-        if (mLocalSensorMask & INV_THREE_AXIS_COMPASS) {
+        if (s->present & INV_THREE_AXIS_COMPASS) {
             inv_build_compass(mCachedCompassData, status,
                               mCompassTimestamp);
+            mNewDataMode |= INV_MAG_NEW;
             LOGV_IF(INPUT_DATA, "HAL:inv_build_compass: %+8ld %+8ld %+8ld - %lld",
                     mCachedCompassData[0], mCachedCompassData[1],
                     mCachedCompassData[2], mCompassTimestamp);
         }
     }
 
-    if (isLowPowerQuatEnabled() && lp_quaternion_on) {
+    if (!mCompassQueue.empty())
+        mergeCompass(mSensorTimestamp);
+
+    if (s->quatOn && mDmpQuatOnly && !s->present) {
+        // DMP quaternion only: rv and gravity come from it directly, the
+        // MPL does not run
+        float norm = 0;
+        for (i = 0; i < 4; i++) {
+            mDmpQuat[i] = mCachedQuaternionData[i] * INV_TWO_POWER_NEG_30;
+            norm += mDmpQuat[i] * mDmpQuat[i];
+        }
+        norm = sqrtf(norm);
+        if (norm > FLT_EPSILON) {
+            for (i = 0; i < 4; i++)
+                mDmpQuat[i] /= norm;
+            mDmpQuatTimestamp = mSensorTimestamp;
+            mNewDataMode |= INV_QUAT_NEW;
+        }
+    } else if (s->quatOn) {
 
         inv_build_quat(mCachedQuaternionData, 32 /*default 32 for now (16/32bits)*/, mSensorTimestamp);
+        mNewDataMode |= INV_QUAT_NEW;
         LOGV_IF(INPUT_DATA, "HAL:inv_build_quat: %+8ld %+8ld %+8ld %+8ld - %lld",
                     mCachedQuaternionData[0], mCachedQuaternionData[1],
                     mCachedQuaternionData[2], mCachedQuaternionData[3], mSensorTimestamp);
     }
+}
 
-    // pthread_mutex_unlock(&mMplMutex);
-    // pthread_mutex_unlock(&mHALMutex);
+
+/* start measuring the FIFO rate again against a new nominal period */
+void MPLSensor::resetOdr(int64_t nominal)
+{
+    mOdrNominal = nominal;
+    mOdrPushed = nominal;
+    mOdrInterval = 0;
+    mOdrLastTs = 0;
+    mOdrSamples = 0;
+}
+
+/* The MPU runs off its own oscillator, and with the DMP or a 3rd party
+   accel in the path the FIFO rate is only close to the one asked for.
+   The MPL integrates with the rate it is given, so follow the scan
+   timestamps and hand it the rate actually seen once that drifts away. */
+void MPLSensor::trackOdr(int64_t ts)
+{
+    int64_t dt = ts - mOdrLastTs;
+    bool counted = mOdrLastTs > 0 && mOdrNominal > 0 &&
+                   dt > mOdrNominal / 2 && dt < mOdrNominal * 2;
+
+    mOdrLastTs = ts;
+    if (!counted)
+        return;
+
+    if (mOdrInterval == 0)
+        mOdrInterval = dt;
+    else
+        mOdrInterval += (dt - mOdrInterval) >> ODR_SMOOTHING_SHIFT;
+    if (++mOdrSamples < ODR_MIN_SAMPLES)
+        return;
+
+    int64_t drift = mOdrInterval - mOdrPushed;
+    if (drift < 0)
+        drift = -drift;
+    if (drift * 100 <= mOdrPushed * ODR_TOLERANCE_PERCENT)
+        return;
+
+    int rateInus = (int)(mOdrInterval / 1000LL);
+    LOGV_IF(PROCESS_VERBOSE, "HAL:measured ODR %lld ns (nominal %lld ns), "
+            "mpl rate: %d us", mOdrInterval, mOdrNominal, rateInus);
+    inv_set_gyro_sample_rate(rateInus);
+    inv_set_accel_sample_rate(rateInus);
+    if (mCompassSensor->isIntegrated())
+        inv_set_compass_sample_rate(rateInus);
+    mOdrPushed = mOdrInterval;
+}
+
+/* The driver stamps the scans it pushes on each FIFO interrupt with the
+   interrupt time, so a batch drained in one read can carry the same
+   timestamp on every scan. In that case only the last one is trusted and
+   the others are spread back from it at the FIFO period, measured since
+   the previous batch. Scans with their own timestamps are left alone. */
+void MPLSensor::alignScanTimestamps(char *buf, int samples, int nbyte)
+{
+    int64_t *first, *last, period;
+    int i;
+
+    if (samples <= 0)
+        return;
+    first = (int64_t *) (buf + nbyte - 8);
+    last = (int64_t *) (buf + samples * nbyte - 8);
+
+    if (samples > 1 && mHwDelay > 0 &&
+            *last - *first < (samples - 1) * (mHwDelay / 2)) {
+        period = mHwDelay;
+        if (mLastScanTs > 0 && *last > mLastScanTs) {
+            // after a gap keep the configured period, otherwise never
+            // spread back past the previous batch
+            int64_t measured = (*last - mLastScanTs) / samples;
+            if (measured < mHwDelay * 2)
+                period = measured;
+        }
+        for (i = 0; i < samples - 1; i++) {
+            int64_t *ts = (int64_t *) (buf + (i + 1) * nbyte - 8);
+            *ts = *last - (samples - 1 - i) * period;
+        }
+        LOGV_IF(INPUT_DATA, "HAL:%d scans stamped %lld, spread at %lld ns",
+                samples, *last, period);
+    }
+    mLastScanTs = *last;
+}
+
+/* bytes taken by one IIO scan for the given sensor mask */
+int MPLSensor::scanLayout(long localMask, int *sensors, int *lp_quaternion_on)
+{
+    int nbyte;
+
+    *sensors = ((localMask & INV_THREE_AXIS_GYRO)? 1 : 0) +
+            ((localMask & INV_THREE_AXIS_ACCEL)? 1 : 0) +
+            (((localMask & INV_THREE_AXIS_COMPASS) && mCompassSensor->isIntegrated())? 1 : 0);
+    nbyte = 8 * *sensors + 8;
+
+    *lp_quaternion_on = 0;
+    if (isLowPowerQuatEnabled()) {
+        *lp_quaternion_on = checkLPQuaternion();
+        if (*lp_quaternion_on) {
+            nbyte += sizeof(mCachedQuaternionData);
+        }
+    }
+    return nbyte;
+}
+
+/* batched variant of readEvents + executeOnData: runs every scan waiting
+   for the MPL through fusion and emits its events. With the ingest thread
+   the scans come from the sample ring, otherwise they are drained from the
+   IIO ring with one read() */
+int MPLSensor::readBatchedEvents(sensors_event_t *data, int count)
+{
+    VHANDLER_LOG;
+
+    int lp_quaternion_on = 0, nbyte, nb, numEventReceived = 0, sensors;
+    long localMask;
+    struct iio_sample sample;
+
+    if (mIngestRunning) {
+        char msg[16];
+
+        // clear the wakeup before popping, a scan pushed after this raises
+        // another one
+        while (read(mIngestPipe[0], msg, sizeof(msg)) > 0)
+            ;
+        while (count > 0 && mSampleRing.pop(&sample)) {
+            buildSample(&sample);
+            // fusion has to see every scan even when data is full
+            nb = executeOnData(data, count);
+            data += nb;
+            count -= nb;
+            numEventReceived += nb;
+        }
+        return numEventReceived;
+    }
+
+    localMask = fifoSensorMask();
+    nbyte = scanLayout(localMask, &sensors, &lp_quaternion_on);
+    if (sensors == 0 && !lp_quaternion_on) {
+        // nothing is scanned, readEvents only flushes the ring
+        readEvents(NULL, count);
+        return executeOnData(data, count);
+    }
+
+    // every scan can update each enabled sensor once, leave room for all
+    int enabled = __builtin_popcount(mEnabled);
+    int samples = (enabled > 0)? count / enabled : count;
+    if (samples < 1)
+        samples = 1;
+    if (samples > (int) (sizeof(mIIOBuffer) / nbyte))
+        samples = sizeof(mIIOBuffer) / nbyte;
+
+    ssize_t rsize = read(iio_fd, mIIOBuffer, samples * nbyte);
+    countRead(rsize, nbyte);
+    if (rsize < (nbyte - 8)) {
+        LOGE("HAL:ERR Full data packet was not read. rsize=%ld nbyte=%d sensors=%d errno=%d(%s)",
+             rsize, nbyte, sensors, errno, strerror(errno));
+        return -1;
+    }
+
+    // the ring hands out whole scans, readEvents also takes one that came
+    // without its timestamp
+    samples = rsize / nbyte;
+    alignScanTimestamps(mIIOBuffer, samples, nbyte);
+    if (samples == 0)
+        samples = 1;
+    LOGV_IF(INPUT_DATA, "HAL:read %d scans in %ld bytes", samples, rsize);
+    for (int i = 0; i < samples; i++) {
+        parseScan(mIIOBuffer + i * nbyte, sensors, lp_quaternion_on,
+                  localMask, &sample);
+        buildSample(&sample);
+        // fusion has to see every scan even when data is full
+        nb = executeOnData(data, count);
+        data += nb;
+        count -= nb;
+        numEventReceived += nb;
+    }
 
     return numEventReceived;
 }
 
-/* use for both MPUxxxx and third party compass */
+void *MPLSensor::ingestThread(void *arg)
+{
+    ((MPLSensor *) arg)->ingestLoop();
+    return NULL;
+}
+
+/* IIO ingestion: drains the IIO ring as soon as the driver fills it and
+   hands the parsed scans to the poll thread, so a slow fusion pass no
+   longer delays the next read */
+void MPLSensor::ingestLoop()
+{
+    VFUNC_LOG;
+
+    struct pollfd fds[2];
+    struct iio_sample sample;
+    int sensors, lp_quaternion_on, nbyte, samples, dropped;
+    long localMask;
+    ssize_t rsize;
+    const char wake = 'E';
+
+    androidSetThreadPriority(0, ANDROID_PRIORITY_URGENT_DISPLAY);
+
+    fds[0].fd = iio_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = mIngestStop[0];
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        fds[0].revents = fds[1].revents = 0;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            LOGE("HAL:ingest poll failed (%s)", strerror(errno));
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            LOGE("HAL:ingest lost the iio device (revents=0x%x)", fds[0].revents);
+            break;
+        }
+        if (!(fds[0].revents & (POLLIN | POLLPRI)))
+            continue;
+
+        // the scan layout only changes with the master enable off
+        pthread_mutex_lock(&GlobalHalMutex);
+        localMask = fifoSensorMask();
+        nbyte = scanLayout(localMask, &sensors, &lp_quaternion_on);
+        pthread_mutex_unlock(&GlobalHalMutex);
+
+        if (sensors == 0 && !lp_quaternion_on) {
+            // nothing is scanned, just flush the ring
+            read(iio_fd, mIIOBuffer, sizeof(mIIOBuffer));
+            continue;
+        }
+
+        rsize = read(iio_fd, mIIOBuffer, (sizeof(mIIOBuffer) / nbyte) * nbyte);
+        countRead(rsize, nbyte);
+        if (rsize < (nbyte - 8)) {
+            LOGE("HAL:ERR Full data packet was not read. rsize=%ld nbyte=%d sensors=%d errno=%d(%s)",
+                 rsize, nbyte, sensors, errno, strerror(errno));
+            continue;
+        }
+
+        samples = rsize / nbyte;
+        alignScanTimestamps(mIIOBuffer, samples, nbyte);
+        if (samples == 0)
+            samples = 1;
+        dropped = 0;
+        for (int i = 0; i < samples; i++) {
+            parseScan(mIIOBuffer + i * nbyte, sensors, lp_quaternion_on,
+                      localMask, &sample);
+            // the gyro temperature rides along every 0.5 seconds, so the
+            // HAL thread never reads sysfs for it
+            if (!mTempFifo && (sample.present & INV_THREE_AXIS_GYRO) &&
+                    sample.timestamp - mIngestTempTime >= 500000000LL) {
+                mIngestTempTime = sample.timestamp;
+                sample.tempOn = (inv_read_temperature(sample.temperature) == 0);
+            }
+            if (!mSampleRing.push(sample))
+                dropped++;
+        }
+        LOGW_IF(dropped, "HAL:sample ring full, dropped %d of %d scans (%d total)",
+                dropped, samples, mSampleRing.dropped());
+
+        if (write(mIngestPipe[1], &wake, 1) < 0 && errno != EAGAIN) {
+            LOGE("HAL:ingest wakeup failed (%s)", strerror(errno));
+        }
+    }
+}
+
+/* called once per read of iio_fd, from either the poll or the ingest thread */
+void MPLSensor::countRead(ssize_t rsize, int nbyte)
+{
+    android_atomic_inc(&mReadStats.reads);
+    if (rsize < (nbyte - 8)) {
+        android_atomic_inc(&mReadStats.shortReads);
+    } else {
+        // a scan without its timestamp still counts as one
+        android_atomic_add(rsize >= nbyte ? rsize / nbyte : 1,
+                           &mReadStats.scans);
+    }
+}
+
+void MPLSensor::getReadStats(iio_read_stats *stats) const
+{
+    stats->reads = android_atomic_acquire_load(&mReadStats.reads);
+    stats->shortReads = android_atomic_acquire_load(&mReadStats.shortReads);
+    stats->scans = android_atomic_acquire_load(&mReadStats.scans);
+    stats->dropped = mSampleRing.dropped();
+}
+
+/* move IIO reads onto their own thread, readEvents falls back to reading
+   iio_fd directly when this fails */
+void MPLSensor::startIngest()
+{
+    VFUNC_LOG;
+
+    mIngestRunning = false;
+    if (iio_fd < 0)
+        return;
+
+    if (pipe(mIngestPipe) < 0) {
+        LOGE("HAL:can't create ingest pipe (%s)", strerror(errno));
+        return;
+    }
+    if (pipe(mIngestStop) < 0) {
+        LOGE("HAL:can't create ingest stop pipe (%s)", strerror(errno));
+        close(mIngestPipe[0]);
+        close(mIngestPipe[1]);
+        return;
+    }
+    fcntl(mIngestPipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(mIngestPipe[1], F_SETFL, O_NONBLOCK);
+
+    if (pthread_create(&mIngestThread, NULL, ingestThread, this) != 0) {
+        LOGE("HAL:can't start ingest thread");
+        close(mIngestPipe[0]);
+        close(mIngestPipe[1]);
+        close(mIngestStop[0]);
+        close(mIngestStop[1]);
+        return;
+    }
+    mIngestRunning = true;
+}
+
+void MPLSensor::stopIngest()
+{
+    VFUNC_LOG;
+
+    const char stop = 'S';
+
+    if (!mIngestRunning)
+        return;
+
+    write(mIngestStop[1], &stop, 1);
+    pthread_join(mIngestThread, NULL);
+    mIngestRunning = false;
+
+    close(mIngestPipe[0]);
+    close(mIngestPipe[1]);
+    close(mIngestStop[0]);
+    close(mIngestStop[1]);
+}
+
+/* use for both MPUxxxx and third party compass, returns 1 when the sample
+   was built for its own executeOnData() pass */
 int MPLSensor::readCompassEvents(sensors_event_t *data, int count)
 {
     VHANDLER_LOG;
@@ -2046,26 +3565,31 @@ int MPLSensor::readCompassEvents(sensors_event_t *data, int count)
     // pthread_mutex_lock(&mMplMutex);
     // pthread_mutex_lock(&mHALMutex);
 
-    done = mCompassSensor->readSample(mCachedCompassData, &mCompassTimestamp);
+    struct iio_sample sample, oldest;
+    done = mCompassSensor->readSample(sample.compass, &sample.timestamp);
 #ifdef COMPASS_YAS53x
     if (mCompassSensor->checkCoilsReset()) {
        //Reset relevant compass settings
        resetCompass();
     }
 #endif
-    if (done > 0) {
-        int status = 0;
-        if (mCompassSensor->providesCalibration()) {
-            status = mCompassSensor->getAccuracy();
-            status |= INV_CALIBRATED;
-        }
-        if (mLocalSensorMask & INV_THREE_AXIS_COMPASS) {
-            inv_build_compass(mCachedCompassData, status,
-                              mCompassTimestamp);
-            LOGV_IF(INPUT_DATA, "HAL:inv_build_compass: %+8ld %+8ld %+8ld - %lld",
-                    mCachedCompassData[0], mCachedCompassData[1],
-                    mCachedCompassData[2], mCompassTimestamp);
+    if (done > 0 && (mLocalSensorMask & INV_THREE_AXIS_COMPASS)) {
+        if (fifoSensorMask() & (INV_THREE_AXIS_GYRO | INV_THREE_AXIS_ACCEL)) {
+            // the MPU scans are running: this sample goes into fusion
+            // with the first scan not older than it, see mergeCompass()
+            sample.present = INV_THREE_AXIS_COMPASS;
+            if (!mCompassQueue.push(sample)) {
+                mCompassQueue.pop(&oldest);
+                mCompassQueue.push(sample);
+            }
+            return numEventReceived;
         }
+        // the compass runs alone, samples queued for scans that stopped
+        // coming are stale
+        while (mCompassQueue.pop(&oldest))
+            ;
+        buildCompass(sample.compass, sample.timestamp);
+        numEventReceived = 1;
     }
 
     // pthread_mutex_unlock(&mMplMutex);
@@ -2074,11 +3598,49 @@ int MPLSensor::readCompassEvents(sensors_event_t *data, int count)
     return numEventReceived;
 }
 
+/* hand a third party compass sample to the MPL */
+void MPLSensor::buildCompass(const long *data, int64_t timestamp)
+{
+    int status = 0;
+
+    memcpy(mCachedCompassData, data, sizeof(mCachedCompassData));
+    mCompassTimestamp = timestamp;
+    if (mCompassSensor->providesCalibration()) {
+        status = mCompassSensor->getAccuracy();
+        status |= INV_CALIBRATED;
+    }
+    inv_build_compass(mCachedCompassData, status, mCompassTimestamp);
+    mNewDataMode |= INV_MAG_NEW;
+    LOGV_IF(INPUT_DATA, "HAL:inv_build_compass: %+8ld %+8ld %+8ld - %lld",
+            mCachedCompassData[0], mCachedCompassData[1],
+            mCachedCompassData[2], mCompassTimestamp);
+}
+
+/* build the newest queued third party compass sample not later than the
+   MPU scan at timestamp, so fusion runs once per scan with it; the older
+   ones are superseded */
+void MPLSensor::mergeCompass(int64_t timestamp)
+{
+    const struct iio_sample *next;
+    struct iio_sample sample;
+    int found = 0;
+
+    while ((next = mCompassQueue.front()) != NULL &&
+            next->timestamp <= timestamp) {
+        mCompassQueue.pop(&sample);
+        found = 1;
+    }
+    if (found)
+        buildCompass(sample.compass, sample.timestamp);
+}
+
 #ifdef COMPASS_YAS53x
 int MPLSensor::resetCompass()
 {
     VFUNC_LOG;
 
+    saveCompassCal();
+
     //Reset compass cal if enabled
     if (mFeatureActiveMask & INV_COMPASS_CAL) {
        LOGV_IF(EXTRA_VERBOSE, "HAL:Reset compass cal");
@@ -2093,11 +3655,100 @@ int MPLSensor::resetCompass()
 
     return 0;
 }
+
+/* keep the MPL states, compass bias and fit included, so the calibration
+   can pick up where it was if the reset didn't change the field */
+void MPLSensor::saveCompassCal()
+{
+    VFUNC_LOG;
+
+    long field[3];
+    int8_t accuracy;
+    inv_time_t timestamp;
+    size_t size;
+    float sq = 0;
+
+    dropCompassCal();
+    if (inv_get_mag_accuracy() < 3)
+        return;     // nothing worth coming back to
+    if (inv_get_mpl_state_size(&size) != INV_SUCCESS || size == 0)
+        return;
+    mCompassCal = (unsigned char *)malloc(size);
+    if (mCompassCal == NULL)
+        return;
+    inv_store_cal(mCompassCal, size);
+    mCompassCalSize = size;
+
+    inv_get_compass_bias(mCompassCalBias);
+    inv_get_compass_set(field, &accuracy, &timestamp);
+    for (int i = 0; i < 3; i++) {
+        float v = field[i] / 65536.f;
+        sq += v * v;
+    }
+    mCompassCalField = sqrtf(sq);
+    mCompassWarmMatches = 0;
+}
+
+/* after a reset, measure the field with the saved bias: the same strength
+   for COMPASS_WARM_SAMPLES samples brings the saved states back, anything
+   else leaves the calibration to start over */
+void MPLSensor::checkCompassWarmStart()
+{
+    long field[3], bias[3];
+    int8_t accuracy;
+    inv_time_t timestamp;
+    float sq = 0;
+
+    if (mCompassCal == NULL)
+        return;
+    if (inv_get_mag_accuracy() >= 3) {
+        // got there on its own
+        dropCompassCal();
+        return;
+    }
+
+    inv_get_compass_set(field, &accuracy, &timestamp);
+    inv_get_compass_bias(bias);
+    for (int i = 0; i < 3; i++) {
+        float v = (field[i] + bias[i] - mCompassCalBias[i]) / 65536.f;
+        sq += v * v;
+    }
+    if (fabsf(sqrtf(sq) - mCompassCalField) >
+            COMPASS_WARM_TOLERANCE * mCompassCalField) {
+        LOGV_IF(PROCESS_VERBOSE, "HAL:compass field changed (%.1f/%.1f uT), "
+                "calibrating from scratch", sqrtf(sq), mCompassCalField);
+        dropCompassCal();
+        return;
+    }
+    if (++mCompassWarmMatches < COMPASS_WARM_SAMPLES)
+        return;
+
+    if (inv_load_mpl_states(mCompassCal, mCompassCalSize) == INV_SUCCESS) {
+        LOGV_IF(PROCESS_VERBOSE, "HAL:compass warm start at %.1f uT",
+                mCompassCalField);
+    } else {
+        LOGE("HAL:couldn't restore the compass calibration");
+    }
+    dropCompassCal();
+}
 #endif
 
+void MPLSensor::dropCompassCal()
+{
+    free(mCompassCal);
+    mCompassCal = NULL;
+    mCompassCalSize = 0;
+    mCompassWarmMatches = 0;
+}
+
 int MPLSensor::getFd() const
 {
     VFUNC_LOG;
+    if (mIngestRunning) {
+        // parsed scans are signalled by the ingest thread
+        LOGV_IF(EXTRA_VERBOSE, "MPLSensor::getFd returning %d", mIngestPipe[0]);
+        return mIngestPipe[0];
+    }
     LOGV_IF(EXTRA_VERBOSE, "MPLSensor::getFd returning %d", iio_fd);
     return iio_fd;
 }
@@ -2131,6 +3782,30 @@ int MPLSensor::turnOffAccelFifo() {
     return 0;
 }
 
+int MPLSensor::turnOffGyroFifo() {
+    int i, res;
+    char *gyro_fifo_enable[3] = {mpu.gyro_x_fifo_enable,
+        mpu.gyro_y_fifo_enable, mpu.gyro_z_fifo_enable};
+
+    for (i = 0; i < 3; i++) {
+        res = write_sysfs_int(gyro_fifo_enable[i], 0);
+        if (res < 0) {
+            return res;
+        }
+    }
+    if (mTempFifo) {
+        return write_sysfs_int(mpu.temp_fifo_enable, 0);
+    }
+    return 0;
+}
+
+/* sensors whose samples are in the IIO scans, the DMP quaternion only mode
+   keeps gyro and accel powered with their FIFOs off */
+long MPLSensor::fifoSensorMask()
+{
+    return mDmpQuatOnly ? 0 : (mLocalSensorMask & mMasterSensorMask);
+}
+
 int MPLSensor::enableDmpOrientation(int en)
 {
     VFUNC_LOG;
@@ -2142,6 +3817,7 @@ int MPLSensor::enableDmpOrientation(int en)
         return res;
 
     pthread_mutex_lock(&GlobalHalMutex);
+    openReconfig();
 
     // on power if not already On
     res = onPower(1);
@@ -2231,20 +3907,27 @@ int MPLSensor::dmpOrientHandler(int orient)
     return 0;
 }
 
-int MPLSensor::readDmpOrientEvents(sensors_event_t* data, int count) {
+int MPLSensor::readDmpOrientEvents(sensors_event_t* data, int count, int64_t now) {
     VFUNC_LOG;
 
-    char dummy[4];
+    char buf[32];
+    char *end;
     int screen_orientation = 0;
-    FILE *fp;
-
-    fp = fopen(mpu.event_display_orientation, "r");
-    if (fp == NULL) {
-        LOGE("HAL:cannot open event_display_orientation");
+    int64_t timestamp = 0;
+    ssize_t n;
+
+    // dmp_orient_fd is event_display_orientation itself: reading it from
+    // the start returns the value and re-arms the POLLPRI notification
+    n = pread(dmp_orient_fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        LOGE("HAL:cannot read event_display_orientation");
         return 0;
     }
-    fscanf(fp, "%d\n", &screen_orientation);
-    fclose(fp);
+    buf[n] = '\0';
+    screen_orientation = strtol(buf, &end, 10);
+    // drivers that timestamp the event append it after the value
+    if (end != buf)
+        timestamp = strtoll(end, NULL, 10);
 
     int numEventReceived = 0;
 
@@ -2258,18 +3941,14 @@ int MPLSensor::readDmpOrientEvents(sensors_event_t* data, int count) {
         temp.type = SENSOR_TYPE_SCREEN_ORIENTATION;
         temp.screen_orientation = screen_orientation;
 #endif
-        struct timespec ts;
-        clock_gettime(CLOCK_MONOTONIC, &ts);
-        temp.timestamp = (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+        temp.timestamp = timestamp > 0 ? timestamp : now;
 
         *data++ = temp;
         count--;
         numEventReceived++;
     }
 
-    // read dummy data per driver's request
     dmpOrientHandler(screen_orientation);
-    read(dmp_orient_fd, dummy, 4);
 
     return numEventReceived;
 }
@@ -2283,6 +3962,162 @@ int MPLSensor::getDmpOrientFd()
 
 }
 
+void MPLSensor::openDmpPedometerFd()
+{
+    VFUNC_LOG;
+
+    char buf[16];
+
+    if (!isDmpPedometerOn() || dmp_pedometer_fd >= 0)
+        return;
+
+    dmp_pedometer_fd = open(mpu.event_pedometer, O_RDONLY | O_NONBLOCK);
+    if (dmp_pedometer_fd < 0) {
+        LOGV_IF(PROCESS_VERBOSE, "HAL:no DMP pedometer event node");
+        return;
+    }
+    // sysfs only notifies POLLPRI for changes after a first read
+    pread(dmp_pedometer_fd, buf, sizeof(buf), 0);
+    LOGV_IF(PROCESS_VERBOSE, "HAL:dmp_pedometer_fd opened : %d", dmp_pedometer_fd);
+}
+
+int MPLSensor::getDmpPedometerFd()
+{
+    VFUNC_LOG;
+
+    LOGV_IF(EXTRA_VERBOSE, "MPLSensor::getDmpPedometerFd returning %d", dmp_pedometer_fd);
+    return dmp_pedometer_fd;
+}
+
+void MPLSensor::openSigMotionFd()
+{
+    VFUNC_LOG;
+
+    char buf[16];
+
+    if (!isSigMotionOn() || motion_fd >= 0)
+        return;
+
+    motion_fd = open(mpu.event_accel_motion, O_RDONLY | O_NONBLOCK);
+    if (motion_fd < 0) {
+        LOGV_IF(PROCESS_VERBOSE, "HAL:no motion interrupt event node");
+        return;
+    }
+    // sysfs only notifies POLLPRI for changes after a first read
+    pread(motion_fd, buf, sizeof(buf), 0);
+    LOGV_IF(PROCESS_VERBOSE, "HAL:motion_fd opened : %d", motion_fd);
+}
+
+int MPLSensor::getSigMotionFd()
+{
+    VFUNC_LOG;
+
+    LOGV_IF(EXTRA_VERBOSE, "MPLSensor::getSigMotionFd returning %d", motion_fd);
+    return motion_fd;
+}
+
+/* The sensor is one shot: the first motion interrupt while it is armed
+   is reported and disarms it, the accel goes back off with it */
+int MPLSensor::readSigMotionEvents(sensors_event_t* data, int count, int64_t now)
+{
+    VFUNC_LOG;
+
+    char buf[16];
+    int numEventReceived = 0;
+
+    // reading the event node re-arms its POLLPRI notification
+    if (pread(motion_fd, buf, sizeof(buf), 0) < 0) {
+        LOGE("HAL:cannot read event_accel_motion");
+        return 0;
+    }
+    if (!(mFeatureActiveMask & INV_MOTION_WAKE) || count <= 0)
+        return 0;
+
+#ifdef ENABLE_SIGNIFICANT_MOTION_FEAT
+    sensors_event_t temp;
+
+    bzero(&temp, sizeof(temp));
+    temp.version = sizeof(sensors_event_t);
+    temp.sensor = ID_SM;
+    temp.type = SENSOR_TYPE_SIGNIFICANT_MOTION;
+    temp.data[0] = 1.0f;
+    temp.timestamp = now;
+
+    *data = temp;
+    numEventReceived++;
+#endif
+
+    LOGV_IF(PROCESS_VERBOSE, "HAL:significant motion, disarming");
+    enableSignificantMotion(0);
+
+    return numEventReceived;
+}
+
+/* One step detector event per new step and the running total on the step
+   counter, the total keeps counting across disable/enable of the sensors */
+int MPLSensor::readDmpPedometerEvents(sensors_event_t* data, int count, int64_t now)
+{
+    VFUNC_LOG;
+
+    char buf[16];
+    int steps, newSteps;
+    int numEventReceived = 0;
+
+    // reading the event node re-arms its POLLPRI notification
+    if (pread(dmp_pedometer_fd, buf, sizeof(buf), 0) < 0) {
+        LOGE("HAL:cannot read event_pedometer");
+        return 0;
+    }
+    if (read_sysfs_int(mpu.pedometer_steps, &steps) < 0) {
+        return 0;
+    }
+
+    // a DMP reload restarts its count from zero
+    newSteps = steps >= mStepsHw ? steps - mStepsHw : steps;
+    mStepsHw = steps;
+    if (!mDmpStepEnabled || newSteps == 0)
+        return 0;
+    mStepCount += newSteps;
+    LOGV_IF(PROCESS_VERBOSE, "HAL:pedometer %d new steps, %llu total",
+            newSteps, (unsigned long long)mStepCount);
+
+#ifdef ENABLE_DMP_PEDOMETER_FEAT
+    if ((mDmpStepEnabled & (1 << StepCounter)) && count > 0) {
+        sensors_event_t temp;
+
+        bzero(&temp, sizeof(temp));
+        temp.version = sizeof(sensors_event_t);
+        temp.sensor = ID_SC;
+        temp.type = SENSOR_TYPE_STEP_COUNTER;
+        temp.u64.step_counter = mStepCount;
+        temp.timestamp = now;
+
+        *data++ = temp;
+        count--;
+        numEventReceived++;
+    }
+
+    if (mDmpStepEnabled & (1 << StepDetector)) {
+        for (; newSteps > 0 && count > 0; newSteps--) {
+            sensors_event_t temp;
+
+            bzero(&temp, sizeof(temp));
+            temp.version = sizeof(sensors_event_t);
+            temp.sensor = ID_SD;
+            temp.type = SENSOR_TYPE_STEP_DETECTOR;
+            temp.data[0] = 1.0f;
+            temp.timestamp = now;
+
+            *data++ = temp;
+            count--;
+            numEventReceived++;
+        }
+    }
+#endif
+
+    return numEventReceived;
+}
+
 int MPLSensor::checkDMPOrientation()
 {
     VFUNC_LOG;
@@ -2306,15 +4141,28 @@ int MPLSensor::getDmpRate(int64_t *wanted)
 int MPLSensor::getPollTime()
 {
     VHANDLER_LOG;
-    return mPollTime;
+
+    int pollTime = -1;
+
+    // every data path has an fd to block on, the only timed wakeup left
+    // is committing a pending reconfiguration
+    pthread_mutex_lock(&GlobalHalMutex);
+    if (mReconfigOpen) {
+        int64_t left = mReconfigDeadline - getTimestamp();
+        int ms = left > 0 ? (int)((left + 999999LL) / 1000000LL) : 0;
+        if (pollTime < 0 || ms < pollTime)
+            pollTime = ms;
+    }
+    pthread_mutex_unlock(&GlobalHalMutex);
+    return pollTime;
 }
 
 bool MPLSensor::hasPendingEvents() const
 {
     VHANDLER_LOG;
-    // if we are using the polling workaround, force the main
-    // loop to check for data every time
-    return (mPollTime != -1);
+    // scans the ingest thread queued past the last wakeup the poll loop
+    // consumed; nothing else is held outside an fd
+    return mIngestRunning && !mSampleRing.empty();
 }
 
 /* TODO: support resume suspend when we gain more info about them*/
@@ -2394,11 +4242,13 @@ int MPLSensor::inv_read_temperature(long long *data)
         return -1;
     }
 
-    count = sscanf(raw_buf, "%ld%lld", &raw, &timestamp);
-
-    if(count < 0) {
+    // "<raw> <timestamp>", parsed by hand as this runs twice a second
+    char *end;
+    raw = strtol(raw_buf, &end, 10);
+    if (end == raw_buf) {
         return -1;
     }
+    timestamp = strtoll(end, NULL, 10);
 
     LOGV_IF(ENG_VERBOSE,
             "HAL:temperature raw = %ld, timestamp = %lld, count = %d",
@@ -2489,6 +4339,16 @@ int MPLSensor::populateSensorList(struct sensor_t *list, int len)
         return -(sizeof(sSensorList) / sizeof(sensor_t));
     }
 
+    pthread_mutex_lock(&sHalCacheLock);
+    if (sCachedListCount && chip_ID[0] != '\0'
+            && !strcmp(sCachedListChip, chip_ID)) {
+        memcpy(list, sCachedList, sizeof(sensor_t) * sCachedListCount);
+        numsensors = sCachedListCount;
+        pthread_mutex_unlock(&sHalCacheLock);
+        return numsensors;
+    }
+    pthread_mutex_unlock(&sHalCacheLock);
+
     /* fill in the base values */
     memcpy(list, sSensorList, sizeof (struct sensor_t) * (sizeof(sSensorList) / sizeof(sensor_t)));
 
@@ -2515,15 +4375,49 @@ int MPLSensor::populateSensorList(struct sensor_t *list, int len)
         fillGravity(list);
         /* fill in Linear accel values */
         fillLinearAccel(list);
+#ifdef ENABLE_GAME_RV_FEAT
+        /* fill in game rotation vector values */
+        fillGameRV(list);
+#endif
     } else {
         /* no 9-axis sensors, zero fill that part of the list */
         numsensors = 3;
         memset(list + 3, 0, 4 * sizeof(struct sensor_t));
     }
 
+    /* event sensors are only listed when the driver has their node */
+    if (numsensors > numSensors) {
+        int kept = numSensors;
+        for (int i = numSensors; i < numsensors; i++) {
+            if (hasEventNode(list[i].handle))
+                list[kept++] = list[i];
+        }
+        numsensors = kept;
+    }
+
+    pthread_mutex_lock(&sHalCacheLock);
+    if (!sCachedListCount && chip_ID[0] != '\0') {
+        memcpy(sCachedList, list, sizeof(sensor_t) * numsensors);
+        strcpy(sCachedListChip, chip_ID);
+        sCachedListCount = numsensors;
+    }
+    pthread_mutex_unlock(&sHalCacheLock);
+
     return numsensors;
 }
 
+bool MPLSensor::hasEventNode(int handle)
+{
+    switch (handle) {
+    case ID_SD:
+    case ID_SC:
+        return dmp_pedometer_fd >= 0;
+    case ID_SM:
+        return motion_fd >= 0;
+    }
+    return true;
+}
+
 void MPLSensor::fillAccel(const char* accel, struct sensor_t *list)
 {
     VFUNC_LOG;
@@ -2629,6 +4523,22 @@ void MPLSensor::fillRV(struct sensor_t *list)
     return;
 }
 
+void MPLSensor::fillGameRV(struct sensor_t *list)
+{
+    VFUNC_LOG;
+
+#ifdef ENABLE_GAME_RV_FEAT
+    /* no compass */
+    list[GameRotationVector].power = list[Gyro].power +
+                                     list[Accelerometer].power;
+    list[GameRotationVector].resolution = .00001;
+    list[GameRotationVector].maxRange = 1.0;
+    list[GameRotationVector].minDelay = 5000;
+#endif
+
+    return;
+}
+
 void MPLSensor::fillOrientation(struct sensor_t *list)
 {
     VFUNC_LOG;
@@ -2676,19 +4586,35 @@ int MPLSensor::inv_init_sysfs_attributes(void)
     VFUNC_LOG;
 
     unsigned char i;
-    char sysfs_path[MAX_SYSFS_NAME_LEN], iio_trigger_path[MAX_SYSFS_NAME_LEN];
-    char *sptr;
+    char *names, *sptr;
     char **dptr;
-    int num;
+    bool shared;
+
+    sysfs_names_ptr = NULL;
 
-    sysfs_names_ptr =
-            (char*)calloc(1, sizeof(char[MAX_SYSFS_ATTRB][MAX_SYSFS_NAME_LEN]));
-    sptr = sysfs_names_ptr;
-    if (sptr == NULL) {
-        LOGE("HAL:couldn't alloc mem for sysfs paths");
+    // get proper (in absolute/relative) IIO path & build MPU's sysfs paths
+    // inv_get_sysfs_abs_path(sysfs_path);
+    const struct inv_topology *topo = inv_get_topology();
+    if (topo == NULL) {
+        ALOGE("MPLSensor failed get sysfs path");
         return -1;
     }
 
+    pthread_mutex_lock(&sHalCacheLock);
+    shared = sSysfsNames && !strcmp(sSysfsNamesKey, topo->sysfs_path);
+    if (shared) {
+        names = sSysfsNames;
+    } else {
+        names = (char*)calloc(1,
+                sizeof(char[MAX_SYSFS_ATTRB][MAX_SYSFS_NAME_LEN]));
+        if (names == NULL) {
+            pthread_mutex_unlock(&sHalCacheLock);
+            LOGE("HAL:couldn't alloc mem for sysfs paths");
+            return -1;
+        }
+    }
+
+    sptr = names;
     dptr = (char**)&mpu;
     i = 0;
     do {
@@ -2696,17 +4622,45 @@ int MPLSensor::inv_init_sysfs_attributes(void)
         sptr += sizeof(char[MAX_SYSFS_NAME_LEN]);
     } while (++i < MAX_SYSFS_ATTRB);
 
-    // get proper (in absolute/relative) IIO path & build MPU's sysfs paths
-    // inv_get_sysfs_abs_path(sysfs_path);
-    if(INV_SUCCESS != inv_get_sysfs_path(sysfs_path)) {
-        ALOGE("MPLSensor failed get sysfs path");
-        return -1;
+    if (!shared) {
+        fillSysfsNames(topo->sysfs_path, topo->trigger_path);
+        if (sSysfsNames == NULL) {
+            // kept for the life of the process
+            sSysfsNames = names;
+            strcpy(sSysfsNamesKey, topo->sysfs_path);
+        } else {
+            sysfs_names_ptr = names;
+        }
     }
+    pthread_mutex_unlock(&sHalCacheLock);
 
-    if(INV_SUCCESS != inv_get_iio_trigger_path(iio_trigger_path)) {
-        ALOGE("MPLSensor failed get iio trigger path");
-        return -1;
+#if SYSFS_VERBOSE
+    // test print sysfs paths
+    dptr = (char**)&mpu;
+    for (i = 0; i < MAX_SYSFS_ATTRB; i++) {
+        LOGE("HAL:sysfs path: %s", *dptr++);
     }
+#endif
+
+    // keep the integer attributes open for the enable/rate paths
+    dptr = (char**)&mpu;
+    for (i = 0; i < MAX_SYSFS_ATTRB; i++, dptr++) {
+        if (*dptr == mpu.dmp_firmware || *dptr == mpu.key
+                || *dptr == mpu.trigger_name
+                || *dptr == mpu.event_display_orientation
+                || *dptr == mpu.event_pedometer
+                || *dptr == mpu.event_accel_motion)
+            continue;
+        inv_sysfs_cache_add(*dptr);
+    }
+    return 0;
+}
+
+/* writes the attribute paths into the buffers mpu points at */
+void MPLSensor::fillSysfsNames(const char *sysfs_path,
+                               const char *iio_trigger_path)
+{
+    VFUNC_LOG;
 
     sprintf(mpu.key, "%s%s", sysfs_path, "/key");
     sprintf(mpu.chip_enable, "%s%s", sysfs_path, "/buffer/enable");
@@ -2723,6 +4677,17 @@ int MPLSensor::inv_init_sysfs_attributes(void)
     sprintf(mpu.dmp_event_int_on,"%s%s", sysfs_path, "/dmp_event_int_on");
     sprintf(mpu.dmp_output_rate,"%s%s", sysfs_path, "/dmp_output_rate");
     sprintf(mpu.tap_on, "%s%s", sysfs_path, "/tap_on");
+    sprintf(mpu.flick_int_on, "%s%s", sysfs_path, "/flick_int_on");
+    sprintf(mpu.flick_upper, "%s%s", sysfs_path, "/flick_upper");
+    sprintf(mpu.flick_lower, "%s%s", sysfs_path, "/flick_lower");
+    sprintf(mpu.flick_counter, "%s%s", sysfs_path, "/flick_counter");
+    sprintf(mpu.pedometer_on, "%s%s", sysfs_path, "/pedometer_on");
+    sprintf(mpu.pedometer_int_on, "%s%s", sysfs_path, "/pedometer_int_on");
+    sprintf(mpu.pedometer_steps, "%s%s", sysfs_path, "/pedometer_steps");
+    sprintf(mpu.motion_lpa_on, "%s%s", sysfs_path, "/motion_lpa_on");
+    sprintf(mpu.motion_lpa_threshold, "%s%s", sysfs_path, "/motion_lpa_threshold");
+    sprintf(mpu.motion_lpa_duration, "%s%s", sysfs_path, "/motion_lpa_duration");
+    sprintf(mpu.motion_lpa_freq, "%s%s", sysfs_path, "/motion_lpa_freq");
 
     // TODO: for self test
     sprintf(mpu.self_test, "%s%s", sysfs_path, "/self_test");
@@ -2734,6 +4699,7 @@ int MPLSensor::inv_init_sysfs_attributes(void)
     sprintf(mpu.gyro_x_fifo_enable, "%s%s", sysfs_path, "/scan_elements/in_anglvel_x_en");
     sprintf(mpu.gyro_y_fifo_enable, "%s%s", sysfs_path, "/scan_elements/in_anglvel_y_en");
     sprintf(mpu.gyro_z_fifo_enable, "%s%s", sysfs_path, "/scan_elements/in_anglvel_z_en");
+    sprintf(mpu.temp_fifo_enable, "%s%s", sysfs_path, "/scan_elements/in_temp_en");
 
     sprintf(mpu.accel_enable, "%s%s", sysfs_path, "/accl_enable");
     sprintf(mpu.accel_fifo_rate, "%s%s", sysfs_path, "/sampling_frequency");
@@ -2758,15 +4724,8 @@ int MPLSensor::inv_init_sysfs_attributes(void)
 
     sprintf(mpu.display_orientation_on, "%s%s", sysfs_path, "/display_orientation_on");
     sprintf(mpu.event_display_orientation, "%s%s", sysfs_path, "/event_display_orientation");
-
-#if SYSFS_VERBOSE
-    // test print sysfs paths
-    dptr = (char**)&mpu;
-    for (i = 0; i < MAX_SYSFS_ATTRB; i++) {
-        LOGE("HAL:sysfs path: %s", *dptr++);
-    }
-#endif
-    return 0;
+    sprintf(mpu.event_pedometer, "%s%s", sysfs_path, "/event_pedometer");
+    sprintf(mpu.event_accel_motion, "%s%s", sysfs_path, "/event_accel_motion");
 }
 
 /* TODO: stop manually testing/using 0 and 1 instead of
@@ -2788,6 +4747,22 @@ int MPLSensor::isLowPowerQuatEnabled()
 #endif
 }
 
+/* rotation vectors and gravity alone can run on the DMP quaternion, without
+   the raw sensors in the FIFO or the MPL fusion */
+int MPLSensor::isDmpQuatOnly(int enabled_sensors)
+{
+#ifdef ENABLE_DMP_QUAT_ONLY_FEAT
+    int quat_only = (1 << RotationVector) | (1 << Gravity);
+#ifdef ENABLE_GAME_RV_FEAT
+    quat_only |= (1 << GameRotationVector);
+#endif
+    return isLowPowerQuatEnabled() && (enabled_sensors & quat_only) &&
+           !(enabled_sensors & ~quat_only);
+#else
+    return 0;
+#endif
+}
+
 int MPLSensor::isDmpDisplayOrientationOn()
 {
 #ifdef ENABLE_DMP_DISPL_ORIENT_FEAT
@@ -2796,3 +4771,21 @@ int MPLSensor::isDmpDisplayOrientationOn()
     return 0;
 #endif
 }
+
+int MPLSensor::isDmpPedometerOn()
+{
+#ifdef ENABLE_DMP_PEDOMETER_FEAT
+    return !isMpu3050();
+#else
+    return 0;
+#endif
+}
+
+int MPLSensor::isSigMotionOn()
+{
+#ifdef ENABLE_SIGNIFICANT_MOTION_FEAT
+    return !isMpu3050();
+#else
+    return 0;
+#endif
+}
@@ -27,6 +27,7 @@
 #include "sensors.h"
 #include "SensorBase.h"
 #include "InputEventReader.h"
+#include "IIOSampleRing.h"
 
 #ifdef INVENSENSE_COMPASS_CAL
 
@@ -49,6 +50,7 @@
 /* Sensors Enable/Disable Mask
  *****************************************************************************/
 #define MAX_CHIP_ID_LEN             (20)
+#define COMPASS_QUEUE_LENGTH        (8)
 
 #define INV_THREE_AXIS_GYRO         (0x000F)
 #define INV_THREE_AXIS_ACCEL        (0x0070)
@@ -70,10 +72,40 @@
 #define INV_COMPASS_FIT              0x02
 #define INV_DMP_QUATERNION           0x04
 #define INV_DMP_DISPL_ORIENTATION    0x08
+#define INV_DMP_PEDOMETER            0x10
+#define INV_DMP_TAP                  0x20
+#define INV_DMP_FLICK                0x40
+#define INV_MOTION_WAKE              0x80
 
 /* Uncomment to enable Low Power Quaternion */
 #define ENABLE_LP_QUAT_FEAT
 
+/* Uncomment to serve rotation vector and gravity straight from the
+   DMP quaternion while no raw gyro, accel or compass sensor is enabled.
+   The gyro and accel FIFOs and the compass are turned off and the MPL
+   fusion is bypassed, so the rotation vector has no magnetic heading
+   in that mode (needs ENABLE_LP_QUAT_FEAT) */
+// #define ENABLE_DMP_QUAT_ONLY_FEAT
+
+/* Uncomment to slow the compass down while it only feeds fusion and its
+   calibration is settled */
+#define ENABLE_ADAPTIVE_COMPASS_RATE
+
+/* Uncomment to power the gyro down while it only feeds fusion and the
+   device has been still for a while, fusion goes on with accel and
+   compass until the device moves again */
+#define ENABLE_GYRO_PARKING
+
+/* Uncomment to run the MPL on only part of the scans while the device is
+   still and the 9-axis quaternion is at full accuracy, with only fused
+   sensors enabled */
+#define ENABLE_FUSION_GATING
+
+/* Uncomment to take the gyro temperature from the FIFO along with the gyro
+   samples, when the driver has the channel, instead of reading the sysfs
+   temperature node twice a second */
+#define ENABLE_FIFO_TEMP_FEAT
+
 /* Uncomment to enable DMP display orientation 
    (within the HAL, see below for Java framework) */
 // #define ENABLE_DMP_DISPL_ORIENT_FEAT
@@ -95,6 +127,41 @@
 #warning "ENABLE_DMP_DISPL_ORIENT_FEAT is defined, framework changes are necessary for HAL to work properly"
 #endif
 
+/* The DMP pedometer is exposed as the step detector and step counter
+   sensors when the platform sensors.h knows them. The DMP counts the
+   steps on the accel alone and signals them on their own event node,
+   so the AP can stay suspended while they add up. */
+#ifdef SENSOR_TYPE_STEP_COUNTER
+#define ENABLE_DMP_PEDOMETER_FEAT
+#endif
+
+/* One shot significant motion sensor on the MPU motion interrupt. While
+   it is armed the accel runs without the FIFO and the AP is only woken
+   when the motion threshold is crossed, then the sensor disarms. */
+#ifdef SENSOR_TYPE_SIGNIFICANT_MOTION
+#define ENABLE_SIGNIFICANT_MOTION_FEAT
+#endif
+
+/* Game rotation vector from the gyro and accel quaternion, when the
+   platform sensors.h knows it. It leaves the compass off, so its heading
+   is arbitrary but free of magnetic disturbances. */
+#ifdef SENSOR_TYPE_GAME_ROTATION_VECTOR
+#define ENABLE_GAME_RV_FEAT
+#endif
+
+/* Uncomment to expose a shake detector as a sensor. It runs in the HAL on
+   the calibrated accel and only reports when a shake is detected, with the
+   number of shakes. There is no platform type for it, it is given a
+   device private one. */
+#define ENABLE_SHAKE_FEAT
+
+#ifdef ENABLE_SHAKE_FEAT
+#ifndef SENSOR_TYPE_DEVICE_PRIVATE_BASE
+#define SENSOR_TYPE_DEVICE_PRIVATE_BASE     0x10000
+#endif
+#define SENSOR_TYPE_SHAKE                   (SENSOR_TYPE_DEVICE_PRIVATE_BASE + 1)
+#endif
+
 int isDmpScreenAutoRotationEnabled()
 {
 #ifdef ENABLE_DMP_SCREEN_AUTO_ROTATION
@@ -126,9 +193,25 @@ public:
         RotationVector,
         LinearAccel,
         Gravity,
+#ifdef ENABLE_GAME_RV_FEAT
+        GameRotationVector,
+#endif
+#ifdef ENABLE_SHAKE_FEAT
+        Shake,
+#endif
         numSensors
     };
 
+    /* sensors fed by MPU events instead of the IIO scans, listed after
+       the ones above */
+    enum {
+        ScreenOrientation = 0,
+        StepDetector,
+        StepCounter,
+        SignificantMotion,
+        numEventSensors
+    };
+
     MPLSensor(CompassSensor *, int (*m_pt2AccelCalLoadFunc)(long*) = 0);
     virtual ~MPLSensor();
 
@@ -137,6 +220,8 @@ public:
     int32_t getEnableMask() { return mEnabled; }
 
     virtual int readEvents(sensors_event_t *data, int count);
+    int readBatchedEvents(sensors_event_t *data, int count);
+    int commitReconfig(bool force);
     virtual int getFd() const;
     virtual int getAccelFd() const;
     virtual int getCompassFd() const;
@@ -153,23 +238,67 @@ public:
     //AKM HAL Integration
     //void set_compass(long ready, long x, long y, long z, long accuracy);
     int executeOnData(sensors_event_t* data, int count);
+    bool decimate(int i, int64_t ts);
+    void adaptCompassRate();
+    void adaptGyroPower();
+    void setGyroParked(bool parked);
+    void smoothRvSwitch(sensors_event_t *s);
+    bool skipFusion();
+    void updateFusionGate();
     int readAccelEvents(sensors_event_t* data, int count);
     int readCompassEvents(sensors_event_t* data, int count);
 
     int turnOffAccelFifo();
+    int turnOffGyroFifo();
     int enableDmpOrientation(int);
     int dmpOrientHandler(int);
-    int readDmpOrientEvents(sensors_event_t* data, int count);
+    int readDmpOrientEvents(sensors_event_t* data, int count, int64_t now);
     int getDmpOrientFd();
     int openDmpOrientFd();
     int closeDmpOrientFd();
+    int readDmpPedometerEvents(sensors_event_t* data, int count, int64_t now);
+    int getDmpPedometerFd();
+    int readSigMotionEvents(sensors_event_t* data, int count, int64_t now);
+    int getSigMotionFd();
+
+    /* DMP event nodes reported by one wakeup, see readDmpEvents */
+    enum {
+        DMP_EVENT_ORIENT = 1 << 0,
+        DMP_EVENT_PEDOMETER = 1 << 1,
+        DMP_EVENT_MOTION = 1 << 2,
+    };
+    int readDmpEvents(int nodes, sensors_event_t* data, int count);
 
     int getDmpRate(int64_t *);
     int checkDMPOrientation();
 
+    /* IIO ring counters since HAL start, for the sensor stats dump */
+    struct iio_read_stats {
+        int32_t reads;          // reads of iio_fd that expected scans
+        int32_t shortReads;     // reads that did not return a whole scan
+        int32_t scans;          // scans those reads returned
+        int32_t dropped;        // scans lost to a full sample ring
+    };
+    void getReadStats(iio_read_stats *stats) const;
+
 protected:
     CompassSensor *mCompassSensor;
 
+    int scanLayout(long localMask, int *sensors, int *lp_quaternion_on);
+    void parseScan(const char *rdata, int sensors, int lp_quaternion_on,
+                   long localMask, struct iio_sample *s);
+    void buildSample(const struct iio_sample *s);
+    void alignScanTimestamps(char *buf, int samples, int nbyte);
+    void resetOdr(int64_t nominal);
+    void trackOdr(int64_t ts);
+    void buildCompass(const long *data, int64_t timestamp);
+    void mergeCompass(int64_t timestamp);
+    static void *ingestThread(void *arg);
+    void ingestLoop();
+    void startIngest();
+    void stopIngest();
+    void openReconfig();
+
     int gyroHandler(sensors_event_t *data);
     int rawGyroHandler(sensors_event_t *data);
     int accelHandler(sensors_event_t *data);
@@ -177,7 +306,11 @@ protected:
     int rvHandler(sensors_event_t *data);
     int laHandler(sensors_event_t *data);
     int gravHandler(sensors_event_t *data);
+    int grvHandler(sensors_event_t *data);
     int orienHandler(sensors_event_t *data);
+    int shakeHandler(sensors_event_t *data);
+    int enableShake(int en);
+    void detectShake(const float *accel, int64_t ts);
     void calcOrientationSensor(float *Rx, float *Val);
     virtual int update_delay();
 
@@ -196,6 +329,7 @@ protected:
     int enableAccel(int en);
     int enableCompass(int en);
     void computeLocalSensorMask(int enabled_sensors);
+    void updateMplModules(long needed);
     int enableSensors(unsigned long sensors, int en, uint32_t changed);
     int inv_read_gyro_buffer(int fd, short *data, long long *timestamp);
     int inv_float_to_q16(float *fdata, long *ldata);
@@ -207,21 +341,60 @@ protected:
     int inv_read_sensor_bias(int fd, long *data);
     void inv_get_sensors_orientation(void);
     int inv_init_sysfs_attributes(void);
+    void fillSysfsNames(const char *sysfs_path, const char *iio_trigger_path);
 #ifdef COMPASS_YAS53x
     int resetCompass(void);
+    void saveCompassCal();
+    void checkCompassWarmStart();
 #endif
+    void dropCompassCal();
     void setCompassDelay(int64_t ns);
     void enable_iio_sysfs(void);
     int enableTap(int);
     int enableFlick(int);
     int enablePedometer(int);
+    int enableSignificantMotion(int);
+    int enableEventFeature(int feature, int en, int (MPLSensor::*writer)(int));
+    int writeTap(int en);
+    int writeFlick(int en);
+    int writePedometer(int en);
+    int writeSigMotion(int en);
+    int dmpEventsWanted();
+    int accelEventsWanted();
     int checkLPQuaternion();
+    long fifoSensorMask();
 
     int mNewData;   // flag indicating that the MPL calculated new output values
     int mDmpStarted;
     long mMasterSensorMask;
     long mLocalSensorMask;
-    int mPollTime;
+    int mDmpQuatOnly;       // rv/gravity served from the DMP quaternion alone
+    int mMplModules;        // optional MPL modules running, see updateMplModules
+    float mDmpQuat[4];      // last DMP quaternion, w x y z, unit length
+    int64_t mDmpQuatTimestamp;
+    int mCompassSlow;           // compass at COMPASS_SETTLED_RATE
+    int64_t mCompassFastDelay;  // compass delay to go back to
+    int64_t mCompassSettledTs;  // compass settled since, 0 if not
+    unsigned char *mCompassCal; // MPL states saved by resetCompass, or NULL
+    size_t mCompassCalSize;
+    long mCompassCalBias[3];    // compass bias they were fitted with
+    float mCompassCalField;     // field strength they saw, uT
+    int mCompassWarmMatches;    // samples in a row seeing that field
+    bool mGyroParked;           // gyro off while the device is still
+    int64_t mNoMotionSince;     // no motion reported since, 0 if moving
+    long mParkAccel[3];         // accel when the gyro was parked
+    bool mRvSwitched;           // fusion source changed under the rv
+    float mRvLast[4];           // last rv sent, w x y z
+    int64_t mRvLastTs;
+    float mRvOffset[4];         // step taken out at the switch
+    int64_t mRvBlendStart;      // fading mRvOffset out since, 0 if not
+    int64_t mFusionSteadySince; // still at full accuracy since, 0 if not
+    long mSteadyAccel[3];       // accel at the last fusion run
+    int mFusionSkipped;         // scans dropped since the last fusion run
+    int mShakes;                // shakes of the last detection, 0 if sent
+    int mShakePeaks;            // accel peaks of the swing in progress
+    bool mShakeArmed;           // back under the re-arm level since the last peak
+    int64_t mShakeLastPeakTs;
     bool mHaveGoodMpuCal;   // flag indicating that the cal file can be written
     int mGyroAccuracy;      // value indicating the quality of the gyro calibr.
     int mAccelAccuracy;     // value indicating the quality of the accel calibr.
@@ -238,14 +411,33 @@ protected:
     int mpufifo_fd;
     int gyro_temperature_fd;
     int dmp_orient_fd;
+    int dmp_pedometer_fd;
+    int motion_fd;
 
     int mDmpOrientationEnabled;
+    int mDmpStepEnabled;    // StepDetector and StepCounter bits
+    uint64_t mStepCount;    // steps reported by the step counter so far
+    int mStepsHw;           // pedometer_steps at the last read
 
 
     uint32_t mEnabled;
     uint32_t mOldEnabledMask;
+
+    /* enable/delay changes batched into a single master enable cycle */
+    bool mReconfigOpen;
+    int64_t mReconfigDeadline;
+    int mMasterWanted;  // deferred master enable, -1 if untouched
+    int mPowerWanted;   // deferred power state, -1 if untouched
     sensors_event_t mPendingEvents[numSensors];
     int64_t mDelays[numSensors];
+    int64_t mNextEventTs[numSensors];   // next decimated event due, 0 to restart
+    int64_t mHwDelay;                   // period the MPU actually runs at
+    int64_t mLastScanTs;                // last scan timestamp of the last batch
+    int64_t mOdrNominal;    // FIFO period asked for, ns
+    int64_t mOdrInterval;   // smoothed measured scan interval, 0 until primed
+    int64_t mOdrPushed;     // period the MPL was last given
+    int64_t mOdrLastTs;
+    int mOdrSamples;
     hfunc_t mHandlers[numSensors];
     short mCachedGyroData[3];
     long mCachedAccelData[3];
@@ -256,13 +448,30 @@ protected:
     InputEventCircularReader mAccelInputReader;
     InputEventCircularReader mGyroInputReader;
 
+    /* IIO scans parsed by the ingest thread, waiting for fusion */
+    IIOSampleRing mSampleRing;
+    /* third party compass samples waiting for the MPU scan they belong to */
+    IIOSampleRing mCompassQueue;
+    bool mIngestRunning;
+    pthread_t mIngestThread;
+    int mIngestPipe[2];     // wakes the poll loop when scans are queued
+    int mIngestStop[2];
+
+    iio_read_stats mReadStats;
+    void countRead(ssize_t rsize, int nbyte);
+
     bool mFirstRead;
     short mTempScale;
     short mTempOffset;
     int64_t mTempCurrentTime;
+    int64_t mIngestTempTime;    // last temperature read by the ingest thread
+    bool mTempFifo;             // temperature channel in the gyro scans
+    int mTempDecimation;        // scans per temperature sent to the MPL
+    int mTempScans;             // scans since the last one sent
     int mAccelScale;
 
     uint32_t mPendingMask;
+    int mNewDataMode;   // INV_*_NEW inputs built since the last executeOnData
     unsigned long mSensorMask;
 
     char chip_ID[MAX_CHIP_ID_LEN];
@@ -283,6 +492,17 @@ protected:
        char *dmp_event_int_on;
        char *dmp_output_rate;
        char *tap_on;
+       char *flick_int_on;
+       char *flick_upper;
+       char *flick_lower;
+       char *flick_counter;
+       char *pedometer_on;
+       char *pedometer_int_on;
+       char *pedometer_steps;
+       char *motion_lpa_on;
+       char *motion_lpa_threshold;
+       char *motion_lpa_duration;
+       char *motion_lpa_freq;
        char *key;
        char *self_test;
        char *temperature;
@@ -293,6 +513,7 @@ protected:
        char *gyro_x_fifo_enable;
        char *gyro_y_fifo_enable;
        char *gyro_z_fifo_enable;
+       char *temp_fifo_enable;
 
        char *accel_enable;
        char *accel_fifo_rate;
@@ -316,9 +537,11 @@ protected:
 
        char *display_orientation_on;
        char *event_display_orientation;
+       char *event_pedometer;
+       char *event_accel_motion;
     } mpu;
 
-    char *sysfs_names_ptr;
+    char *sysfs_names_ptr;  // NULL while mpu points into the shared paths
     int mFeatureActiveMask;
 
 private:
@@ -328,12 +551,19 @@ private:
     void fillRV(struct sensor_t *list);
     void fillOrientation(struct sensor_t *list);
     void fillGravity(struct sensor_t *list);
+    void fillGameRV(struct sensor_t *list);
     void fillLinearAccel(struct sensor_t *list);
     void storeCalibration();
     void loadDMP();
     bool isMpu3050();
     int isLowPowerQuatEnabled();
+    int isDmpQuatOnly(int enabled_sensors);
     int isDmpDisplayOrientationOn();
+    int isDmpPedometerOn();
+    void openDmpPedometerFd();
+    int isSigMotionOn();
+    void openSigMotionFd();
+    bool hasEventNode(int handle);
 
 
 };
@@ -20,6 +20,10 @@
 #include <string.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/utsname.h>
 
 #include "log.h"
 #include "SensorBase.h"
@@ -27,6 +31,28 @@
 #include "ml_sysfs_helper.h"
 #include "local_log_def.h"
 
+#ifdef INV_HAL_DEBUG_LOG
+#include <stdlib.h>
+#include <cutils/properties.h>
+
+int inv_log_mask;
+
+/* debug flavor: the LOGV enablers of local_log_def.h come from the
+   debug.sensors.inv_log property, e.g. 0x41 for process and input data */
+void inv_load_log_mask(void)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get("debug.sensors.inv_log", value, "0");
+    inv_log_mask = strtol(value, NULL, 0);
+    LOGI("HAL:log mask 0x%x", inv_log_mask);
+}
+#else
+void inv_load_log_mask(void)
+{
+}
+#endif
+
 int64_t getTimestamp()
 {
     struct timespec t;
@@ -135,10 +161,156 @@ int write_attribute_sensor(int fd, long data)
     return num_b;
 }
 
+/* Persistent handles on the integer sysfs attributes so the enable and
+ * rate paths do not pay an open/close per access. Entries are keyed by
+ * path, not by pointer, since some attributes are reached through more
+ * than one name (gyro and accel fifo rate are the same node).
+ */
+#define SYSFS_CACHE_MAX 56
+
+struct sysfs_attr_handle {
+    char *path;
+    int fd;
+    int last;       // last value written or read back
+    bool valid;     // last holds what the node currently contains
+};
+
+static struct sysfs_attr_handle sysfsCache[SYSFS_CACHE_MAX];
+static int sysfsCacheCount = 0;
+static pthread_mutex_t sysfsCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct sysfs_attr_handle *sysfs_cache_find(const char *filename)
+{
+    for (int i = 0; i < sysfsCacheCount; i++) {
+        if (!strcmp(sysfsCache[i].path, filename))
+            return &sysfsCache[i];
+    }
+    return NULL;
+}
+
+/**
+ *  @brief  Keep the sysfs attribute open for later read_sysfs_int and
+ *          write_sysfs_int calls on the same path.
+ *  @param  filename
+ *              the attribute path
+ *  @return 0 on success, a negative errno otherwise.
+ */
+int inv_sysfs_cache_add(char *filename)
+{
+    int fd, res = 0;
+
+    if (filename == NULL || filename[0] == '\0')
+        return -EINVAL;
+
+    pthread_mutex_lock(&sysfsCacheLock);
+    if (sysfs_cache_find(filename) != NULL)
+        goto out;
+    if (sysfsCacheCount >= SYSFS_CACHE_MAX) {
+        res = -ENOSPC;
+        goto out;
+    }
+    fd = open(filename, O_RDWR);
+    if (fd < 0)
+        fd = open(filename, O_WRONLY);
+    if (fd < 0)
+        fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        res = -errno;
+        LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:not caching %s (%d)", filename, res);
+        goto out;
+    }
+    sysfsCache[sysfsCacheCount].path = strdup(filename);
+    if (sysfsCache[sysfsCacheCount].path == NULL) {
+        close(fd);
+        res = -ENOMEM;
+        goto out;
+    }
+    sysfsCache[sysfsCacheCount].fd = fd;
+    sysfsCache[sysfsCacheCount].valid = false;
+    sysfsCacheCount++;
+out:
+    pthread_mutex_unlock(&sysfsCacheLock);
+    return res;
+}
+
+/* Close every cached sysfs attribute */
+void inv_sysfs_cache_release(void)
+{
+    pthread_mutex_lock(&sysfsCacheLock);
+    for (int i = 0; i < sysfsCacheCount; i++) {
+        close(sysfsCache[i].fd);
+        free(sysfsCache[i].path);
+    }
+    sysfsCacheCount = 0;
+    pthread_mutex_unlock(&sysfsCacheLock);
+}
+
+/* Forget the last value so the next write always reaches the node */
+void inv_sysfs_cache_invalidate(void)
+{
+    pthread_mutex_lock(&sysfsCacheLock);
+    for (int i = 0; i < sysfsCacheCount; i++)
+        sysfsCache[i].valid = false;
+    pthread_mutex_unlock(&sysfsCacheLock);
+}
+
+static int sysfs_cache_read(struct sysfs_attr_handle *h, int *var)
+{
+    char buf[32];
+    int count;
+
+    count = pread(h->fd, buf, sizeof(buf) - 1, 0);
+    if (count < 0) {
+        count = -errno;
+        LOGE("HAL:ERR read %s failed with error %d", h->path, count);
+        return count;
+    }
+    buf[count] = '\0';
+    if (sscanf(buf, "%d", var) < 1) {
+        LOGE("HAL:ERR failed to read an int from %s.", h->path);
+        return -EINVAL;
+    }
+    h->last = *var;
+    h->valid = true;
+    return 0;
+}
+
+static int sysfs_cache_write(struct sysfs_attr_handle *h, int var)
+{
+    char buf[16];
+    int len, nb;
+
+    if (h->valid && h->last == var) {
+        LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:%s already %d", h->path, var);
+        return 0;
+    }
+    len = snprintf(buf, sizeof(buf), "%d\n", var);
+    nb = pwrite(h->fd, buf, len, 0);
+    if (nb < 0) {
+        int res = -errno;
+        h->valid = false;
+        LOGE("HAL:ERR failed to write %d to %s (err=%d)", var, h->path, res);
+        return res;
+    }
+    h->last = var;
+    h->valid = true;
+    return 0;
+}
+
 int read_sysfs_int(char *filename, int *var)
 {
     int res=0;
     FILE  *sysfsfp;
+    struct sysfs_attr_handle *h;
+
+    pthread_mutex_lock(&sysfsCacheLock);
+    h = sysfs_cache_find(filename);
+    if (h != NULL) {
+        res = sysfs_cache_read(h, var);
+        pthread_mutex_unlock(&sysfsCacheLock);
+        return res;
+    }
+    pthread_mutex_unlock(&sysfsCacheLock);
 
     sysfsfp = fopen(filename, "r");
     if (sysfsfp != NULL) {
@@ -159,8 +331,19 @@ int write_sysfs_int(char *filename, int var)
     int res = 0;
     FILE  *sysfsfp;
 
+    struct sysfs_attr_handle *h;
+
     LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:echo %d > %s (%lld)",
             var, filename, getTimestamp());
+    pthread_mutex_lock(&sysfsCacheLock);
+    h = sysfs_cache_find(filename);
+    if (h != NULL) {
+        res = sysfs_cache_write(h, var);
+        pthread_mutex_unlock(&sysfsCacheLock);
+        return res;
+    }
+    pthread_mutex_unlock(&sysfsCacheLock);
+
     sysfsfp = fopen(filename, "w");
     if (sysfsfp == NULL) {
         res = -errno;
@@ -188,3 +371,191 @@ int write_sysfs_int(char *filename, int var)
     }
     return res;
 }
+
+/*
+ * Resolving the IIO topology walks /proc/bus/input and reads the name of
+ * every iio:device to find the MPU, its trigger and its device node, and
+ * then reads the mounting matrices. None of it changes unless the kernel
+ * does, so the result is kept in TOPOLOGY_FILE keyed on the kernel build
+ * and reused on the next HAL start as long as the nodes it names still
+ * exist. Any mismatch simply falls back to a full discovery.
+ */
+#ifndef TOPOLOGY_FILE
+#define TOPOLOGY_FILE "/data/inv_hal_topology.bin"
+#endif
+#define TOPOLOGY_TMP_FILE TOPOLOGY_FILE ".tmp"
+#define TOPOLOGY_MAGIC    0x544f504fu   /* "TOPO" */
+#define TOPOLOGY_VERSION  1
+
+struct topology_file {
+    unsigned int magic;
+    unsigned int version;
+    char kernel[2 * sizeof(((struct utsname *)0)->release)];
+    struct inv_topology topo;
+};
+
+static struct inv_topology topology;
+static bool topologyResolved = false;
+static pthread_mutex_t topologyLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void topology_kernel_id(char *id, size_t len)
+{
+    struct utsname u;
+
+    memset(id, 0, len);
+    if (uname(&u) == 0)
+        snprintf(id, len, "%s %s", u.release, u.version);
+}
+
+static bool topology_load(void)
+{
+    struct topology_file f;
+    char kernel[sizeof(f.kernel)];
+    FILE *fp;
+    size_t n;
+
+    fp = fopen(TOPOLOGY_FILE, "rb");
+    if (fp == NULL)
+        return false;
+    n = fread(&f, 1, sizeof(f), fp);
+    fclose(fp);
+    if (n != sizeof(f)
+            || f.magic != TOPOLOGY_MAGIC || f.version != TOPOLOGY_VERSION)
+        return false;
+
+    topology_kernel_id(kernel, sizeof(kernel));
+    if (kernel[0] == '\0' || strncmp(kernel, f.kernel, sizeof(kernel)))
+        return false;
+
+    f.topo.sysfs_path[sizeof(f.topo.sysfs_path) - 1] = '\0';
+    f.topo.trigger_path[sizeof(f.topo.trigger_path) - 1] = '\0';
+    f.topo.device_node[sizeof(f.topo.device_node) - 1] = '\0';
+    f.topo.chip_name[sizeof(f.topo.chip_name) - 1] = '\0';
+    if (access(f.topo.sysfs_path, F_OK) || access(f.topo.device_node, F_OK))
+        return false;
+
+    topology = f.topo;
+    return true;
+}
+
+/* call with topologyLock held */
+static void topology_save(void)
+{
+    struct topology_file f;
+    FILE *fp;
+    int res;
+
+    memset(&f, 0, sizeof(f));
+    f.magic = TOPOLOGY_MAGIC;
+    f.version = TOPOLOGY_VERSION;
+    topology_kernel_id(f.kernel, sizeof(f.kernel));
+    if (f.kernel[0] == '\0')
+        return;
+    f.topo = topology;
+
+    fp = fopen(TOPOLOGY_TMP_FILE, "wb");
+    if (fp == NULL) {
+        LOGV_IF(PROCESS_VERBOSE, "HAL:couldn't create %s err=%d",
+                TOPOLOGY_TMP_FILE, errno);
+        return;
+    }
+    res = (fwrite(&f, 1, sizeof(f), fp) == sizeof(f)) ? 0 : -1;
+    if (fclose(fp) != 0)
+        res = -1;
+    if (res == 0 && rename(TOPOLOGY_TMP_FILE, TOPOLOGY_FILE) == 0)
+        return;
+    unlink(TOPOLOGY_TMP_FILE);
+}
+
+static bool topology_discover(void)
+{
+    memset(&topology, 0, sizeof(topology));
+
+    if (INV_SUCCESS != inv_get_sysfs_path(topology.sysfs_path)) {
+        LOGE("HAL:failed to get sysfs path");
+        return false;
+    }
+    if (INV_SUCCESS != inv_get_iio_trigger_path(topology.trigger_path)) {
+        LOGE("HAL:failed to get iio trigger path");
+        return false;
+    }
+    if (inv_get_chip_name(topology.chip_name) != INV_SUCCESS) {
+        LOGE("HAL:ERR- Failed to get chip ID\n");
+        topology.chip_name[0] = '\0';
+    }
+    if (inv_get_iio_device_node(topology.device_node) < 0) {
+        LOGE("HAL:could retrive the iio device node");
+        return false;
+    }
+    return true;
+}
+
+/**
+ *  @brief  Return the resolved IIO topology, discovering it on first use.
+ *  @return NULL if the MPU could not be found.
+ */
+const struct inv_topology *inv_get_topology(void)
+{
+    const struct inv_topology *res;
+
+    pthread_mutex_lock(&topologyLock);
+    if (!topologyResolved) {
+        if (topology_load()) {
+            LOGV_IF(PROCESS_VERBOSE, "HAL:topology loaded from %s",
+                    TOPOLOGY_FILE);
+            topologyResolved = true;
+        } else if (topology_discover()) {
+            topologyResolved = true;
+            topology_save();
+        }
+    }
+    res = topologyResolved ? &topology : NULL;
+    pthread_mutex_unlock(&topologyLock);
+    return res;
+}
+
+/**
+ *  @brief  Read a mounting matrix, from the topology cache if it holds one
+ *          or else from the sysfs attribute at path.
+ *  @param  which   INV_TOPOLOGY_*_ORIENT.
+ *  @param  om      receives the 9 entries, row major.
+ *  @return 0 on success, negative if the matrix couldn't be read.
+ */
+int inv_read_topology_orientation(int which, const char *path, int *om)
+{
+    FILE *fptr;
+    int i, n;
+
+    if (which < 0 || which >= INV_TOPOLOGY_NUM_ORIENT)
+        return -EINVAL;
+
+    pthread_mutex_lock(&topologyLock);
+    if (topologyResolved && (topology.orient_valid & (1u << which))) {
+        for (i = 0; i < 9; i++)
+            om[i] = topology.orient[which][i];
+        pthread_mutex_unlock(&topologyLock);
+        return 0;
+    }
+    pthread_mutex_unlock(&topologyLock);
+
+    LOGV_IF(SYSFS_VERBOSE, "HAL:sysfs:cat %s (%lld)", path, getTimestamp());
+    fptr = fopen(path, "r");
+    if (fptr == NULL)
+        return -errno;
+    n = fscanf(fptr, "%d,%d,%d,%d,%d,%d,%d,%d,%d",
+               &om[0], &om[1], &om[2], &om[3], &om[4], &om[5],
+               &om[6], &om[7], &om[8]);
+    fclose(fptr);
+    if (n != 9)
+        return -EINVAL;
+
+    pthread_mutex_lock(&topologyLock);
+    if (topologyResolved) {
+        for (i = 0; i < 9; i++)
+            topology.orient[which][i] = om[i];
+        topology.orient_valid |= 1u << which;
+        topology_save();
+    }
+    pthread_mutex_unlock(&topologyLock);
+    return 0;
+}
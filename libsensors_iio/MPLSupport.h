@@ -22,6 +22,7 @@
 
 int64_t getTimestamp();
 int64_t timevalToNano(timeval const& t);
+void inv_load_log_mask(void);
 
 int inv_read_data(char *fname, long *data);
 int read_attribute_sensor(int fd, char* data, unsigned int size);
@@ -29,5 +30,31 @@ int enable_sysfs_sensor(int fd, int en);
 int write_attribute_sensor(int fd, long data);
 int read_sysfs_int(char*, int*);
 int write_sysfs_int(char*, int);
+int inv_sysfs_cache_add(char*);
+void inv_sysfs_cache_invalidate(void);
+void inv_sysfs_cache_release(void);
+
+/* IIO topology resolved at HAL start, cached across HAL restarts */
+#define INV_TOPOLOGY_NAME_LEN   (100)
+#define INV_TOPOLOGY_CHIP_LEN   (20)
+
+enum {
+    INV_TOPOLOGY_GYRO_ORIENT = 0,
+    INV_TOPOLOGY_ACCEL_ORIENT,
+    INV_TOPOLOGY_COMPASS_ORIENT,
+    INV_TOPOLOGY_NUM_ORIENT
+};
+
+struct inv_topology {
+    char sysfs_path[INV_TOPOLOGY_NAME_LEN];
+    char trigger_path[INV_TOPOLOGY_NAME_LEN];
+    char device_node[INV_TOPOLOGY_NAME_LEN];
+    char chip_name[INV_TOPOLOGY_CHIP_LEN];
+    signed char orient[INV_TOPOLOGY_NUM_ORIENT][9];
+    unsigned int orient_valid;
+};
+
+const struct inv_topology *inv_get_topology(void);
+int inv_read_topology_orientation(int which, const char *path, int *om);
 
 #endif //  ANDROID_MPL_SUPPORT_H
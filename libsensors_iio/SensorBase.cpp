@@ -18,61 +18,69 @@
 #include <errno.h>
 #include <math.h>
 #include <poll.h>
+#include <unistd.h>
 #include <dirent.h>
+#include <string.h>
+#include <time.h>
 #include <sys/select.h>
 #include <cutils/log.h>
 #include <linux/input.h>
 
 #include "SensorBase.h"
+#include "iio/events.h"
 #include "local_log_def.h"
 
+#define IIO_MAX_NAME_LENGTH 30
+
+static const char *iio_dir = IIO_SYSFS_DIR "/";
+
 /*****************************************************************************/
 
 SensorBase::SensorBase(const char* dev_name,
-                       const char* data_name) : dev_name(dev_name),
-                                                data_name(data_name),
-                                                dev_fd(-1),
-                                                data_fd(-1)
+                       const char* data_name) : mDevName(dev_name),
+                                                mDataName(data_name),
+                                                mDevFd(-1),
+                                                mDataFd(-1)
 {
-    if (data_name) {
-        data_fd = openInput(data_name);
+    if (mDataName) {
+        mDataFd = openInput(mDataName);
     }
 }
 
 SensorBase::~SensorBase()
 {
-    if (data_fd >= 0) {
-        close(data_fd);
+    if (mDataFd >= 0) {
+        close(mDataFd);
     }
-    if (dev_fd >= 0) {
-        close(dev_fd);
+    if (mDevFd >= 0) {
+        close(mDevFd);
     }
 }
 
-int SensorBase::open_device()
+int SensorBase::openDevice()
 {
-    if (dev_fd<0 && dev_name) {
-        dev_fd = open(dev_name, O_RDONLY);
-        LOGE_IF(dev_fd<0, "Couldn't open %s (%s)", dev_name, strerror(errno));
+    if (mDevFd < 0 && mDevName) {
+        mDevFd = open(mDevName, O_RDONLY);
+        LOGE_IF(mDevFd < 0, "Couldn't open %s (%s)", mDevName, strerror(errno));
     }
     return 0;
 }
 
-int SensorBase::close_device()
+int SensorBase::closeDevice()
 {
-    if (dev_fd >= 0) {
-        close(dev_fd);
-        dev_fd = -1;
+    if (mDevFd >= 0) {
+        close(mDevFd);
+        mDevFd = -1;
     }
     return 0;
 }
 
 int SensorBase::getFd() const
 {
-    if (!data_name) {
-        return dev_fd;
+    if (!mDataName) {
+        return mDevFd;
     }
-    return data_fd;
+    return mDataFd;
 }
 
 int SensorBase::setDelay(int32_t handle, int64_t ns)
@@ -85,47 +93,93 @@ bool SensorBase::hasPendingEvents() const
     return false;
 }
 
-int SensorBase::openInput(const char *inputName)
+int64_t SensorBase::getTimestamp()
+{
+    struct timespec t;
+    t.tv_sec = t.tv_nsec = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return int64_t(t.tv_sec) * 1000000000LL + t.tv_nsec;
+}
+
+/*
+ * find_type_by_name() - function to match top level types by name
+ * @name: top level type instance name
+ * @type: the type of top level instance being sort
+ *
+ * Typical types this is used for are device and trigger.
+ *
+ * NOTE: This function is copied from drivers/staging/iio/Documentation/iio_utils.h
+ * and modified.
+ */
+int SensorBase::findTypeByName(const char *name, const char *type)
+{
+    const struct dirent *ent;
+    int iio_id;
+    int ret = -ENODEV;
+
+    FILE *nameFile;
+    DIR *dp;
+    char thisname[IIO_MAX_NAME_LENGTH];
+    char filename[PATH_MAX];
+
+    dp = opendir(iio_dir);
+    if (dp == NULL) {
+        LOGE("No industrialio devices available");
+        return ret;
+    }
+
+    while (ent = readdir(dp), ent != NULL) {
+        if (strcmp(ent->d_name, ".") != 0 &&
+            strcmp(ent->d_name, "..") != 0 &&
+            strlen(ent->d_name) > strlen(type) &&
+            strncmp(ent->d_name, type, strlen(type)) == 0) {
+            if (sscanf(ent->d_name + strlen(type), "%d", &iio_id) != 1)
+                continue;
+
+            sprintf(filename, "%s%s%d/name", iio_dir, type, iio_id);
+            nameFile = fopen(filename, "r");
+            if (!nameFile)
+                continue;
+
+            if (fscanf(nameFile, "%s", thisname) == 1) {
+                if (strcmp(name, thisname) == 0) {
+                    fclose(nameFile);
+                    ret = iio_id;
+                    break;
+                }
+            }
+            fclose(nameFile);
+        }
+    }
+    closedir(dp);
+    return ret;
+}
+
+int SensorBase::openInput(const char* inputName)
 {
-    int fd = -1;
-    const char *dirname = "/dev/input";
+    int event_fd = -1;
     char devname[PATH_MAX];
-    char *filename;
-    DIR *dir;
-    struct dirent *de;
-    dir = opendir(dirname);
-    if(dir == NULL)
-        return -1;
-    strcpy(devname, dirname);
-    filename = devname + strlen(devname);
-    *filename++ = '/';
-    while((de = readdir(dir))) {
-        if(de->d_name[0] == '.' &&
-                (de->d_name[1] == '\0' ||
-                        (de->d_name[1] == '.' && de->d_name[2] == '\0')))
-            continue;
-        strcpy(filename, de->d_name);
+    int dev_num;
+
+    dev_num =  findTypeByName(inputName, "iio:device");
+    if (dev_num >= 0) {
+        int fd;
+        sprintf(devname, IIO_DEV_DIR "/iio:device%d", dev_num);
         fd = open(devname, O_RDONLY);
-        LOGV_IF(EXTRA_VERBOSE, "path open %s", devname);
-        LOGI("path open %s", devname);
         if (fd >= 0) {
-            char name[80];
-            if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), &name) < 1) {
-                name[0] = '\0';
-            }
-            LOGV_IF(EXTRA_VERBOSE, "name read %s", name);
-            if (!strcmp(name, inputName)) {
-                strcpy(input_name, filename);
-                break;
-            } else {
-                close(fd);
-                fd = -1;
-            }
+            /* a device without events can still be read through its buffer */
+            sprintf(mInputName, "iio:device%d", dev_num);
+            if (ioctl(fd, IIO_GET_EVENT_FD_IOCTL, &event_fd) < 0)
+                LOGE("couldn't get a event fd from %s", devname);
+            close(fd); /* close /dev/iio:device* */
+        } else {
+            LOGE("couldn't open %s (%s)", devname, strerror(errno));
         }
+    } else {
+       LOGE("couldn't find the device %s", inputName);
     }
-    closedir(dir);
-    LOGE_IF(fd < 0, "couldn't find '%s' input device", inputName);
-    return fd;
+
+    return event_fd;
 }
 
 int SensorBase::enable(int32_t handle, int enabled)
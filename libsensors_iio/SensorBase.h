@@ -27,24 +27,36 @@
 #define MAX_SYSFS_NAME_LEN  (100)
 #define IIO_BUFFER_LENGTH   (480)
 
+/* where IIO devices are found, a bench or test build can point these at a
+   fake tree */
+#ifndef IIO_SYSFS_DIR
+#define IIO_SYSFS_DIR       "/sys/bus/iio/devices"
+#endif
+#ifndef IIO_DEV_DIR
+#define IIO_DEV_DIR         "/dev"
+#endif
+
 /*****************************************************************************/
 
 struct sensors_event_t;
 
 class SensorBase {
 protected:
-    const char *dev_name;
-    const char *data_name;
-    char input_name[PATH_MAX];
-    int dev_fd;
-    int data_fd;
+    const char* mDevName;
+    const char* mDataName;
+    char        mInputName[PATH_MAX];
+    int         mDevFd;
+    int         mDataFd;
 
+    int findTypeByName(const char *name, const char *type);
     int openInput(const char* inputName);
-
-    int open_device();
-    int close_device();
+    static int64_t getTimestamp();
+    int openDevice();
+    int closeDevice();
 
 public:
+    /* data_name is the IIO device whose event fd the sensor reads, the
+       same base serves the MPL sensors and the other HAL drivers */
             SensorBase(const char* dev_name, const char* data_name);
 
     virtual ~SensorBase();
@@ -3,6 +3,20 @@
 
 /* Log enablers, each of these independent */
 
+#ifdef INV_HAL_DEBUG_LOG
+/* debug flavor: the enablers are bits of the debug.sensors.inv_log
+   property, read once when the HAL starts (inv_load_log_mask()) */
+extern int inv_log_mask;
+
+#define PROCESS_VERBOSE (inv_log_mask & 0x01)
+#define EXTRA_VERBOSE   (inv_log_mask & 0x02)
+#define SYSFS_VERBOSE   (inv_log_mask & 0x04)
+#define FUNC_ENTRY      (inv_log_mask & 0x08)
+#define HANDLER_ENTRY   (inv_log_mask & 0x10)
+#define ENG_VERBOSE     (inv_log_mask & 0x20)
+#define INPUT_DATA      (inv_log_mask & 0x40)
+#define HANDLER_DATA    (inv_log_mask & 0x80)
+#else
 #define PROCESS_VERBOSE (0) /* process log messages */
 #define EXTRA_VERBOSE   (0) /* verbose log messages */
 #define SYSFS_VERBOSE   (0) /* log sysfs interactions as cat/echo for repro
@@ -14,6 +28,7 @@
 #define ENG_VERBOSE     (0) /* log some a lot more info about the internals */
 #define INPUT_DATA      (0) /* log the data input from the events */
 #define HANDLER_DATA    (0) /* log the data fetched from the handlers */
+#endif
 
 #if defined ANDROID_JELLYBEAN
 #define LOGV            ALOGV
@@ -38,6 +53,15 @@
 #warning "build for ICS or earlier version"
 #endif
 
+#ifndef INV_HAL_DEBUG_LOG
+/* release flavor: verbose logs are compiled out whatever LOG_NDEBUG says,
+   their arguments (getTimestamp() and the like) are never evaluated */
+#undef LOGV
+#undef LOGV_IF
+#define LOGV(...)           ((void)0)
+#define LOGV_IF(cond, ...)  ((void)0)
+#endif
+
 
 #define FUNC_LOG \
             LOGV("%s", __PRETTY_FUNCTION__)
@@ -27,6 +27,11 @@
 #define SENSORS_MAGNETIC_FIELD_HANDLE     (ID_M)
 #define SENSORS_ORIENTATION_HANDLE        (ID_O)
 #define SENSORS_SCREEN_ORIENTATION_HANDLE (ID_SO)
+#define SENSORS_STEP_DETECTOR_HANDLE      (ID_SD)
+#define SENSORS_STEP_COUNTER_HANDLE       (ID_SC)
+#define SENSORS_SIGNIFICANT_MOTION_HANDLE (ID_SM)
+#define SENSORS_SHAKE_HANDLE              (ID_SK)
+#define SENSORS_GAME_ROTATION_VECTOR_HANDLE (ID_GRV)
 
 /******************************************/
 //MPU9250 INV_COMPASS
@@ -44,9 +44,19 @@ enum {
     ID_RV,
     ID_LA,
     ID_GR,
-    ID_SO
+    ID_SO,
+    ID_SD,
+    ID_SC,
+    ID_SM,
+    ID_SK,
+    ID_GRV
 };
 
+/* sensors of the board HAL (libsensors) around the MPL ones */
+#define ID_AMAZON_BASE 16
+#define ID_L  (ID_AMAZON_BASE)
+#define ID_PR (ID_L + 1)
+
 /*****************************************************************************/
 
 /*
@@ -35,6 +35,13 @@ CFLAGS += -I$(INV_ROOT)/simple_apps/common
 CFLAGS += $(INV_INCLUDES)
 CFLAGS += $(INV_DEFINES)
 
+# NEON fixed point math, ARMv7 targets only
+ifeq ($(INV_USE_NEON),1)
+CFLAGS += -mfpu=neon
+CFLAGS += -mfloat-abi=softfp
+CFLAGS += -DINV_MATH_NEON
+endif
+
 LLINK  = -lc 
 LLINK += -lm 
 LLINK += -lutils 
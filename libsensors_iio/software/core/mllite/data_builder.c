@@ -19,6 +19,9 @@
 #define MPL_LOG_NDEBUG 0 /* Use 0 to turn on MPL_LOGV output */
 
 #include <string.h>
+#ifdef INV_PLAYBACK_DBG
+#include <time.h>
+#endif
 
 #include "ml_math_func.h"
 #include "data_builder.h"
@@ -37,6 +40,10 @@ struct process_t {
     inv_process_cb_func func;
     int priority;
     int data_required;
+#ifdef INV_PLAYBACK_DBG
+    unsigned long calls;
+    long long time_ns;
+#endif
 };
 
 struct inv_db_save_t {
@@ -57,20 +64,29 @@ struct inv_db_save_t {
     int compass_accuracy;
 };
 
+/** One entry per combination of the INV_*_NEW mode bits */
+#define INV_DATA_MODES 32
+
 struct inv_data_builder_t {
     int num_cb;
     struct process_t process[INV_MAX_DATA_CB];
+    /** Callbacks to run for each mode, as indexes into process in priority
+     *  order. Rebuilt whenever a callback is registered or unregistered. */
+    unsigned char dispatch[INV_DATA_MODES][INV_MAX_DATA_CB];
+    unsigned char num_dispatch[INV_DATA_MODES];
     struct inv_db_save_t save;
     int compass_disturbance;
 #ifdef INV_PLAYBACK_DBG
     int debug_mode;
     int last_mode;
     FILE *file;
+    int profile;
 #endif
 };
 
 void inv_apply_calibration(struct inv_single_sensor_t *sensor, const long *bias);
-static void inv_set_contiguous(void);
+static void inv_set_contiguous(int mode);
+static void inv_build_dispatch(void);
 
 static struct inv_data_builder_t inv_data_builder;
 static struct inv_sensor_cal_t sensors;
@@ -99,6 +115,45 @@ void inv_turn_off_data_logging()
     inv_data_builder.debug_mode = RD_NO_DEBUG;
     inv_data_builder.file = NULL;
 }
+
+/** Turn on or off timing of the data callbacks run by inv_execute_on_data().
+* Turning it on clears the counters.
+* @param[in] enable 1 to time the callbacks, 0 to stop.
+*/
+void inv_enable_data_cb_profiling(int enable)
+{
+    int kk;
+    if (enable) {
+        for (kk = 0; kk < inv_data_builder.num_cb; ++kk) {
+            inv_data_builder.process[kk].calls = 0;
+            inv_data_builder.process[kk].time_ns = 0;
+        }
+    }
+    inv_data_builder.profile = enable;
+}
+
+/** Get the time spent in each data callback since profiling was turned on.
+* @param[out] profile One entry per registered callback, in priority order.
+* @param[in] max Number of entries profile can hold.
+* @return Number of entries filled in.
+*/
+int inv_get_data_cb_profile(struct inv_data_cb_profile_t *profile, int max)
+{
+    int kk;
+    for (kk = 0; kk < inv_data_builder.num_cb && kk < max; ++kk) {
+        profile[kk].priority = inv_data_builder.process[kk].priority;
+        profile[kk].calls = inv_data_builder.process[kk].calls;
+        profile[kk].time_ns = inv_data_builder.process[kk].time_ns;
+    }
+    return kk;
+}
+
+static long long inv_profile_time_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
 #endif
 
 /** This function receives the data that was stored in non-volatile memory between power off */
@@ -176,6 +231,7 @@ void set_sensor_orientation_and_scale(struct inv_single_sensor_t *sensor,
 {
     sensor->sensitivity = sensitivity;
     sensor->orientation = orientation;
+    sensor->to_body_cal = inv_get_convert_to_body_calibrated((unsigned short)orientation);
 }
 
 /** Sets the Orientation and Sensitivity of the gyro data.
@@ -411,9 +467,51 @@ void inv_set_compass_orientation_and_scale(int orientation, long sensitivity)
 
 void inv_matrix_vector_mult(const long *A, const long *x, long *y)
 {
+#ifdef INV_USE_NEON_MATH
+    /* column by column: y += A[:,k] * x[k] */
+    int32_t c0[4] = { A[0], A[3], A[6], 0 };
+    int32_t c1[4] = { A[1], A[4], A[7], 0 };
+    int32_t c2[4] = { A[2], A[5], A[8], 0 };
+    int32_t out[4];
+    int32x4_t acc;
+
+    acc = inv_q_shift_mult4(vld1q_s32(c0), vdupq_n_s32(x[0]), 30);
+    acc = vaddq_s32(acc, inv_q_shift_mult4(vld1q_s32(c1), vdupq_n_s32(x[1]), 30));
+    acc = vaddq_s32(acc, inv_q_shift_mult4(vld1q_s32(c2), vdupq_n_s32(x[2]), 30));
+    vst1q_s32(out, acc);
+    y[0] = out[0];
+    y[1] = out[1];
+    y[2] = out[2];
+#else
     y[0] = inv_q30_mult(A[0], x[0]) + inv_q30_mult(A[1], x[1]) + inv_q30_mult(A[2], x[2]);
     y[1] = inv_q30_mult(A[3], x[0]) + inv_q30_mult(A[4], x[1]) + inv_q30_mult(A[5], x[2]);
     y[2] = inv_q30_mult(A[6], x[0]) + inv_q30_mult(A[7], x[1]) + inv_q30_mult(A[8], x[2]);
+#endif
+}
+
+/** Rebuilds the body frame copy of a sensor's bias if the bias or the
+* orientation changed since it was last built.
+* @param[in,out] sensor structure to modify
+* @param[in] bias bias in the mounting frame, in hardware units scaled by
+*                 2^16. Length 3.
+*/
+static void inv_update_body_bias(struct inv_single_sensor_t *sensor, const long *bias)
+{
+    // The bias only changes when a new one is solved for, so keep it in the
+    // body frame and rotate each sample once for both outputs.
+    if (sensor->body_bias_orientation != sensor->orientation ||
+        sensor->bias_chip[0] != bias[0] || sensor->bias_chip[1] != bias[1] ||
+        sensor->bias_chip[2] != bias[2]) {
+        long bias32[3];
+
+        bias32[0] = bias[0] >> 1;
+        bias32[1] = bias[1] >> 1;
+        bias32[2] = bias[2] >> 1;
+        inv_convert_to_body((unsigned short)sensor->orientation, bias32,
+                            sensor->body_bias);
+        memcpy(sensor->bias_chip, bias, sizeof(sensor->bias_chip));
+        sensor->body_bias_orientation = sensor->orientation;
+    }
 }
 
 /** Takes raw data stored in the sensor, removes bias, and converts it to
@@ -426,18 +524,20 @@ void inv_apply_calibration(struct inv_single_sensor_t *sensor, const long *bias)
 {
     long raw32[3];
 
+    inv_update_body_bias(sensor, bias);
+
     // Convert raw to calibrated
     raw32[0] = (long)sensor->raw[0] << 15;
     raw32[1] = (long)sensor->raw[1] << 15;
     raw32[2] = (long)sensor->raw[2] << 15;
 
-    inv_convert_to_body_with_scale(sensor->orientation, sensor->sensitivity << 1, raw32, sensor->raw_scaled);
-
-    raw32[0] -= bias[0] >> 1;
-    raw32[1] -= bias[1] >> 1;
-    raw32[2] -= bias[2] >> 1;
-
-    inv_convert_to_body_with_scale(sensor->orientation, sensor->sensitivity << 1, raw32, sensor->calibrated);
+    if (sensor->to_body_cal)
+        sensor->to_body_cal(sensor->sensitivity << 1, raw32, sensor->body_bias,
+                            sensor->raw_scaled, sensor->calibrated);
+    else
+        inv_convert_to_body_calibrated(sensor->orientation, sensor->sensitivity << 1,
+                                       raw32, sensor->body_bias,
+                                       sensor->raw_scaled, sensor->calibrated);
 
     sensor->status |= INV_CALIBRATED;
 }
@@ -608,6 +708,7 @@ inv_error_t inv_build_accel(const long *accel, int status, inv_time_t timestamp)
         int type = PLAYBACK_DBG_TYPE_ACCEL;
         fwrite(&type, sizeof(type), 1, inv_data_builder.file);
         fwrite(accel, sizeof(accel[0]), 3, inv_data_builder.file);
+        fwrite(&status, sizeof(status), 1, inv_data_builder.file);
         fwrite(&timestamp, sizeof(timestamp), 1, inv_data_builder.file);
     }
 #endif
@@ -679,6 +780,7 @@ inv_error_t inv_build_compass(const long *compass, int status,
         int type = PLAYBACK_DBG_TYPE_COMPASS;
         fwrite(&type, sizeof(type), 1, inv_data_builder.file);
         fwrite(compass, sizeof(compass[0]), 3, inv_data_builder.file);
+        fwrite(&status, sizeof(status), 1, inv_data_builder.file);
         fwrite(&timestamp, sizeof(timestamp), 1, inv_data_builder.file);
     }
 #endif
@@ -745,6 +847,7 @@ inv_error_t inv_build_quat(const long *quat, int status, inv_time_t timestamp)
         int type = PLAYBACK_DBG_TYPE_QUAT;
         fwrite(&type, sizeof(type), 1, inv_data_builder.file);
         fwrite(quat, sizeof(quat[0]), 4, inv_data_builder.file);
+        fwrite(&status, sizeof(status), 1, inv_data_builder.file);
         fwrite(&timestamp, sizeof(timestamp), 1, inv_data_builder.file);
     }
 #endif
@@ -757,11 +860,329 @@ inv_error_t inv_build_quat(const long *quat, int status, inv_time_t timestamp)
     return INV_SUCCESS;
 }
 
+/** Samples calibrated at a time by inv_build_batch() */
+#define INV_BATCH_CHUNK 32
+
+/** Body frame data for a chunk of one sensor's batch samples, along with the
+* settings it was calibrated with so a bias solved mid-batch is noticed.
+*/
+struct inv_batch_cal_t {
+    /** Index in the batch of the first sample in the chunk */
+    int first;
+    /** Number of samples calibrated, 0 if none */
+    int count;
+    long sensitivity;
+    int orientation;
+    long body_bias[3];
+    long raw_scaled[3][INV_BATCH_CHUNK];
+    long calibrated[3][INV_BATCH_CHUNK];
+};
+
+static struct inv_batch_cal_t inv_batch_cal[3];
+
+/** Scales a run of body frame values by a Q30 sensitivity in place.
+* @param[in,out] data Values to scale
+* @param[in] count Number of values
+* @param[in] sensitivity Sensitivity scale
+*/
+static void inv_batch_scale(long *data, int count, long sensitivity)
+{
+    int kk = 0;
+#ifdef INV_USE_NEON_MATH
+    int32x4_t s = vdupq_n_s32(sensitivity);
+
+    for (; kk + 4 <= count; kk += 4) {
+        vst1q_s32((int32_t *)&data[kk],
+                  inv_q_shift_mult4(vld1q_s32((const int32_t *)&data[kk]), s, 30));
+    }
+#endif
+    for (; kk < count; ++kk)
+        data[kk] = inv_q30_mult(data[kk], sensitivity);
+}
+
+/** Calibrates up to INV_BATCH_CHUNK raw samples of a sensor starting at
+* first, the same way inv_apply_calibration() does one sample. The
+* orientation must be a signed permutation.
+* @param[in,out] sensor Sensor the samples belong to
+* @param[in] bias bias in the mounting frame, in hardware units scaled by
+*                 2^16. Length 3.
+* @param[in] axis Raw x, y, z sample arrays
+* @param[in] first Index of the first sample to calibrate
+* @param[in] count Number of samples in the batch
+* @param[out] cal Calibrated chunk
+*/
+static void inv_batch_calibrate(struct inv_single_sensor_t *sensor,
+                                const long *bias, const long *const *axis,
+                                int first, int count,
+                                struct inv_batch_cal_t *cal)
+{
+    int row, kk;
+
+    inv_update_body_bias(sensor, bias);
+    cal->first = first;
+    cal->count = MIN(count - first, INV_BATCH_CHUNK);
+    cal->sensitivity = sensor->sensitivity;
+    cal->orientation = sensor->orientation;
+    memcpy(cal->body_bias, sensor->body_bias, sizeof(cal->body_bias));
+
+    for (row = 0; row < 3; ++row) {
+        int rot = sensor->orientation >> (3 * row);
+        const long *in = axis[rot & 0x03] + first;
+        long *raw_scaled = cal->raw_scaled[row];
+        long *calibrated = cal->calibrated[row];
+        long body;
+
+        for (kk = 0; kk < cal->count; ++kk) {
+            body = (long)(short)in[kk] << 15;
+            if (rot & 0x04)
+                body = -body;
+            raw_scaled[kk] = body;
+            calibrated[kk] = body - cal->body_bias[row];
+        }
+        inv_batch_scale(raw_scaled, cal->count, sensor->sensitivity << 1);
+        inv_batch_scale(calibrated, cal->count, sensor->sensitivity << 1);
+    }
+}
+
+/** Records one raw sample of a batch for a sensor, calibrating the next
+* chunk when the current one runs out or its settings went stale.
+* @param[in,out] sensor Sensor to update
+* @param[in] bias bias in the mounting frame, in hardware units scaled by
+*                 2^16. Length 3.
+* @param[in] batch Batch the sample is from
+* @param[in] axis Raw x, y, z sample arrays of the sensor in batch
+* @param[in] index Index of the sample
+* @param[in,out] cal Calibrated chunk of the sensor
+*/
+static void inv_batch_build_raw(struct inv_single_sensor_t *sensor,
+                                const long *bias,
+                                const struct inv_sensor_batch_t *batch,
+                                const long *const *axis, int index,
+                                struct inv_batch_cal_t *cal)
+{
+    int kk;
+
+    sensor->raw[0] = (short)axis[0][index];
+    sensor->raw[1] = (short)axis[1][index];
+    sensor->raw[2] = (short)axis[2][index];
+
+    inv_update_body_bias(sensor, bias);
+    if (index >= cal->first + cal->count ||
+        cal->sensitivity != sensor->sensitivity ||
+        cal->orientation != sensor->orientation ||
+        memcmp(cal->body_bias, sensor->body_bias, sizeof(cal->body_bias))) {
+        inv_batch_calibrate(sensor, bias, axis, index, batch->count, cal);
+    }
+    kk = index - cal->first;
+    sensor->raw_scaled[0] = cal->raw_scaled[0][kk];
+    sensor->raw_scaled[1] = cal->raw_scaled[1][kk];
+    sensor->raw_scaled[2] = cal->raw_scaled[2][kk];
+    sensor->calibrated[0] = cal->calibrated[0][kk];
+    sensor->calibrated[1] = cal->calibrated[1][kk];
+    sensor->calibrated[2] = cal->calibrated[2][kk];
+
+    sensor->status |= INV_NEW_DATA | INV_RAW_DATA | INV_CALIBRATED | INV_SENSOR_ON;
+    sensor->timestamp_prev = sensor->timestamp;
+    sensor->timestamp = batch->timestamp[index];
+}
+
+/** Record a run of samples and process each of them, as calling the
+* inv_build_*() functions and inv_execute_on_data() for every sample would.
+* Raw gyro, accel and compass data are calibrated a chunk at a time rather
+* than one sample at a time.
+* @param[in] batch Samples to process.
+* @param[in] sample_cb If not NULL, called after each sample has been
+*            processed, when its results can be read.
+* @param[in] user Passed to sample_cb.
+* @return Returns INV_SUCCESS if successful or the first error returned by
+*         processing a sample.
+*/
+inv_error_t inv_build_batch(const struct inv_sensor_batch_t *batch,
+                            inv_batch_sample_cb_t sample_cb, void *user)
+{
+    inv_error_t result, first_error = INV_SUCCESS;
+    int fast_gyro, fast_accel, fast_compass;
+    long data[4];
+    int kk;
+
+    if (batch == NULL || batch->count < 0 ||
+        (batch->count && batch->timestamp == NULL))
+        return INV_ERROR_INVALID_PARAMETER;
+
+    // Calibrated input and orientations without a specialized kernel take
+    // the per sample path, as does recording for playback.
+    fast_gyro = batch->gyro[0] && sensors.gyro.to_body_cal;
+    fast_accel = batch->accel[0] && sensors.accel.to_body_cal &&
+                 (batch->accel_status & INV_CALIBRATED) == 0;
+    fast_compass = batch->compass[0] && sensors.compass.to_body_cal &&
+                   (batch->compass_status & INV_CALIBRATED) == 0;
+#ifdef INV_PLAYBACK_DBG
+    if (inv_data_builder.debug_mode == RD_RECORD)
+        fast_gyro = fast_accel = fast_compass = 0;
+#endif
+    for (kk = 0; kk < 3; ++kk) {
+        inv_batch_cal[kk].first = 0;
+        inv_batch_cal[kk].count = 0;
+    }
+
+    for (kk = 0; kk < batch->count; ++kk) {
+        if (fast_gyro) {
+            inv_batch_build_raw(&sensors.gyro, inv_data_builder.save.gyro_bias,
+                                batch, batch->gyro, kk, &inv_batch_cal[0]);
+        } else if (batch->gyro[0]) {
+            short gyro[3];
+            gyro[0] = (short)batch->gyro[0][kk];
+            gyro[1] = (short)batch->gyro[1][kk];
+            gyro[2] = (short)batch->gyro[2][kk];
+            inv_build_gyro(gyro, batch->timestamp[kk]);
+        }
+        if (fast_accel) {
+            inv_batch_build_raw(&sensors.accel, inv_data_builder.save.accel_bias,
+                                batch, batch->accel, kk, &inv_batch_cal[1]);
+        } else if (batch->accel[0]) {
+            data[0] = batch->accel[0][kk];
+            data[1] = batch->accel[1][kk];
+            data[2] = batch->accel[2][kk];
+            inv_build_accel(data, batch->accel_status, batch->timestamp[kk]);
+        }
+        if (fast_compass) {
+            inv_batch_build_raw(&sensors.compass, inv_data_builder.save.compass_bias,
+                                batch, batch->compass, kk, &inv_batch_cal[2]);
+        } else if (batch->compass[0]) {
+            data[0] = batch->compass[0][kk];
+            data[1] = batch->compass[1][kk];
+            data[2] = batch->compass[2][kk];
+            inv_build_compass(data, batch->compass_status, batch->timestamp[kk]);
+        }
+        if (batch->quat[0]) {
+            data[0] = batch->quat[0][kk];
+            data[1] = batch->quat[1][kk];
+            data[2] = batch->quat[2][kk];
+            data[3] = batch->quat[3][kk];
+            inv_build_quat(data, batch->quat_status, batch->timestamp[kk]);
+        }
+
+        result = inv_execute_on_data();
+        if (result && !first_error)
+            first_error = result;
+        if (sample_cb)
+            sample_cb(kk, user);
+    }
+
+    return first_error;
+}
+
+/** Record and process a run of gyro samples, see inv_build_batch().
+* @param[in] gyro Gyro x, y, z arrays in device units, each length count.
+* @param[in] timestamp Monotonic time stamps, length count.
+* @param[in] count Number of samples.
+* @param[in] sample_cb If not NULL, called after each sample is processed.
+* @param[in] user Passed to sample_cb.
+* @return Returns INV_SUCCESS if successful or an error code if not.
+*/
+inv_error_t inv_build_gyro_batch(const long *const *gyro,
+                                 const inv_time_t *timestamp, int count,
+                                 inv_batch_sample_cb_t sample_cb, void *user)
+{
+    struct inv_sensor_batch_t batch;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.count = count;
+    batch.timestamp = timestamp;
+    batch.gyro[0] = gyro[0];
+    batch.gyro[1] = gyro[1];
+    batch.gyro[2] = gyro[2];
+    return inv_build_batch(&batch, sample_cb, user);
+}
+
+/** Record and process a run of accel samples, see inv_build_batch().
+* @param[in] accel Accel x, y, z arrays, each length count.
+* @param[in] status Same as for inv_build_accel(), for all samples.
+* @param[in] timestamp Monotonic time stamps, length count.
+* @param[in] count Number of samples.
+* @param[in] sample_cb If not NULL, called after each sample is processed.
+* @param[in] user Passed to sample_cb.
+* @return Returns INV_SUCCESS if successful or an error code if not.
+*/
+inv_error_t inv_build_accel_batch(const long *const *accel, int status,
+                                  const inv_time_t *timestamp, int count,
+                                  inv_batch_sample_cb_t sample_cb, void *user)
+{
+    struct inv_sensor_batch_t batch;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.count = count;
+    batch.timestamp = timestamp;
+    batch.accel[0] = accel[0];
+    batch.accel[1] = accel[1];
+    batch.accel[2] = accel[2];
+    batch.accel_status = status;
+    return inv_build_batch(&batch, sample_cb, user);
+}
+
+/** Record and process a run of compass samples, see inv_build_batch().
+* @param[in] compass Compass x, y, z arrays, each length count.
+* @param[in] status Same as for inv_build_compass(), for all samples.
+* @param[in] timestamp Monotonic time stamps, length count.
+* @param[in] count Number of samples.
+* @param[in] sample_cb If not NULL, called after each sample is processed.
+* @param[in] user Passed to sample_cb.
+* @return Returns INV_SUCCESS if successful or an error code if not.
+*/
+inv_error_t inv_build_compass_batch(const long *const *compass, int status,
+                                    const inv_time_t *timestamp, int count,
+                                    inv_batch_sample_cb_t sample_cb, void *user)
+{
+    struct inv_sensor_batch_t batch;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.count = count;
+    batch.timestamp = timestamp;
+    batch.compass[0] = compass[0];
+    batch.compass[1] = compass[1];
+    batch.compass[2] = compass[2];
+    batch.compass_status = status;
+    return inv_build_batch(&batch, sample_cb, user);
+}
+
+/** Record and process a run of quaternion samples, see inv_build_batch().
+* @param[in] quat Quaternion component arrays, real part first, each length
+*            count.
+* @param[in] status Same as for inv_build_quat(), for all samples.
+* @param[in] timestamp Monotonic time stamps, length count.
+* @param[in] count Number of samples.
+* @param[in] sample_cb If not NULL, called after each sample is processed.
+* @param[in] user Passed to sample_cb.
+* @return Returns INV_SUCCESS if successful or an error code if not.
+*/
+inv_error_t inv_build_quat_batch(const long *const *quat, int status,
+                                 const inv_time_t *timestamp, int count,
+                                 inv_batch_sample_cb_t sample_cb, void *user)
+{
+    struct inv_sensor_batch_t batch;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.count = count;
+    batch.timestamp = timestamp;
+    batch.quat[0] = quat[0];
+    batch.quat[1] = quat[1];
+    batch.quat[2] = quat[2];
+    batch.quat[3] = quat[3];
+    batch.quat_status = status;
+    return inv_build_batch(&batch, sample_cb, user);
+}
+
 /** This should be called when the accel has been turned off. This is so
 * that we will know if the data is contiguous.
 */
 void inv_accel_was_turned_off()
 {
+#ifdef INV_PLAYBACK_DBG
+    if (inv_data_builder.debug_mode == RD_RECORD) {
+        int type = PLAYBACK_DBG_TYPE_ACCEL_OFF;
+        fwrite(&type, sizeof(type), 1, inv_data_builder.file);
+    }
+#endif
     sensors.accel.status = 0;
 }
 
@@ -770,6 +1191,12 @@ void inv_accel_was_turned_off()
 */
 void inv_compass_was_turned_off()
 {
+#ifdef INV_PLAYBACK_DBG
+    if (inv_data_builder.debug_mode == RD_RECORD) {
+        int type = PLAYBACK_DBG_TYPE_COMPASS_OFF;
+        fwrite(&type, sizeof(type), 1, inv_data_builder.file);
+    }
+#endif
     sensors.compass.status = 0;
 }
 
@@ -786,6 +1213,12 @@ void inv_quaternion_sensor_was_turned_off(void)
 */
 void inv_gyro_was_turned_off()
 {
+#ifdef INV_PLAYBACK_DBG
+    if (inv_data_builder.debug_mode == RD_RECORD) {
+        int type = PLAYBACK_DBG_TYPE_GYRO_OFF;
+        fwrite(&type, sizeof(type), 1, inv_data_builder.file);
+    }
+#endif
     sensors.gyro.status = 0;
 }
 
@@ -846,6 +1279,7 @@ inv_error_t inv_register_data_cb(
         inv_data_builder.process[kk].priority = priority;
         inv_data_builder.process[kk].data_required = sensor_type;
         inv_data_builder.num_cb++;
+        inv_build_dispatch();
     } else {
         MPL_LOGE("Unable to add feature callback as too many were already registered\n");
         result = INV_ERROR_MEMORY_EXAUSTED;
@@ -878,6 +1312,7 @@ inv_error_t inv_unregister_data_cb(
                     inv_data_builder.process[nn];
             }
             inv_data_builder.num_cb--;
+            inv_build_dispatch();
             return INV_SUCCESS;
         }
     }
@@ -885,6 +1320,24 @@ inv_error_t inv_unregister_data_cb(
     return INV_SUCCESS;    // We did not find the callback
 }
 
+/** Precomputes, for every combination of new data, which callbacks
+* inv_execute_on_data() has to run so a sample does not test them all.
+*/
+static void inv_build_dispatch(void)
+{
+    int mode, kk;
+
+    for (mode = 0; mode < INV_DATA_MODES; ++mode) {
+        inv_data_builder.num_dispatch[mode] = 0;
+        for (kk = 0; kk < inv_data_builder.num_cb; ++kk) {
+            if (mode & inv_data_builder.process[kk].data_required) {
+                inv_data_builder.dispatch[mode]
+                    [inv_data_builder.num_dispatch[mode]++] = kk;
+            }
+        }
+    }
+}
+
 /** After at least one of inv_build_gyro(), inv_build_accel(), or
 * inv_build_compass() has been called, this function should be called.
 * It will process the data it has received and update all the internal states
@@ -894,7 +1347,8 @@ inv_error_t inv_unregister_data_cb(
 inv_error_t inv_execute_on_data(void)
 {
     inv_error_t result, first_error;
-    int kk;
+    int kk, num;
+    const unsigned char *dispatch;
     int mode;
 
 #ifdef INV_PLAYBACK_DBG
@@ -918,44 +1372,60 @@ inv_error_t inv_execute_on_data(void)
 
     first_error = INV_SUCCESS;
 
-    for (kk = 0; kk < inv_data_builder.num_cb; ++kk) {
-        if (mode & inv_data_builder.process[kk].data_required) {
-            result = inv_data_builder.process[kk].func(&sensors);
-            if (result && !first_error) {
-                first_error = result;
-            }
+    dispatch = inv_data_builder.dispatch[mode];
+    num = inv_data_builder.num_dispatch[mode];
+    for (kk = 0; kk < num; ++kk) {
+#ifdef INV_PLAYBACK_DBG
+        if (inv_data_builder.profile) {
+            struct process_t *p = &inv_data_builder.process[dispatch[kk]];
+            long long start = inv_profile_time_ns();
+            result = p->func(&sensors);
+            p->time_ns += inv_profile_time_ns() - start;
+            p->calls++;
+        } else
+#endif
+        result = inv_data_builder.process[dispatch[kk]].func(&sensors);
+        if (result && !first_error) {
+            first_error = result;
         }
     }
 
-    inv_set_contiguous();
+    inv_set_contiguous(mode);
 
     return first_error;
 }
 
 /** Cleans up status bits after running all the callbacks. It sets the contiguous flag.
-*
+* @param[in] mode The INV_*_NEW bits inv_execute_on_data() ran with, only
+*            those sensors have INV_NEW_DATA to clean up.
 */
-static void inv_set_contiguous(void)
+static void inv_set_contiguous(int mode)
 {
     inv_time_t current_time = 0;
-    if (sensors.gyro.status & INV_NEW_DATA) {
+    if (mode & INV_GYRO_NEW) {
         sensors.gyro.status |= INV_CONTIGUOUS;
+        sensors.gyro.status &= ~INV_NEW_DATA;
         current_time = sensors.gyro.timestamp;
     }
-    if (sensors.accel.status & INV_NEW_DATA) {
+    if (mode & INV_ACCEL_NEW) {
         sensors.accel.status |= INV_CONTIGUOUS;
+        sensors.accel.status &= ~INV_NEW_DATA;
         current_time = MAX(current_time, sensors.accel.timestamp);
     }
-    if (sensors.compass.status & INV_NEW_DATA) {
+    if (mode & INV_MAG_NEW) {
         sensors.compass.status |= INV_CONTIGUOUS;
+        sensors.compass.status &= ~INV_NEW_DATA;
         current_time = MAX(current_time, sensors.compass.timestamp);
     }
-    if (sensors.temp.status & INV_NEW_DATA) {
+    if (mode & INV_TEMP_NEW) {
         sensors.temp.status |= INV_CONTIGUOUS;
+        sensors.temp.status &= ~INV_NEW_DATA;
         current_time = MAX(current_time, sensors.temp.timestamp);
     }
+    /* quaternion mode is not keyed on INV_NEW_DATA, test it directly */
     if (sensors.quat.status & INV_NEW_DATA) {
         sensors.quat.status |= INV_CONTIGUOUS;
+        sensors.quat.status &= ~INV_NEW_DATA;
         current_time = MAX(current_time, sensors.quat.timestamp);
     }
 
@@ -973,13 +1443,6 @@ static void inv_set_contiguous(void)
     if (inv_delta_time_ms(current_time, sensors.temp.timestamp) >= 2000)
         inv_temperature_was_turned_off();
 #endif
-
-    /* clear bits */
-    sensors.gyro.status &= ~INV_NEW_DATA;
-    sensors.accel.status &= ~INV_NEW_DATA;
-    sensors.compass.status &= ~INV_NEW_DATA;
-    sensors.temp.status &= ~INV_NEW_DATA;
-    sensors.quat.status &= ~INV_NEW_DATA;
 }
 
 /** Gets a whole set of accel data including data, accuracy and timestamp.
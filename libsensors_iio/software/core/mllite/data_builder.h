@@ -89,6 +89,16 @@ struct inv_single_sensor_t {
     inv_time_t timestamp_prev;
     /** Bandwidth in Hz */
     int bandwidth;
+    /** Scaled chip to body conversion with bias removal for orientation,
+    * NULL if it has no specialized kernel */
+    void (*to_body_cal)(long sensitivity, const long *input,
+                        const long *body_bias, long *raw_out, long *cal_out);
+    /** Mounting frame bias the body frame bias was last built from */
+    long bias_chip[3];
+    /** Bias shifted down to raw << 15 units and rotated to the body frame */
+    long body_bias[3];
+    /** Orientation body_bias was built for */
+    int body_bias_orientation;
 };
 struct inv_quat_sensor_t {
     long raw[4];
@@ -114,6 +124,34 @@ struct inv_sensor_cal_t {
     int status;
 };
 
+/** A run of samples for inv_build_batch(), laid out structure-of-arrays.
+* Each sensor not in the batch has its axis pointers set to NULL. Data and
+* status follow the matching single sample inv_build_*() call.
+*/
+struct inv_sensor_batch_t {
+    /** Number of samples */
+    int count;
+    /** Monotonic time stamp of each sample, for Android it's in nanoseconds */
+    const inv_time_t *timestamp;
+    /** Gyro x, y, z in device units, each length count */
+    const long *gyro[3];
+    /** Accel x, y, z, each length count */
+    const long *accel[3];
+    int accel_status;
+    /** Compass x, y, z, each length count */
+    const long *compass[3];
+    int compass_status;
+    /** Quaternion components, real part first, each length count */
+    const long *quat[4];
+    int quat_status;
+};
+
+/** Called by inv_build_batch() after the processors ran on a sample
+* @param[in] index Index of the sample in the batch.
+* @param[in] user Pointer passed to inv_build_batch().
+*/
+typedef void (*inv_batch_sample_cb_t)(int index, void *user);
+
 // Useful for debug record and playback
 typedef enum {
     RD_NO_DEBUG,
@@ -148,6 +186,15 @@ typedef enum {
 #include <stdio.h>
 void inv_turn_on_data_logging(FILE *file);
 void inv_turn_off_data_logging();
+
+/** Time spent in one data callback, see inv_get_data_cb_profile() */
+struct inv_data_cb_profile_t {
+    int priority;           /**< INV_PRIORITY_* the callback registered with */
+    unsigned long calls;
+    long long time_ns;
+};
+void inv_enable_data_cb_profiling(int enable);
+int inv_get_data_cb_profile(struct inv_data_cb_profile_t *profile, int max);
 #endif
 
 void inv_set_gyro_orientation_and_scale(int orientation, long sensitivity);
@@ -181,6 +228,20 @@ inv_error_t inv_build_accel(const long *accel, int status,
 inv_error_t inv_build_temp(const long temp, inv_time_t timestamp);
 inv_error_t inv_build_quat(const long *quat, int status, inv_time_t timestamp);
 inv_error_t inv_execute_on_data(void);
+inv_error_t inv_build_batch(const struct inv_sensor_batch_t *batch,
+                            inv_batch_sample_cb_t sample_cb, void *user);
+inv_error_t inv_build_gyro_batch(const long *const *gyro,
+                                 const inv_time_t *timestamp, int count,
+                                 inv_batch_sample_cb_t sample_cb, void *user);
+inv_error_t inv_build_accel_batch(const long *const *accel, int status,
+                                  const inv_time_t *timestamp, int count,
+                                  inv_batch_sample_cb_t sample_cb, void *user);
+inv_error_t inv_build_compass_batch(const long *const *compass, int status,
+                                    const inv_time_t *timestamp, int count,
+                                    inv_batch_sample_cb_t sample_cb, void *user);
+inv_error_t inv_build_quat_batch(const long *const *quat, int status,
+                                 const inv_time_t *timestamp, int count,
+                                 inv_batch_sample_cb_t sample_cb, void *user);
 
 void inv_get_compass_bias(long *bias);
 
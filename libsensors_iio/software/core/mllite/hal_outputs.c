@@ -40,8 +40,13 @@ struct hal_output_t {
     int accel_status;
     int compass_status;
     int nine_axis_status;
-    inv_biquad_filter_t lp_filter[3];
+    inv_biquad_bank_t lp_filter;
     float compass_float[3];
+    /** Orientation angles for nav_quat, computed on the first request after
+    * nav_quat changes. */
+    float orientation[3];
+    int orientation_valid;
+    inv_time_t orientation_timestamp;
 };
 
 static struct hal_output_t hal_out;
@@ -108,15 +113,16 @@ int inv_get_sensor_type_linear_acceleration(float *values, int8_t *accuracy,
 int inv_get_sensor_type_gravity(float *values, int8_t *accuracy,
                                  inv_time_t * timestamp)
 {
-    long gravity[3];
+    struct inv_results_snapshot_t snap;
     int status;
 
-    *accuracy = (int8_t) hal_out.accuracy_quat;
-    *timestamp = hal_out.nav_timestamp;
-    inv_get_gravity(gravity);
-    values[0] = (gravity[0] >> 14) * ACCEL_CONVERSION;
-    values[1] = (gravity[1] >> 14) * ACCEL_CONVERSION;
-    values[2] = (gravity[2] >> 14) * ACCEL_CONVERSION;
+    // gravity, accuracy and timestamp all from the same sample
+    inv_get_results_snapshot(&snap);
+    *accuracy = (int8_t) snap.accuracy;
+    *timestamp = snap.timestamp;
+    values[0] = (snap.gravity[0] >> 14) * ACCEL_CONVERSION;
+    values[1] = (snap.gravity[1] >> 14) * ACCEL_CONVERSION;
+    values[2] = (snap.gravity[2] >> 14) * ACCEL_CONVERSION;
     if ((hal_out.accel_status & INV_NEW_DATA) || (hal_out.gyro_status & INV_NEW_DATA))
         status = 1;
     else
@@ -222,6 +228,39 @@ int inv_get_sensor_type_rotation_vector(float *values, int8_t *accuracy,
     return hal_out.nine_axis_status;
 }
 
+/** Rotation vector from the gyro and accel quaternion, without the compass.
+* Same elements as inv_get_sensor_type_rotation_vector() but the reference
+* coordinate system has an arbitrary heading: Z points towards the sky and
+* the rotation around it drifts slowly instead of following magnetic North.
+* It is not affected by magnetic disturbances.
+* @param[out] values Length 4.
+* @param[out] accuracy Accuracy 0 to 3, 3 = most accurate
+* @param[out] timestamp Timestamp. In (ns) for Android.
+* @return     Returns 1 if the data was updated or 0 if it was not updated.
+*/
+int inv_get_sensor_type_game_rotation_vector(float *values, int8_t *accuracy,
+        inv_time_t * timestamp)
+{
+    struct inv_results_snapshot_t snap;
+    float sign;
+
+    // quaternion and timestamp all from the same sample
+    inv_get_results_snapshot(&snap);
+    // no heading to lose accuracy on
+    *accuracy = 3;
+    *timestamp = snap.timestamp;
+
+    sign = (snap.quat_6axis[0] >= 0) ? 1.f : -1.f;
+    values[0] = sign * snap.quat_6axis[1] * INV_TWO_POWER_NEG_30;
+    values[1] = sign * snap.quat_6axis[2] * INV_TWO_POWER_NEG_30;
+    values[2] = sign * snap.quat_6axis[3] * INV_TWO_POWER_NEG_30;
+    values[3] = sign * snap.quat_6axis[0] * INV_TWO_POWER_NEG_30;
+
+    if ((hal_out.accel_status & INV_NEW_DATA) || (hal_out.gyro_status & INV_NEW_DATA))
+        return 1;
+    return 0;
+}
+
 
 /** Compass data (uT) in body frame.
 * @param[out] values Compass data in (uT), length 3. May be calibrated by having
@@ -311,7 +350,15 @@ int inv_get_sensor_type_orientation(float *values, int8_t *accuracy,
     *accuracy = (int8_t) hal_out.accuracy_quat;
     *timestamp = hal_out.nav_timestamp;
 
-    google_orientation(values);
+    if (!hal_out.orientation_valid ||
+            hal_out.orientation_timestamp != hal_out.nav_timestamp) {
+        google_orientation(hal_out.orientation);
+        hal_out.orientation_timestamp = hal_out.nav_timestamp;
+        hal_out.orientation_valid = 1;
+    }
+    values[0] = hal_out.orientation[0];
+    values[1] = hal_out.orientation[1];
+    values[2] = hal_out.orientation[2];
 
     return hal_out.nine_axis_status;
 }
@@ -326,12 +373,15 @@ inv_error_t inv_generate_hal_outputs(struct inv_sensor_cal_t *sensor_cal)
     int use_sensor = 0;
     long sr = 1000;
     long compass[3];
+    float compass_in[3];
     int8_t accuracy;
     int i;
     (void) sensor_cal;
 
     inv_get_quaternion_set(hal_out.nav_quat, &hal_out.accuracy_quat,
                            &hal_out.nav_timestamp);
+    // orientation is only recomputed when it is asked for
+    hal_out.orientation_valid = 0;
     hal_out.gyro_status = sensor_cal->gyro.status;
     hal_out.accel_status = sensor_cal->accel.status;
     hal_out.compass_status = sensor_cal->compass.status;
@@ -395,23 +445,25 @@ inv_error_t inv_generate_hal_outputs(struct inv_sensor_cal_t *sensor_cal)
     inv_get_compass_set(compass, &accuracy, &(hal_out.mag_timestamp) );
     hal_out.accuracy_mag = (int ) accuracy;
 
-    for (i=0; i<3; i++) {
-        if ((sensor_cal->compass.status & (INV_NEW_DATA | INV_CONTIGUOUS)) ==
-                                                             INV_NEW_DATA )  {
-            // set the state variables to match output with input
-            inv_calc_state_to_match_output(&hal_out.lp_filter[i], (float ) compass[i]);
-        }
+    for (i=0; i<3; i++)
+        compass_in[i] = (float ) compass[i];
 
-        if ((sensor_cal->compass.status & (INV_NEW_DATA | INV_RAW_DATA)) ==
-                                         (INV_NEW_DATA | INV_RAW_DATA)   )  {
+    if ((sensor_cal->compass.status & (INV_NEW_DATA | INV_CONTIGUOUS)) ==
+                                                         INV_NEW_DATA )  {
+        // set the state variables to match output with input
+        inv_biquad_bank_match_output(&hal_out.lp_filter, compass_in);
+    }
 
-            hal_out.compass_float[i] = inv_biquad_filter_process(&hal_out.lp_filter[i],
-                                           (float ) compass[i]) * COMPASS_CONVERSION;
+    if ((sensor_cal->compass.status & (INV_NEW_DATA | INV_RAW_DATA)) ==
+                                     (INV_NEW_DATA | INV_RAW_DATA)   )  {
 
-        } else if ((sensor_cal->compass.status & INV_NEW_DATA) == INV_NEW_DATA )  {
-            hal_out.compass_float[i] = (float ) compass[i] * COMPASS_CONVERSION;
-        }
+        inv_biquad_bank_process(&hal_out.lp_filter, compass_in, compass_in, 1);
+        for (i=0; i<3; i++)
+            hal_out.compass_float[i] = compass_in[i] * COMPASS_CONVERSION;
 
+    } else if ((sensor_cal->compass.status & INV_NEW_DATA) == INV_NEW_DATA )  {
+        for (i=0; i<3; i++)
+            hal_out.compass_float[i] = compass_in[i] * COMPASS_CONVERSION;
     }
     return INV_SUCCESS;
 }
@@ -450,11 +502,8 @@ float compass_low_pass_filter_coeff[5] =
 */
 inv_error_t inv_init_hal_outputs(void)
 {
-    int i;
     memset(&hal_out, 0, sizeof(hal_out));
-    for (i=0; i<3; i++)  {
-        inv_init_biquad_filter(&hal_out.lp_filter[i], compass_low_pass_filter_coeff);
-    }
+    inv_init_biquad_bank(&hal_out.lp_filter, compass_low_pass_filter_coeff);
 
     return INV_SUCCESS;
 }
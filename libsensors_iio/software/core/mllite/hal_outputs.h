@@ -25,6 +25,8 @@ extern "C" {
                                             inv_time_t * timestamp);
     int inv_get_sensor_type_rotation_vector(float *values, int8_t *accuracy,
             inv_time_t * timestamp);
+    int inv_get_sensor_type_game_rotation_vector(float *values,
+            int8_t *accuracy, inv_time_t * timestamp);
 
     int inv_get_sensor_type_linear_acceleration(float *values,
             int8_t *accuracy,
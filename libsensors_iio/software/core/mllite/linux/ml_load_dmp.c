@@ -18,6 +18,8 @@
  *      @brief    functions for writing dmp firmware.
  */
 #include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
 
 #include "log.h"
 #undef MPL_LOG_TAG
@@ -245,7 +247,8 @@ static const unsigned char dmpMemory[DMP_CODE_SIZE] = {
 inv_error_t inv_write_dmp_data(FILE *fd, const unsigned char *dmp, size_t len)
 {
     inv_error_t result = INV_SUCCESS;
-    int bytesWritten = 0;
+    size_t bytesWritten = 0;
+    ssize_t res;
    
     if (len <= 0) {
         MPL_LOGE("Nothing to write");
@@ -256,7 +259,19 @@ inv_error_t inv_write_dmp_data(FILE *fd, const unsigned char *dmp, size_t len)
     if (fd == NULL) {
         return INV_ERROR_FILE_OPEN;
     }
-    bytesWritten = fwrite(dmp, 1, len, fd);
+    /* the sysfs firmware node takes the image best in one piece: bypass
+       stdio and write the whole image with a single write() */
+    if (fflush(fd) != 0) {
+        return INV_ERROR_FILE_WRITE;
+    }
+    while (bytesWritten < len) {
+        res = write(fileno(fd), dmp + bytesWritten, len - bytesWritten);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            break;
+        bytesWritten += res;
+    }
     if (bytesWritten != len) {
         MPL_LOGE("bytes written (%d) don't match requested length (%d)\n",
                  bytesWritten, len);
@@ -20,6 +20,11 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "log.h"
 #undef MPL_LOG_TAG
@@ -37,6 +42,49 @@
 #define STORECAL_LOG MPL_LOGI
 #define LOADCAL_LOG  MPL_LOGI
 
+#define MLCAL_TMP_FILE MLCAL_FILE ".tmp"
+
+/* The calibration file stays mapped between stores so a store only touches
+   the records that changed. */
+static unsigned char *cal_map = NULL;
+static size_t cal_map_size = 0;
+
+static void inv_unmap_cal(void)
+{
+    if (cal_map) {
+        munmap(cal_map, cal_map_size);
+        cal_map = NULL;
+        cal_map_size = 0;
+    }
+}
+
+static inv_error_t inv_map_cal(void)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    if (cal_map)
+        return INV_SUCCESS;
+
+    fd = open(MLCAL_FILE, O_RDWR);
+    if (fd < 0)
+        return INV_ERROR_FILE_OPEN;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return INV_ERROR_FILE_READ;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        MPL_LOGE("Cannot map file \"%s\"\n", MLCAL_FILE);
+        return INV_ERROR_FILE_READ;
+    }
+    cal_map = (unsigned char *)map;
+    cal_map_size = st.st_size;
+    return INV_SUCCESS;
+}
+
 inv_error_t inv_read_cal(unsigned char **calData, size_t *bytesRead)
 {
     FILE *fp;
@@ -91,9 +139,11 @@ inv_error_t inv_write_cal(unsigned char *cal, size_t len)
     else {
         MPL_LOGI("cal data size to write = %d", len);
     }
-    fp = fopen(MLCAL_FILE,"wb");
+    /* write a new file next to the old one and rename it over, so a crash
+       never leaves a half written calibration behind */
+    fp = fopen(MLCAL_TMP_FILE,"wb");
     if (fp == NULL) {
-        MPL_LOGE("Cannot open file \"%s\" for write\n", MLCAL_FILE);
+        MPL_LOGE("Cannot open file \"%s\" for write\n", MLCAL_TMP_FILE);
         return INV_ERROR_FILE_OPEN;
     }
     bytesWritten = fwrite(cal, 1, len, fp);
@@ -105,7 +155,21 @@ inv_error_t inv_write_cal(unsigned char *cal, size_t len)
     else {
         MPL_LOGI("Bytes written = %d", bytesWritten);
     }
+    if (fflush(fp) != 0 || fsync(fileno(fp)) != 0)
+        result = INV_ERROR_FILE_WRITE;
     fclose(fp);
+
+    if (result == INV_SUCCESS && rename(MLCAL_TMP_FILE, MLCAL_FILE) != 0) {
+        MPL_LOGE("Cannot rename \"%s\" to \"%s\"\n",
+                 MLCAL_TMP_FILE, MLCAL_FILE);
+        result = INV_ERROR_FILE_WRITE;
+    }
+    if (result != INV_SUCCESS) {
+        unlink(MLCAL_TMP_FILE);
+    } else {
+        /* any mapping now refers to the replaced file */
+        inv_unmap_cal();
+    }
     return result;
 }
 
@@ -278,6 +342,15 @@ inv_error_t inv_load_calibration(void)
     inv_error_t result = 0;
     size_t bytesRead = 0;
 
+    if (inv_map_cal() == INV_SUCCESS) {
+        result = inv_load_mpl_states(cal_map, cal_map_size);
+        if (result != INV_SUCCESS) {
+            MPL_LOGE("Could not load the calibration data - "
+                     "error %d - aborting\n", result);
+        }
+        return result;
+    }
+
     result = inv_read_cal(&calData, &bytesRead);
     if(result != INV_SUCCESS) {
         MPL_LOGE("Could not load cal file - "
@@ -311,7 +384,8 @@ inv_error_t inv_store_calibration(void)
 {
     unsigned char *calData;
     inv_error_t result;
-    size_t length;
+    size_t length, start, end;
+    long page;
 
     result = inv_get_mpl_state_size(&length);
     calData = (unsigned char *)inv_malloc(length);
@@ -324,6 +398,22 @@ inv_error_t inv_store_calibration(void)
         MPL_LOGI("mpl state size = %d", length);
     }
 
+    /* update the records that changed in place when the file on flash
+       still has the layout of the registered modules */
+    if (inv_map_cal() == INV_SUCCESS && cal_map_size == length &&
+            inv_update_mpl_states(cal_map, length, calData,
+                                  &start, &end) == INV_SUCCESS) {
+        if (end > start) {
+            page = sysconf(_SC_PAGESIZE);
+            start &= ~(page - 1);
+            if (msync(cal_map + start, end - start, MS_SYNC) != 0) {
+                MPL_LOGE("Could not sync calibration data\n");
+                result = INV_ERROR_FILE_WRITE;
+            }
+        }
+        goto free_mem_n_exit;
+    }
+
     result = inv_save_mpl_states(calData, length);
     if (result != INV_SUCCESS) {
         MPL_LOGE("Could not save mpl states - "
@@ -25,7 +25,9 @@ extern "C" {
 /*
     Defines
 */
+#ifndef MLCAL_FILE
 #define MLCAL_FILE "/data/inv_cal_data.bin"
+#endif
 
 /*
     APIs
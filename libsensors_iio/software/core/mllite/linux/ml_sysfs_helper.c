@@ -1,10 +1,22 @@
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "ml_sysfs_helper.h"
 #include <dirent.h>
 #include <ctype.h>
 #define MPU_SYSFS_ABS_PATH "/sys/class/invensense/mpu"
 
+/* overridden by the HAL benchmark to run over a fake device tree */
+#ifndef IIO_SYSFS_DIR
+#define IIO_SYSFS_DIR "/sys/bus/iio/devices"
+#endif
+#ifndef IIO_DEV_DIR
+#define IIO_DEV_DIR "/dev"
+#endif
+#ifndef PROC_INPUT_DEVICES
+#define PROC_INPUT_DEVICES "/proc/bus/input/devices"
+#endif
+
 enum PROC_SYSFS_CMD {
 	CMD_GET_SYSFS_PATH,
 	CMD_GET_DMP_PATH,
@@ -28,188 +40,254 @@ static int iio_initialized = 0;
 static int iio_dev_num = 0;
 
 #define IIO_MAX_NAME_LENGTH 30
+#define IIO_MAX_TYPE_LENGTH 16
+#define IIO_MAX_ENTRIES 32
+#define INPUT_MAX_NAME_LENGTH 64
+#define INPUT_MAX_DEVICES 32
 
 #define FORMAT_SCAN_ELEMENTS_DIR "%s/scan_elements"
 #define FORMAT_TYPE_FILE "%s_type"
 
 #define CHIP_NUM ARRAY_SIZE(chip_name)
 
-static const char *iio_dir = "/sys/bus/iio/devices/";
+static const char *iio_dir = IIO_SYSFS_DIR "/";
+
+/* Every top level entry of the iio directory, read once so looking up a
+   chip or trigger does not open each name file again. */
+struct iio_entry {
+	char type[IIO_MAX_TYPE_LENGTH];
+	int number;
+	char name[IIO_MAX_NAME_LENGTH];
+};
+static struct iio_entry iio_entries[IIO_MAX_ENTRIES];
+static int iio_entry_count = -1;
+
+/* Every device listed in /proc/bus/input/devices, read once. */
+struct input_entry {
+	char name[INPUT_MAX_NAME_LENGTH];
+	char sysfs[100];
+	int event_number;
+	int input_number;
+};
+static struct input_entry input_entries[INPUT_MAX_DEVICES];
+static int input_entry_count = -1;
 
 /**
- * find_type_by_name() - function to match top level types by name
- * @name: top level type instance name
- * @type: the type of top level instance being sort
- *
- * Typical types this is used for are device and trigger.
+ * scan_iio_entries() - index the name of each top level iio instance
  **/
-int find_type_by_name(const char *name, const char *type)
+static void scan_iio_entries(void)
 {
 	const struct dirent *ent;
-	int number, numstrlen;
-
+	struct iio_entry *entry;
+	char filename[256];
 	FILE *nameFile;
 	DIR *dp;
-	char thisname[IIO_MAX_NAME_LENGTH];
-	char *filename;
+	int len;
 
+	iio_entry_count = 0;
 	dp = opendir(iio_dir);
 	if (dp == NULL) {
 		printf("No industrialio devices available");
-		return -ENODEV;
+		return;
 	}
 
 	while (ent = readdir(dp), ent != NULL) {
-		if (strcmp(ent->d_name, ".") != 0 &&
-			strcmp(ent->d_name, "..") != 0 &&
-			strlen(ent->d_name) > strlen(type) &&
-			strncmp(ent->d_name, type, strlen(type)) == 0) {
-			numstrlen = sscanf(ent->d_name + strlen(type),
-					   "%d",
-					   &number);
-			/* verify the next character is not a colon */
-			if (strncmp(ent->d_name + strlen(type) + numstrlen,
-					":",
-					1) != 0) {
-				filename = malloc(strlen(iio_dir)
-						+ strlen(type)
-						+ numstrlen
-						+ 6);
-				if (filename == NULL)
-					return -ENOMEM;
-				sprintf(filename, "%s%s%d/name",
-					iio_dir,
-					type,
-					number);
-				nameFile = fopen(filename, "r");
-				if (!nameFile)
-					continue;
-				free(filename);
-				fscanf(nameFile, "%s", thisname);
-				if (strcmp(name, thisname) == 0)
-					return number;
-				fclose(nameFile);
-			}
-		}
+		if (iio_entry_count == IIO_MAX_ENTRIES)
+			break;
+		entry = &iio_entries[iio_entry_count];
+		/* split "<type><number>", skipping entries like "iio:device0:..." */
+		for (len = 0; ent->d_name[len] && !isdigit(ent->d_name[len]); len++)
+			;
+		if (len == 0 || len >= IIO_MAX_TYPE_LENGTH ||
+			sscanf(ent->d_name + len, "%d", &entry->number) != 1 ||
+			strchr(ent->d_name + len, ':') != NULL)
+			continue;
+		memcpy(entry->type, ent->d_name, len);
+		entry->type[len] = '\0';
+
+		snprintf(filename, sizeof(filename), "%s%s/name",
+			 iio_dir, ent->d_name);
+		nameFile = fopen(filename, "r");
+		if (!nameFile)
+			continue;
+		if (fscanf(nameFile, "%29s", entry->name) == 1)
+			iio_entry_count++;
+		fclose(nameFile);
+	}
+	closedir(dp);
+}
+
+static int lookup_iio_entry(const char *name, const char *type)
+{
+	int i;
+
+	for (i = 0; i < iio_entry_count; i++) {
+		if (strcmp(iio_entries[i].type, type) == 0 &&
+			strcmp(iio_entries[i].name, name) == 0)
+			return iio_entries[i].number;
 	}
 	return -ENODEV;
 }
 
-/* mode 0: search for which chip in the system and fill sysfs path
-   mode 1: return event number
- */
-static int parsing_proc_input(int mode, char *name){
-	const char input[] = "/proc/bus/input/devices";
-	char line[4096], d;
-	char tmp[100];
-	FILE *fp;
-	int i, j, result, find_flag;
-	int event_number = -1;
-	int input_number = -1;
+/**
+ * find_type_by_name() - function to match top level types by name
+ * @name: top level type instance name
+ * @type: the type of top level instance being sort
+ *
+ * Typical types this is used for are device and trigger.
+ * The iio directory is indexed on first use and again only when a name
+ * is not found, in case its driver was loaded since.
+ **/
+int find_type_by_name(const char *name, const char *type)
+{
+	int number;
 
-	if(NULL == (fp = fopen(input, "rt")) ){
-		return -1;
+	if (iio_entry_count < 0)
+		scan_iio_entries();
+	number = lookup_iio_entry(name, type);
+	if (number < 0) {
+		scan_iio_entries();
+		number = lookup_iio_entry(name, type);
 	}
-	result = 1;
-	find_flag = 0;
-	while(result != 0 && find_flag < 2){
-		i = 0;
-		d = 0;
-		memset(line, 0, 100);
-		while(d != '\n'){		
-			result = fread(&d, 1, 1, fp);
-			if(result == 0){
-				line[0] = 0;
+	return number;
+}
+
+/* Copies the rest of a line of the input device list after its first
+   '=', or for a name after its opening quote. */
+static void copy_input_value(char *dst, size_t size, const char *line)
+{
+	const char *value = strpbrk(line, "=\"");
+	size_t len;
+
+	dst[0] = '\0';
+	if (value == NULL)
+		return;
+	value++;
+	len = strcspn(value, "\n");
+	if (len >= size)
+		len = size - 1;
+	memcpy(dst, value, len);
+	dst[len] = '\0';
+}
+
+/**
+ * scan_input_entries() - index the input devices the kernel lists
+ *
+ * The list is read in one go rather than a byte at a time and parsed in
+ * place.
+ **/
+static void scan_input_entries(void)
+{
+	struct input_entry *entry = NULL;
+	char *buf, *line, *next, *p;
+	size_t size = 4096, len = 0, n;
+	FILE *fp;
+
+	input_entry_count = 0;
+	if ((fp = fopen(PROC_INPUT_DEVICES, "r")) == NULL)
+		return;
+	buf = malloc(size);
+	while (buf) {
+		n = fread(buf + len, 1, size - len - 1, fp);
+		len += n;
+		if (n == 0)
+			break;
+		if (len == size - 1) {
+			char *bigger = realloc(buf, size * 2);
+			if (bigger == NULL)
 				break;
-			}
-			sprintf(&line[i], "%c", d);		
-			i ++;
+			buf = bigger;
+			size *= 2;
 		}
-		if(line[0] == 'N'){
-			i = 1;
-			while(line[i] != '"'){
-				i++;
-			}
-			i++;
-			j = 0;
-			find_flag = 0;
-			if (mode == 0){
-				while(j < CHIP_NUM){
-					if(!memcmp(&line[i], chip_name[j], strlen(chip_name[j]))){
-						find_flag = 1;
-						chip_ind = j;
-					}
-					j++;
-				}
-			} else if (mode  != 0){
-				if(!memcmp(&line[i], name, strlen(name))){
-					find_flag = 1;
-				}
-			}
-		}		
-		if(find_flag){
-			if(mode == 0){
-				if(line[0] == 'S'){
-					memset(tmp, 0, 100);
-					i =1;
-					while(line[i] != '=') i++;
-					i++;
-					j = 0;
-					while(line[i] != '\n'){
-						tmp[j] = line[i];
-						i ++; j++;
-					}	
-					sprintf(sysfs_path, "%s%s", "/sys", tmp);
-					find_flag++;
-				}
-			} else if(mode == 1){
-				if(line[0] == 'H') {
-					i = 2;
-					while(line[i] != '=') i++;
-					while(line[i] != 't') i++;	
-					i++;
-					event_number = 0;
-					while(line[i] != '\n'){
-						if(line[i] >= '0' && line[i] <= '9')
-							event_number = event_number*10 + line[i]-0x30;
-						i ++;
-					}
-					find_flag ++;
-				}
-			} else if (mode == 2) {
-				if(line[0] == 'S'){
-					memset(tmp, 0, 100);
-					i =1;
-					while(line[i] != '=') i++;
-					i++;
-					j = 0;
-					while(line[i] != '\n'){
-						tmp[j] = line[i];
-						i ++; j++;
-					}
-					input_number = 0;
-					if(tmp[j-2] >= '0' && tmp[j-2] <= '9') 
-						input_number += (tmp[j-2]-0x30)*10;
-					if(tmp[j-1] >= '0' && tmp[j-1] <= '9') 
-						input_number += (tmp[j-1]-0x30);
-					find_flag++;
-				}
+	}
+	fclose(fp);
+	if (buf == NULL)
+		return;
+	buf[len] = '\0';
+
+	for (line = buf; line && *line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		if (line[0] == 'N') {
+			entry = NULL;
+			if (input_entry_count == INPUT_MAX_DEVICES)
+				break;
+			entry = &input_entries[input_entry_count++];
+			memset(entry, 0, sizeof(*entry));
+			entry->event_number = -1;
+			entry->input_number = -1;
+			/* N: Name="<name>" */
+			p = strchr(line, '"');
+			if (p) {
+				copy_input_value(entry->name, sizeof(entry->name), p);
+				p = strchr(entry->name, '"');
+				if (p)
+					*p = '\0';
 			}
+		} else if (entry && line[0] == 'S') {
+			copy_input_value(entry->sysfs, sizeof(entry->sysfs), line);
+			p = strrchr(entry->sysfs, 't');
+			if (p && isdigit(p[1]))
+				entry->input_number = atoi(p + 1);
+		} else if (entry && line[0] == 'H') {
+			p = strstr(line, "event");
+			if (p && isdigit(p[5]))
+				entry->event_number = atoi(p + 5);
 		}
 	}
-	fclose(fp);
-	if(find_flag == 0){
-		return -1;
+	free(buf);
+}
+
+/* First input device whose name starts with prefix, NULL if none. */
+static const struct input_entry *lookup_input_entry(const char *prefix)
+{
+	int i;
+
+	for (i = 0; i < input_entry_count; i++) {
+		if (!strncmp(input_entries[i].name, prefix, strlen(prefix)))
+			return &input_entries[i];
 	}
-	if(0 == mode)
-		status = 1;
-	if (mode == 1)
-		return event_number;
-	if (mode == 2)
-		return input_number;
-	return 0;
+	return NULL;
+}
+
+/* Input device whose name starts with prefix. The list is read on first
+   use and again only when the name is not in it. */
+static const struct input_entry *find_input_entry(const char *prefix)
+{
+	const struct input_entry *entry;
+
+	if (input_entry_count < 0)
+		scan_input_entries();
+	entry = lookup_input_entry(prefix);
+	if (entry == NULL) {
+		scan_input_entries();
+		entry = lookup_input_entry(prefix);
+	}
+	return entry;
+}
+
+/* search for which chip in the system and fill sysfs path */
+static void parsing_proc_input(void)
+{
+	int i, j;
 
+	if (input_entry_count < 0)
+		scan_input_entries();
+	for (i = 0; i < input_entry_count && !status; i++) {
+		for (j = 0; j < CHIP_NUM; j++) {
+			if (!strncmp(input_entries[i].name, chip_name[j],
+				     strlen(chip_name[j]))) {
+				chip_ind = j;
+				status = 1;
+			}
+		}
+		if (status)
+			sprintf(sysfs_path, "%s%s", "/sys", input_entries[i].sysfs);
+	}
 }
+
 static void init_iio() {
 	int i, j;
 	char iio_chip[10];
@@ -219,7 +297,9 @@ static void init_iio() {
 			iio_chip[i] = tolower(chip_name[j][i]);
 		}
 		iio_chip[strlen(chip_name[0])] = '\0';
-		dev_num = find_type_by_name(iio_chip, "iio:device");
+		if (iio_entry_count < 0)
+			scan_iio_entries();
+		dev_num = lookup_iio_entry(iio_chip, "iio:device");
 		if(dev_num >= 0) {
 			iio_initialized = 1;
 			iio_dev_num = dev_num;
@@ -234,26 +314,29 @@ static int process_sysfs_request(enum PROC_SYSFS_CMD cmd, char *data)
 	FILE *fp;
 	int i, result;
 	if(initialized == 0){
-		parsing_proc_input(0, NULL);
-		initialized = 1;
-	}
-	if(initialized && status == 0) {
-		init_iio();
-		if (iio_initialized == 0)
+		parsing_proc_input();
+		if (status == 0)
+			init_iio();
+		initialized = status || iio_initialized;
+		if (initialized == 0) {
+			/* look again next time, the driver may not be up yet */
+			input_entry_count = -1;
+			iio_entry_count = -1;
 			return -1;
+		}
 	}
 
 	memset(key_path, 0, 100);
 	switch(cmd){
 	case CMD_GET_SYSFS_PATH:
 		if (iio_initialized == 1)
-			sprintf(data, "/sys/bus/iio/devices/iio:device%d", iio_dev_num);
+			sprintf(data, IIO_SYSFS_DIR "/iio:device%d", iio_dev_num);
 		else
 			sprintf(data, "%s%s", sysfs_path, "/device/invensense/mpu");
 		break;
 	case CMD_GET_DMP_PATH:
 		if (iio_initialized == 1)
-			sprintf(data, "/sys/bus/iio/devices/iio:device%d/dmp_firmware", iio_dev_num);
+			sprintf(data, IIO_SYSFS_DIR "/iio:device%d/dmp_firmware", iio_dev_num);
 		else
 			sprintf(data, "%s%s", sysfs_path, "/device/invensense/mpu/dmp_firmware");
 		break;
@@ -261,15 +344,15 @@ static int process_sysfs_request(enum PROC_SYSFS_CMD cmd, char *data)
 		sprintf(data, "%s", chip_name[chip_ind]);
 		break;
 	case CMD_GET_TRIGGER_PATH:
-		sprintf(data, "/sys/bus/iio/devices/trigger%d", iio_dev_num);
+		sprintf(data, IIO_SYSFS_DIR "/trigger%d", iio_dev_num);
 		break;
 	case CMD_GET_DEVICE_NODE:
-		sprintf(data, "/dev/iio:device%d", iio_dev_num);
+		sprintf(data, IIO_DEV_DIR "/iio:device%d", iio_dev_num);
 		break;
 	case CMD_GET_SYSFS_KEY:
 		memset(key_path, 0, 100);
 		if (iio_initialized == 1)
-			sprintf(key_path, "/sys/bus/iio/devices/iio:device%d/key", iio_dev_num);
+			sprintf(key_path, IIO_SYSFS_DIR "/iio:device%d/key", iio_dev_num);
 		else	
 			sprintf(key_path, "%s%s", sysfs_path, "/device/invensense/mpu/key");
 
@@ -366,8 +449,10 @@ inv_error_t inv_get_chip_name(char *name)
  */
 inv_error_t  inv_get_handler_number(const char *name, int *num)
 {
-	initialized = 0;
-	if ((*num = parsing_proc_input(1, (char *)name)) < 0)
+	const struct input_entry *entry = find_input_entry(name);
+
+	*num = entry ? entry->event_number : -1;
+	if (*num < 0)
 		return INV_ERROR_NOT_OPENED;
 	else
 		return INV_SUCCESS;	
@@ -384,8 +469,10 @@ inv_error_t  inv_get_handler_number(const char *name, int *num)
  */
 inv_error_t  inv_get_input_number(const char *name, int *num)
 {
-	initialized = 0;
-	if ((*num = parsing_proc_input(2, (char *)name)) < 0)
+	const struct input_entry *entry = find_input_entry(name);
+
+	*num = entry ? entry->input_number : -1;
+	if (*num < 0)
 		return INV_ERROR_NOT_OPENED;
 	else {
 		return INV_SUCCESS;
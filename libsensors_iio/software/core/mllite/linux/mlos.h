@@ -22,6 +22,14 @@ extern "C" {
 typedef pthread_mutex_t* HANDLE;
 #endif
 
+/** Mutex that needs no allocation, for module state in static storage.
+    0 unlocked, 1 locked, 2 locked with waiters. */
+typedef struct {
+	volatile int state;
+} inv_static_mutex_t;
+
+#define INV_STATIC_MUTEX_INITIALIZER { 0 }
+
 	/* ------------ */
 	/* - Defines. - */
 	/* ------------ */
@@ -58,8 +66,14 @@ typedef pthread_mutex_t* HANDLE;
 
 	inv_error_t inv_destroy_mutex(HANDLE handle);
 
+	void inv_init_static_mutex(inv_static_mutex_t *mutex);
+	void inv_lock_static_mutex(inv_static_mutex_t *mutex);
+	void inv_unlock_static_mutex(inv_static_mutex_t *mutex);
+
 	void inv_sleep(int mSecs);
+	void inv_sleep_us(unsigned long usecs);
 	unsigned long inv_get_tick_count(void);
+	uint64_t inv_get_tick_count_ns(void);
 
 	/* Kernel implmentations */
 #define GFP_KERNEL (0x70)
@@ -87,7 +101,7 @@ typedef pthread_mutex_t* HANDLE;
 	}
 	static inline void udelay(unsigned long usecs)
 	{
-		inv_sleep((usecs + 999) / 1000);
+		inv_sleep_us(usecs);
 	}
 #else
 #include <linux/delay.h>
@@ -24,6 +24,9 @@
 /* ------------- */
 
 #include <sys/time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <time.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <stdlib.h>
@@ -33,20 +36,68 @@
 #include "mlos.h"
 
 
+/* ------------ */
+/* - Defines. - */
+/* ------------ */
+
+/* Bytes of static storage inv_malloc() serves MPL module state from before
+   falling back to the heap. */
+#ifndef INV_MALLOC_ARENA_SIZE
+#define INV_MALLOC_ARENA_SIZE (32 * 1024)
+#endif
+
+/* Header in front of each arena block. */
+struct inv_arena_block {
+    unsigned int size;              /* usable bytes after the header */
+    struct inv_arena_block *next;   /* next free block, when free */
+    long long align;                /* keeps the payload 8 byte aligned */
+};
+
+static struct {
+    inv_static_mutex_t lock;
+    unsigned int used;
+    struct inv_arena_block *free_list;
+    long long mem[INV_MALLOC_ARENA_SIZE / sizeof(long long)];
+} arena = { INV_STATIC_MUTEX_INITIALIZER, 0, NULL, { 0 } };
+
 /* -------------- */
 /* - Functions. - */
 /* -------------- */
 
 /**
  *  @brief  Allocate space
+ *          Module state is mostly allocated once at startup, so it is
+ *          carved out of a static arena; blocks that are freed are kept on
+ *          a free list for reuse. The heap is used once the arena is full.
  *  @param  num_bytes  number of bytes
  *  @return pointer to allocated space
  */
 void *inv_malloc(unsigned int num_bytes)
 {
+    struct inv_arena_block *blk, **prev;
+    unsigned int size = (num_bytes + 7) & ~7U;
+
+    inv_lock_static_mutex(&arena.lock);
+    for (prev = &arena.free_list; *prev; prev = &(*prev)->next) {
+        blk = *prev;
+        if (blk->size >= size) {
+            *prev = blk->next;
+            inv_unlock_static_mutex(&arena.lock);
+            return blk + 1;
+        }
+    }
+    if (size <= sizeof(arena.mem) - sizeof(*blk) &&
+        arena.used + sizeof(*blk) + size <= sizeof(arena.mem)) {
+        blk = (struct inv_arena_block *)((char *)arena.mem + arena.used);
+        blk->size = size;
+        arena.used += sizeof(*blk) + size;
+        inv_unlock_static_mutex(&arena.lock);
+        return blk + 1;
+    }
+    inv_unlock_static_mutex(&arena.lock);
+
     // Allocate space.
-    void *alloc_ptr = malloc(num_bytes);
-    return alloc_ptr;
+    return malloc(num_bytes);
 }
 
 
@@ -57,12 +108,72 @@ void *inv_malloc(unsigned int num_bytes)
  */
 inv_error_t inv_free(void *ptr)
 {
-    if (ptr)
+    struct inv_arena_block *blk;
+
+    if (ptr == NULL)
+        return INV_SUCCESS;
+    if ((char *)ptr > (char *)arena.mem &&
+        (char *)ptr < (char *)arena.mem + sizeof(arena.mem)) {
+        blk = (struct inv_arena_block *)ptr - 1;
+        inv_lock_static_mutex(&arena.lock);
+        blk->next = arena.free_list;
+        arena.free_list = blk;
+        inv_unlock_static_mutex(&arena.lock);
+    } else {
         free(ptr);
+    }
     return INV_SUCCESS;
 }
 
 
+/**
+ *  @brief  Static mutex init function, for a mutex that was not set up
+ *          with INV_STATIC_MUTEX_INITIALIZER.
+ *  @param  mutex   mutex to initialize
+ */
+void inv_init_static_mutex(inv_static_mutex_t *mutex)
+{
+    mutex->state = 0;
+}
+
+
+/**
+ *  @brief  Static mutex lock function.
+ *          Takes the mutex with one atomic operation when it is free and
+ *          only enters the kernel to wait when it is contended.
+ *  @param  mutex   mutex to lock
+ */
+void inv_lock_static_mutex(inv_static_mutex_t *mutex)
+{
+    int c = __sync_val_compare_and_swap(&mutex->state, 0, 1);
+
+    if (c == 0)
+        return;
+    if (c != 2)
+        c = __sync_lock_test_and_set(&mutex->state, 2);
+    while (c != 0) {
+        syscall(__NR_futex, &mutex->state, FUTEX_WAIT_PRIVATE, 2,
+                NULL, NULL, 0);
+        c = __sync_lock_test_and_set(&mutex->state, 2);
+    }
+}
+
+
+/**
+ *  @brief  Static mutex unlock function.
+ *  @param  mutex   mutex to unlock
+ */
+void inv_unlock_static_mutex(inv_static_mutex_t *mutex)
+{
+    if (__sync_fetch_and_sub(&mutex->state, 1) != 1) {
+        mutex->state = 0;
+        __sync_synchronize();
+        syscall(__NR_futex, &mutex->state, FUTEX_WAKE_PRIVATE, 1,
+                NULL, NULL, 0);
+    }
+}
+
+
 /**
  *  @brief  Mutex create function
  *  @param  mutex   pointer to mutex handle
@@ -171,6 +282,15 @@ void inv_sleep(int m_secs)
 }
 
 
+/**
+ *  @brief  Sleep function with microsecond resolution.
+ */
+void inv_sleep_us(unsigned long usecs)
+{
+    usleep(usecs);
+}
+
+
 /**
  *  @brief  get system's internal tick count.
  *          Used for time reference.
@@ -178,12 +298,24 @@ void inv_sleep(int m_secs)
  */
 unsigned long inv_get_tick_count()
 {
-    struct timeval tv;
+    return (unsigned long)(inv_get_tick_count_ns() / 1000000ULL);
+}
+
+
+/**
+ *  @brief  get the monotonic clock in nanoseconds.
+ *          Unlike the wall clock it never jumps, so it is the one to take
+ *          time differences from.
+ *  @return current time in nanoseconds.
+ */
+uint64_t inv_get_tick_count_ns(void)
+{
+    struct timespec ts;
 
-    if (gettimeofday(&tv, NULL) != 0)
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0)
         return 0;
 
-    return (long)((tv.tv_sec * 1000000LL + tv.tv_usec) / 1000LL);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
 /** @} */
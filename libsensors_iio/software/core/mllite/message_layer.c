@@ -13,11 +13,26 @@
  *       @file message_layer.c
  *       @brief Holds Low Occurance Messages.
  */
+#include <string.h>
+
 #include "message_layer.h"
 #include "log.h"
 
+/** Max number of message subscribers */
+#define INV_MAX_MESSAGE_CB 4
+
+struct message_cb_t {
+    inv_message_cb_func func;
+    long mask;
+    void *user;
+};
+
 struct message_holder_t {
-    long message;
+    /** Level 0 messages, only changed with atomic operations as they are
+    * set from the data processing and read from the consumer thread. */
+    volatile long message;
+    int num_cb;
+    struct message_cb_t cb[INV_MAX_MESSAGE_CB];
 };
 
 static struct message_holder_t mh;
@@ -32,9 +47,19 @@ static struct message_holder_t mh;
 */
 void inv_set_message(long set, long clear, int level)
 {
+    long old, msg;
+    int kk;
+
     if (level == 0) {
-        mh.message &= ~clear;
-        mh.message |= set;
+        do {
+            old = mh.message;
+            msg = (old & ~clear) | set;
+        } while (!__sync_bool_compare_and_swap(&mh.message, old, msg));
+
+        for (kk = 0; kk < mh.num_cb; ++kk) {
+            if (set & mh.cb[kk].mask)
+                mh.cb[kk].func(set & mh.cb[kk].mask, mh.cb[kk].user);
+        }
     }
 }
 
@@ -46,12 +71,52 @@ void inv_set_message(long set, long clear, int level)
 */
 long inv_get_message_level_0(int clear)
 {
-    long msg;
-    msg = mh.message;
     if (clear) {
-        mh.message = 0;
+        // fetch and clear in one step so a message set in between is kept
+        return __sync_fetch_and_and(&mh.message, 0);
+    }
+    return __sync_fetch_and_or(&mh.message, 0);
+}
+
+/** Subscribes to level 0 messages, so a consumer is told about them as they
+* are set rather than polling inv_get_message_level_0(). The callback runs
+* on the thread that set the message, inside the data processing, and
+* should only hand the message off. Subscribe before data starts flowing.
+* @param[in] func Called with the subscribed messages that were just set.
+* @param[in] mask Messages to be told about.
+* @param[in] user Passed to func.
+* @return Returns INV_SUCCESS if successful or an error code if not.
+*/
+inv_error_t inv_subscribe_message(inv_message_cb_func func, long mask, void *user)
+{
+    if (func == NULL || mask == 0)
+        return INV_ERROR_INVALID_PARAMETER;
+    if (mh.num_cb >= INV_MAX_MESSAGE_CB)
+        return INV_ERROR_MEMORY_EXAUSTED;
+    mh.cb[mh.num_cb].func = func;
+    mh.cb[mh.num_cb].mask = mask;
+    mh.cb[mh.num_cb].user = user;
+    mh.num_cb++;
+    return INV_SUCCESS;
+}
+
+/** Removes a subscription made with inv_subscribe_message().
+* @param[in] func Callback that was subscribed.
+* @return Returns INV_SUCCESS if successful or an error code if not.
+*/
+inv_error_t inv_unsubscribe_message(inv_message_cb_func func)
+{
+    int kk;
+
+    for (kk = 0; kk < mh.num_cb; ++kk) {
+        if (mh.cb[kk].func == func) {
+            mh.num_cb--;
+            memmove(&mh.cb[kk], &mh.cb[kk + 1],
+                    (mh.num_cb - kk) * sizeof(mh.cb[0]));
+            return INV_SUCCESS;
+        }
     }
-    return msg;
+    return INV_ERROR_INVALID_PARAMETER;
 }
 
 /**
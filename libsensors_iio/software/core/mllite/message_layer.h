@@ -25,8 +25,14 @@ extern "C" {
     /** A setting of the accel bias has occured */
 #define INV_MSG_NEW_AB_EVENT    (0x10)
 
+    /** Receives messages subscribed to with inv_subscribe_message() */
+    typedef void (*inv_message_cb_func)(long message, void *user);
+
     void inv_set_message(long set, long clear, int level);
     long inv_get_message_level_0(int clear);
+    inv_error_t inv_subscribe_message(inv_message_cb_func func, long mask,
+                                      void *user);
+    inv_error_t inv_unsubscribe_message(inv_message_cb_func func);
 
 #ifdef __cplusplus
 }
@@ -164,6 +164,27 @@ long inv_q_shift_mult(long a, long b, int shift)
 void inv_q_mult(const long *q1, const long *q2, long *qProd)
 {
     INVENSENSE_FUNC_START;
+#ifdef INV_USE_NEON_MATH
+    /* each column of products lines up with q2 permuted, the signs follow
+       the scalar expressions below */
+    static const int32_t sign1[4] = { -1, 1, -1, 1 };
+    static const int32_t sign2[4] = { -1, 1, 1, -1 };
+    static const int32_t sign3[4] = { -1, -1, 1, 1 };
+    int32x4_t b = vld1q_s32((const int32_t *)q2);   // q2 0 1 2 3
+    int32x4_t b1 = vrev64q_s32(b);                  // q2 1 0 3 2
+    int32x4_t b2 = vcombine_s32(vget_high_s32(b), vget_low_s32(b)); // 2 3 0 1
+    int32x4_t b3 = vrev64q_s32(b2);                 // q2 3 2 1 0
+    int32x4_t prod;
+
+    prod = inv_q_shift_mult4(vdupq_n_s32(q1[0]), b, 30);
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(q1[1]), b1, 30),
+                     vld1q_s32(sign1));
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(q1[2]), b2, 30),
+                     vld1q_s32(sign2));
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(q1[3]), b3, 30),
+                     vld1q_s32(sign3));
+    vst1q_s32((int32_t *)qProd, prod);
+#else
     qProd[0] = inv_q30_mult(q1[0], q2[0]) - inv_q30_mult(q1[1], q2[1]) -
                inv_q30_mult(q1[2], q2[2]) - inv_q30_mult(q1[3], q2[3]);
 
@@ -175,6 +196,7 @@ void inv_q_mult(const long *q1, const long *q2, long *qProd)
 
     qProd[3] = inv_q30_mult(q1[0], q2[3]) + inv_q30_mult(q1[1], q2[2]) -
                inv_q30_mult(q1[2], q2[1]) + inv_q30_mult(q1[3], q2[0]);
+#endif
 }
 
 /** Performs a fixed point quaternion addition.
@@ -246,6 +268,46 @@ double quaternion_to_rotation_angle(const long *quat) {
 */
 void inv_q_rotate(const long *q, const long *in, long *out)
 {
+#ifdef INV_USE_NEON_MATH
+    /* q * (0, in) * q^-1 with the quaternion multiplies inlined: the zero
+       real part and the conjugate are folded into the operands */
+    static const int32_t sign1[4] = { -1, 1, -1, 1 };
+    static const int32_t sign2[4] = { -1, 1, 1, -1 };
+    static const int32_t sign3[4] = { -1, -1, 1, 1 };
+    static const int32_t conj[4] = { 1, -1, -1, -1 };
+    int32_t in4[4] = { 0, in[0], in[1], in[2] };
+    int32_t t[4], out4[4];
+    int32x4_t b, b1, b2, b3, prod;
+
+    b = vld1q_s32(in4);
+    b1 = vrev64q_s32(b);
+    b2 = vcombine_s32(vget_high_s32(b), vget_low_s32(b));
+    b3 = vrev64q_s32(b2);
+    prod = inv_q_shift_mult4(vdupq_n_s32(q[0]), b, 30);
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(q[1]), b1, 30),
+                     vld1q_s32(sign1));
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(q[2]), b2, 30),
+                     vld1q_s32(sign2));
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(q[3]), b3, 30),
+                     vld1q_s32(sign3));
+    vst1q_s32(t, prod);
+
+    b = vmulq_s32(vld1q_s32((const int32_t *)q), vld1q_s32(conj));
+    b1 = vrev64q_s32(b);
+    b2 = vcombine_s32(vget_high_s32(b), vget_low_s32(b));
+    b3 = vrev64q_s32(b2);
+    prod = inv_q_shift_mult4(vdupq_n_s32(t[0]), b, 30);
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(t[1]), b1, 30),
+                     vld1q_s32(sign1));
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(t[2]), b2, 30),
+                     vld1q_s32(sign2));
+    prod = vmlaq_s32(prod, inv_q_shift_mult4(vdupq_n_s32(t[3]), b3, 30),
+                     vld1q_s32(sign3));
+    vst1q_s32(out4, prod);
+    out[0] = out4[1];
+    out[1] = out4[2];
+    out[2] = out4[3];
+#else
     long q_temp1[4], q_temp2[4];
     long in4[4], out4[4];
 
@@ -256,6 +318,7 @@ void inv_q_rotate(const long *q, const long *in, long *out)
     inv_q_invert(q, q_temp2);
     inv_q_mult(q_temp1, q_temp2, out4);
     memcpy(out, &out4[1], 3 * sizeof(long));
+#endif
 }
 
 void inv_q_multf(const float *q1, const float *q2, float *qProd)
@@ -345,6 +408,33 @@ void inv_q_invertf(const float *q, float *qInverted)
  */
 void inv_quaternion_to_rotation(const long *quat, long *rot)
 {
+#ifdef INV_USE_NEON_MATH
+    /* the ten distinct q29 products in three vector multiplies */
+    int32x4_t q = vld1q_s32((const int32_t *)quat);
+    int32_t a[4] = { quat[1], quat[1], quat[2], 0 };
+    int32_t b[4] = { quat[2], quat[3], quat[3], 0 };
+    int32_t c[4] = { quat[3], quat[2], quat[1], 0 };
+    int32x4_t sq = inv_q_shift_mult4(q, q, 29);     // 00 11 22 33
+    int32x4_t cross = inv_q_shift_mult4(vld1q_s32(a), vld1q_s32(b), 29);
+                                                    // 12 13 23 --
+    int32x4_t real = inv_q_shift_mult4(vld1q_s32(c),
+                                       vdupq_n_s32(quat[0]), 29);
+                                                    // 30 20 10 --
+    int32x4_t diag = vsubq_s32(vaddq_s32(sq, vdupq_n_s32(vgetq_lane_s32(sq, 0))),
+                               vdupq_n_s32(1073741824L));
+    int32x4_t sum = vaddq_s32(cross, real);
+    int32x4_t diff = vsubq_s32(cross, real);
+
+    rot[0] = vgetq_lane_s32(diag, 1);
+    rot[1] = vgetq_lane_s32(diff, 0);
+    rot[2] = vgetq_lane_s32(sum, 1);
+    rot[3] = vgetq_lane_s32(sum, 0);
+    rot[4] = vgetq_lane_s32(diag, 2);
+    rot[5] = vgetq_lane_s32(diff, 2);
+    rot[6] = vgetq_lane_s32(diff, 1);
+    rot[7] = vgetq_lane_s32(sum, 2);
+    rot[8] = vgetq_lane_s32(diag, 3);
+#else
     rot[0] =
         inv_q29_mult(quat[1], quat[1]) + inv_q29_mult(quat[0],
                 quat[0]) -
@@ -369,6 +459,7 @@ void inv_quaternion_to_rotation(const long *quat, long *rot)
         inv_q29_mult(quat[3], quat[3]) + inv_q29_mult(quat[0],
                 quat[0]) -
         1073741824L;
+#endif
 }
 
 /**
@@ -630,6 +721,28 @@ void inv_convert_to_chip(unsigned short orientation, const long *input, long *ou
 }
 
 
+/** Scales a body frame vector by a Q30 sensitivity.
+* @param[in] sensitivity Sensitivity scale
+* @param[in] body Input vector already in the body frame, length 3
+* @param[out] output Output vector, length 3
+*/
+static void inv_scale_body(long sensitivity, const long *body, long *output)
+{
+#ifdef INV_USE_NEON_MATH
+    int32_t in[4] = { body[0], body[1], body[2], 0 };
+    int32_t out[4];
+
+    vst1q_s32(out, inv_q_shift_mult4(vld1q_s32(in), vdupq_n_s32(sensitivity), 30));
+    output[0] = out[0];
+    output[1] = out[1];
+    output[2] = out[2];
+#else
+    output[0] = inv_q30_mult(body[0], sensitivity);
+    output[1] = inv_q30_mult(body[1], sensitivity);
+    output[2] = inv_q30_mult(body[2], sensitivity);
+#endif
+}
+
 /** Uses the scalar orientation value to convert from chip frame to body frame and
 * apply appropriate scaling.
 * @param[in] orientation A scalar that represent how to go from chip to body frame
@@ -639,12 +752,208 @@ void inv_convert_to_chip(unsigned short orientation, const long *input, long *ou
 */
 void inv_convert_to_body_with_scale(unsigned short orientation, long sensitivity, const long *input, long *output)
 {
-    output[0] = inv_q30_mult(input[orientation & 0x03] *
-                             SIGNSET(orientation & 0x004), sensitivity);
-    output[1] = inv_q30_mult(input[(orientation>>3) & 0x03] *
-                             SIGNSET(orientation & 0x020), sensitivity);
-    output[2] = inv_q30_mult(input[(orientation>>6) & 0x03] *
-                             SIGNSET(orientation & 0x100), sensitivity);
+    long body[3];
+
+    body[0] = input[orientation & 0x03] * SIGNSET(orientation & 0x004);
+    body[1] = input[(orientation>>3) & 0x03] * SIGNSET(orientation & 0x020);
+    body[2] = input[(orientation>>6) & 0x03] * SIGNSET(orientation & 0x100);
+    inv_scale_body(sensitivity, body, output);
+}
+
+/** Scales two body frame vectors by the same Q30 sensitivity.
+* @param[in] sensitivity Sensitivity scale
+* @param[in] a First input vector, length 3
+* @param[in] b Second input vector, length 3
+* @param[out] a_out Scaled a, length 3
+* @param[out] b_out Scaled b, length 3
+*/
+static void inv_scale_body_pair(long sensitivity, const long *a, const long *b,
+                                long *a_out, long *b_out)
+{
+#ifdef INV_USE_NEON_MATH
+    int32_t in_a[4] = { a[0], a[1], a[2], b[0] };
+    int32_t in_b[4] = { b[1], b[2], 0, 0 };
+    int32_t out_a[4], out_b[4];
+    int32x4_t s = vdupq_n_s32(sensitivity);
+
+    vst1q_s32(out_a, inv_q_shift_mult4(vld1q_s32(in_a), s, 30));
+    vst1q_s32(out_b, inv_q_shift_mult4(vld1q_s32(in_b), s, 30));
+    a_out[0] = out_a[0];
+    a_out[1] = out_a[1];
+    a_out[2] = out_a[2];
+    b_out[0] = out_a[3];
+    b_out[1] = out_b[0];
+    b_out[2] = out_b[1];
+#else
+    a_out[0] = inv_q30_mult(a[0], sensitivity);
+    a_out[1] = inv_q30_mult(a[1], sensitivity);
+    a_out[2] = inv_q30_mult(a[2], sensitivity);
+    b_out[0] = inv_q30_mult(b[0], sensitivity);
+    b_out[1] = inv_q30_mult(b[1], sensitivity);
+    b_out[2] = inv_q30_mult(b[2], sensitivity);
+#endif
+}
+
+/** Converts a chip frame sample to the body frame both as is and with a bias
+* removed, scaling both, in one pass over the input. Gives the same results as
+* two inv_convert_to_body_with_scale() calls, before and after subtracting the
+* chip frame bias.
+* @param[in] orientation A scalar that represent how to go from chip to body frame
+* @param[in] sensitivity Sensitivity scale
+* @param[in] input Input vector in the chip frame, length 3
+* @param[in] body_bias Bias already converted to the body frame, length 3
+* @param[out] raw_out Scaled input in the body frame, length 3
+* @param[out] cal_out Scaled input minus bias in the body frame, length 3
+*/
+void inv_convert_to_body_calibrated(unsigned short orientation, long sensitivity,
+                                    const long *input, const long *body_bias,
+                                    long *raw_out, long *cal_out)
+{
+    long body[3], cal[3];
+
+    body[0] = input[orientation & 0x03] * SIGNSET(orientation & 0x004);
+    body[1] = input[(orientation>>3) & 0x03] * SIGNSET(orientation & 0x020);
+    body[2] = input[(orientation>>6) & 0x03] * SIGNSET(orientation & 0x100);
+    cal[0] = body[0] - body_bias[0];
+    cal[1] = body[1] - body_bias[1];
+    cal[2] = body[2] - body_bias[2];
+    inv_scale_body_pair(sensitivity, body, cal, raw_out, cal_out);
+}
+
+/* One set of conversion kernels for each of the 48 signed permutations an
+ * orientation scalar can describe, with the columns and signs fixed at
+ * compile time. c0..c2 are the input columns of the body rows and s0..s2
+ * their signs, 1 meaning negated. */
+#define INV_ORIENT_ROW(in, c, s) ((s) ? -(in)[c] : (in)[c])
+
+#define INV_ORIENT_KERNELS(n, c0, c1, c2, s0, s1, s2)                      \
+static void inv_to_body_##n(const long *input, long *output)               \
+{                                                                           \
+    output[0] = INV_ORIENT_ROW(input, c0, s0);                              \
+    output[1] = INV_ORIENT_ROW(input, c1, s1);                              \
+    output[2] = INV_ORIENT_ROW(input, c2, s2);                              \
+}                                                                           \
+static void inv_to_chip_##n(const long *input, long *output)               \
+{                                                                           \
+    output[c0] = (s0) ? -input[0] : input[0];                               \
+    output[c1] = (s1) ? -input[1] : input[1];                               \
+    output[c2] = (s2) ? -input[2] : input[2];                               \
+}                                                                           \
+static void inv_to_body_scale_##n(long sensitivity, const long *input,     \
+                                  long *output)                             \
+{                                                                           \
+    long body[3];                                                           \
+    body[0] = INV_ORIENT_ROW(input, c0, s0);                                \
+    body[1] = INV_ORIENT_ROW(input, c1, s1);                                \
+    body[2] = INV_ORIENT_ROW(input, c2, s2);                                \
+    inv_scale_body(sensitivity, body, output);                              \
+}                                                                           \
+static void inv_to_body_cal_##n(long sensitivity, const long *input,       \
+                                const long *body_bias, long *raw_out,       \
+                                long *cal_out)                              \
+{                                                                           \
+    long body[3], cal[3];                                                   \
+    body[0] = INV_ORIENT_ROW(input, c0, s0);                                \
+    body[1] = INV_ORIENT_ROW(input, c1, s1);                                \
+    body[2] = INV_ORIENT_ROW(input, c2, s2);                                \
+    cal[0] = body[0] - body_bias[0];                                        \
+    cal[1] = body[1] - body_bias[1];                                        \
+    cal[2] = body[2] - body_bias[2];                                        \
+    inv_scale_body_pair(sensitivity, body, cal, raw_out, cal_out);          \
+}
+
+#define INV_ORIENT_SIGNS(X, p, c0, c1, c2) \
+    X(p##_0, c0, c1, c2, 0, 0, 0) \
+    X(p##_1, c0, c1, c2, 1, 0, 0) \
+    X(p##_2, c0, c1, c2, 0, 1, 0) \
+    X(p##_3, c0, c1, c2, 1, 1, 0) \
+    X(p##_4, c0, c1, c2, 0, 0, 1) \
+    X(p##_5, c0, c1, c2, 1, 0, 1) \
+    X(p##_6, c0, c1, c2, 0, 1, 1) \
+    X(p##_7, c0, c1, c2, 1, 1, 1)
+
+#define INV_ORIENT_ALL(X) \
+    INV_ORIENT_SIGNS(X, 012, 0, 1, 2) \
+    INV_ORIENT_SIGNS(X, 021, 0, 2, 1) \
+    INV_ORIENT_SIGNS(X, 102, 1, 0, 2) \
+    INV_ORIENT_SIGNS(X, 120, 1, 2, 0) \
+    INV_ORIENT_SIGNS(X, 201, 2, 0, 1) \
+    INV_ORIENT_SIGNS(X, 210, 2, 1, 0)
+
+INV_ORIENT_ALL(INV_ORIENT_KERNELS)
+
+struct inv_orient_kernels_t {
+    unsigned short orientation;
+    inv_convert_func_t to_body;
+    inv_convert_func_t to_chip;
+    inv_convert_scale_func_t to_body_with_scale;
+    inv_convert_cal_func_t to_body_calibrated;
+};
+
+#define INV_ORIENT_ENTRY(n, c0, c1, c2, s0, s1, s2)                         \
+    { (c0) | ((s0) << 2) | ((c1) << 3) | ((s1) << 5) | ((c2) << 6) |       \
+      ((s2) << 8),                                                          \
+      inv_to_body_##n, inv_to_chip_##n, inv_to_body_scale_##n,              \
+      inv_to_body_cal_##n },
+
+static const struct inv_orient_kernels_t inv_orient_kernels[] = {
+    INV_ORIENT_ALL(INV_ORIENT_ENTRY)
+};
+
+static const struct inv_orient_kernels_t *inv_find_orient_kernels(
+    unsigned short orientation)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(inv_orient_kernels) / sizeof(inv_orient_kernels[0]); i++) {
+        if (inv_orient_kernels[i].orientation == orientation)
+            return &inv_orient_kernels[i];
+    }
+    return NULL;
+}
+
+/** Returns a chip to body conversion specialized for an orientation scalar.
+* Look it up once when the orientation is set instead of decoding the scalar
+* on every sample.
+* @param[in] orientation A scalar that represent how to go from chip to body frame
+* @return The conversion, or NULL if the scalar is not a signed permutation.
+*/
+inv_convert_func_t inv_get_convert_to_body(unsigned short orientation)
+{
+    const struct inv_orient_kernels_t *k = inv_find_orient_kernels(orientation);
+    return k ? k->to_body : NULL;
+}
+
+/** Returns a body to chip conversion specialized for an orientation scalar.
+* @param[in] orientation A scalar that represent how to go from chip to body frame
+* @return The conversion, or NULL if the scalar is not a signed permutation.
+*/
+inv_convert_func_t inv_get_convert_to_chip(unsigned short orientation)
+{
+    const struct inv_orient_kernels_t *k = inv_find_orient_kernels(orientation);
+    return k ? k->to_chip : NULL;
+}
+
+/** Returns a scaled chip to body conversion specialized for an orientation
+* scalar, the per mount equivalent of inv_convert_to_body_with_scale().
+* @param[in] orientation A scalar that represent how to go from chip to body frame
+* @return The conversion, or NULL if the scalar is not a signed permutation.
+*/
+inv_convert_scale_func_t inv_get_convert_to_body_with_scale(unsigned short orientation)
+{
+    const struct inv_orient_kernels_t *k = inv_find_orient_kernels(orientation);
+    return k ? k->to_body_with_scale : NULL;
+}
+
+/** Returns the specialized inv_convert_to_body_calibrated() for an
+* orientation scalar.
+* @param[in] orientation A scalar that represent how to go from chip to body frame
+* @return The conversion, or NULL if the scalar is not a signed permutation.
+*/
+inv_convert_cal_func_t inv_get_convert_to_body_calibrated(unsigned short orientation)
+{
+    const struct inv_orient_kernels_t *k = inv_find_orient_kernels(orientation);
+    return k ? k->to_body_calibrated : NULL;
 }
 
 /** find a norm for a vector
@@ -694,6 +1003,90 @@ float inv_biquad_filter_process(inv_biquad_filter_t *pFilter, float input)  {
     return pFilter->output;
 }
 
+/** Initializes a three axis biquad filter bank.
+* @param[out] pBank Filter bank to initialize
+* @param[in] pBiquadCoeff The 5 filter coefficients, same layout as for
+*            inv_init_biquad_filter()
+*/
+void inv_init_biquad_bank(inv_biquad_bank_t *pBank, const float *pBiquadCoeff)
+{
+    int i;
+
+    memset(pBank->state, 0, sizeof(pBank->state));
+    for (i=0; i<5; i++) {
+        pBank->c[i] = pBiquadCoeff[i];
+    }
+}
+
+/** Sets the state of all three filters so their output matches the input,
+* as inv_calc_state_to_match_output() does for a single filter.
+* @param[in,out] pBank Filter bank
+* @param[in] input One sample, length 3
+*/
+void inv_biquad_bank_match_output(inv_biquad_bank_t *pBank, const float *input)
+{
+    float scale = 1 + pBank->c[2] + pBank->c[3];
+    int i;
+
+    for (i=0; i<3; i++) {
+        pBank->state[0][i] = input[i] / scale;
+        pBank->state[1][i] = pBank->state[0][i];
+    }
+}
+
+/** Runs a batch of three axis samples through the filter bank. Gives the
+* same result as calling inv_biquad_filter_process() once per axis and sample.
+* @param[in,out] pBank Filter bank
+* @param[in] input count samples of 3 axes, x/y/z interleaved
+* @param[out] output Filtered samples, same layout as input. May be input.
+* @param[in] count Number of samples
+*/
+void inv_biquad_bank_process(inv_biquad_bank_t *pBank, const float *input,
+                             float *output, int count)
+{
+#ifdef INV_USE_NEON_MATH
+    float32x4_t s0 = vld1q_f32(pBank->state[0]);
+    float32x4_t s1 = vld1q_f32(pBank->state[1]);
+    float lane[4] = {0, 0, 0, 0};
+    float32x4_t zero, out;
+    int n;
+
+    for (n=0; n<count; n++, input += 3, output += 3) {
+        lane[0] = input[0];
+        lane[1] = input[1];
+        lane[2] = input[2];
+        zero = vld1q_f32(lane);
+        zero = vmlsq_n_f32(zero, s0, pBank->c[2]);
+        zero = vmlsq_n_f32(zero, s1, pBank->c[3]);
+        out = vmlaq_n_f32(zero, s0, pBank->c[0]);
+        out = vmlaq_n_f32(out, s1, pBank->c[1]);
+        out = vmulq_n_f32(out, pBank->c[4]);
+        s1 = s0;
+        s0 = zero;
+        vst1q_f32(lane, out);
+        output[0] = lane[0];
+        output[1] = lane[1];
+        output[2] = lane[2];
+    }
+    vst1q_f32(pBank->state[0], s0);
+    vst1q_f32(pBank->state[1], s1);
+#else
+    float stateZero;
+    int n, i;
+
+    for (n=0; n<count; n++, input += 3, output += 3) {
+        for (i=0; i<3; i++) {
+            stateZero = input[i] - pBank->c[2]*pBank->state[0][i]
+                                 - pBank->c[3]*pBank->state[1][i];
+            output[i] = (stateZero + pBank->c[0]*pBank->state[0][i]
+                                   + pBank->c[1]*pBank->state[1][i]) * pBank->c[4];
+            pBank->state[1][i] = pBank->state[0][i];
+            pBank->state[0][i] = stateZero;
+        }
+    }
+#endif
+}
+
 void inv_get_cross_product_vec(float *cgcross, float compass[3], float grav[3])  {
 
     cgcross[0] = (float)compass[1] * grav[2] - (float)compass[2] * grav[1];
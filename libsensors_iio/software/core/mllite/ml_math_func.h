@@ -9,6 +9,15 @@
 
 #include "mltypes.h"
 
+/* INV_MATH_NEON selects the NEON versions of the fixed point vector math.
+ * They give the same results as the scalar code, bit for bit, and rely on
+ * long being 32 bits wide, so they are only built for ARMv7. */
+#if defined(INV_MATH_NEON) && defined(__ARM_NEON__) && \
+    !defined(UMPL_ELIMINATE_64BIT)
+#define INV_USE_NEON_MATH
+#include <arm_neon.h>
+#endif
+
 #define GYRO_MAG_SQR_SHIFT 6
 #define NUM_ROTATION_MATRIX_ELEMENTS (9)
 #define ROT_MATRIX_SCALE_LONG  (1073741824L)
@@ -31,6 +40,13 @@ extern "C" {
         float output;
     }   inv_biquad_filter_t;
 
+    /* Biquad filters with shared coefficients for the three axes of a
+     * sensor, one lane per axis. The fourth lane pads the state for NEON. */
+    typedef struct {
+        float state[2][4];
+        float c[5];
+    }   inv_biquad_bank_t;
+
     static inline float inv_q30_to_float(long q30)
     {
         return (float) q30 / ((float)(1L << 30));
@@ -57,6 +73,18 @@ extern "C" {
     long inv_q29_mult(long a, long b);
     long inv_q30_mult(long a, long b);
 
+#ifdef INV_USE_NEON_MATH
+    /* lane-wise ((long long)a * b) >> shift, truncated like inv_q30_mult() */
+    static inline int32x4_t inv_q_shift_mult4(int32x4_t a, int32x4_t b,
+                                              const int shift)
+    {
+        int64x2_t lo = vmull_s32(vget_low_s32(a), vget_low_s32(b));
+        int64x2_t hi = vmull_s32(vget_high_s32(a), vget_high_s32(b));
+        return vcombine_s32(vmovn_s64(vshlq_s64(lo, vdupq_n_s64(-shift))),
+                            vmovn_s64(vshlq_s64(hi, vdupq_n_s64(-shift))));
+    }
+#endif
+
     /* UMPL_ELIMINATE_64BIT Notes:
      * An alternate implementation using float instead of long long accudoublemulators
      * is provided for q29_mult and q30_mult.
@@ -94,6 +122,18 @@ extern "C" {
     void inv_convert_to_body(unsigned short orientation, const long *input, long *output);
     void inv_convert_to_chip(unsigned short orientation, const long *input, long *output);
     void inv_convert_to_body_with_scale(unsigned short orientation, long sensitivity, const long *input, long *output);
+    typedef void (*inv_convert_func_t)(const long *input, long *output);
+    typedef void (*inv_convert_scale_func_t)(long sensitivity, const long *input, long *output);
+    inv_convert_func_t inv_get_convert_to_body(unsigned short orientation);
+    inv_convert_func_t inv_get_convert_to_chip(unsigned short orientation);
+    inv_convert_scale_func_t inv_get_convert_to_body_with_scale(unsigned short orientation);
+    void inv_convert_to_body_calibrated(unsigned short orientation, long sensitivity,
+                                        const long *input, const long *body_bias,
+                                        long *raw_out, long *cal_out);
+    typedef void (*inv_convert_cal_func_t)(long sensitivity, const long *input,
+                                           const long *body_bias, long *raw_out,
+                                           long *cal_out);
+    inv_convert_cal_func_t inv_get_convert_to_body_calibrated(unsigned short orientation);
     void inv_q_rotate(const long *q, const long *in, long *out);
 	void inv_vector_normalize(long *vec, int length);
     uint32_t inv_checksum(const unsigned char *str, int len);
@@ -112,6 +152,10 @@ extern "C" {
     void inv_init_biquad_filter(inv_biquad_filter_t *pFilter, float *pBiquadCoeff);
     float inv_biquad_filter_process(inv_biquad_filter_t *pFilter, float input);
     void inv_calc_state_to_match_output(inv_biquad_filter_t *pFilter, float input);
+    void inv_init_biquad_bank(inv_biquad_bank_t *pBank, const float *pBiquadCoeff);
+    void inv_biquad_bank_process(inv_biquad_bank_t *pBank, const float *input,
+                                 float *output, int count);
+    void inv_biquad_bank_match_output(inv_biquad_bank_t *pBank, const float *input);
     void inv_get_cross_product_vec(float *cgcross, float compass[3], float grav[3]);
 
 #ifdef __cplusplus
@@ -28,6 +28,9 @@
 #define INV_COMPASS_CORRECTION_SET 1
 #define INV_6_AXIS_QUAT_SET 2
 
+static void inv_quat_to_gravity(const long *quat, long *data);
+static void inv_publish_results_snapshot(void);
+
 struct results_t {
     long nav_quat[4];
     long gam_quat[4];
@@ -51,6 +54,15 @@ struct results_t {
 };
 static struct results_t rh;
 
+/** Results of the last processed sample, published by inv_generate_results()
+* under a sequence count so readers on other threads get a consistent copy
+* without taking a lock. seq is odd while the copy is being written. */
+struct results_snapshot_holder_t {
+    volatile unsigned int seq;
+    struct inv_results_snapshot_t data;
+};
+static struct results_snapshot_holder_t rs;
+
 /** @internal
 * Store a quaternion more suitable for gaming. This quaternion is often determined
 * using only gyro and accel.
@@ -192,20 +204,29 @@ void inv_get_mag_scale(long *data)
     memcpy(data, rh.mag_scale, sizeof(rh.mag_scale));
 }
 
-/** Gets gravity vector
+/** @internal
+ * Gravity vector in body frame for a quaternion.
+ * @param[in] quat Quaternion scaled such that 1.0 = 2^30.
  * @param[out] data gravity vector in body frame scaled such that 1.0 = 2^30.
- * @return Returns INV_SUCCESS if successful or an error code if not.
  */
-inv_error_t inv_get_gravity(long *data)
+static void inv_quat_to_gravity(const long *quat, long *data)
 {
     data[0] =
-        inv_q29_mult(rh.nav_quat[1], rh.nav_quat[3]) - inv_q29_mult(rh.nav_quat[2], rh.nav_quat[0]);
+        inv_q29_mult(quat[1], quat[3]) - inv_q29_mult(quat[2], quat[0]);
     data[1] =
-        inv_q29_mult(rh.nav_quat[2], rh.nav_quat[3]) + inv_q29_mult(rh.nav_quat[1], rh.nav_quat[0]);
+        inv_q29_mult(quat[2], quat[3]) + inv_q29_mult(quat[1], quat[0]);
     data[2] =
-        (inv_q29_mult(rh.nav_quat[3], rh.nav_quat[3]) + inv_q29_mult(rh.nav_quat[0], rh.nav_quat[0])) -
+        (inv_q29_mult(quat[3], quat[3]) + inv_q29_mult(quat[0], quat[0])) -
         1073741824L;
+}
 
+/** Gets gravity vector
+ * @param[out] data gravity vector in body frame scaled such that 1.0 = 2^30.
+ * @return Returns INV_SUCCESS if successful or an error code if not.
+ */
+inv_error_t inv_get_gravity(long *data)
+{
+    inv_quat_to_gravity(rh.nav_quat, data);
     return INV_SUCCESS;
 }
 
@@ -276,9 +297,45 @@ void inv_get_quaternion_set(long *data, int *accuracy, inv_time_t *timestamp)
 inv_error_t inv_generate_results(struct inv_sensor_cal_t *sensor_cal)
 {
     rh.sensor = sensor_cal;
+    inv_publish_results_snapshot();
     return INV_SUCCESS;
 }
 
+/** @internal
+ * Copies the results of the sample just processed to the snapshot readers
+ * see. Only called from the data processing thread.
+ */
+static void inv_publish_results_snapshot(void)
+{
+    struct inv_results_snapshot_t *snap = &rs.data;
+
+    rs.seq++;
+    __sync_synchronize();
+    inv_get_quaternion_set(snap->quat, &snap->accuracy, &snap->timestamp);
+    memcpy(snap->quat_6axis, rh.gam_quat, sizeof(snap->quat_6axis));
+    inv_quat_to_gravity(snap->quat, snap->gravity);
+    snap->motion_state = rh.motion_state;
+    __sync_synchronize();
+    rs.seq++;
+}
+
+/** Gets the quaternion, gravity and motion state of the last processed
+ * sample as one consistent set. Safe to call from another thread than the
+ * one feeding data to the MPL, it does not block the data processing.
+ * @param[out] snap Results of the last processed sample.
+ */
+void inv_get_results_snapshot(struct inv_results_snapshot_t *snap)
+{
+    unsigned int seq;
+
+    do {
+        seq = rs.seq;
+        __sync_synchronize();
+        memcpy(snap, &rs.data, sizeof(*snap));
+        __sync_synchronize();
+    } while ((seq & 1) || seq != rs.seq);
+}
+
 /** Function to turn on this module. This is automatically called by
  *  inv_enable_results_holder(). Typically not called by users.
  * @return Returns INV_SUCCESS if successful or an error code if not.
@@ -298,6 +355,9 @@ inv_error_t inv_start_results_holder(void)
 inv_error_t inv_init_results_holder(void)
 {
     memset(&rh, 0, sizeof(rh));
+    memset(&rs.data, 0, sizeof(rs.data));
+    rs.data.quat[0] = 1L<<30;
+    rs.data.quat_6axis[0] = 1L<<30;
     rh.mag_scale[0] = 1L<<30;
     rh.mag_scale[1] = 1L<<30;
     rh.mag_scale[2] = 1L<<30;
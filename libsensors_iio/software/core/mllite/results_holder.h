@@ -44,6 +44,22 @@ inv_error_t inv_get_quaternion(long *data);
 inv_error_t inv_get_quaternion_float(float *data);
 void inv_get_quaternion_set(long *data, int *accuracy, inv_time_t *timestamp);
 
+/** Results of one processed sample, see inv_get_results_snapshot() */
+struct inv_results_snapshot_t {
+    /** 9-axis quaternion scaled such that 1.0 = 2^30 */
+    long quat[4];
+    /** Gyro and accel quaternion scaled such that 1.0 = 2^30 */
+    long quat_6axis[4];
+    /** Gravity in body frame scaled such that 1.0 = 2^30 */
+    long gravity[3];
+    /** Accuracy of quat, 0-3, where 3 is most accurate */
+    int accuracy;
+    inv_time_t timestamp;
+    /** INV_MOTION or INV_NO_MOTION */
+    unsigned char motion_state;
+};
+void inv_get_results_snapshot(struct inv_results_snapshot_t *snap);
+
 inv_error_t inv_enable_results_holder();
 inv_error_t inv_init_results_holder(void);
 
@@ -29,6 +29,8 @@ typedef inv_error_t (*load_func_t)(const unsigned char *data);
 typedef inv_error_t (*save_func_t)(unsigned char *data);
 /** Max number of entites that can be stored */
 #define NUM_STORAGE_BOXES 20
+/** Slots in the key index, a power of 2 above NUM_STORAGE_BOXES */
+#define STORAGE_INDEX_SIZE 32
 
 struct data_header_t {
     long size;
@@ -42,6 +44,8 @@ struct data_storage_t {
     load_func_t load[NUM_STORAGE_BOXES]; /**< Callback to load data */
     save_func_t save[NUM_STORAGE_BOXES]; /**< Callback to save data */
     struct data_header_t hd[NUM_STORAGE_BOXES]; /**< Header info for each entity */
+    size_t offset[NUM_STORAGE_BOXES]; /**< Offset of each entity's header in a saved block */
+    signed char index[STORAGE_INDEX_SIZE]; /**< Entity for a key hash, -1 if empty */
 };
 static struct data_storage_t ds;
 
@@ -50,9 +54,18 @@ static struct data_storage_t ds;
 void inv_init_storage_manager()
 {
     memset(&ds, 0, sizeof(ds));
+    memset(ds.index, -1, sizeof(ds.index));
     ds.total_size = sizeof(struct data_header_t);
 }
 
+/** @internal
+ * First slot of ds.index[] to probe for a key.
+ */
+static int inv_key_slot(unsigned int key)
+{
+    return (int)((key * 2654435761U) >> 27) & (STORAGE_INDEX_SIZE - 1);
+}
+
 /** Used to register your mechanism to load and store non-volative data. This should typical be
 * called during the enable function for your feature.
 * @param[in] load_func function pointer you will use to receive data that was stored for you.
@@ -66,10 +79,11 @@ void inv_init_storage_manager()
 inv_error_t inv_register_load_store(inv_error_t (*load_func)(const unsigned char *data),
                                     inv_error_t (*save_func)(unsigned char *data), size_t size, unsigned int key)
 {
-    int kk;
+    int slot;
     // Check if this has been registered already
-    for (kk=0; kk<ds.num; ++kk) {
-        if (key == ds.hd[kk].key) {
+    for (slot = inv_key_slot(key); ds.index[slot] >= 0;
+            slot = (slot + 1) & (STORAGE_INDEX_SIZE - 1)) {
+        if (key == ds.hd[(int)ds.index[slot]].key) {
             return INV_ERROR_INVALID_PARAMETER;
         }
     }
@@ -82,6 +96,8 @@ inv_error_t inv_register_load_store(inv_error_t (*load_func)(const unsigned char
     ds.hd[ds.num].size = size;
     ds.load[ds.num] = load_func;
     ds.save[ds.num] = save_func;
+    ds.offset[ds.num] = ds.total_size;
+    ds.index[slot] = (signed char)ds.num;
     ds.total_size += size + sizeof(struct data_header_t);
     ds.num++;
 
@@ -104,15 +120,67 @@ inv_error_t inv_get_mpl_state_size(size_t *size)
  */
 static int inv_find_entry(unsigned int key)
 {
-    int kk;
-    for (kk=0; kk<ds.num; ++kk) {
-        if (key == ds.hd[kk].key) {
-            return kk;
+    int slot;
+    for (slot = inv_key_slot(key); ds.index[slot] >= 0;
+            slot = (slot + 1) & (STORAGE_INDEX_SIZE - 1)) {
+        if (key == ds.hd[(int)ds.index[slot]].key) {
+            return ds.index[slot];
         }
     }
     return -1;
 }
 
+/** Finds the stored state of one entity in a block saved by
+* inv_save_mpl_states() without copying it, so a module can read its state
+* straight out of a mapped calibration file.
+* @param[in] data Block that was saved, as passed to inv_load_mpl_states()
+* @param[in] length Length of data in bytes
+* @param[in] key Key the entity registered with inv_register_load_store()
+* @param[out] state Set to the entity's state inside data
+* @return Returns INV_SUCCESS if successful, or INV_ERROR_CALIBRATION_LOAD if
+*         the entity is not in data or its checksum does not match.
+*/
+inv_error_t inv_find_mpl_state(const unsigned char *data, size_t length,
+                               unsigned int key, const unsigned char **state)
+{
+    const struct data_header_t *hd;
+    size_t off;
+    int entry;
+
+    entry = inv_find_entry(key);
+    if (entry < 0 || length < sizeof(struct data_header_t))
+        return INV_ERROR_CALIBRATION_LOAD;
+    hd = (const struct data_header_t *)data;
+    if (hd->key != DEFAULT_KEY || hd->size > (long)length)
+        return INV_ERROR_CALIBRATION_LOAD;
+    length = hd->size;
+
+    // Saved with the current layout the entity sits at its own offset,
+    // otherwise walk the records
+    off = ds.offset[entry];
+    hd = (const struct data_header_t *)(data + off);
+    if (off + sizeof(struct data_header_t) > length || hd->key != key) {
+        off = sizeof(struct data_header_t);
+        for (;;) {
+            if (off + sizeof(struct data_header_t) > length)
+                return INV_ERROR_CALIBRATION_LOAD;
+            hd = (const struct data_header_t *)(data + off);
+            if (hd->key == key)
+                break;
+            if (hd->size < 0)
+                return INV_ERROR_CALIBRATION_LOAD;
+            off += sizeof(struct data_header_t) + hd->size;
+        }
+    }
+    off += sizeof(struct data_header_t);
+    if (hd->size != ds.hd[entry].size || off + hd->size > length ||
+            inv_checksum(data + off, hd->size) != hd->checksum)
+        return INV_ERROR_CALIBRATION_LOAD;
+
+    *state = data + off;
+    return INV_SUCCESS;
+}
+
 /** This function takes a block of data that has been saved in non-volatile memory and pushes
 * to the proper locations. Multiple error checks are performed on the data.
 * @param[in] data Data that was saved to be loaded up by MPL
@@ -125,6 +193,7 @@ inv_error_t inv_load_mpl_states(const unsigned char *data, size_t length)
     int entry;
     uint32_t checksum;
     long len;
+    int corrupt = 0, skipped = 0;
 
     len = length; // Important so we get negative numbers
     if (len < sizeof(struct data_header_t))
@@ -137,8 +206,12 @@ inv_error_t inv_load_mpl_states(const unsigned char *data, size_t length)
     len -= sizeof(struct data_header_t);
     data += sizeof(struct data_header_t);
     checksum = inv_checksum(data, len);
-    if (checksum != hd->checksum)
-        return INV_ERROR_CALIBRATION_LOAD;	// Data corruption
+    if (checksum != hd->checksum) {
+        // An in place update was cut short, only trust records whose own
+        // checksum still matches
+        MPL_LOGW("stored state checksum mismatch, checking each record\n");
+        corrupt = 1;
+    }
 
     while (len > (long)sizeof(struct data_header_t)) {
         hd = (struct data_header_t *)data;
@@ -150,6 +223,9 @@ inv_error_t inv_load_mpl_states(const unsigned char *data, size_t length)
                 checksum = inv_checksum(data, hd->size);
                 if (checksum == hd->checksum) {
                     ds.load[entry](data);
+                } else if (corrupt) {
+                    MPL_LOGW("skipping stored record %u\n", hd->key);
+                    skipped = 1;
                 } else {
                     return INV_ERROR_CALIBRATION_LOAD;
                 }
@@ -160,7 +236,7 @@ inv_error_t inv_load_mpl_states(const unsigned char *data, size_t length)
             data = data + hd->size;
     }
 
-    return INV_SUCCESS;
+    return skipped ? INV_ERROR_CALIBRATION_LOAD : INV_SUCCESS;
 }
 
 /** This function fills up a block of memory to be stored in non-volatile memory.
@@ -199,6 +275,68 @@ inv_error_t inv_save_mpl_states(unsigned char *data, size_t sz)
     return INV_SUCCESS;
 }
 
+/** Refreshes a block previously filled by inv_save_mpl_states() in place.
+* Only the records whose content changed are written, so the block can live
+* in a shared file mapping without dirtying pages that did not change.
+* @param[in,out] data Block to update, as filled by inv_save_mpl_states()
+* @param[in] sz Size of data, must match inv_get_mpl_state_size()
+* @param[out] scratch Work area of at least inv_get_mpl_state_size() bytes
+* @param[out] dirty_start Offset of the first byte that was written
+* @param[out] dirty_end Offset past the last byte that was written, equal to
+*             dirty_start if nothing changed
+* @return Returns INV_SUCCESS if successful, or INV_ERROR_CALIBRATION_LOAD if
+*         the layout of data does not match the registered modules, in which
+*         case the block has to be saved again in full.
+*/
+inv_error_t inv_update_mpl_states(unsigned char *data, size_t sz,
+                                  unsigned char *scratch,
+                                  size_t *dirty_start, size_t *dirty_end)
+{
+    unsigned char *cur;
+    int kk;
+    struct data_header_t *hd;
+
+    *dirty_start = *dirty_end = 0;
+    hd = (struct data_header_t *)data;
+    if (sz != ds.total_size || hd->key != DEFAULT_KEY ||
+            hd->size != (long)ds.total_size)
+        return INV_ERROR_CALIBRATION_LOAD;
+
+    // Check the whole layout first so nothing is written on a mismatch
+    cur = data + sizeof(struct data_header_t);
+    for (kk = 0; kk < ds.num; ++kk) {
+        hd = (struct data_header_t *)cur;
+        if (hd->key != ds.hd[kk].key || hd->size != ds.hd[kk].size)
+            return INV_ERROR_CALIBRATION_LOAD;
+        cur += sizeof(struct data_header_t) + ds.hd[kk].size;
+    }
+
+    cur = data + sizeof(struct data_header_t);
+    for (kk = 0; kk < ds.num; ++kk) {
+        hd = (struct data_header_t *)cur;
+        cur += sizeof(struct data_header_t);
+        ds.save[kk](scratch);
+        if (memcmp(scratch, cur, ds.hd[kk].size)) {
+            memcpy(cur, scratch, ds.hd[kk].size);
+            hd->checksum = inv_checksum(cur, ds.hd[kk].size);
+            if (*dirty_end == 0)
+                *dirty_start = (unsigned char *)hd - data;
+            *dirty_end = (cur - data) + ds.hd[kk].size;
+        }
+        cur += ds.hd[kk].size;
+    }
+
+    if (*dirty_end) {
+        // The block checksum goes last, a record without it still loads
+        hd = (struct data_header_t *)data;
+        hd->checksum = inv_checksum(data + sizeof(struct data_header_t),
+                                    ds.total_size - sizeof(struct data_header_t));
+        *dirty_start = 0;
+    }
+
+    return INV_SUCCESS;
+}
+
 /**
  * @}
  */
@@ -22,6 +22,11 @@ void inv_init_storage_manager(void);
 inv_error_t inv_get_mpl_state_size(size_t *size);
 inv_error_t inv_load_mpl_states(const unsigned char *data, size_t len);
 inv_error_t inv_save_mpl_states(unsigned char *data, size_t len);
+inv_error_t inv_find_mpl_state(const unsigned char *data, size_t len,
+                               unsigned int key, const unsigned char **state);
+inv_error_t inv_update_mpl_states(unsigned char *data, size_t len,
+                                  unsigned char *scratch,
+                                  size_t *dirty_start, size_t *dirty_end);
 
 #ifdef __cplusplus
 }
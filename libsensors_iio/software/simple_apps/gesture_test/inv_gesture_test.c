@@ -19,6 +19,8 @@
 #include <linux/time.h>
 #include <unistd.h>
 #include <termios.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
 
 #include "invensense.h"
 #include "ml_math_func.h"
@@ -34,7 +36,7 @@
 #define FLICK_UPPER_THRES       3147790
 #define FLICK_LOWER_THRES       -3147790
 #define FLICK_COUNTER           50
-#define POLL_TIME               2000 // 2sec
+#define EVENT_BUF_LEN           32
 
 #define FALSE   0
 #define TRUE    1
@@ -65,6 +67,7 @@ struct sysfs_attrbs {
     char *tap_on;
     char *tap_threshold;
     char *tap_time;
+    char *event_timestamp;
 } mpu;
 
 enum {
@@ -75,7 +78,31 @@ enum {
     numDMPFeatures
 };
 
-struct pollfd pfd[numDMPFeatures];
+/* per feature event node and the latency seen for it */
+struct gesture_event {
+    const char *name;
+    int (*handler)(int data);
+    int fd;
+    unsigned long count;
+    long long irq_min, irq_max, irq_sum;    /* DMP interrupt -> handler, ns */
+    long long disp_min, disp_max, disp_sum; /* epoll wakeup -> handled, ns */
+};
+
+int flickHandler(int data);
+int tapHandler(int tap);
+int googleOrientHandler(int orient);
+int orientHandler(int orient);
+
+struct gesture_event events[numDMPFeatures] = {
+    [tap]     = { "tap",                 tapHandler,          -1 },
+    [flick]   = { "flick",               flickHandler,        -1 },
+    [gOrient] = { "display_orientation", googleOrientHandler, -1 },
+    [orient]  = { "orientation",         orientHandler,       -1 },
+};
+
+/* optional node holding the time of the last DMP interrupt */
+int irq_ts_fd = -1;
+int quiet;
 
 /*******************************************************************************
  *                       DMP Feature Supported Functions
@@ -113,26 +140,54 @@ int write_sysfs_int(char *filename, int data)
     return res;
 }
 
-/**************************************************
-    This _kbhit() function is courtesy from Web
-***************************************************/
-int _kbhit() {
-    static const int STDIN = 0;
-    static bool initialized = false;
-
-    if (! initialized) {
-        // Use termios to turn off line buffering
-        struct termios term;
-        tcgetattr(STDIN, &term);
+static long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long cpu_us(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL +
+        ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/**
+ *  Read the value of an already open sysfs node.  Reading from offset 0
+ *  also re-arms the node so that the next sysfs_notify() wakes epoll.
+ */
+static int read_event_fd(int fd, long long *val)
+{
+    char buf[EVENT_BUF_LEN];
+    int n;
+
+    if (lseek(fd, 0, SEEK_SET) < 0)
+        return -1;
+    n = read(fd, buf, sizeof(buf) - 1);
+    if (n <= 0)
+        return -1;
+    buf[n] = 0;
+    *val = strtoll(buf, NULL, 0);
+    return 0;
+}
+
+/* turn off line buffering so any key stops the program */
+static void stdin_unbuffered(int on)
+{
+    static struct termios saved;
+    struct termios term;
+
+    if (on) {
+        tcgetattr(STDIN_FILENO, &saved);
+        term = saved;
         term.c_lflag &= ~ICANON;
-        tcsetattr(STDIN, TCSANOW, &term);
-        setbuf(stdin, NULL);
-        initialized = true;
+        tcsetattr(STDIN_FILENO, TCSANOW, &term);
+    } else {
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved);
     }
-
-    int bytesWaiting;
-    ioctl(STDIN, FIONREAD, &bytesWaiting);
-    return bytesWaiting;
 }
 
 int inv_init_sysfs_attributes(void)
@@ -182,6 +237,7 @@ int inv_init_sysfs_attributes(void)
     sprintf(mpu.tap_on, "%s%s", sysfs_path, "/tap_on");
     sprintf(mpu.tap_threshold, "%s%s", sysfs_path, "/tap_threshold");
     sprintf(mpu.tap_time, "%s%s", sysfs_path, "/tap_time");
+    sprintf(mpu.event_timestamp, "%s%s", sysfs_path, "/event_timestamp");
 
 #if 0
     // test print sysfs paths
@@ -274,32 +330,26 @@ int enable_orient(int en)
     return 0;
 }
 
-int flickHandler()
+int flickHandler(int data)
 {
-    FILE *fp;
-    int data;
+    if (quiet)
+        return 0;
 
 #ifdef DEBUG_PRINT
     printf("GT:Flick Handler\n");
 #endif
 
-    fp = fopen(mpu.event_flick, "rt");
-    fscanf(fp, "%d\n", &data);
-    fclose (fp);
-
     printf("Flick= %x\n", data);
 
     return 0;
 }
 
-int tapHandler()
+int tapHandler(int tap)
 {
-    FILE *fp;
-    int tap, tap_dir, tap_num;
+    int tap_dir, tap_num;
 
-    fp = fopen(mpu.event_tap, "rt");
-    fscanf(fp, "%d\n", &tap);
-    fclose(fp);
+    if (quiet)
+        return 0;
 
     tap_dir = tap/8;
     tap_num = tap%8 + 1;
@@ -338,32 +388,24 @@ int tapHandler()
     return 0;
 }
 
-int googleOrientHandler()
+int googleOrientHandler(int orient)
 {
-    FILE *fp;
-    int orient;
+    if (quiet)
+        return 0;
 
 #ifdef DEBUG_PRINT
     printf("GT:Google Orient Handler\n");
 #endif
 
-    fp = fopen(mpu.event_display_orientation, "rt");
-    fscanf(fp, "%d\n", &orient);
-    fclose(fp);
-
     printf("Google Orient-> %d\n", orient);
 
     return 0;
 }
 
-int orientHandler()
+int orientHandler(int orient)
 {
-    FILE *fp;
-    int orient;
-
-    fp = fopen(mpu.event_orientation, "rt");
-    fscanf(fp, "%d\n", &orient);
-    fclose(fp);
+    if (quiet)
+        return 0;
 
 #ifdef DEBUG_PRINT
     printf("GT:Reg Orient Handler\n");
@@ -393,7 +435,11 @@ int orientHandler()
     return 0;
 }
 
-int enableDMPFeatures(int en)
+/**
+ *  Enable or disable the DMP features selected by mask (one bit per
+ *  feature, e.g. 1 << tap).
+ */
+int enableDMPFeatures(int en, int mask)
 {
     int res= -1;
 
@@ -403,49 +449,77 @@ int enableDMPFeatures(int en)
         /* An error in enabling features below could be an indication of the feature */
         /* not supported in current loaded DMP firmware */
 
-        enable_flick(en);
-        enable_tap(en);
-        enable_displ_orient(en);
-        enable_orient(en);
+        if (mask & (1 << flick))
+            enable_flick(en);
+        if (mask & (1 << tap))
+            enable_tap(en);
+        if (mask & (1 << gOrient))
+            enable_displ_orient(en);
+        if (mask & (1 << orient))
+            enable_orient(en);
         res= 0;
     }
 
     return res;
 }
 
-int initFds()
+/**
+ *  Open the event nodes of the features in mask and add them to the
+ *  epoll set.  Each node is read once first so only new events wake us.
+ */
+int initFds(int efd, int mask)
 {
+    struct epoll_event ev;
+    long long dummy;
     int i;
 
     for (i=0; i< numDMPFeatures; i++) {
+        char *path;
+
+        if (!(mask & (1 << i)))
+            continue;
+
         switch(i) {
             case tap:
-                pfd[i].fd = open(mpu.event_tap, O_RDONLY | O_NONBLOCK);
+                path = mpu.event_tap;
                 break;
 
             case flick:
-                pfd[i].fd = open(mpu.event_flick, O_RDONLY | O_NONBLOCK);
+                path = mpu.event_flick;
                 break;
 
             case gOrient:
-                pfd[i].fd = open(mpu.event_display_orientation, O_RDONLY | O_NONBLOCK);
+                path = mpu.event_display_orientation;
                 break;
 
             case orient:
-                pfd[i].fd = open(mpu.event_orientation, O_RDONLY | O_NONBLOCK);
+                path = mpu.event_orientation;
                 break;
 
             default:
-                pfd[i].fd = -1;
-         }
+                continue;
+        }
 
-        pfd[i].events = POLLPRI|POLLERR,
-        pfd[i].revents = 0;
+        events[i].fd = open(path, O_RDONLY | O_NONBLOCK);
 #ifdef DEBUG_PRINT
-        printf("GT:pfd[%d].fd= %d\n", i, pfd[i].fd);
+        printf("GT:%s fd= %d\n", events[i].name, events[i].fd);
 #endif
+        if (events[i].fd < 0)
+            continue;
+        read_event_fd(events[i].fd, &dummy);
+
+        ev.events = EPOLLPRI | EPOLLERR;
+        ev.data.u32 = i;
+        if (epoll_ctl(efd, EPOLL_CTL_ADD, events[i].fd, &ev) < 0) {
+            printf("GT:ERR-can't poll '%s'\n", path);
+            close(events[i].fd);
+            events[i].fd = -1;
+        }
     }
 
+    /* not every driver stamps its DMP interrupts */
+    irq_ts_fd = open(mpu.event_timestamp, O_RDONLY);
+
     return 0;
 }
 
@@ -453,20 +527,124 @@ int closeFds()
 {
     int i;
     for (i = 0; i < numDMPFeatures; i++) {
-        if (!pfd[i].fd)
-            close(pfd[i].fd);
+        if (events[i].fd >= 0)
+            close(events[i].fd);
+        events[i].fd = -1;
     }
+    if (irq_ts_fd >= 0)
+        close(irq_ts_fd);
+    irq_ts_fd = -1;
     return 0;
 }
 
+/**
+ *  Read the event behind a wakeup, run its handler and account the time
+ *  from the DMP interrupt (when the driver reports it) and from the
+ *  wakeup to the handler.
+ */
+static void dispatch_event(struct gesture_event *e, long long woke)
+{
+    long long data, irq_ts = 0, entry, done, lat;
+
+    if (read_event_fd(e->fd, &data) < 0)
+        return;
+    if (irq_ts_fd >= 0 && read_event_fd(irq_ts_fd, &irq_ts) < 0)
+        irq_ts = 0;
+
+    entry = now_ns();
+    e->handler((int)data);
+    done = now_ns();
+
+    if (irq_ts > 0 && entry > irq_ts) {
+        lat = entry - irq_ts;
+        if (!e->irq_min || lat < e->irq_min)
+            e->irq_min = lat;
+        if (lat > e->irq_max)
+            e->irq_max = lat;
+        e->irq_sum += lat;
+    }
+    lat = done - woke;
+    if (!e->disp_min || lat < e->disp_min)
+        e->disp_min = lat;
+    if (lat > e->disp_max)
+        e->disp_max = lat;
+    e->disp_sum += lat;
+    e->count++;
+}
+
+/**
+ *  One JSON line per feature with its event count and latencies, then a
+ *  summary line with the wakeup rate and CPU time of the whole run.
+ */
+static void print_report(int mask, double elapsed, unsigned long wakeups,
+                         long long cpu)
+{
+    unsigned long total = 0;
+    int i;
+
+    for (i = 0; i < numDMPFeatures; i++) {
+        struct gesture_event *e = &events[i];
+        unsigned long n = e->count ? e->count : 1;
+
+        if (!(mask & (1 << i)))
+            continue;
+        total += e->count;
+        printf("{\"bench\":\"gesture_test\",\"feature\":\"%s\","
+               "\"available\":%d,\"events\":%lu,"
+               "\"irq_latency_us_min\":%.1f,\"irq_latency_us_avg\":%.1f,"
+               "\"irq_latency_us_max\":%.1f,\"dispatch_us_min\":%.1f,"
+               "\"dispatch_us_avg\":%.1f,\"dispatch_us_max\":%.1f}\n",
+               e->name, e->fd >= 0, e->count,
+               e->irq_min / 1e3, e->irq_sum / 1e3 / n, e->irq_max / 1e3,
+               e->disp_min / 1e3, e->disp_sum / 1e3 / n, e->disp_max / 1e3);
+    }
+    printf("{\"bench\":\"gesture_test\",\"feature\":\"all\",\"mask\":%d,"
+           "\"irq_timestamp\":%d,\"seconds\":%.3f,\"events\":%lu,"
+           "\"wakeups\":%lu,\"wakeups_per_sec\":%.2f,\"cpu_us\":%lld,"
+           "\"cpu_us_per_event\":%.1f}\n",
+           mask, irq_ts_fd >= 0, elapsed, total, wakeups,
+           elapsed > 0 ? wakeups / elapsed : 0.0, cpu,
+           total ? (double)cpu / total : 0.0);
+}
+
 /*******************************************************************************
  *                       M a i n  S e l f  T e s t
  ******************************************************************************/
 
+/**
+ *  gesture_test [-b seconds] [-g mask] [-q]
+ *
+ *  -b  run for a fixed time instead of until a key is pressed and don't
+ *      print the gestures, for power and latency measurements
+ *  -g  DMP features to enable, bit 0 tap, 1 flick, 2 display orientation,
+ *      3 orientation (default all)
+ *  -q  don't print the gestures
+ */
 int main(int argc, char **argv)
 {
-    char data[4];
-    int i, res= 0;
+    struct epoll_event ev[numDMPFeatures + 1];
+    unsigned long bench_secs = 0, wakeups = 0;
+    int mask = (1 << numDMPFeatures) - 1;
+    int efd, i, n, c, timeout, stop = 0, res= 0;
+    long long start, end, woke, cpu;
+
+    while ((c = getopt(argc, argv, "b:g:q")) != -1) {
+        switch (c) {
+        case 'b':
+            bench_secs = strtoul(optarg, NULL, 10);
+            quiet = 1;
+            break;
+        case 'g':
+            mask = strtol(optarg, NULL, 0) & ((1 << numDMPFeatures) - 1);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            printf("usage: %s [-b seconds] [-g mask] [-q]\n", argv[0]);
+            return -1;
+        }
+    }
 
     res = inv_init_sysfs_attributes();
     if (res) {
@@ -474,56 +652,77 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    efd = epoll_create(numDMPFeatures + 1);
+    if (efd < 0) {
+        printf("GT:ERR-Can't create epoll set\n");
+        free(sysfs_names_ptr);
+        return -1;
+    }
+
     /* On Gesture/DMP supported features */
-    enableDMPFeatures(1);
+    if (enableDMPFeatures(1, mask) < 0)
+        printf("GT:ERR-DMP firmware not loaded\n");
 
     /* init Fds to poll for Gesture data */
-    initFds();
+    initFds(efd, mask);
+
+    if (!bench_secs) {
+        ev[0].events = EPOLLIN;
+        ev[0].data.u32 = numDMPFeatures;
+        epoll_ctl(efd, EPOLL_CTL_ADD, STDIN_FILENO, &ev[0]);
+        stdin_unbuffered(1);
 
-    /* prompt user to make gesture and how to stop program */
-    printf("\n**Please make Gesture to see data.  Press any key to stop Prog**\n\n");
+        /* prompt user to make gesture and how to stop program */
+        printf("\n**Please make Gesture to see data.  Press any key to stop Prog**\n\n");
+    }
 
-    do {
-        for (i=0; i< numDMPFeatures; i++) {
-            read(pfd[i].fd, data, 4);
+    cpu = cpu_us();
+    start = now_ns();
+    end = start + bench_secs * 1000000000LL;
+
+    /* sleep until a gesture or a key press, nothing else wakes us */
+    while (!stop) {
+        timeout = -1;
+        if (bench_secs) {
+            woke = now_ns();
+            if (woke >= end)
+                break;
+            timeout = (int)((end - woke) / 1000000) + 1;
         }
 
-        poll(pfd, numDMPFeatures, POLL_TIME);
-
-        for (i=0; i< numDMPFeatures; i++) {
-           if(pfd[i].revents != 0) {
-               switch(i) {
-                   case tap:
-                       tapHandler();
-                       break;
-
-                   case flick:
-                       flickHandler();
-                       break;
-
-                   case gOrient:
-                       googleOrientHandler();
-                       break;
-
-                   case orient:
-                       orientHandler();
-                       break;
-
-                   default:
-                       printf("GT:ERR-Not supported");
-                       break;
-               }
-               pfd[i].revents= 0;	//no need. reset anyway
-           }
+        n = epoll_wait(efd, ev, numDMPFeatures + 1, timeout);
+        woke = now_ns();
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            printf("GT:ERR-epoll_wait failed (%d)\n", errno);
+            res = -1;
+            break;
+        }
+        if (n == 0)
+            continue;
+        wakeups++;
+
+        for (i = 0; i < n; i++) {
+            if (ev[i].data.u32 == numDMPFeatures) {
+                stop = 1;
+                continue;
+            }
+            dispatch_event(&events[ev[i].data.u32], woke);
         }
+    }
 
-    } while (!_kbhit());
+    cpu = cpu_us() - cpu;
+    print_report(mask, (now_ns() - start) / 1e9, wakeups, cpu);
 
     /* Off DMP features */
-    enableDMPFeatures(0);
+    enableDMPFeatures(0, (1 << numDMPFeatures) - 1);
 
     /* release resources */
+    if (!bench_secs)
+        stdin_unbuffered(0);
     closeFds();
+    close(efd);
     if (sysfs_names_ptr) {
         free(sysfs_names_ptr);
     }
@@ -532,4 +731,3 @@ int main(int argc, char **argv)
 
     return res;
 }
-
@@ -28,6 +28,8 @@
 #include <linux/types.h>
 #include <string.h>
 #include <poll.h>
+#include <time.h>
+#include <sys/resource.h>
 #include "iio_utils.h"
 #include "ml_load_dmp.h"
 #include "ml_sysfs_helper.h"
@@ -429,6 +431,121 @@ void get_dmp_event(char *dev_dir_name)
 }
 
 
+static long long bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long bench_cpu_us(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000LL +
+        ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/**
+ * run_benchmark() - stream the buffer for a fixed time without formatting
+ * @fd:            non blocking buffer access node
+ * @scan_size:     bytes per scan
+ * @infoarray:     channel info, used to find the timestamp channel
+ * @num_channels:  size of infoarray
+ * @seconds:       how long to stream
+ * @rate:          sampling rate in Hz, 0 if unknown
+ * @watermark:     scans to let collect before each read
+ * @hw_watermark:  the driver wakes us at the watermark itself
+ * @buf_len:       IIO buffer length in scans
+ *
+ * Prints one JSON line with the achieved rate, samples dropped according
+ * to the timestamps, read sizes, syscalls per sample and wakeups per
+ * second.
+ **/
+static int run_benchmark(int fd, int scan_size,
+                         struct iio_channel_info *infoarray, int num_channels,
+                         unsigned long seconds, unsigned long rate,
+                         unsigned long watermark, int hw_watermark,
+                         unsigned long buf_len)
+{
+    char *data;
+    int i, ts_loc = -1;
+    long long start, end, now, cpu, ts, last_ts = 0, period = 0;
+    unsigned long long samples = 0, dropped = 0, reads = 0, bytes = 0;
+    unsigned long long syscalls = 0, wakeups = 0;
+    int read_min = 0, read_max = 0, n, k;
+    struct pollfd pfd;
+    double elapsed;
+
+    data = malloc(scan_size * buf_len);
+    if (!data)
+        return -ENOMEM;
+    for (i = 0; i < num_channels; i++) {
+        if (infoarray[i].bytes == 8 &&
+            strcmp(infoarray[i].name, "timestamp") == 0)
+            ts_loc = infoarray[i].location;
+    }
+    if (rate)
+        period = 1000000000LL / rate;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    cpu = bench_cpu_us();
+    start = bench_now_ns();
+    end = start + seconds * 1000000000LL;
+    while ((now = bench_now_ns()) < end) {
+        syscalls++;
+        if (poll(&pfd, 1, (int)((end - now) / 1000000) + 1) <= 0)
+            continue;
+        wakeups++;
+        if (!hw_watermark && watermark > 1 && rate) {
+            /* let the FIFO fill to the watermark before reading */
+            usleep((watermark - 1) * 1000000 / rate);
+            syscalls++;
+        }
+        for (;;) {
+            syscalls++;
+            n = read(fd, data, scan_size * buf_len);
+            if (n <= 0)
+                break;
+            reads++;
+            bytes += n;
+            if (read_min == 0 || n < read_min)
+                read_min = n;
+            if (n > read_max)
+                read_max = n;
+            for (k = 0; k < n / scan_size; k++) {
+                samples++;
+                if (ts_loc < 0 || !period)
+                    continue;
+                ts = *(int64_t *)(data + k * scan_size + ts_loc);
+                /* a gap of more than 1.5 periods means scans were lost */
+                if (last_ts && ts - last_ts > period + period / 2)
+                    dropped += (ts - last_ts + period / 2) / period - 1;
+                last_ts = ts;
+            }
+        }
+    }
+    elapsed = (bench_now_ns() - start) / 1e9;
+    cpu = bench_cpu_us() - cpu;
+
+    printf("{\"bench\":\"mpu_iio\",\"rate_hz\":%lu,\"watermark\":%lu,"
+           "\"hw_watermark\":%d,\"buffer_length\":%lu,\"scan_bytes\":%d,"
+           "\"seconds\":%.3f,\"samples\":%llu,\"achieved_hz\":%.1f,"
+           "\"dropped\":%llu,\"reads\":%llu,\"read_bytes_min\":%d,"
+           "\"read_bytes_avg\":%.1f,\"read_bytes_max\":%d,"
+           "\"syscalls_per_sample\":%.3f,\"wakeups_per_sec\":%.1f,"
+           "\"cpu_us_per_sample\":%.2f}\n",
+           rate, watermark, hw_watermark, buf_len, scan_size,
+           elapsed, samples, samples / elapsed,
+           dropped, reads, read_min,
+           reads ? (double)bytes / reads : 0.0, read_max,
+           samples ? (double)syscalls / samples : 0.0, wakeups / elapsed,
+           samples ? (double)cpu / samples : 0.0);
+    free(data);
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     unsigned long num_loops = 2;
@@ -454,12 +571,16 @@ int main(int argc, char **argv)
     char chip_name[10];
     char device_name[10];
     char sysfs[100];
+    unsigned long bench_secs = 0, bench_rate = 0, bench_wm = 1;
+    int hw_watermark = 0;
 
     struct iio_channel_info *infoarray;
     /* -r means no DMP is enabled (raw) -> should be used for mpu3050.
        -p means no print of data */
     /* when using -p, 1 means orientation, 2 means tap, 3 means flick */
-    while ((c = getopt(argc, argv, "l:w:c:pret:")) != -1) {
+    /* -b <seconds> benchmarks the buffer instead of printing it, at the
+       rate set with -f <Hz> reading every -m <scans> */
+    while ((c = getopt(argc, argv, "l:w:c:pret:b:f:m:")) != -1) {
         switch (c) {
         case 't':
             trigger_name = optarg;
@@ -483,6 +604,15 @@ int main(int argc, char **argv)
         case 'l':
             buf_len = strtoul(optarg, &dummy, 10);
             break;
+        case 'b':
+            bench_secs = strtoul(optarg, &dummy, 10);
+            break;
+        case 'f':
+            bench_rate = strtoul(optarg, &dummy, 10);
+            break;
+        case 'm':
+            bench_wm = strtoul(optarg, &dummy, 10);
+            break;
         case '?':
             return -1;
         }
@@ -606,6 +736,16 @@ int main(int argc, char **argv)
         printf("Problem reading scan element information\n");
         goto exit_here;
     }
+    if (bench_secs) {
+        if (bench_rate)
+            write_sysfs_int("sampling_frequency", dev_dir_name, bench_rate);
+        ret = read_sysfs_posint("sampling_frequency", dev_dir_name);
+        bench_rate = ret > 0 ? ret : bench_rate;
+        /* older drivers have no watermark and wake on every scan */
+        if (bench_wm > 1)
+            hw_watermark = write_sysfs_int("watermark", buf_dir_name,
+                                           bench_wm) >= 0;
+    }
 
     /* Enable the buffer */
     ret = write_sysfs_int("enable", buf_dir_name, 1);
@@ -636,6 +776,12 @@ int main(int argc, char **argv)
         ret = -errno;
         goto error_free_buffer_access;
     }
+    if (bench_secs) {
+        ret = run_benchmark(fp, scan_size, infoarray, num_channels,
+                            bench_secs, bench_rate, bench_wm, hw_watermark,
+                            buf_len);
+        num_loops = 0;
+    }
     /* Wait for events 10 times */
     for (j = 0; j < num_loops; j++) {
         if (!noevents) {
@@ -0,0 +1,11 @@
+#### filelist.mk for inv_playback ####
+
+# headers
+#HEADERS += 
+
+# sources
+SOURCES := $(APP_DIR)/inv_playback.c
+
+INV_SOURCES += $(SOURCES)
+
+VPATH += $(APP_DIR)
@@ -0,0 +1,429 @@
+/**
+ *  Playback benchmark for the MPL.
+ *
+ *  Replays an input log recorded by the HAL (/data/playback.bin, written
+ *  when libmllite and the HAL are built with INV_PLAYBACK_DBG) through
+ *  inv_build_*() and inv_execute_on_data() as fast as possible, then reports
+ *  the throughput and the time spent in each MPL data callback.
+ *
+ *  With -o the fusion outputs after every execute are written as text; with
+ *  -c they are compared against such a file instead, so a change to the MPL
+ *  can be checked for bit-exactness (or against a tolerance with -t).
+ *
+ *  The log is read with the native type sizes, so replay it on the same ABI
+ *  it was recorded on.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "invensense.h"
+#include "invensense_adv.h"
+
+#ifndef INV_PLAYBACK_DBG
+#error "inv_playback needs INV_PLAYBACK_DBG, see build/android/shared.mk"
+#endif
+
+#define FALSE   0
+#define TRUE    1
+
+/* fusion outputs written per execute: 7 sensors, up to 5 values each */
+#define NUM_OUTPUTS     7
+#define MAX_VALUES      5
+#define MAX_CB          INV_MAX_DATA_CB
+
+struct output_t {
+    const char *name;
+    int (*get)(float *values, int8_t *accuracy, inv_time_t *timestamp);
+    int num;
+};
+
+static const struct output_t outputs[NUM_OUTPUTS] = {
+    { "gyroscope",      inv_get_sensor_type_gyroscope,              3 },
+    { "accelerometer",  inv_get_sensor_type_accelerometer,          3 },
+    { "magnetic",       inv_get_sensor_type_magnetic_field,         3 },
+    { "orientation",    inv_get_sensor_type_orientation,            3 },
+    { "rotation",       inv_get_sensor_type_rotation_vector,        5 },
+    { "linear_accel",   inv_get_sensor_type_linear_acceleration,    3 },
+    { "gravity",        inv_get_sensor_type_gravity,                3 },
+};
+
+static const struct {
+    int priority;
+    const char *name;
+} modules[] = {
+    { INV_PRIORITY_MOTION_NO_MOTION,        "motion_no_motion" },
+    { INV_PRIORITY_GYRO_TC,                 "gyro_tc" },
+    { INV_PRIORITY_QUATERNION_GYRO_ACCEL,   "quaternion_gyro_accel" },
+    { INV_PRIORITY_QUATERNION_NO_GYRO,      "quaternion_no_gyro" },
+    { INV_PRIORITY_MAGNETIC_DISTURBANCE,    "magnetic_disturbance" },
+    { INV_PRIORITY_HEADING_FROM_GYRO,       "heading_from_gyro" },
+    { INV_PRIORITY_COMPASS_BIAS_W_GYRO,     "compass_bias_w_gyro" },
+    { INV_PRIORITY_COMPASS_VECTOR_CAL,      "compass_vector_cal" },
+    { INV_PRIORITY_COMPASS_ADV_BIAS,        "compass_adv_bias" },
+    { INV_PRIORITY_9_AXIS_FUSION,           "9_axis_fusion" },
+    { INV_PRIORITY_QUATERNION_ADJUST_9_AXIS, "quaternion_adjust_9_axis" },
+    { INV_PRIORITY_QUATERNION_ACCURACY,     "quaternion_accuracy" },
+    { INV_PRIORITY_RESULTS_HOLDER,          "results_holder" },
+    { INV_PRIORITY_INUSE_AUTO_CALIBRATION,  "inuse_auto_calibration" },
+    { INV_PRIORITY_HAL_OUTPUTS,             "hal_outputs" },
+    { INV_PRIORITY_GLYPH,                   "glyph" },
+    { INV_PRIORITY_SHAKE,                   "shake" },
+    { INV_PRIORITY_SM,                      "sm" },
+};
+
+/* recorded input, loaded whole so file I/O stays out of the timing */
+static unsigned char *log_data;
+static size_t log_size;
+static size_t log_pos;
+
+static long long now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static int load_log(const char *path)
+{
+    FILE *fp;
+    long size;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        printf("cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (size <= 0) {
+        printf("%s is empty\n", path);
+        fclose(fp);
+        return -1;
+    }
+    log_data = malloc(size);
+    if (log_data == NULL || fread(log_data, 1, size, fp) != (size_t)size) {
+        printf("cannot read %s\n", path);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    log_size = size;
+    log_pos = 0;
+    return 0;
+}
+
+/* copy the next len bytes of the log, FALSE at the end or on a torn record */
+static int get(void *dst, size_t len)
+{
+    if (log_pos + len > log_size)
+        return FALSE;
+    memcpy(dst, log_data + log_pos, len);
+    log_pos += len;
+    return TRUE;
+}
+
+static inv_error_t setup_mpl(void)
+{
+    inv_error_t result;
+
+    result = inv_init_mpl();
+    if (result)
+        return result;
+
+    /* same feature set as the HAL, see inv_constructor_default_enable() */
+    if ((result = inv_enable_quaternion()) ||
+        (result = inv_enable_in_use_auto_calibration()) ||
+        (result = inv_enable_fast_nomot()) ||
+        (result = inv_enable_gyro_tc()) ||
+        (result = inv_enable_hal_outputs()) ||
+        (result = inv_enable_vector_compass_cal()) ||
+        (result = inv_enable_compass_bias_w_gyro()) ||
+        (result = inv_enable_heading_from_gyro()) ||
+        (result = inv_enable_magnetic_disturbance()) ||
+        (result = inv_enable_9x_sensor_fusion()) ||
+        (result = inv_enable_no_gyro_fusion()) ||
+        (result = inv_enable_quat_accuracy_monitor()))
+        return result;
+    inv_vector_compass_cal_sensitivity(3);
+
+    return inv_start_mpl();
+}
+
+static void write_outputs(FILE *out, inv_time_t timestamp)
+{
+    float values[MAX_VALUES];
+    int8_t accuracy;
+    inv_time_t ts;
+    int i, j;
+
+    fprintf(out, "%lld", timestamp);
+    for (i = 0; i < NUM_OUTPUTS; i++) {
+        memset(values, 0, sizeof(values));
+        accuracy = 0;
+        outputs[i].get(values, &accuracy, &ts);
+        fprintf(out, " %d", accuracy);
+        for (j = 0; j < outputs[i].num; j++)
+            fprintf(out, " %.9g", values[j]);
+    }
+    fprintf(out, "\n");
+}
+
+/* compare the current outputs with the next line of ref, return mismatches */
+static int compare_outputs(FILE *ref, float tolerance, float *max_diff,
+                           long sample)
+{
+    float values[MAX_VALUES], expected;
+    int8_t accuracy;
+    int ref_accuracy;
+    inv_time_t ts;
+    long long ref_ts;
+    int i, j, bad = 0;
+
+    if (fscanf(ref, "%lld", &ref_ts) != 1) {
+        printf("reference ends at sample %ld\n", sample);
+        return 1;
+    }
+    for (i = 0; i < NUM_OUTPUTS; i++) {
+        memset(values, 0, sizeof(values));
+        accuracy = 0;
+        outputs[i].get(values, &accuracy, &ts);
+        if (fscanf(ref, "%d", &ref_accuracy) != 1)
+            return 1;
+        if (ref_accuracy != accuracy && !bad++)
+            printf("sample %ld: %s accuracy %d, expected %d\n",
+                   sample, outputs[i].name, accuracy, ref_accuracy);
+        for (j = 0; j < outputs[i].num; j++) {
+            float diff;
+            if (fscanf(ref, "%f", &expected) != 1)
+                return 1;
+            diff = fabsf(values[j] - expected);
+            if (diff > max_diff[i])
+                max_diff[i] = diff;
+            if (diff > tolerance && !bad++)
+                printf("sample %ld: %s[%d] = %.9g, expected %.9g\n",
+                       sample, outputs[i].name, j, values[j], expected);
+        }
+    }
+    return bad;
+}
+
+static const char *module_name(int priority)
+{
+    unsigned int i;
+    for (i = 0; i < sizeof(modules) / sizeof(modules[0]); i++) {
+        if (modules[i].priority == priority)
+            return modules[i].name;
+    }
+    return "unknown";
+}
+
+static void usage(const char *name)
+{
+    printf("usage: %s [-o outputs.txt | -c reference.txt [-t tolerance]] "
+           "[playback.bin]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    const char *in_path = "/data/playback.bin";
+    const char *out_path = NULL, *ref_path = NULL;
+    FILE *out = NULL, *ref = NULL;
+    float tolerance = 0.f;
+    float max_diff[NUM_OUTPUTS];
+    struct inv_data_cb_profile_t profile[MAX_CB];
+    long long start, elapsed = 0, t;
+    long executes = 0, records = 0, mismatched = 0;
+    inv_time_t last_ts = 0;
+    int type, num, opt, i;
+
+    while ((opt = getopt(argc, argv, "o:c:t:h")) != -1) {
+        switch (opt) {
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'c':
+            ref_path = optarg;
+            break;
+        case 't':
+            tolerance = atof(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (optind < argc)
+        in_path = argv[optind];
+    if (out_path && ref_path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (load_log(in_path))
+        return 1;
+    if (out_path && (out = fopen(out_path, "w")) == NULL) {
+        printf("cannot create %s: %s\n", out_path, strerror(errno));
+        return 1;
+    }
+    if (ref_path && (ref = fopen(ref_path, "r")) == NULL) {
+        printf("cannot open %s: %s\n", ref_path, strerror(errno));
+        return 1;
+    }
+    memset(max_diff, 0, sizeof(max_diff));
+
+    if (setup_mpl()) {
+        printf("MPL setup failed\n");
+        return 1;
+    }
+    inv_enable_data_cb_profiling(TRUE);
+
+    while (get(&type, sizeof(type))) {
+        short gyro[3];
+        long data[4], value;
+        int status, orientation;
+        inv_time_t ts;
+        int ok = TRUE;
+
+        records++;
+        start = now_ns();
+        switch (type) {
+        case PLAYBACK_DBG_TYPE_GYRO:
+            ok = get(gyro, sizeof(gyro)) && get(&ts, sizeof(ts));
+            if (ok) {
+                start = now_ns();
+                inv_build_gyro(gyro, ts);
+                last_ts = ts;
+            }
+            break;
+        case PLAYBACK_DBG_TYPE_ACCEL:
+            ok = get(data, 3 * sizeof(long)) && get(&status, sizeof(status)) &&
+                 get(&ts, sizeof(ts));
+            if (ok) {
+                start = now_ns();
+                inv_build_accel(data, status, ts);
+                last_ts = ts;
+            }
+            break;
+        case PLAYBACK_DBG_TYPE_COMPASS:
+            ok = get(data, 3 * sizeof(long)) && get(&status, sizeof(status)) &&
+                 get(&ts, sizeof(ts));
+            if (ok) {
+                start = now_ns();
+                inv_build_compass(data, status, ts);
+                last_ts = ts;
+            }
+            break;
+        case PLAYBACK_DBG_TYPE_QUAT:
+            ok = get(data, 4 * sizeof(long)) && get(&status, sizeof(status)) &&
+                 get(&ts, sizeof(ts));
+            if (ok) {
+                start = now_ns();
+                inv_build_quat(data, status, ts);
+                last_ts = ts;
+            }
+            break;
+        case PLAYBACK_DBG_TYPE_TEMPERATURE:
+            ok = get(&value, sizeof(value)) && get(&ts, sizeof(ts));
+            if (ok) {
+                start = now_ns();
+                inv_build_temp(value, ts);
+            }
+            break;
+        case PLAYBACK_DBG_TYPE_EXECUTE:
+            inv_execute_on_data();
+            elapsed += now_ns() - start;
+            executes++;
+            if (out)
+                write_outputs(out, last_ts);
+            if (ref)
+                mismatched += compare_outputs(ref, tolerance, max_diff,
+                                              executes) ? 1 : 0;
+            continue;
+        case PLAYBACK_DBG_TYPE_A_ORIENT:
+        case PLAYBACK_DBG_TYPE_G_ORIENT:
+        case PLAYBACK_DBG_TYPE_C_ORIENT:
+            ok = get(&orientation, sizeof(orientation)) &&
+                 get(&value, sizeof(value));
+            if (!ok)
+                break;
+            if (type == PLAYBACK_DBG_TYPE_A_ORIENT)
+                inv_set_accel_orientation_and_scale(orientation, value);
+            else if (type == PLAYBACK_DBG_TYPE_G_ORIENT)
+                inv_set_gyro_orientation_and_scale(orientation, value);
+            else
+                inv_set_compass_orientation_and_scale(orientation, value);
+            continue;
+        case PLAYBACK_DBG_TYPE_A_SAMPLE_RATE:
+        case PLAYBACK_DBG_TYPE_C_SAMPLE_RATE:
+        case PLAYBACK_DBG_TYPE_G_SAMPLE_RATE:
+        case PLAYBACK_DBG_TYPE_Q_SAMPLE_RATE:
+            ok = get(&value, sizeof(value));
+            if (!ok)
+                break;
+            if (type == PLAYBACK_DBG_TYPE_A_SAMPLE_RATE)
+                inv_set_accel_sample_rate(value);
+            else if (type == PLAYBACK_DBG_TYPE_C_SAMPLE_RATE)
+                inv_set_compass_sample_rate(value);
+            else if (type == PLAYBACK_DBG_TYPE_G_SAMPLE_RATE)
+                inv_set_gyro_sample_rate(value);
+            else
+                inv_set_quat_sample_rate(value);
+            continue;
+        case PLAYBACK_DBG_TYPE_GYRO_OFF:
+            inv_gyro_was_turned_off();
+            continue;
+        case PLAYBACK_DBG_TYPE_ACCEL_OFF:
+            inv_accel_was_turned_off();
+            continue;
+        case PLAYBACK_DBG_TYPE_COMPASS_OFF:
+            inv_compass_was_turned_off();
+            continue;
+        default:
+            printf("unknown record type %d at offset %lu\n",
+                   type, (unsigned long)(log_pos - sizeof(type)));
+            ok = FALSE;
+            break;
+        }
+        if (!ok)
+            break;
+        elapsed += now_ns() - start;
+    }
+    if (log_pos < log_size)
+        printf("stopped at offset %lu of %lu\n",
+               (unsigned long)log_pos, (unsigned long)log_size);
+
+    t = elapsed ? elapsed : 1;
+    printf("%ld records, %ld executes in %lld us, %.0f executes/sec\n",
+           records, executes, elapsed / 1000, executes * 1e9 / t);
+
+    num = inv_get_data_cb_profile(profile, MAX_CB);
+    printf("%-26s %10s %12s %10s %6s\n",
+           "callback", "calls", "total us", "avg ns", "share");
+    for (i = 0; i < num; i++) {
+        printf("%-26s %10lu %12lld %10lld %5.1f%%\n",
+               module_name(profile[i].priority), profile[i].calls,
+               profile[i].time_ns / 1000,
+               profile[i].calls ? profile[i].time_ns / profile[i].calls : 0,
+               profile[i].time_ns * 100.0 / t);
+    }
+
+    if (ref) {
+        printf("%ld of %ld executes differ (tolerance %g), max difference:\n",
+               mismatched, executes, tolerance);
+        for (i = 0; i < NUM_OUTPUTS; i++)
+            printf("  %-14s %g\n", outputs[i].name, max_diff[i]);
+        fclose(ref);
+    }
+    if (out)
+        fclose(out);
+    free(log_data);
+
+    return mismatched ? 2 : 0;
+}
@@ -23,6 +23,7 @@
 #include "storage_manager.h"
 #include "ml_stored_data.h"
 #include "ml_sysfs_helper.h"
+#include "mlos.h"
 
 #ifndef ABS
 #define ABS(x)(((x) >= 0) ? (x) : -(x))
@@ -88,6 +89,45 @@ struct inv_db_save_t {
 
 static struct inv_db_save_t save_data;
 
+/* Each attribute is opened once and then read and written at offset 0,
+   rather than opened and closed on every access. */
+static int sysfs_fd[MAX_SYSFS_ATTRB];
+
+/* Quick check: skip the compass and writes that would not change anything */
+static int quick = FALSE;
+
+/* Start of the phase being timed, see phase_done() */
+static uint64_t phase_start_ns;
+
+static void phase_done(const char *phase)
+{
+    uint64_t now = inv_get_tick_count_ns();
+    printf("Self-Test:%s took %llu ms\n", phase,
+           (unsigned long long)((now - phase_start_ns) / 1000000ULL));
+    phase_start_ns = now;
+}
+
+/** returns the cached descriptor for an attribute path of mpu, opening it
+    on first use */
+static int sysfs_attr_fd(const char *filename, int flags)
+{
+    char **dptr = (char**)&mpu;
+    unsigned int i;
+
+    for (i = 0; i < MAX_SYSFS_ATTRB; i++) {
+        if (dptr[i] == filename)
+            break;
+    }
+    if (i == MAX_SYSFS_ATTRB)
+        return open(filename, flags);
+    if (sysfs_fd[i] < 0) {
+        sysfs_fd[i] = open(filename, O_RDWR);
+        if (sysfs_fd[i] < 0)
+            sysfs_fd[i] = open(filename, flags);
+    }
+    return sysfs_fd[i];
+}
+
 /** This function receives the data that was stored in non-volatile memory
     between power off */
 static inv_error_t inv_db_load_func(const unsigned char *data)
@@ -107,35 +147,63 @@ static inv_error_t inv_db_save_func(unsigned char *data)
 /** read a sysfs entry that represents an integer */
 int read_sysfs_int(char *filename, int *var)
 {
-    int res=0;
-    FILE *fp;
+    char buf[16];
+    ssize_t len;
+    int fd;
 
-    fp = fopen(filename, "r");
-    if (fp != NULL) {
-        fscanf(fp, "%d\n", var);
-        fclose(fp);
-    } else {
+    fd = sysfs_attr_fd(filename, O_RDONLY);
+    if (fd < 0) {
         MPL_LOGE("inv_self_test: ERR open file to read");
-        res= -1;   
+        return -1;
     }
-    return res;
+    len = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (len <= 0) {
+        MPL_LOGE("inv_self_test: ERR read file");
+        return -1;
+    }
+    buf[len] = '\0';
+    *var = atoi(buf);
+    return 0;
 }
 
 /** write a sysfs entry that represents an integer */
 int write_sysfs_int(char *filename, int data)
 {
-    int res=0;
-    FILE  *fp;
+    char buf[16];
+    int fd, len;
 
-    fp = fopen(filename, "w");
-    if (fp!=NULL) {
-        fprintf(fp, "%d\n", data);
-        fclose(fp);
-    } else {
+    fd = sysfs_attr_fd(filename, O_WRONLY);
+    if (fd < 0) {
         MPL_LOGE("inv_self_test: ERR open file to write");
-        res= -1;   
+        return -1;
+    }
+    len = snprintf(buf, sizeof(buf), "%d\n", data);
+    if (pwrite(fd, buf, len, 0) != len) {
+        MPL_LOGE("inv_self_test: ERR write file");
+        return -1;
+    }
+    return 0;
+}
+
+/** write a sysfs integer, in quick mode only if it is not already set */
+static int set_sysfs_int(char *filename, int data)
+{
+    int cur;
+
+    if (quick && read_sysfs_int(filename, &cur) == 0 && cur == data)
+        return 0;
+    return write_sysfs_int(filename, data);
+}
+
+static void inv_close_sysfs_attributes(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < MAX_SYSFS_ATTRB; i++) {
+        if (sysfs_fd[i] >= 0)
+            close(sysfs_fd[i]);
+        sysfs_fd[i] = -1;
     }
-    return res;
 }
 
 int inv_init_sysfs_attributes(void)
@@ -145,6 +213,10 @@ int inv_init_sysfs_attributes(void)
     char *sptr;
     char **dptr;
 
+    for (i = 0; i < MAX_SYSFS_ATTRB; i++)
+        sysfs_fd[i] = -1;
+    i = 0;
+
     sysfs_names_ptr = 
             (char*)malloc(sizeof(char[MAX_SYSFS_ATTRB][MAX_SYSFS_NAME_LEN]));
     sptr = sysfs_names_ptr;
@@ -201,13 +273,15 @@ int main(int argc, char **argv)
     bias_dtype gyro_bias[3];
     bias_dtype accel_bias[3];
     int axis = 0;
-    size_t packet_sz;
     int axis_sign = 1;
-    unsigned char *buffer;
     long timestamp;
     int temperature = 0;
     bool compass_present = TRUE;
 
+    if (argc > 1 && strcmp(argv[1], "-q") == 0)
+        quick = TRUE;
+    phase_start_ns = inv_get_tick_count_ns();
+
     result = inv_init_sysfs_attributes();
     if (result)
         return -1;
@@ -225,49 +299,52 @@ int main(int argc, char **argv)
                 sizeof(save_data), INV_DB_SAVE_KEY);
 
     // Power ON MPUxxxx chip
-    if (write_sysfs_int(mpu.power_state, 1) < 0) {
+    if (set_sysfs_int(mpu.power_state, 1) < 0) {
         printf("Self-Test:ERR-Failed to set power state=1\n");
     } else {
         // Note: Driver turns on power automatically when self-test invoked
     }
 
     // Disable Master enable 
-    if (write_sysfs_int(mpu.enable, 0) < 0) {
+    if (set_sysfs_int(mpu.enable, 0) < 0) {
         printf("Self-Test:ERR-Failed to disable master enable\n");
     }
 
     // Disable DMP
-    if (write_sysfs_int(mpu.dmp_on, 0) < 0) {
+    if (set_sysfs_int(mpu.dmp_on, 0) < 0) {
         printf("Self-Test:ERR-Failed to disable DMP\n");
     }
 
     // Enable Accel
-    if (write_sysfs_int(mpu.accel_enable, 1) < 0) {
+    if (set_sysfs_int(mpu.accel_enable, 1) < 0) {
         printf("Self-Test:ERR-Failed to enable accel\n");
     }
 
     // Enable Gyro
-    if (write_sysfs_int(mpu.gyro_enable, 1) < 0) {
+    if (set_sysfs_int(mpu.gyro_enable, 1) < 0) {
         printf("Self-Test:ERR-Failed to enable gyro\n");
     }
 
     // Enable Compass
-    if (write_sysfs_int(mpu.compass_enable, 1) < 0) {
+    if (quick) {
+        // the quick check only covers gyro and accel
+        compass_present = FALSE;
+    } else if (write_sysfs_int(mpu.compass_enable, 1) < 0) {
 #ifdef DEBUG_PRINT
         printf("Self-Test:ERR-Failed to enable compass\n");
 #endif
         compass_present= FALSE;
     }
+    phase_done("setup");
 
-    fptr = fopen(mpu.self_test, "r");
-    if (!fptr) {
+    // Invoke self-test. The driver tests the gyro and the accel together
+    // in this one read.
+    if (read_sysfs_int(mpu.self_test, &self_test_status) < 0) {
         printf("Self-Test:ERR-Couldn't invoke self-test\n");
         result = -1;
         goto free_sysfs_storage;
     }
-
-    // Invoke self-test 
-    fscanf(fptr, "%d", &self_test_status);
+    phase_done("self-test");
 	if (compass_present == TRUE) {
         printf("Self-Test:Self test result- "
            "Gyro passed= %x, Accel passed= %x, Compass passed= %x\n",
@@ -280,7 +357,6 @@ int main(int argc, char **argv)
 			   (self_test_status & GYRO_PASS_STATUS_BIT),
 			   (self_test_status & ACCEL_PASS_STATUS_BIT) >> 1);
 	}
-    fclose(fptr);
 
     if (self_test_status & GYRO_PASS_STATUS_BIT) {
         // Read Gyro Bias
@@ -333,6 +409,7 @@ int main(int argc, char **argv)
     } else {
         printf("Self-Test:ERR-Couldn't read temperature\n");
     }
+    phase_done("bias read");
 
     // When we read gyro bias, the bias is in raw units scaled by 1000.
     // We store the bias in raw units scaled by 2^16
@@ -381,36 +458,18 @@ int main(int argc, char **argv)
            save_data.accel_temp);
 #endif
 
-    // Get size of packet to store.
-    inv_get_mpl_state_size(&packet_sz);
-
-    // Create place to store data
-    buffer = (unsigned char *)malloc(packet_sz + 10);
-    if (buffer == NULL) {
-        printf("Self-Test:Can't allocate buffer\n");
-        result = -1;
-        goto free_sysfs_storage;
-    }
-
-    // Store the data
-    result = inv_save_mpl_states(buffer, packet_sz);
+    // Store the data. Only the changed records are rewritten when the file
+    // already holds this layout, otherwise it is replaced atomically.
+    result = inv_store_calibration();
     if (result) {
+        printf("Self-Test:ERR- Can't store calibration file - %s\n",
+               MLCAL_FILE);
         result = -1;
-    } else {
-        fptr= fopen(MLCAL_FILE, "wb+");
-        if (fptr != NULL) {
-            fwrite(buffer, 1, packet_sz, fptr);
-            fclose(fptr);
-        } else {
-            printf("Self-Test:ERR- Can't open calibration file to write - %s\n",
-                   MLCAL_FILE);
-            result = -1;
-        }
     }
-
-    free(buffer);
+    phase_done("store");
 
 free_sysfs_storage:
+    inv_close_sysfs_attributes();
     free(sysfs_names_ptr);
     return result;
 }